@@ -1,32 +1,25 @@
+#include <ADCSampler.h>
 
-const int BUFFERSIZE = 320;
-int buffer[BUFFERSIZE];
-int sIndex;
-const long sDelay = 2000;
+// sample A0 every 2 ms after it first reaches 16, keep what came before
+const long sRate = 500;
+const byte pins[] = { 0 };
 
 void setup() {
   Serial.begin(9600);
-  sIndex = 0;
+  ADCSample.begin(pins, 1);
+  ADCSample.setTrigger(ADCSampler::TRIGGER_LEVEL, 0, 16);
 }
 
 void loop() {
-  int i;
-  
-  while (analogRead(0) < 16)
-    delayMicroseconds(sDelay);
-    
-  for (sIndex = 0; sIndex < BUFFERSIZE; sIndex++) {
-    buffer[sIndex] = analogRead(0);
-    delayMicroseconds(sDelay);
+  const int * block;
+
+  ADCSample.start(ADCSampler::TIMER_TRIGGERED, sRate, 3);
+  while (ADCSample.status() != ADCSampler::IDLE || ADCSample.available()) {
+    if ((block = ADCSample.available())) {
+      for (int i = 0; i < ADCSample.blockLength(); i++) {
+        Serial.println(block[i]);
+      }
+      ADCSample.release();
+    }
   }
-
-  for (sIndex = 0; sIndex < BUFFERSIZE; sIndex++) {
-    Serial.println(buffer[sIndex]);
-//    delay(5);
-  }
-
 }
-
-
-
-
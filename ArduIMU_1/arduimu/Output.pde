@@ -26,23 +26,23 @@ void printdata(void)
       
 	#if PRINT_DCM == 1
 		Serial.print ("EX0:");
-		Serial.print(convert_to_dec(DCM_Matrix[0][0]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().a.x)));
 		Serial.print (",EX1:");
-		Serial.print(convert_to_dec(DCM_Matrix[0][1]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().a.y)));
 		Serial.print (",EX2:");
-		Serial.print(convert_to_dec(DCM_Matrix[0][2]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().a.z)));
 		Serial.print (",EX3:");
-		Serial.print(convert_to_dec(DCM_Matrix[1][0]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().b.x)));
 		Serial.print (",EX4:");
-		Serial.print(convert_to_dec(DCM_Matrix[1][1]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().b.y)));
 		Serial.print (",EX5:");
-		Serial.print(convert_to_dec(DCM_Matrix[1][2]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().b.z)));
 		Serial.print (",EX6:");
-		Serial.print(convert_to_dec(DCM_Matrix[2][0]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().c.x)));
 		Serial.print (",EX7:");
-		Serial.print(convert_to_dec(DCM_Matrix[2][1]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().c.y)));
 		Serial.print (",EX8:");
-		Serial.print(convert_to_dec(DCM_Matrix[2][2]));
+		Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().c.z)));
 		Serial.print (",");
 	#endif
 
@@ -257,8 +257,8 @@ void printPerfData(long time)
       
         	IMU_buffer[10]=gyro_sat_count;
         	IMU_buffer[11]=adc_constraints;
-        	IMU_buffer[12]=renorm_sqrt_count;
-        	IMU_buffer[13]=renorm_blowup_count;
+        	IMU_buffer[12]=ahrs.renorm_sqrt_count;
+        	IMU_buffer[13]=ahrs.renorm_blowup_count;
         	IMU_buffer[14]=0;								// gps_payload_error_count - We don't have access to this with GPS library
         	IMU_buffer[15]=0;								// gps_checksum_error_count - We don't have access to this with GPS library
         	IMU_buffer[16]=0;								// gps_pos_fix_count - We don't have access to this with GPS library
@@ -288,9 +288,9 @@ void printPerfData(long time)
     Serial.print(",adc:");
     Serial.print(adc_constraints,DEC);
     Serial.print(",rsc:");
-    Serial.print(renorm_sqrt_count,DEC);
+    Serial.print(ahrs.renorm_sqrt_count,DEC);
     Serial.print(",rbc:");
-    Serial.print(renorm_blowup_count,DEC);
+    Serial.print(ahrs.renorm_blowup_count,DEC);
     Serial.print(",gms:");
     Serial.print(gps_messages_sent,DEC);
     Serial.print(",imu:");
@@ -302,8 +302,8 @@ void printPerfData(long time)
         G_Dt_max  = 0;
         gyro_sat_count = 0;
         adc_constraints = 0;
-        renorm_sqrt_count = 0;
-        renorm_blowup_count = 0;
+        ahrs.renorm_sqrt_count = 0;
+        ahrs.renorm_blowup_count = 0;
         gps_messages_sent = 0;
         
 }
@@ -13,8 +13,11 @@
 #include <avr/eeprom.h>
 #include <Wire.h>
 #include <FastSerial.h>		// ArduPilot Fast Serial Library
+#include <NMEAParser.h>		// NMEA sentence parser used by AP_GPS
 #include <AP_GPS.h>			// ArduPilot GPS library
 #include <APM_Compass.h>	// ArduPilot Mega Magnetometer Library
+#include <AP_Math.h>		// ArduPilot Mega Vector/Matrix math Library
+#include <AP_AHRS.h>		// DCM attitude estimator
 
 //**********************************************************************
 //  This section contains USER PARAMETERS !!!
@@ -46,6 +49,9 @@
 //OUTPUTMODE=1 will print the corrected data, 0 will print uncorrected data of the gyros (with drift), 2 will print accelerometer only data
 #define OUTPUTMODE 1
 
+// 1 runs the DCM in Q16.16 fixed point, 0 in float
+#define AHRS_FIXED 0
+
 #define PRINT_DCM 0     //Will print the whole direction cosine matrix
 #define PRINT_ANALOGS 0 //Will print the analog raw data
 #define PRINT_EULER 1   //Will print the Euler angles Roll, Pitch and Yaw
@@ -158,12 +164,14 @@ boolean groundstartDone = false;    // Used to not repeat ground start
 float AN[8]; //array that store the 6 ADC filtered data
 float AN_OFFSET[8]; //Array that stores the Offset of the gyros
 
-float Accel_Vector[3]= {0,0,0}; //Store the acceleration in a vector
-float Gyro_Vector[3]= {0,0,0};//Store the gyros rutn rate in a vector
-float Omega_Vector[3]= {0,0,0}; //Corrected Gyro_Vector data
-float Omega_P[3]= {0,0,0};//Omega Proportional correction
-float Omega_I[3]= {0,0,0};//Omega Integrator
-float Omega[3]= {0,0,0};
+Vector3f Accel_Vector; //Store the acceleration in a vector
+Vector3f Gyro_Vector;  //Store the gyros rutn rate in a vector
+
+#if AHRS_FIXED == 1
+AP_AHRS_DCM<Fixed16> ahrs;
+#else
+AP_AHRS_DCM<float> ahrs;
+#endif
 
 // Euler angles
 float roll;
@@ -172,34 +180,12 @@ float yaw;
 
 int toggleMode=0;
 
-float errorRollPitch[3]= {0,0,0}; 
-float errorYaw[3]= {0,0,0};
-float errorCourse=180; 
 float COGX=0; //Course overground X axis
 float COGY=1; //Course overground Y axis
 
 unsigned int cycleCount=0;
 byte gyro_sat=0;
 
-float DCM_Matrix[3][3]= {
-  {
-    1,0,0  }
-  ,{
-    0,1,0  }
-  ,{
-    0,0,1  }
-}; 
-float Update_Matrix[3][3]={{0,1,2},{3,4,5},{6,7,8}}; //Gyros here
-
-float Temporary_Matrix[3][3]={
-  {
-    0,0,0  }
-  ,{
-    0,0,0  }
-  ,{
-    0,0,0  }
-};
- 
 // Startup GPS variables
 int gps_fix_count = 5;		//used to count 5 good fixes at ground startup
 
@@ -233,8 +219,6 @@ volatile uint8_t analog_count[8];
  int G_Dt_max = 0.0;                  //Max main loop cycle time in milliseconds
  byte gyro_sat_count = 0;
  byte adc_constraints = 0;
- byte renorm_sqrt_count = 0;
- byte renorm_blowup_count = 0;
  byte gps_messages_sent = 0;
  long perf_mon_timer = 0;
  #endif
@@ -257,6 +241,8 @@ volatile uint8_t analog_count[8];
 void setup()
 { 
   Serial.begin(38400, 128, 16);
+  ahrs.set_gains(Kp_ROLLPITCH, Ki_ROLLPITCH, Kp_YAW, Ki_YAW);
+  ahrs.set_gravity(GRAVITY);
   pinMode(SERIAL_MUX_PIN,OUTPUT); //Serial Mux
   if (GPS_CONNECTION == 0){
     digitalWrite(SERIAL_MUX_PIN,HIGH); //Serial Mux
@@ -379,7 +365,7 @@ void loop() //Main Loop
     #endif
 
     //Turn on the LED when you saturate any of the gyros.
-    if((abs(Gyro_Vector[0])>=ToRad(300))||(abs(Gyro_Vector[1])>=ToRad(300))||(abs(Gyro_Vector[2])>=ToRad(300)))
+    if((abs(Gyro_Vector.x)>=ToRad(300))||(abs(Gyro_Vector.y)>=ToRad(300))||(abs(Gyro_Vector.z)>=ToRad(300)))
     {
       gyro_sat=1;
 #if PERFORMANCE_REPORTING == 1
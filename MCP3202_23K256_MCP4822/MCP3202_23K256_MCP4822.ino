@@ -1,7 +1,9 @@
 #include <SPI.h>
+#include <TimerOne.h>
 #include "MCP320X.h"
 #include "SPISRAM.h"
 #include "MCP48X2.h"
+#include "DelayLine.h"
 
 MCP320X adc(10);
 /*
@@ -14,73 +16,52 @@ SPISRAM sram(SRAM_CS);
 const byte DAC_CS = 8;
 MCP48X2 dac(DAC_CS);
 
+DelayLine echo(adc, sram, dac);
+
 const word SAMPLE_SIZE = 32768;
+const long SAMPLE_PERIOD = 50;  // usec, 20 ksps
+const byte FREEZE_PIN = 7;      // hold low to loop the last SAMPLE_SIZE samples
+
+long lastReport;
+unsigned long idle;
+
 void setup() {
-  pinMode(7, OUTPUT);
-//  Serial.begin(38400);
+  pinMode(FREEZE_PIN, INPUT);
+  digitalWrite(FREEZE_PIN, HIGH);
+  Serial.begin(38400);
 
   SPI.begin();
   adc.begin();
   sram.begin();
   dac.begin();
+
+  echo.begin(adc.SINGLE_CH0, SAMPLE_SIZE);
+  echo.setDelay(10000);  // half a second
+  echo.start(SAMPLE_PERIOD);
+  lastReport = millis();
 }
 
 void loop() {
-  union {
-    byte b[2];
-    word w;
-  } 
-  val;
-  long intime, outtime;
-  word i;
-
-digitalWrite(7, HIGH);
-  intime = micros();
-  for(i = 0; i < SAMPLE_SIZE; ) {
-    adc.setupSPI();
-    val.w = adc.read8(adc.SINGLE_CH0);
-    sram.setupSPI();
-//    sram.write(i, (byte*)&val, 2);
-    sram[i++] = (byte) val.w;
-//    i += 2;
-    delayMicroseconds(32);
-  }
-  outtime = micros();
-digitalWrite(7, LOW);
+  echo.poll();
+  echo.record(digitalRead(FREEZE_PIN) == HIGH);
+  idle++;
 
-  delay(2000);
-  sram.setupSPI();
-  for(i = 0; i < SAMPLE_SIZE; ) {
-    /*
-    Serial.print(i);
-     Serial.print(": ");
-     */
-     val.w = sram[i++];
-//    val.b[0] = sram[i++];
-    //    val <<=8;
-//    val.b[1] = (sram[i++]);
-    /*
-    Serial.print(val.w, HEX);
-     Serial.print(" ");
-     Serial.print(val.w);
-     Serial.println();
-     */
-    dac.write12(val.w<<4);
-    delayMicroseconds(51);
-  }
-  /*
-  Serial.print(SAMPLE_SIZE);
-  Serial.print(" sample / ");
-  Serial.print(outtime - intime);
-  Serial.print(" usec, ");
-  Serial.print(1000L * SAMPLE_SIZE/(outtime - intime));
-  Serial.println(" ksps.");
-  */
-  delay(2000);
+  if (millis() - lastReport < 2000)
+    return;
+  lastReport = millis();
+  // bytes/sample is the SPI traffic of all three devices per tick
+  Serial.print(echo.ticks);
+  Serial.print(" samples, ");
+  Serial.print((float) echo.busBytes / echo.ticks, 2);
+  Serial.print(" bus bytes/sample, ");
+  Serial.print(echo.restarts);
+  Serial.print(" restarts, ");
+  Serial.print(echo.underruns);
+  Serial.print(" underruns, ");
+  Serial.print(echo.overruns);
+  Serial.print(" overruns, ");
+  Serial.print(idle);
+  Serial.println(" idle loops");
+  echo.resetCounters();
+  idle = 0;
 }
-
-
-
-
-
-
@@ -1,4 +1,5 @@
 #include "MindSet.h"
+#include <CRC.h>
 #include <Monitor.h>
 
 MindSet m3band(Serial);
@@ -1,4 +1,5 @@
 #include <OneWire.h>
+#include <CRC.h>
 #include <SerialMonitor.h>
 
 /*
@@ -1,4 +1,5 @@
 #include <OneWire.h>
+#include <CRC.h>
 #include <DS18B20.h>
 #include <SerialMonitor.h>
 /*
@@ -0,0 +1,164 @@
+/*
+ 10-18-2012
+ SparkFun Electronics 2012
+ 
+ This code is public domain but you buy me a beer if you use this and we meet someday (Beerware license).
+ 
+ Throughput and drop test for OpenLog. The Arduino plays the host UART: it streams numbered records at
+ full speed into a new log, sends the escape sequence and reads back how many bytes OpenLog recorded.
+ The results are then written to BENCH.TXT on the card through the command prompt.
+ 
+ Connect the following OpenLog to Arduino:
+   TXO of OpenLog to RX of the Arduino
+   RXI to TX
+   GRN to 2
+   VCC to 5V
+   GND to GND
+ 
+ NOTE: When uploading this example code you must temporarily disconnect TX and RX while uploading 
+ the new code to the Arduino. Otherwise you will get a "avrdude: stk500_getsync(): not in sync" error.
+ 
+ OpenLog must run at BENCH_BAUD in NewLog mode with verbose on and the default escape of three ctrl+z,
+ so that it powers up with '12<' and reports the bytes recorded when a log is closed (v3.14 and up, built
+ with HIGH_RATE_CAPTURE set to 1).
+ 
+ Each record is 64 bytes:
+ 
+ 0000123:abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ01
+ 
+ The record number makes it easy to find where characters were lost when the log is read back.
+ Set BURST_GAP_MS to pause between bursts so that OpenLog goes idle and sleeps in the middle of the log.
+ 
+ Recorded results look like this:
+ 
+ baud 115200
+ sent 1382400
+ recorded 1382403
+ dropped 0
+ bytes/s 11520
+ 
+ The escape characters are recorded with the log, so recorded is sent + 3 when nothing is lost.
+ */
+
+#define BENCH_BAUD    115200
+#define TEST_SECONDS  120 //How long to stream for
+#define BURST_SECONDS 10 //Stream this long between pauses
+#define BURST_GAP_MS  0 //Pause between bursts, 0 streams without a break
+
+#define ESCAPE_CHAR   26
+#define ESCAPE_COUNT  3
+
+int statLED = 13;
+int resetOpenLog = 2;
+
+char record[] = "0000000:abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ01\r\n";
+
+unsigned long bytesSent;
+unsigned long bytesRecorded;
+unsigned long testMillis;
+
+void setup() 
+{ 
+  pinMode(statLED, OUTPUT);
+  pinMode(resetOpenLog, OUTPUT);
+
+  Serial.begin(BENCH_BAUD);
+
+  //Reset OpenLog
+  digitalWrite(resetOpenLog, LOW);
+  delay(100);
+  digitalWrite(resetOpenLog, HIGH);
+
+  //Wait for OpenLog to respond with '<' to indicate it is alive and recording to a file
+  waitFor('<');
+
+  streamRecords();
+
+  //Close the log and pick up the number of bytes OpenLog reports before the '~'
+  sendEscape();
+  bytesRecorded = 0;
+  while(1) {
+    if(Serial.available()) {
+      char c = Serial.read();
+      if(c == '~') break;
+      if(c >= '0' && c <= '9') bytesRecorded = bytesRecorded * 10 + (c - '0');
+    }
+  }
+
+  //Write the results to their own file
+  waitFor('>');
+  Serial.print("new BENCH.TXT\r");
+  waitFor('>');
+  Serial.print("append BENCH.TXT\r");
+  waitFor('<');
+
+  unsigned long expected = bytesSent + ESCAPE_COUNT;
+  Serial.print("baud ");
+  Serial.println(BENCH_BAUD);
+  Serial.print("sent ");
+  Serial.println(bytesSent);
+  Serial.print("recorded ");
+  Serial.println(bytesRecorded);
+  Serial.print("dropped ");
+  Serial.println(expected > bytesRecorded ? expected - bytesRecorded : 0);
+  Serial.print("bytes/s ");
+  Serial.println(bytesSent * 1000 / testMillis);
+
+  sendEscape();
+  waitFor('~');
+} 
+
+void loop() 
+{ 
+  //Blink the Status LED because we're done!
+  digitalWrite(statLED, HIGH);
+  delay(100);
+  digitalWrite(statLED, LOW);
+  delay(1000);
+} 
+
+//Streams numbered records for TEST_SECONDS, not counting the pauses
+void streamRecords(void)
+{
+  unsigned long recordNumber = 0;
+  unsigned long burstStart = millis();
+
+  bytesSent = 0;
+  testMillis = 0;
+
+  while(testMillis < TEST_SECONDS * 1000UL) {
+    //Number the record, the string holds seven digits
+    unsigned long n = recordNumber++;
+    for(int i = 6 ; i >= 0 ; i--) {
+      record[i] = '0' + n % 10;
+      n /= 10;
+    }
+    Serial.write((const uint8_t *)record, sizeof(record) - 1);
+    bytesSent += sizeof(record) - 1;
+
+    if((recordNumber & 0x3F) == 0) digitalWrite(statLED, !digitalRead(statLED));
+
+    if(millis() - burstStart >= BURST_SECONDS * 1000UL) {
+      Serial.flush(); //Wait for the last record to go out
+      testMillis += millis() - burstStart;
+      if(BURST_GAP_MS > 0) delay(BURST_GAP_MS);
+      burstStart = millis();
+    }
+  }
+}
+
+void sendEscape(void)
+{
+  Serial.flush();
+  delay(10);
+  for(int i = 0 ; i < ESCAPE_COUNT ; i++)
+    Serial.write(ESCAPE_CHAR);
+}
+
+void waitFor(char c)
+{
+  while(1) {
+    if(Serial.available())
+      if(Serial.read() == c) break;
+  }
+}
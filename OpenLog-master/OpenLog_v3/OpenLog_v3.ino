@@ -139,6 +139,19 @@
  RAM is currently at 779 after 2 and 696 once we've begun append_file.
  Removal of strncmp(). I believe we used it to reduce flash footprint. Once migrated to PSTR, it makes it worse.
  
+ 
+ v3.14 High rate capture into preallocated files.
+ 
+ A new, empty log is now created as one contiguous file (CAPTURE_PREALLOCATE_MB) and recorded in whole 512 byte blocks.
+ The volume's cache block doubles as the capture block so no RAM is added. Characters move from the serial buffer into the
+ block in bulk, the escape characters are looked for over each bulk read with memchr, and every full block goes to the card
+ through a single open multi-block write. There are no FAT updates, and no directory updates while data keeps coming, so no
+ long sync stalls, until the escape sequence closes the log and cuts the file down to the bytes received. Logs appended to an existing file still use the regular
+ append loop. It is off by default, set HIGH_RATE_CAPTURE to 1 to use it. See OpenLog_Bench for a throughput and drop test.
+ 
+ Note that the directory entry of a captured log is only brought up to date when the data stops for a while and OpenLog goes
+ to sleep. After a power loss the file ends where the last idle period was, rather than at the last 5 second sync.
+ 
  */
 
 #include <SdFat.h> //We do not use the built-in SD.h file because it calls Serial.print
@@ -167,6 +180,16 @@ SerialPort<0, 780, 0> NewSerial;
 //#define RAM_TESTING  1 //On
 #define RAM_TESTING  0 //Off
 
+//High rate capture records new, empty logs block by block into a preallocated contiguous file. This keeps up with
+//115200bps where the regular append loop can stall on a file sync. (1) On, (0) use the regular append loop for every log
+#define HIGH_RATE_CAPTURE  0
+#define CAPTURE_PREALLOCATE_MB  64 //Space reserved for each captured log. Whatever is not used is freed when the log is closed
+
+//Results of capture_file
+#define CAPTURE_FAILED   0 //Could not preallocate, nothing was recorded
+#define CAPTURE_DONE     1 //Recorded up to the escape sequence
+#define CAPTURE_STOPPED  2 //Out of preallocated space or a block write failed, carry on with the regular append loop
+
 //#define Reset_AVR() wdt_enable(WDTO_1S); while(1) {} //Correct way of resetting the ATmega, but doesn't work with 
 //Arduino pre-Optiboot bootloader
 void(* Reset_AVR) (void) = 0; //Dirty way of resetting the ATmega, but it works for now
@@ -487,6 +510,14 @@ byte append_file(char* file_name)
   // O_WRITE - open for write
   if (!workingFile.open(&currentDirectory, file_name, O_CREAT | O_APPEND | O_WRITE)) systemError(ERROR_FILE_OPEN);
   if (workingFile.fileSize() == 0) {
+#if HIGH_RATE_CAPTURE
+    //An empty file can be preallocated and recorded the fast way
+    workingFile.close();
+    byte capture_result = capture_file(file_name);
+    if (capture_result == CAPTURE_DONE) return(1);
+    if (!workingFile.open(&currentDirectory, file_name, O_CREAT | O_APPEND | O_WRITE)) systemError(ERROR_FILE_OPEN);
+    if (capture_result == CAPTURE_STOPPED) return(append_loop(workingFile));
+#endif
     //This is a trick to make sure first cluster is allocated - found in Bill's example/beta code
     //workingFile.write((byte)0); //Leaves a NUL at the beginning of a file
     workingFile.rewind();
@@ -496,6 +527,12 @@ byte append_file(char* file_name)
   NewSerial.print(F("<")); //give a different prompt to indicate no echoing
   digitalWrite(statled1, HIGH); //Turn on indicator LED
 
+  return(append_loop(workingFile));
+}
+
+//Records characters to an open file until the escape sequence, then closes it
+byte append_loop(SdFile &workingFile)
+{
 #define LOCAL_BUFF_SIZE  32
   byte localBuffer[LOCAL_BUFF_SIZE];
   byte checkedSpot;
@@ -578,6 +615,149 @@ byte append_file(char* file_name)
   return(1); //Success!
 }
 
+#if HIGH_RATE_CAPTURE
+//Counts the escape characters through a bulk read, carrying the run over from the last read
+//Stops at the escape character that completes the sequence. Like append_loop, the whole read is still recorded
+void scan_escape(const byte* buffer, uint16_t n, byte* escape_chars_received)
+{
+  const byte* spot = buffer;
+  const byte* end = buffer + n;
+
+  while(spot < end) {
+    if(*spot != setting_escape_character) {
+      *escape_chars_received = 0;
+      spot = (const byte*)memchr(spot, setting_escape_character, end - spot); //Skip straight to the next escape character
+      if(spot == 0) return;
+    }
+    if(++*escape_chars_received == setting_max_escape_character) return;
+    spot++;
+  }
+}
+
+//Records a stream of serial data to a new, empty file in whole blocks
+//The file is preallocated as one contiguous run of blocks. The volume's cache block becomes the capture block:
+//the SerialPort interrupt buffers the incoming characters, they are moved into the block in bulk and every full
+//block is sent through one multi-block write that stays open while data keeps coming. Nothing in the FAT or the
+//directory changes until the data stops for a while, when the directory entry gets the length recorded so far, or until
+//the escape sequence, when the file is cut down to the bytes that made it onto the card.
+//The file is left closed on return
+byte capture_file(char* file_name)
+{
+  SdFile workingFile;
+  uint32_t bgnBlock, endBlock;
+
+  //createContiguous only makes new files
+  SdFile::remove(&currentDirectory, file_name);
+  if (!workingFile.createContiguous(&currentDirectory, file_name, CAPTURE_PREALLOCATE_MB * 1024UL * 1024UL)) return(CAPTURE_FAILED);
+  //Until the first idle period the directory entry shows an empty file instead of the preallocated size
+  if (!workingFile.contiguousRange(&bgnBlock, &endBlock) || !workingFile.setFileSize(0) || !workingFile.sync()) {
+    workingFile.remove();
+    return(CAPTURE_FAILED);
+  }
+  byte* captureBlock = (byte*)volume.cacheClear(); //The cache is not needed while we write blocks directly
+  if (captureBlock == 0) {
+    workingFile.remove();
+    return(CAPTURE_FAILED);
+  }
+
+  NewSerial.print(F("<")); //give a different prompt to indicate no echoing
+  digitalWrite(statled1, HIGH); //Turn on indicator LED
+
+  const uint16_t MAX_IDLE_TIME_MSEC = 500; //The number of milliseconds before unit goes to sleep
+  uint32_t lastReceiveTime = millis();
+  uint32_t block = bgnBlock; //The block being filled, every block before it has been written
+  uint16_t blockFill = 0;
+  boolean streaming = false; //True while a multi-block write is open on the card
+  boolean tailOnCard = false; //True if the partial block is on the card but could not be read back into captureBlock
+  byte escape_chars_received = 0;
+  byte result = CAPTURE_DONE;
+
+  printRam(); //Print the available RAM
+
+  //Start recording incoming characters
+  while(escape_chars_received < setting_max_escape_character) {
+
+    uint16_t n = NewSerial.read(captureBlock + blockFill, 512 - blockFill); //Move whatever has arrived straight into the block
+    if (n > 0)
+    {
+      scan_escape(captureBlock + blockFill, n, &escape_chars_received);
+      blockFill += n;
+      lastReceiveTime = millis();
+
+      if (blockFill == 512)
+      {
+        if (!streaming) streaming = card.writeStart(block, endBlock - block + 1);
+        if (!streaming || !card.writeData(captureBlock)) {
+          result = CAPTURE_STOPPED;
+          break;
+        }
+        blockFill = 0;
+
+        STAT1_PORT ^= (1<<STAT1); //Toggle the STAT1 LED each time we record a block
+
+        if (++block > endBlock) {
+          result = CAPTURE_STOPPED;
+          break;
+        }
+      }
+    }
+    //No characters recevied?
+    else if( (millis() - lastReceiveTime) > MAX_IDLE_TIME_MSEC) {
+      //Get the partial block onto the card before we go to sleep. It is written again once it fills.
+      if (streaming) card.writeStop();
+      streaming = false;
+      if (blockFill == 0 || card.writeBlock(block, captureBlock)) {
+        //Record the length so far in the directory entry, a power loss then only costs what comes after this point.
+        //The update goes through the cache, which is also captureBlock, so the partial block is read back afterwards.
+        workingFile.setFileSize((block - bgnBlock) * 512UL + blockFill);
+        workingFile.sync();
+        volume.cacheClear();
+        if (blockFill > 0 && !card.readBlock(block, captureBlock)) {
+          tailOnCard = true;
+          result = CAPTURE_STOPPED;
+          break;
+        }
+      }
+
+      STAT1_PORT &= ~(1<<STAT1); //Turn off stat LED to save power
+
+      power_timer0_disable(); //Shut down peripherals we don't need
+      power_spi_disable();
+      sleep_mode(); //Stop everything and go to sleep. Wake up if serial character received
+
+      power_spi_enable(); //After wake up, power up peripherals
+      power_timer0_enable();
+
+      escape_chars_received = 0; // Clear the esc flag as it has timed out
+      lastReceiveTime = millis();
+    }
+  }
+
+  if (streaming) card.writeStop();
+
+  //Only count what is on the card. A block writeData() gave up on gets one more try here.
+  uint32_t bytesRecorded = (block - bgnBlock) * 512UL;
+  if (blockFill > 0 && block <= endBlock && (tailOnCard || card.writeBlock(block, captureBlock))) bytesRecorded += blockFill;
+
+  //truncate only works down from the file size, so go back to the whole preallocation first
+  workingFile.setFileSize(CAPTURE_PREALLOCATE_MB * 1024UL * 1024UL);
+  workingFile.truncate(bytesRecorded); //Give back the blocks we did not use, this is the only FAT update
+  workingFile.close();
+
+  if (result == CAPTURE_STOPPED) return(result); //append_file carries on with the same prompt and LED
+
+  digitalWrite(statled1, LOW); // Turn off indicator LED
+
+  if (setting_verbose == ON) {
+    NewSerial.print(bytesRecorded);
+    NewSerial.print(F(" bytes"));
+  }
+  NewSerial.print(F("~")); // Indicate a successful record
+
+  return(result);
+}
+#endif
+
 //The following are system functions needed for basic operation
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
@@ -2289,4 +2469,4 @@ byte wildcmp(const char* wild, const char* string)
 
 //End wildcard functions
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-
+
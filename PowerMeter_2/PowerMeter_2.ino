@@ -6,6 +6,7 @@
 #include "CharacterLCD.h"
 #include "ST7032i.h"
 #include "M41T62.h"
+#include <WindowStats.h>
 
 LCD_ST7032i lcd;             // Number of lines and i2c address of the display
 M41T62 rtc;
@@ -13,6 +14,9 @@ M41T62 rtc;
 int a2history[12];
 unsigned int a2index = 0;
 
+StreamStats chan[3];
+unsigned long lastSample;
+
 void setup() { 
 
   Serial.begin(38400);
@@ -44,42 +48,29 @@ void setup() {
 }
 
 void loop() {
-  int a[3], base[3];
-  long sum[3];
-
   const int samples = 103;
-  int i;
-  sum[0] = 0; sum[1] = 0; sum[2] = 0;
-  for(i = 0; i < samples; i++) {
-    sum[0] += analogRead(0);
-    sum[1] += analogRead(1);
-    sum[2] += analogRead(2);    
-    delay(11);
+
+  // sample every 11 ms without blocking, mean absolute deviation is
+  // taken about the previous block's mean
+  if (millis() - lastSample < 11) return;
+  lastSample = millis();
+  for (int i = 0; i < 3; i++) {
+    chan[i].add(analogRead(i));
   }
-  
-  base[0] = sum[0] / samples;
-  base[1] = sum[1] / samples;
-  base[2] = sum[2] / samples;
-  
-  Serial.print(base[0]);
+  if (chan[0].count() < samples) return;
+
+  Serial.print(chan[0].mean());
   Serial.print(", ");
-  Serial.print(base[1]);
+  Serial.print(chan[1].mean());
   Serial.print(", ");
-  Serial.print(base[2]);
+  Serial.print(chan[2].mean());
   Serial.println();
 
-  sum[0] = 0; sum[1] = 0; sum[2] = 0;
-  for(i = 0; i < samples; i++) {
-    sum[0] += abs(analogRead(0) - base[0]);
-    sum[1] += abs(analogRead(1) - base[1]);
-    sum[2] += abs(analogRead(2) - base[2]);
-    delay(11);
-  }
-  Serial.print(sum[0]/(samples));
+  Serial.print(chan[0].meanAbsDev());
   Serial.print(", ");
-  Serial.print(sum[1]/(samples));
+  Serial.print(chan[1].meanAbsDev());
   Serial.print(", ");
-  Serial.print(sum[2]/(samples));
+  Serial.print(chan[2].meanAbsDev());
   Serial.println();
   Serial.println();
   
@@ -88,9 +79,11 @@ void loop() {
   lcd.setCursor(0,0);
   lcd.print(rtc.time, HEX);
   lcd.setCursor(0, 1);
-  lcd.print(sum[1]/(samples)); lcd.print(" ");
-  lcd.print(sum[2]/(samples)); lcd.print(" ");
-  delay(1000);
+  lcd.print(chan[1].meanAbsDev()); lcd.print(" ");
+  lcd.print(chan[2].meanAbsDev()); lcd.print(" ");
+  for (int i = 0; i < 3; i++) {
+    chan[i].restart();
+  }
 }
 
 
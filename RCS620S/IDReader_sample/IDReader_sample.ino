@@ -1,4 +1,5 @@
 #include "RCS620S.h"
+#include <CRC.h>
 #include "ISO14443.h"
 
 #define COMMAND_TIMEOUT 400
@@ -3,12 +3,23 @@
 //#include "Des.h"
 #include "TextStream.h"
 
+#include "KeyFile.h"
+
 #include "RecordBuffer.h"
 // On the Ethernet Shield, CS is pin 4. 
 const int chipSelect = 4;
 SDClass SD(chipSelect);
 
 const char * dbfname = "keys.dbn";
+// keys.dbn with a block index, looked up by type, division, PID and issue no.
+const char * kdbfname = "keys.kdb";
+// built under this name and renamed when complete, a reset while building
+// leaves no partial key file behind
+const char * tmpfname = "keys.tmp";
+const byte keyLength = 11;
+
+File kdbfile;
+KeyFile db;
 
 const byte	uni_key[8]  = { 
   0x7F, 0x48, 0xE5, 0xEC, 0x12, 0x0F, 0xE1, 0x9E}; 	/* defoult net_key */
@@ -30,35 +41,108 @@ void setup()
   SD.begin() || (Serial.println("Card initialization failed... may be not present") && halt() );
   Serial.println("card initialized.");
 
+  // rebuild a key file that is missing, unreadable or made from another keys.dbn
+  if ( !openKeyFile() || db.source() != sourceSize() ) {
+    if ( kdbfile ) 
+      kdbfile.close();
+    buildKeyFile();
+    if ( !openKeyFile() ) {
+      Serial.println("Failed to open key file.");
+      halt();
+    }
+  }
+  Serial.print(db.records());
+  Serial.println(" records.");
+  Serial.println("Type division, PID and issue no. of a Mifare card, e.g. S825418541");
+}
+
+boolean openKeyFile() {
+  kdbfile = SD.open(kdbfname);
+  return kdbfile && db.begin(kdbfile);
+}
+
+uint32_t sourceSize() {
   File dbfile = SD.open(dbfname);
-  if ( !dbfile ) Serial.println("Failed to open db file.");
+  if ( !dbfile ) 
+    return 0;
+  uint32_t size = dbfile.size();
+  dbfile.close();
+  return size;
+}
 
- char buf[512];
+// keys.dbn is kept in key order, a key file is built from it in one pass
+void buildKeyFile() {
+  File dbfile = SD.open(dbfname);
+  if ( !dbfile ) {
+    Serial.print("error opening ");
+    Serial.println(dbfname);
+    halt();
+  }
+  if ( SD.exists((char *) tmpfname) ) 
+    SD.remove((char *) tmpfname);
+  File kfile = SD.open(tmpfname, FILE_WRITE);
+  KeyFileBuilder builder(kfile, sizeof(RecordBuffer), 0, keyLength);
   RecordBuffer record;
 
-long swatch = millis();
-  if (dbfile) {
-    int cnt = 0;
-    while (dbfile.available()) {
-      dbfile.read(record.rawbytes, 32);
+  Serial.print("Building ");
+  Serial.print(kdbfname);
+  Serial.println("... ");
+  long swatch = millis();
+  long cnt = 0;
+  while (dbfile.available()) {
+    dbfile.read(record.rawbytes, 32);
+    if ( !builder.add(record.rawbytes) ) {
       Serial.print(cnt);
-      Serial.print(" ");
+      Serial.print(" out of order or duplicate: ");
       record.printOn(Serial);
-      cnt++;
+      kfile.close();
+      SD.remove((char *) tmpfname);
+      halt();
     }
-    dbfile.close();
-    Serial.println(millis() - swatch);
-    Serial.println("finished.");
-  }  
-  // if the file isn't open, pop up an error:
-  else {
-    Serial.print("error opening ");
-    Serial.println(dbfname);
-  } 
+    cnt++;
+  }
+  if ( !builder.finish(0, dbfile.size()) ) {
+    Serial.println("error writing key file");
+    halt();
+  }
+  dbfile.close();
+  kfile.close();
+  if ( SD.exists((char *) kdbfname) ) 
+    SD.remove((char *) kdbfname);
+  SD.rename((char *) tmpfname, (char *) kdbfname);
+  Serial.println(millis() - swatch);
+  Serial.println("finished.");
 }
 
 void loop()
 {
+  static char key[keyLength + 1] = { RecordBuffer::MIFARE };
+  static byte len = 1;
+  RecordBuffer record;
+
+  if ( !Serial.available() ) 
+    return;
+  char c = Serial.read();
+  if ( c != '\n' && c != '\r' ) {
+    if ( len < keyLength ) 
+      key[len++] = c;
+    return;
+  }
+  if ( len == 1 ) 
+    return;
+  while ( len < keyLength ) 
+    key[len++] = 0;
+
+  long swatch = micros();
+  boolean found = db.find(key, record.rawbytes);
+  swatch = micros() - swatch;
+  if ( found ) 
+    record.printOn(Serial);
+  else
+    Serial.println("not found.");
+  Serial.print(swatch);
+  Serial.println(" usec.");
+  len = 1;
 }
 
 boolean halt() {
@@ -3,6 +3,7 @@
 #include "Des.h"
 #include "TextStream.h"
 #include "SPISRAM.h"
+#include "KeyFile.h"
 
 
 #include "ICCardKey.h"
@@ -12,6 +13,9 @@ SDClass SD(SD_chipSelect);
 
 const char * datafname = "keys.txt";
 const char * dbfname = "keys.dbn";
+// key files for lookups, by type, division, PID and issue no. as in keys.txt, and by NFCID
+const char * pidfname = "cards.kdb";
+const char * nfcfname = "nfcid.kdb";
 
 const byte	uni_key[8]  = { 
   0x7F, 0x48, 0xE5, 0xEC, 0x12, 0x0F, 0xE1, 0x9E}; 	/* defoult net_key */
@@ -146,7 +150,33 @@ void setup()
     Serial.println(pos);
     sram.read(pos * 24, record.rawbytes, 24);
     record.printOn(Serial);
+    Serial.println();
+
+    // the records are in keys.txt order, sort them again for the NFCID file
+    buildKeyFile(pidfname, cnt, 0, 11);
+    Serial.println("Sorting by NFCID.");
+    swatch = millis();
+    sortRecords(cnt, 11, 8);
+    Serial.print(millis() - swatch);
+    Serial.println(" msec.");
+    buildKeyFile(nfcfname, cnt, 11, 8);
 
+    Serial.println("Search by NFCID in the key file.");
+    File nfcfile = SD.open(nfcfname);
+    KeyFile db;
+    if ( nfcfile && db.begin(nfcfile) ) {
+      ICCardKey found;
+      sram.read(cnt / 3 * 24, record.rawbytes, 24);
+      swatch = millis();
+      boolean hit = db.find(record.NFCID, found.rawbytes);
+      Serial.print(millis() - swatch);
+      Serial.println(" msec.");
+      if ( hit ) 
+        found.printOn(Serial);
+      else
+        Serial.println("not found!!!");
+    }
+    nfcfile.close();
   }  
   // if the file isn't open, pop up an error:
   else {
@@ -207,4 +237,53 @@ int bsearch(long limit, char id[]) {
   return -1;
 }
 
+// Writes the records in serial SRAM, which must be in key order, to a key file
+boolean buildKeyFile(const char * fname, long limit, byte keyOffset, byte keyLength) {
+  ICCardKey r;
+  Serial.print("Building ");
+  Serial.print(fname);
+  Serial.println(".");
+  long swatch = millis();
+  SD.remove((char *) fname);
+  File kfile = SD.open(fname, FILE_WRITE);
+  if ( !kfile ) {
+    Serial.println("Failed to open key file.");
+    return false;
+  }
+  KeyFileBuilder builder(kfile, sizeof(ICCardKey), keyOffset, keyLength);
+  for(long i = 0; i < limit; i++) {
+    sram.read(i * sizeof(ICCardKey), r.rawbytes, sizeof(ICCardKey));
+    if ( !builder.add(r.rawbytes) ) {
+      Serial.print(i);
+      Serial.print(" out of order or duplicate: ");
+      r.printOn(Serial);
+      kfile.close();
+      return false;
+    }
+  }
+  boolean result = builder.finish();
+  kfile.close();
+  Serial.print(millis() - swatch);
+  Serial.println(" msec.");
+  return result;
+}
 
+// Shell sort of the records in serial SRAM by the key at keyOffset
+void sortRecords(long limit, byte keyOffset, byte keyLength) {
+  ICCardKey a, b;
+  long gap = limit;
+  while ( gap > 1 ) {
+    gap = (gap < 5) ? 1 : gap * 5 / 11;
+    for(long i = gap; i < limit; i++) {
+      sram.read(i * sizeof(ICCardKey), a.rawbytes, sizeof(ICCardKey));
+      long j = i;
+      for( ; j >= gap; j -= gap) {
+        sram.read((j - gap) * sizeof(ICCardKey), b.rawbytes, sizeof(ICCardKey));
+        if ( memcmp(b.rawbytes + keyOffset, a.rawbytes + keyOffset, keyLength) <= 0 ) 
+          break;
+        sram.write(j * sizeof(ICCardKey), b.rawbytes, sizeof(ICCardKey));
+      }
+      sram.write(j * sizeof(ICCardKey), a.rawbytes, sizeof(ICCardKey));
+    }
+  }
+}
@@ -34,23 +34,23 @@ void printdata(void)
       #endif
       /*#if PRINT_DCM == 1
       Serial.print (",DCM:");
-      Serial.print(convert_to_dec(DCM_Matrix[0][0]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().a.x)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[0][1]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().a.y)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[0][2]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().a.z)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[1][0]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().b.x)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[1][1]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().b.y)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[1][2]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().b.z)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[2][0]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().c.x)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[2][1]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().c.y)));
       Serial.print (",");
-      Serial.print(convert_to_dec(DCM_Matrix[2][2]));
+      Serial.print(convert_to_dec(to_float(ahrs.get_dcm_matrix().c.z)));
       #endif*/
       Serial.print("\r\n");
       
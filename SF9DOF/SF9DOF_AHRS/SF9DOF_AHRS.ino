@@ -32,6 +32,8 @@
 // This code works also on ATMega168 Hardware
 
 #include <Wire.h>
+#include <AP_Math.h>
+#include <AP_AHRS.h>
 
 // ADXL345 Sensitivity(from datasheet) => 4mg/LSB   1G => 1000mg/4mg = 256 steps
 // Tested value : 248
@@ -60,6 +62,9 @@
 //OUTPUTMODE=0 will print uncorrected data of the gyros (with drift)
 #define OUTPUTMODE 1
 
+// 1 runs the DCM in Q16.16 fixed point, 0 in float
+#define AHRS_FIXED 0
+
 //#define PRINT_DCM 0     //Will print the whole direction cosine matrix
 #define PRINT_ANALOGS 0 //Will print the analog raw data
 #define PRINT_EULER 1   //Will print the Euler angles Roll, Pitch and Yaw
@@ -91,58 +96,22 @@ int magnetom_y;
 int magnetom_z;
 float MAG_Heading;
 
-float Accel_Vector[3]= {
-  0,0,0}; //Store the acceleration in a vector
-float Gyro_Vector[3]= {
-  0,0,0};//Store the gyros turn rate in a vector
-float Omega_Vector[3]= {
-  0,0,0}; //Corrected Gyro_Vector data
-float Omega_P[3]= {
-  0,0,0};//Omega Proportional correction
-float Omega_I[3]= {
-  0,0,0};//Omega Integrator
-float Omega[3]= {
-  0,0,0};
+Vector3f Accel_Vector; //Store the acceleration in a vector
+Vector3f Gyro_Vector;  //Store the gyros turn rate in a vector
 
 // Euler angles
 float roll;
 float pitch;
 float yaw;
 
-float errorRollPitch[3]= {
-  0,0,0}; 
-float errorYaw[3]= {
-  0,0,0};
-
 unsigned int counter=0;
 byte gyro_sat=0;
 
-float DCM_Matrix[3][3]= {
-  {
-    1,0,0    }
-  ,{
-    0,1,0    }
-  ,{
-    0,0,1    }
-}; 
-float Update_Matrix[3][3]={
-  {
-    0,1,2  }
-  ,{
-    3,4,5  }
-  ,{
-    6,7,8  }
-}; //Gyros here
-
-
-float Temporary_Matrix[3][3]={
-  {
-    0,0,0    }
-  ,{
-    0,0,0    }
-  ,{
-    0,0,0    }
-};
+#if AHRS_FIXED == 1
+AP_AHRS_DCM<Fixed16> ahrs;
+#else
+AP_AHRS_DCM<float> ahrs;
+#endif
 
 //ADC variables
 volatile uint8_t MuxSel=0;
@@ -165,6 +134,9 @@ void setup()
 
   Serial.println("Sparkfun 9DOF Razor AHRS");
 
+  ahrs.set_gains(Kp_ROLLPITCH, Ki_ROLLPITCH, Kp_YAW, Ki_YAW);
+  ahrs.set_gravity(GRAVITY);
+
   digitalWrite(STATUS_LED,LOW);
   delay(1500);
 
@@ -240,7 +212,7 @@ void loop() //Main Loop
     }
 
     //Turn off the LED when you saturate any of the gyros.
-    if((abs(Gyro_Vector[0])>=ToRad(300))||(abs(Gyro_Vector[1])>=ToRad(300))||(abs(Gyro_Vector[2])>=ToRad(300)))
+    if((abs(Gyro_Vector.x)>=ToRad(300))||(abs(Gyro_Vector.y)>=ToRad(300))||(abs(Gyro_Vector.z)>=ToRad(300)))
     {
       if (gyro_sat<50)
         gyro_sat+=10;
@@ -1,3 +1,5 @@
+#include <Sort.h>
+
 struct string {
   const static int LimitLength = 64;
 
@@ -33,6 +35,8 @@ struct string {
 } 
 myInput, inputcopy;
 
+char scratch[string::LimitLength / 2];
+
 void setup() {
   Serial.begin(9600);
   Serial.println("Ready.");
@@ -63,7 +67,8 @@ void loop() {
     Serial.println(" elements:");
     //
     stopwatch = micros();
-    SelectionSort(myInput.str, myInput.length);
+    // largest first, as before
+    introSort(myInput.str, myInput.length, Greater<char>());
     stopwatch = micros() - stopwatch;
     //
     Serial.println();
@@ -75,7 +80,7 @@ void loop() {
     Serial.println();
     //
     stopwatch = micros();
-    BubbleSort(inputcopy.str, myInput.length);
+    mergeSort(inputcopy.str, myInput.length, scratch, Greater<char>());
     stopwatch = micros() - stopwatch;
     //
     Serial.println();
@@ -90,37 +95,3 @@ void loop() {
     myInput.initialize();
   }
 }
-
-void SelectionSort(char array[], int size) {
-  int i, j;
-  char tmp;
-
-  for (j = 0; j < size-1; j++) {
-    for (i = j; i < size; i++) {
-      tmp = array[i];
-      if ( tmp > array[j] ) {
-        array[i] = array[j];
-        array[j] = tmp;
-      }
-    }
-  }
-}
-
-void BubbleSort(char array[], int n) {
-  int i, j;
-  char tmp;
-
-  for (i = 0; i+1 < n; i++) {
-    for (j = 0; j+1 < n; j++) {
-      if ( array[j+1] > array[j] ) {
-        tmp = array[j];
-        array[j] = array[j+1];
-        array[j+1] = tmp;
-      }
-    }
-  }
-}
-
-
-
-
@@ -108,6 +108,13 @@ char eliminateCompileErrors = 1;  // fix to suppress arduino build errors
 // this makes the "pinmode" command obsolete, as it gets set internally.
 #define kAutoConf 1
 
+// this compiles each expression of a running program to bytecode the
+// first time it is evaluated, and runs the bytecode from then on.
+// the code is kept in the free program ram, so it adds no ram usage.
+// it adds 1.5k of usage as well.
+#define ENABLE_BYTECODE 1
+//#undef ENABLE_BYTECODE
+
 ////////////////////////////////////////////////////////////////////////////////
 #if ARDUINO
 // includes, and settings for Arduino-specific functionality
@@ -135,6 +142,14 @@ SoftwareSerial ssSerial( kSS_RX, kSS_TX );
 #define kRamSize   512 
 //255
 
+// lines of the line number index, and entries of the jump target cache
+#define kLineIndexSize  16
+#define kJumpCacheSize  4
+
+// compiled expressions kept, and the deepest bytecode evaluation stack
+#define kBytecodeSlots  16
+#define kBytecodeStack  8
+
 // for file writing
 #if ENABLE_FILEIO
 File fp;
@@ -144,15 +159,45 @@ File fp;
 #else
 // Not arduino setup
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// build with:  g++ -x c++ -DFORCE_DESKTOP TinyBasicPlus.ino -o tinybasic
+// and feed it a program:  ./tinybasic < benchmark.bas
+// the desktop build has no files or tones
+// add -DTEXT_ONLY to compare against the text interpreter alone
+#undef ENABLE_FILEIO
+#undef ENABLE_TONES
+#ifdef TEXT_ONLY
+#undef ENABLE_BYTECODE
+#endif
 
 // size of our program ram
 #define kRamSize   4096
 
-#if ENABLE_FILEIO
-FILE * fp;
-// functions defined elsehwere
-void cmd_Files( void );
-#endif
+// lines of the line number index, and entries of the jump target cache
+#define kLineIndexSize  64
+#define kJumpCacheSize  8
+
+// compiled expressions kept, and the deepest bytecode evaluation stack
+#define kBytecodeSlots  128
+#define kBytecodeStack  16
+
+// the Arduino bits used by the interpreter
+#define PROGMEM
+#define pgm_read_byte( p ) (*(const unsigned char *)(p))
+typedef unsigned char prog_uchar;
+#define INPUT 0
+#define OUTPUT 1
+static void pinMode( int pin, int mode ) {}
+static int analogRead( int pin ) { return 0; }
+static int digitalRead( int pin ) { return 0; }
+static long random( long howbig ) { return howbig > 0 ? rand() % howbig : 0; }
+static void randomSeed( unsigned int seed ) { srand( seed ); }
+
+// statements executed by RUN, reported when it ends
+static unsigned long statements;
+static clock_t run_started;
 
 #ifndef boolean 
 #define boolean int
@@ -198,12 +243,22 @@ typedef short unsigned LINENUM;
 
 
 static unsigned char program[kRamSize];
+static unsigned short line_index[kLineIndexSize]; // offsets of every line_index_stride'th line
+static unsigned char line_index_count;
+static unsigned char line_index_stride;
+static boolean line_index_valid = false;
+static struct {
+  LINENUM linenum;
+  unsigned char *line;
+} jump_cache[kJumpCacheSize];                   // recent findline() results
 static unsigned char *txtpos,*list_line;
 static unsigned char expression_error;
 static unsigned char *tempsp;
 
 /***********************************************************/
 // Keyword table and constants - the last character has 0x80 added to it
+// In stored lines the statement keywords are replaced by KW_TOKEN + their
+// index in the table.
 static prog_uchar /* unsigned char*/ keywords[] PROGMEM = {
   'L','I','S','T'+0x80,
   'L','O','A','D'+0x80,
@@ -263,6 +318,7 @@ enum {
   KW_TONEW, KW_TONE, KW_NOTONE,
   KW_DEFAULT /* always the final one*/
 };
+#define KW_TOKEN 0x80
 
 struct stack_for_frame {
   char frame_type;
@@ -383,6 +439,7 @@ static int inchar(void);
 static void outchar(unsigned char c);
 static void line_terminator(void);
 static short int expression(void);
+static short int expr1(void);
 static unsigned char breakcheck(void);
 /***************************************************************************/
 static void ignore_blanks(void)
@@ -596,20 +653,180 @@ static void getln(char prompt)
 }
 
 /***************************************************************************/
-static unsigned char *findline(void)
+// Forget the line index and the cached jump targets, the program has changed
+static void program_changed(void)
 {
-  unsigned char *line = program_start;
-  while(1)
+  unsigned char i;
+
+  line_index_valid = false;
+  for(i = 0; i < kJumpCacheSize; i++)
+    jump_cache[i].line = NULL;
+}
+
+/***************************************************************************/
+// Index every line, or every few lines when there are more lines than entries
+static void build_line_index(void)
+{
+  unsigned char *line;
+  unsigned int lines = 0;
+
+  for(line = program_start; line != program_end; line += line[sizeof(LINENUM)])
+    lines++;
+  line_index_stride = (lines + kLineIndexSize - 1) / kLineIndexSize;
+  if(line_index_stride == 0)
+    line_index_stride = 1;
+
+  line_index_count = 0;
+  lines = 0;
+  for(line = program_start; line != program_end; line += line[sizeof(LINENUM)])
   {
-    if(line == program_end)
-      return line;
+    if(lines++ % line_index_stride == 0)
+      line_index[line_index_count++] = line - program_start;
+  }
+  line_index_valid = true;
+}
+
+/***************************************************************************/
+// The first line numbered linenum or above, or program_end
+static unsigned char *findline(void)
+{
+  unsigned char *line;
+  unsigned char low, high, middle;
+  unsigned char slot = linenum % kJumpCacheSize;
 
-    if(((LINENUM *)line)[0] >= linenum)
-      return line;
+  if(jump_cache[slot].line != NULL && jump_cache[slot].linenum == linenum)
+    return jump_cache[slot].line;
 
+  if(!line_index_valid)
+    build_line_index();
+
+  // Find the last indexed line before linenum
+  low = 0;
+  high = line_index_count;
+  while(low < high)
+  {
+    middle = (low + high) / 2;
+    if(((LINENUM *)(program_start + line_index[middle]))[0] < linenum)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  line = low ? program_start + line_index[low - 1] : program_start;
+
+  // and walk the few lines from there
+  while(line != program_end && ((LINENUM *)line)[0] < linenum)
+  {
     // Add the line length onto the current address, to get to the next line;
     line += line[sizeof(LINENUM)];
   }
+
+  jump_cache[slot].linenum = linenum;
+  jump_cache[slot].line = line;
+  return line;
+}
+
+/***************************************************************************/
+// Length of the keyword at s, and its index in table_index, or 0
+static unsigned char keyword_length(unsigned char *s)
+{
+  prog_uchar *table = keywords;
+  unsigned char i = 0;
+
+  table_index = 0;
+  while(pgm_read_byte(table) != 0)
+  {
+    if(s[i] == pgm_read_byte(table))
+    {
+      i++;
+      table++;
+    }
+    else if(s[i] + 0x80 == pgm_read_byte(table))
+      return i + 1;
+    else
+    {
+      // Forward to the first character of the next word
+      while((pgm_read_byte(table) & 0x80) == 0)
+        table++;
+      table++;
+      table_index++;
+      i = 0;
+    }
+  }
+  return 0;
+}
+
+/***************************************************************************/
+// Replace the statement keywords of an entered line by tokens, in place.
+// Statements start the line, follow a ':' and follow an IF condition,
+// where only variables, numbers and function names appear, so the first
+// keyword found after IF starts its statement.  Blanks, strings and
+// comments are kept as typed so that LIST shows the line unchanged.
+static void tokenize(unsigned char *from)
+{
+  unsigned char *to = from;
+  unsigned char statement = 1;
+  unsigned char in_if = 0;
+  unsigned char quote = 0;
+  unsigned char prev = SPACE;
+  unsigned char length;
+
+  while(*from != NL)
+  {
+    if(quote == 0 && *from != SPACE && *from != TAB &&
+       (statement || (in_if && (prev < 'A' || prev > 'Z'))))
+    {
+      length = keyword_length(from);
+      if(length > 0)
+      {
+        prev = from[length - 1];
+        from += length;
+        *to++ = KW_TOKEN + table_index;
+        statement = 0;
+        in_if = (table_index == KW_IF);
+        if(table_index == KW_REM || table_index == KW_QUOTE)
+        {
+          // the rest is a comment
+          while(*from != NL)
+            *to++ = *from++;
+        }
+        continue;
+      }
+      statement = 0;
+    }
+
+    if(*from == quote)
+      quote = 0;
+    else if(quote == 0 && (*from == '"' || *from == '\''))
+      quote = *from;
+    else if(quote == 0 && *from == ':')
+    {
+      statement = 1;
+      in_if = 0;
+    }
+    prev = *from;
+    *to++ = *from++;
+  }
+  *to = NL;
+}
+
+/***************************************************************************/
+// Print the keyword for a token
+static void printkeyword(unsigned char token)
+{
+  prog_uchar *table = keywords;
+  unsigned char c;
+
+  for(token -= KW_TOKEN; token > 0; token--)
+  {
+    while((pgm_read_byte(table) & 0x80) == 0)
+      table++;
+    table++;
+  }
+  do {
+    c = pgm_read_byte(table++);
+    outchar(c & 0x7f);
+  }
+  while((c & 0x80) == 0);
 }
 
 /***************************************************************************/
@@ -644,13 +861,45 @@ void printline()
   outchar(' ');
   while(*list_line != NL)
   {
-    outchar(*list_line);
+    if(*list_line >= KW_TOKEN)
+      printkeyword(*list_line);
+    else
+      outchar(*list_line);
     list_line++;
   }
   list_line++;
   line_terminator();
 }
 
+/***************************************************************************/
+static short int function(unsigned char f, short int a)
+{
+  switch(f)
+  {
+  case FUNC_PEEK:
+    return program[a];
+  case FUNC_ABS:
+    if(a < 0) 
+      return -a;
+    return a;
+
+  case FUNC_AREAD:
+#ifdef kAutoConf
+    pinMode( a, INPUT );
+#endif
+    return analogRead( a );                        
+  case FUNC_DREAD:
+#ifdef kAutoConf
+    pinMode( a, INPUT );
+#endif
+    return digitalRead( a );
+
+  case FUNC_RND:
+    return( random( a ));
+  }
+  return 0;
+}
+
 /***************************************************************************/
 static short int expr4(void)
 {
@@ -704,40 +953,18 @@ static short int expr4(void)
       goto expr4_error;
 
     txtpos++;
-    a = expression();
+    a = expr1();
     if(*txtpos != ')')
       goto expr4_error;
     txtpos++;
-    switch(f)
-    {
-    case FUNC_PEEK:
-      return program[a];
-    case FUNC_ABS:
-      if(a < 0) 
-        return -a;
-      return a;
-
-    case FUNC_AREAD:
-#ifdef kAutoConf
-      pinMode( a, INPUT );
-#endif
-      return analogRead( a );                        
-    case FUNC_DREAD:
-#ifdef kAutoConf
-      pinMode( a, INPUT );
-#endif
-      return digitalRead( a );
-
-    case FUNC_RND:
-      return( random( a ));
-    }
+    return function(f, a);
   }
 
   if(*txtpos == '(')
   {
     short int a;
     txtpos++;
-    a = expression();
+    a = expr1();
     if(*txtpos != ')')
       goto expr4_error;
 
@@ -811,7 +1038,7 @@ static short int expr2(void)
   }
 }
 /***************************************************************************/
-static short int expression(void)
+static short int expr1(void)
 {
   short int a,b;
 
@@ -855,6 +1082,438 @@ static short int expression(void)
   return 0;
 }
 
+#if ENABLE_BYTECODE
+/***************************************************************************/
+// Expression bytecode
+//
+// While a program runs, each expression is compiled into a small stack
+// code the first time it is evaluated, with constants folded and variables
+// resolved to their slots.  The code goes in the free ram between the
+// program and the variables, behind a table that finds it by the offset
+// of the expression text:
+//
+//   table:  kBytecodeSlots offsets of entries, 0 when unused
+//   entry:  text offset, offset of the text that follows, code, OP_END
+//
+// Everything is dropped at the prompt, where the free ram holds the input
+// line, so an edited program always starts again from its text.  When the
+// ram or the table is full the remaining expressions are parsed as text.
+
+enum {
+  OP_END = 0,
+  OP_CONST,           // followed by the value, low byte first
+  OP_VAR,             // followed by the variable number
+  OP_NEG, OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+  OP_GE, OP_NE, OP_GT, OP_EQ, OP_LE, OP_LT,
+  OP_FUNC             // OP_FUNC + FUNC_PEEK ... FUNC_RND
+};
+
+// relop table index to opcode
+static const unsigned char relop_ops[] = {
+  OP_GE, OP_NE, OP_GT, OP_EQ, OP_LE, OP_LT, OP_NE
+};
+
+static boolean code_ready = false;
+static boolean code_full;
+static unsigned char *code_table;
+static unsigned char *code_end;
+static unsigned char *code_limit;
+static unsigned char compile_error;
+static unsigned char code_depth, code_max_depth;
+
+static unsigned short get16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static void put16(unsigned char *p, unsigned short v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+/***************************************************************************/
+static void emit(unsigned char op)
+{
+  if(code_end >= code_limit)
+  {
+    code_full = true;
+    compile_error = 1;
+    return;
+  }
+  *code_end++ = op;
+
+  if(op == OP_CONST || op == OP_VAR)
+  {
+    if(++code_depth > code_max_depth)
+      code_max_depth = code_depth;
+  }
+  else if(op >= OP_ADD && op <= OP_LT)
+    code_depth--;
+}
+
+static void emit_const(short int value)
+{
+  emit(OP_CONST);
+  emit(value & 0xff);
+  emit((unsigned short)value >> 8);
+}
+
+/***************************************************************************/
+// Emit a binary operation, or fold it when both operands are constants.
+// Each operand is a lone OP_CONST when constant, the left one at left and
+// the right one at right.
+static unsigned char emit_binary(unsigned char op, unsigned char *left, unsigned char *right,
+                                 unsigned char lconst, unsigned char rconst)
+{
+  short int a, b;
+
+  if(lconst && rconst && !compile_error)
+  {
+    a = get16(left + 1);
+    b = get16(right + 1);
+    if(op != OP_DIV || b != 0)
+    {
+      switch(op)
+      {
+      case OP_ADD: a += b; break;
+      case OP_SUB: a -= b; break;
+      case OP_MUL: a *= b; break;
+      case OP_DIV: a /= b; break;
+      case OP_GE:  a = a >= b; break;
+      case OP_NE:  a = a != b; break;
+      case OP_GT:  a = a > b; break;
+      case OP_EQ:  a = a == b; break;
+      case OP_LE:  a = a <= b; break;
+      case OP_LT:  a = a < b; break;
+      }
+      code_end = left;
+      code_depth -= 2;
+      emit_const(a);
+      return 1;
+    }
+  }
+  emit(op);
+  return 0;
+}
+
+/***************************************************************************/
+// The compile_ functions follow expr1() to expr4() step for step, so that
+// they accept the same text and stop at the same place.  Each returns 1
+// when its code is a single constant.
+static unsigned char compile_expr1(void);
+
+static unsigned char compile_expr4(void)
+{
+  unsigned char *start = code_end;
+
+  ignore_blanks();
+
+  if( *txtpos == '-' ) {
+    txtpos++;
+    if(compile_expr4() && !compile_error)
+    {
+      short int a = get16(start + 1);
+      code_end = start;
+      code_depth--;
+      emit_const(-a);
+      return 1;
+    }
+    emit(OP_NEG);
+    return 0;
+  }
+
+  if(*txtpos == '0')
+  {
+    txtpos++;
+    emit_const(0);
+    return 1;
+  }
+
+  if(*txtpos >= '1' && *txtpos <= '9')
+  {
+    short int a = 0;
+    do 	{
+      a = a*10 + *txtpos - '0';
+      txtpos++;
+    } 
+    while(*txtpos >= '0' && *txtpos <= '9');
+    emit_const(a);
+    return 1;
+  }
+
+  if(txtpos[0] >= 'A' && txtpos[0] <= 'Z')
+  {
+    // variable reference
+    if(txtpos[1] < 'A' || txtpos[1] > 'Z')
+    {
+      emit(OP_VAR);
+      emit(*txtpos - 'A');
+      txtpos++;
+      return 0;
+    }
+
+    // function with a single parameter
+    scantable(func_tab);
+    if(table_index == FUNC_UNKNOWN)
+      goto compile_expr4_error;
+
+    unsigned char f = table_index;
+
+    if(*txtpos != '(')
+      goto compile_expr4_error;
+    txtpos++;
+    compile_expr1();
+    if(*txtpos != ')')
+      goto compile_expr4_error;
+    txtpos++;
+    emit(OP_FUNC + f);
+    return 0;
+  }
+
+  if(*txtpos == '(')
+  {
+    unsigned char constant;
+    txtpos++;
+    constant = compile_expr1();
+    if(*txtpos != ')')
+      goto compile_expr4_error;
+    txtpos++;
+    return constant;
+  }
+
+compile_expr4_error:
+  compile_error = 1;
+  return 0;
+}
+
+static unsigned char compile_expr3(void)
+{
+  unsigned char *start = code_end, *right;
+  unsigned char constant, op;
+
+  constant = compile_expr4();
+
+  ignore_blanks();
+
+  while(*txtpos == '*' || *txtpos == '/')
+  {
+    op = *txtpos == '*' ? OP_MUL : OP_DIV;
+    txtpos++;
+    right = code_end;
+    constant = emit_binary(op, start, right, constant, compile_expr4());
+  }
+  return constant;
+}
+
+static unsigned char compile_expr2(void)
+{
+  unsigned char *start = code_end, *right;
+  unsigned char constant, op;
+
+  if(*txtpos == '-' || *txtpos == '+')
+  {
+    emit_const(0);
+    constant = 1;
+  }
+  else
+    constant = compile_expr3();
+
+  while(*txtpos == '-' || *txtpos == '+')
+  {
+    op = *txtpos == '-' ? OP_SUB : OP_ADD;
+    txtpos++;
+    right = code_end;
+    constant = emit_binary(op, start, right, constant, compile_expr3());
+  }
+  return constant;
+}
+
+static unsigned char compile_expr1(void)
+{
+  unsigned char *start = code_end, *right;
+  unsigned char constant;
+
+  constant = compile_expr2();
+
+  if(compile_error)
+    return 0;
+
+  scantable(relop_tab);
+  if(table_index == RELOP_UNKNOWN)
+    return constant;
+
+  right = code_end;
+  return emit_binary(relop_ops[table_index], start, right, constant, compile_expr2());
+}
+
+/***************************************************************************/
+// Set up the table in the free ram, false when there is no room
+static boolean code_init(void)
+{
+  unsigned int i;
+
+  code_ready = true;
+  code_table = program_end;
+  code_end = code_table + kBytecodeSlots * sizeof(unsigned short);
+  // keep a line's worth free below the variables, as getln() does
+  code_limit = variables_begin - 2;
+  code_full = code_end >= code_limit;
+  if(code_full)
+    return false;
+
+  for(i = 0; i < kBytecodeSlots * sizeof(unsigned short); i++)
+    code_table[i] = 0;
+  return true;
+}
+
+/***************************************************************************/
+// The entry for the expression at txtpos, compiled if need be, or NULL
+static unsigned char *find_code(void)
+{
+  unsigned short offset = txtpos - program;
+  unsigned short slot = offset % kBytecodeSlots;
+  unsigned short entry = 0;
+  unsigned short i;
+  unsigned char *saved;
+
+  if(!code_ready && !code_init())
+    return NULL;
+
+  for(i = 0; i < kBytecodeSlots; i++)
+  {
+    entry = get16(code_table + slot * sizeof(unsigned short));
+    if(entry == 0)
+      break;
+    if(get16(program + entry) == offset)
+      return program + entry;
+    slot = (slot + 1) % kBytecodeSlots;
+  }
+  if(entry != 0 || code_full)
+    return NULL;
+
+  // Compile it
+  saved = txtpos;
+  entry = code_end - program;
+  code_end += 2 * sizeof(unsigned short);
+  compile_error = 0;
+  code_depth = 0;
+  code_max_depth = 0;
+  if(code_end < code_limit)
+  {
+    compile_expr1();
+    emit(OP_END);
+  }
+  else
+    code_full = true;
+
+  if(code_full || compile_error || code_max_depth > kBytecodeStack)
+  {
+    // leave it to the text interpreter, which reports any error
+    code_end = program + entry;
+    txtpos = saved;
+    return NULL;
+  }
+  put16(program + entry, offset);
+  put16(program + entry + sizeof(unsigned short), txtpos - program);
+  put16(code_table + slot * sizeof(unsigned short), entry);
+  txtpos = saved;
+  return program + entry;
+}
+
+/***************************************************************************/
+// Run an entry and move txtpos past its expression
+static short int run_code(unsigned char *code)
+{
+  short int stack[kBytecodeStack];
+  short int *top = stack - 1;
+  short int b;
+
+  txtpos = program + get16(code + sizeof(unsigned short));
+  code += 2 * sizeof(unsigned short);
+
+  while(1)
+  {
+    switch(*code++)
+    {
+    case OP_END:
+      return *top;
+    case OP_CONST:
+      *++top = get16(code);
+      code += 2;
+      break;
+    case OP_VAR:
+      *++top = ((short int *)variables_begin)[*code++];
+      break;
+    case OP_NEG:
+      *top = -*top;
+      break;
+    case OP_ADD:
+      b = *top--;
+      *top += b;
+      break;
+    case OP_SUB:
+      b = *top--;
+      *top -= b;
+      break;
+    case OP_MUL:
+      b = *top--;
+      *top *= b;
+      break;
+    case OP_DIV:
+      b = *top--;
+      if(b != 0)
+        *top /= b;
+      else
+        expression_error = 1;
+      break;
+    case OP_GE:
+      b = *top--;
+      *top = *top >= b;
+      break;
+    case OP_NE:
+      b = *top--;
+      *top = *top != b;
+      break;
+    case OP_GT:
+      b = *top--;
+      *top = *top > b;
+      break;
+    case OP_EQ:
+      b = *top--;
+      *top = *top == b;
+      break;
+    case OP_LE:
+      b = *top--;
+      *top = *top <= b;
+      break;
+    case OP_LT:
+      b = *top--;
+      *top = *top < b;
+      break;
+    default:
+      *top = function(code[-1] - OP_FUNC, *top);
+      break;
+    }
+  }
+}
+#endif
+
+/***************************************************************************/
+static short int expression(void)
+{
+#if ENABLE_BYTECODE
+  // only program lines are compiled, direct commands are in the free ram
+  if(txtpos >= program_start && txtpos < program_end)
+  {
+    unsigned char *code = find_code();
+    if(code != NULL)
+      return run_code(code);
+  }
+#endif
+  return expr1();
+}
+
 /***************************************************************************/
 void loop()
 {
@@ -885,6 +1544,12 @@ warmstart:
   printmsg(okmsg);
 
 prompt:
+  // back in direct mode, also after an error stopped a program
+  current_line = 0;
+#if ENABLE_BYTECODE
+  // the free ram is about to hold the input line
+  code_ready = false;
+#endif
   if( triggerRun ){
     triggerRun = false;
     current_line = program_start;
@@ -924,6 +1589,8 @@ prompt:
   if(linenum == 0xFFFF)
     goto qhow;
 
+  tokenize(txtpos);
+
   // Find the length of what is left, including the (yet-to-be-populated) line header
   linelen = 0;
   while(txtpos[linelen] != NL)
@@ -939,6 +1606,7 @@ prompt:
 
   // Merge it into the rest of the program
   start = findline();
+  program_changed();
 
   // If a line with that number exists, then remove it
   if(start != program_end && *((LINENUM *)start) == linenum)
@@ -1049,7 +1717,18 @@ interperateAtTxtpos:
     goto warmstart;
   }
 
-  scantable(keywords);
+#if !ARDUINO
+  statements++;
+#endif
+
+  if(*txtpos >= KW_TOKEN)
+  {
+    table_index = *txtpos - KW_TOKEN;
+    txtpos++;
+    ignore_blanks();
+  }
+  else
+    scantable(keywords);
 
   switch(table_index)
   {
@@ -1079,8 +1758,13 @@ interperateAtTxtpos:
     if(txtpos[0] != NL)
       goto qwhat;
     program_end = program_start;
+    program_changed();
     goto prompt;
   case KW_RUN:
+#if !ARDUINO
+    statements = 0;
+    run_started = clock();
+#endif
     current_line = program_start;
     goto execline;
   case KW_SAVE:
@@ -1167,7 +1851,20 @@ execnextline:
 
 execline:
   if(current_line == program_end) // Out of lines to run
+  {
+#if !ARDUINO
+    if(statements > 0)
+    {
+      double seconds = (double)(clock() - run_started) / CLOCKS_PER_SEC;
+      fprintf(stderr, "%lu statements in %.3f s", statements, seconds);
+      if(seconds > 0)
+        fprintf(stderr, ", %.0f statements/s", statements / seconds);
+      fprintf(stderr, "\n");
+      statements = 0;
+    }
+#endif
     goto warmstart;
+  }
   txtpos = current_line+sizeof(LINENUM)+sizeof(char);
   goto interperateAtTxtpos;
 
@@ -1575,6 +2272,7 @@ chain:
 load:
   // clear the program
   program_end = program_start;
+  program_changed();
 
   // load from a file into memory
 #if ENABLE_FILEIO
@@ -1860,6 +2558,9 @@ static int inchar()
   // 3. CONSOLE INPUT
   int got = getchar();
 
+  // the end of a piped program
+  if( got == EOF ) exit( 0 );
+
   // translation for desktop systems
   if( got == LF ) got = CR;
 
@@ -1870,7 +2571,9 @@ static int inchar()
 /***********************************************************/
 static void outchar(unsigned char c)
 {
+#if ENABLE_FILEIO
   if( inhibitOutput ) return;
+#endif
 
 #if ARDUINO
 #if ENABLE_FILEIO
@@ -1881,6 +2584,8 @@ static void outchar(unsigned char c)
   else {
     Serial.write(c);
   }
+#else
+  Serial.write(c);
 #endif
 
 #else
@@ -1964,3 +2669,11 @@ void cmd_Files( void )
 }
 #endif
 
+#if !ARDUINO
+int main()
+{
+  setup();
+  loop();
+  return 0;
+}
+#endif
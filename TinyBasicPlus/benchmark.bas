@@ -0,0 +1,153 @@
+NEW
+10 REM COUNTING LOOP
+20 S=0
+30 FOR J=1 TO 20
+40 FOR I=1 TO 30000
+50 S=I
+60 NEXT I
+70 NEXT J
+80 PRINT "FOR/NEXT ",S
+RUN
+NEW
+10 REM GOTO LOOP
+20 FOR J=1 TO 20
+30 I=0
+40 I=I+1
+50 IF I<30000 GOTO 40
+60 NEXT J
+70 PRINT "IF/GOTO ",I
+RUN
+NEW
+10 REM SUBROUTINE CALLS
+20 C=0
+30 FOR I=1 TO 30000
+40 GOSUB 100
+50 NEXT I
+60 PRINT "GOSUB ",C
+70 END
+100 C=C+1
+110 RETURN
+RUN
+NEW
+10 REM PRIMES BY TRIAL DIVISION
+20 C=0
+30 FOR N=2 TO 20000
+40 D=2
+50 IF D*D>N GOTO 90
+60 IF N-N/D*D=0 GOTO 100
+70 D=D+1
+80 GOTO 50
+90 C=C+1
+100 NEXT N
+110 PRINT "PRIMES ",C
+RUN
+NEW
+10 REM JUMPS ACROSS A LONG PROGRAM
+20 I=0
+30 GOTO 990
+40 REM
+50 REM
+60 REM
+70 REM
+80 REM
+90 REM
+100 REM
+110 REM
+120 REM
+130 REM
+140 REM
+150 REM
+160 REM
+170 REM
+180 REM
+190 REM
+200 REM
+210 REM
+220 REM
+230 REM
+240 REM
+250 REM
+260 REM
+270 REM
+280 REM
+290 REM
+300 REM
+310 REM
+320 REM
+330 REM
+340 REM
+350 REM
+360 REM
+370 REM
+380 REM
+390 REM
+400 REM
+410 REM
+420 REM
+430 REM
+440 REM
+450 REM
+460 REM
+470 REM
+480 REM
+490 REM
+500 REM
+510 REM
+520 REM
+530 REM
+540 REM
+550 REM
+560 REM
+570 REM
+580 REM
+590 REM
+600 REM
+610 REM
+620 REM
+630 REM
+640 REM
+650 REM
+660 REM
+670 REM
+680 REM
+690 REM
+700 REM
+710 REM
+720 REM
+730 REM
+740 REM
+750 REM
+760 REM
+770 REM
+780 REM
+790 REM
+800 REM
+810 REM
+820 REM
+830 REM
+840 REM
+850 REM
+860 REM
+870 REM
+880 REM
+890 REM
+900 REM
+910 REM
+920 REM
+930 REM
+940 REM
+950 REM
+960 REM
+970 REM
+980 REM
+990 I=I+1
+1000 IF I<30000 GOTO 30
+1010 PRINT "LONG PROGRAM ",I
+RUN
+NEW
+10 REM AN ERROR, THEN DIRECT COMMANDS
+20 A=1/0
+RUN
+PRINT 4+4
+A=5
+PRINT A*A
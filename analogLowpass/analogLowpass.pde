@@ -1,7 +1,7 @@
+#include <WindowStats.h>
+
 const int samples = 32;
-struct {
-  int val, avr, maxv, minv;
-} hist[samples];
+WindowStats<int, samples> hist;
 int q;
 
 void setup() {
@@ -11,44 +11,28 @@ void setup() {
 }
 
 void loop() {
-  int i, sum;
-  int val = analogRead(0);
+  hist.add(analogRead(0));
   q = (q+1) % samples;
-  hist[q].val = val;
-  hist[q].maxv = val;
-  hist[q].minv = val;
-  sum = 0;
-  for(i = 0; i < samples; i++) {
-    sum += hist[i].val;
-    hist[q].maxv = max(hist[q].maxv, hist[i].val);
-    hist[q].minv = min(hist[q].minv, hist[i].val);    
-  }
-  hist[q].avr = sum/samples;
   if (q > 0) {
     delay(13);
     return;
   }
   
   Serial.print("avr: ");
-  Serial.print(hist[q].avr );
+  Serial.print(hist.mean());
   Serial.print(", min: ");
-  Serial.print(hist[q].minv);
+  Serial.print(hist.min());
   Serial.print(", max: ");
-  Serial.print(hist[q].maxv);
+  Serial.print(hist.max());
   Serial.print(", +diff: ");
-  Serial.print((hist[q].maxv-hist[q].minv)*5.0/1024, 3);
+  Serial.print(hist.range()*5.0/1024, 3);
   Serial.println(" A.");
   
   /*
-  for (i = 0; i < (hist[q].maxv-hist[q].avr)*5.0/1.024; i++) {
+  for (i = 0; i < (hist.max()-hist.mean())*5.0/1.024; i++) {
     Serial.print("+");
   }
   Serial.println();
   */
   delay(1000);
 }
-
-
-
-
-
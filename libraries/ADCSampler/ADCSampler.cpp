@@ -0,0 +1,258 @@
+/*
+ * ADCSampler.cpp
+ *
+ *  Interrupt driven ADC acquisition, see ADCSampler.h
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "ADCSampler.h"
+
+ADCSampler ADCSample;
+
+ADCSampler::ADCSampler() {
+	channelCount = 1;
+	channels[0] = 0;
+	mode = FREE_RUNNING;
+	prescaler = 7;
+	trigger = TRIGGER_NONE;
+	state = IDLE;
+	handler = 0;
+	resetCounters();
+}
+
+void ADCSampler::begin(const byte * pins, byte count, byte reference) {
+	stop();
+	if (count < 1)
+		count = 1;
+	if (count > ADC_MAX_CHANNELS)
+		count = ADC_MAX_CHANNELS;
+	channelCount = count;
+	for (byte i = 0; i < count; i++) {
+		// accept both 0..7 and A0..A7
+		byte ch = pins[i];
+#ifdef A0
+		if (ch >= A0)
+			ch -= A0;
+#endif
+		channels[i] = ch & 0x07;
+	}
+	ADMUX = (reference << 6) | channels[0];
+	ADCSRA = _BV(ADEN) | prescaler;
+}
+
+// ADPS bits, 2 (F_CPU/4) to 7 (F_CPU/128); below 6 costs resolution
+void ADCSampler::setPrescaler(byte adps) {
+	if (adps < 2)
+		adps = 2;
+	prescaler = adps & 0x07;
+	ADCSRA = (ADCSRA & ~0x07) | prescaler;
+}
+
+// channel is an index into the pins given to begin()
+void ADCSampler::setTrigger(byte type, byte channel, int level) {
+	trigger = type;
+	triggerChannel = channel < channelCount ? channel : 0;
+	threshold = level;
+}
+
+/*
+ * Start acquisition.  rate is the sample rate in timer-triggered mode, for
+ * all channels together.  With a limit, sampling stops after that many
+ * blocks have been completed.
+ */
+void ADCSampler::start(byte runMode, unsigned long rate, unsigned long limit) {
+	stop();
+	mode = runMode;
+	blockLimit = limit;
+	fill = 0;
+	index = 0;
+	ready = 0;
+	nextRead = 0;
+	preHead = 0;
+	preCount = 0;
+	pending = false;
+	lastTriggerSample = threshold;
+	resultChannel = 0;
+	state = trigger == TRIGGER_NONE ? RUNNING : ARMED;
+	ADMUX = (ADMUX & 0xf0) | channels[0];
+
+	if (mode == TIMER_TRIGGERED) {
+		unsigned long ticks = F_CPU / (rate ? rate : 1);
+		byte cs = 1;
+		static const byte shift[] = { 3, 3, 2, 2 };   // 1, 8, 64, 256, 1024
+		for (byte i = 0; i < 4 && ticks > 65536UL; i++) {
+			ticks >>= shift[i];
+			cs++;
+		}
+		if (ticks > 65536UL)
+			ticks = 65536UL;
+		TCCR1A = 0;
+		TCCR1B = 0;
+		TCNT1 = 0;
+		OCR1A = ticks - 1;
+		OCR1B = ticks - 1;
+		TIFR1 = _BV(OCF1B);
+		skip = false;
+		// auto trigger source Timer/Counter1 compare match B
+		ADCSRB = (ADCSRB & ~0x07) | _BV(ADTS2) | _BV(ADTS0);
+		ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | prescaler;
+		TCCR1B = _BV(WGM12) | cs;
+	} else {
+		// the conversion after the first starts before its mux can be set
+		skip = channelCount > 1;
+		ADCSRB &= ~0x07;
+		ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) | prescaler
+				| _BV(ADSC);
+	}
+}
+
+void ADCSampler::stop() {
+	ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+	if (mode == TIMER_TRIGGERED)
+		TCCR1B = 0;
+	state = IDLE;
+}
+
+const int * ADCSampler::available() {
+	if (ready & _BV(nextRead))
+		return blocks[nextRead];
+	return 0;
+}
+
+void ADCSampler::release() {
+	uint8_t sreg = SREG;
+	cli();
+	ready &= ~_BV(nextRead);
+	SREG = sreg;
+	nextRead ^= 1;
+}
+
+// call from loop(); returns 1 if a block was handed to the handler
+byte ADCSampler::poll() {
+	const int * block = available();
+	if (!block || !handler)
+		return 0;
+	handler(block, blockLength());
+	release();
+	return 1;
+}
+
+void ADCSampler::resetCounters() {
+	uint8_t sreg = SREG;
+	cli();
+	samples = 0;
+	blockCount = 0;
+	overruns = 0;
+	latencyMin = 0xffff;
+	latencyMax = 0;
+	SREG = sreg;
+}
+
+unsigned long ADCSampler::freeRunningRate() {
+	return (F_CPU >> prescaler) / 13;
+}
+
+void ADCSampler::store(int value, byte ch) {
+	// wait for a free block, and restart on a frame boundary
+	if ((ready & _BV(fill)) || (index == 0 && ch != 0)) {
+		overruns++;
+		return;
+	}
+	blocks[fill][index++] = value;
+	if (index == blockLength())
+		complete();
+}
+
+// hand the block being filled to the main loop and switch to the other one
+void ADCSampler::complete() {
+	ready |= _BV(fill);
+	blockCount++;
+	fill ^= 1;
+	index = 0;
+	if (blockLimit && --blockLimit == 0)
+		stop();
+}
+
+// copy the pre-trigger ring, oldest first, to the start of the first block
+void ADCSampler::triggered() {
+	int len = ADC_PRETRIGGER - ADC_PRETRIGGER % channelCount;
+	int i = preCount < len ? 0 : preHead;
+	for (int n = 0; n < preCount; n++) {
+		blocks[fill][index++] = pre[i];
+		if (++i == len)
+			i = 0;
+	}
+	state = RUNNING;
+	if (index == blockLength())
+		complete();
+}
+
+void ADCSampler::handleSample(int value) {
+	byte ch = resultChannel;
+	resultChannel = nextChannel(ch);
+	samples++;
+	if (state == RUNNING) {
+		store(value, ch);
+		return;
+	}
+	if (state != ARMED)
+		return;
+
+	// keep whole frames of history while armed
+	int len = ADC_PRETRIGGER - ADC_PRETRIGGER % channelCount;
+	if (len > 0) {
+		pre[preHead] = value;
+		if (++preHead == len)
+			preHead = 0;
+		if (preCount < len)
+			preCount++;
+	}
+	if (ch == triggerChannel) {
+		switch (trigger) {
+		case TRIGGER_LEVEL:
+			pending = value >= threshold;
+			break;
+		case TRIGGER_RISING:
+			pending = lastTriggerSample < threshold && value >= threshold;
+			break;
+		case TRIGGER_FALLING:
+			pending = lastTriggerSample > threshold && value <= threshold;
+			break;
+		}
+		lastTriggerSample = value;
+	}
+	// start the capture at the end of the frame holding the trigger
+	if (pending && resultChannel == 0)
+		triggered();
+}
+
+void ADCSampler::handleInterrupt() {
+	int value = ADC;
+
+	if (mode == TIMER_TRIGGERED) {
+		// ticks since the compare match that started this conversion
+		unsigned int t = TCNT1;
+		if (t < latencyMin)
+			latencyMin = t;
+		if (t > latencyMax)
+			latencyMax = t;
+		TIFR1 = _BV(OCF1B);
+		handleSample(value);
+		// the next conversion has not started yet
+		setMux(resultChannel);
+		return;
+	}
+	if (skip) {
+		skip = false;
+		setMux(nextChannel(resultChannel));
+		return;
+	}
+	handleSample(value);
+	// the next conversion is already running, set up the one after it
+	setMux(nextChannel(resultChannel));
+}
+
+ISR(ADC_vect) {
+	ADCSample.handleInterrupt();
+}
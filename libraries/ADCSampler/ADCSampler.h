@@ -0,0 +1,141 @@
+/*
+ * ADCSampler.h
+ *
+ *  Interrupt driven ADC acquisition for ATmega168/328.
+ *
+ *  The ADC runs free-running or is triggered by Timer1 compare match B, and
+ *  the ADC interrupt stores each result into one of two sample blocks while
+ *  the main loop works on the other.  Up to ADC_MAX_CHANNELS inputs are
+ *  converted in round-robin order, so a block holds interleaved frames.
+ *
+ *  A level or edge trigger on one of the channels can gate the capture; the
+ *  last ADC_PRETRIGGER samples up to the end of the trigger frame are kept
+ *  in a ring and start the first block.
+ *
+ *  Timer-triggered mode takes over Timer1, so it cannot be used together
+ *  with TimerOne, Servo or WaveHC.
+ */
+
+#ifndef ADCSAMPLER_H_
+#define ADCSAMPLER_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+// samples per block, two blocks are allocated
+#ifndef ADC_BLOCK_SIZE
+#define ADC_BLOCK_SIZE 128
+#endif
+// samples kept from before the trigger, must not exceed ADC_BLOCK_SIZE
+#ifndef ADC_PRETRIGGER
+#define ADC_PRETRIGGER 32
+#endif
+#define ADC_MAX_CHANNELS 8
+
+class ADCSampler {
+public:
+	enum {
+		FREE_RUNNING = 0,
+		TIMER_TRIGGERED = 1
+	};
+	enum {
+		TRIGGER_NONE = 0,
+		TRIGGER_LEVEL,      // sample >= threshold
+		TRIGGER_RISING,     // crosses threshold upward
+		TRIGGER_FALLING     // crosses threshold downward
+	};
+	enum {
+		IDLE = 0,
+		ARMED,
+		RUNNING
+	};
+
+	typedef void (*BlockHandler)(const int * block, int length);
+
+private:
+	int blocks[2][ADC_BLOCK_SIZE];
+	int pre[ADC_PRETRIGGER];
+	byte channels[ADC_MAX_CHANNELS];
+	byte channelCount;
+	byte mode;
+	byte prescaler;
+
+	byte trigger;
+	byte triggerChannel;
+	int threshold;
+	int lastTriggerSample;
+
+	volatile byte state;
+	byte fill;             // block being filled
+	int index;             // next sample in the block
+	volatile byte ready;   // bit i set if block i is complete
+	byte nextRead;         // block the main loop gets next
+	int preHead;
+	int preCount;
+	byte resultChannel;    // channel index of the next result
+	boolean pending;       // trigger seen, waiting for the end of the frame
+	boolean skip;
+	unsigned long blockLimit;
+
+	BlockHandler handler;
+
+	byte nextChannel(byte i) {
+		return ++i == channelCount ? 0 : i;
+	}
+	void setMux(byte i) {
+		ADMUX = (ADMUX & 0xf0) | (channels[i] & 0x07);
+	}
+	void store(int value, byte ch);
+	void complete();
+	void triggered();
+
+public:
+	// counters, updated by the interrupt
+	volatile unsigned long samples;
+	volatile unsigned long blockCount;
+	volatile unsigned long overruns;   // samples lost because no block was free
+	volatile unsigned int latencyMin;  // timer ticks from trigger to interrupt
+	volatile unsigned int latencyMax;
+
+	ADCSampler();
+
+	void begin(const byte * pins, byte count, byte reference = DEFAULT);
+	void setPrescaler(byte adps);
+	void setTrigger(byte type, byte channel, int level);
+	void start(byte runMode = FREE_RUNNING, unsigned long rate = 0,
+			unsigned long limit = 0);
+	void stop();
+
+	byte status() {
+		return state;
+	}
+
+	// a completed block or 0, valid until release()
+	const int * available();
+	void release();
+	int blockLength() {
+		return ADC_BLOCK_SIZE - ADC_BLOCK_SIZE % channelCount;
+	}
+	// pass completed blocks to a handler from the main loop
+	void onBlock(BlockHandler h) {
+		handler = h;
+	}
+	byte poll();
+
+	void resetCounters();
+	// samples per second for free-running mode, from F_CPU and the prescaler
+	unsigned long freeRunningRate();
+
+	// the data path of the ADC interrupt; also lets a sketch or a host
+	// build replay recorded samples without the ADC
+	void handleSample(int value);
+	// called by ISR(ADC_vect)
+	void handleInterrupt();
+};
+
+extern ADCSampler ADCSample;
+
+#endif /* ADCSAMPLER_H_ */
@@ -0,0 +1,55 @@
+/*
+ * Streams two channels, free-running, to a binary file on the SD card.
+ * Each block is written as ADCSample.blockLength() little endian ints.
+ * Send any character to stop.
+ */
+#include <SdFat.h>
+#include <ADCSampler.h>
+
+const byte pins[] = { A0, A1 };
+const uint8_t chipSelect = SS;
+
+SdFat sd;
+SdFile file;
+unsigned long startTime;
+
+void logBlock(const int * block, int length) {
+	if (file.write(block, length * sizeof(int)) != length * sizeof(int))
+		sd.errorHalt("write failed");
+}
+
+void setup() {
+	Serial.begin(9600);
+	if (!sd.begin(chipSelect, SPI_FULL_SPEED))
+		sd.initErrorHalt();
+	if (!file.open("ADCLOG.BIN", O_CREAT | O_WRITE | O_TRUNC))
+		sd.errorHalt("open failed");
+
+	ADCSample.begin(pins, 2);
+	ADCSample.setPrescaler(6);   // about 19 ksps for both channels
+	ADCSample.onBlock(logBlock);
+	Serial.print("rate: ");
+	Serial.println(ADCSample.freeRunningRate());
+	startTime = millis();
+	ADCSample.start(ADCSampler::FREE_RUNNING);
+}
+
+void loop() {
+	ADCSample.poll();
+	if (!Serial.available())
+		return;
+
+	ADCSample.stop();
+	while (ADCSample.poll())
+		;
+	file.close();
+	unsigned long ms = millis() - startTime;
+	Serial.print("blocks: ");
+	Serial.print(ADCSample.blockCount);
+	Serial.print(" samples/s: ");
+	Serial.print(ADCSample.samples * 1000 / ms);
+	Serial.print(" overruns: ");
+	Serial.println(ADCSample.overruns);
+	while (1)
+		;
+}
@@ -0,0 +1,43 @@
+/*
+ * Captures three channels at 3 kHz per channel after a rising edge on A0
+ * and prints them with the sampler counters.
+ */
+#include <ADCSampler.h>
+
+const byte pins[] = { A0, A1, A2 };
+
+void printBlock(const int * block, int length) {
+	for (int i = 0; i < length; i += 3) {
+		Serial.print(block[i]);
+		Serial.print(',');
+		Serial.print(block[i + 1]);
+		Serial.print(',');
+		Serial.println(block[i + 2]);
+	}
+}
+
+void setup() {
+	Serial.begin(115200);
+	ADCSample.begin(pins, 3);
+	ADCSample.setPrescaler(5);   // 500 kHz ADC clock, about 8 bits effective
+	ADCSample.setTrigger(ADCSampler::TRIGGER_RISING, 0, 512);
+	ADCSample.onBlock(printBlock);
+}
+
+void loop() {
+	ADCSample.resetCounters();
+	ADCSample.start(ADCSampler::TIMER_TRIGGERED, 9000, 4);
+	while (ADCSample.status() != ADCSampler::IDLE || ADCSample.available())
+		ADCSample.poll();
+
+	Serial.print("samples: ");
+	Serial.print(ADCSample.samples);
+	Serial.print(" overruns: ");
+	Serial.print(ADCSample.overruns);
+	Serial.print(" latency: ");
+	Serial.print(ADCSample.latencyMin);
+	Serial.print('-');
+	Serial.print(ADCSample.latencyMax);
+	Serial.println(" ticks");
+	delay(2000);
+}
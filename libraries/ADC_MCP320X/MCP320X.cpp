@@ -12,6 +12,8 @@
 void MCP320X::init(const byte cdiv, const byte mode) {
 	pinMode(pin_cs, OUTPUT);
 	digitalWrite(pin_cs, HIGH);
+	cs_port = portOutputRegister(digitalPinToPort(pin_cs));
+	cs_mask = digitalPinToBitMask(pin_cs);
 	setupSPI(cdiv, mode);
 }
 
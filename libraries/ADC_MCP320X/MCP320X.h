@@ -14,6 +14,8 @@
 
 class MCP320X {
 	const byte pin_cs;
+	volatile uint8_t * cs_port;
+	uint8_t cs_mask;
 	byte clock_divider;
 	byte spi_mode;
 
@@ -39,12 +41,19 @@ public:
 	void setupSPI();
 	inline void end() { deselect(); }
 
+	// direct port access, also called from interrupts
 	void select() {
-		digitalWrite(pin_cs, LOW);
+		uint8_t sreg = SREG;
+		cli();
+		*cs_port &= ~cs_mask;
+		SREG = sreg;
 	}
 
 	void deselect() {
-		digitalWrite(pin_cs, HIGH);
+		uint8_t sreg = SREG;
+		cli();
+		*cs_port |= cs_mask;
+		SREG = sreg;
 	}
 
 	word read12(const byte chcfig);
@@ -0,0 +1,12 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: t -*-
+
+/// @file	AP_AHRS.h
+/// @brief	Catch-all header that defines all the attitude estimators.
+///
+/// AP_AHRS_DCM<float>		DCM in float
+/// AP_AHRS_DCM<Fixed16>	DCM in Q16.16 fixed point
+/// AP_AHRS_Mahony			quaternion complementary filter
+/// AP_AHRS_Madgwick		quaternion gradient descent filter
+
+#include "AP_AHRS_DCM.h"
+#include "AP_AHRS_Quaternion.h"
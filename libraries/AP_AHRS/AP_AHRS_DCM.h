@@ -0,0 +1,251 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: t -*-
+
+/// @file	AP_AHRS_DCM.h
+/// @brief	Direction cosine matrix attitude estimator, after Premerlani and
+///			Bizard, as used by ArduIMU and the SF9DOF Razor AHRS.
+///
+/// The estimator is a template over the element type of the matrix, so the
+/// same code runs in float (AP_AHRS_DCM<float>) or in Q16.16 fixed point
+/// (AP_AHRS_DCM<Fixed16>).  Sensor data and the results are passed as float;
+/// only the per-update math is done in T.
+///
+/// An update is update_matrix(), normalize() and drift_correction(), with
+/// drift_correction_yaw() after it whenever a heading is available.
+/// update() does the first three.
+///
+/// The gains are those of the original sketches: the roll/pitch gains apply
+/// to the accelerometer in sensor units, set_gravity() tells the estimator
+/// what reading 1g is.
+
+#ifndef AP_AHRS_DCM_H
+#define AP_AHRS_DCM_H
+
+#include <AP_Math.h>
+
+// the integrator gains are held multiplied by 2^AHRS_KI_SHIFT and the error
+// sums divided by it, so that Ki of 1e-5 keeps its precision in Q16.16
+#define AHRS_KI_SHIFT		8
+
+// limit of each error sum, keeps Q16.16 in range
+#define AHRS_ERROR_SUM_MAX	30000
+
+template <typename T>
+class AP_AHRS_DCM
+{
+public:
+	AP_AHRS_DCM():
+		_kp_rp(0), _ki_rp(0), _gravity_inv(1)
+	{
+		set_gains(0.02, 0.00002, 1.2, 0.00002);
+		set_integrator_limit(5.236);	// 300 deg/s
+		reset();
+	}
+
+	/// Level attitude, heading north, integrators cleared.
+	void reset()
+	{
+		_dcm(Vector3<T>(1, 0, 0), Vector3<T>(0, 1, 0), Vector3<T>(0, 0, 1));
+		_omega_P = Vector3<T>();
+		_omega_I = Vector3<T>();
+		_sum_rollpitch = Vector3<T>();
+		_sum_yaw = Vector3<T>();
+		_accel_weight = 0;
+		renorm_sqrt_count = 0;
+		renorm_blowup_count = 0;
+	}
+
+	void set_gains(float kp_rollpitch, float ki_rollpitch, float kp_yaw, float ki_yaw)
+	{
+		_kp_rp = kp_rollpitch;
+		_ki_rp = ki_rollpitch;
+		_kp_yaw = T(kp_yaw);
+		_ki_yaw = T(ldexp(ki_yaw, AHRS_KI_SHIFT));
+		scale_gains();
+	}
+
+	/// @param	one_g	accelerometer reading for 1g
+	void set_gravity(float one_g)
+	{
+		_gravity_inv = 1.0 / one_g;
+		scale_gains();
+	}
+
+	/// The integrator is halved whenever its magnitude exceeds this.
+	/// @param	rad_s	limit in rad/s
+	void set_integrator_limit(float rad_s)
+	{
+		_integrator_limit = rad_s;
+		_integrator_limit_sq = T(rad_s * rad_s);
+	}
+
+	/// Rotate the matrix by the corrected gyro rates.
+	/// @param	gyro	body rates in rad/s
+	/// @param	dt		time since the last update in seconds
+	void update_matrix(const Vector3f &gyro, float dt)
+	{
+		_gyro(T(gyro.x), T(gyro.y), T(gyro.z));
+		_omega_I = scale_down(_sum_rollpitch, AHRS_KI_SHIFT) * _ki_rollpitch
+				 + scale_down(_sum_yaw, AHRS_KI_SHIFT) * _ki_yaw;
+		if (_omega_I * _omega_I > _integrator_limit_sq)
+			limit_integrator();
+		_omega = _gyro + _omega_I + _omega_P;
+		_dcm.rotate(_omega * T(dt));
+	}
+
+	/// Make the rows orthonormal again (eq. 19 - 21).  Rows that have drifted
+	/// far are scaled by an exact square root; if that fails too the matrix
+	/// is reset to level.
+	void normalize()
+	{
+		T error = -scale_down(_dcm.a * _dcm.b, 1);							// eq.19
+		Vector3<T> t0 = _dcm.a + _dcm.b * error;								// eq.19
+		Vector3<T> t1 = _dcm.b + _dcm.a * error;								// eq.19
+		Vector3<T> t2 = t0 % t1;												// eq.20
+
+		bool ok = renorm(t0, _dcm.a);
+		ok = renorm(t1, _dcm.b) && ok;
+		ok = renorm(t2, _dcm.c) && ok;
+		if (!ok) {
+			// blowing up, force back to level and hope we are not upside down
+			_dcm(Vector3<T>(1, 0, 0), Vector3<T>(0, 1, 0), Vector3<T>(0, 0, 1));
+		}
+	}
+
+	/// Roll and pitch drift correction from the accelerometer.  Sets the
+	/// proportional term, so it must come before drift_correction_yaw().
+	/// @param	accel	acceleration in sensor units
+	void drift_correction(const Vector3f &accel)
+	{
+		Vector3f a = accel * _gravity_inv;
+
+		// weight for accelerometer info (<0.5G = 0.0, 1G = 1.0 , >1.5G = 0.0)
+		float w = 1 - 2 * fabs(1 - a.length());
+		_accel_weight = w < 0 ? 0 : w > 1 ? 1 : w;
+
+		T weight = T(_accel_weight);
+		Vector3<T> error = Vector3<T>(T(a.x), T(a.y), T(a.z)) % _dcm.c;	// adjust the ground of reference
+		_omega_P = error * (_kp_rollpitch * weight);
+		_sum_rollpitch += error * weight;
+		clamp(_sum_rollpitch);
+	}
+
+	/// Yaw drift correction from a compass heading or a GPS ground course.
+	/// @param	heading_x	cosine of the heading
+	/// @param	heading_y	sine of the heading
+	void drift_correction_yaw(float heading_x, float heading_y)
+	{
+		T course = _dcm.a.x * T(heading_y) - _dcm.b.x * T(heading_x);	// yaw error
+		Vector3<T> error = _dcm.c * course;
+		_omega_P += error * _kp_yaw;
+		_sum_yaw += error;
+		clamp(_sum_yaw);
+	}
+
+	/// Convenience for sketches without a heading reference.
+	void update(const Vector3f &gyro, const Vector3f &accel, float dt)
+	{
+		update_matrix(gyro, dt);
+		normalize();
+		drift_correction(accel);
+	}
+
+	/// Euler angles in radians.
+	void euler_angles(float &roll, float &pitch, float &yaw) const
+	{
+		float s = to_float(_dcm.c.x);
+		pitch = -asin(s > 1 ? 1 : s < -1 ? -1 : s);
+		roll = atan2(to_float(_dcm.c.y), to_float(_dcm.c.z));
+		yaw = atan2(to_float(_dcm.b.x), to_float(_dcm.a.x));
+	}
+
+	const Matrix3<T> &get_dcm_matrix() const	{ return _dcm; }
+
+	/// Gyro rates with the integrator applied, in rad/s.
+	Vector3f get_gyro() const			{ return to_vector3f(_gyro + _omega_I); }
+
+	/// Rates used for the last rotation, in rad/s.
+	Vector3f get_omega() const			{ return to_vector3f(_omega); }
+
+	Vector3f get_omega_I() const		{ return to_vector3f(_omega_I); }
+
+	/// Weight given to the accelerometer by the last drift correction.
+	float get_accel_weight() const		{ return _accel_weight; }
+
+	/// Counts of normalize() taking the square root and the reset paths.
+	uint8_t		renorm_sqrt_count;
+	uint8_t		renorm_blowup_count;
+
+private:
+	Matrix3<T>	_dcm;
+	Vector3<T>	_gyro;
+	Vector3<T>	_omega;				// corrected rates of the last update
+	Vector3<T>	_omega_P;			// proportional correction
+	Vector3<T>	_omega_I;			// integrator correction
+	Vector3<T>	_sum_rollpitch;		// error sums feeding the integrator
+	Vector3<T>	_sum_yaw;
+
+	float		_kp_rp, _ki_rp;		// as given, for accel in sensor units
+	float		_gravity_inv;
+	float		_accel_weight;
+	float		_integrator_limit;
+	T			_kp_rollpitch, _ki_rollpitch;	// for accel in g
+	T			_kp_yaw, _ki_yaw;
+	T			_integrator_limit_sq;
+
+	void scale_gains()
+	{
+		float g = 1.0 / _gravity_inv;
+		_kp_rollpitch = T(_kp_rp * g);
+		_ki_rollpitch = T(ldexp(_ki_rp * g, AHRS_KI_SHIFT));
+	}
+
+	// scale v to unit length into out; false if it is beyond repair
+	bool renorm(const Vector3<T> &v, Vector3<T> &out)
+	{
+		T r = v * v;
+		if (r < T(1.5625f) && r > T(0.64f)) {
+			r = scale_down(T(3) - r, 1);										// eq.21
+		} else if (r < T(100.0f) && r > T(0.01f)) {
+			r = T(1.0f / sqrt(to_float(r)));
+			renorm_sqrt_count++;
+		} else {
+			renorm_blowup_count++;
+			return false;
+		}
+		out = v * r;
+		return true;
+	}
+
+	// halve the integrator when it exceeds the limit, the gyros can not
+	// be that far off
+	void limit_integrator()
+	{
+		float m = sqrt(to_float(_omega_I * _omega_I));
+		T s = T(0.5f * _integrator_limit / m);
+		_sum_rollpitch *= s;
+		_sum_yaw *= s;
+		_omega_I *= s;
+	}
+
+	static void clamp(Vector3<T> &v)
+	{
+		const T hi = T(AHRS_ERROR_SUM_MAX), lo = -hi;
+		v.x = v.x > hi ? hi : v.x < lo ? lo : v.x;
+		v.y = v.y > hi ? hi : v.y < lo ? lo : v.y;
+		v.z = v.z > hi ? hi : v.z < lo ? lo : v.z;
+	}
+
+	static Vector3<T> scale_down(const Vector3<T> &v, uint8_t s)
+	{
+		return Vector3<T>(::scale_down(v.x, s), ::scale_down(v.y, s), ::scale_down(v.z, s));
+	}
+
+	static T scale_down(const T v, uint8_t s)	{ return ::scale_down(v, s); }
+
+	static Vector3f to_vector3f(const Vector3<T> &v)
+	{
+		return Vector3f(to_float(v.x), to_float(v.y), to_float(v.z));
+	}
+};
+
+#endif // AP_AHRS_DCM_H
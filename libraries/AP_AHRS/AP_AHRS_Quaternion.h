@@ -0,0 +1,170 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: t -*-
+
+/// @file	AP_AHRS_Quaternion.h
+/// @brief	Quaternion attitude estimators, Mahony's complementary filter and
+///			Madgwick's gradient descent filter, in float.
+///
+/// Both keep four numbers instead of nine and need no normalize() step of
+/// their own.  They use the same axes and the same update() and
+/// euler_angles() calls as AP_AHRS_DCM, so a sketch can switch between them;
+/// the accelerometer may be in any units, it is normalized.  Neither uses a
+/// heading reference, so yaw is the integrated gyro.
+
+#ifndef AP_AHRS_QUATERNION_H
+#define AP_AHRS_QUATERNION_H
+
+#include <AP_Math.h>
+
+class AP_AHRS_Quaternion
+{
+public:
+	AP_AHRS_Quaternion()		{ reset(); }
+
+	void reset()
+	{
+		q0 = 1; q1 = 0; q2 = 0; q3 = 0;
+	}
+
+	/// Euler angles in radians.
+	void euler_angles(float &roll, float &pitch, float &yaw) const
+	{
+		float s = 2 * (q1 * q3 - q0 * q2);
+		pitch = -asin(s > 1 ? 1 : s < -1 ? -1 : s);
+		roll = atan2(2 * (q2 * q3 + q0 * q1), 1 - 2 * (q1 * q1 + q2 * q2));
+		yaw = atan2(2 * (q1 * q2 + q0 * q3), 1 - 2 * (q2 * q2 + q3 * q3));
+	}
+
+	/// The equivalent direction cosine matrix.
+	Matrix3f get_dcm_matrix() const
+	{
+		return Matrix3f(1 - 2 * (q2 * q2 + q3 * q3), 2 * (q1 * q2 - q0 * q3), 2 * (q1 * q3 + q0 * q2),
+						2 * (q1 * q2 + q0 * q3), 1 - 2 * (q1 * q1 + q3 * q3), 2 * (q2 * q3 - q0 * q1),
+						2 * (q1 * q3 - q0 * q2), 2 * (q2 * q3 + q0 * q1), 1 - 2 * (q1 * q1 + q2 * q2));
+	}
+
+	float		q0, q1, q2, q3;
+
+protected:
+	// q += q * (0, g) / 2, then back to unit length
+	void rotate(float gx, float gy, float gz)
+	{
+		gx *= 0.5f; gy *= 0.5f; gz *= 0.5f;
+		float a = q0, b = q1, c = q2;
+		q0 += -b * gx - c * gy - q3 * gz;
+		q1 += a * gx + c * gz - q3 * gy;
+		q2 += a * gy - b * gz + q3 * gx;
+		q3 += a * gz + b * gy - c * gx;
+		normalize();
+	}
+
+	void normalize()
+	{
+		float n = 1.0f / sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+		q0 *= n; q1 *= n; q2 *= n; q3 *= n;
+	}
+
+	// unit accelerometer vector, false if there is no reading
+	static bool unit(const Vector3f &accel, Vector3f &a)
+	{
+		float n = accel * accel;
+		if (n == 0)
+			return false;
+		a = accel * (1.0f / sqrt(n));
+		return true;
+	}
+};
+
+/// Mahony: proportional and integral feedback of the cross product between
+/// the measured and the estimated gravity direction.
+class AP_AHRS_Mahony : public AP_AHRS_Quaternion
+{
+public:
+	AP_AHRS_Mahony(float kp = 1.0, float ki = 0.005):
+		_kp(kp), _ki(ki)
+	{}
+
+	void set_gains(float kp, float ki)	{ _kp = kp; _ki = ki; }
+
+	void reset()
+	{
+		AP_AHRS_Quaternion::reset();
+		_omega_I = Vector3f();
+	}
+
+	/// @param	gyro	body rates in rad/s
+	/// @param	accel	acceleration in any units
+	/// @param	dt		time since the last update in seconds
+	void update(const Vector3f &gyro, const Vector3f &accel, float dt)
+	{
+		Vector3f a, omega = gyro;
+		if (unit(accel, a)) {
+			// estimated direction of gravity, the third row of the DCM
+			Vector3f v(2 * (q1 * q3 - q0 * q2),
+					   2 * (q2 * q3 + q0 * q1),
+					   1 - 2 * (q1 * q1 + q2 * q2));
+			Vector3f error = a % v;
+			_omega_I += error * (_ki * dt);
+			omega += error * _kp + _omega_I;
+		}
+		rotate(omega.x * dt, omega.y * dt, omega.z * dt);
+	}
+
+	Vector3f get_omega_I() const	{ return _omega_I; }
+
+private:
+	float		_kp, _ki;
+	Vector3f	_omega_I;
+};
+
+/// Madgwick: one gradient descent step per update towards the attitude
+/// that explains the accelerometer, weighted by beta.
+class AP_AHRS_Madgwick : public AP_AHRS_Quaternion
+{
+public:
+	AP_AHRS_Madgwick(float beta = 0.1):
+		_beta(beta)
+	{}
+
+	void set_beta(float beta)		{ _beta = beta; }
+
+	/// @param	gyro	body rates in rad/s
+	/// @param	accel	acceleration in any units
+	/// @param	dt		time since the last update in seconds
+	void update(const Vector3f &gyro, const Vector3f &accel, float dt)
+	{
+		// rate of change of the quaternion from the gyros
+		float h = 0.5f * dt;
+		float d0 = h * (-q1 * gyro.x - q2 * gyro.y - q3 * gyro.z);
+		float d1 = h * (q0 * gyro.x + q2 * gyro.z - q3 * gyro.y);
+		float d2 = h * (q0 * gyro.y - q1 * gyro.z + q3 * gyro.x);
+		float d3 = h * (q0 * gyro.z + q1 * gyro.y - q2 * gyro.x);
+
+		Vector3f a;
+		if (unit(accel, a)) {
+			// objective function, estimated minus measured gravity
+			float f0 = 2 * (q1 * q3 - q0 * q2) - a.x;
+			float f1 = 2 * (q0 * q1 + q2 * q3) - a.y;
+			float f2 = 1 - 2 * (q1 * q1 + q2 * q2) - a.z;
+			// gradient, the Jacobian transposed times f
+			float s0 = -2 * q2 * f0 + 2 * q1 * f1;
+			float s1 = 2 * q3 * f0 + 2 * q0 * f1 - 4 * q1 * f2;
+			float s2 = -2 * q0 * f0 + 2 * q3 * f1 - 4 * q2 * f2;
+			float s3 = 2 * q1 * f0 + 2 * q2 * f1;
+			float n = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+			if (n > 0) {
+				n = _beta * dt / sqrt(n);
+				d0 -= s0 * n;
+				d1 -= s1 * n;
+				d2 -= s2 * n;
+				d3 -= s3 * n;
+			}
+		}
+		q0 += d0; q1 += d1; q2 += d2; q3 += d3;
+		normalize();
+	}
+
+private:
+	float		_beta;
+};
+
+#endif // AP_AHRS_QUATERNION_H
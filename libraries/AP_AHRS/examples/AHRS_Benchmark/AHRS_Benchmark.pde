@@ -0,0 +1,226 @@
+/*
+	Benchmark of the AP_AHRS estimators.
+
+	Runs the same IMU data through the float and the Q16.16 DCM, Mahony and
+	Madgwick, and reports updates per second and the attitude error of each
+	against the float DCM.
+
+	Replay a recorded log by sending lines of
+		dt,gx,gy,gz,ax,ay,az
+	in seconds, rad/s and g at 115200 baud.  Without input the sketch
+	generates a rolling, pitching and turning motion, and also reports the
+	float DCM against the true attitude.
+*/
+
+#include <AP_Math.h>
+#include <AP_AHRS.h>
+#include <stdlib.h>
+
+#define BATCH 16			// samples timed together
+#define REPORT_BATCHES 20	// batches per report
+#define TIMEOUT 2000		// ms without input before generating data
+
+#define ToDeg(x) (x*57.2957795131)  // *180/pi
+
+// the sketch gains, for a 248 count accelerometer with 1g in g
+#define Kp_ROLLPITCH (0.02 * 248)
+#define Ki_ROLLPITCH (0.00002 * 248)
+#define Kp_YAW 1.2
+#define Ki_YAW 0.00002
+
+struct Sample {
+	float dt;
+	Vector3f gyro;
+	Vector3f accel;
+};
+
+AP_AHRS_DCM<float> dcm;
+AP_AHRS_DCM<Fixed16> dcm_q;
+AP_AHRS_Mahony mahony;
+AP_AHRS_Madgwick madgwick;
+
+Sample batch[BATCH];
+Matrix3f truth[BATCH];
+int count;
+
+// per estimator: time spent, worst error in degrees
+enum { DCM_F, DCM_Q, MAHONY, MADGWICK, ESTIMATORS };
+const char *names[ESTIMATORS] = { "DCM float", "DCM Q16", "Mahony", "Madgwick" };
+unsigned long elapsed[ESTIMATORS];
+float worst[ESTIMATORS];
+float worst_truth;
+unsigned long updates;
+int batches;
+
+char line[80];
+byte length;
+unsigned long last_input;
+float t;
+
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println("AP_AHRS benchmark");
+	dcm.set_gains(Kp_ROLLPITCH, Ki_ROLLPITCH, Kp_YAW, Ki_YAW);
+	dcm_q.set_gains(Kp_ROLLPITCH, Ki_ROLLPITCH, Kp_YAW, Ki_YAW);
+	last_input = millis();
+}
+
+Matrix3f to_matrix3f(const Matrix3f &m)
+{
+	return m;
+}
+
+Matrix3f to_matrix3f(const Matrix3q &m)
+{
+	return Matrix3f(to_float(m.a.x), to_float(m.a.y), to_float(m.a.z),
+					to_float(m.b.x), to_float(m.b.y), to_float(m.b.z),
+					to_float(m.c.x), to_float(m.c.y), to_float(m.c.z));
+}
+
+// angle of the rotation between two attitudes, in degrees
+float difference(const Matrix3f &m, const Matrix3f &n)
+{
+	float c = (m.a * n.a + m.b * n.b + m.c * n.c - 1) * 0.5;
+	return ToDeg(acos(c > 1 ? 1 : c < -1 ? -1 : c));
+}
+
+// one log line, false if it is not seven numbers
+bool parse(char *s, Sample &sample)
+{
+	float v[7];
+	for (byte i = 0; i < 7; i++) {
+		char *end;
+		v[i] = strtod(s, &end);
+		if (end == s)
+			return false;
+		s = end;
+		if (*s == ',')
+			s++;
+	}
+	sample.dt = v[0];
+	sample.gyro(v[1], v[2], v[3]);
+	sample.accel(v[4], v[5], v[6]);
+	return true;
+}
+
+// roll and pitch swinging, heading turning
+void generate(Sample &sample, Matrix3f &m)
+{
+	const float w_roll = 2 * M_PI * 0.3, w_pitch = 2 * M_PI * 0.2, yaw_rate = 0.2;
+	sample.dt = 0.02;
+	t += sample.dt;
+
+	float phi = 0.5 * sin(w_roll * t), theta = 0.3 * sin(w_pitch * t), psi = yaw_rate * t;
+	float phi_dot = 0.5 * w_roll * cos(w_roll * t), theta_dot = 0.3 * w_pitch * cos(w_pitch * t);
+	float sp = sin(phi), cp = cos(phi), st = sin(theta), ct = cos(theta);
+	float ss = sin(psi), cs = cos(psi);
+
+	// body rates from the euler rates
+	sample.gyro(phi_dot - yaw_rate * st,
+				theta_dot * cp + yaw_rate * ct * sp,
+				-theta_dot * sp + yaw_rate * ct * cp);
+	// gravity only, the third row of the matrix
+	sample.accel(-st, sp * ct, cp * ct);
+
+	m(Vector3f(ct * cs, sp * st * cs - cp * ss, cp * st * cs + sp * ss),
+	  Vector3f(ct * ss, sp * st * ss + cp * cs, cp * st * ss - sp * cs),
+	  Vector3f(-st, sp * ct, cp * ct));
+}
+
+// true when a line has been read into the batch
+bool read_line()
+{
+	while (Serial.available()) {
+		char c = Serial.read();
+		last_input = millis();
+		if (c == '\r' || c == '\n') {
+			line[length] = 0;
+			bool ok = length && parse(line, batch[count]);
+			length = 0;
+			return ok;
+		}
+		if (length < sizeof(line) - 1)
+			line[length++] = c;
+	}
+	return false;
+}
+
+void run_batch(bool synthetic)
+{
+	unsigned long start;
+
+	start = micros();
+	for (int i = 0; i < count; i++)
+		dcm.update(batch[i].gyro, batch[i].accel, batch[i].dt);
+	elapsed[DCM_F] += micros() - start;
+
+	start = micros();
+	for (int i = 0; i < count; i++)
+		dcm_q.update(batch[i].gyro, batch[i].accel, batch[i].dt);
+	elapsed[DCM_Q] += micros() - start;
+
+	start = micros();
+	for (int i = 0; i < count; i++)
+		mahony.update(batch[i].gyro, batch[i].accel, batch[i].dt);
+	elapsed[MAHONY] += micros() - start;
+
+	start = micros();
+	for (int i = 0; i < count; i++)
+		madgwick.update(batch[i].gyro, batch[i].accel, batch[i].dt);
+	elapsed[MADGWICK] += micros() - start;
+
+	updates += count;
+
+	// errors at the end of the batch
+	Matrix3f ref = dcm.get_dcm_matrix();
+	float e[ESTIMATORS] = {
+		0,
+		difference(ref, to_matrix3f(dcm_q.get_dcm_matrix())),
+		difference(ref, mahony.get_dcm_matrix()),
+		difference(ref, madgwick.get_dcm_matrix())
+	};
+	for (byte i = 0; i < ESTIMATORS; i++)
+		if (e[i] > worst[i])
+			worst[i] = e[i];
+	if (synthetic) {
+		float d = difference(ref, truth[count - 1]);
+		if (d > worst_truth)
+			worst_truth = d;
+	}
+	count = 0;
+
+	if (++batches < REPORT_BATCHES)
+		return;
+	for (byte i = 0; i < ESTIMATORS; i++) {
+		Serial.print(names[i]);
+		Serial.print(": ");
+		Serial.print(updates * 1000000.0 / elapsed[i], 0);
+		Serial.print(" updates/s, max error ");
+		Serial.print(worst[i], 3);
+		Serial.println(" deg");
+		elapsed[i] = 0;
+		worst[i] = 0;
+	}
+	if (synthetic) {
+		Serial.print("DCM float against truth: max error ");
+		Serial.print(worst_truth, 3);
+		Serial.println(" deg");
+		worst_truth = 0;
+	}
+	Serial.println();
+	updates = 0;
+	batches = 0;
+}
+
+void loop()
+{
+	if (read_line()) {
+		if (++count == BATCH)
+			run_batch(false);
+	} else if (millis() - last_input > TIMEOUT) {
+		generate(batch[count], truth[count]);
+		if (++count == BATCH)
+			run_batch(true);
+	}
+}
@@ -52,77 +52,62 @@ AP_GPS_Auto::update(void)
 //
 // Perform one iteration of the auto-detection process.
 //
+// Every byte is offered to a framer for each binary protocol and to the
+// NMEA parser at once, and the first of them to complete a message with
+// a good checksum names the GPS.  A stray preamble in the noise at the
+// wrong baudrate can start a frame but will not survive the checksum.
+//
 GPS *
 AP_GPS_Auto::_detect(void)
 {
 	unsigned long then;
-	int		fingerprint[4];
 	int		tries;
-	GPS		*gps;
+	uint8_t	data;
+
+	AP_GPS_Framer	ublox(AP_GPS_UBLOX::protocol, NULL, 0);
+	AP_GPS_Framer	mtk(AP_GPS_MTK::protocol, NULL, 0);
+	AP_GPS_Framer	sirf(AP_GPS_SIRF::protocol, NULL, 0);
+	NMEAParser		nmea;
 
-	//
-	// Loop attempting to detect a recognised GPS
-	//
-	gps = NULL;
 	for (tries = 0; tries < 2; tries++) {
 
 		//
-		// Empty the serial buffer and wait for 50ms of quiet.
-		//
-		// XXX We can detect babble by counting incoming characters, but
-		//     what would we do about it?
+		// Listen for long enough to see a message from a receiver
+		// reporting at 1Hz.
 		//
 		_port->flush();
 		then = millis();
-		do {
-			if (_port->available()) {
-				then = millis();
-				_port->read();
-			}
-		} while ((millis() - then) < 50);
-			
-		//
-		// Collect four characters to fingerprint a device
-		//
-		fingerprint[0] = _getc();
-		fingerprint[1] = _getc();
-		fingerprint[2] = _getc();
-		fingerprint[3] = _getc();
-		printf("fingerprints 0x%02x 0x%02x 0x%02x 0x%02x\n",
-			   fingerprint[0],
-			   fingerprint[1],
-			   fingerprint[2],
-			   fingerprint[3]);
-
-		//
-		// u-blox or MTK in DIYD binary mode (whose smart idea was
-		// it to make the MTK look sort-of like it was talking UBX?)
-		//
-		if ((0xb5 == fingerprint[0]) &&
-			(0x62 == fingerprint[1]) && 
-			(0x01 == fingerprint[2])) {
-
-			// message 5 is MTK pretending to talk UBX
-			if (0x05 == fingerprint[3]) {
+		while ((millis() - then) < DETECT_TIMEOUT) {
+			if (0 == _port->available())
+				continue;
+			data = _port->read();
+
+			//
+			// MTK in DIYD binary mode uses the UBX preamble and class, but
+			// its message has no length, so neither framer will accept
+			// the other's messages.
+			//
+			if (mtk.frame(data)) {
 				printf("detected MTK in binary mode\n");
-				gps = new AP_GPS_MTK(_port);
-				break;
+				return new AP_GPS_MTK(_port);
+			}
+			if (ublox.frame(data)) {
+				printf("detected u-blox in binary mode\n");
+				return new AP_GPS_UBLOX(_port);
+			}
+			if (sirf.frame(data)) {
+				printf("detected SIRF in binary mode\n");
+				return new AP_GPS_SIRF(_port);
 			}
 
-			// any other message is u-blox
-			printf("detected u-blox in binary mode\n");
-			gps = new AP_GPS_UBLOX(_port);
-			break;
-		} 
-
-		//
-		// SIRF in binary mode
-		//
-		if ((0xa0 == fingerprint[0]) &&
-			(0xa2 == fingerprint[1])) {
-			printf("detected SIRF in binary mode\n");
-			gps = new AP_GPS_SIRF(_port);
-			break;
+			//
+			// Something talking NMEA, once the setup strings have had
+			// a chance to switch it to binary.
+			//
+			if (tries > 0 && NMEAParser::NONE != nmea.encode(data)) {
+				printf("detected NMEA\n");
+				return new AP_GPS_NMEA(_port);
+			}
 		}
 
 		//
@@ -134,29 +119,7 @@ AP_GPS_Auto::_detect(void)
 			_port->println(MTK_SET_BINARY);
 			_port->println(UBLOX_SET_BINARY);
 			_port->println(SIRF_SET_BINARY);
-			continue;
-		}
-
-		//
-		// Something talking NMEA
-		//
-		if (('$' == fingerprint[0]) &&
-			(('G' == fingerprint[1]) || ('P' == fingerprint[1]))) {
-
-			// XXX this may be a bit presumptive, might want to give the GPS a couple of
-			//     iterations around the loop to react to init strings?
-			printf("detected NMEA\n");
-			gps = new AP_GPS_NMEA(_port);
-			break;
 		}
 	}
-	return(gps);
-}
-
-int
-AP_GPS_Auto::_getc(void)
-{
-	while (0 == _port->available())
-		;
-	return(_port->read());
+	return(NULL);
 }
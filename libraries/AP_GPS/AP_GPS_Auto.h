@@ -9,6 +9,9 @@
 #include <GPS.h>
 #include <FastSerial.h>
 
+/// time to listen at each baudrate, ms
+#define DETECT_TIMEOUT	1200
+
 class AP_GPS_Auto : public GPS
 {
 public:
@@ -44,9 +47,5 @@ private:
 	/// low-level auto-detect routine
 	///
 	GPS			*_detect(void);
-
-	/// fetch a character from the port
-	///
-	int			_getc(void);
 };
 #endif
@@ -0,0 +1,264 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: t -*-
+//
+//  Framing and table driven decoding for the binary GPS protocols.
+//
+//	This library is free software; you can redistribute it and / or
+//	modify it under the terms of the GNU Lesser General Public
+//	License as published by the Free Software Foundation; either
+//	version 2.1 of the License, or (at your option) any later version.
+//
+
+#include "AP_GPS_Framer.h"
+#include "GPS.h"
+
+// Constructors ////////////////////////////////////////////////////////////////
+
+AP_GPS_Framer::AP_GPS_Framer(const protocol &p, void *buffer, uint8_t size) :
+	checksum_errors(0),
+	_protocol(p),
+	_buffer((uint8_t *)buffer),
+	_size(size),
+	_message(NULL),
+	_step(0)
+{
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+// Process one byte from the stream
+//
+// Every protocol starts with two preamble bytes.  If we fail to match
+// them, we reset the state machine and re-consider the failed byte as
+// the first byte of the preamble.  The length is always collected, so
+// that a message we do not want is skipped whole rather than searched
+// for preamble bytes; only the MTK frames, which carry no length, have
+// to be abandoned when the id is not in the table.
+//
+bool
+AP_GPS_Framer::frame(uint8_t data)
+{
+	uint8_t		preamble1, preamble2;
+
+	if (SIRF == _protocol.format) {
+		preamble1 = 0xa0;
+		preamble2 = 0xa2;
+	} else {
+		preamble1 = 0xb5;
+		preamble2 = 0x62;
+	}
+
+	switch(_step) {
+
+		// Preamble detection
+		//
+	case 1:
+		if (preamble2 == data) {
+			_step++;
+			break;
+		}
+		_step = 0;
+		// FALLTHROUGH
+	case 0:
+		_message = NULL;
+		if (preamble1 == data)
+			_step++;
+		break;
+
+		// Header: UBX and MTK class and id, SIRF length
+		//
+	case 2:
+		_step++;
+		if (SIRF == _protocol.format) {
+			_payload_length = (uint16_t)data << 8;
+		} else {
+			_ck_a = _ck_b = 0;
+			_accumulate(data);
+			_msg_class = data;
+		}
+		break;
+	case 3:
+		_step++;
+		if (SIRF == _protocol.format) {
+			_payload_length |= data;
+			_checksum = 0;
+			if (0 == _payload_length || _payload_length > AP_GPS_FRAMER_MAX_LENGTH)
+				_step = 0;
+			break;
+		}
+		_accumulate(data);
+		_lookup(data);
+		if (MTK == _protocol.format) {
+			if (NULL == _message) {
+				_step = 0;						// cannot skip what we cannot measure
+				break;
+			}
+			_payload_length = _message->length;
+			_payload_counter = 0;
+			_step = 6;
+		}
+		break;
+
+		// UBX length, SIRF id
+		//
+	case 4:
+		_accumulate(data);
+		if (SIRF == _protocol.format) {
+			_payload_length--;					// the id is not part of the stored payload
+			_payload_counter = 0;
+			_lookup(data);
+			_step = _payload_length ? 6 : 7;
+		} else {
+			_step++;
+			_payload_length = data;
+		}
+		break;
+	case 5:
+		_accumulate(data);
+		_payload_length |= (uint16_t)data << 8;
+		_payload_counter = 0;
+		if (_payload_length > AP_GPS_FRAMER_MAX_LENGTH) {
+			_step = 0;
+			break;
+		}
+		_step = _payload_length ? 6 : 7;
+		break;
+
+		// Payload, stored only for a message in the table
+		//
+	case 6:
+		_accumulate(data);
+		if (NULL != _message && _payload_counter < _size)
+			_buffer[_payload_counter] = data;
+		if (++_payload_counter == _payload_length)
+			_step++;
+		break;
+
+		// Checksum
+		//
+	case 7:
+		_step++;
+		if (SIRF == _protocol.format) {
+			if (!_check(_checksum >> 8, data))
+				_step = 0;
+		} else if (!_check(_ck_a, data)) {
+			_step = 0;
+		}
+		break;
+	case 8:
+		_step = 0;
+		if (!_check(SIRF == _protocol.format ? _checksum & 0xff : _ck_b, data))
+			break;
+		if (NULL != _message && _payload_length >= _message->length)
+			return true;
+		break;
+	}
+	return false;
+}
+
+void
+AP_GPS_Framer::decode(GPS *gps) const
+{
+	if (NULL == _message || NULL == _buffer)
+		return;
+
+	for (uint8_t i = 0; i < _message->num_fields; i++) {
+		const field	&f = _message->fields[i];
+		long		v = get(_buffer + f.offset, f.type);
+
+		if (f.scale > 0)
+			v *= f.scale;
+		else if (f.scale < 0)
+			v /= -f.scale;
+
+		switch (f.target) {
+		case TIME:			gps->time = v;				break;
+		case LATITUDE:		gps->latitude = v;			break;
+		case LONGITUDE:		gps->longitude = v;			break;
+		case ALTITUDE:		gps->altitude = v;			break;
+		case GROUND_SPEED:	gps->ground_speed = v;		break;
+		case GROUND_COURSE:	gps->ground_course = v;		break;
+		case SPEED_3D:		gps->speed_3d = v;			break;
+		case NUM_SATS:		gps->num_sats = v;			break;
+		}
+	}
+}
+
+long
+AP_GPS_Framer::get(const void *payload, uint8_t type)
+{
+	const uint8_t	*b = (const uint8_t *)payload;
+	uint8_t			size;
+	union {
+		uint32_t	u32;
+		int32_t		s32;
+		uint16_t	u16;
+		int16_t		s16;
+		uint8_t		b[4];
+	} u;
+
+	switch (type & ~BIG) {
+	case U8:
+		return b[0];
+	case S8:
+		return (int8_t)b[0];
+	case U16:
+	case S16:
+		size = 2;
+		break;
+	default:
+		size = 4;
+		break;
+	}
+
+	// the payload is not aligned, so assemble the value bytewise
+	for (uint8_t i = 0; i < size; i++)
+		u.b[i] = (type & BIG) ? b[size - 1 - i] : b[i];
+
+	switch (type & ~BIG) {
+	case U16:
+		return u.u16;
+	case S16:
+		return u.s16;
+	case U32:
+		return u.u32;
+	default:
+		return u.s32;
+	}
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+void
+AP_GPS_Framer::_accumulate(uint8_t data)
+{
+	if (SIRF == _protocol.format) {
+		_checksum = (_checksum + data) & 0x7fff;
+	} else {
+		_ck_b += (_ck_a += data);
+	}
+}
+
+// find the message in the table, NULL when we do not want it
+void
+AP_GPS_Framer::_lookup(uint8_t id)
+{
+	_message = NULL;
+	for (uint8_t i = 0; i < _protocol.num_messages; i++) {
+		const message	*m = &_protocol.messages[i];
+
+		if (m->msg_id == id &&
+			(SIRF == _protocol.format || m->msg_class == _msg_class)) {
+			_message = m;
+			return;
+		}
+	}
+}
+
+bool
+AP_GPS_Framer::_check(uint8_t expected, uint8_t data)
+{
+	if (expected == data)
+		return true;
+	checksum_errors++;
+	return false;
+}
@@ -0,0 +1,132 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: t -*-
+//
+//  Framing and table driven decoding for the binary GPS protocols.
+//
+//	This library is free software; you can redistribute it and / or
+//	modify it under the terms of the GNU Lesser General Public
+//	License as published by the Free Software Foundation; either
+//	version 2.1 of the License, or (at your option) any later version.
+//
+
+/// @file	AP_GPS_Framer.h
+/// @brief	Shared sync detection, checksums and message dispatch for the
+///			u-blox, MediaTek and SiRF binary drivers.
+///
+/// A driver describes its protocol with a table of the messages it wants
+/// and, for each message, the payload offsets that map straight into the
+/// GPS properties.  The framer stores the payload of a wanted message once,
+/// into the driver's own buffer, while the checksum is accumulated; fields
+/// are then read in place at their offsets with the byte order of the
+/// protocol.  Messages that are not in the table are checksummed and
+/// skipped without being stored.
+
+#ifndef AP_GPS_Framer_h
+#define AP_GPS_Framer_h
+
+#include <inttypes.h>
+#include <stddef.h>
+
+class GPS;
+
+/// longest payload skipped before the framer gives up and resyncs
+#define AP_GPS_FRAMER_MAX_LENGTH	512
+
+class AP_GPS_Framer
+{
+public:
+	/// Frame formats
+	enum format {
+		UBX,		///< b5 62, class, id, little endian length, Fletcher checksum
+		MTK,		///< b5 62, class, id, length set by the id, Fletcher checksum
+		SIRF		///< a0 a2, big endian length, id, 15 bit sum, b0 b3
+	};
+
+	/// Field types, with BIG set for big endian values
+	enum type {
+		U8, S8, U16, S16, U32, S32,
+		BIG = 0x80
+	};
+
+	/// GPS properties a field can be stored into
+	enum target {
+		TIME, LATITUDE, LONGITUDE, ALTITUDE,
+		GROUND_SPEED, GROUND_COURSE, SPEED_3D, NUM_SATS
+	};
+
+	/// A payload field and where it goes
+	struct field {
+		uint8_t		offset;			///< from the start of the payload
+		uint8_t		type;
+		uint8_t		target;
+		int16_t		scale;			///< multiplier, or divisor when negative
+	};
+
+	/// A message the driver decodes
+	struct message {
+		uint8_t		msg_class;		///< unused by SIRF
+		uint8_t		msg_id;
+		uint8_t		length;			///< payload bytes needed, without the SIRF id
+		const field	*fields;
+		uint8_t		num_fields;
+	};
+
+	/// A protocol as seen by a driver
+	struct protocol {
+		uint8_t			format;
+		const message	*messages;
+		uint8_t			num_messages;
+	};
+
+	/// Constructor
+	///
+	/// @param	p		Protocol and message table.
+	/// @param	buffer	Receives the payload of the messages in the table,
+	///					at least as long as the longest of them.  NULL
+	///					with a size of 0 only matches frames, as done by
+	///					auto-detection.
+	/// @param	size	Size of the buffer.
+	///
+	AP_GPS_Framer(const protocol &p, void *buffer, uint8_t size);
+
+	/// Process one byte from the stream.
+	///
+	/// @returns		true when a message from the table has been received
+	///					with a good checksum.  Its payload stays in the buffer
+	///					until the next byte is processed.
+	///
+	bool			frame(uint8_t data);
+
+	/// the message last completed by ::frame
+	const message	*current(void) const { return _message; }
+
+	/// Store the fields of the current message into a GPS.
+	void			decode(GPS *gps) const;
+
+	/// Read a field of the given type from a payload.
+	static long		get(const void *payload, uint8_t type);
+
+	unsigned long	checksum_errors;	///< frames dropped on a bad checksum
+
+private:
+	const protocol	&_protocol;
+	uint8_t			*_buffer;
+	uint8_t			_size;
+	const message	*_message;
+
+	// State machine state
+	uint8_t			_step;
+	uint8_t			_msg_class;
+	uint16_t		_payload_length;
+	uint16_t		_payload_counter;
+
+	// Checksum accumulators, Fletcher or SiRF sum
+	uint8_t			_ck_a;
+	uint8_t			_ck_b;
+	uint16_t		_checksum;
+
+	void			_accumulate(uint8_t data);
+	void			_lookup(uint8_t id);
+	bool			_check(uint8_t expected, uint8_t data);
+};
+
+#endif // AP_GPS_Framer_h
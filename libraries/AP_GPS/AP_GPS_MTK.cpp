@@ -14,8 +14,34 @@
 #include "AP_GPS_MTK.h"
 #include "WProgram.h"
 
+// Message tables //////////////////////////////////////////////////////////////
+
+#define FIELD(member, type, target, scale) \
+	{ offsetof(diyd_mtk_msg, member), AP_GPS_Framer::type | AP_GPS_Framer::BIG, AP_GPS_Framer::target, scale }
+
+const AP_GPS_Framer::field AP_GPS_MTK::_msg_fields[] = {
+	FIELD(latitude,			S32, LATITUDE,		10),
+	FIELD(longitude,		S32, LONGITUDE,		10),
+	FIELD(altitude,			S32, ALTITUDE,		0),
+	FIELD(ground_speed,		S32, GROUND_SPEED,	0),
+	FIELD(ground_course,	S32, GROUND_COURSE,	-10000),
+	FIELD(satellites,		U8,  NUM_SATS,		0),
+	// XXX docs say this is UTC, but our clients expect msToW
+	FIELD(utc_time,			U32, TIME,			0)
+};
+
+const AP_GPS_Framer::message AP_GPS_MTK::_messages[] = {
+	{ MESSAGE_CLASS, MESSAGE_ID, sizeof(diyd_mtk_msg), _msg_fields, sizeof(_msg_fields) / sizeof(_msg_fields[0]) }
+};
+
+const AP_GPS_Framer::protocol AP_GPS_MTK::protocol = {
+	AP_GPS_Framer::MTK, _messages, sizeof(_messages) / sizeof(_messages[0])
+};
+
 // Constructors ////////////////////////////////////////////////////////////////
-AP_GPS_MTK::AP_GPS_MTK(Stream *s) : GPS(s)
+AP_GPS_MTK::AP_GPS_MTK(Stream *s) :
+	GPS(s),
+	_framer(protocol, &_buffer, sizeof(_buffer))
 {
 }
 
@@ -33,113 +59,28 @@ void AP_GPS_MTK::init(void)
 
 // Process bytes available from the stream
 //
-// The stream is assumed to contain only our custom message.  If it
-// contains other messages, and those messages contain the preamble bytes,
-// it is possible for this code to become de-synchronised.  Without
-// buffering the entire message and re-processing it from the top,
-// this is unavoidable.
-//
-// The lack of a standard header length field makes it impossible to skip
-// unrecognised messages.
+// The stream is assumed to contain only our custom message.  The lack of
+// a standard header length field makes it impossible to skip unrecognised
+// messages, so AP_GPS_Framer resyncs on the preamble after any other class
+// or ID.
 //
 void AP_GPS_MTK::update(void)
 {
-	byte data;
 	int numc;
 
 	numc = _port->available();
-	for (int i = 0; i < numc; i++){	// Process bytes received
-
-		// read the next byte
-		data = _port->read();
-
-restart:		
-		switch(_step){
-
-			// Message preamble, class, ID detection
-			//
-			// If we fail to match any of the expected bytes, we
-			// reset the state machine and re-consider the failed
-			// byte as the first byte of the preamble.  This 
-			// improves our chances of recovering from a mismatch
-			// and makes it less likely that we will be fooled by
-			// the preamble appearing as data in some other message.
-			//
-		case 0:
-			if(PREAMBLE1 == data)
-				_step++;
-			break;
-		case 1:
-			if (PREAMBLE2 == data) {
-				_step++;
-				break;
-			}
-			_step = 0;
-			goto restart;
-		case 2:
-			if (MESSAGE_CLASS == data) {
-				_step++;
-				_ck_b = _ck_a = data;					// reset the checksum accumulators
-			} else {
-				_step = 0;							// reset and wait for a message of the right class
-				goto restart;
-			}
-			break;
-		case 3:
-			if (MESSAGE_ID == data) {
-				_step++;
-				_ck_b += (_ck_a += data);
-				_payload_length = sizeof(diyd_mtk_msg);	// prepare to receive our message
-				_payload_counter = 0;
-			} else {
-				_step = 0;
-				goto restart;
-			}
-			break;
-
-			// Receive message data
-			//
-		case 4:
-			_buffer.bytes[_payload_counter++] = data;
-			_ck_b += (_ck_a += data);
-			if (_payload_counter == _payload_length)
-				_step++;
-			break;
-
-			// Checksum and message processing
-			//
-		case 5:
-			_step++;
-			if (_ck_a != data) {
-				_error("GPS_MTK: checksum error\n");
-				_step = 0;
-			}
-			break;
-		case 6:
-			_step = 0;
-			if (_ck_b != data) {
-				_error("GPS_MTK: checksum error\n");
-				break;
-			}
-			_parse_gps();							 // Parse the new GPS packet
-		}
-	} 
+	while (numc--) {
+		if (_framer.frame(_port->read()))
+			_parse_gps();
+	}
 }
 
 // Private Methods 
 void 
 AP_GPS_MTK::_parse_gps(void)
 {
+	_framer.decode(this);
 	fix				= (_buffer.msg.fix_type == FIX_3D);
-	latitude		= _swapl(&_buffer.msg.latitude)  * 10;
-	longitude		= _swapl(&_buffer.msg.longitude) * 10;
-	altitude		= _swapl(&_buffer.msg.altitude);
-	ground_speed	= _swapl(&_buffer.msg.ground_speed);
-	ground_course	= _swapl(&_buffer.msg.ground_course) / 10000;
-	num_sats		= _buffer.msg.satellites;
-			
-	// XXX docs say this is UTC, but our clients expect msToW
-	time			= _swapl(&_buffer.msg.utc_time);
 	_setTime();
 	valid_read = true;
 	new_data = true;
@@ -14,6 +14,7 @@
 #define AP_GPS_MTK_h
 
 #include <GPS.h>
+#include "AP_GPS_Framer.h"
 #define MAXPAYLOAD 32
 
 #define MTK_SET_BINARY	"$PGCMD,16,0,0,0,0,0*6A\r\n"
@@ -39,6 +40,9 @@ public:
 	virtual void	init(void);
 	virtual void	update(void);
 
+	/// DIYD binary framing and the message decoded, also used by auto-detection
+	static const AP_GPS_Framer::protocol protocol;
+
 private:
 #pragma pack(1)
 	struct diyd_mtk_msg {
@@ -65,21 +69,18 @@ private:
 		MESSAGE_ID = 5
 	};
 
-	// Packet checksum accumulators
-	uint8_t 	_ck_a;
-	uint8_t 	_ck_b;
-
-	// State machine state
-	uint8_t 	_step;
-	uint8_t		_payload_length;
-	uint8_t		_payload_counter;
-
 	// Receive buffer
 	union {
 		diyd_mtk_msg	msg;
 		uint8_t			bytes[];
 	} _buffer;
 
+	AP_GPS_Framer	_framer;
+
+	// Message tables
+	static const AP_GPS_Framer::field	_msg_fields[];
+	static const AP_GPS_Framer::message	_messages[];
+
 	// Buffer parse & GPS state update
 	void		_parse_gps();
 };
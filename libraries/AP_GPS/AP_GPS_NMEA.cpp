@@ -15,6 +15,8 @@
 	NMEA Sentences : 
 		$GPGGA : Global Positioning System fix Data
 		$GPVTG : Ttack and Ground Speed
+		$GPRMC : Recommended minimum data, used when present
+	The sentences are parsed by the shared NMEAParser (libraries/NMEA).
 		
 	Methods:
 		init() : GPS Initialization
@@ -42,7 +44,7 @@
 #include "WProgram.h"
 
 // Constructors ////////////////////////////////////////////////////////////////
-AP_GPS_NMEA::AP_GPS_NMEA(Stream *s) : GPS(s)
+AP_GPS_NMEA::AP_GPS_NMEA(Stream *s) : GPS(s), _checksum_errors(0)
 {
 }
 
@@ -61,186 +63,70 @@ AP_GPS_NMEA::init(void)
 
 // This code dont wait for data, only proccess the data available on serial port
 // We can call this function on the main loop (50Hz loop)
-// If we get a complete packet this function call parse_nmea_gps() to parse and update the GPS info.
+// Each byte goes straight to the parser, which hands back a complete sentence
+// once its checksum has been checked.
 void
 AP_GPS_NMEA::update(void)
 {
-	char c;
 	int numc;
-	int i;
 
 	numc = _port->available();
-	
-	if (numc > 0){
-		for (i = 0; i < numc; i++){
-			c = _port->read();
-			if (c == '$'){											// NMEA Start
-				bufferidx = 0;
-				buffer[bufferidx++] = c;
-				GPS_checksum = 0;
-				GPS_checksum_calc = true;
-				continue;
-				}
-			if (c == '\r'){										 // NMEA End
-				buffer[bufferidx++] = 0;
-				parse_nmea_gps();
-			} else {
-				if (bufferidx < (GPS_BUFFERSIZE - 1)){
-					if (c == '*')
-						GPS_checksum_calc = false;		// Checksum calculation end
-					buffer[bufferidx++] = c;
-					if (GPS_checksum_calc){
-						GPS_checksum ^= c;						// XOR 
-					}
-				} else {
-					bufferidx = 0;	 // Buffer overflow : restart
-				}
+	while (numc-- > 0) {
+		switch (_nmea.encode(_port->read())) {
+		case NMEAParser::GGA:
+			_setTime();
+			valid_read = true;
+			new_data = true;	// New GPS Data
+			time = _nmea.time;							// GPS UTC time hhmmss.ss
+			latitude = _nmea.latitude;
+			longitude = _nmea.longitude;
+			fix = _nmea.quality > 0;
+			num_sats = _nmea.satellites;
+			HDOP = _nmea.hdop / 10;						// HDOP * 10
+			altitude = _nmea.altitude * 10;				// milimeters
+			_fix_quality();
+			break;
+		case NMEAParser::RMC:
+			_setTime();
+			valid_read = true;
+			new_data = true;
+			time = _nmea.time;
+			if (_nmea.valid) {
+				latitude = _nmea.latitude;
+				longitude = _nmea.longitude;
 			}
+			ground_speed = _nmea.speed;
+			ground_course = _nmea.course;
+			break;
+		case NMEAParser::VTG:
+			_setTime();
+			valid_read = true;
+			new_data = true;	// New GPS Data
+			ground_course = _nmea.course;				// Ground course in degrees * 100
+			ground_speed = _nmea.speed;					// m / s * 100
+			break;
+		case NMEAParser::NONE:
+			if (_nmea.checksumErrors != _checksum_errors) {
+				_checksum_errors = _nmea.checksumErrors;
+				_error("GPSERR: Checksum error!!\n");
+			}
+			break;
 		}
 	}
 }
 
-/****************************************************************
- * 
- * * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * ** * **/
 // Private Methods //////////////////////////////////////////////////////////////
 void
-AP_GPS_NMEA::parse_nmea_gps(void)
+AP_GPS_NMEA::_fix_quality(void)
 {
-	uint8_t NMEA_check;
-	long aux_deg;
-	long aux_min;
-	char *parseptr;
-
-	if (strncmp(buffer,"$GPGGA",6)==0){					// Check if sentence begins with $GPGGA
-		if (buffer[bufferidx-4]=='*'){					 // Check for the "*" character
-			NMEA_check = parseHex(buffer[bufferidx - 3]) * 16 + parseHex(buffer[bufferidx - 2]);		// Read the checksums characters
-			if (GPS_checksum == NMEA_check){			// Checksum validation
-				//Serial.println("buffer");
-				_setTime();
-				valid_read = true;
-				new_data = true;	// New GPS Data
-				parseptr = strchr(buffer, ',')+1;
-				//parseptr = strchr(parseptr, ',')+1;
-				time = parsenumber(parseptr, 2);					// GPS UTC time hhmmss.ss
-				parseptr = strchr(parseptr, ',')+1;
-				aux_deg = parsedecimal(parseptr, 2);			// degrees
-				aux_min = parsenumber(parseptr + 2, 4);		 // minutes (sexagesimal) => Convert to decimal
-				latitude = aux_deg * 10000000 + (aux_min * 50) / 3;	 // degrees + minutes / 0.6	( * 10000000) (0.6 = 3 / 5)
-				parseptr = strchr(parseptr, ',')+1;
-				if ( * parseptr == 'S')
-					latitude = -1 * latitude;							// South latitudes are negative
-				parseptr = strchr(parseptr, ',')+1;
-				// W longitudes are Negative
-				aux_deg = parsedecimal(parseptr, 3);			// degrees
-				aux_min = parsenumber(parseptr + 3, 4);		 // minutes (sexagesimal)
-				longitude = aux_deg * 10000000 + (aux_min * 50) / 3;	// degrees + minutes / 0.6 ( * 10000000)
-				//longitude = -1*longitude;									 // This Assumes that we are in W longitudes...
-				parseptr = strchr(parseptr, ',')+1;
-				if ( * parseptr == 'W')
-					longitude = -1 * longitude;							// West longitudes are negative
-				parseptr = strchr(parseptr, ',')+1;
-				fix = parsedecimal(parseptr, 1);
-				parseptr = strchr(parseptr, ',')+1;
-				num_sats = parsedecimal(parseptr, 2);
-				parseptr = strchr(parseptr, ',')+1; 
-				HDOP = parsenumber(parseptr, 1);					// HDOP * 10
-				parseptr = strchr(parseptr, ',')+1;
-				altitude = parsenumber(parseptr, 1) * 100;	// altitude in decimeters * 100 = milimeters
-				if (fix < 1)
-					quality = 0;			// No FIX
-				else if(num_sats < 5)
-					quality = 1;			// Bad (Num sats < 5)
-				else if(HDOP > 30)
-					quality = 2;			// Poor (HDOP > 30)
-				else if(HDOP > 25)
-					quality = 3;			// Medium (HDOP > 25)
-				else
-					quality = 4;			// Good (HDOP < 25)
-			} else {
-				_error("GPSERR: Checksum error!!\n");
-			}
-		}
-	} else if (strncmp(buffer,"$GPVTG",6)==0){				// Check if sentence begins with $GPVTG
-		//Serial.println(buffer);
-		if (buffer[bufferidx-4]=='*'){					 // Check for the "*" character
-			NMEA_check = parseHex(buffer[bufferidx - 3]) * 16 + parseHex(buffer[bufferidx - 2]);		// Read the checksums characters
-			if (GPS_checksum == NMEA_check){			// Checksum validation
-				_setTime();
-				valid_read = true;
-				new_data = true;	// New GPS Data
-				parseptr = strchr(buffer, ',')+1;
-				ground_course = parsenumber(parseptr, 1) * 10;			// Ground course in degrees * 100
-				parseptr = strchr(parseptr, ',')+1;
-				parseptr = strchr(parseptr, ',')+1;
-				parseptr = strchr(parseptr, ',')+1;
-				parseptr = strchr(parseptr, ',')+1;
-				parseptr = strchr(parseptr, ',')+1;
-				parseptr = strchr(parseptr, ',')+1;
-				ground_speed = parsenumber(parseptr, 1) * 100 / 36; // Convert Km / h to m / s ( * 100)
-				//GPS_line = true;
-			} else {
-				_error("GPSERR: Checksum error!!\n");
-			}
-		}
-	} else {
-		bufferidx = 0;
-		_error("GPSERR: Bad sentence!!\n");
-	}
-}
-
-
- // Parse hexadecimal numbers
-uint8_t
-AP_GPS_NMEA::parseHex(char c) {
-		if (c < '0')
-			return (0);
-		if (c <= '9')
-			return (c - '0');
-		if (c < 'A')
-			 return (0);
-		if (c <= 'F')
-			 return ((c - 'A')+10);
-}
-
-// Decimal number parser
-long
-AP_GPS_NMEA::parsedecimal(char *str, uint8_t num_car) {
-	long d = 0;
-	uint8_t i;
-	
-	i = num_car;
-	while ((str[0] != 0) && (i > 0)) {
-		if ((str[0] > '9') || (str[0] < '0'))
-			return d;
-		d *= 10;
-		d += str[0] - '0';
-		str++;
-		i--;
-	}
-	return d;
-}
-
-// Function to parse fixed point numbers (numdec=number of decimals)
-long
-AP_GPS_NMEA::parsenumber(char *str, uint8_t numdec) {
-	long d = 0;
-	uint8_t ndec = 0;
-	
-	while (str[0] != 0) {
-		 if (str[0] == '.'){
-			 ndec = 1;
-		} else {
-			if ((str[0] > '9') || (str[0] < '0'))
-				return d;
-			d *= 10;
-			d += str[0] - '0';
-			if (ndec > 0)
-				ndec++;
-			if (ndec > numdec)	 // we reach the number of decimals...
-				return d;
-		}
-		str++;
-	}
-	return d;
+	if (fix < 1)
+		quality = 0;			// No FIX
+	else if(num_sats < 5)
+		quality = 1;			// Bad (Num sats < 5)
+	else if(HDOP > 30)
+		quality = 2;			// Poor (HDOP > 30)
+	else if(HDOP > 25)
+		quality = 3;			// Medium (HDOP > 25)
+	else
+		quality = 4;			// Good (HDOP < 25)
 }
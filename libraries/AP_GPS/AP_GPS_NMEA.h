@@ -3,7 +3,7 @@
 #define AP_GPS_NMEA_h
 
 #include <GPS.h>
-#define GPS_BUFFERSIZE 120 
+#include <NMEAParser.h>
 
 #define NMEA_OUTPUT_SENTENCES 	"$PMTK314,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0*28\r\n" //Set GPGGA and GPVTG
 
@@ -44,16 +44,10 @@ class AP_GPS_NMEA : public GPS
 	int HDOP;            // HDOP
 
   private:
-    // Internal variables
-    uint8_t GPS_checksum;
-    uint8_t GPS_checksum_calc;
-	char buffer[GPS_BUFFERSIZE];
-	int bufferidx;
-
-	void parse_nmea_gps(void);
-	uint8_t parseHex(char c);
-	long parsedecimal(char *str,uint8_t num_car);
-	long parsenumber(char *str,uint8_t numdec);
+	NMEAParser _nmea;
+	unsigned long _checksum_errors;
+
+	void _fix_quality(void);
 
 };
 
@@ -12,6 +12,7 @@
 #define AP_GPS_SIRF_h
 
 #include <GPS.h>
+#include "AP_GPS_Framer.h"
 
 #define SIRF_SET_BINARY	"$PSRF100,0,38400,8,1,0*3C"
 
@@ -22,6 +23,9 @@ public:
 	virtual void   	init();
 	virtual void	update();
 
+	/// SiRF framing and the messages decoded, also used by auto-detection
+	static const AP_GPS_Framer::protocol protocol;
+
 private:
 #pragma pack(1)
 	struct sirf_geonav {
@@ -75,22 +79,19 @@ private:
 	};
 
 
-	// State machine state
-	uint8_t			_step;
-	uint16_t		_checksum;
-	bool			_gather;
-	uint16_t		_payload_length;
-	uint16_t		_payload_counter;
-	uint8_t			_msg_id;
-
 	// Message buffer
 	union {
 		sirf_geonav		nav;
 		uint8_t			bytes[];
 	} _buffer;
 
+	AP_GPS_Framer		_framer;
+
+	// Message tables
+	static const AP_GPS_Framer::field	_geonav_fields[];
+	static const AP_GPS_Framer::message	_messages[];
+
 	void			_parse_gps(void);
-	void			_accumulate(uint8_t val);
 };
 
 #endif // AP_GPS_SIRF_h
@@ -12,9 +12,58 @@
 #include "AP_GPS_UBLOX.h"
 #include "WProgram.h"
 
+// Message tables //////////////////////////////////////////////////////////////
+
+#define FIELD(msg, member, type, target, scale) \
+	{ offsetof(msg, member), AP_GPS_Framer::type, AP_GPS_Framer::target, scale }
+
+const AP_GPS_Framer::field AP_GPS_UBLOX::_posllh_fields[] = {
+	FIELD(ubx_nav_posllh, time,			U32, TIME,			0),
+	FIELD(ubx_nav_posllh, longitude,	S32, LONGITUDE,		0),
+	FIELD(ubx_nav_posllh, latitude,		S32, LATITUDE,		0),
+	FIELD(ubx_nav_posllh, altitude_msl,	S32, ALTITUDE,		-10)	// mm to cm
+};
+
+const AP_GPS_Framer::field AP_GPS_UBLOX::_solution_fields[] = {
+	FIELD(ubx_nav_solution, satellites,	U8,  NUM_SATS,		0)
+};
+
+const AP_GPS_Framer::field AP_GPS_UBLOX::_velned_fields[] = {
+	FIELD(ubx_nav_velned, speed_3d,		U32, SPEED_3D,		0),		// cm/s
+	FIELD(ubx_nav_velned, speed_2d,		U32, GROUND_SPEED,	0),		// cm/s
+	FIELD(ubx_nav_velned, heading_2d,	S32, GROUND_COURSE,	-1000)	// deg * 100000 to deg * 100
+};
+
+const AP_GPS_Framer::field AP_GPS_UBLOX::_pvt_fields[] = {
+	FIELD(ubx_nav_pvt, time,			U32, TIME,			0),
+	FIELD(ubx_nav_pvt, satellites,		U8,  NUM_SATS,		0),
+	FIELD(ubx_nav_pvt, longitude,		S32, LONGITUDE,		0),
+	FIELD(ubx_nav_pvt, latitude,		S32, LATITUDE,		0),
+	FIELD(ubx_nav_pvt, altitude_msl,	S32, ALTITUDE,		-10),	// mm to cm
+	FIELD(ubx_nav_pvt, speed_2d,		S32, GROUND_SPEED,	-10),	// mm/s to cm/s
+	FIELD(ubx_nav_pvt, heading_2d,		S32, GROUND_COURSE,	-1000)
+};
+
+#define MESSAGE(id, msg, fields) \
+	{ CLASS_NAV, id, sizeof(msg), fields, sizeof(fields) / sizeof(fields[0]) }
+
+const AP_GPS_Framer::message AP_GPS_UBLOX::_messages[] = {
+	MESSAGE(MSG_POSLLH,	ubx_nav_posllh,		_posllh_fields),
+	{ CLASS_NAV, MSG_STATUS, sizeof(ubx_nav_status), NULL, 0 },
+	MESSAGE(MSG_SOL,	ubx_nav_solution,	_solution_fields),
+	MESSAGE(MSG_VELNED,	ubx_nav_velned,		_velned_fields),
+	MESSAGE(MSG_PVT,	ubx_nav_pvt,		_pvt_fields)
+};
+
+const AP_GPS_Framer::protocol AP_GPS_UBLOX::protocol = {
+	AP_GPS_Framer::UBX, _messages, sizeof(_messages) / sizeof(_messages[0])
+};
+
 // Constructors ////////////////////////////////////////////////////////////////
 
-AP_GPS_UBLOX::AP_GPS_UBLOX(Stream *s) : GPS(s)
+AP_GPS_UBLOX::AP_GPS_UBLOX(Stream *s) :
+	GPS(s),
+	_framer(protocol, &_buffer, sizeof(_buffer))
 {
 }
 
@@ -30,135 +79,19 @@ void AP_GPS_UBLOX::init(void)
 
 // Process bytes available from the stream
 //
-// The stream is assumed to contain only messages we recognise.  If it
-// contains other messages, and those messages contain the preamble
-// bytes, it is possible for this code to fail to synchronise to the
-// stream immediately.  Without buffering the entire message and
-// re-processing it from the top, this is unavoidable. The parser
-// attempts to avoid this when possible.
+// Framing and checksums are handled by AP_GPS_Framer; messages other than
+// the ones in the table are skipped using their length, so the preamble
+// appearing as data in them does not cost us synchronisation.
 //
 void AP_GPS_UBLOX::update(void)
 {
-	byte data;
 	int numc;
 
 	numc = _port->available();
-	for (int i = 0; i < numc; i++){	// Process bytes received
-
-		// read the next byte
-		data = _port->read();
-
-		switch(_step){
-
-			// Message preamble detection
-			//
-			// If we fail to match any of the expected bytes, we reset
-			// the state machine and re-consider the failed byte as
-			// the first byte of the preamble.  This improves our
-			// chances of recovering from a mismatch and makes it less
-			// likely that we will be fooled by the preamble appearing
-			// as data in some other message.
-			//
-		case 1:
-			if (PREAMBLE2 == data) {
-				_step++;
-				break;
-			}
-			_step = 0;
-			// FALLTHROUGH
-		case 0:
-			if(PREAMBLE1 == data)
-				_step++;
-			break;
-
-			// Message header processing
-			//
-			// We sniff the class and message ID to decide whether we
-			// are going to gather the message bytes or just discard
-			// them.
-			//
-			// We always collect the length so that we can avoid being
-			// fooled by preamble bytes in messages.
-			//
-		case 2:
-			_step++;
-			if (CLASS_NAV == data) {
-				_gather = true;					// class is interesting, maybe gather
-				_ck_b = _ck_a = data;				// reset the checksum accumulators
-			} else {
-				_error("ignoring class 0x%x\n", (int)data);
-				_gather = false;				// class is not interesting, discard
-			}
-			break;
-		case 3:
-			_step++;
-			_ck_b += (_ck_a += data);			// checksum byte
-			_msg_id = data;
-			if (_gather) {						// if class was interesting
-				switch(data) {
-				case MSG_POSLLH:				// message is interesting
-					_expect = sizeof(ubx_nav_posllh);
-					break;
-				case MSG_STATUS:
-					_expect = sizeof(ubx_nav_status);
-					break;
-				case MSG_SOL:
-					_expect = sizeof(ubx_nav_solution);
-					break;
-				case MSG_VELNED:
-					_expect = sizeof(ubx_nav_velned);
-					break;
-				default:
-					_error("ignoring message 0x%x\n", (int)data);
-					_gather = false;			// message is not interesting
-				}
-			}
-			break;
-		case 4:
-			_step++;
-			_ck_b += (_ck_a += data);				// checksum byte
-			_payload_length = data;				// payload length low byte
-			break;
-		case 5:
-			_step++;
-			_ck_b += (_ck_a += data);				// checksum byte
-			_payload_length += (uint16_t)data;	// payload length high byte
-			_payload_counter = 0;				// prepare to receive payload
-			if (_payload_length != _expect) {
-				_error("payload %d expected %d\n", _payload_length, _expect);
-				_gather = false;
-			}
-			break;
-
-			// Receive message data
-			//
-		case 6:
-			_ck_b += (_ck_a += data);				// checksum byte
-			if (_gather)						// gather data if requested
-				_buffer.bytes[_payload_counter] = data;
-			if (++_payload_counter == _payload_length)
-				_step++;
-			break;
-
-			// Checksum and message processing
-			//
-		case 7:
-			_step++;
-			if (_ck_a != data) {
-				_error("GPS_UBLOX: checksum error\n");
-				_step = 0;
-			}
-			break;
-		case 8:
-			_step = 0;
-			if (_ck_b != data) {
-				_error("GPS_UBLOX: checksum error\n");
-				break;
-			}
-			if (_gather)
-				_parse_gps();					 // Parse the new GPS packet
-		}
-	} 
+	while (numc--) {
+		if (_framer.frame(_port->read()))
+			_parse_gps();
+	}
 }
 
 // Private Methods /////////////////////////////////////////////////////////////
@@ -166,24 +99,18 @@ void AP_GPS_UBLOX::update(void)
 void
 AP_GPS_UBLOX::_parse_gps(void)
 {
-	switch (_msg_id) {
-	case MSG_POSLLH:
-		time		= _buffer.posllh.time;
-		longitude	= _buffer.posllh.longitude;
-		latitude	= _buffer.posllh.latitude;
-		altitude	= _buffer.posllh.altitude_msl / 10;
-		break;
+	_framer.decode(this);
+
+	switch (_framer.current()->msg_id) {
 	case MSG_STATUS:
 		fix			= (_buffer.status.fix_status & NAV_STATUS_FIX_VALID) && (_buffer.status.fix_type == FIX_3D);
 		break;
 	case MSG_SOL:
 		fix			= (_buffer.solution.fix_status & NAV_STATUS_FIX_VALID) && (_buffer.solution.fix_type == FIX_3D);
-		num_sats	= _buffer.solution.satellites;
 		break;
-	case MSG_VELNED:
-		speed_3d	= _buffer.velned.speed_3d;				// cm/s
-		ground_speed = _buffer.velned.speed_2d;				// cm/s
-		ground_course = _buffer.velned.heading_2d / 1000;	// Heading 2D deg * 100000 rescaled to deg * 100
+	case MSG_PVT:
+		fix			= (_buffer.pvt.fix_status & NAV_STATUS_FIX_VALID) && (_buffer.pvt.fix_type == FIX_3D);
+		speed_3d	= sqrt(sq((float)_buffer.pvt.speed_2d) + sq((float)_buffer.pvt.ned_down)) / 10;	// mm/s to cm/s
 		break;
 	}
 	_setTime();
@@ -12,6 +12,7 @@
 #define AP_GPS_UBLOX_h
 
 #include <GPS.h>
+#include "AP_GPS_Framer.h"
 
 #define UBLOX_SET_BINARY	"$PUBX,41,1,0003,0001,38400,0*26"
 
@@ -23,6 +24,9 @@ public:
 	void		init(void);
 	void		update();
 
+	/// UBX framing and the messages decoded, also used by auto-detection
+	static const AP_GPS_Framer::protocol protocol;
+
 private:
 	// u-blox UBX protocol essentials
 #pragma pack(1)
@@ -74,6 +78,40 @@ private:
 		uint32_t	speed_accuracy;
 		uint32_t	heading_accuracy;
 	};
+	struct ubx_nav_pvt {
+		uint32_t	time;				// GPS msToW
+		uint16_t	year;
+		uint8_t		month;
+		uint8_t		day;
+		uint8_t		hour;
+		uint8_t		min;
+		uint8_t		sec;
+		uint8_t		valid;
+		uint32_t	time_accuracy;
+		int32_t		time_nsec;
+		uint8_t		fix_type;
+		uint8_t		fix_status;
+		uint8_t		fix_status2;
+		uint8_t		satellites;
+		int32_t		longitude;
+		int32_t		latitude;
+		int32_t		altitude_ellipsoid;
+		int32_t		altitude_msl;
+		uint32_t	horizontal_accuracy;
+		uint32_t	vertical_accuracy;
+		int32_t		ned_north;			// mm/s
+		int32_t		ned_east;
+		int32_t		ned_down;
+		int32_t		speed_2d;
+		int32_t		heading_2d;
+		uint32_t	speed_accuracy;
+		uint32_t	heading_accuracy;
+		uint16_t	position_DOP;
+		uint8_t		res[6];
+		int32_t		heading_vehicle;
+		int16_t		magnetic_declination;
+		uint16_t	magnetic_accuracy;
+	};
 #pragma pack(pop)
 	enum ubs_protocol_bytes {
 		PREAMBLE1 = 0xb5,
@@ -82,7 +120,8 @@ private:
 		MSG_POSLLH = 0x2,
 		MSG_STATUS = 0x3,
 		MSG_SOL = 0x6,
-		MSG_VELNED = 0x12
+		MSG_VELNED = 0x12,
+		MSG_PVT = 0x7
 	};
 	enum ubs_nav_fix_type {
 		FIX_NONE = 0,
@@ -96,27 +135,25 @@ private:
 		NAV_STATUS_FIX_VALID = 1
 	};
 
-	// Packet checksum accumulators
-	uint8_t		_ck_a;
-	uint8_t		_ck_b;
-
-	// State machine state
-	uint8_t		_step;
-	uint8_t		_msg_id;
-	bool   		_gather;
-	uint16_t	_expect;
-	uint16_t	_payload_length;
-	uint16_t	_payload_counter;
-
 	// Receive buffer
 	union {
 		ubx_nav_posllh		posllh;
 		ubx_nav_status		status;
 		ubx_nav_solution	solution;
 		ubx_nav_velned		velned;
+		ubx_nav_pvt			pvt;
 		uint8_t	bytes[];
 	} _buffer;
 
+	AP_GPS_Framer	_framer;
+
+	// Message tables
+	static const AP_GPS_Framer::field	_posllh_fields[];
+	static const AP_GPS_Framer::field	_solution_fields[];
+	static const AP_GPS_Framer::field	_velned_fields[];
+	static const AP_GPS_Framer::field	_pvt_fields[];
+	static const AP_GPS_Framer::message	_messages[];
+
 	// Buffer parse & GPS state update
 	void		_parse_gps();
 };
@@ -89,21 +89,6 @@ protected:
 	///
 	void	_setTime(void);
 
-	/// perform an endian swap on a long
-	///
-	/// @param	bytes		pointer to a buffer containing bytes representing a
-	///						long in the wrong byte order
-	/// @returns			endian-swapped value
-	///
-	long	_swapl(const void *bytes);
-
-	/// perform an endian swap on an int
-	///
-	/// @param	bytes		pointer to a buffer containing bytes representing an
-	///						int in the wrong byte order
-	///	@returns			endian-swapped value
-	int		_swapi(const void *bytes);
-
 	/// emit an error message
 	///
 	/// based on the value of print_errors, emits the printf-formatted message
@@ -118,36 +103,4 @@ protected:
 	
 };
 
-inline long
-GPS::_swapl(const void *bytes)
-{
-	const uint8_t	*b = (const uint8_t *)bytes;
-	union {
-		long	v;
-		uint8_t b[4];
-	} u;
-
-	u.b[0] = b[3];
-	u.b[1] = b[2];
-	u.b[2] = b[1];
-	u.b[3] = b[0];
-
-	return(u.v);
-}
-
-inline int16_t
-GPS::_swapi(const void *bytes)
-{
-	const uint8_t	*b = (const uint8_t *)bytes;
-	union {
-		int16_t	v;
-		uint8_t b[2];
-	} u;
-
-	u.b[0] = b[1];
-	u.b[1] = b[0];
-
-	return(u.v);
-}
-
 #endif
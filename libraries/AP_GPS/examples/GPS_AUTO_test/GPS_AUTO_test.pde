@@ -3,6 +3,7 @@
 //
 
 #include <FastSerial.h>
+#include <NMEAParser.h>
 #include <AP_GPS.h>
 #include <stdlib.h>
 
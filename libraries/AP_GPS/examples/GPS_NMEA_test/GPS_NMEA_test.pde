@@ -6,6 +6,7 @@
 */
 
 #include <FastSerial.h>
+#include <NMEAParser.h>
 #include <AP_GPS_NMEA.h>
 #include <stdio.h>
 
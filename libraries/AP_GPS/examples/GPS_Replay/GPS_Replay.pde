@@ -0,0 +1,172 @@
+/*
+	Replay of captured binary GPS logs through the UBLOX, MTK and SIRF drivers.
+
+	Each log is fed from flash through a Stream, decoded by its driver and
+	printed, then replayed in a loop to report the decoding time per message.
+	The u-blox log carries a message the driver does not decode, with the
+	preamble in its payload, NAV-POSLLH, STATUS, SOL, VELNED, a POSLLH with
+	a corrupted byte and NAV-PVT.  Each log is also offered to all three
+	framers at once, as auto-detection does.
+
+	Works on any board, output on Serial at 38400.
+*/
+
+#include <FastSerial.h>
+#include <NMEAParser.h>
+#include <AP_GPS.h>
+#include <avr/pgmspace.h>
+
+FastSerialPort0(Serial);
+
+#define REPLAYS 50
+
+const uint8_t ublox_log[] PROGMEM = {
+	0x01, 0xb5, 0x00, 0xb5, 0x62, 0x0a, 0x04, 0x28, 0x00, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01,
+	0x02, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01,
+	0x02, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01, 0x02, 0xb5, 0x62, 0x01,
+	0x02, 0x3a, 0x28, 0xb5, 0x62, 0x01, 0x02, 0x1c, 0x00, 0x00, 0xca, 0x5b, 0x07, 0x5e, 0xe2, 0x4d,
+	0x53, 0x81, 0x9d, 0x42, 0x15, 0x50, 0xc3, 0x00, 0x00, 0x6e, 0xb2, 0x00, 0x00, 0xe8, 0x03, 0x00,
+	0x00, 0xd0, 0x07, 0x00, 0x00, 0x95, 0x15, 0xb5, 0x62, 0x01, 0x03, 0x10, 0x00, 0x00, 0xca, 0x5b,
+	0x07, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x44, 0xc7, 0xb5,
+	0x62, 0x01, 0x06, 0x34, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x96, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0xde, 0xfe, 0xb5, 0x62, 0x01, 0x12, 0x24,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x14, 0x05, 0x00, 0x00, 0xb0, 0x04, 0x00, 0x00, 0xc0, 0xc8, 0x80, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x01, 0xb5, 0x62, 0x01, 0x02, 0x1c, 0x00, 0x00, 0xca, 0x5b,
+	0x07, 0x5f, 0xe2, 0x4d, 0x53, 0x81, 0x9d, 0x42, 0x15, 0x50, 0xc3, 0x00, 0x00, 0x6e, 0xb2, 0x00,
+	0x00, 0xe8, 0x03, 0x00, 0x00, 0xd0, 0x07, 0x00, 0x00, 0x95, 0x15, 0xb5, 0x62, 0x01, 0x07, 0x5c,
+	0x00, 0xe8, 0xcd, 0x5b, 0x07, 0xdc, 0x07, 0x03, 0x1a, 0x0c, 0x23, 0x13, 0x07, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x01, 0x00, 0x0c, 0x5f, 0xe2, 0x4d, 0x53, 0x82, 0x9d, 0x42,
+	0x15, 0x00, 0x00, 0x00, 0x00, 0x6f, 0xb2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x64, 0x00, 0x00, 0x00, 0xc8, 0x00, 0x00, 0x00, 0x0c, 0xfe, 0xff, 0xff, 0xe0, 0x2e, 0x00,
+	0x00, 0xc0, 0xc8, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x96, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2c, 0x99,
+};
+
+const uint8_t mtk_log[] PROGMEM = {
+	0xb5, 0x62, 0x01, 0x06, 0xb5, 0x62, 0x01, 0x05, 0x02, 0x20, 0x42, 0xf3, 0x08, 0x54, 0x96, 0xa3,
+	0x00, 0x00, 0x11, 0xd7, 0x00, 0x00, 0x04, 0xb0, 0x00, 0x80, 0xc8, 0xc0, 0x0a, 0x03, 0x07, 0x5b,
+	0xd1, 0xd0, 0xa6, 0xb4, 0xb5, 0x62, 0x01, 0x05, 0x02, 0x20, 0x42, 0xf3, 0x08, 0x54, 0x96, 0xa3,
+	0x00, 0x00, 0x11, 0xd7, 0x00, 0x00, 0x04, 0xb0, 0x00, 0x80, 0xc8, 0xc0, 0x0a, 0x03, 0x07, 0x5b,
+	0xd1, 0xd0, 0xa6, 0xb4,
+};
+
+const uint8_t sirf_log[] PROGMEM = {
+	0xa0, 0xa2, 0x00, 0x2a, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+	0xb0, 0xb3, 0xa0, 0xa2, 0x00, 0x5b, 0x29, 0x00, 0x00, 0x00, 0x02, 0x06, 0x90, 0x07, 0x5b, 0xd5,
+	0xb8, 0x07, 0xdc, 0x03, 0x1a, 0x0c, 0x23, 0x4a, 0x38, 0x00, 0x00, 0x00, 0x00, 0x15, 0x42, 0x9d,
+	0x83, 0x53, 0x4d, 0xe2, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb2, 0x70, 0x00, 0x04, 0xe2,
+	0x20, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x09,
+	0x00, 0x0a, 0xeb, 0xb0, 0xb3,
+};
+
+// A Stream reading a log from flash
+class ReplayStream : public Stream
+{
+public:
+	void		begin(const uint8_t *log, unsigned int length) { _log = log; _length = length; _pos = 0; }
+	int			available(void) { return _length - _pos; }
+	int			read(void) { return _pos < _length ? pgm_read_byte(_log + _pos++) : -1; }
+	int			peek(void) { return _pos < _length ? pgm_read_byte(_log + _pos) : -1; }
+	void		flush(void) {}
+#if ARDUINO >= 100
+	size_t		write(uint8_t c) { return 1; }
+#else
+	void		write(uint8_t c) {}
+#endif
+
+private:
+	const uint8_t	*_log;
+	unsigned int	_length;
+	unsigned int	_pos;
+};
+
+ReplayStream	replay;
+AP_GPS_UBLOX	ublox(&replay);
+AP_GPS_MTK		mtk(&replay);
+AP_GPS_SIRF		sirf(&replay);
+
+void show(const char *name, GPS &gps)
+{
+	Serial.print(name);
+	Serial.print(" Lat:");
+	Serial.print(gps.latitude);
+	Serial.print(" Lon:");
+	Serial.print(gps.longitude);
+	Serial.print(" Alt:");
+	Serial.print(gps.altitude);
+	Serial.print(" GSP:");
+	Serial.print(gps.ground_speed);
+	Serial.print(" COG:");
+	Serial.print(gps.ground_course);
+	Serial.print(" SPD3D:");
+	Serial.print(gps.speed_3d);
+	Serial.print(" SAT:");
+	Serial.print(gps.num_sats, DEC);
+	Serial.print(" FIX:");
+	Serial.print(gps.fix, DEC);
+	Serial.print(" TIM:");
+	Serial.println(gps.time);
+}
+
+// the framer that recognises the log first
+void detect(const char *name, const uint8_t *log, unsigned int length)
+{
+	AP_GPS_Framer	u(AP_GPS_UBLOX::protocol, NULL, 0);
+	AP_GPS_Framer	m(AP_GPS_MTK::protocol, NULL, 0);
+	AP_GPS_Framer	s(AP_GPS_SIRF::protocol, NULL, 0);
+	const char		*found = "nothing";
+
+	for (unsigned int i = 0; i < length; i++) {
+		uint8_t data = pgm_read_byte(log + i);
+		if (m.frame(data)) { found = "MTK"; break; }
+		if (u.frame(data)) { found = "u-blox"; break; }
+		if (s.frame(data)) { found = "SIRF"; break; }
+	}
+	Serial.print(name);
+	Serial.print(" log detected as ");
+	Serial.println(found);
+}
+
+// replays the log and returns microseconds per message
+float timing(GPS &gps, const uint8_t *log, unsigned int length, int messages)
+{
+	unsigned long start = micros();
+	for (int i = 0; i < REPLAYS; i++) {
+		replay.begin(log, length);
+		gps.update();
+	}
+	return (float)(micros() - start) / (REPLAYS * messages);
+}
+
+void run(const char *name, GPS &gps, const uint8_t *log, unsigned int length, int messages)
+{
+	replay.begin(log, length);
+	gps.update();
+	show(name, gps);
+	detect(name, log, length);
+	Serial.print(timing(gps, log, length, messages), 1);
+	Serial.println(" us/message");
+	Serial.println();
+}
+
+void setup()
+{
+	Serial.begin(38400);
+	Serial.println("GPS binary log replay");
+	Serial.println();
+
+	run("u-blox", ublox, ublox_log, sizeof(ublox_log), 7);
+	run("MTK", mtk, mtk_log, sizeof(mtk_log), 2);
+	run("SIRF", sirf, sirf_log, sizeof(sirf_log), 2);
+}
+
+void loop()
+{
+}
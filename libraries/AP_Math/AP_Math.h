@@ -5,3 +5,4 @@
 #include "vector2.h"
 #include "vector3.h"
 #include "matrix3.h"
+#include "fixed16.h"
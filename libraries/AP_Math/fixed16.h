@@ -0,0 +1,100 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: t -*-
+
+//	This library is free software; you can redistribute it and / or
+//	modify it under the terms of the GNU Lesser General Public
+//	License as published by the Free Software Foundation; either
+//	version 2.1 of the License, or (at your option) any later version.
+
+//
+// Q16.16 signed fixed-point number, for use as the element type of
+// Vector3<T> and Matrix3<T> on processors without an FPU.
+//
+// The range is about +/-32767 with a resolution of 1/65536.  Addition and
+// subtraction are plain 32-bit integer operations.  Multiplication on AVR is
+// done as four 16x16 bit products instead of a 64-bit multiply, which makes
+// it several times cheaper than a float multiply.  Division and conversion
+// to and from float are slow and should stay out of inner loops.
+//
+// In addition to the class, this header defines the following types:
+//
+// Vector3q		3D vector of Fixed16
+// Matrix3q		3x3 matrix of Fixed16
+//
+
+#ifndef FIXED16_H
+#define FIXED16_H
+
+#include <stdint.h>
+#include <math.h>
+#include "vector3.h"
+#include "matrix3.h"
+
+class Fixed16 {
+public:
+	int32_t raw;
+
+	Fixed16(): raw(0) {}
+	Fixed16(const int v): raw((int32_t)v << 16) {}
+	Fixed16(const long v): raw((int32_t)v << 16) {}
+	Fixed16(const float v): raw((int32_t)(v * 65536.0f + (v < 0 ? -0.5f : 0.5f))) {}
+	Fixed16(const double v): raw((int32_t)(v * 65536.0 + (v < 0 ? -0.5 : 0.5))) {}
+
+	static Fixed16 from_raw(const int32_t r)
+	{	Fixed16 f; f.raw = r; return f;	}
+
+	float to_float() const
+	{	return raw * (1.0f / 65536.0f);	}
+
+	// product of two Q16.16 values, rounded down
+	static int32_t mul(const int32_t a, const int32_t b)
+	{
+#if defined(__AVR__)
+		int16_t ah = a >> 16, bh = b >> 16;
+		uint16_t al = a, bl = b;
+		return ((int32_t)ah * bh << 16)
+			+ (int32_t)ah * bl
+			+ (int32_t)bh * al
+			+ (int32_t)(((uint32_t)al * bl) >> 16);
+#else
+		return (int32_t)(((int64_t)a * b) >> 16);
+#endif
+	}
+
+	Fixed16 operator -(void) const			{	return from_raw(-raw);	}
+	Fixed16 operator +(const Fixed16 &v) const	{	return from_raw(raw + v.raw);	}
+	Fixed16 operator -(const Fixed16 &v) const	{	return from_raw(raw - v.raw);	}
+	Fixed16 operator *(const Fixed16 &v) const	{	return from_raw(mul(raw, v.raw));	}
+	Fixed16 operator /(const Fixed16 &v) const
+	{	return from_raw((int32_t)(((int64_t)raw << 16) / v.raw));	}
+
+	Fixed16 &operator +=(const Fixed16 &v)	{	raw += v.raw; return *this;	}
+	Fixed16 &operator -=(const Fixed16 &v)	{	raw -= v.raw; return *this;	}
+	Fixed16 &operator *=(const Fixed16 &v)	{	raw = mul(raw, v.raw); return *this;	}
+	Fixed16 &operator /=(const Fixed16 &v)	{	return *this = *this / v;	}
+
+	// scaling by a power of two
+	Fixed16 operator >>(const uint8_t s) const	{	return from_raw(raw >> s);	}
+	Fixed16 operator <<(const uint8_t s) const	{	return from_raw(raw << s);	}
+
+	bool operator ==(const Fixed16 &v) const	{	return raw == v.raw;	}
+	bool operator !=(const Fixed16 &v) const	{	return raw != v.raw;	}
+	bool operator <(const Fixed16 &v) const	{	return raw < v.raw;	}
+	bool operator >(const Fixed16 &v) const	{	return raw > v.raw;	}
+	bool operator <=(const Fixed16 &v) const	{	return raw <= v.raw;	}
+	bool operator >=(const Fixed16 &v) const	{	return raw >= v.raw;	}
+};
+
+// conversions used by templates that work on both float and Fixed16
+static inline float to_float(const float v)		{	return v;	}
+static inline float to_float(const Fixed16 v)	{	return v.to_float();	}
+
+// v / 2^s
+static inline float scale_down(const float v, const uint8_t s)		{	return ldexp(v, -s);	}
+static inline Fixed16 scale_down(const Fixed16 v, const uint8_t s)	{	return v >> s;	}
+
+static inline Fixed16 sqrt(const Fixed16 v)	{	return Fixed16(sqrtf(v.to_float()));	}
+
+typedef Vector3<Fixed16>	Vector3q;
+typedef Matrix3<Fixed16>	Matrix3q;
+
+#endif // FIXED16_H
@@ -27,6 +27,8 @@
 // Matrix3ul	3x3 matrix of unsigned longs
 // Matrix3f		3x3 matrix of signed floats
 //
+// fixed16.h adds Matrix3q, a 3x3 matrix of Q16.16 fixed-point values.
+//
 
 #ifndef MATRIX3_H
 #define MATRIX3_H
@@ -113,6 +115,19 @@ public:
 	Matrix3<T> &operator *=(const Matrix3<T> &m)
 	{	return *this = *this * m;	}
 
+	// apply an incremental rotation g (radians about x, y and z):
+	// *this += *this * skew(g), each row r becomes r + r % g.  This is the
+	// DCM update with 18 multiplies instead of the 27 of a full product.
+	void rotate(const Vector3<T> &g)
+	{
+		Vector3<T> ra(a.y * g.z - a.z * g.y, a.z * g.x - a.x * g.z, a.x * g.y - a.y * g.x);
+		Vector3<T> rb(b.y * g.z - b.z * g.y, b.z * g.x - b.x * g.z, b.x * g.y - b.y * g.x);
+		Vector3<T> rc(c.y * g.z - c.z * g.y, c.z * g.x - c.x * g.z, c.x * g.y - c.y * g.x);
+		a += ra;
+		b += rb;
+		c += rc;
+	}
+
 	// transpose the matrix
 	Matrix3<T> transposed(void)
 	{
@@ -0,0 +1,118 @@
+/*
+ * CRC.cpp
+ *
+ *  CRC tables and buffer updates, see CRC.h
+ */
+
+#include "CRC.h"
+
+#define CRC8_MAXIM(i) ((uint8_t) CRC_ENTRY(0x8cUL, 8, true, i))
+#define CRC16_ARC(i) ((uint16_t) CRC_ENTRY(0xa001UL, 16, true, i))
+#define CRC7_SD(i) ((uint8_t) CRC_ENTRY(0x12UL, 8, false, i))
+#define CRC16_CCITT(i) ((uint16_t) CRC_ENTRY(0x1021UL, 16, false, i))
+#define CRC8_RFCOMM(i) ((uint8_t) CRC_ENTRY(0xe0UL, 8, true, i))
+#define CRC32(i) ((uint32_t) CRC_ENTRY(0xedb88320UL, 32, true, i))
+
+const uint8_t crc8MaximTable[256] CRC_PROGMEM = { CRC_TABLE(CRC8_MAXIM) };
+const uint16_t crc16ArcTable[256] CRC_PROGMEM = { CRC_TABLE(CRC16_ARC) };
+const uint8_t crc7SdTable[256] CRC_PROGMEM = { CRC_TABLE(CRC7_SD) };
+const uint16_t crc16CcittTable[256] CRC_PROGMEM = { CRC_TABLE(CRC16_CCITT) };
+const uint8_t crc8RfcommTable[256] CRC_PROGMEM = { CRC_TABLE(CRC8_RFCOMM) };
+const uint32_t crc32Table[256] CRC_PROGMEM = { CRC_TABLE(CRC32) };
+
+uint8_t crc8Maxim(uint8_t crc, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+	while (n--)
+		crc = crc8MaximByte(crc, *p++);
+	return crc;
+}
+
+uint16_t crc16Arc(uint16_t crc, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+	while (n--)
+		crc = crc16ArcByte(crc, *p++);
+	return crc;
+}
+
+uint8_t crc7Sd(uint8_t crc, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+	while (n--)
+		crc = crc7SdByte(crc, *p++);
+	return crc;
+}
+
+uint8_t crc8Rfcomm(uint8_t crc, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+	while (n--)
+		crc = crc8RfcommByte(crc, *p++);
+	return crc;
+}
+
+uint8_t sum8(uint8_t sum, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+	while (n--)
+		sum += *p++;
+	return sum;
+}
+
+#if CRC_SLICE > 1
+// slice[k][x] is the CRC of byte x followed by k zeros
+static uint16_t ccittSlice[CRC_SLICE][256];
+static uint32_t crc32Slice[CRC_SLICE][256];
+static bool sliced = false;
+
+static void fillSlices() {
+	for (int x = 0; x < 256; x++) {
+		ccittSlice[0][x] = crcRead16(crc16CcittTable, x);
+		crc32Slice[0][x] = crcRead32(crc32Table, x);
+	}
+	for (int k = 1; k < CRC_SLICE; k++)
+		for (int x = 0; x < 256; x++) {
+			uint16_t c = ccittSlice[k - 1][x];
+			ccittSlice[k][x] = (c << 8) ^ crcRead16(crc16CcittTable, c >> 8);
+			uint32_t d = crc32Slice[k - 1][x];
+			crc32Slice[k][x] = (d >> 8) ^ crcRead32(crc32Table, d & 0xff);
+		}
+	sliced = true;
+}
+#endif
+
+uint16_t crc16Ccitt(uint16_t crc, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+#if CRC_SLICE > 1
+	if (!sliced)
+		fillSlices();
+	for (; n >= CRC_SLICE; n -= CRC_SLICE, p += CRC_SLICE) {
+		uint16_t c = ccittSlice[CRC_SLICE - 1][(crc >> 8) ^ p[0]]
+				^ ccittSlice[CRC_SLICE - 2][(crc & 0xff) ^ p[1]];
+		for (int k = 2; k < CRC_SLICE; k++)
+			c ^= ccittSlice[CRC_SLICE - 1 - k][p[k]];
+		crc = c;
+	}
+#endif
+	while (n--)
+		crc = crc16CcittByte(crc, *p++);
+	return crc;
+}
+
+uint32_t crc32(uint32_t crc, const void * data, size_t n) {
+	const uint8_t * p = (const uint8_t *) data;
+#if CRC_SLICE >= 4
+	if (!sliced)
+		fillSlices();
+	for (; n >= CRC_SLICE; n -= CRC_SLICE, p += CRC_SLICE) {
+		uint32_t one = crc ^ (p[0] | (uint32_t) p[1] << 8
+				| (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+		uint32_t c = crc32Slice[CRC_SLICE - 1][one & 0xff]
+				^ crc32Slice[CRC_SLICE - 2][(one >> 8) & 0xff]
+				^ crc32Slice[CRC_SLICE - 3][(one >> 16) & 0xff]
+				^ crc32Slice[CRC_SLICE - 4][one >> 24];
+		for (int k = 4; k < CRC_SLICE; k++)
+			c ^= crc32Slice[CRC_SLICE - 1 - k][p[k]];
+		crc = c;
+	}
+#endif
+	while (n--)
+		crc = crc32Byte(crc, *p++);
+	return crc;
+}
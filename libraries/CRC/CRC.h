@@ -0,0 +1,128 @@
+/*
+ * CRC.h
+ *
+ *  Table driven CRCs for the protocols the libraries speak, and the 8 bit
+ *  sum used by the NFC readers and the ThinkGear headsets.
+ *
+ *   crc8Maxim     1-Wire ROM and scratchpad, reflected 0x31, start 0
+ *   crc16Arc      1-Wire CRC16, reflected 0x8005, start 0; the bus sends
+ *                 it inverted
+ *   crc7Sd        SD commands, 0x09 kept in the top seven bits, start 0;
+ *                 the command byte is crc7Sd(0, cmd, 5) | 1
+ *   crc16Ccitt    SD data blocks, XMODEM, 0x1021, start 0
+ *   crc8Rfcomm    RFCOMM FCS (GSM 07.10), reflected 0x07, start 0xff; the
+ *                 FCS is 0xff minus the CRC
+ *   crc32         zlib, reflected 0x04c11db7, start 0xffffffff; the CRC is
+ *                 the complement of the result
+ *   sum8          plain sum of the bytes
+ *
+ *  Every function takes the value so far and returns it updated, so a
+ *  message can be run through in pieces as it arrives; the ...Byte forms
+ *  are inline for one byte at a time.
+ *
+ *  The 256 entry tables are generated by the compiler from the polynomial
+ *  (CrcEntry below) and kept in flash on AVR.  On other targets
+ *  crc16Ccitt and crc32 read CRC_SLICE bytes per step through tables of
+ *  bytes followed by zeros, filled in RAM on first use.
+ */
+
+#ifndef CRC_H_
+#define CRC_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define CRC_PROGMEM PROGMEM
+#define crcRead8(table, i) pgm_read_byte((table) + (i))
+#define crcRead16(table, i) pgm_read_word((table) + (i))
+#define crcRead32(table, i) pgm_read_dword((table) + (i))
+#else
+#define CRC_PROGMEM
+#define crcRead8(table, i) ((table)[i])
+#define crcRead16(table, i) ((table)[i])
+#define crcRead32(table, i) ((table)[i])
+#endif
+
+// bytes per step of crc16Ccitt and crc32, 1 for a single table
+#ifndef CRC_SLICE
+#ifdef __AVR__
+#define CRC_SLICE 1
+#else
+#define CRC_SLICE 8
+#endif
+#endif
+
+/*
+ * Table entry for byte C of a width W CRC with polynomial P, shifted out
+ * K more bits, the low bit first when reflected.
+ */
+template <unsigned long P, uint8_t W, bool R, unsigned long C, uint8_t K = 8>
+struct CrcEntry {
+	static const unsigned long mask = (((1UL << (W - 1)) - 1) << 1) | 1;
+	static const unsigned long next = R ? (C >> 1) ^ (C & 1 ? P : 0)
+			: ((C << 1) ^ (C >> (W - 1) & 1 ? P : 0)) & mask;
+	static const unsigned long value = CrcEntry<P, W, R, next, K - 1>::value;
+};
+
+template <unsigned long P, uint8_t W, bool R, unsigned long C>
+struct CrcEntry<P, W, R, C, 0> {
+	static const unsigned long value = C;
+};
+
+#define CRC_ENTRY(P, W, R, i) \
+	CrcEntry<P, W, R, (R) ? (unsigned long) (i) : (unsigned long) (i) << ((W) - 8)>::value
+#define CRC_ROW(M, i) \
+	M(i), M(i + 1), M(i + 2), M(i + 3), M(i + 4), M(i + 5), M(i + 6), M(i + 7), \
+	M(i + 8), M(i + 9), M(i + 10), M(i + 11), M(i + 12), M(i + 13), M(i + 14), M(i + 15)
+// all 256 entries of M(i)
+#define CRC_TABLE(M) \
+	CRC_ROW(M, 0x00), CRC_ROW(M, 0x10), CRC_ROW(M, 0x20), CRC_ROW(M, 0x30), \
+	CRC_ROW(M, 0x40), CRC_ROW(M, 0x50), CRC_ROW(M, 0x60), CRC_ROW(M, 0x70), \
+	CRC_ROW(M, 0x80), CRC_ROW(M, 0x90), CRC_ROW(M, 0xa0), CRC_ROW(M, 0xb0), \
+	CRC_ROW(M, 0xc0), CRC_ROW(M, 0xd0), CRC_ROW(M, 0xe0), CRC_ROW(M, 0xf0)
+
+extern const uint8_t crc8MaximTable[256] CRC_PROGMEM;
+extern const uint16_t crc16ArcTable[256] CRC_PROGMEM;
+extern const uint8_t crc7SdTable[256] CRC_PROGMEM;
+extern const uint16_t crc16CcittTable[256] CRC_PROGMEM;
+extern const uint8_t crc8RfcommTable[256] CRC_PROGMEM;
+extern const uint32_t crc32Table[256] CRC_PROGMEM;
+
+inline uint8_t crc8MaximByte(uint8_t crc, uint8_t b) {
+	return crcRead8(crc8MaximTable, crc ^ b);
+}
+
+inline uint16_t crc16ArcByte(uint16_t crc, uint8_t b) {
+	return (crc >> 8) ^ crcRead16(crc16ArcTable, (uint8_t) (crc ^ b));
+}
+
+inline uint8_t crc7SdByte(uint8_t crc, uint8_t b) {
+	return crcRead8(crc7SdTable, crc ^ b);
+}
+
+inline uint16_t crc16CcittByte(uint16_t crc, uint8_t b) {
+	return (crc << 8) ^ crcRead16(crc16CcittTable, (crc >> 8) ^ b);
+}
+
+inline uint8_t crc8RfcommByte(uint8_t crc, uint8_t b) {
+	return crcRead8(crc8RfcommTable, crc ^ b);
+}
+
+inline uint32_t crc32Byte(uint32_t crc, uint8_t b) {
+	return (crc >> 8) ^ crcRead32(crc32Table, (uint8_t) (crc ^ b));
+}
+
+uint8_t crc8Maxim(uint8_t crc, const void * data, size_t n);
+uint16_t crc16Arc(uint16_t crc, const void * data, size_t n);
+uint8_t crc7Sd(uint8_t crc, const void * data, size_t n);
+uint16_t crc16Ccitt(uint16_t crc, const void * data, size_t n);
+uint8_t crc8Rfcomm(uint8_t crc, const void * data, size_t n);
+uint32_t crc32(uint32_t crc, const void * data, size_t n);
+uint8_t sum8(uint8_t sum, const void * data, size_t n);
+
+#endif /* CRC_H_ */
@@ -0,0 +1,82 @@
+/*
+ * CRC time per polynomial.
+ *
+ * Runs a 512 byte block, as read from an SD card, through each CRC of the
+ * library and through the bitwise CRC7 and CRC-CCITT that SdFat used with
+ * USE_SD_CRC 1, and prints microseconds per block and kilobytes per
+ * second.  CRC_SLICE is 1 on AVR; other targets read several bytes per
+ * step.
+ */
+#include <CRC.h>
+
+const unsigned int blockSize = 512;
+const int rounds = 20;
+
+byte block[blockSize];
+volatile unsigned long sink;
+
+uint8_t bitwiseCrc7(const uint8_t* data, unsigned int n) {
+	uint8_t crc = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		uint8_t d = data[i];
+		for (uint8_t j = 0; j < 8; j++) {
+			crc <<= 1;
+			if ((d & 0x80) ^ (crc & 0x80))
+				crc ^= 0x09;
+			d <<= 1;
+		}
+	}
+	return (crc << 1) | 1;
+}
+
+uint16_t shiftCcitt(const uint8_t* data, unsigned int n) {
+	uint16_t crc = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		crc = (uint8_t) (crc >> 8) | (crc << 8);
+		crc ^= data[i];
+		crc ^= (uint8_t) (crc & 0xff) >> 4;
+		crc ^= crc << 12;
+		crc ^= (crc & 0xff) << 5;
+	}
+	return crc;
+}
+
+void report(const char * name, unsigned long us) {
+	us /= rounds;
+	Serial.print(name);
+	Serial.print('\t');
+	Serial.print(us);
+	Serial.print(" us\t");
+	Serial.print(us ? blockSize * 1000UL / us : 0);
+	Serial.println(" KB/s");
+}
+
+#define BENCH(name, expr) \
+	do { \
+		unsigned long t = micros(); \
+		for (int r = 0; r < rounds; r++) \
+			sink = (expr); \
+		report(name, micros() - t); \
+	} while (0)
+
+void setup() {
+	Serial.begin(115200);
+	for (unsigned int i = 0; i < blockSize; i++)
+		block[i] = i * 7 + (i >> 3);
+	crc16Ccitt(0, block, 1);   // slice tables, when there are any
+
+	Serial.print("CRC_SLICE ");
+	Serial.println(CRC_SLICE);
+	BENCH("crc8Maxim", crc8Maxim(0, block, blockSize));
+	BENCH("crc16Arc", crc16Arc(0, block, blockSize));
+	BENCH("crc7Sd", crc7Sd(0, block, blockSize));
+	BENCH("crc16Ccitt", crc16Ccitt(0, block, blockSize));
+	BENCH("crc8Rfcomm", crc8Rfcomm(0xff, block, blockSize));
+	BENCH("crc32", crc32(0xffffffffUL, block, blockSize));
+	BENCH("sum8", sum8(0, block, blockSize));
+	BENCH("CRC7 bits", bitwiseCrc7(block, blockSize));
+	BENCH("CCITT shift", shiftCcitt(block, blockSize));
+}
+
+void loop() {
+}
@@ -0,0 +1,57 @@
+/*
+ * GrayEnumerator.cpp
+ *
+ *  Reflected Gray code walk with pruning, see GrayEnumerator.h
+ */
+
+#include "GrayEnumerator.h"
+
+GrayEnumerator::GrayEnumerator(byte dims, byte radix, byte * digits) {
+	_dims = dims < GRAY_MAX_DIMS ? dims : GRAY_MAX_DIMS;
+	_radix = radix;
+	_digits = digits;
+	_visited = 0;
+}
+
+boolean GrayEnumerator::run(Visit visit, Prune prune, void * context) {
+	_visit = visit;
+	_prune = prune;
+	_context = context;
+	_visited = 0;
+	_changed = 0;
+	for (byte i = 0; i < _dims; i++)
+		_digits[i] = 0;
+	if (_dims == 0 || _radix == 0)
+		return true;
+	return walk(_dims - 1);
+}
+
+// Runs digit level through its values, up from 0 or down from the top,
+// whichever end it was left at.  Every digit below is at one end too, so
+// each step moves one digit by one, pruned prefixes aside.
+boolean GrayEnumerator::walk(byte level) {
+	boolean up = _digits[level] == 0;
+
+	for (byte n = 0; n < _radix; n++) {
+		if (n > 0) {
+			if (up)
+				_digits[level]++;
+			else
+				_digits[level]--;
+			if (_changed < level)
+				_changed = level;
+		}
+		if (_prune && !_prune(_digits, level, _context))
+			continue;
+		if (level > 0) {
+			if (!walk(level - 1))
+				return false;
+		} else {
+			_visited++;
+			if (!_visit(_digits, _visited == 1 ? _dims : _changed, _context))
+				return false;
+			_changed = 0;
+		}
+	}
+	return true;
+}
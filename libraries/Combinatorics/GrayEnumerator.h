@@ -0,0 +1,61 @@
+/*
+ * GrayEnumerator.h
+ *
+ *  Every combination of dims digits, each 0 .. radix - 1, in reflected
+ *  Gray code order: one digit moves by one between a combination and the
+ *  next, so a sketch can keep running totals and update them with a single
+ *  add or subtract per step.  With a radix of 2 these are the subsets of
+ *  dims items.
+ *
+ *  The highest digit is the outermost.  A prune callback, when given, is
+ *  called each time a digit is set, with the digits above it already
+ *  fixed; returning false skips every combination under that prefix.  The
+ *  step into the next prefix then moves more than one digit.
+ *
+ *  The digits are kept in an array given by the caller, nothing is
+ *  allocated.  Up to GRAY_MAX_DIMS digits.
+ */
+
+#ifndef GRAYENUMERATOR_H_
+#define GRAYENUMERATOR_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define GRAY_MAX_DIMS 32
+
+class GrayEnumerator {
+public:
+	// A combination, with the digit that changed from the previous one
+	// (dims for the first).  Returning false stops the walk.
+	typedef boolean (*Visit)(const byte * digits, byte changed, void * context);
+	// digits[level] has just been set.  Returning false skips the
+	// combinations below it.
+	typedef boolean (*Prune)(const byte * digits, byte level, void * context);
+
+	GrayEnumerator(byte dims, byte radix, byte * digits);
+
+	// Walks the combinations from all zeros, false if stopped by visit
+	boolean run(Visit visit, Prune prune = 0, void * context = 0);
+
+	unsigned long visited() const {
+		return _visited;
+	}
+
+private:
+	byte _dims;
+	byte _radix;
+	byte * _digits;
+	unsigned long _visited;
+	byte _changed;
+	Visit _visit;
+	Prune _prune;
+	void * _context;
+
+	boolean walk(byte level);
+};
+
+#endif /* GRAYENUMERATOR_H_ */
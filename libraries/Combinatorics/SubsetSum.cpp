@@ -0,0 +1,139 @@
+/*
+ * SubsetSum.cpp
+ *
+ *  Subset sum by bitset dynamic programming or meet in the middle, see
+ *  SubsetSum.h
+ */
+
+#include "SubsetSum.h"
+#include <Sort.h>
+
+#define UNREACHED 0xff
+#define START 0xfe
+
+long SubsetSum::best(const int price[], byte items, long budget,
+		boolean chosen[], byte * work, unsigned int workSize) {
+	if (budget >= 0 && (unsigned long) SUBSET_SUM_WORKSPACE(budget) <= workSize)
+		return dynamic(price, items, budget, chosen, work, workSize);
+	return meetInTheMiddle(price, items, budget, chosen, work, workSize);
+}
+
+long SubsetSum::dynamic(const int price[], byte items, long budget,
+		boolean chosen[], byte * work, unsigned int workSize) {
+	if (budget < 0 || items > SUBSET_SUM_MAX_ITEMS
+			|| (unsigned long) SUBSET_SUM_WORKSPACE(budget) > workSize)
+		return -1;
+
+	// from[s] is the item that first reached total s, reach bit s is set
+	// once it is reached
+	byte * from = work;
+	byte * reach = work + budget + 1;
+	unsigned int bytes = (budget + 8) / 8;
+	byte last = 0xff >> (7 - budget % 8);   // bits of the last byte within the budget
+
+	memset(from, UNREACHED, budget + 1);
+	memset(reach, 0, bytes);
+	from[0] = START;
+	reach[0] = 1;
+
+	for (byte i = 0; i < items && !(reach[bytes - 1] & (1 << (budget % 8))); i++) {
+		int w = price[i];
+		if (w <= 0 || w > budget)
+			continue;
+		unsigned int q = w >> 3;
+		byte r = w & 7;
+		// new totals are the reached ones moved up by w; from the top down
+		// so that every byte is read before it changes
+		for (int k = bytes - 1; k >= (int) q; k--) {
+			byte moved = reach[k - q] << r;
+			if (r && k > (int) q)
+				moved |= reach[k - q - 1] >> (8 - r);
+			if (k == (int) bytes - 1)
+				moved &= last;
+			byte fresh = moved & ~reach[k];
+			if (fresh == 0)
+				continue;
+			reach[k] |= fresh;
+			for (byte b = 0; b < 8; b++)
+				if (fresh & (1 << b))
+					from[k * 8 + b] = i;
+		}
+	}
+
+	long total = budget;
+	while (from[total] == UNREACHED)
+		total--;
+
+	for (byte i = 0; i < items; i++)
+		chosen[i] = false;
+	for (long s = total; s > 0; s -= price[from[s]])
+		chosen[from[s]] = true;
+	return total;
+}
+
+long SubsetSum::meetInTheMiddle(const int price[], byte items, long budget,
+		boolean chosen[], byte * work, unsigned int workSize) {
+	Half * list = (Half *) work;
+	byte listed = 0;
+
+	if (budget < 0)
+		return -1;
+	// as many items in the list as the workspace holds
+	while (listed < 14 && listed < items
+			&& (sizeof(Half) << (listed + 1)) <= workSize)
+		listed++;
+	byte walked = items - listed;
+	if (walked > SUBSET_SUM_MAX_WALK)
+		return -1;
+
+	// totals of every subset of the listed items, each from the subset
+	// without its lowest item
+	int count = 1 << listed;
+	list[0].sum = 0;
+	list[0].mask = 0;
+	for (int m = 1; m < count; m++) {
+		uint16_t low = m & -m;
+		byte bit = 0;
+		while (!(low & (1 << bit)))
+			bit++;
+		list[m].sum = list[m ^ low].sum + price[bit];
+		list[m].mask = m;
+	}
+	introSort(list, count);
+
+	// walk the other items in Gray code order, one item in or out per step
+	long total = -1;
+	uint16_t bestMask = 0;
+	unsigned long bestWalk = 0;
+	unsigned long walk = 0;
+	long walkSum = 0;
+	Half key;
+	for (unsigned long g = 0; ; ) {
+		if (walkSum <= budget) {
+			key.sum = budget - walkSum;
+			int at = upperBound(list, count, key) - 1;   // largest not above
+			long sum = walkSum + list[at].sum;
+			if (sum > total) {
+				total = sum;
+				bestMask = list[at].mask;
+				bestWalk = walk;
+				if (total == budget)
+					break;
+			}
+		}
+		if (++g >> walked)
+			break;
+		byte bit = 0;
+		while (!(g & (1UL << bit)))
+			bit++;
+		walk ^= 1UL << bit;
+		if (walk & (1UL << bit))
+			walkSum += price[listed + bit];
+		else
+			walkSum -= price[listed + bit];
+	}
+
+	for (byte i = 0; i < items; i++)
+		chosen[i] = i < listed ? (bestMask >> i) & 1 : (bestWalk >> (i - listed)) & 1;
+	return total;
+}
@@ -0,0 +1,64 @@
+/*
+ * SubsetSum.h
+ *
+ *  Subset sum, the 0-1 knapsack where every item is worth its price: the
+ *  largest total of prices that stays within a budget, and the items that
+ *  make it up.
+ *
+ *  The memory comes from a workspace given by the caller, so that the
+ *  budget is explicit and nothing is allocated:
+ *
+ *   dynamic()          marks every total reachable within the budget in a
+ *                      bitset, one shift-or of the bitset per item, and
+ *                      remembers which item first reached each total.
+ *                      O(items x budget / 8) byte operations and
+ *                      SUBSET_SUM_WORKSPACE(budget) bytes.
+ *   meetInTheMiddle()  lists the totals of the first items in the
+ *                      workspace, sorts them, then walks the subsets of
+ *                      the rest in Gray code order and looks up the best
+ *                      complement for each.  Any budget; the workspace
+ *                      decides how many items go in the list, the others
+ *                      cost 2^k lookups.
+ *   best()             the dynamic solution when the workspace holds it,
+ *                      meet in the middle otherwise.
+ *
+ *  With the 500 budget of price_buying_guide the dynamic workspace is
+ *  564 bytes.  Prices must be positive; items up to SUBSET_SUM_MAX_ITEMS.
+ *  Each returns the total, or -1 when the workspace is too small.
+ */
+
+#ifndef SUBSETSUM_H_
+#define SUBSETSUM_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define SUBSET_SUM_MAX_ITEMS 254
+// bytes needed by dynamic(): one item number per total, plus the bitset
+#define SUBSET_SUM_WORKSPACE(budget) ((budget) + 1 + ((budget) + 8) / 8)
+// items of meetInTheMiddle() walked in Gray code order, at most
+#define SUBSET_SUM_MAX_WALK 24
+
+class SubsetSum {
+public:
+	struct Half {
+		unsigned long sum;
+		uint16_t mask;
+
+		bool operator<(const Half & h) const {
+			return sum < h.sum;
+		}
+	};
+
+	static long best(const int price[], byte items, long budget,
+			boolean chosen[], byte * work, unsigned int workSize);
+	static long dynamic(const int price[], byte items, long budget,
+			boolean chosen[], byte * work, unsigned int workSize);
+	static long meetInTheMiddle(const int price[], byte items, long budget,
+			boolean chosen[], byte * work, unsigned int workSize);
+};
+
+#endif /* SUBSETSUM_H_ */
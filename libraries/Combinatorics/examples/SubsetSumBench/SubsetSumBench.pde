@@ -0,0 +1,129 @@
+/*
+ * Subset sum time by number of items and budget.
+ *
+ * Solves random price lists of 8 to 24 items against budgets of 500,
+ * 5000 and 50000 with the recursion price_buying_guide used before, with
+ * the bitset dynamic programming and with meet in the middle, and prints
+ * the total found and the microseconds taken.  The workspace is the same
+ * 1200 bytes for both; "-" marks a solver it cannot hold, and the
+ * recursion is only run up to 20 items.  Then counts the subsets the Gray
+ * code walk visits with and without pruning those over the budget.
+ */
+#include <Sort.h>
+#include <SubsetSum.h>
+#include <GrayEnumerator.h>
+
+const byte itemCounts[] = { 8, 12, 16, 20, 24 };
+const long budgets[] = { 500, 5000, 50000 };
+const byte maxItems = 24;
+
+int price[maxItems];
+boolean chosen[maxItems];
+byte work[1200];
+
+unsigned int lfsr = 0xACE1;
+
+unsigned int random16() {
+	lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+	return lfsr;
+}
+
+long recursive(const int price[], byte items, long budget) {
+	if (items == 0)
+		return 0;
+	long notbuy = recursive(price, items - 1, budget);
+	if (price[items - 1] > budget)
+		return notbuy;
+	long buy = price[items - 1] + recursive(price, items - 1, budget - price[items - 1]);
+	return buy > notbuy ? buy : notbuy;
+}
+
+void printResult(long total, unsigned long us) {
+	Serial.print('\t');
+	if (total < 0) {
+		Serial.print('-');
+		return;
+	}
+	Serial.print(total);
+	Serial.print(' ');
+	Serial.print(us);
+	Serial.print("us");
+}
+
+struct Walk {
+	long budget;
+	byte items;
+};
+
+boolean count(const byte *, byte, void *) {
+	return true;
+}
+
+// the total of the items chosen so far, highest first
+boolean withinBudget(const byte * digits, byte level, void * context) {
+	Walk & w = *(Walk *) context;
+	long sum = 0;
+	for (byte i = level; i < w.items; i++)
+		if (digits[i])
+			sum += price[i];
+	return sum <= w.budget;
+}
+
+void setup() {
+	Serial.begin(115200);
+	Serial.println("items\tbudget\trecursive\tdynamic\tmeet in the middle");
+
+	for (byte b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+		for (byte c = 0; c < sizeof(itemCounts); c++) {
+			byte items = itemCounts[c];
+			long budget = budgets[b];
+			unsigned long t;
+			long total;
+
+			// prices around a fifth of the budget
+			for (byte i = 0; i < items; i++)
+				price[i] = 1 + random16() % (budget * 2 / 5);
+
+			Serial.print(items);
+			Serial.print('\t');
+			Serial.print(budget);
+
+			if (items <= 20) {
+				t = micros();
+				total = recursive(price, items, budget);
+				printResult(total, micros() - t);
+			} else {
+				printResult(-1, 0);
+			}
+
+			t = micros();
+			total = SubsetSum::dynamic(price, items, budget, chosen, work, sizeof(work));
+			printResult(total, micros() - t);
+
+			t = micros();
+			total = SubsetSum::meetInTheMiddle(price, items, budget, chosen, work, sizeof(work));
+			printResult(total, micros() - t);
+			Serial.println();
+		}
+	}
+
+	Serial.println();
+	Serial.println("items\tsubsets\twithin 500");
+	for (byte c = 0; c < 3; c++) {
+		Walk w = { 500, itemCounts[c] };
+		GrayEnumerator gray(w.items, 2, work);
+
+		for (byte i = 0; i < w.items; i++)
+			price[i] = 1 + random16() % 200;
+		gray.run(count);
+		Serial.print(w.items);
+		Serial.print('\t');
+		Serial.print(gray.visited());
+		gray.run(count, withinBudget, &w);
+		Serial.print('\t');
+		Serial.println(gray.visited());
+	}
+}
+
+void loop() {
+}
@@ -12,6 +12,8 @@
 
 class MCP48X2 {
 	byte pin_cs;
+	volatile uint8_t * cs_port;
+	uint8_t cs_mask;
 	byte spi_mode;
 	byte spi_clockdiv;
 
@@ -22,6 +24,8 @@ class MCP48X2 {
 	void init(const byte cdiv, const byte mode) {
 		pinMode(pin_cs, OUTPUT);
 		digitalWrite(pin_cs, HIGH);
+		cs_port = portOutputRegister(digitalPinToPort(pin_cs));
+		cs_mask = digitalPinToBitMask(pin_cs);
 		setupSPI(cdiv, mode);
 	}
 
@@ -29,8 +33,19 @@ public:
 	MCP48X2(const byte cs = 10) : pin_cs(cs) {}
 
 	void begin(const byte cdiv = SPI_CLOCK_DIV4, const byte mode = SPI_MODE0) { init(cdiv, mode); }
-	void select() { digitalWrite(pin_cs, LOW); }
-	void deselect() { digitalWrite(pin_cs, HIGH); }
+	// direct port access, also called from interrupts
+	void select() {
+		uint8_t sreg = SREG;
+		cli();
+		*cs_port &= ~cs_mask;
+		SREG = sreg;
+	}
+	void deselect() {
+		uint8_t sreg = SREG;
+		cli();
+		*cs_port |= cs_mask;
+		SREG = sreg;
+	}
 
 	void setupSPI(const byte cdiv, const byte mode) {
 		spi_clockdiv = cdiv;
@@ -0,0 +1,158 @@
+/*
+ * DelayLine.cpp
+ *
+ *  ADC -> SPI SRAM -> DAC streaming, see DelayLine.h
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <TimerOne.h>
+
+#include "DelayLine.h"
+
+static DelayLine * running = 0;
+
+static void delayLineTick() {
+	running->tick();
+}
+
+/*
+ * len is the number of SRAM bytes used, rounded down to whole batches.
+ * The region is cleared to mid-scale so the first pass plays silence.
+ */
+void DelayLine::begin(const byte chcfg, const unsigned int len) {
+	channel = chcfg;
+	length = len - len % DELAYLINE_BATCH;
+	inHead = inTail = 0;
+	outHead = outTail = 0;
+	writeAddr = 0;
+	setDelay(length / 2);
+	resetCounters();
+
+	byte silence[DELAYLINE_BATCH];
+	memset(silence, 0x80, sizeof(silence));
+	for (unsigned int a = 0; a < length; a += DELAYLINE_BATCH)
+		burst(true, a, silence, DELAYLINE_BATCH);
+	busBytes = 0;
+	transactions = 0;
+}
+
+// delay in samples, whole batches between two batches and length - one batch
+void DelayLine::setDelay(unsigned int samples) {
+	samples -= samples % DELAYLINE_BATCH;
+	if (samples < 2 * DELAYLINE_BATCH)
+		samples = 2 * DELAYLINE_BATCH;
+	if (samples > length - DELAYLINE_BATCH)
+		samples = length - DELAYLINE_BATCH;
+	readAddr = wrap(writeAddr + length - samples);
+}
+
+void DelayLine::start(long periodMicros) {
+	running = this;
+	poll();   // fill the output ring before the first tick
+	Timer1.initialize(periodMicros);
+	Timer1.attachInterrupt(delayLineTick);
+}
+
+void DelayLine::stop() {
+	Timer1.detachInterrupt();
+	Timer1.stop();
+}
+
+void DelayLine::resetCounters() {
+	uint8_t sreg = SREG;
+	cli();
+	ticks = 0;
+	underruns = 0;
+	overruns = 0;
+	restarts = 0;
+	busBytes = 0;
+	transactions = 0;
+	SREG = sreg;
+}
+
+/*
+ * One byte at a time with interrupts off, so a tick can only come between
+ * bytes.  If it did, the tick has ended the SRAM access and it is opened
+ * again at the current address.
+ */
+void DelayLine::burst(boolean write, unsigned int address, byte * buf,
+		byte n) {
+	for (byte i = 0; i < n; i++) {
+		cli();
+		if (!busOwned) {
+			if (write)
+				sram.beginWrite(address + i);
+			else
+				sram.beginRead(address + i);
+			busOwned = true;
+			busBytes += 3;
+			transactions++;
+		}
+		if (write)
+			SPI.transfer(buf[i]);
+		else
+			buf[i] = SPI.transfer(0);
+		busBytes++;
+		sei();
+	}
+	cli();
+	if (busOwned) {
+		sram.deselect();
+		busOwned = false;
+	}
+	sei();
+}
+
+// call from loop() often enough to move a batch each way per batch of ticks
+void DelayLine::poll() {
+	byte batch[DELAYLINE_BATCH];
+	byte i;
+
+	while ((byte) (inHead - inTail) >= DELAYLINE_BATCH) {
+		for (i = 0; i < DELAYLINE_BATCH; i++)
+			batch[i] = inBuf[(byte) (inTail + i) % DELAYLINE_RING];
+		inTail += DELAYLINE_BATCH;
+		burst(true, writeAddr, batch, DELAYLINE_BATCH);
+		writeAddr = wrap(writeAddr + DELAYLINE_BATCH);
+	}
+	while ((byte) (outHead - outTail) <= DELAYLINE_RING - DELAYLINE_BATCH) {
+		burst(false, readAddr, batch, DELAYLINE_BATCH);
+		readAddr = wrap(readAddr + DELAYLINE_BATCH);
+		for (i = 0; i < DELAYLINE_BATCH; i++)
+			outBuf[(byte) (outHead + i) % DELAYLINE_RING] = batch[i];
+		outHead += DELAYLINE_BATCH;
+	}
+}
+
+void DelayLine::tick() {
+	if (busOwned) {
+		// take the bus from poll(), it reopens the burst
+		sram.deselect();
+		busOwned = false;
+		restarts++;
+	}
+
+	adc.setupSPI();
+	byte s = adc.read8(channel);
+	if (recording) {
+		if ((byte) (inHead - inTail) < DELAYLINE_RING) {
+			inBuf[inHead % DELAYLINE_RING] = s;
+			inHead++;
+		} else {
+			overruns++;
+		}
+	}
+
+	dac.setupSPI();
+	if (outHead != outTail) {
+		dac.write12((word) outBuf[outTail % DELAYLINE_RING] << 4);
+		outTail++;
+	} else {
+		underruns++;
+	}
+
+	ticks++;
+	busBytes += 4;
+	transactions += 2;
+}
@@ -0,0 +1,92 @@
+/*
+ * DelayLine.h
+ *
+ *  Continuous ADC -> SPI SRAM -> DAC streaming for MCP320X, SPISRAM and
+ *  MCP48X2 sharing one SPI bus.
+ *
+ *  A Timer1 interrupt takes one 8-bit sample from the ADC and writes one
+ *  delayed sample to the DAC on every tick.  Samples pass through two small
+ *  RAM rings; poll(), called from loop(), moves them to and from the SRAM in
+ *  sequential mode bursts of DELAYLINE_BATCH bytes.  A burst is given up
+ *  whenever the interrupt needs the bus and resumed with a new command, so
+ *  the sample clock is never held off by the SRAM.
+ *
+ *  With recording on the output is the input delayed by setDelay() samples,
+ *  to within one batch.  With recording off the last length samples play as
+ *  a loop.
+ */
+
+#ifndef DELAYLINE_H_
+#define DELAYLINE_H_
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#include "MCP320X.h"
+#include "SPISRAM.h"
+#include "MCP48X2.h"
+
+// samples per SRAM burst; the rings hold two batches
+#define DELAYLINE_BATCH 32
+#define DELAYLINE_RING (2 * DELAYLINE_BATCH)
+
+class DelayLine {
+	MCP320X & adc;
+	SPISRAM & sram;
+	MCP48X2 & dac;
+	byte channel;
+
+	// free running indices, the ring position is index % DELAYLINE_RING
+	byte inBuf[DELAYLINE_RING];
+	volatile byte inHead;    // written by the interrupt
+	byte inTail;
+	byte outBuf[DELAYLINE_RING];
+	byte outHead;
+	volatile byte outTail;   // written by the interrupt
+
+	unsigned int length;     // samples used in the SRAM
+	unsigned int writeAddr;
+	unsigned int readAddr;
+	volatile boolean recording;
+	volatile boolean busOwned;   // poll() has a burst open on the SRAM
+
+	void burst(boolean write, unsigned int address, byte * buf, byte n);
+	unsigned int wrap(unsigned int addr) {
+		return addr >= length ? addr - length : addr;
+	}
+
+public:
+	// counters, a bus transaction model of the SPI traffic
+	volatile unsigned long ticks;
+	volatile unsigned long underruns;   // DAC ticks with no sample ready
+	volatile unsigned long overruns;    // ADC samples dropped, ring full
+	volatile unsigned long restarts;    // bursts resumed after a tick
+	volatile unsigned long busBytes;    // SPI bytes on the bus, all devices
+	volatile unsigned long transactions;  // chip selects, all devices
+
+	DelayLine(MCP320X & a, SPISRAM & s, MCP48X2 & d) :
+			adc(a), sram(s), dac(d) {
+		length = 32768U;
+		recording = true;
+		busOwned = false;
+	}
+
+	void begin(const byte chcfg = MCP320X::SINGLE_CH0,
+			const unsigned int len = 32768U);
+	void setDelay(unsigned int samples);
+	void record(boolean on) {
+		recording = on;
+	}
+	boolean isRecording() {
+		return recording;
+	}
+	void start(long periodMicros);
+	void stop();
+	void poll();
+	void resetCounters();
+
+	// called from the Timer1 interrupt
+	void tick();
+};
+
+#endif /* DELAYLINE_H_ */
@@ -8,8 +8,6 @@
 #include "EthernetServer.h"
 #include "Dhcp.h"
 
-#define MAX_SOCK_NUM 4
-
 class EthernetClass {
 private:
   IPAddress _dnsServerAddress;
@@ -14,6 +14,11 @@ extern "C" {
 
 uint16_t EthernetClient::_srcport = 1024;
 
+uint8_t EthernetClient::_txBuf[MAX_SOCK_NUM][ETHERNET_TX_BUFFER];
+uint8_t EthernetClient::_txLen[MAX_SOCK_NUM];
+uint16_t EthernetClient::_txQueued[MAX_SOCK_NUM];
+unsigned long EthernetClient::_txSince[MAX_SOCK_NUM];
+
 EthernetClient::EthernetClient() : _sock(MAX_SOCK_NUM) {
 }
 
@@ -39,7 +44,7 @@ int EthernetClient::connect(IPAddress ip, uint16_t port) {
   if (_sock != MAX_SOCK_NUM)
     return 0;
 
-  for (int i = 0; i < MAX_SOCK_NUM; i++) {
+  for (int i = 0; i < W5100.getSocketCount(); i++) {
     uint8_t s = W5100.readSnSR(i);
     if (s == SnSR::CLOSED || s == SnSR::FIN_WAIT || s == SnSR::CLOSE_WAIT) {
       _sock = i;
@@ -53,6 +58,7 @@ int EthernetClient::connect(IPAddress ip, uint16_t port) {
   _srcport++;
   if (_srcport == 0) _srcport = 1024;
   socket(_sock, SnMR::TCP, _srcport, 0);
+  discard(_sock);
 
   if (!::connect(_sock, rawIPAddress(ip), port)) {
     _sock = MAX_SOCK_NUM;
@@ -79,21 +85,93 @@ size_t EthernetClient::write(const uint8_t *buf, size_t size) {
     setWriteError();
     return 0;
   }
-  if (!send(_sock, buf, size)) {
-    setWriteError();
-    return 0;
+  if (_txLen[_sock] == 0 && _txQueued[_sock] == 0)
+    _txSince[_sock] = millis();
+
+  if (size < ETHERNET_TX_BUFFER) {
+    // collect small writes, the chip is written a buffer at a time
+    if (_txLen[_sock] + size > ETHERNET_TX_BUFFER) {
+      if (!queue(_sock, _txBuf[_sock], _txLen[_sock]))
+        goto error;
+      _txLen[_sock] = 0;
+    }
+    memcpy(_txBuf[_sock] + _txLen[_sock], buf, size);
+    _txLen[_sock] += size;
+    if (millis() - _txSince[_sock] >= ETHERNET_TX_DELAY && !transmit(_sock))
+      goto error;
+  } else {
+    // larger ones go straight to the chip, behind what is waiting
+    if (!queue(_sock, _txBuf[_sock], _txLen[_sock]))
+      goto error;
+    _txLen[_sock] = 0;
+    if (!queue(_sock, buf, size) || !transmit(_sock))
+      goto error;
   }
   return size;
+
+error:
+  discard(_sock);
+  setWriteError();
+  return 0;
+}
+
+// Copies data to the chip behind the data queued there, sending every
+// full segment
+int EthernetClient::queue(uint8_t sock, const uint8_t *buf, uint16_t size) {
+  while (size > 0) {
+    uint16_t n = ETHERNET_TX_SEGMENT - _txQueued[sock];
+    if (n > size)
+      n = size;
+    if (!queueData(sock, _txQueued[sock], buf, n))
+      return 0;
+    buf += n;
+    size -= n;
+    _txQueued[sock] += n;
+    if (_txQueued[sock] == ETHERNET_TX_SEGMENT) {
+      _txQueued[sock] = 0;
+      if (!sendQueued(sock, ETHERNET_TX_SEGMENT))
+        return 0;
+    }
+  }
+  return 1;
+}
+
+// Sends everything written to the socket
+int EthernetClient::transmit(uint8_t sock) {
+  int ok = 1;
+  if (_txLen[sock] > 0)
+    ok = queue(sock, _txBuf[sock], _txLen[sock]);
+  if (ok && _txQueued[sock] > 0)
+    ok = sendQueued(sock, _txQueued[sock]);
+  discard(sock);
+  return ok;
+}
+
+void EthernetClient::discard(uint8_t sock) {
+  _txLen[sock] = 0;
+  _txQueued[sock] = 0;
+}
+
+// Sends the data that has waited for ETHERNET_TX_DELAY ms
+void EthernetClient::poll(uint8_t sock) {
+  if ((_txLen[sock] > 0 || _txQueued[sock] > 0) &&
+      millis() - _txSince[sock] >= ETHERNET_TX_DELAY)
+    transmit(sock);
 }
 
 int EthernetClient::available() {
-  if (_sock != MAX_SOCK_NUM)
+  if (_sock != MAX_SOCK_NUM) {
+    // the peer may be waiting for what has been written
+    transmit(_sock);
     return W5100.getRXReceivedSize(_sock);
+  }
   return 0;
 }
 
 int EthernetClient::read() {
   uint8_t b;
+  if (_sock != MAX_SOCK_NUM)
+    transmit(_sock);
   if ( recv(_sock, &b, 1) > 0 )
   {
     // recv worked
@@ -107,6 +185,8 @@ int EthernetClient::read() {
 }
 
 int EthernetClient::read(uint8_t *buf, size_t size) {
+  if (_sock != MAX_SOCK_NUM)
+    transmit(_sock);
   return recv(_sock, buf, size);
 }
 
@@ -120,6 +200,10 @@ int EthernetClient::peek() {
 }
 
 void EthernetClient::flush() {
+  if (_sock == MAX_SOCK_NUM)
+    return;
+  if (!transmit(_sock))
+    setWriteError();
   while (available())
     read();
 }
@@ -128,7 +212,9 @@ void EthernetClient::stop() {
   if (_sock == MAX_SOCK_NUM)
     return;
 
-  // attempt to close the connection gracefully (send a FIN to other side)
+  // send what is left, then attempt to close the connection gracefully
+  // (send a FIN to other side)
+  transmit(_sock);
   disconnect(_sock);
   unsigned long start = millis();
 
@@ -146,6 +232,7 @@ void EthernetClient::stop() {
 
 uint8_t EthernetClient::connected() {
   if (_sock == MAX_SOCK_NUM) return 0;
+  poll(_sock);
   
   uint8_t s = status();
   return !(s == SnSR::LISTEN || s == SnSR::CLOSED || s == SnSR::FIN_WAIT ||
@@ -4,6 +4,23 @@
 #include "Print.h"
 #include "Client.h"
 #include "IPAddress.h"
+#include "utility/w5100.h"	// MAX_SOCK_NUM
+
+// Small writes, such as those made by print(), are collected per socket
+// and copied to the W5100 a buffer at a time.  The data is sent as one
+// segment by flush(), by a write of at least ETHERNET_TX_BUFFER bytes,
+// once ETHERNET_TX_SEGMENT bytes are waiting, before the client reads or
+// closes, or by the first write or server check ETHERNET_TX_DELAY ms
+// after the oldest unsent byte.
+#ifndef ETHERNET_TX_BUFFER
+#define ETHERNET_TX_BUFFER 32
+#endif
+#ifndef ETHERNET_TX_SEGMENT
+#define ETHERNET_TX_SEGMENT 1460
+#endif
+#ifndef ETHERNET_TX_DELAY
+#define ETHERNET_TX_DELAY 20
+#endif
 
 class EthernetClient : public Client {
 
@@ -20,6 +37,7 @@ public:
   virtual int read();
   virtual int read(uint8_t *buf, size_t size);
   virtual int peek();
+  // sends what has been written, then discards unread input
   virtual void flush();
   virtual void stop();
   virtual uint8_t connected();
@@ -32,6 +50,16 @@ public:
 private:
   static uint16_t _srcport;
   uint8_t _sock;
+
+  static uint8_t _txBuf[MAX_SOCK_NUM][ETHERNET_TX_BUFFER];
+  static uint8_t _txLen[MAX_SOCK_NUM];          // bytes in _txBuf
+  static uint16_t _txQueued[MAX_SOCK_NUM];      // bytes copied to the chip, not yet sent
+  static unsigned long _txSince[MAX_SOCK_NUM];  // when the oldest unsent byte was written
+
+  static int queue(uint8_t sock, const uint8_t *buf, uint16_t size);
+  static int transmit(uint8_t sock);
+  static void discard(uint8_t sock);
+  static void poll(uint8_t sock);
 };
 
 #endif
@@ -15,10 +15,11 @@ EthernetServer::EthernetServer(uint16_t port)
 
 void EthernetServer::begin()
 {
-  for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+  for (int sock = 0; sock < W5100.getSocketCount(); sock++) {
     EthernetClient client(sock);
     if (client.status() == SnSR::CLOSED) {
       socket(sock, SnMR::TCP, _port, 0);
+      EthernetClient::discard(sock);
       listen(sock);
       EthernetClass::_server_port[sock] = _port;
       break;
@@ -30,10 +31,11 @@ void EthernetServer::accept()
 {
   int listening = 0;
 
-  for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+  for (int sock = 0; sock < W5100.getSocketCount(); sock++) {
     EthernetClient client(sock);
 
     if (EthernetClass::_server_port[sock] == _port) {
+      EthernetClient::poll(sock);
       if (client.status() == SnSR::LISTEN) {
         listening = 1;
       } 
@@ -52,7 +54,7 @@ EthernetClient EthernetServer::available()
 {
   accept();
 
-  for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+  for (int sock = 0; sock < W5100.getSocketCount(); sock++) {
     EthernetClient client(sock);
     if (EthernetClass::_server_port[sock] == _port &&
         (client.status() == SnSR::ESTABLISHED ||
@@ -78,7 +80,7 @@ size_t EthernetServer::write(const uint8_t *buffer, size_t size)
   
   accept();
 
-  for (int sock = 0; sock < MAX_SOCK_NUM; sock++) {
+  for (int sock = 0; sock < W5100.getSocketCount(); sock++) {
     EthernetClient client(sock);
 
     if (EthernetClass::_server_port[sock] == _port &&
@@ -0,0 +1,93 @@
+/*
+  Throughput client
+
+ This sketch measures how fast data moves between the Arduino and
+ a computer over TCP, to compare the W5100 with the W5200 and W5500.
+ The W5100 takes four SPI bytes for every byte of data, the newer
+ chips take one.
+
+ On the computer run a server that sinks what it is sent and sends
+ a file back, for example:
+
+   nc -l 5001 < bigfile > /dev/null
+
+ The sketch sends 64 KB in 1 KB writes, then reads until the server
+ closes the connection, and prints the rate of each direction.
+
+ Circuit:
+ * Ethernet shield attached to pins 10, 11, 12, 13
+
+ */
+
+#include <SPI.h>
+#include <Ethernet.h>
+#include <utility/w5100.h>
+
+byte mac[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED };
+IPAddress ip(192,168,0,177);
+
+// the computer running the server
+IPAddress server(192,168,0,2);
+const int port = 5001;
+
+const long sendSize = 65536;
+
+EthernetClient client;
+byte buf[1024];
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for Leonardo only
+  }
+
+  Ethernet.begin(mac, ip);
+  delay(1000);
+
+  Serial.print("chip W");
+  Serial.print(W5100.getChip());
+  Serial.print("00, ");
+  Serial.print(W5100.getSocketCount());
+  Serial.print(" sockets, ");
+  Serial.print(W5100.SSIZE);
+  Serial.println(" byte buffers");
+
+  for (int i = 0; i < sizeof(buf); i++)
+    buf[i] = 'a' + i % 26;
+
+  Serial.println("connecting...");
+  if (!client.connect(server, port)) {
+    Serial.println("connection failed");
+    return;
+  }
+
+  unsigned long start = millis();
+  for (long sent = 0; sent < sendSize; sent += sizeof(buf))
+    client.write(buf, sizeof(buf));   // writes this size are sent at once
+  report("sent", sendSize, millis() - start);
+
+  long received = 0;
+  start = millis();
+  while (client.connected()) {
+    int n = client.read(buf, sizeof(buf));
+    if (n > 0)
+      received += n;
+  }
+  report("received", received, millis() - start);
+  client.stop();
+}
+
+void loop() {
+}
+
+void report(const char *what, long bytes, unsigned long ms) {
+  Serial.print(what);
+  Serial.print(" ");
+  Serial.print(bytes);
+  Serial.print(" bytes in ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  if (ms > 0)
+    Serial.print(bytes / ms);
+  Serial.println(" KB/s");
+}
@@ -0,0 +1,86 @@
+/*
+ ChipProbe - W5100, W5200 and W5500 on the same library build
+
+ For each chip the model plays, checks that init() finds it and sizes the
+ sockets, then sends and receives 20000 bytes on every socket through the
+ ring wrap and reads an address back from the common registers.  Prints
+ the SPI bytes per payload byte in each direction.
+ */
+
+#include <stdio.h>
+#include <Ethernet.h>
+#include "utility/w5100.h"
+#include "W5x00Sim.h"
+
+static uint8_t data[20000], got[20000];
+
+static int chip(int model) {
+  int bad = 0;
+
+  W5x00Sim::reset(model);
+  W5100.init();
+  printf("W%d: found W%d, %d sockets, %u byte buffers\n", model * 100,
+         W5100.getChip() * 100, W5100.getSocketCount(), W5100.SSIZE);
+  if (W5100.getChip() != model)
+    bad++;
+
+  for (int s = 0; s < W5100.getSocketCount(); s++) {
+    EthernetClient c(s);
+    std::string expect;
+    unsigned long before = W5x00Sim::spiBytes;
+    for (int k = 0; k < 20; k++) {
+      c.write(data + k * 1000, 1000);
+      expect.append((const char *) data + k * 1000, 1000);
+    }
+    c.flush();
+    unsigned long tx = W5x00Sim::spiBytes - before;
+    if (W5x00Sim::sent[s] != expect)
+      bad++;
+
+    // the peer sends 1500 bytes at a time, read in pieces of up to 700
+    before = W5x00Sim::spiBytes;
+    for (int n = 0; n < 20000; ) {
+      int chunk = 20000 - n < 1500 ? 20000 - n : 1500;
+      int r = 0;
+      W5x00Sim::receive(s, data + n, chunk);
+      while (c.available()) {
+        int k = c.read(got + n + r, 700);
+        if (k <= 0)
+          break;
+        r += k;
+      }
+      if (r != chunk) {
+        bad++;
+        break;
+      }
+      n += chunk;
+    }
+    unsigned long rx = W5x00Sim::spiBytes - before;
+    if (memcmp(got, data, sizeof(data)))
+      bad++;
+    if (s == 0)
+      printf("  SPI bytes per payload byte: %.2f sending, %.2f receiving\n", tx / 20000.0, rx / 20000.0);
+  }
+
+  uint8_t ip[4] = { 192, 168, 1, 177 }, back[4];
+  W5100.setIPAddress(ip);
+  W5100.getIPAddress(back);
+  if (memcmp(ip, back, 4))
+    bad++;
+  printf("  %s\n", bad ? "FAILED" : "ok");
+  return bad ? 1 : 0;
+}
+
+int main() {
+  int failed = 0;
+  for (unsigned i = 0; i < sizeof(data); i++)
+    data[i] = rand();
+  for (int rw = 0; rw < 2; rw++) {
+    W5x00Sim::txWrReadsWritten = rw;
+    printf("TX_WR reads back %s\n", rw ? "as written" : "as latched by SEND");
+    failed += chip(W5x00Sim::W5100);
+    failed += chip(W5x00Sim::W5200);
+    failed += chip(W5x00Sim::W5500);
+  }
+  return failed;
+}
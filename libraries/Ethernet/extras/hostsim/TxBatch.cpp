@@ -0,0 +1,75 @@
+/*
+ TxBatch - EthernetClient write batching on the W5100 model
+
+ Sends the response of the WebServer example the way the sketch does, a
+ print() at a time, and checks what the peer receives and how many SEND
+ commands it took.  Then again with a pause between lines longer than
+ ETHERNET_TX_DELAY, and with a 3000 byte write in the middle, larger than
+ the 2048 byte transmit buffer.  Each case is run with TX_WR reading
+ back as latched by SEND and as last written.
+ */
+
+#include <stdio.h>
+#include <Ethernet.h>
+#include "W5x00Sim.h"
+
+static std::string expect;
+
+static void line(EthernetClient & c, const char * s) {
+  c.println(s);
+  expect += s;
+  expect += "\r\n";
+}
+
+static int response(const char * name, unsigned long pause, bool large) {
+  W5x00Sim::reset(W5x00Sim::W5100);
+  W5100.init();
+  EthernetClient c(0);
+  char num[8];
+
+  expect.clear();
+  line(c, "HTTP/1.1 200 OK");
+  line(c, "Content-Type: text/html");
+  line(c, "Connection: close");
+  line(c, "Refresh: 5");
+  line(c, "");
+  line(c, "<!DOCTYPE HTML>");
+  line(c, "<html>");
+  for (int ch = 0; ch < 6; ch++) {
+    int reading = ch * 173;
+    c.print("analog input ");
+    c.print(ch);
+    c.print(" is ");
+    c.print(reading);
+    snprintf(num, sizeof(num), "%d", reading);
+    expect += std::string("analog input ") + (char) ('0' + ch) + " is " + num;
+    line(c, "<br />");
+    delay(pause);
+  }
+  if (large) {
+    static uint8_t big[3000];
+    for (int i = 0; i < 3000; i++)
+      big[i] = 'a' + i % 26;
+    c.write(big, sizeof(big));
+    expect.append((const char *) big, sizeof(big));
+  }
+  line(c, "</html>");
+  c.stop();
+
+  bool ok = W5x00Sim::sent[0] == expect;
+  printf("  %-26s %5u bytes  %3lu SEND  %6lu SPI bytes  %s\n", name,
+         (unsigned) expect.size(), W5x00Sim::sends, W5x00Sim::spiBytes, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main() {
+  int failed = 0;
+  for (int rw = 0; rw < 2; rw++) {
+    W5x00Sim::txWrReadsWritten = rw;
+    printf("TX_WR reads back %s\n", rw ? "as written" : "as latched by SEND");
+    failed += response("WebServer response", 0, false);
+    failed += response("7 ms between lines", 7, false);
+    failed += response("with a 3000 byte write", 0, true);
+  }
+  return failed;
+}
@@ -0,0 +1,220 @@
+// W5x00Sim - register level model of the W5100, W5200 and W5500, see W5x00Sim.h
+
+#include <string.h>
+#include "W5x00Sim.h"
+
+bool W5x00Sim::txWrReadsWritten = false;
+std::string W5x00Sim::sent[8];
+unsigned long W5x00Sim::sends;
+unsigned long W5x00Sim::spiBytes;
+unsigned long W5x00Sim::selects;
+
+static int chip = W5x00Sim::W5100;
+
+static uint8_t common[0x100];
+static uint8_t sreg[8][0x100];
+static uint8_t txb[8][16384], rxb[8][16384];
+// TX_WR as written and as latched by SEND, RX_RD as written, RX write pointer
+static uint16_t txWrWritten[8], txWr[8], rxRdWritten[8], rxWr[8];
+
+// socket register offsets, the same on all three chips
+enum { Sn_CR = 0x01, Sn_IR = 0x02, Sn_SR = 0x03, Sn_RXBUF_SIZE = 0x1E, Sn_TXBUF_SIZE = 0x1F,
+       Sn_TX_FSR = 0x20, Sn_TX_RD = 0x22, Sn_TX_WR = 0x24, Sn_RX_RSR = 0x26, Sn_RX_RD = 0x28 };
+
+static int sockets() { return chip == W5x00Sim::W5100 ? 4 : 8; }
+static uint16_t txSize(int s) { return chip == W5x00Sim::W5100 ? 2048 : sreg[s][Sn_TXBUF_SIZE] * 1024; }
+static uint16_t rxSize(int s) { return chip == W5x00Sim::W5100 ? 2048 : sreg[s][Sn_RXBUF_SIZE] * 1024; }
+static uint16_t get16(int s, int r) { return (sreg[s][r] << 8) | sreg[s][r + 1]; }
+static void set16(int s, int r, uint16_t v) { sreg[s][r] = v >> 8; sreg[s][r + 1] = v; }
+
+static void update(int s) {
+  set16(s, Sn_TX_FSR, txSize(s) - (uint16_t) (txWr[s] - get16(s, Sn_TX_RD)));
+  set16(s, Sn_TX_WR, txWr[s]);
+  set16(s, Sn_RX_RSR, rxWr[s] - rxRdWritten[s]);
+  set16(s, Sn_RX_RD, rxRdWritten[s]);
+}
+
+void W5x00Sim::reset(int c) {
+  chip = c;
+  memset(common, 0, sizeof(common));
+  memset(sreg, 0, sizeof(sreg));
+  if (chip == W5200)
+    common[0x1F] = 3;           // VERSIONR
+  if (chip == W5500)
+    common[0x39] = 4;           // VERSIONR
+  for (int s = 0; s < 8; s++) {
+    sreg[s][Sn_RXBUF_SIZE] = sreg[s][Sn_TXBUF_SIZE] = 2;
+    txWr[s] = txWrWritten[s] = rxRdWritten[s] = rxWr[s] = 0;
+    sreg[s][Sn_SR] = 0x17;      // ESTABLISHED
+    update(s);
+    sent[s].clear();
+  }
+  sends = spiBytes = selects = 0;
+}
+
+void W5x00Sim::receive(uint8_t s, const uint8_t * data, uint16_t len) {
+  for (uint16_t i = 0; i < len; i++)
+    rxb[s][(rxWr[s]++) & (rxSize(s) - 1)] = data[i];
+  update(s);
+}
+
+// A location in one of the spaces
+enum { NOWHERE = -1, COMMON, SOCKET, TXBUF, RXBUF };
+struct Loc { int space, s; uint16_t off; };
+
+static uint8_t *cell(Loc l) {
+  static uint8_t dummy;
+  if (l.s >= sockets())
+    return &dummy;
+  switch (l.space) {
+  case COMMON: return l.off < 0x100 ? &common[l.off] : &dummy;
+  case SOCKET: return &sreg[l.s][l.off & 0xff];
+  case TXBUF: return &txb[l.s][l.off & (txSize(l.s) - 1)];
+  case RXBUF: return &rxb[l.s][l.off & (rxSize(l.s) - 1)];
+  }
+  return &dummy;
+}
+
+// the buffers of the sockets follow each other, each as large as set
+static Loc inBuffers(int space, uint16_t o) {
+  Loc l = { NOWHERE, 0, o };
+  for (int s = 0; s < sockets(); s++) {
+    uint16_t size = space == TXBUF ? txSize(s) : rxSize(s);
+    if (o < size) {
+      l.space = space; l.s = s; l.off = o;
+      break;
+    }
+    o -= size;
+  }
+  return l;
+}
+
+// flat address maps of the W5100 and W5200
+static Loc mapFlat(uint16_t a) {
+  Loc l = { COMMON, 0, a };
+  uint16_t chBase = chip == W5x00Sim::W5100 ? 0x0400 : 0x4000;
+  uint16_t txBase = chip == W5x00Sim::W5100 ? 0x4000 : 0x8000;
+  uint16_t rxBase = chip == W5x00Sim::W5100 ? 0x6000 : 0xC000;
+  uint16_t rxEnd = chip == W5x00Sim::W5100 ? 0x8000 : 0x0000;
+
+  if (rxEnd && a >= rxEnd) {
+    l.space = NOWHERE;
+  } else if (a >= rxBase) {
+    l = inBuffers(RXBUF, a - rxBase);
+  } else if (a >= txBase) {
+    l = inBuffers(TXBUF, a - txBase);
+  } else if (a >= chBase && a < chBase + 0x100 * sockets()) {
+    l.space = SOCKET; l.s = (a - chBase) >> 8; l.off = a & 0xff;
+  } else if (a >= 0x100) {
+    l.space = NOWHERE;
+  }
+  return l;
+}
+
+// W5500 block select: 0 common, then register, TX and RX block per socket
+static Loc map5500(uint16_t a, uint8_t control) {
+  uint8_t block = control >> 3;
+  Loc l = { NOWHERE, block >> 2, a };
+  if (block == 0)
+    l.space = a < 0x100 ? COMMON : NOWHERE;
+  else if ((block & 3) != 0)
+    l.space = block & 3;
+  return l;
+}
+
+static void regWrite(Loc l, uint8_t v) {
+  if (l.space == NOWHERE)
+    return;
+  if (l.space == COMMON && l.off == 0 && (v & 0x80)) {      // MR reset
+    W5x00Sim::reset(chip);
+    return;
+  }
+  if (l.space == SOCKET) {
+    int s = l.s;
+    switch (l.off) {
+    case Sn_IR: sreg[s][Sn_IR] &= ~v; return;
+    case Sn_TX_WR: txWrWritten[s] = (v << 8) | (txWrWritten[s] & 0xff); return;
+    case Sn_TX_WR + 1: txWrWritten[s] = (txWrWritten[s] & 0xff00) | v; return;
+    case Sn_RX_RD: rxRdWritten[s] = (v << 8) | (rxRdWritten[s] & 0xff); return;
+    case Sn_RX_RD + 1: rxRdWritten[s] = (rxRdWritten[s] & 0xff00) | v; return;
+    case Sn_CR:
+      if (v == 0x20) {          // SEND
+        for (uint16_t p = txWr[s]; p != txWrWritten[s]; p++)
+          W5x00Sim::sent[s] += (char) txb[s][p & (txSize(s) - 1)];
+        W5x00Sim::sends++;
+        txWr[s] = txWrWritten[s];
+        set16(s, Sn_TX_RD, txWr[s]);
+        sreg[s][Sn_IR] |= 0x10; // SEND_OK
+      }
+      update(s);                // RECV takes RX_RD
+      return;
+    }
+  }
+  *cell(l) = v;
+}
+
+static uint8_t regRead(Loc l) {
+  if (l.space == NOWHERE)
+    return 0;
+  if (W5x00Sim::txWrReadsWritten && l.space == SOCKET) {
+    if (l.off == Sn_TX_WR)
+      return txWrWritten[l.s] >> 8;
+    if (l.off == Sn_TX_WR + 1)
+      return txWrWritten[l.s] & 0xff;
+  }
+  return *cell(l);
+}
+
+static bool selected = false;
+static int pos;
+static uint8_t header[4];
+
+void W5x00Sim::select(bool low) {
+  if (low && !selected) {
+    selects++;
+    pos = 0;
+  }
+  selected = low;
+}
+
+uint8_t W5x00Sim::transfer(uint8_t d) {
+  int headerLength = chip == W5200 ? 4 : 3;
+  uint8_t ret = 0;
+
+  spiBytes++;
+  if (pos < headerLength) {
+    header[pos++] = d;
+    return 0;
+  }
+  uint16_t n = pos++ - headerLength;
+  uint16_t a = (header[0] << 8) | header[1];
+  if (chip == W5100) {
+    // F0 or 0F, address high, address low, one data byte
+    if (n > 0)
+      return 0;
+    a = (header[1] << 8) | header[2];
+    if (header[0] == 0xF0)
+      regWrite(mapFlat(a), d);
+    else if (header[0] == 0x0F)
+      ret = regRead(mapFlat(a));
+  } else if (chip == W5200) {
+    // address, write flag and length, data
+    uint16_t len = ((header[2] & 0x7f) << 8) | header[3];
+    if (n >= len)
+      return 0;
+    if (header[2] & 0x80)
+      regWrite(mapFlat(a + n), d);
+    else
+      ret = regRead(mapFlat(a + n));
+  } else {
+    // address, block select and read/write, data until deselected
+    Loc l = map5500(a + n, header[2]);
+    if (l.space == COMMON && (header[2] & 0x04) && l.off > 0x3f)
+      return 0;
+    if (header[2] & 0x04)
+      regWrite(l, d);
+    else
+      ret = regRead(l);
+  }
+  return ret;
+}
@@ -0,0 +1,46 @@
+/*
+ W5x00Sim - register level model of the W5100, W5200 and W5500 SPI
+ interfaces, for running the Ethernet library on the host.
+
+ The model answers the frames each chip expects: 4 bytes per byte on the
+ W5100, and an address/length or address/control header followed by any
+ number of data bytes on the W5200 and W5500.  Socket registers, the
+ transmit and receive rings and the read and write pointers behave as on
+ the chip.  A SEND command moves the bytes between the last SEND and
+ TX_WR to sent[] for the socket; receive() puts bytes in a socket's
+ receive ring as if the peer had sent them.
+
+ Sockets start out ESTABLISHED, the tests drive a connection from there.
+ */
+
+#ifndef W5X00SIM_H
+#define W5X00SIM_H
+
+#include <stdint.h>
+#include <string>
+
+class W5x00Sim {
+public:
+  enum { W5100 = 51, W5200 = 52, W5500 = 55 };
+
+  // Powers up as the given chip, all counters cleared
+  static void reset(int chip);
+  // Bytes from the peer, put in the socket's receive ring
+  static void receive(uint8_t s, const uint8_t * data, uint16_t len);
+
+  // When set, reading TX_WR returns the value last written instead of the
+  // one latched by the last SEND.  Chips differ here, the library must not
+  // depend on either.
+  static bool txWrReadsWritten;
+
+  static std::string sent[8];     // payload per socket, in SEND order
+  static unsigned long sends;     // SEND commands
+  static unsigned long spiBytes;  // bytes clocked over SPI
+  static unsigned long selects;   // chip select cycles
+
+  // wiring, called by the SPI and port stand-ins
+  static void select(bool low);
+  static uint8_t transfer(uint8_t data);
+};
+
+#endif
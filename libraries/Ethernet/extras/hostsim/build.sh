@@ -0,0 +1,20 @@
+#!/bin/sh
+# Builds the Ethernet library with the host compiler against the W5x00
+# model and runs the tests.  Run from this directory:  sh build.sh
+#
+# The library casts buffer pointers to 16 bit offsets as on the AVR, so
+# it is built with -fpermissive.
+
+set -e
+CORE=../../../../hardware/ProMicro/cores/arduino
+LIB=../..
+CXX="${CXX:-g++} -std=gnu++11 -w -fpermissive -DARDUINO=101 -D__AVR_ATmega328P__"
+CXX="$CXX -Istub -I$CORE -I$LIB -I$LIB/utility -I."
+SOURCES="$LIB/*.cpp $LIB/utility/*.cpp core.cpp hostcore.cpp W5x00Sim.cpp"
+
+mkdir -p bin
+for test in TxBatch ChipProbe; do
+  $CXX $SOURCES $test.cpp -o bin/$test
+  echo "== $test"
+  ./bin/$test
+done
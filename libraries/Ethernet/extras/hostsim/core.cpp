@@ -0,0 +1,8 @@
+// The printing, string and address classes of the Arduino core, built on
+// the host.  Arduino.h comes first so that the core's own is skipped.
+
+#include <Arduino.h>
+#include <Print.cpp>
+#include <Stream.cpp>
+#include <WString.cpp>
+#include <IPAddress.cpp>
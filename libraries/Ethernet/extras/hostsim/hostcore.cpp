@@ -0,0 +1,71 @@
+// Clock, number formatting and pins of the Arduino core for host builds
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <stdio.h>
+#include "W5x00Sim.h"
+
+unsigned long hostMicros = 0;
+
+unsigned long millis(void) { return hostMicros / 1000; }
+unsigned long micros(void) { return hostMicros; }
+void delay(unsigned long ms) { hostMicros += ms * 1000; }
+void delayMicroseconds(unsigned int us) { hostMicros += us; }
+long random(long max) { return max ? rand() % max : 0; }
+long random(long min, long max) { return min + random(max - min); }
+
+char *ultoa(unsigned long value, char *buf, int base) {
+  char tmp[33];
+  int n = 0;
+  do {
+    int d = value % base;
+    tmp[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+    value /= base;
+  } while (value);
+  for (int i = 0; i < n; i++)
+    buf[i] = tmp[n - 1 - i];
+  buf[n] = 0;
+  return buf;
+}
+
+char *ltoa(long value, char *buf, int base) {
+  if (value < 0 && base == 10) {
+    buf[0] = '-';
+    ultoa(-(unsigned long) value, buf + 1, base);
+    return buf;
+  }
+  return ultoa((unsigned long) value, buf, base);
+}
+
+char *itoa(int value, char *buf, int base) {
+  return base == 10 ? ltoa(value, buf, base) : ultoa((unsigned) value, buf, base);
+}
+
+char *utoa(unsigned value, char *buf, int base) { return ultoa(value, buf, base); }
+
+char *dtostrf(double value, signed char width, unsigned char prec, char *buf) {
+  sprintf(buf, "%*.*f", width, prec, value);
+  return buf;
+}
+
+// PB2 is the chip select of the Ethernet shield
+HostPortB PORTB;
+volatile uint8_t DDRB;
+
+HostPortB & HostPortB::operator&=(int mask) {
+  value &= mask;
+  if (!(value & _BV(2)))
+    W5x00Sim::select(true);
+  return *this;
+}
+
+HostPortB & HostPortB::operator|=(int mask) {
+  value |= mask;
+  if (value & _BV(2))
+    W5x00Sim::select(false);
+  return *this;
+}
+
+SPIClass SPI;
+
+uint8_t SPIClass::transfer(uint8_t data) { return W5x00Sim::transfer(data); }
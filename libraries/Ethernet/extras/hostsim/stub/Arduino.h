@@ -0,0 +1,50 @@
+// Host stand-in for the Arduino core header.  The core's Print, Stream,
+// WString and IPAddress are compiled as they are; only the AVR parts and
+// the clock are replaced.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+// simulated time, moved on by delay() and by the tests
+extern unsigned long hostMicros;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+long random(long max);
+long random(long min, long max);
+
+char *itoa(int value, char *buf, int base);
+char *utoa(unsigned value, char *buf, int base);
+char *ltoa(long value, char *buf, int base);
+char *ultoa(unsigned long value, char *buf, int base);
+char *dtostrf(double value, signed char width, unsigned char prec, char *buf);
+
+#ifdef __cplusplus
+#include <WString.h>
+#include <Stream.h>
+#endif
+
+#endif
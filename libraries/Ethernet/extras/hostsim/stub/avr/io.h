@@ -0,0 +1,21 @@
+// Port B of an ATmega328P, with the chip select line (PB2, pin 10) wired
+// to the W5x00 model.
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+struct HostPortB {
+  uint8_t value;
+  HostPortB & operator&=(int mask);
+  HostPortB & operator|=(int mask);
+  operator uint8_t() const { return value; }
+};
+
+extern HostPortB PORTB;
+extern volatile uint8_t DDRB;
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+typedef char prog_char;
+typedef unsigned char prog_uchar;
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(const uint16_t *) (p))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+
+#endif
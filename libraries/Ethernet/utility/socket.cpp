@@ -137,6 +137,54 @@ uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len)
 }
 
 
+/**
+ * @brief	Copies data into the TCP transmit buffer behind the queued bytes already there,
+ * 		without sending it.  Waits for room as send() does.
+ * @return	len for success else 0 when the connection is gone.
+ */
+uint16_t queueData(SOCKET s, uint16_t queued, const uint8_t * buf, uint16_t len)
+{
+  uint8_t status=0;
+
+  if (queued + len > W5100.SSIZE)
+    return 0;
+
+  // the free size only counts data up to the last SEND, not what is queued since
+  while (W5100.getTXFreeSize(s) < queued + len)
+  {
+    status = W5100.readSnSR(s);
+    if ((status != SnSR::ESTABLISHED) && (status != SnSR::CLOSE_WAIT))
+      return 0;
+  }
+
+  // TX_WR stays at the last SEND until sendQueued() moves it past everything queued
+  W5100.write_data_offset(s, queued, buf, len);
+  return len;
+}
+
+
+/**
+ * @brief	Sends the len bytes queued by queueData() as one SEND command.
+ * @return	1 for success else 0.
+ */
+int sendQueued(SOCKET s, uint16_t len)
+{
+  W5100.writeSnTX_WR(s, W5100.readSnTX_WR(s) + len);
+  W5100.execCmdSn(s, Sock_SEND);
+
+  while ( (W5100.readSnIR(s) & SnIR::SEND_OK) != SnIR::SEND_OK ) 
+  {
+    if ( W5100.readSnSR(s) == SnSR::CLOSED )
+    {
+      close(s);
+      return 0;
+    }
+  }
+  W5100.writeSnIR(s, SnIR::SEND_OK);
+  return 1;
+}
+
+
 /**
  * @brief	This function is an application I/F function which is used to receive the data in TCP mode.
  * 		It continues to wait for data as much as the application wants to receive.
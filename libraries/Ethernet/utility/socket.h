@@ -9,6 +9,8 @@ extern uint8_t connect(SOCKET s, uint8_t * addr, uint16_t port); // Establish TC
 extern void disconnect(SOCKET s); // disconnect the connection
 extern uint8_t listen(SOCKET s);	// Establish TCP connection (Passive connection)
 extern uint16_t send(SOCKET s, const uint8_t * buf, uint16_t len); // Send data (TCP)
+extern uint16_t queueData(SOCKET s, uint16_t queued, const uint8_t * buf, uint16_t len); // Queue data without sending it (TCP)
+extern int sendQueued(SOCKET s, uint16_t len); // Send the queued data (TCP)
 extern int16_t recv(SOCKET s, uint8_t * buf, int16_t len);	// Receive data (TCP)
 extern uint16_t peek(SOCKET s, uint8_t *buf);
 extern uint16_t sendto(SOCKET s, const uint8_t * buf, uint16_t len, uint8_t * addr, uint16_t port); // Send data (UDP/IP RAW)
@@ -23,21 +23,118 @@ W5100Class W5100;
 #define TXBUF_BASE 0x4000
 #define RXBUF_BASE 0x6000
 
+#define TXBUF_BASE_W5200 0x8000
+#define RXBUF_BASE_W5200 0xC000
+#define BUF_TOTAL_W5200 16384
+
+uint8_t W5100Class::chip = 0;
+uint8_t W5100Class::sockets = 4;
+uint16_t W5100Class::CH_BASE = 0x0400;
+uint16_t W5100Class::SSIZE = 2048;
+uint16_t W5100Class::RSIZE = 2048;
+uint16_t W5100Class::SMASK = 0x07FF;
+uint16_t W5100Class::RMASK = 0x07FF;
+
 void W5100Class::init(void)
 {
   delay(300);
 
   SPI.begin();
   initSS();
-  
-  writeMR(1<<RST);
-  writeTMSR(0x55);
-  writeRMSR(0x55);
 
-  for (int i=0; i<MAX_SOCK_NUM; i++) {
-    SBASE[i] = TXBUF_BASE + SSIZE * i;
-    RBASE[i] = RXBUF_BASE + RSIZE * i;
+  // each probe sets the chip it tries, a W5100 is assumed when none answers
+  if (!isW5100() && !isW5200() && !isW5500()) {
+    chip = 0;
+    CH_BASE = 0x0400;
+  }
+
+  if (chip == 52 || chip == 55) {
+    sockets = MAX_SOCK_NUM < 8 ? MAX_SOCK_NUM : 8;
+    SSIZE = BUF_TOTAL_W5200;
+    while (SSIZE > 2048 && (uint32_t)SSIZE * sockets > BUF_TOTAL_W5200)
+      SSIZE >>= 1;
+    RSIZE = SSIZE;
+    for (int i=0; i<8; i++) {
+      writeSnTX_SIZE(i, i < sockets ? SSIZE >> 10 : 0);
+      writeSnRX_SIZE(i, i < sockets ? RSIZE >> 10 : 0);
+    }
+    for (int i=0; i<sockets; i++) {
+      SBASE[i] = TXBUF_BASE_W5200 + SSIZE * i;
+      RBASE[i] = RXBUF_BASE_W5200 + RSIZE * i;
+    }
+  } else {
+    sockets = MAX_SOCK_NUM < 4 ? MAX_SOCK_NUM : 4;
+    SSIZE = RSIZE = 2048;
+    writeTMSR(0x55);
+    writeRMSR(0x55);
+    for (int i=0; i<sockets; i++) {
+      SBASE[i] = TXBUF_BASE + SSIZE * i;
+      RBASE[i] = RXBUF_BASE + RSIZE * i;
+    }
+  }
+  SMASK = SSIZE - 1;
+  RMASK = RSIZE - 1;
+}
+
+uint8_t W5100Class::softReset()
+{
+  writeMR(1<<RST);
+  // the reset bit clears itself when done
+  for (uint8_t i=0; i<20; i++) {
+    if (readMR() == 0)
+      return 1;
+    delay(1);
   }
+  return 0;
+}
+
+// A chip only keeps MR bits written in its own frame format
+uint8_t W5100Class::isW5100()
+{
+  chip = 51;
+  CH_BASE = 0x0400;
+  if (!softReset())
+    return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10)
+    return 0;
+  writeMR(0x12);
+  if (readMR() != 0x12)
+    return 0;
+  writeMR(0x00);
+  return readMR() == 0x00;
+}
+
+uint8_t W5100Class::isW5200()
+{
+  chip = 52;
+  CH_BASE = 0x4000;
+  if (!softReset())
+    return 0;
+  writeMR(0x08);
+  if (readMR() != 0x08)
+    return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10)
+    return 0;
+  writeMR(0x00);
+  return readMR() == 0x00 && readVERSIONR_W5200() == 0x03;
+}
+
+uint8_t W5100Class::isW5500()
+{
+  chip = 55;
+  CH_BASE = 0x4000;
+  if (!softReset())
+    return 0;
+  writeMR(0x08);
+  if (readMR() != 0x08)
+    return 0;
+  writeMR(0x10);
+  if (readMR() != 0x10)
+    return 0;
+  writeMR(0x00);
+  return readMR() == 0x00 && readVERSIONR_W5500() == 0x04;
 }
 
 uint16_t W5100Class::getTXFreeSize(SOCKET s)
@@ -72,6 +169,11 @@ void W5100Class::send_data_processing(SOCKET s, const uint8_t *data, uint16_t le
 }
 
 void W5100Class::send_data_processing_offset(SOCKET s, uint16_t data_offset, const uint8_t *data, uint16_t len)
+{
+  writeSnTX_WR(s, write_data_offset(s, data_offset, data, len));
+}
+
+uint16_t W5100Class::write_data_offset(SOCKET s, uint16_t data_offset, const uint8_t *data, uint16_t len)
 {
   uint16_t ptr = readSnTX_WR(s);
   ptr += data_offset;
@@ -89,8 +191,7 @@ void W5100Class::send_data_processing_offset(SOCKET s, uint16_t data_offset, con
     write(dstAddr, data, len);
   }
 
-  ptr += len;
-  writeSnTX_WR(s, ptr);
+  return ptr + len;
 }
 
 
@@ -129,6 +230,8 @@ void W5100Class::read_data(SOCKET s, volatile uint8_t *src, volatile uint8_t *ds
 
 uint8_t W5100Class::write(uint16_t _addr, uint8_t _data)
 {
+  if (chip == 52 || chip == 55)
+    return write(_addr, &_data, 1);
   setSS();  
   SPI.transfer(0xF0);
   SPI.transfer(_addr >> 8);
@@ -140,6 +243,22 @@ uint8_t W5100Class::write(uint16_t _addr, uint8_t _data)
 
 uint16_t W5100Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
 {
+  if (chip == 52 || chip == 55) {
+    setSS();
+    if (chip == 52) {
+      SPI.transfer(_addr >> 8);
+      SPI.transfer(_addr & 0xFF);
+      SPI.transfer(0x80 | (_len >> 8));
+      SPI.transfer(_len & 0xFF);
+    } else {
+      beginW5500(_addr, 0x04);
+    }
+    for (uint16_t i=0; i<_len; i++)
+      SPI.transfer(_buf[i]);
+    resetSS();
+    return _len;
+  }
+
   for (uint16_t i=0; i<_len; i++)
   {
     setSS();    
@@ -155,6 +274,11 @@ uint16_t W5100Class::write(uint16_t _addr, const uint8_t *_buf, uint16_t _len)
 
 uint8_t W5100Class::read(uint16_t _addr)
 {
+  if (chip == 52 || chip == 55) {
+    uint8_t _data;
+    read(_addr, &_data, 1);
+    return _data;
+  }
   setSS();  
   SPI.transfer(0x0F);
   SPI.transfer(_addr >> 8);
@@ -166,6 +290,22 @@ uint8_t W5100Class::read(uint16_t _addr)
 
 uint16_t W5100Class::read(uint16_t _addr, uint8_t *_buf, uint16_t _len)
 {
+  if (chip == 52 || chip == 55) {
+    setSS();
+    if (chip == 52) {
+      SPI.transfer(_addr >> 8);
+      SPI.transfer(_addr & 0xFF);
+      SPI.transfer(_len >> 8);
+      SPI.transfer(_len & 0xFF);
+    } else {
+      beginW5500(_addr, 0x00);
+    }
+    for (uint16_t i=0; i<_len; i++)
+      _buf[i] = SPI.transfer(0);
+    resetSS();
+    return _len;
+  }
+
   for (uint16_t i=0; i<_len; i++)
   {
     setSS();
@@ -179,6 +319,27 @@ uint16_t W5100Class::read(uint16_t _addr, uint8_t *_buf, uint16_t _len)
   return _len;
 }
 
+// The W5500 selects the common registers, or a socket's registers, TX or
+// RX buffer, by a block number in the control byte that follows the
+// address.  Buffer offsets are taken within the socket's own block.
+void W5100Class::beginW5500(uint16_t _addr, uint8_t _rw)
+{
+  uint8_t block = 0;
+
+  if (_addr >= TXBUF_BASE_W5200) {
+    uint16_t offset = _addr & (BUF_TOTAL_W5200 - 1);
+    uint8_t s = offset / SSIZE;
+    block = (s << 2) + (_addr >= RXBUF_BASE_W5200 ? 3 : 2);
+    _addr = offset & SMASK;
+  } else if (_addr >= CH_BASE) {
+    block = (((_addr - CH_BASE) / CH_SIZE) << 2) + 1;
+    _addr &= CH_SIZE - 1;
+  }
+  SPI.transfer(_addr >> 8);
+  SPI.transfer(_addr & 0xFF);
+  SPI.transfer((block << 3) | _rw);
+}
+
 void W5100Class::execCmdSn(SOCKET s, SockCMD _cmd) {
   // Send command to socket
   writeSnCR(s, _cmd);
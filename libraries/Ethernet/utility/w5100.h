@@ -13,7 +13,14 @@
 #include <avr/pgmspace.h>
 #include <SPI.h>
 
+// The W5100 has 4 sockets, the W5200 and W5500 have 8
+#ifndef MAX_SOCK_NUM
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1284P__)
+#define MAX_SOCK_NUM 8
+#else
 #define MAX_SOCK_NUM 4
+#endif
+#endif
 
 typedef uint8_t SOCKET;
 
@@ -126,11 +133,34 @@ public:
   static const uint8_t RAW  = 255;
 };
 
+/*
+ * The same interface drives the W5100, W5200 and W5500, which one is
+ * found by init().  Addresses follow the W5100 map for the common
+ * registers; socket registers start at CH_BASE and the socket buffers
+ * at SBASE and RBASE:
+ *
+ *            sockets  socket registers  TX buffers  RX buffers
+ *   W5100    4        0x0400            0x4000      0x6000       2 KB each
+ *   W5200    8        0x4000            0x8000      0xC000       16 KB shared
+ *   W5500    8        as the W5200, turned into block selects
+ *
+ * On the W5200 and W5500 the 16 KB of each direction is split evenly
+ * between the sockets in use, 4 KB each with MAX_SOCK_NUM at 4.
+ *
+ * The W5100 takes a 4 byte SPI frame for every byte.  The W5200 and
+ * W5500 take one frame for a whole run of bytes, so buffer copies are
+ * made in one burst, or two where the ring wraps.
+ */
 class W5100Class {
 
 public:
   void init();
 
+  // 51, 52 or 55 for the chip found by init(), 0 when none answered
+  static uint8_t getChip() { return chip; };
+  // sockets that can be used, at most MAX_SOCK_NUM
+  static uint8_t getSocketCount() { return sockets; };
+
   /**
    * @brief	This function is being used for copy the data form Receive buffer of the chip to application buffer.
    * 
@@ -159,6 +189,12 @@ public:
    */
 // FIXME Update documentation
   void send_data_processing_offset(SOCKET s, uint16_t data_offset, const uint8_t *data, uint16_t len);
+  /**
+   * @brief Copies data into the TX buffer data_offset bytes past TX_WR,
+   *        leaving TX_WR where it is
+   * @return TX_WR value that would include the data
+   */
+  uint16_t write_data_offset(SOCKET s, uint16_t data_offset, const uint8_t *data, uint16_t len);
 
   /**
    * @brief	This function is being called by recv() also.
@@ -197,6 +233,12 @@ private:
   static uint16_t write(uint16_t addr, const uint8_t *buf, uint16_t len);
   static uint8_t read(uint16_t addr);
   static uint16_t read(uint16_t addr, uint8_t *buf, uint16_t len);
+  static void beginW5500(uint16_t addr, uint8_t rw);
+
+  static uint8_t softReset();
+  static uint8_t isW5100();
+  static uint8_t isW5200();
+  static uint8_t isW5500();
   
 #define __GP_REGISTER8(name, address)             \
   static inline void write##name(uint8_t _data) { \
@@ -240,6 +282,11 @@ public:
   __GP_REGISTER8 (PMAGIC, 0x0029);    // PPP LCP Magic Number
   __GP_REGISTER_N(UIPR,   0x002A, 4); // Unreachable IP address in UDP mode
   __GP_REGISTER16(UPORT,  0x002E);    // Unreachable Port address in UDP mode
+
+  __GP_REGISTER8 (VERSIONR_W5200, 0x001F); // Chip version, 0x03
+  __GP_REGISTER16(RTR_W5500,      0x0019); // Timeout address
+  __GP_REGISTER8 (RCR_W5500,      0x001B); // Retry count
+  __GP_REGISTER8 (VERSIONR_W5500, 0x0039); // Chip version, 0x04
   
 #undef __GP_REGISTER8
 #undef __GP_REGISTER16
@@ -253,7 +300,7 @@ private:
   static inline uint16_t readSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
   static inline uint16_t writeSn(SOCKET _s, uint16_t _addr, uint8_t *_buf, uint16_t len);
 
-  static const uint16_t CH_BASE = 0x0400;
+  static uint16_t CH_BASE;
   static const uint16_t CH_SIZE = 0x0100;
 
 #define __SOCKET_REGISTER8(name, address)                    \
@@ -303,6 +350,8 @@ public:
   __SOCKET_REGISTER16(SnRX_RSR,   0x0026)        // RX Free Size
   __SOCKET_REGISTER16(SnRX_RD,    0x0028)        // RX Read Pointer
   __SOCKET_REGISTER16(SnRX_WR,    0x002A)        // RX Write Pointer (supported?)
+  __SOCKET_REGISTER8(SnRX_SIZE,   0x001E)        // RX Buffer Size in KB, W5200 and W5500
+  __SOCKET_REGISTER8(SnTX_SIZE,   0x001F)        // TX Buffer Size in KB, W5200 and W5500
   
 #undef __SOCKET_REGISTER8
 #undef __SOCKET_REGISTER16
@@ -312,15 +361,16 @@ public:
 private:
   static const uint8_t  RST = 7; // Reset BIT
 
-  static const int SOCKETS = 4;
-  static const uint16_t SMASK = 0x07FF; // Tx buffer MASK
-  static const uint16_t RMASK = 0x07FF; // Rx buffer MASK
+  static uint8_t chip;
+  static uint8_t sockets;
+  static uint16_t SMASK; // Tx buffer MASK
+  static uint16_t RMASK; // Rx buffer MASK
 public:
-  static const uint16_t SSIZE = 2048; // Max Tx buffer size
+  static uint16_t SSIZE; // Max Tx buffer size
 private:
-  static const uint16_t RSIZE = 2048; // Max Rx buffer size
-  uint16_t SBASE[SOCKETS]; // Tx buffer base address
-  uint16_t RBASE[SOCKETS]; // Rx buffer base address
+  static uint16_t RSIZE; // Max Rx buffer size
+  uint16_t SBASE[MAX_SOCK_NUM]; // Tx buffer base address
+  uint16_t RBASE[MAX_SOCK_NUM]; // Rx buffer base address
 
 private:
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
@@ -398,11 +448,17 @@ void W5100Class::setIPAddress(uint8_t *_addr) {
 }
 
 void W5100Class::setRetransmissionTime(uint16_t _timeout) {
-  writeRTR(_timeout);
+  if (chip == 55)
+    writeRTR_W5500(_timeout);
+  else
+    writeRTR(_timeout);
 }
 
 void W5100Class::setRetransmissionCount(uint8_t _retry) {
-  writeRCR(_retry);
+  if (chip == 55)
+    writeRCR_W5500(_retry);
+  else
+    writeRCR(_retry);
 }
 
 #endif
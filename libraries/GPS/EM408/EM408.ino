@@ -1,4 +1,5 @@
 #include <SoftwareSerial.h>
+#include <NMEAParser.h>
 #include "GPS.h"
 
 #include <Wire.h>
@@ -7,158 +7,70 @@
 
 #include "GPS.h"
 
+// degrees and minutes x100 as before, "3540.1234" gives 354012
+static long degreesMinutes(const char * s, char hemisphere) {
+	long v = NMEAParser::decimal(s, 2);
+	return (hemisphere == 'S' || hemisphere == 'W') ? -v : v;
+}
+
 boolean GPS::update(const byte typemask) {
 	long lasttime = time;
 	if ( ! getSentence() )
 		return false;
-	switch(sentenceType() & typemask) {
+	switch(type & typemask) {
 	case GGA:
-		time = getFloat(GGA_UTC)*100;
-	    latitude = getFloat(GGA_LATITUDE)*100;
-	    if ( getChar(GGA_LATITUDE+1) == 'S' )
-	    	latitude = -latitude;
-	    longitude = getFloat(GGA_LONGITUDE)*100;
-	    if ( getChar(GGA_LONGITUDE+1) == 'W' )
-	    	longitude = -longitude;
-	    dilution = getFloat(GGA_DILUTION);
-	    altitude = getFloat(GGA_ALTITUDE);
+		time = nmea.time;
+	    latitude = degreesMinutes(getPtr(GGA_LATITUDE), getChar(GGA_LATITUDE+1));
+	    longitude = degreesMinutes(getPtr(GGA_LONGITUDE), getChar(GGA_LONGITUDE+1));
+	    dilution = NMEAParser::decimal(getPtr(GGA_DILUTION), 2) / 100.0;
+	    altitude = NMEAParser::decimal(getPtr(GGA_ALTITUDE), 2) / 100.0;
     	return (time != 0) && (lasttime != time);
 		break;
 	case RMC:
-		time = getFloat(RMC_UTC)*100;
-		latitude = getFloat(RMC_LATITUDE)*100;
-	    if ( getChar(RMC_LATITUDE+1) == 'S' )
-	    	latitude = -latitude;
-		longitude = getFloat(RMC_LONGITUDE)*100;
-	    if ( getChar(RMC_LONGITUDE+1) == 'W' )
-	    	longitude = -longitude;
-		grndspeed = getFloat(RMC_GROUNDSPEED);
-		trackangle = getFloat(RMC_TRACKANGLE);
-		caldate = getLong(RMC_DATE);
-		caldate = (2000 + (caldate % 100)) * 10000
-				+ (caldate / 100 % 100) * 100 + (caldate / 10000);
+		time = nmea.time;
+		latitude = degreesMinutes(getPtr(RMC_LATITUDE), getChar(RMC_LATITUDE+1));
+		longitude = degreesMinutes(getPtr(RMC_LONGITUDE), getChar(RMC_LONGITUDE+1));
+		grndspeed = NMEAParser::decimal(getPtr(RMC_GROUNDSPEED), 2) / 100.0;
+		trackangle = NMEAParser::decimal(getPtr(RMC_TRACKANGLE), 2) / 100.0;
+		caldate = nmea.date;
     	return (time != 0) && (lasttime != time);
 		break;
 	case ZDA:
-		caldate = getLong(4) * 10000 + getLong(3) * 100 + getLong(2);
+		caldate = nmea.date;
 		return true;
 		break;
 	}
 	return false;
 }
 
+// true when a sentence with a valid checksum has been completed
 boolean GPS::getSentence() {
-	char c;
 	while (port.available()) {
-		c = (char) port.read();
-		if (!isprint(c)) {
-			if (pos == 0)
-				continue;
-			break;
-		}
-		if (c == '$') {
-			pos = 0;
-			buffer[0] = 0;
-			continue;
-		}
-		buffer[pos] = c;
-		pos++;
-		buffer[pos] = 0;
-	}
-	if (isprint(c))
-		return false;
-	if (pos == 0)
-		return false;
-	//
-	int i;
-	byte xsum = 0;
-	for (i = 0; buffer[i] && buffer[i] != '*'; i++) {
-		xsum ^= buffer[i];
-	}
-	if (buffer[i] == '*') {
-		i++;
-		if (xsum == (byte) strtol(buffer + i, NULL, 16)) {
-			pos = 0;
+		type = nmea.encode((char) port.read());
+		if (type)
 			return true;
-		}
 	}
 	return false;
 }
 
 
 void GPS::copyItem(char * dst, int inum) {
-	int i;
-	int icount = 0;
-	int p = 0; // if buffer[0] == $ then p must be 1.
-	dst[0] = 0;
-	for (i = 0; buffer[i]; i++) {
-		if (buffer[i] == ',' or buffer[i] == '*') {
-			if (icount == inum) {
-				strncpy(dst, buffer + p, i - p);
-				dst[i - p] = 0;
-				return;
-			}
-			if (buffer[i] == '*')
-				break;
-			icount++;
-			p = i + 1;
-		}
-	}
-	return;
+	nmea.copyField(inum, dst, NMEA_BUFFER_SIZE);
 }
 
+// the item runs to the next ',' or the end of the sentence
 const char * GPS::getPtr(int inum) {
-	int i;
-	int icount = 0;
-	int p = 0; // if buffer[0] == $ then p must be 1.
-	for (i = 0; buffer[i]; i++) {
-		if (icount == inum) {
-			return buffer+i;
-		}
-		if ( buffer[i] == ',' ) {
-			icount++;
-		}
-	}
-	return NULL;
+	return nmea.field(inum);
 }
 
 char GPS::getChar(int inum) {
-	//char tmp[16] = "";
-	//copyItem(tmp, inum);
-	return *getPtr(inum); //tmp[0];
+	return nmea.fieldChar(inum);
 }
 
 long GPS::getLong(int inum) {
-//	char tmp[16] = "";
-//	copyItem(tmp, inum);
-	return atol(getPtr(inum)); //tmp);
+	return atol(getPtr(inum));
 }
 
 float GPS::getFloat(int inum) {
-//	char tmp[16] = "";
-//	copyItem(tmp, inum);
-	return atof(getPtr(inum)); //tmp);
-}
-
-const byte GPS::sentenceType() {
-	char * p = buffer + 2;
-	char c = *p++;
-	if (c == 'G') {
-		if (strncmp(p, "GA", 2) == 0)
-			return GGA;
-		if (strncmp(p, "LL", 2) == 0)
-			return GLL;
-		if (strncmp(p, "SA", 2) == 0)
-			return GSA;
-		if (strncmp(p, "SV", 2) == 0)
-			return GSV;
-	} else if ( c == 'R') {
-		if (strncmp(p, "MC", 2) == 0)
-			return RMC;
-	} else if ( c == 'Z') {
-		if (strncmp(p, "DA", 2) == 0)
-			return ZDA;
-	}
-	return 0;
+	return atof(getPtr(inum));
 }
-
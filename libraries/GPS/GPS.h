@@ -15,11 +15,12 @@
 #endif
 #include <ctype.h>
 //#include <inttype.h>
+#include <NMEAParser.h>
 
 class GPS {
 	Stream & port;
-	char buffer[128];
-	int pos;
+	NMEAParser nmea;
+	byte type;
 
 public:
 	long time; 			// time in decimal HHMMSS.ss x100 format
@@ -33,8 +34,7 @@ public:
 
 public:
 	GPS(Stream & serial) : port(serial) {
-		pos = 0;
-		buffer[0] = 0;
+		type = NMEAParser::NONE;
 
 		time = 0;
 		caldate = 0;
@@ -43,9 +43,12 @@ public:
 		dilution = 0;
 	}
 
-	char * sentence() { return buffer; }
-	void clear() { buffer[0] = 0; pos = 0; }
-	const byte sentenceType();
+	// the last sentence without '$' and checksum
+	const char * sentence() { return nmea.sentence(); }
+	void clear() { nmea.reset(); type = NMEAParser::NONE; }
+	const byte sentenceType() { return type; }
+	// the parser, for the decoded values in integer units
+	NMEAParser & parser() { return nmea; }
 
 	boolean update(const byte typemask);
 	boolean getSentence();
@@ -59,16 +62,17 @@ public:
 public: // const
 
 enum {
-	NONE = 0,
-	GGA = 1<<0,
+	NONE = NMEAParser::NONE,
+	GGA = NMEAParser::GGA,
 	GGA_UTC = 1, GGA_LATITUDE = 2, GGA_LONGITUDE = 4, GGA_FIXQUALITY = 6,
 	GGA_NUMBEROFSATELLITES = 7, GGA_DILUTION = 8, GGA_ALTITUDE = 9,
-	GLL = 1<<2,
-	GSA = 1<<3,
-	GSV = 1<<4,
-	RMC = 1<<5,
+	VTG = NMEAParser::VTG,
+	GLL = NMEAParser::GLL,
+	GSA = NMEAParser::GSA,
+	GSV = NMEAParser::GSV,
+	RMC = NMEAParser::RMC,
 	RMC_UTC = 1, RMC_LATITUDE = 3, RMC_LONGITUDE = 5, RMC_GROUNDSPEED = 7, RMC_TRACKANGLE = 8, RMC_DATE = 9,
-	ZDA = 1<<7,
+	ZDA = NMEAParser::ZDA,
 };
 
 	/*
@@ -6,9 +6,9 @@
  */
 
 #include "MindSet.h"
+#include <CRC.h>
 
 boolean MindSet::getPacket() {
-	byte xsum = 0;
 	payload[2] = 0;
 	int pos = 0;
 	while (btPort.available() > 0) {
@@ -49,11 +49,12 @@ boolean MindSet::getPacket() {
 			if (!(btPort.available() > 0))
 				continue;
 			payload[i + pos_payhead] = btPort.read();
-			xsum += payload[i + pos_payhead];
 			i++;
 		}
 		payload[payload[pos_paylength] + pos_payhead] = btPort.read();
-		if ((xsum + packetChecksum()) & 0xff != 255) {
+		// the checksum is the complement of the payload sum
+		byte xsum = sum8(0, payload + pos_payhead, payload[pos_paylength]);
+		if ((byte) (xsum + packetChecksum()) != 255) {
 			/*
 			 Serial.println();
 			 Serial.print(" xsum = ");
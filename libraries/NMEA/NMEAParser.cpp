@@ -0,0 +1,279 @@
+/*
+ * NMEAParser.cpp
+ *
+ *  Incremental NMEA 0183 parser, see NMEAParser.h
+ */
+
+#include "NMEAParser.h"
+
+const NMEAParser::Sentence NMEAParser::table[] = {
+	{ "GGA", GGA, &NMEAParser::decodeGGA },
+	{ "RMC", RMC, &NMEAParser::decodeRMC },
+	{ "VTG", VTG, &NMEAParser::decodeVTG },
+	{ "GSA", GSA, &NMEAParser::decodeGSA },
+	{ "GSV", GSV, &NMEAParser::decodeGSV },
+	{ "ZDA", ZDA, &NMEAParser::decodeZDA },
+	{ "GLL", GLL, &NMEAParser::decodeGLL },
+};
+
+NMEAParser::NMEAParser() {
+	reset();
+	time = 0;
+	date = 0;
+	latitude = 0;
+	longitude = 0;
+	altitude = 0;
+	speed = 0;
+	course = 0;
+	hdop = pdop = vdop = 9999;
+	quality = 0;
+	mode = 1;
+	satellites = 0;
+	inView = 0;
+	valid = false;
+	updated = 0;
+	sentences = 0;
+	checksumErrors = 0;
+	overruns = 0;
+}
+
+void NMEAParser::reset() {
+	state = IDLE;
+	length = 0;
+	count = 0;
+	buffer[0] = 0;
+}
+
+static byte hexValue(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return 0xff;
+}
+
+byte NMEAParser::encode(char c) {
+	if (c == '$') {
+		state = DATA;
+		length = 0;
+		count = 1;
+		offsets[0] = 0;
+		sum = 0;
+		return NONE;
+	}
+	switch (state) {
+	case DATA:
+		if (c == '*') {
+			buffer[length] = 0;
+			offsets[count] = length + 1;
+			state = CHECK_HIGH;
+			return NONE;
+		}
+		if (c == '\r' || c == '\n' || length >= NMEA_BUFFER_SIZE - 1) {
+			// no checksum, or no end in sight
+			overruns++;
+			state = IDLE;
+			return NONE;
+		}
+		sum ^= c;
+		buffer[length++] = c;
+		if (c == ',') {
+			if (count == NMEA_MAX_FIELDS) {
+				overruns++;
+				state = IDLE;
+				return NONE;
+			}
+			offsets[count++] = length;
+		}
+		return NONE;
+	case CHECK_HIGH:
+		check = hexValue(c) << 4;
+		state = hexValue(c) < 16 ? CHECK_LOW : IDLE;
+		return NONE;
+	case CHECK_LOW:
+		state = IDLE;
+		if (hexValue(c) > 15 || (check | hexValue(c)) != sum) {
+			checksumErrors++;
+			return NONE;
+		}
+		sentences++;
+		return identify();
+	}
+	return NONE;
+}
+
+// look the sentence up without its two letter talker and decode it
+byte NMEAParser::identify() {
+	const char * id = buffer + 2;
+	if (buffer[0] != 'P' && fieldLength(0) == 5) {
+		for (byte i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+			const Sentence & t = table[i];
+			if (id[0] == t.id[0] && id[1] == t.id[1] && id[2] == t.id[2]) {
+				(this->*t.decode)();
+				updated |= t.type;
+				return t.type;
+			}
+		}
+	}
+	return OTHER;
+}
+
+const char * NMEAParser::field(byte i) const {
+	if (i >= count)
+		return buffer + length;   // the terminating NUL
+	return buffer + offsets[i];
+}
+
+byte NMEAParser::fieldLength(byte i) const {
+	if (i >= count)
+		return 0;
+	return offsets[i + 1] - offsets[i] - 1;
+}
+
+void NMEAParser::copyField(byte i, char * dst, byte size) const {
+	byte n = fieldLength(i);
+	if (n > size - 1)
+		n = size - 1;
+	memcpy(dst, field(i), n);
+	dst[n] = 0;
+}
+
+long NMEAParser::decimal(const char * s, byte decimals) {
+	boolean negative = false;
+	long d = 0;
+	if (*s == '-') {
+		negative = true;
+		s++;
+	}
+	while (*s >= '0' && *s <= '9')
+		d = d * 10 + (*s++ - '0');
+	if (*s == '.')
+		s++;
+	for (; decimals > 0; decimals--) {
+		d *= 10;
+		if (*s >= '0' && *s <= '9')
+			d += *s++ - '0';
+	}
+	return negative ? -d : d;
+}
+
+long NMEAParser::coordinate(const char * s) {
+	// the minutes take the last two digits before the point
+	const char * p = s;
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (p - s < 2)
+		return 0;
+	long degrees = 0;
+	for (p -= 2; s < p; s++)
+		degrees = degrees * 10 + (*s - '0');
+	long minutes = decimal(p, 5);   // x10^5
+	return degrees * 10000000L + minutes * 5 / 3;
+}
+
+/*
+ * $GPGGA,hhmmss.ss,llll.ll,a,yyyyy.yy,a,q,nn,h.h,a.a,M,g.g,M,,*hh
+ */
+void NMEAParser::decodeGGA() {
+	if (fieldLength(1))
+		time = fieldDecimal(1, 2);
+	if (fieldLength(2) && fieldLength(4)) {
+		latitude = coordinate(field(2));
+		if (fieldChar(3) == 'S')
+			latitude = -latitude;
+		longitude = coordinate(field(4));
+		if (fieldChar(5) == 'W')
+			longitude = -longitude;
+	}
+	quality = fieldDecimal(6, 0);
+	satellites = fieldDecimal(7, 0);
+	if (fieldLength(8))
+		hdop = fieldDecimal(8, 2);
+	if (fieldLength(9))
+		altitude = fieldDecimal(9, 2);
+}
+
+/*
+ * $GPGLL,llll.ll,a,yyyyy.yy,a,hhmmss.ss,A*hh
+ */
+void NMEAParser::decodeGLL() {
+	valid = fieldChar(6) == 'A';
+	if (fieldLength(5))
+		time = fieldDecimal(5, 2);
+	if (valid && fieldLength(1) && fieldLength(3)) {
+		latitude = coordinate(field(1));
+		if (fieldChar(2) == 'S')
+			latitude = -latitude;
+		longitude = coordinate(field(3));
+		if (fieldChar(4) == 'W')
+			longitude = -longitude;
+	}
+}
+
+/*
+ * $GPGSA,A,3,ss,ss,ss,ss,ss,ss,ss,ss,ss,ss,ss,ss,p.p,h.h,v.v*hh
+ */
+void NMEAParser::decodeGSA() {
+	mode = fieldDecimal(2, 0);
+	if (fieldLength(15))
+		pdop = fieldDecimal(15, 2);
+	if (fieldLength(16))
+		hdop = fieldDecimal(16, 2);
+	if (fieldLength(17))
+		vdop = fieldDecimal(17, 2);
+}
+
+/*
+ * $GPGSV,m,n,tt,ss,ee,aaa,cc,...*hh
+ */
+void NMEAParser::decodeGSV() {
+	inView = fieldDecimal(3, 0);
+}
+
+/*
+ * $GPRMC,hhmmss.ss,A,llll.ll,a,yyyyy.yy,a,k.k,c.c,ddmmyy,m.m,a*hh
+ */
+void NMEAParser::decodeRMC() {
+	if (fieldLength(1))
+		time = fieldDecimal(1, 2);
+	valid = fieldChar(2) == 'A';
+	if (valid && fieldLength(3) && fieldLength(5)) {
+		latitude = coordinate(field(3));
+		if (fieldChar(4) == 'S')
+			latitude = -latitude;
+		longitude = coordinate(field(5));
+		if (fieldChar(6) == 'W')
+			longitude = -longitude;
+	}
+	if (fieldLength(7))
+		speed = fieldDecimal(7, 2) * 1852 / 3600;   // knots x100 to cm/s
+	if (fieldLength(8))
+		course = fieldDecimal(8, 2);
+	if (fieldLength(9) == 6) {
+		long d = fieldDecimal(9, 0);
+		date = (2000 + d % 100) * 10000L + (d / 100 % 100) * 100 + d / 10000;
+	}
+}
+
+/*
+ * $GPVTG,c.c,T,c.c,M,k.k,N,k.k,K*hh
+ */
+void NMEAParser::decodeVTG() {
+	if (fieldLength(1))
+		course = fieldDecimal(1, 2);
+	if (fieldLength(7))
+		speed = fieldDecimal(7, 2) * 5 / 18;   // km/h x100 to cm/s
+}
+
+/*
+ * $GPZDA,hhmmss.ss,dd,mm,yyyy,zh,zm*hh
+ */
+void NMEAParser::decodeZDA() {
+	if (fieldLength(1))
+		time = fieldDecimal(1, 2);
+	if (fieldLength(4))
+		date = fieldDecimal(4, 0) * 10000 + fieldDecimal(3, 0) * 100
+				+ fieldDecimal(2, 0);
+}
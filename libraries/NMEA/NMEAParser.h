@@ -0,0 +1,142 @@
+/*
+ * NMEAParser.h
+ *
+ *  Incremental NMEA 0183 parser shared by the GPS and AP_GPS libraries.
+ *
+ *  encode() takes the sentence one byte at a time.  Field offsets are
+ *  recorded as the commas arrive and the checksum is accumulated on the way,
+ *  so a complete sentence is validated without a second pass and any field
+ *  can be reached by its index directly.  Recognised sentences are found
+ *  through a table and decoded into scaled integers, without floating point:
+ *
+ *   time       UTC hhmmss.ss x100
+ *   date       YYYYMMDD
+ *   latitude   degrees x10^7, south negative
+ *   longitude  degrees x10^7, west negative
+ *   altitude   cm above mean sea level
+ *   speed      cm/s over ground
+ *   course     degrees x100
+ *   hdop, pdop, vdop  x100
+ */
+
+#ifndef NMEAPARSER_H_
+#define NMEAPARSER_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+// 82 characters at most by the standard, without '$' and CR LF
+#define NMEA_BUFFER_SIZE 84
+#define NMEA_MAX_FIELDS 24
+
+class NMEAParser {
+public:
+	// sentence types, bits so that a set can be given as a mask
+	enum {
+		NONE = 0,
+		GGA = 1 << 0,
+		VTG = 1 << 1,
+		GLL = 1 << 2,
+		GSA = 1 << 3,
+		GSV = 1 << 4,
+		RMC = 1 << 5,
+		OTHER = 1 << 6,   // valid but not decoded, e.g. $PMTK
+		ZDA = 1 << 7
+	};
+
+	struct Sentence {
+		char id[4];       // without the talker, "GGA"
+		byte type;
+		void (NMEAParser::*decode)();
+	};
+
+private:
+	enum {
+		IDLE = 0, DATA, CHECK_HIGH, CHECK_LOW
+	};
+
+	char buffer[NMEA_BUFFER_SIZE];   // the sentence between '$' and '*'
+	byte length;
+	byte offsets[NMEA_MAX_FIELDS + 1];   // field starts, then one past the end
+	byte count;
+	byte state;
+	byte sum;
+	byte check;
+
+	static const Sentence table[];
+
+	byte identify();
+	long fieldDecimal(byte i, byte decimals) {
+		return decimal(field(i), decimals);
+	}
+
+	void decodeGGA();
+	void decodeGLL();
+	void decodeGSA();
+	void decodeGSV();
+	void decodeRMC();
+	void decodeVTG();
+	void decodeZDA();
+
+public:
+	// decoded values, kept until the next sentence that carries them
+	long time;
+	long date;
+	long latitude;
+	long longitude;
+	long altitude;
+	long speed;
+	long course;
+	int hdop;
+	int pdop;
+	int vdop;
+	byte quality;      // GGA fix quality, 0 = no fix
+	byte mode;         // GSA 1 = no fix, 2 = 2D, 3 = 3D
+	byte satellites;   // used in the fix
+	byte inView;       // satellites in view
+	boolean valid;     // RMC/GLL status A
+	byte updated;      // types decoded since the last clearUpdated()
+
+	// counters
+	unsigned long sentences;
+	unsigned long checksumErrors;
+	unsigned long overruns;
+
+	NMEAParser();
+	void reset();
+
+	// returns the type of a sentence completed with a valid checksum, else 0
+	byte encode(char c);
+
+	// fields of the last sentence, 0 is the address ("GPGGA"); a field
+	// ends at ',' or at the end of the sentence.  They are valid until the
+	// next '$' arrives.
+	byte fields() const {
+		return count;
+	}
+	const char * field(byte i) const;
+	byte fieldLength(byte i) const;
+	char fieldChar(byte i) const {
+		return fieldLength(i) ? *field(i) : 0;
+	}
+	// NUL-terminated copy of at most size - 1 characters
+	void copyField(byte i, char * dst, byte size) const;
+	// the last sentence, NUL-terminated at the '*'
+	const char * sentence() const {
+		return buffer;
+	}
+
+	void clearUpdated() {
+		updated = 0;
+	}
+
+	// "-12.345" with decimals 2 gives -1234; stops at the first non-digit
+	static long decimal(const char * s, byte decimals);
+	// "ddmm.mmmm" or "dddmm.mmmm" to degrees x10^7
+	static long coordinate(const char * s);
+};
+
+#endif /* NMEAPARSER_H_ */
@@ -0,0 +1,101 @@
+/*
+	Benchmark of the NMEAParser.
+
+	Replays a captured 10 Hz epoch (GGA, GSA, three GSV, RMC, VTG and ZDA)
+	through encode() many times over and reports the sentences and bytes
+	parsed per second, the time per sentence and the share of the CPU a
+	receiver sending this epoch at 10 Hz would take.  A log sent to the
+	serial port at 115200 baud is parsed as well and its counters reported.
+*/
+
+#include <NMEAParser.h>
+#include <avr/pgmspace.h>
+
+#define EPOCHS 100		// epochs timed together
+#define RATE 10			// epochs per second of the receiver
+
+// checksums as sent by the receiver
+const char epoch[] PROGMEM =
+	"$GPGGA,123519.20,3540.1234,N,13945.6789,E,1,08,0.9,545.4,M,39.8,M,,*6C\r\n"
+	"$GPGSA,A,3,04,05,09,12,17,22,24,25,26,,,,1.8,0.9,1.5*3E\r\n"
+	"$GPGSV,3,1,11,04,40,083,46,05,17,308,41,09,07,344,39,12,77,168,47*77\r\n"
+	"$GPGSV,3,2,11,17,25,120,44,22,45,062,45,24,12,270,38,25,60,310,48*7A\r\n"
+	"$GPGSV,3,3,11,26,33,215,42,29,05,030,,31,02,190,*48\r\n"
+	"$GPRMC,123519.20,A,3540.1234,N,13945.6789,E,022.4,084.4,260312,003.1,W*43\r\n"
+	"$GPVTG,084.4,T,087.5,M,022.4,N,041.5,K*48\r\n"
+	"$GPZDA,123519.20,26,03,2012,00,00*6F\r\n";
+
+NMEAParser bench;
+NMEAParser nmea;
+
+void setup() {
+	Serial.begin(115200);
+	Serial.println("NMEAParser benchmark");
+	// the epoch once to check the decoding
+	for (unsigned int i = 0; i < sizeof(epoch) - 1; i++)
+		bench.encode(pgm_read_byte(epoch + i));
+	Serial.print("time ");
+	Serial.print(bench.time);
+	Serial.print(" date ");
+	Serial.print(bench.date);
+	Serial.print(" lat ");
+	Serial.print(bench.latitude);
+	Serial.print(" lon ");
+	Serial.print(bench.longitude);
+	Serial.print(" alt cm ");
+	Serial.print(bench.altitude);
+	Serial.print(" speed cm/s ");
+	Serial.print(bench.speed);
+	Serial.print(" course ");
+	Serial.print(bench.course);
+	Serial.print(" hdop ");
+	Serial.print(bench.hdop);
+	Serial.print(" sats ");
+	Serial.print(bench.satellites);
+	Serial.print("/");
+	Serial.println(bench.inView);
+	Serial.print(bench.sentences);
+	Serial.print(" sentences, ");
+	Serial.print(bench.checksumErrors);
+	Serial.println(" checksum errors");
+	Serial.println();
+}
+
+void report_log() {
+	Serial.print("log: ");
+	Serial.print(nmea.sentences);
+	Serial.print(" sentences, ");
+	Serial.print(nmea.checksumErrors);
+	Serial.print(" checksum errors, ");
+	Serial.print(nmea.overruns);
+	Serial.println(" overruns");
+}
+
+void loop() {
+	// a log on the serial port comes first
+	if (Serial.available()) {
+		while (Serial.available())
+			if (nmea.encode(Serial.read()) == NMEAParser::RMC)
+				report_log();
+		return;
+	}
+
+	unsigned long sentences = bench.sentences;
+	unsigned long start = micros();
+	for (int n = 0; n < EPOCHS; n++)
+		for (unsigned int i = 0; i < sizeof(epoch) - 1; i++)
+			bench.encode(pgm_read_byte(epoch + i));
+	unsigned long elapsed = micros() - start;
+	sentences = bench.sentences - sentences;
+	unsigned long bytes = (unsigned long) EPOCHS * (sizeof(epoch) - 1);
+
+	Serial.print(sentences * 1000000.0 / elapsed, 0);
+	Serial.print(" sentences/s, ");
+	Serial.print(bytes * 1000000.0 / elapsed, 0);
+	Serial.print(" bytes/s, ");
+	Serial.print((float) elapsed / sentences, 1);
+	Serial.print(" us/sentence, ");
+	Serial.print(100.0 * RATE * elapsed / EPOCHS / 1000000.0, 2);
+	Serial.println("% CPU at 10 Hz");
+	delay(1000);
+}
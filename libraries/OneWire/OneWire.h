@@ -25,7 +25,9 @@
 #define ONEWIRE_SEARCH 1
 #endif
 
-// You can exclude CRC checks altogether by defining this to 0
+// You can exclude CRC checks altogether by defining this to 0.
+// The CRCs come from the CRC library, so sketches using OneWire
+// must also #include <CRC.h> unless this is 0.
 #ifndef ONEWIRE_CRC
 #define ONEWIRE_CRC 1
 #endif
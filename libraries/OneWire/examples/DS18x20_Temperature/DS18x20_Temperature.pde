@@ -1,4 +1,5 @@
 #include <OneWire.h>
+#include <CRC.h>
 
 // OneWire DS18S20, DS18B20, DS1822 Temperature Example
 //
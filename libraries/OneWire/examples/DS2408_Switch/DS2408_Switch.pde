@@ -1,4 +1,5 @@
 #include <OneWire.h>
+#include <CRC.h>
 
 /*
  * DS2408 8-Channel Addressable Switch
@@ -23,6 +23,7 @@ DS250x add-only programmable memory reader w/SKIP ROM.
  */
 
 #include <OneWire.h>
+#include <CRC.h>
 OneWire ds(6);                    // OneWire bus on digital pin 6
 void setup() {
   Serial.begin (9600);
@@ -87,4 +88,4 @@ void loop() {
 
 
 
-
+
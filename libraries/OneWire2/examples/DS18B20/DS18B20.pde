@@ -1,4 +1,5 @@
 #include <OneWire.h>
+#include <CRC.h>
 
 /* DS18S20 Temperature chip i/o
  
@@ -0,0 +1,163 @@
+/*
+ * OneWireSim.cpp
+ *
+ *  Simulated 1-Wire bus of DS18x20 sensors, see OneWireSim.h
+ */
+
+#include "OneWireSim.h"
+#include <CRC.h>
+
+#define RESET_US 960
+#define SLOT_US 70
+#define BYTE_US (8 * SLOT_US)
+
+unsigned long OneWireSim::clock = 0;
+
+OneWireSim::OneWireSim(SimSensor * sensors, uint8_t count, boolean parasite) {
+	_sensors = sensors;
+	_count = count;
+	_parasite = parasite;
+	_selected = NONE;
+	_command = 0;
+	_position = 0;
+	_searched = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		sensors[i].converted = 0x0550;   // 85 degrees, the power on value
+		sensors[i].doneAt = 0;
+	}
+}
+
+void OneWireSim::makeRom(SimSensor & s, uint8_t family, uint32_t serial) {
+	s.rom[0] = family;
+	for (uint8_t i = 1; i < 7; i++) {
+		s.rom[i] = serial;
+		serial >>= 8;
+	}
+	s.rom[7] = crc8Maxim(0, s.rom, 7);
+	s.raw = 0;
+	s.corrupt = 0;
+}
+
+uint8_t OneWireSim::reset() {
+	clock += RESET_US;
+	_selected = NONE;
+	_command = 0;
+	return _count > 0;
+}
+
+void OneWireSim::skip() {
+	clock += BYTE_US;
+	_selected = ALL;
+}
+
+void OneWireSim::select(const uint8_t rom[8]) {
+	clock += 9 * BYTE_US;
+	_selected = NONE;
+	for (uint8_t i = 0; i < _count; i++)
+		if (memcmp(_sensors[i].rom, rom, 8) == 0)
+			_selected = i;
+}
+
+void OneWireSim::write(uint8_t v, uint8_t power) {
+	clock += BYTE_US;
+	_command = v;
+	_position = 0;
+	switch (v) {
+	case 0x44:
+		for (uint8_t i = 0; i < _count; i++) {
+			if (_selected != ALL && _selected != i)
+				continue;
+			SimSensor & s = _sensors[i];
+			// a parasite part without the strong pull-up does not convert
+			if (_parasite && !power)
+				continue;
+			s.converted = s.raw;
+			s.doneAt = clock + 600000UL + (s.rom[1] * 590UL);
+		}
+		break;
+	case 0xBE:
+		fillScratchpad();
+		break;
+	}
+}
+
+void OneWireSim::write_bytes(const uint8_t * buf, uint16_t count, bool power) {
+	for (uint16_t i = 0; i < count; i++)
+		write(buf[i], power);
+}
+
+void OneWireSim::fillScratchpad() {
+	if (_selected >= _count) {
+		memset(_scratchpad, 0xff, sizeof(_scratchpad));
+		return;
+	}
+	SimSensor & s = _sensors[_selected];
+	int16_t v = s.converted;
+	if (s.rom[0] == 0x10) {
+		// DS18S20: whole degrees in half degree units, and the count
+		// remaining that puts back the sixteenths
+		int16_t half = ((v + 4) >> 4) << 1;
+		_scratchpad[0] = half;
+		_scratchpad[1] = half >> 8;
+		_scratchpad[6] = 12 - (v - (half << 3));
+	} else {
+		_scratchpad[0] = v;
+		_scratchpad[1] = v >> 8;
+		_scratchpad[6] = 0x0c;
+	}
+	_scratchpad[2] = 0x4b;
+	_scratchpad[3] = 0x46;
+	_scratchpad[4] = 0x7f;   // 12 bits
+	_scratchpad[5] = 0xff;
+	_scratchpad[7] = 0x10;
+	_scratchpad[8] = crc8Maxim(0, _scratchpad, 8);
+	if (s.corrupt) {
+		s.corrupt--;
+		_scratchpad[s.corrupt % 8] ^= 0x04;
+	}
+}
+
+uint8_t OneWireSim::read() {
+	clock += BYTE_US;
+	if (_command == 0xBE && _position < sizeof(_scratchpad))
+		return _scratchpad[_position++];
+	return 0xff;
+}
+
+void OneWireSim::read_bytes(uint8_t * buf, uint16_t count) {
+	for (uint16_t i = 0; i < count; i++)
+		buf[i] = read();
+}
+
+uint8_t OneWireSim::read_bit() {
+	clock += SLOT_US;
+	switch (_command) {
+	case 0x44:
+		for (uint8_t i = 0; i < _count; i++)
+			if ((_selected == ALL || _selected == i) && (long) (clock - _sensors[i].doneAt) < 0)
+				return 0;
+		return 1;
+	case 0xB4:
+		return !_parasite;
+	}
+	return 1;
+}
+
+void OneWireSim::write_bit(uint8_t) {
+	clock += SLOT_US;
+}
+
+void OneWireSim::depower() {
+}
+
+void OneWireSim::reset_search() {
+	_searched = 0;
+}
+
+uint8_t OneWireSim::search(uint8_t * rom) {
+	clock += RESET_US + BYTE_US + 64 * 3 * SLOT_US;
+	if (_searched >= _count)
+		return 0;
+	memcpy(rom, _sensors[_searched++].rom, 8);
+	return 1;
+}
@@ -0,0 +1,72 @@
+/*
+ * OneWireSim.h
+ *
+ *  A 1-Wire bus of simulated DS18x20 sensors, with the calls of OneWire,
+ *  for running OneWireSweep and sketches without the hardware.  Bus time
+ *  is counted on a clock shared by every simulated bus, as the buses of a
+ *  bit banging master are driven one at a time: a reset takes 960 us, a
+ *  byte 560 us and a search 14 ms per device.  Sensors take 600 to 750 ms
+ *  to convert, answer read slots with 0 until they are done and can be
+ *  made to corrupt a scratchpad read.
+ *
+ *  The sensors are kept in an array given by the caller.
+ */
+
+#ifndef ONEWIRESIM_H_
+#define ONEWIRESIM_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+struct SimSensor {
+	uint8_t rom[8];
+	int16_t raw;            // 1/16 degree, what the next conversion gives
+	int16_t converted;      // in the scratchpad
+	unsigned long doneAt;   // clock when the running conversion ends
+	uint8_t corrupt;        // scratchpad reads to garble
+};
+
+class OneWireSim {
+public:
+	// microseconds of bus time on every simulated bus
+	static unsigned long clock;
+
+	OneWireSim(SimSensor * sensors, uint8_t count, boolean parasite = false);
+
+	// Fills sensor i with a DS18B20 ROM code made from serial
+	static void makeRom(SimSensor & s, uint8_t family, uint32_t serial);
+
+	uint8_t reset();
+	void skip();
+	void select(const uint8_t rom[8]);
+	void write(uint8_t v, uint8_t power = 0);
+	void write_bytes(const uint8_t * buf, uint16_t count, bool power = 0);
+	uint8_t read();
+	void read_bytes(uint8_t * buf, uint16_t count);
+	uint8_t read_bit();
+	void write_bit(uint8_t v);
+	void depower();
+	void reset_search();
+	uint8_t search(uint8_t * rom);
+
+private:
+	enum {
+		ALL = 0xff, NONE = 0xfe
+	};
+
+	SimSensor * _sensors;
+	uint8_t _count;
+	boolean _parasite;
+	uint8_t _selected;      // sensor, ALL or NONE
+	uint8_t _command;
+	uint8_t _scratchpad[9];
+	uint8_t _position;
+	uint8_t _searched;
+
+	void fillScratchpad();
+};
+
+#endif /* ONEWIRESIM_H_ */
@@ -0,0 +1,245 @@
+/*
+ * OneWireSweep.h
+ *
+ *  Reads every DS18x20 on one or more 1-Wire buses with a single
+ *  conversion per sweep instead of one per sensor:
+ *
+ *   scan()    searches each bus once and keeps the ROM codes of the
+ *             temperature sensors, and whether a bus has parasite
+ *             powered parts
+ *   start()   resets each bus and sends Convert T to all of its sensors
+ *             with Skip ROM, so that every conversion runs at once
+ *   poll()    call from loop().  Watches the buses until their sensors
+ *             are done, by read slots on powered buses and by the clock on
+ *             parasite powered ones, then reads one scratchpad per call,
+ *             checking its CRC and reading it again once on a mismatch.
+ *             Returns true when the last one is in.
+ *
+ *  A sweep of 40 sensors then takes one conversion, 750 ms at most, and
+ *  about 12 ms of bus time per sensor, 1.3 seconds where converting them
+ *  one by one took over 30.
+ *
+ *  Bus is OneWire, or any class with the same reset, skip, select, write,
+ *  read_bit, read_bytes, depower, reset_search and search, such as the
+ *  simulated bus in OneWireSim.h.  The sensors are kept in an array given
+ *  by the caller.
+ */
+
+#ifndef ONEWIRESWEEP_H_
+#define ONEWIRESWEEP_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+#include <CRC.h>
+
+#define SWEEP_MAX_BUSES 8
+// longest DS18x20 conversion at 12 bits, and what a late one is allowed
+#define SWEEP_CONVERSION_MS 750
+#define SWEEP_TIMEOUT_MS 1000
+
+#define SWEEP_CONVERT_T 0x44
+#define SWEEP_READ_SCRATCHPAD 0xBE
+#define SWEEP_READ_POWER_SUPPLY 0xB4
+
+struct SweepSensor {
+	enum {
+		OK, CRC_ERROR, MISSING
+	};
+
+	uint8_t rom[8];
+	uint8_t bus;
+	uint8_t status;
+	int16_t raw;   // 1/16 degree
+
+	float celsius() const {
+		return raw * 0.0625;
+	}
+};
+
+template <typename Bus>
+class OneWireSweep {
+public:
+	OneWireSweep(Bus * const * buses, uint8_t busCount,
+			SweepSensor * sensors, uint8_t maxSensors) :
+			_buses(buses), _busCount(busCount < SWEEP_MAX_BUSES ? busCount : SWEEP_MAX_BUSES),
+			_sensors(sensors), _max(maxSensors), _count(0),
+			_parasite(0), _state(IDLE), _timestamp(0), _errors(0) {
+	}
+
+	// Searches every bus, returns the number of sensors found
+	uint8_t scan() {
+		uint8_t rom[8];
+
+		_count = 0;
+		_parasite = 0;
+		for (uint8_t b = 0; b < _busCount; b++) {
+			Bus & bus = *_buses[b];
+			bus.reset_search();
+			while (_count < _max && bus.search(rom)) {
+				if (crc8Maxim(0, rom, 7) != rom[7] || !isSensor(rom[0]))
+					continue;
+				SweepSensor & s = _sensors[_count++];
+				memcpy(s.rom, rom, 8);
+				s.bus = b;
+				s.status = SweepSensor::MISSING;
+				s.raw = 0;
+			}
+			// parasite powered parts pull the read slot low
+			if (bus.reset()) {
+				bus.skip();
+				bus.write(SWEEP_READ_POWER_SUPPLY);
+				if (!bus.read_bit())
+					_parasite |= 1 << b;
+			}
+		}
+		_state = IDLE;
+		return _count;
+	}
+
+	// Starts the conversion on every bus, false while a sweep is running
+	boolean start(unsigned long now) {
+		if (_state != IDLE)
+			return false;
+		_pending = 0;
+		for (uint8_t b = 0; b < _busCount; b++) {
+			Bus & bus = *_buses[b];
+			if (!bus.reset())
+				continue;
+			bus.skip();
+			// parasite parts draw their conversion current from the pull-up
+			bus.write(SWEEP_CONVERT_T, isParasite(b));
+			_pending |= 1 << b;
+		}
+		_timestamp = now;
+		_next = 0;
+		_errors = 0;
+		_state = CONVERTING;
+		return true;
+	}
+
+	boolean start() {
+		return start(millis());
+	}
+
+	// Advances the sweep, true once when its readings are all in
+	boolean poll(unsigned long now) {
+		switch (_state) {
+		case CONVERTING:
+			for (uint8_t b = 0; b < _busCount; b++) {
+				if (!(_pending & (1 << b)))
+					continue;
+				Bus & bus = *_buses[b];
+				unsigned long elapsed = now - _timestamp;
+				if (isParasite(b) ? elapsed >= SWEEP_CONVERSION_MS
+						: bus.read_bit() || elapsed >= SWEEP_TIMEOUT_MS) {
+					bus.depower();
+					_pending &= ~(1 << b);
+				}
+			}
+			if (_pending)
+				return false;
+			_state = READING;
+			// FALLTHROUGH
+		case READING:
+			if (_next < _count) {
+				read(_sensors[_next++]);
+				if (_next < _count)
+					return false;
+			}
+			_state = IDLE;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	boolean poll() {
+		return poll(millis());
+	}
+
+	boolean busy() const {
+		return _state != IDLE;
+	}
+
+	// millis() when the conversion of the last sweep started
+	unsigned long timestamp() const {
+		return _timestamp;
+	}
+
+	uint8_t count() const {
+		return _count;
+	}
+
+	// sensors that did not answer with a good scratchpad in the last sweep
+	uint8_t errors() const {
+		return _errors;
+	}
+
+	SweepSensor & operator[](uint8_t i) {
+		return _sensors[i];
+	}
+
+	boolean isParasite(uint8_t bus) const {
+		return _parasite & (1 << bus);
+	}
+
+	static boolean isSensor(uint8_t family) {
+		return family == 0x10 || family == 0x22 || family == 0x28;
+	}
+
+private:
+	enum {
+		IDLE, CONVERTING, READING
+	};
+
+	Bus * const * _buses;
+	uint8_t _busCount;
+	SweepSensor * _sensors;
+	uint8_t _max;
+	uint8_t _count;
+	uint8_t _parasite;   // bit per bus
+	uint8_t _pending;    // buses still converting
+	uint8_t _state;
+	uint8_t _next;       // sensor to read
+	unsigned long _timestamp;
+	uint8_t _errors;
+
+	boolean readScratchpad(SweepSensor & s, uint8_t data[9]) {
+		Bus & bus = *_buses[s.bus];
+		if (!bus.reset())
+			return false;
+		bus.select(s.rom);
+		bus.write(SWEEP_READ_SCRATCHPAD);
+		bus.read_bytes(data, 9);
+		return crc8Maxim(0, data, 8) == data[8];
+	}
+
+	void read(SweepSensor & s) {
+		uint8_t data[9];
+
+		memset(data, 0xff, sizeof(data));
+		if (!readScratchpad(s, data) && !readScratchpad(s, data)) {
+			// a sensor that has gone reads as all ones
+			s.status = data[8] == 0xff && data[0] == 0xff ? SweepSensor::MISSING
+					: SweepSensor::CRC_ERROR;
+			_errors++;
+			return;
+		}
+		int16_t raw = (data[1] << 8) | data[0];
+		if (s.rom[0] == 0x10) {
+			// DS18S20: half degrees, refined by the count remaining
+			raw = ((raw & 0xfffe) << 3) + 12 - data[6];
+		} else {
+			// the unused low bits at 9 to 11 bits resolution
+			uint8_t resolution = (data[4] >> 5) & 3;
+			raw &= ~((1 << (3 - resolution)) - 1);
+		}
+		s.raw = raw;
+		s.status = SweepSensor::OK;
+	}
+};
+
+#endif /* ONEWIRESWEEP_H_ */
@@ -0,0 +1,52 @@
+/*
+ * Temperatures of every DS18x20 on two 1-Wire buses, pins 2 and 3, once
+ * a second.  Each sweep converts all sensors at once and prints them as
+ * one batch with the time the conversion started.
+ */
+#include <OneWire.h>
+#include <CRC.h>
+#include <OneWireSweep.h>
+
+OneWire bus2(2), bus3(3);
+OneWire * buses[] = { &bus2, &bus3 };
+SweepSensor sensors[16];
+OneWireSweep<OneWire> sweep(buses, 2, sensors, 16);
+
+unsigned long lastStart;
+
+void setup() {
+	Serial.begin(9600);
+	Serial.print(sweep.scan());
+	Serial.println(" sensors");
+	for (uint8_t i = 0; i < sweep.count(); i++) {
+		Serial.print(i);
+		Serial.print(" bus ");
+		Serial.print(sweep[i].bus);
+		Serial.print(" ROM");
+		for (uint8_t j = 0; j < 8; j++) {
+			Serial.print(' ');
+			Serial.print(sweep[i].rom[j], HEX);
+		}
+		Serial.println();
+	}
+}
+
+void loop() {
+	if (!sweep.busy() && millis() - lastStart >= 1000) {
+		lastStart = millis();
+		sweep.start();
+	}
+	if (sweep.poll()) {
+		Serial.print(sweep.timestamp());
+		Serial.print(" ms:");
+		for (uint8_t i = 0; i < sweep.count(); i++) {
+			Serial.print(' ');
+			if (sweep[i].status == SweepSensor::OK)
+				Serial.print(sweep[i].celsius());
+			else
+				Serial.print('-');
+		}
+		Serial.println();
+	}
+	// other work goes here, the sweep does not block
+}
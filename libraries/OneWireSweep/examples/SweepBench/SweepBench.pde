@@ -0,0 +1,105 @@
+/*
+ * Sweep time by number of sensors and buses, on simulated buses.
+ *
+ * Reads 1, 10 and 40 simulated DS18B20s spread over 1, 2 and 4 buses,
+ * first one sensor at a time as the DS18x20 example does, then with
+ * OneWireSweep, and prints the time each takes in milliseconds of
+ * simulated bus and conversion time.  One sensor in seven garbles its
+ * first scratchpad read to exercise the CRC retry; the readings are
+ * checked against the temperatures given to the sensors.
+ */
+#include <CRC.h>
+#include <OneWireSweep.h>
+#include <OneWireSim.h>
+
+const uint8_t probeCounts[] = { 1, 10, 40 };
+const uint8_t busCounts[] = { 1, 2, 4 };
+const uint8_t maxProbes = 40;
+// loop() time between polls that is not spent on the bus
+const unsigned long otherWork = 200;
+
+SimSensor probes[maxProbes];
+SweepSensor sensors[maxProbes];
+
+unsigned long now() {
+	return OneWireSim::clock / 1000;
+}
+
+void setup() {
+	Serial.begin(115200);
+	Serial.println("sensors\tbuses\tone by one ms\tsweep ms\terrors\twrong");
+
+	for (uint8_t p = 0; p < sizeof(probeCounts); p++) {
+		for (uint8_t b = 0; b < sizeof(busCounts); b++) {
+			uint8_t probeCount = probeCounts[p];
+			uint8_t busCount = busCounts[b];
+			SimSensor * group[4];
+			uint8_t groupSize[4] = { 0 };
+
+			// consecutive probes on each bus
+			for (uint8_t i = 0; i < probeCount; i++) {
+				OneWireSim::makeRom(probes[i], 0x28, 0x1000UL + i * 37);
+				probes[i].raw = 200 + i * 9 - (i % 3) * 50;
+				probes[i].corrupt = i % 7 == 3;
+			}
+			OneWireSim sim[4] = { OneWireSim(probes, 0), OneWireSim(probes, 0),
+					OneWireSim(probes, 0), OneWireSim(probes, 0) };
+			OneWireSim * buses[4];
+			uint8_t first = 0;
+			for (uint8_t k = 0; k < busCount; k++) {
+				groupSize[k] = probeCount / busCount + (k < probeCount % busCount);
+				group[k] = probes + first;
+				first += groupSize[k];
+				sim[k] = OneWireSim(group[k], groupSize[k]);
+				buses[k] = &sim[k];
+			}
+
+			Serial.print(probeCount);
+			Serial.print('\t');
+			Serial.print(busCount);
+			Serial.print('\t');
+			// one by one reads each probe from the bus it is on
+			unsigned long t = OneWireSim::clock;
+			uint8_t data[9];
+			for (uint8_t k = 0; k < busCount; k++)
+				for (uint8_t i = 0; i < groupSize[k]; i++) {
+					OneWireSim & bus = *buses[k];
+					bus.reset();
+					bus.select(group[k][i].rom);
+					bus.write(SWEEP_CONVERT_T, 1);
+					OneWireSim::clock += SWEEP_CONVERSION_MS * 1000UL;
+					bus.reset();
+					bus.select(group[k][i].rom);
+					bus.write(SWEEP_READ_SCRATCHPAD);
+					bus.read_bytes(data, 9);
+				}
+			Serial.print((OneWireSim::clock - t) / 1000);
+			Serial.print('\t');
+
+			OneWireSweep<OneWireSim> sweep(buses, busCount, sensors, maxProbes);
+			sweep.scan();
+			for (uint8_t i = 0; i < probeCount; i++)
+				probes[i].corrupt = i % 7 == 3;
+			t = OneWireSim::clock;
+			sweep.start(now());
+			while (!sweep.poll(now()))
+				OneWireSim::clock += otherWork;
+			Serial.print((OneWireSim::clock - t) / 1000);
+			Serial.print('\t');
+			Serial.print(sweep.errors());
+
+			uint8_t wrong = probeCount - sweep.count();
+			for (uint8_t i = 0; i < sweep.count(); i++) {
+				SweepSensor & s = sweep[i];
+				for (uint8_t j = 0; j < probeCount; j++)
+					if (memcmp(s.rom, probes[j].rom, 8) == 0 && s.raw != probes[j].raw)
+						wrong++;
+			}
+			Serial.print('\t');
+			Serial.println(wrong);
+		}
+	}
+}
+
+void loop() {
+}
@@ -19,6 +19,7 @@
 #include <SoftwareSerial.h>
 
 #include "RCS620S.h"
+#include <CRC.h>
 
 #define DEBUG
 
@@ -397,13 +398,7 @@ void RCS620S::cancel(void) {
 }
 
 uint8_t RCS620S::calcDCS(const uint8_t* data, uint16_t len) {
-	uint8_t sum = 0;
-
-	for (uint16_t i = 0; i < len; i++) {
-		sum += data[i];
-	}
-
-	return (uint8_t) -(sum & 0xff);
+	return (uint8_t) -sum8(0, data, len);
 }
 
 void RCS620S::writeSerial(const uint8_t* data, uint16_t len) {
@@ -1,4 +1,5 @@
 #include <RCS620S.h>
+#include <CRC.h>
 #include <inttypes.h>
 #include <string.h>
 
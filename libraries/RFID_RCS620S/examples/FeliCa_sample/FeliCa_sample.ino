@@ -1,4 +1,5 @@
 #include <RCS620S.h>
+#include <CRC.h>
  
 #define COMMAND_TIMEOUT 400
 #define POLLING_INTERVAL 500
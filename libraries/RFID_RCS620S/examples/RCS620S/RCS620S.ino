@@ -1,5 +1,6 @@
 //#include <LiquidCrystal.h>
 #include <RCS620S.h>
+#include <CRC.h>
 
 #define COMMAND_TIMEOUT 400
 #define POLLING_INTERVAL 500
@@ -0,0 +1,303 @@
+/*
+
+ KeyFile - sorted fixed size records with a block index, see KeyFile.h
+
+ */
+
+#include "KeyFile.h"
+
+static boolean writeZeros(File & file, uint16_t count) {
+  static const uint8_t zeros[32] = { 0 };
+  while (count > 0) {
+    uint16_t n = count < sizeof(zeros) ? count : sizeof(zeros);
+    if (file.write(zeros, n) != n)
+      return false;
+    count -= n;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// KeyFile
+
+boolean KeyFile::begin(File & file) {
+  _file = &file;
+  if (!file.seek(0)
+      || file.read(&_header, sizeof(_header)) != sizeof(_header)
+      || memcmp(_header.magic, "KDB1", 4) != 0
+      || _header.recordSize == 0 || _header.recordSize > KEYFILE_MAX_RECORD
+      || _header.keyLength == 0 || _header.keyLength > KEYFILE_MAX_KEY
+      || _header.keyOffset + _header.keyLength > _header.recordSize
+      || _header.levels > KEYFILE_MAX_LEVELS) {
+    _file = 0;
+    return false;
+  }
+  return true;
+}
+
+boolean KeyFile::writeHeader() {
+  if (!_file->seek(0)
+      || _file->write((const uint8_t *) &_header, sizeof(_header)) != sizeof(_header))
+    return false;
+  _file->flush();
+  return true;
+}
+
+// The key stored at pos against the one given, as memcmp.  Successive
+// calls within a block are served by the library's block cache.
+int KeyFile::compareAt(uint32_t pos, const void * key) {
+  uint8_t buf[KEYFILE_MAX_KEY];
+  _file->seek(pos);
+  _file->read(buf, _header.keyLength);
+  return memcmp(buf, key, _header.keyLength);
+}
+
+// Byte position of the record with the key, 0 when there is none
+uint32_t KeyFile::locate(const void * key) {
+  uint32_t block = 0;   // within the level
+  uint32_t first, base;
+  uint16_t lo, hi, mid;
+  int diff;
+
+  if (_header.records > 0) {
+    for (uint8_t level = _header.levels; level > 0; level--) {
+      // the last entry whose key is not above ours leads to the block below
+      first = block * fanout();
+      lo = 0;
+      hi = min((uint32_t) fanout(), _header.levelBlocks[level - 1] - first);
+      base = (_header.levelStart[level] + block) * KEYFILE_BLOCK_SIZE;
+      while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (compareAt(base + (uint32_t) mid * _header.keyLength, key) <= 0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (lo == 0)
+        goto pending;   // below the first key
+      block = first + lo - 1;
+    }
+
+    first = block * perBlock();
+    lo = 0;
+    hi = min((uint32_t) perBlock(), _header.records - first);
+    base = (_header.levelStart[0] + block) * KEYFILE_BLOCK_SIZE;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      diff = compareAt(base + (uint32_t) mid * _header.recordSize + _header.keyOffset, key);
+      if (diff == 0)
+        return base + (uint32_t) mid * _header.recordSize;
+      if (diff < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  }
+
+pending:
+  for (uint16_t i = 0; i < _header.pending; i++) {
+    base = _header.pendingStart + (uint32_t) i * _header.recordSize;
+    if (compareAt(base + _header.keyOffset, key) == 0)
+      return base;
+  }
+  return 0;
+}
+
+boolean KeyFile::find(const void * key, void * record) {
+  if (!_file)
+    return false;
+  uint32_t pos = locate(key);
+  if (pos == 0)
+    return false;
+  _file->seek(pos);
+  return _file->read(record, _header.recordSize) == _header.recordSize;
+}
+
+boolean KeyFile::insert(const void * records, uint16_t count) {
+  const uint8_t * record = (const uint8_t *) records;
+  uint16_t pending = _header.pending;
+  boolean result = true;
+
+  if (!_file)
+    return false;
+  for (; count > 0; count--, record += _header.recordSize) {
+    uint32_t pos = locate(record + _header.keyOffset);
+    if (pos == 0) {
+      if (_header.pending >= KEYFILE_MAX_PENDING) {
+        result = false;
+        break;
+      }
+      pos = _header.pendingStart + (uint32_t) _header.pending * _header.recordSize;
+      _header.pending++;
+    }
+    if (!_file->seek(pos)
+        || _file->write(record, _header.recordSize) != _header.recordSize) {
+      result = false;
+      break;
+    }
+  }
+  // the batch becomes visible with the header
+  if (_header.pending != pending)
+    return writeHeader() && result;
+  _file->flush();
+  return result;
+}
+
+// The pending record with the smallest key above after, or the smallest
+// of all when after is 0
+boolean KeyFile::nextPending(uint8_t * record, const uint8_t * after) {
+  uint8_t key[KEYFILE_MAX_KEY];
+  boolean found = false;
+
+  for (uint16_t i = 0; i < _header.pending; i++) {
+    uint32_t pos = _header.pendingStart + (uint32_t) i * _header.recordSize;
+    _file->seek(pos + _header.keyOffset);
+    _file->read(key, _header.keyLength);
+    if (after && memcmp(key, after, _header.keyLength) <= 0)
+      continue;
+    if (found && memcmp(key, record + _header.keyOffset, _header.keyLength) >= 0)
+      continue;
+    _file->seek(pos);
+    _file->read(record, _header.recordSize);
+    found = true;
+  }
+  return found;
+}
+
+boolean KeyFile::merge(File & dst) {
+  KeyFileBuilder out(dst, _header.recordSize, _header.keyOffset, _header.keyLength);
+  uint8_t record[KEYFILE_MAX_RECORD];
+  uint8_t pend[KEYFILE_MAX_RECORD];
+  uint8_t lastPending[KEYFILE_MAX_KEY];
+  uint32_t next = 0;
+  boolean haveRecord = false;
+  boolean havePending;
+
+  if (!_file)
+    return false;
+  havePending = nextPending(pend, 0);
+  while (next < _header.records || havePending) {
+    if (!haveRecord && next < _header.records) {
+      _file->seek((_header.levelStart[0] + next / perBlock()) * KEYFILE_BLOCK_SIZE
+                  + (next % perBlock()) * _header.recordSize);
+      _file->read(record, _header.recordSize);
+      haveRecord = true;
+    }
+    // pending keys never match a sorted one, those are rewritten in place
+    if (haveRecord && (!havePending
+        || memcmp(record + _header.keyOffset, pend + _header.keyOffset, _header.keyLength) < 0)) {
+      if (!out.add(record))
+        return false;
+      haveRecord = false;
+      next++;
+    } else {
+      if (!out.add(pend))
+        return false;
+      memcpy(lastPending, pend + _header.keyOffset, _header.keyLength);
+      havePending = nextPending(pend, lastPending);
+    }
+  }
+  return out.finish(_header.generation + 1, _header.source);
+}
+
+//------------------------------------------------------------------------------
+// KeyFileBuilder
+
+KeyFileBuilder::KeyFileBuilder(File & file, uint8_t recordSize, uint8_t keyOffset, uint8_t keyLength)
+  : _file(file), _fill(0) {
+  memset(&_header, 0, sizeof(_header));
+  memcpy(_header.magic, "KDB1", 4);
+  if (recordSize <= KEYFILE_MAX_RECORD && keyLength > 0 && keyLength <= KEYFILE_MAX_KEY
+      && keyOffset + keyLength <= recordSize) {
+    _header.recordSize = recordSize;
+    _header.keyOffset = keyOffset;
+    _header.keyLength = keyLength;
+  }
+  _header.levelStart[0] = 1;
+}
+
+// Fills the rest of the block that the file ends in
+boolean KeyFileBuilder::pad() {
+  uint16_t used = _file.position() % KEYFILE_BLOCK_SIZE;
+  return used == 0 || writeZeros(_file, KEYFILE_BLOCK_SIZE - used);
+}
+
+boolean KeyFileBuilder::add(const void * record) {
+  const uint8_t * key = (const uint8_t *) record + _header.keyOffset;
+
+  if (_header.recordSize == 0)
+    return false;
+  if (_header.records == 0) {
+    // room for the header, written by finish()
+    if (!_file.seek(0) || !writeZeros(_file, KEYFILE_BLOCK_SIZE))
+      return false;
+  } else if (memcmp(key, _lastKey, _header.keyLength) <= 0) {
+    return false;
+  }
+  if (_file.write((const uint8_t *) record, _header.recordSize) != _header.recordSize)
+    return false;
+  memcpy(_lastKey, key, _header.keyLength);
+  _header.records++;
+  if (++_fill == KEYFILE_BLOCK_SIZE / _header.recordSize) {
+    _fill = 0;
+    return pad();
+  }
+  return true;
+}
+
+boolean KeyFileBuilder::finish(uint16_t generation, uint32_t source) {
+  uint8_t key[KEYFILE_MAX_KEY];
+  uint16_t perBlock, fanout;
+  uint8_t level;
+  uint32_t next, child;
+
+  if (_header.recordSize == 0)
+    return false;
+  if (_header.records == 0) {
+    if (!_file.seek(0) || !writeZeros(_file, KEYFILE_BLOCK_SIZE))
+      return false;
+  }
+  if (!pad())
+    return false;
+  _fill = 0;
+
+  perBlock = KEYFILE_BLOCK_SIZE / _header.recordSize;
+  fanout = KEYFILE_BLOCK_SIZE / _header.keyLength;
+  _header.levelBlocks[0] = (_header.records + perBlock - 1) / perBlock;
+  next = _header.levelStart[0] + _header.levelBlocks[0];
+
+  // each level holds the first key of every block of the level below,
+  // until one block holds them all
+  for (level = 0; _header.levelBlocks[level] > 1; level++) {
+    if (level == KEYFILE_MAX_LEVELS)
+      return false;
+    _header.levelStart[level + 1] = next;
+    for (child = 0; child < _header.levelBlocks[level]; child++) {
+      uint32_t write = next * KEYFILE_BLOCK_SIZE + child / fanout * KEYFILE_BLOCK_SIZE
+                       + child % fanout * _header.keyLength;
+      _file.seek((_header.levelStart[level] + child) * KEYFILE_BLOCK_SIZE
+                 + (level == 0 ? _header.keyOffset : 0));
+      if (_file.read(key, _header.keyLength) != _header.keyLength
+          || !_file.seek(write)
+          || _file.write(key, _header.keyLength) != _header.keyLength)
+        return false;
+      if (child % fanout == fanout - 1u && !pad())
+        return false;
+    }
+    if (!pad())
+      return false;
+    _header.levelBlocks[level + 1] = (_header.levelBlocks[level] + fanout - 1) / fanout;
+    next += _header.levelBlocks[level + 1];
+  }
+
+  _header.levels = level;
+  _header.pendingStart = next * KEYFILE_BLOCK_SIZE;
+  _header.pending = 0;
+  _header.generation = generation;
+  _header.source = source;
+  if (!_file.seek(0)
+      || _file.write((const uint8_t *) &_header, sizeof(_header)) != sizeof(_header))
+    return false;
+  _file.flush();
+  return true;
+}
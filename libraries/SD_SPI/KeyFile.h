@@ -0,0 +1,114 @@
+/*
+
+ KeyFile - sorted fixed size records with a block index, for key lookups
+
+ Records of up to KEYFILE_MAX_RECORD bytes are kept in key order, a
+ whole number of them in each 512 byte block, with the key at a fixed
+ offset in the record.  The index above them is a tree of blocks that
+ each hold the first key of the blocks below, so a lookup reads one
+ block per level:
+
+   block 0                  header
+   blocks 1 ...             records in key order, level 0
+   then for each level      first key of each block of the level below
+   last index block         root
+   after the root           pending records, not sorted
+
+ With 24 byte records and an 11 byte key, 1k and 10k records take two
+ levels (a lookup reads three blocks) and 100k take three.
+
+ New keys are added to the pending area, which lookups scan after the
+ tree; records whose key is already there are rewritten in place.  When
+ the pending area fills, merge() writes the whole file again, in order,
+ to a second file.  The header carries a generation number so that a
+ sketch switching between two files can tell the newer one, and the
+ size of the file the records were built from, so that a sketch can tell
+ when its index is out of date.
+
+ Files are built with KeyFileBuilder from records given in key order.
+
+ */
+
+#ifndef __KEYFILE_H__
+#define __KEYFILE_H__
+
+#include "SD_SPI.h"
+
+#define KEYFILE_BLOCK_SIZE 512
+#define KEYFILE_MAX_RECORD 64
+#define KEYFILE_MAX_KEY 16
+#define KEYFILE_MAX_LEVELS 6
+#define KEYFILE_MAX_PENDING 256
+
+struct KeyFileHeader {
+  char magic[4];              // "KDB1"
+  uint8_t recordSize;
+  uint8_t keyOffset;
+  uint8_t keyLength;
+  uint8_t levels;             // index levels above the records
+  uint32_t records;           // sorted records
+  uint16_t pending;           // records in the pending area
+  uint16_t generation;
+  uint32_t pendingStart;      // byte offset of the pending area
+  uint32_t levelStart[KEYFILE_MAX_LEVELS + 1];  // first block of each level, 0 is the records
+  uint32_t levelBlocks[KEYFILE_MAX_LEVELS + 1];
+  uint32_t source;            // size of the source file, 0 if none
+};
+
+class KeyFile {
+  File * _file;
+  KeyFileHeader _header;
+
+  uint16_t perBlock() const { return KEYFILE_BLOCK_SIZE / _header.recordSize; }
+  uint16_t fanout() const { return KEYFILE_BLOCK_SIZE / _header.keyLength; }
+  int compareAt(uint32_t pos, const void * key);
+  uint32_t locate(const void * key);
+  boolean nextPending(uint8_t * record, const uint8_t * after);
+  boolean writeHeader();
+
+public:
+  KeyFile() : _file(0) {}
+
+  // Reads the header of an open file, false if it is not a key file
+  boolean begin(File & file);
+
+  uint32_t records() const { return _header.records + _header.pending; }
+  uint16_t pending() const { return _header.pending; }
+  uint16_t generation() const { return _header.generation; }
+  uint32_t source() const { return _header.source; }
+  uint8_t recordSize() const { return _header.recordSize; }
+  // blocks read by a lookup that finds its key in the tree
+  uint8_t depth() const { return _header.levels + 1; }
+
+  // Copies the record with the key, false if there is none
+  boolean find(const void * key, void * record);
+
+  // Adds or replaces count records, the file must be open for writing.
+  // Stops and returns false when the pending area is full; the records
+  // before that one are in.
+  boolean insert(const void * records, uint16_t count = 1);
+
+  // Writes all records in order to an empty file, as the next generation
+  boolean merge(File & dst);
+};
+
+class KeyFileBuilder {
+  File & _file;
+  KeyFileHeader _header;
+  uint8_t _lastKey[KEYFILE_MAX_KEY];
+  uint8_t _fill;              // records in the current block
+
+  boolean pad();
+
+public:
+  // The file must be open for writing and empty
+  KeyFileBuilder(File & file, uint8_t recordSize, uint8_t keyOffset, uint8_t keyLength);
+
+  // Appends a record, false if its key is not above the previous one
+  boolean add(const void * record);
+
+  // Writes the index and the header, source is kept for the sketch
+  boolean finish(uint16_t generation = 0, uint32_t source = 0);
+};
+
+#endif
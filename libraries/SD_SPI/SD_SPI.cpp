@@ -316,6 +316,16 @@ boolean callback_remove(SdFile& parentDir, char *filePathComponent,
   return true;
 }
 
+boolean callback_rename(SdFile& parentDir, char *filePathComponent, 
+			boolean isLastComponent, void *object) {
+  if (isLastComponent) {
+    SdFile f;
+    if (!f.open(parentDir, filePathComponent, O_WRITE)) return false;
+    return f.rename(&parentDir, (const char *) object) && f.close();
+  }
+  return true;
+}
+
 boolean callback_rmdir(SdFile& parentDir, char *filePathComponent, 
 			boolean isLastComponent, void *object) {
   if (isLastComponent) {
@@ -563,6 +573,10 @@ boolean SDClass::remove(char *filepath) {
   return walkPath(filepath, root, callback_remove);
 }
 
+boolean SDClass::rename(char *filepath, char *newname) {
+  return walkPath(filepath, root, callback_rename, newname);
+}
+
 
 // allows you to recurse into a directory
 File File::openNextFile(uint8_t mode) {
@@ -85,6 +85,9 @@ public:
   
   // Delete the file.
   boolean remove(char *filepath);
+
+  // Give the file a new name in the same directory, newname has no path.
+  boolean rename(char *filepath, char *newname);
   
   boolean rmdir(char *filepath);
 
@@ -0,0 +1,179 @@
+/*
+  KeyFile lookup benchmark
+
+ Builds key files of 1k, 10k and 100k card records on the SD card and
+ times lookups of keys that are there, keys that are not, and keys that
+ wait in the pending area after a batch insert.  Then merges the file
+ and checks the merged copy.
+
+ Records are 24 bytes with an 11 byte key, as ICCardKey in the
+ DatabaseFileBinaryWrite sketch: type, division, PID and issue number.
+
+ The 100k file takes 2.4MB and a few minutes to build.
+
+ */
+
+#include <SPI.h>
+#include "SD_SPI.h"
+#include "KeyFile.h"
+
+// On the Ethernet Shield, CS is pin 4. 
+const int chipSelect = 4;
+SDClass SD(chipSelect);
+
+struct CardRecord {
+  byte type;
+  char DIVISION;
+  char PID[8];
+  char ISSUE;
+  byte NFCID[8];
+  uint32_t goodthru;
+  byte privileges;
+};
+
+const uint8_t KeyLength = 11;
+const long Sizes[] = { 1000, 10000, 100000 };
+const int Lookups = 200;
+const int BatchSize = 16;
+
+void makeRecord(CardRecord & r, long pid) {
+  memset(&r, 0, sizeof(r));
+  r.type = 0x10;
+  r.DIVISION = 'S';
+  for (int i = 7; i >= 0; i--) {
+    r.PID[i] = '0' + pid % 10;
+    pid /= 10;
+  }
+  r.ISSUE = '1';
+  r.goodthru = 0x20151231;
+}
+
+// Times count lookups of random keys, PIDs of 2 * i + odd for i below n
+void timeLookups(KeyFile & db, long n, byte odd, boolean expected) {
+  CardRecord key, record;
+  unsigned long total = 0, worst = 0, t;
+  int errors = 0;
+
+  for (int i = 0; i < Lookups; i++) {
+    makeRecord(key, random(n) * 2 + odd);
+    t = micros();
+    boolean found = db.find(&key, &record);
+    t = micros() - t;
+    total += t;
+    if (t > worst) worst = t;
+    if (found != expected || (found && memcmp(&key, &record, KeyLength) != 0))
+      errors++;
+  }
+  Serial.print(total / Lookups);
+  Serial.print(" us average, ");
+  Serial.print(worst);
+  Serial.print(" us worst");
+  if (errors) {
+    Serial.print(", ");
+    Serial.print(errors);
+    Serial.print(" WRONG");
+  }
+  Serial.println();
+}
+
+void bench(long n) {
+  char name[13];
+  char merged[13];
+  CardRecord record;
+  unsigned long t;
+
+  sprintf(name, "kb%ld.kdb", n / 1000);
+  sprintf(merged, "kb%ldm.kdb", n / 1000);
+  SD.remove(name);
+  SD.remove(merged);
+
+  Serial.print(n);
+  Serial.println(" records");
+
+  File file = SD.open(name, FILE_WRITE);
+  KeyFileBuilder builder(file, sizeof(CardRecord), 0, KeyLength);
+  t = millis();
+  for (long i = 0; i < n; i++) {
+    makeRecord(record, i * 2);
+    if (!builder.add(&record)) {
+      Serial.println("add failed");
+      return;
+    }
+  }
+  if (!builder.finish()) {
+    Serial.println("finish failed");
+    return;
+  }
+  Serial.print("  build ");
+  Serial.print(millis() - t);
+  Serial.print(" ms, ");
+  Serial.print(file.size());
+  Serial.println(" bytes");
+
+  KeyFile db;
+  db.begin(file);
+  Serial.print("  blocks per lookup ");
+  Serial.println(db.depth());
+  Serial.print("  found     ");
+  timeLookups(db, n, 0, true);
+  Serial.print("  not found ");
+  timeLookups(db, n, 1, false);
+
+  // a batch of new keys goes to the pending area
+  CardRecord batch[BatchSize];
+  for (int i = 0; i < BatchSize; i++)
+    makeRecord(batch[i], random(n) * 2 + 1);
+  t = millis();
+  db.insert(batch, BatchSize);
+  Serial.print("  insert ");
+  Serial.print(BatchSize);
+  Serial.print(" in ");
+  Serial.print(millis() - t);
+  Serial.println(" ms");
+  t = micros();
+  boolean found = db.find(&batch[0], &record);
+  Serial.print("  pending lookup ");
+  Serial.print(micros() - t);
+  Serial.println(found ? " us" : " us, WRONG");
+
+  File copy = SD.open(merged, FILE_WRITE);
+  t = millis();
+  found = db.merge(copy);
+  Serial.print("  merge ");
+  Serial.print(millis() - t);
+  Serial.println(found ? " ms" : " ms, failed");
+  file.close();
+
+  KeyFile db2;
+  db2.begin(copy);
+  Serial.print("  merged ");
+  Serial.print(db2.records());
+  Serial.print(" records, generation ");
+  Serial.println(db2.generation());
+  Serial.print("  found     ");
+  timeLookups(db2, n, 0, true);
+  copy.close();
+}
+
+void setup()
+{
+  // Open serial communications and wait for port to open:
+  Serial.begin(57600);
+  while (!Serial);
+
+  Serial.print("Initializing SD card... ");
+  SPI.begin();
+  if (!SD.begin()) {
+    Serial.println("Card initialization failed... may be not present");
+    return;
+  }
+  Serial.println("card initialized.");
+
+  for (int i = 0; i < sizeof(Sizes) / sizeof(Sizes[0]); i++)
+    bench(Sizes[i]);
+  Serial.println("finished.");
+}
+
+void loop()
+{
+}
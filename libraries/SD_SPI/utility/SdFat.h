@@ -242,6 +242,7 @@ class SdFile : public Print {
   int8_t readDir(dir_t* dir);
   static uint8_t remove(SdFile* dirFile, const char* fileName);
   uint8_t remove(void);
+  uint8_t rename(SdFile* dirFile, const char* newName);
   /** Set the file's current position to zero. */
   void rewind(void) {
     curPosition_ = curCluster_ = 0;
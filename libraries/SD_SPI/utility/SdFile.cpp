@@ -813,6 +813,50 @@ uint8_t SdFile::remove(SdFile* dirFile, const char* fileName) {
   return file.remove();
 }
 //------------------------------------------------------------------------------
+/**
+ * Rename a file.
+ *
+ * A directory entry with the new name is written before the old one is
+ * deleted, so a reset in between leaves the data under both names and
+ * never under neither.  The file stays open.
+ *
+ * \param[in] dirFile The directory that contains the file.
+ * \param[in] newName The new name of the file.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include the file is not open or is a directory,
+ * \a newName is invalid or already exists, or an I/O error occurred.
+ */
+uint8_t SdFile::rename(SdFile* dirFile, const char* newName) {
+  dir_t entry;
+  SdFile file;
+
+  // must be an open normal file
+  if (!isFile()) return false;
+
+  // sync and copy the current entry
+  if (!dirEntry(&entry)) return false;
+
+  // make the entry for the new name
+  if (!file.open(dirFile, newName, O_CREAT | O_EXCL | O_WRITE)) return false;
+  dir_t* d = file.cacheDirEntry(SdVolume::CACHE_FOR_WRITE);
+  if (!d) return false;
+
+  // take everything but the name from the old entry
+  memcpy(&d->attributes, &entry.attributes, sizeof(dir_t) - sizeof(d->name));
+  file.type_ = FAT_FILE_TYPE_CLOSED;
+  if (!SdVolume::cacheFlush()) return false;
+
+  // delete the old entry
+  d = cacheDirEntry(SdVolume::CACHE_FOR_WRITE);
+  if (!d) return false;
+  d->name[0] = DIR_NAME_DELETED;
+  dirBlock_ = file.dirBlock_;
+  dirIndex_ = file.dirIndex_;
+  return SdVolume::cacheFlush();
+}
+//------------------------------------------------------------------------------
 /** Remove a directory file.
  *
  * The directory file will be removed only if it is empty and is not the
@@ -19,6 +19,8 @@ SPISRAM::SPISRAM(const byte csPin, const byte addr_width) :
 
 void SPISRAM::init() {
 	pinMode(_csPin, OUTPUT);
+	_csPort = portOutputRegister(digitalPinToPort(_csPin));
+	_csMask = digitalPinToBitMask(_csPin);
 	csHigh();
 	//
 	//addr = 0;
@@ -66,26 +68,3 @@ void SPISRAM::write(const long & address, byte *buffer, const long & size) {
 		SPI.transfer(*buffer++);
 	deselect();
 }
-
-void SPISRAM::setSPIMode(void) {
-	SPI.setBitOrder(MSBFIRST);
-	SPI.setClockDivider(SPI_CLOCK_DIV4);
-	SPI.setDataMode(SPI_MODE0);
-}
-
-void SPISRAM::csLow() {
-	digitalWrite(_csPin, LOW);
-}
-
-void SPISRAM::csHigh() {
-	digitalWrite(_csPin, HIGH);
-}
-
-void SPISRAM::select(void) {
-	setSPIMode();
-	csLow();
-}
-
-void SPISRAM::deselect(void) {
-	csHigh();
-}
@@ -21,6 +21,8 @@ class SPISRAM {
 private:
 	const byte _csPin;
 	const byte _addrbus;
+	volatile uint8_t * _csPort;
+	uint8_t _csMask;
 //	volatile long addr;
 //	byte clock_divider;
 //	byte spi_mode;
@@ -72,17 +74,47 @@ public:
 	inline void begin() {
 		init();
 	}
-	inline void setSPIMode();
+	inline void setSPIMode() {
+		SPI.setBitOrder(MSBFIRST);
+		SPI.setClockDivider(SPI_CLOCK_DIV4);
+		SPI.setDataMode(SPI_MODE0);
+	}
 
 	byte read(const long & address);
 	void * read(const long & address, byte *buffer, const long & size);
 	void write(const long & address, byte data);
 	void write(const long & address, byte *buffer, const long & size);
 
-	inline void csLow();
-	inline void csHigh();
-	inline void select(void);
-	inline void deselect(void);
+	// sequential access left open for streaming, ended by deselect()
+	void beginRead(const long & address) {
+		select();
+		set_access(READ, address);
+	}
+	void beginWrite(const long & address) {
+		select();
+		set_access(WRITE, address);
+	}
+
+	// direct port access, also called from interrupts
+	inline void csLow() {
+		uint8_t sreg = SREG;
+		cli();
+		*_csPort &= ~_csMask;
+		SREG = sreg;
+	}
+	inline void csHigh() {
+		uint8_t sreg = SREG;
+		cli();
+		*_csPort |= _csMask;
+		SREG = sreg;
+	}
+	inline void select(void) {
+		setSPIMode();
+		csLow();
+	}
+	inline void deselect(void) {
+		csHigh();
+	}
 };
 
 #endif
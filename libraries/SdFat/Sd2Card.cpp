@@ -21,6 +21,12 @@
 // debug trace macro
 #define SD_TRACE(m, b)
 // #define SD_TRACE(m, b) Serial.print(m);Serial.println(b);
+#if USE_SD_BLOCK_DEVICE
+// pass the call to the block device if the card was initialized with one
+#define SD_DEVICE_CALL(call) if (dev_) return devResult(dev_->call)
+#else  // USE_SD_BLOCK_DEVICE
+#define SD_DEVICE_CALL(call)
+#endif  // USE_SD_BLOCK_DEVICE
 
 // SPI functions
 //==============================================================================
@@ -606,6 +612,7 @@ static void spiSend(const uint8_t* buf , size_t n) {
 #if USE_SD_CRC
 // CRC functions
 //------------------------------------------------------------------------------
+#if USE_SD_CRC == 1
 static uint8_t CRC7(const uint8_t* data, uint8_t n) {
   uint8_t crc = 0;
   for (uint8_t i = 0; i < n; i++) {
@@ -619,7 +626,6 @@ static uint8_t CRC7(const uint8_t* data, uint8_t n) {
   return (crc << 1) | 1;
 }
 //------------------------------------------------------------------------------
-#if USE_SD_CRC == 1
 // slower CRC-CCITT
 // uses the x^16,x^12,x^5,x^1 polynomial.
 static uint16_t CRC_CCITT(const uint8_t *data, size_t n) {
@@ -633,58 +639,16 @@ static uint16_t CRC_CCITT(const uint8_t *data, size_t n) {
   }
   return crc;
 }
-#elif USE_SD_CRC > 1  // CRC_CCITT
+#elif USE_SD_CRC > 1
 //------------------------------------------------------------------------------
-// faster CRC-CCITT
-// uses the x^16,x^12,x^5,x^1 polynomial.
-#ifdef __AVR__
-static const uint16_t crctab[] PROGMEM = {
-#else  // __AVR__
-static const uint16_t crctab[] = {
-#endif  // __AVR__
-  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
-  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
-  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
-  0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
-  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
-  0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
-  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
-  0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
-  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
-  0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
-  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
-  0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
-  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
-  0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
-  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
-  0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
-  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
-  0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
-  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
-  0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
-  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
-  0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
-  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
-  0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
-  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
-  0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
-  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
-  0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
-  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
-  0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
-  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
-  0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
-};
+// faster table driven CRC7 and CRC-CCITT from the CRC library, several
+// bytes per step on 32-bit processors.
+#include <CRC.h>
+static uint8_t CRC7(const uint8_t* data, uint8_t n) {
+  return crc7Sd(0, data, n) | 1;
+}
 static uint16_t CRC_CCITT(const uint8_t* data, size_t n) {
-  uint16_t crc = 0;
-  for (size_t i = 0; i < n; i++) {
-#ifdef __AVR__
-    crc = pgm_read_word(&crctab[(crc >> 8 ^ data[i]) & 0XFF]) ^ (crc << 8);
-#else  // __AVR__
-    crc = crctab[(crc >> 8 ^ data[i]) & 0XFF] ^ (crc << 8);
-#endif  // __AVR__
-  }
-  return crc;
+  return crc16Ccitt(0, data, n);
 }
 #endif  // CRC_CCITT
 #endif  // USE_SD_CRC
@@ -736,6 +700,13 @@ uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
  *         or zero if an error occurs.
  */
 uint32_t Sd2Card::cardSize() {
+#if USE_SD_BLOCK_DEVICE
+  if (dev_) {
+    uint32_t n = dev_->cardSize();
+    devResult(n != 0);
+    return n;
+  }
+#endif  // USE_SD_BLOCK_DEVICE
   csd_t csd;
   if (!readCSD(&csd)) return 0;
   if (csd.v1.csd_ver == 0) {
@@ -780,6 +751,9 @@ void Sd2Card::chipSelectLow() {
  * the value zero, false, is returned for failure.
  */
 bool Sd2Card::erase(uint32_t firstBlock, uint32_t lastBlock) {
+#if USE_SD_BLOCK_DEVICE
+  if (dev_) return devResult(false);
+#endif  // USE_SD_BLOCK_DEVICE
   csd_t csd;
   if (!readCSD(&csd)) goto fail;
   // check for single block erase
@@ -820,6 +794,9 @@ bool Sd2Card::erase(uint32_t firstBlock, uint32_t lastBlock) {
  * The value zero, false, is returned if single block erase is not supported.
  */
 bool Sd2Card::eraseSingleBlockEnable() {
+#if USE_SD_BLOCK_DEVICE
+  if (dev_) return false;
+#endif  // USE_SD_BLOCK_DEVICE
   csd_t csd;
   return readCSD(&csd) ? csd.v1.erase_blk_en : false;
 }
@@ -836,6 +813,9 @@ bool Sd2Card::eraseSingleBlockEnable() {
  */
 bool Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   errorCode_ = type_ = 0;
+#if USE_SD_BLOCK_DEVICE
+  dev_ = 0;
+#endif  // USE_SD_BLOCK_DEVICE
   chipSelectPin_ = chipSelectPin;
   // 16-bit init start time allows over a minute
   uint16_t t0 = (uint16_t)millis();
@@ -912,6 +892,36 @@ bool Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   chipSelectHigh();
   return false;
 }
+#if USE_SD_BLOCK_DEVICE
+//------------------------------------------------------------------------------
+/**
+ * Use a block device in place of an SD card.
+ *
+ * The other Sd2Card functions pass their calls to the device, which must
+ * be ready for use.  A device error sets errorCode() to
+ * SD_CARD_ERROR_DEVICE and errorData() to the device's errorData().
+ *
+ * \param[in] dev The block device.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned if the device has no blocks.
+ */
+bool Sd2Card::init(SdBlockDevice* dev) {
+  errorCode_ = status_ = 0;
+  // block addressing
+  type_ = SD_CARD_TYPE_SDHC;
+  dev_ = dev;
+  return cardSize() != 0;
+}
+//------------------------------------------------------------------------------
+bool Sd2Card::devResult(bool ok) {
+  if (!ok) {
+    error(SD_CARD_ERROR_DEVICE);
+    status_ = dev_->errorData();
+  }
+  return ok;
+}
+#endif  // USE_SD_BLOCK_DEVICE
 //------------------------------------------------------------------------------
 /**
  * Read a 512 byte block from an SD card.
@@ -924,6 +934,7 @@ bool Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
  */
 bool Sd2Card::readBlock(uint32_t blockNumber, uint8_t* dst) {
   SD_TRACE("RB", blockNumber);
+  SD_DEVICE_CALL(readBlock(blockNumber, dst));
   // use address if not SDHC card
   if (type()!= SD_CARD_TYPE_SDHC) blockNumber <<= 9;
   if (cardCommand(CMD17, blockNumber)) {
@@ -945,6 +956,7 @@ bool Sd2Card::readBlock(uint32_t blockNumber, uint8_t* dst) {
  * the value zero, false, is returned for failure.
  */
 bool Sd2Card::readData(uint8_t *dst) {
+  SD_DEVICE_CALL(readData(dst));
   chipSelectLow();
   return readData(dst, 512);
 }
@@ -988,6 +1000,13 @@ bool Sd2Card::readData(uint8_t* dst, size_t count) {
 /** read CID or CSR register */
 bool Sd2Card::readRegister(uint8_t cmd, void* buf) {
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+#if USE_SD_BLOCK_DEVICE
+  // a block device has no CID or CSD
+  if (dev_) {
+    error(SD_CARD_ERROR_READ_REG);
+    return false;
+  }
+#endif  // USE_SD_BLOCK_DEVICE
   if (cardCommand(cmd, 0)) {
     error(SD_CARD_ERROR_READ_REG);
     goto fail;
@@ -1011,6 +1030,7 @@ bool Sd2Card::readRegister(uint8_t cmd, void* buf) {
  */
 bool Sd2Card::readStart(uint32_t blockNumber) {
   SD_TRACE("RS", blockNumber);
+  SD_DEVICE_CALL(readStart(blockNumber));
   if (type()!= SD_CARD_TYPE_SDHC) blockNumber <<= 9;
   if (cardCommand(CMD18, blockNumber)) {
     error(SD_CARD_ERROR_CMD18);
@@ -1030,6 +1050,7 @@ bool Sd2Card::readStart(uint32_t blockNumber) {
  * the value zero, false, is returned for failure.
  */
 bool Sd2Card::readStop() {
+  SD_DEVICE_CALL(readStop());
   chipSelectLow();
   if (cardCommand(CMD12, 0)) {
     error(SD_CARD_ERROR_CMD12);
@@ -1089,6 +1110,7 @@ bool Sd2Card::waitNotBusy(uint16_t timeoutMillis) {
  */
 bool Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src) {
   SD_TRACE("WB", blockNumber);
+  SD_DEVICE_CALL(writeBlock(blockNumber, src));
   // use address if not SDHC card
   if (type() != SD_CARD_TYPE_SDHC) blockNumber <<= 9;
   if (cardCommand(CMD24, blockNumber)) {
@@ -1120,6 +1142,7 @@ bool Sd2Card::writeBlock(uint32_t blockNumber, const uint8_t* src) {
  * the value zero, false, is returned for failure.
  */
 bool Sd2Card::writeData(const uint8_t* src) {
+  SD_DEVICE_CALL(writeData(src));
   chipSelectLow();
   // wait for previous write to finish
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail;
@@ -1171,6 +1194,7 @@ bool Sd2Card::writeData(uint8_t token, const uint8_t* src) {
  */
 bool Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
   SD_TRACE("WS", blockNumber);
+  SD_DEVICE_CALL(writeStart(blockNumber, eraseCount));
   // send pre-erase count
   if (cardAcmd(ACMD23, eraseCount)) {
     error(SD_CARD_ERROR_ACMD23);
@@ -1196,6 +1220,7 @@ bool Sd2Card::writeStart(uint32_t blockNumber, uint32_t eraseCount) {
  * the value zero, false, is returned for failure.
  */
 bool Sd2Card::writeStop() {
+  SD_DEVICE_CALL(writeStop());
   chipSelectLow();
   if (!waitNotBusy(SD_WRITE_TIMEOUT)) goto fail;
   spiSend(STOP_TRAN_TOKEN);
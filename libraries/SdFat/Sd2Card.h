@@ -111,6 +111,8 @@ uint8_t const SD_CARD_ERROR_CMD59 = 0X1A;
 uint8_t const SD_CARD_ERROR_READ_CRC = 0X1B;
 /** SPI DMA error */
 uint8_t const SD_CARD_ERROR_SPI_DMA = 0X1C;
+/** block device error, see SdBlockDevice::errorData() */
+uint8_t const SD_CARD_ERROR_DEVICE = 0X1D;
 //------------------------------------------------------------------------------
 // card types
 /** Standard capacity V1 SD card */
@@ -142,6 +144,43 @@ uint8_t const  SD_CHIP_SELECT_PIN = SS;
 uint8_t const SD_CHIP_SELECT_PIN = SOFT_SPI_CS_PIN;
 #endif  // SOFTWARE_SPI
 //------------------------------------------------------------------------------
+/**
+ * \class SdBlockDevice
+ * \brief Interface for a block device used in place of an SD card.
+ *
+ * Blocks are 512 bytes.  The functions have the meaning of the Sd2Card
+ * functions of the same name and return true for success.
+ */
+class SdBlockDevice {
+ public:
+  /** \return The number of 512 byte blocks or zero for an error. */
+  virtual uint32_t cardSize() = 0;
+  /** \return A device specific code for the last error. */
+  virtual uint8_t errorData() = 0;
+  /** Read a block. \param[in] block address. \param[out] dst data. */
+  virtual bool readBlock(uint32_t block, uint8_t* dst) = 0;
+  /** Read the next block of a sequence. \param[out] dst data. */
+  virtual bool readData(uint8_t* dst) = 0;
+  /** Start a read sequence. \param[in] block first address. */
+  virtual bool readStart(uint32_t block) = 0;
+  /** End a read sequence. */
+  virtual bool readStop() = 0;
+  /** Write a block. \param[in] block address. \param[in] src data. */
+  virtual bool writeBlock(uint32_t block, const uint8_t* src) = 0;
+  /** Write the next block of a sequence. \param[in] src data. */
+  virtual bool writeData(const uint8_t* src) = 0;
+  /** Start a write sequence.
+   * \param[in] block first address.
+   * \param[in] count number of blocks to pre-erase, as for an SD card.
+   * It is only a hint: the sequence may stop before \a count blocks are
+   * written or go on past them.  Blocks in the range that are not
+   * written may be left with any content.
+   */
+  virtual bool writeStart(uint32_t block, uint32_t count) = 0;
+  /** End a write sequence. */
+  virtual bool writeStop() = 0;
+};
+//------------------------------------------------------------------------------
 /**
  * \class Sd2Card
  * \brief Raw access to SD and SDHC flash memory cards.
@@ -149,7 +188,11 @@ uint8_t const SD_CHIP_SELECT_PIN = SOFT_SPI_CS_PIN;
 class Sd2Card {
  public:
   /** Construct an instance of Sd2Card. */
-  Sd2Card() : errorCode_(SD_CARD_ERROR_INIT_NOT_CALLED), type_(0) {}
+  Sd2Card() : errorCode_(SD_CARD_ERROR_INIT_NOT_CALLED), type_(0) {
+#if USE_SD_BLOCK_DEVICE
+    dev_ = 0;
+#endif  // USE_SD_BLOCK_DEVICE
+  }
   uint32_t cardSize();
   bool erase(uint32_t firstBlock, uint32_t lastBlock);
   bool eraseSingleBlockEnable();
@@ -172,6 +215,9 @@ class Sd2Card {
    */
   bool init(uint8_t sckRateID = SPI_FULL_SPEED,
     uint8_t chipSelectPin = SD_CHIP_SELECT_PIN);
+#if USE_SD_BLOCK_DEVICE
+  bool init(SdBlockDevice* dev);
+#endif  // USE_SD_BLOCK_DEVICE
   bool readBlock(uint32_t block, uint8_t* dst);
   /**
    * Read a card's CID register. The CID contains card identification
@@ -216,6 +262,10 @@ class Sd2Card {
   uint8_t spiRate_;
   uint8_t status_;
   uint8_t type_;
+#if USE_SD_BLOCK_DEVICE
+  SdBlockDevice* dev_;
+  bool devResult(bool ok);
+#endif  // USE_SD_BLOCK_DEVICE
   // private functions
   uint8_t cardAcmd(uint8_t cmd, uint32_t arg) {
     cardCommand(CMD55, 0);
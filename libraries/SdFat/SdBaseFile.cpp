@@ -1920,6 +1920,32 @@ bool SdBaseFile::setDirSize() {
   return false;
 }
 //------------------------------------------------------------------------------
+/** Set the file size without allocating or freeing clusters.  Used
+ * with raw block writes to a file made by createContiguous(), to record
+ * the length written so far.  The directory entry is updated by the
+ * next call to sync().
+ *
+ * \param[in] size The new file size.  It must not be past the clusters
+ * allocated to the file.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include file is read only, file is a directory
+ * or the current position is past \a size.
+ */
+bool SdBaseFile::setFileSize(uint32_t size) {
+  if (!isFile() || !(flags_ & O_WRITE) || curPosition_ > size) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  fileSize_ = size;
+  flags_ |= F_FILE_DIR_DIRTY;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
 void SdBaseFile::setpos(FatPos_t* pos) {
   curPosition_ = pos->position;
   curCluster_ = pos->cluster;
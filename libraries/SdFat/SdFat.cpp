@@ -53,6 +53,23 @@ static void pstrPrintln(PGM_P str) {
 bool SdFat::begin(uint8_t chipSelectPin, uint8_t sckRateID) {
   return card_.init(sckRateID, chipSelectPin) && vol_.init(&card_) && chdir(1);
 }
+#if USE_SD_BLOCK_DEVICE
+//------------------------------------------------------------------------------
+/**
+ * Initialize an SdFat object on a block device.
+ *
+ * Initializes the volume and root directory on a device that is already
+ * started, a USB drive for example.  See Sd2Card::init(SdBlockDevice* dev).
+ *
+ * \param[in] dev The block device.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdFat::begin(SdBlockDevice* dev) {
+  return card_.init(dev) && vol_.init(&card_) && chdir(1);
+}
+#endif  // USE_SD_BLOCK_DEVICE
 //------------------------------------------------------------------------------
 /** Change a volume's working directory to root
  *
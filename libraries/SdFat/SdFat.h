@@ -79,6 +79,9 @@ class SdFat {
   bool exists(const char* name);
   bool begin(uint8_t chipSelectPin = SD_CHIP_SELECT_PIN,
     uint8_t sckRateID = SPI_FULL_SPEED);
+#if USE_SD_BLOCK_DEVICE
+  bool begin(SdBlockDevice* dev);
+#endif  // USE_SD_BLOCK_DEVICE
   void initErrorHalt();
   void initErrorHalt(char const *msg);
   void initErrorPrint();
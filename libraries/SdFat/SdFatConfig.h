@@ -74,7 +74,8 @@
  *
  * Set USE_SD_CRC to 1 to use a smaller slower CRC-CCITT function.
  *
- * Set USE_SD_CRC to 2 to used a larger faster table driven CRC-CCITT function.
+ * Set USE_SD_CRC to 2 to used the larger faster table driven functions of
+ * the CRC library.  Sketches must then include CRC.h.
  */
 #define USE_SD_CRC 0
 //------------------------------------------------------------------------------
@@ -87,6 +88,15 @@
  */
 #define USE_MULTIPLE_CARDS 0
 //------------------------------------------------------------------------------
+/**
+ * Set USE_SD_BLOCK_DEVICE nonzero to allow a volume on a block device
+ * other than an SD card, for example a USB drive.
+ * See Sd2Card::init(SdBlockDevice* dev).
+ *
+ * Costs two bytes of SRAM and a test in each block access.
+ */
+#define USE_SD_BLOCK_DEVICE 0
+//------------------------------------------------------------------------------
 /**
  * Set DESTRUCTOR_CLOSES_FILE nonzero to close a file in its destructor.
  *
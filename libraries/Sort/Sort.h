@@ -0,0 +1,369 @@
+/*
+ * Sort.h
+ *
+ * In-place sorting and binary search over plain arrays.
+ *
+ *  introSort(a, n)             quicksort with median of three, falling back
+ *                              to heapsort when it recurses too deep, and
+ *                              insertion sort under SORT_INSERTION_CUTOFF
+ *  heapSort(a, n)              O(n log n) always, no extra memory
+ *  insertionSort(a, n)         stable, best for short or nearly sorted input
+ *  mergeSort(a, n, scratch)    stable O(n log n), scratch holds n/2 elements
+ *  countingSort<R>(a, n)       integers 0 .. R-1, counts on the stack
+ *  radixSort(a, n, scratch)    unsigned integers, stable, 4 bits per pass,
+ *                              scratch holds n elements
+ *  lowerBound(a, n, key)       first element not less than key
+ *  upperBound(a, n, key)       first element greater than key
+ *
+ * Each sort and search takes an optional comparator, any function or
+ * object called as less(x, y).  Less<T> and Greater<T> are provided, and
+ * PgmIndexLess<T> orders indices into a PROGMEM table so that records kept
+ * in flash can be sorted through a small index array.  lowerBound_P and
+ * upperBound_P search a sorted PROGMEM table directly.
+ *
+ * Nothing is allocated from the heap; recursion depth is O(log n).
+ */
+
+#ifndef SORT_H_
+#define SORT_H_
+
+#if ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+#include <avr/pgmspace.h>
+
+#define SORT_INSERTION_CUTOFF 12
+
+template <typename T>
+struct Less {
+	bool operator()(const T & x, const T & y) const {
+		return x < y;
+	}
+};
+
+template <typename T>
+struct Greater {
+	bool operator()(const T & x, const T & y) const {
+		return y < x;
+	}
+};
+
+// orders indices by the records they select in a PROGMEM table
+template <typename T, typename C = Less<T> >
+struct PgmIndexLess {
+	const T * table;
+	C less;
+
+	PgmIndexLess(const T * t, C c = C()) : table(t), less(c) {}
+
+	template <typename I>
+	bool operator()(I i, I j) const {
+		T x, y;
+		memcpy_P(&x, table + i, sizeof(T));
+		memcpy_P(&y, table + j, sizeof(T));
+		return less(x, y);
+	}
+};
+
+template <typename T>
+inline void sortSwap(T & x, T & y) {
+	T t = x;
+	x = y;
+	y = t;
+}
+
+/*
+ * Insertion sort
+ */
+template <typename T, typename C>
+void insertionSort(T * a, int n, C less) {
+	for (int i = 1; i < n; i++) {
+		if (!less(a[i], a[i - 1]))
+			continue;
+		T v = a[i];
+		int j = i;
+		do {
+			a[j] = a[j - 1];
+			j--;
+		} while (j > 0 && less(v, a[j - 1]));
+		a[j] = v;
+	}
+}
+
+template <typename T>
+inline void insertionSort(T * a, int n) {
+	insertionSort(a, n, Less<T>());
+}
+
+/*
+ * Heapsort
+ */
+template <typename T, typename C>
+void sortSiftDown(T * a, int root, int n, C less) {
+	T v = a[root];
+	int child;
+	while ((child = 2 * root + 1) < n) {
+		if (child + 1 < n && less(a[child], a[child + 1]))
+			child++;
+		if (!less(v, a[child]))
+			break;
+		a[root] = a[child];
+		root = child;
+	}
+	a[root] = v;
+}
+
+template <typename T, typename C>
+void heapSort(T * a, int n, C less) {
+	for (int i = n / 2 - 1; i >= 0; i--)
+		sortSiftDown(a, i, n, less);
+	for (int i = n - 1; i > 0; i--) {
+		sortSwap(a[0], a[i]);
+		sortSiftDown(a, 0, i, less);
+	}
+}
+
+template <typename T>
+inline void heapSort(T * a, int n) {
+	heapSort(a, n, Less<T>());
+}
+
+/*
+ * Introsort.  Partitions are left unsorted below the cutoff and finished
+ * by one insertion sort pass over the whole array.
+ */
+template <typename T, typename C>
+void introSortLoop(T * a, int n, int depth, C less) {
+	while (n > SORT_INSERTION_CUTOFF) {
+		if (depth-- == 0) {
+			heapSort(a, n, less);
+			return;
+		}
+		// median of three into the middle, the lower middle keeps both
+		// partitions non-empty
+		int mid = (n - 1) / 2;
+		if (less(a[mid], a[0]))
+			sortSwap(a[mid], a[0]);
+		if (less(a[n - 1], a[mid])) {
+			sortSwap(a[n - 1], a[mid]);
+			if (less(a[mid], a[0]))
+				sortSwap(a[mid], a[0]);
+		}
+		T pivot = a[mid];
+		int i = -1, j = n;
+		for (;;) {
+			do
+				i++;
+			while (less(a[i], pivot));
+			do
+				j--;
+			while (less(pivot, a[j]));
+			if (i >= j)
+				break;
+			sortSwap(a[i], a[j]);
+		}
+		// recurse into the smaller side, loop on the larger
+		int left = j + 1;
+		if (left < n - left) {
+			introSortLoop(a, left, depth, less);
+			a += left;
+			n -= left;
+		} else {
+			introSortLoop(a + left, n - left, depth, less);
+			n = left;
+		}
+	}
+}
+
+template <typename T, typename C>
+void introSort(T * a, int n, C less) {
+	int depth = 0;
+	for (int m = n; m > 1; m >>= 1)
+		depth += 2;
+	introSortLoop(a, n, depth, less);
+	insertionSort(a, n, less);
+}
+
+template <typename T>
+inline void introSort(T * a, int n) {
+	introSort(a, n, Less<T>());
+}
+
+/*
+ * Merge sort, stable.  The left half is moved to scratch and merged back
+ * with the right half in place.
+ */
+template <typename T, typename C>
+void mergeSort(T * a, int n, T * scratch, C less) {
+	if (n <= SORT_INSERTION_CUTOFF) {
+		insertionSort(a, n, less);
+		return;
+	}
+	int half = n / 2;
+	mergeSort(a, half, scratch, less);
+	mergeSort(a + half, n - half, scratch, less);
+	if (!less(a[half], a[half - 1]))
+		return;   // already in order
+
+	for (int i = 0; i < half; i++)
+		scratch[i] = a[i];
+	int i = 0, j = half, k = 0;
+	while (i < half && j < n) {
+		// equal keys take the left one first
+		if (less(a[j], scratch[i]))
+			a[k++] = a[j++];
+		else
+			a[k++] = scratch[i++];
+	}
+	while (i < half)
+		a[k++] = scratch[i++];
+}
+
+template <typename T>
+inline void mergeSort(T * a, int n, T * scratch) {
+	mergeSort(a, n, scratch, Less<T>());
+}
+
+/*
+ * Counting sort of small integers, 0 .. R-1.  Values outside the range
+ * are dropped into the nearest end.
+ */
+template <int R, typename T>
+void countingSort(T * a, int n) {
+	unsigned int count[R];
+	for (int v = 0; v < R; v++)
+		count[v] = 0;
+	for (int i = 0; i < n; i++) {
+		T v = a[i];
+		count[v < 0 ? 0 : (v >= R ? R - 1 : v)]++;
+	}
+	int k = 0;
+	for (int v = 0; v < R; v++)
+		for (unsigned int c = count[v]; c > 0; c--)
+			a[k++] = v;
+}
+
+/*
+ * LSD radix sort of unsigned integers, four bits per pass.  Passes where
+ * every element has the same digit are skipped.  The result ends up in a.
+ */
+template <typename T>
+void radixSort(T * a, int n, T * scratch) {
+	T * from = a;
+	T * to = scratch;
+	unsigned int count[16];
+
+	if (n < 2)
+		return;
+	for (uint8_t shift = 0; shift < sizeof(T) * 8; shift += 4) {
+		for (uint8_t d = 0; d < 16; d++)
+			count[d] = 0;
+		for (int i = 0; i < n; i++)
+			count[(from[i] >> shift) & 0xf]++;
+		if (count[(from[0] >> shift) & 0xf] == (unsigned int) n)
+			continue;
+		// bucket starts
+		unsigned int start = 0;
+		for (uint8_t d = 0; d < 16; d++) {
+			unsigned int c = count[d];
+			count[d] = start;
+			start += c;
+		}
+		for (int i = 0; i < n; i++)
+			to[count[(from[i] >> shift) & 0xf]++] = from[i];
+		T * t = from;
+		from = to;
+		to = t;
+	}
+	if (from != a)
+		for (int i = 0; i < n; i++)
+			a[i] = from[i];
+}
+
+/*
+ * Binary search
+ */
+template <typename T, typename K, typename C>
+int lowerBound(const T * a, int n, const K & key, C less) {
+	int lo = 0;
+	while (n > 0) {
+		int half = n / 2;
+		if (less(a[lo + half], key)) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return lo;
+}
+
+template <typename T, typename K>
+inline int lowerBound(const T * a, int n, const K & key) {
+	return lowerBound(a, n, key, Less<T>());
+}
+
+template <typename T, typename K, typename C>
+int upperBound(const T * a, int n, const K & key, C less) {
+	int lo = 0;
+	while (n > 0) {
+		int half = n / 2;
+		if (!less(key, a[lo + half])) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return lo;
+}
+
+template <typename T, typename K>
+inline int upperBound(const T * a, int n, const K & key) {
+	return upperBound(a, n, key, Less<T>());
+}
+
+// the same over a table in PROGMEM
+template <typename T, typename K, typename C>
+int lowerBound_P(const T * table, int n, const K & key, C less) {
+	int lo = 0;
+	T x;
+	while (n > 0) {
+		int half = n / 2;
+		memcpy_P(&x, table + lo + half, sizeof(T));
+		if (less(x, key)) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return lo;
+}
+
+template <typename T, typename K>
+inline int lowerBound_P(const T * table, int n, const K & key) {
+	return lowerBound_P(table, n, key, Less<T>());
+}
+
+template <typename T, typename K, typename C>
+int upperBound_P(const T * table, int n, const K & key, C less) {
+	int lo = 0;
+	T x;
+	while (n > 0) {
+		int half = n / 2;
+		memcpy_P(&x, table + lo + half, sizeof(T));
+		if (!less(key, x)) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return lo;
+}
+
+template <typename T, typename K>
+inline int upperBound_P(const T * table, int n, const K & key) {
+	return upperBound_P(table, n, key, Less<T>());
+}
+
+#endif /* SORT_H_ */
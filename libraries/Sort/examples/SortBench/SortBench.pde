@@ -0,0 +1,113 @@
+/*
+ * Sorting time by input size and distribution.
+ *
+ * Sorts int arrays of 16, 64 and 192 elements in five orders with each
+ * algorithm of Sort.h and the selection and bubble sorts of the
+ * Sort_Algorithms sketch, and prints microseconds and CPU cycles per
+ * element.  Counting sort runs on values folded into 0 .. 63.
+ */
+#include <Sort.h>
+
+const int sizes[] = { 16, 64, 192 };
+const int maxSize = 192;
+const char * orders[] = { "random", "sorted", "reversed", "few unique", "organ pipe" };
+
+int input[maxSize];
+int work[maxSize];
+int scratch[maxSize];
+
+unsigned int lfsr = 0xACE1;
+
+int fill(int order, int i, int n) {
+	lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+	switch (order) {
+	case 0:
+		return lfsr & 0x7fff;
+	case 1:
+		return i;
+	case 2:
+		return n - i;
+	case 3:
+		return lfsr & 3;
+	default:
+		return i < n / 2 ? i : n - i;
+	}
+}
+
+void selectionSort(int a[], int n) {
+	for (int j = 0; j < n - 1; j++)
+		for (int i = j; i < n; i++)
+			if (a[i] < a[j]) {
+				int t = a[i];
+				a[i] = a[j];
+				a[j] = t;
+			}
+}
+
+void bubbleSort(int a[], int n) {
+	for (int i = 0; i + 1 < n; i++)
+		for (int j = 0; j + 1 < n; j++)
+			if (a[j + 1] < a[j]) {
+				int t = a[j];
+				a[j] = a[j + 1];
+				a[j + 1] = t;
+			}
+}
+
+void report(const char * name, unsigned long us, int n) {
+	Serial.print("  ");
+	Serial.print(name);
+	Serial.print(": ");
+	Serial.print(us);
+	Serial.print(" us, ");
+	Serial.print((float) us * (F_CPU / 1000000L) / n, 0);
+	Serial.println(" cycles/element");
+}
+
+void check(int n) {
+	for (int i = 1; i < n; i++)
+		if (work[i] < work[i - 1]) {
+			Serial.println("  NOT SORTED");
+			return;
+		}
+}
+
+// copies the input, runs one algorithm and reports it
+#define RUN(name, call) \
+	memcpy(work, input, n * sizeof(int)); \
+	t = micros(); \
+	call; \
+	report(name, micros() - t, n); \
+	check(n)
+
+void setup() {
+	Serial.begin(19200);
+}
+
+void loop() {
+	unsigned long t;
+
+	for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		int n = sizes[s];
+		for (int order = 0; order < 5; order++) {
+			for (int i = 0; i < n; i++)
+				input[i] = fill(order, i, n);
+			Serial.print(n);
+			Serial.print(" ");
+			Serial.println(orders[order]);
+
+			RUN("insertionSort", insertionSort(work, n));
+			RUN("introSort", introSort(work, n));
+			RUN("heapSort", heapSort(work, n));
+			RUN("mergeSort", mergeSort(work, n, scratch));
+			RUN("radixSort", radixSort((unsigned int *) work, n, (unsigned int *) scratch));
+			RUN("selection", selectionSort(work, n));
+			RUN("bubble", bubbleSort(work, n));
+			for (int i = 0; i < n; i++)
+				input[i] &= 63;
+			RUN("countingSort<64>", countingSort<64>(work, n));
+		}
+	}
+	Serial.println();
+	delay(10000);
+}
@@ -36,6 +36,45 @@ uint8_t OUTPUT_REPORT_BUFFER[] PROGMEM = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 
 };
 
+/* How the input reports are decoded into PS3State */
+#define PS3_FIELD_BUTTONS   0 // three bytes
+#define PS3_FIELD_U8        1
+#define PS3_FIELD_BE16      2 // high byte first
+#define PS3_FIELD_LE16      3 // low byte first
+#define PS3_FIELD_HI12      4 // low nibble of the first byte and the second byte
+#define PS3_FIELD_LO12      5 // first byte and high nibble of the second byte
+
+struct PS3Field
+{
+    uint8_t offset; // byte location in l2capinbuf
+    uint8_t format;
+    uint8_t dest; // byte location in PS3State
+    uint8_t count; // fields of the same format right after each other
+};
+
+const PS3Field PS3_FIELDS[] PROGMEM = { // Dualshock 3 and Navigation controller
+    { 11, PS3_FIELD_BUTTONS, offsetof(PS3State, buttons), 1 },
+    { LeftHatX, PS3_FIELD_U8, offsetof(PS3State, hat), 4 },
+    { UP_ANALOG, PS3_FIELD_U8, offsetof(PS3State, analogButton), 12 },
+    { 38, PS3_FIELD_U8, offsetof(PS3State, status), 3 },
+    { aX, PS3_FIELD_BE16, offsetof(PS3State, sensor), 4 }, // aX, aY, aZ and gZ
+};
+const PS3Field MOVE_FIELDS[] PROGMEM = { // Motion controller
+    { 10, PS3_FIELD_BUTTONS, offsetof(PS3State, buttons), 1 }, // All the buttons locations are shifted one back on the Move controller
+    { T_ANALOG, PS3_FIELD_U8, offsetof(PS3State, analogButton) + 12, 1 },
+    { 21, PS3_FIELD_U8, offsetof(PS3State, status) + 1, 1 },
+    { aXmove, PS3_FIELD_LE16, offsetof(PS3State, sensor), 3 }, // aXmove, aZmove and aYmove
+    { gXmove, PS3_FIELD_LE16, offsetof(PS3State, sensor) + 3 * 2, 3 }, // gXmove, gZmove and gYmove
+    { tempMove, PS3_FIELD_LO12, offsetof(PS3State, sensor) + 6 * 2, 1 },
+    { mXmove, PS3_FIELD_HI12, offsetof(PS3State, sensor) + 7 * 2, 1 },
+    { mZmove, PS3_FIELD_LO12, offsetof(PS3State, sensor) + 8 * 2, 1 },
+    { mYmove, PS3_FIELD_HI12, offsetof(PS3State, sensor) + 9 * 2, 1 },
+};
+
+/* Order of PS3State.sensor - aX and mYmove are both at byte 50, so it depends on the controller */
+const uint8_t PS3_SENSORS[] PROGMEM = { aX, aY, aZ, gZ };
+const uint8_t MOVE_SENSORS[] PROGMEM = { aXmove, aZmove, aYmove, gXmove, gZmove, gYmove, tempMove, mXmove, mZmove, mYmove };
+
 PS3BT::PS3BT(USB *p, uint8_t btadr5, uint8_t btadr4, uint8_t btadr3, uint8_t btadr2, uint8_t btadr1, uint8_t btadr0):
 pUsb(p), // pointer to USB class instance - mandatory
 bAddress(0), // device address - mandatory
@@ -60,6 +99,10 @@ bPollEnable(false) // don't start polling before dongle is connected
     my_bdaddr[2] = btadr2;
     my_bdaddr[1] = btadr1;
     my_bdaddr[0] = btadr0;
+    
+    hci_new_controller = PS3_MAX_CONTROLLERS;
+    for (uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++)
+        resetController(i);
 }
 
 uint8_t PS3BT::Init(uint8_t parent, uint8_t port, bool lowspeed)
@@ -247,17 +290,6 @@ uint8_t PS3BT::Init(uint8_t parent, uint8_t port, bool lowspeed)
         if(rcode) 
             goto FailSetConf;        
         
-        //Needed for PS3 Dualshock Controller commands to work via bluetooth
-        for (uint8_t i = 0; i < OUTPUT_REPORT_BUFFER_SIZE; i++)
-            HIDBuffer[i + 2] = pgm_read_byte(&OUTPUT_REPORT_BUFFER[i]);//First two bytes reserved for report type and ID
-        
-        HIDBuffer[0] = 0x52;// HID BT Set_report (0x50) | Report Type (Output 0x02)
-        HIDBuffer[1] = 0x01;// Report ID
-        
-        //Needed for PS3 Move Controller commands to work via bluetooth
-        HIDMoveBuffer[0] = 0xA2;// HID BT DATA_request (0xA0) | Report Type (Output 0x02)            
-        HIDMoveBuffer[1] = 0x02;// Report ID
-        
         /* Set device cid for the control and intterrupt channelse - LSB */
         control_dcid[0] = 0x40;//0x0040
         control_dcid[1] = 0x00;        
@@ -268,7 +300,9 @@ uint8_t PS3BT::Init(uint8_t parent, uint8_t port, bool lowspeed)
         
         hci_state = HCI_INIT_STATE;
         hci_counter = 0;        
-        l2cap_state = L2CAP_EV_WAIT;
+        hci_new_controller = PS3_MAX_CONTROLLERS;
+        for (uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++)
+            resetController(i);
 #ifdef DEBUG
         Notify(PSTR("\r\nBluetooth Dongle Initialized"));
 #endif
@@ -369,12 +403,11 @@ void PS3BT::PrintEndpointDescriptor( const USB_ENDPOINT_DESCRIPTOR* ep_ptr )
 /* Performs a cleanup after failed Init() attempt */
 uint8_t PS3BT::Release()
 {
-    PS3Connected = false;
-    PS3MoveConnected = false;
-    PS3NavigationConnected = false;
 	pUsb->GetAddressPool().FreeAddress(bAddress);    
 	bAddress = 0;
     bPollEnable = false;
+    for (uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++)
+        resetController(i);
     bNumEP = 1; // must have to be reset to 1	
 	return 0;
 }
@@ -384,6 +417,9 @@ uint8_t PS3BT::Poll()
 		return 0;
     if (qNextPollTime <= millis()) { // Don't poll if shorter than polling interval
         qNextPollTime = millis() + pollInterval; // Set new poll time
+        buttonChanged = false; // These are only set until the next poll
+        buttonPressed = false;
+        buttonReleased = false;
         HCI_event_task(); // poll the HCI event pipe
         ACL_event_task(); // start polling the ACL input pipe too, though discard data until connected        
     }    
@@ -437,77 +473,63 @@ void PS3BT::setMoveBdaddr(uint8_t* BDADDR)
 #endif
 	return;
 }
-bool PS3BT::getButton(Button b)
+bool PS3BT::getButton(Button b, uint8_t controller)
 {
-    if (l2capinbuf == NULL)
+    if (controller >= PS3_MAX_CONTROLLERS)
+        return false;
+    // The button bytes starts at byte 11 - for the Move controller too, as it is moved when decoded
+    if (controllers[controller].state.buttons & ((uint32_t)((uint8_t)b & 0xff) << ((((uint16_t)b >> 8) - 11) << 3)))
+        return true;
+    else
         return false;
-    if(PS3MoveConnected) {
-        if((l2capinbuf[((uint16_t)b >> 8)-1] & ((uint8_t)b & 0xff))) // All the buttons locations are shifted one back on the Move controller
-            return true;
-        else
-            return false;
-    } else {  
-        if((l2capinbuf[(uint16_t)b >> 8] & ((uint8_t)b & 0xff)))
-            return true;
-        else
-            return false;
-    }
 }
-uint8_t PS3BT::getAnalogButton(AnalogButton a)
+uint8_t PS3BT::getAnalogButton(AnalogButton a, uint8_t controller)
 {
-    if (l2capinbuf == NULL)
+    if (controller >= PS3_MAX_CONTROLLERS)
         return 0;
-    return (uint8_t)(l2capinbuf[(uint16_t)a]);
+    if (a == T_ANALOG)
+        return controllers[controller].state.analogButton[12];
+    return controllers[controller].state.analogButton[(uint8_t)a - UP_ANALOG];
 }
-uint8_t PS3BT::getAnalogHat(AnalogHat a)
+uint8_t PS3BT::getAnalogHat(AnalogHat a, uint8_t controller)
 {
-    if (l2capinbuf == NULL)
+    if (controller >= PS3_MAX_CONTROLLERS)
         return 0;                        
-    return (uint8_t)(l2capinbuf[(uint16_t)a]);            
+    return controllers[controller].state.hat[(uint8_t)a - LeftHatX];
 }
-int16_t PS3BT::getSensor(Sensor a)
+int16_t PS3BT::getSensor(Sensor a, uint8_t controller)
 {
-    if (l2capinbuf == NULL)
+    if (controller >= PS3_MAX_CONTROLLERS)
         return 0;
-    if (a == aX || a == aY || a == aZ || a == gZ)
-        return ((l2capinbuf[(uint16_t)a] << 8) | l2capinbuf[(uint16_t)a + 1]);
-    else if (a == mXmove || a == mYmove || a == mZmove) // These are all 12-bits long
-    {        
-        // Might not be correct, haven't tested it yet
-        /*if (a == mXmove)
-            return ((l2capinbuf[(uint16_t)a + 1] << 0x04) | (l2capinbuf[(uint16_t)a] << 0x0C));
-        else if (a == mYmove)
-            return ((l2capinbuf[(uint16_t)a + 1] & 0xF0) | (l2capinbuf[(uint16_t)a] << 0x08));
-        else if (a == mZmove)
-         return ((l2capinbuf[(uint16_t)a + 1] << 0x0F) | (l2capinbuf[(uint16_t)a] << 0x0C));
-         */
-        if (a == mXmove || a == mYmove)
-            return (((l2capinbuf[(uint16_t)a] & 0x0F) << 8) | (l2capinbuf[(uint16_t)a + 1]));
-        else // mZmove            
-            return ((l2capinbuf[(uint16_t)a] << 4) | (l2capinbuf[(uint16_t)a + 1] >> 4));                
+    const uint8_t* sensors = PS3_SENSORS;
+    uint8_t n = sizeof(PS3_SENSORS);
+    if (controllers[controller].type == MotionController) {
+        sensors = MOVE_SENSORS;
+        n = sizeof(MOVE_SENSORS);
     }
-    else if (a == tempMove) // The tempearature is 12 bits long too
-        return ((l2capinbuf[(uint16_t)a] << 4) | ((l2capinbuf[(uint16_t)a + 1] & 0xF0) >> 4));
-    else // aXmove, aYmove, aZmove, gXmove, gYmove and gZmove
-        return (l2capinbuf[(uint16_t)a] | (l2capinbuf[(uint16_t)a + 1] << 8));
+    for (uint8_t i = 0; i < n; i++) {
+        if (pgm_read_byte(&sensors[i]) == (uint8_t)a)
+            return controllers[controller].state.sensor[i];
+    }
+    return 0; // The controller doesn't have this sensor
 }
-double PS3BT::getAngle(Angle a) {        
+double PS3BT::getAngle(Angle a, uint8_t controller) {        
     double accXval;
     double accYval;
     double accZval;
     
-    if(PS3Connected) {
+    if(getControllerType(controller) == Dualshock3) {
         // Data for the Kionix KXPC4 used in the DualShock 3
         const double zeroG = 511.5; // 1.65/3.3*1023 (1,65V)
-        accXval = -((double)getSensor(aX)-zeroG);
-        accYval = -((double)getSensor(aY)-zeroG);
-        accZval = -((double)getSensor(aZ)-zeroG);
-    } else if(PS3MoveConnected) {        
+        accXval = -((double)getSensor(aX, controller)-zeroG);
+        accYval = -((double)getSensor(aY, controller)-zeroG);
+        accZval = -((double)getSensor(aZ, controller)-zeroG);
+    } else if(getControllerType(controller) == MotionController) {        
         // It's a Kionix KXSC4 inside the Motion controller
         const uint16_t zeroG = 0x8000;                
-        accXval = -(int16_t)(getSensor(aXmove)-zeroG);
-        accYval = (int16_t)(getSensor(aYmove)-zeroG);
-        accZval = (int16_t)(getSensor(aZmove)-zeroG);      
+        accXval = -(int16_t)(getSensor(aXmove, controller)-zeroG);
+        accYval = (int16_t)(getSensor(aYmove, controller)-zeroG);
+        accZval = (int16_t)(getSensor(aZmove, controller)-zeroG);      
     }
     
     // Convert to 360 degrees resolution
@@ -521,9 +543,9 @@ double PS3BT::getAngle(Angle a) {
         return angle;
     }    
 }
-String PS3BT::getTemperature() {
-    if(PS3MoveConnected) {
-        int16_t input = getSensor(tempMove);    
+String PS3BT::getTemperature(uint8_t controller) {
+    if(getControllerType(controller) == MotionController) {
+        int16_t input = getSensor(tempMove, controller);    
         
         String output = String(input/100);
         output += ".";
@@ -533,79 +555,144 @@ String PS3BT::getTemperature() {
         
         return output;        
     }
+    return "";
 }
-bool PS3BT::getStatus(Status c)
+bool PS3BT::getStatus(Status c, uint8_t controller)
 {
-    if (l2capinbuf == NULL)
+    if (controller >= PS3_MAX_CONTROLLERS)
         return false;
-    if (l2capinbuf[(uint16_t)c >> 8] == ((uint8_t)c & 0xff))
+    uint8_t i = (uint16_t)c >> 8;
+    i = (i == 21) ? 1 : i - 38; // The Move controller's battery is stored with the other controllers' - see MOVE_FIELDS
+    if (controllers[controller].state.status[i] == ((uint8_t)c & 0xff))
         return true;
     return false;
 }
-String PS3BT::getStatusString()
+String PS3BT::getStatusString(uint8_t controller)
 {
-    if (PS3Connected || PS3NavigationConnected)
+    ControllerType type = getControllerType(controller);
+    if (type == Dualshock3 || type == NavigationController)
     {
         char statusOutput[100];
         
         strcpy(statusOutput,"ConnectionStatus: ");
         
-        if (getStatus(Plugged)) strcat(statusOutput,"Plugged");
-        else if (getStatus(Unplugged)) strcat(statusOutput,"Unplugged");
+        if (getStatus(Plugged, controller)) strcat(statusOutput,"Plugged");
+        else if (getStatus(Unplugged, controller)) strcat(statusOutput,"Unplugged");
         else strcat(statusOutput,"Error");
         
         
         strcat(statusOutput," - PowerRating: ");
-        if (getStatus(Charging)) strcat(statusOutput,"Charging");
-        else if (getStatus(NotCharging)) strcat(statusOutput,"Not Charging");
-        else if (getStatus(Shutdown)) strcat(statusOutput,"Shutdown");
-        else if (getStatus(Dying)) strcat(statusOutput,"Dying");
-        else if (getStatus(Low)) strcat(statusOutput,"Low");
-        else if (getStatus(High)) strcat(statusOutput,"High");
-        else if (getStatus(Full)) strcat(statusOutput,"Full");
+        if (getStatus(Charging, controller)) strcat(statusOutput,"Charging");
+        else if (getStatus(NotCharging, controller)) strcat(statusOutput,"Not Charging");
+        else if (getStatus(Shutdown, controller)) strcat(statusOutput,"Shutdown");
+        else if (getStatus(Dying, controller)) strcat(statusOutput,"Dying");
+        else if (getStatus(Low, controller)) strcat(statusOutput,"Low");
+        else if (getStatus(High, controller)) strcat(statusOutput,"High");
+        else if (getStatus(Full, controller)) strcat(statusOutput,"Full");
         else strcat(statusOutput,"Error");
         
         strcat(statusOutput," - WirelessStatus: ");
         
-        if (getStatus(CableRumble)) strcat(statusOutput,"Cable - Rumble is on");
-        else if (getStatus(Cable)) strcat(statusOutput,"Cable - Rumble is off");
-        else if (getStatus(BluetoothRumble)) strcat(statusOutput,"Bluetooth - Rumble is on");
-        else if (getStatus(Bluetooth)) strcat(statusOutput,"Bluetooth - Rumble is off");
+        if (getStatus(CableRumble, controller)) strcat(statusOutput,"Cable - Rumble is on");
+        else if (getStatus(Cable, controller)) strcat(statusOutput,"Cable - Rumble is off");
+        else if (getStatus(BluetoothRumble, controller)) strcat(statusOutput,"Bluetooth - Rumble is on");
+        else if (getStatus(Bluetooth, controller)) strcat(statusOutput,"Bluetooth - Rumble is off");
         else strcat(statusOutput,"Error");
         
         return statusOutput;
         
     }
-    else if(PS3MoveConnected)
+    else if(type == MotionController)
     {
         char statusOutput[50];
         
         strcpy(statusOutput,"PowerRating: ");
         
-        if (getStatus(MoveCharging)) strcat(statusOutput,"Charging");
-        else if (getStatus(MoveNotCharging)) strcat(statusOutput,"Not Charging");
-        else if (getStatus(MoveShutdown)) strcat(statusOutput,"Shutdown");
-        else if (getStatus(MoveDying)) strcat(statusOutput,"Dying");
-        else if (getStatus(MoveLow)) strcat(statusOutput,"Low");
-        else if (getStatus(MoveHigh)) strcat(statusOutput,"High");
-        else if (getStatus(MoveFull)) strcat(statusOutput,"Full");
+        if (getStatus(MoveCharging, controller)) strcat(statusOutput,"Charging");
+        else if (getStatus(MoveNotCharging, controller)) strcat(statusOutput,"Not Charging");
+        else if (getStatus(MoveShutdown, controller)) strcat(statusOutput,"Shutdown");
+        else if (getStatus(MoveDying, controller)) strcat(statusOutput,"Dying");
+        else if (getStatus(MoveLow, controller)) strcat(statusOutput,"Low");
+        else if (getStatus(MoveHigh, controller)) strcat(statusOutput,"High");
+        else if (getStatus(MoveFull, controller)) strcat(statusOutput,"Full");
         else strcat(statusOutput,"Error");
         
         return statusOutput;
     }
+    return "";
+}
+bool PS3BT::getButtonEvent(Button *b, bool *pressed, uint8_t controller)
+{
+    if (controller >= PS3_MAX_CONTROLLERS)
+        return false;
+    PS3Controller *c = &controllers[controller];
+    if (c->eventTail == c->eventHead)
+        return false;
+    uint8_t event = c->events[c->eventTail];
+    c->eventTail = (c->eventTail + 1) & (PS3_EVENT_QUEUE_SIZE - 1);
+    
+    uint8_t bit = event & 0x1F;
+    *b = (Button)(((11 + (bit >> 3)) << 8) | (1 << (bit & 0x07))); // Back to the byte and bit location of enum Button
+    *pressed = (event & 0x80);
+    return true;
 }
-void PS3BT::disconnect()//Use this void to disconnect any of the controllers
+ControllerType PS3BT::getControllerType(uint8_t controller)
 {
-    if (PS3Connected)
+    if (controller >= PS3_MAX_CONTROLLERS || !controllers[controller].connected)
+        return NoController;
+    return (ControllerType)controllers[controller].type;
+}
+void PS3BT::disconnect(uint8_t controller)//Use this void to disconnect any of the controllers
+{
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    PS3Controller *c = &controllers[controller];
+    c->connected = false;
+    if (controller == 0) {
         PS3Connected = false;
-    else if (PS3MoveConnected)
         PS3MoveConnected = false;
-    else if (PS3NavigationConnected)
         PS3NavigationConnected = false;
+    }
     
     //First the HID interrupt channel has to be disconencted, then the HID control channel and finally the HCI connection
-    l2cap_disconnection_request(0x0A, interrupt_dcid, interrupt_scid);            
-    l2cap_state = L2CAP_EV_INTERRUPT_DISCONNECT;
+    l2cap_disconnection_request(controller, 0x0A, interrupt_dcid, c->interrupt_scid);            
+    c->l2cap_state = L2CAP_EV_INTERRUPT_DISCONNECT;
+}
+void PS3BT::resetController(uint8_t controller)
+{
+    PS3Controller *c = &controllers[controller];
+    c->hci_handle = -1;
+    c->type = NoController;
+    c->connected = false;
+    c->l2cap_state = L2CAP_EV_WAIT;
+    c->l2cap_event_flag = 0;
+    c->timerHID = 0;
+    for (uint8_t i = 0; i < sizeof(c->output); i++)
+        c->output[i] = 0;
+    
+    memset(&c->state, 0, sizeof(PS3State));
+    for (uint8_t i = 0; i < 4; i++)
+        c->state.hat[i] = 0x7F; // Set the analog joystick values to center position
+    c->oldButtons = 0;
+    c->eventHead = 0;
+    c->eventTail = 0;
+    
+    if (controller == 0) {
+        PS3Connected = false;
+        PS3MoveConnected = false;
+        PS3NavigationConnected = false;
+        buttonChanged = false;
+        buttonPressed = false;
+        buttonReleased = false;
+    }
+}
+uint8_t PS3BT::freeController()
+{
+    for (uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++) {
+        if (controllers[i].hci_handle == -1 && i != hci_new_controller)
+            return i;
+    }
+    return PS3_MAX_CONTROLLERS;
 }
 
 void PS3BT::HCI_event_task()
@@ -615,6 +702,8 @@ void PS3BT::HCI_event_task()
     uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[ BTD_EVENT_PIPE ].epAddr, &MAX_BUFFER_SIZE, hcibuf); // input on endpoint 1
     if(!rcode || rcode == hrNAK) // Check for errors
     {
+        if(rcode == hrNAK) // Nothing new - the buffer still holds the last event or command
+            hcibuf[0] = 0x00;
         switch (hcibuf[0]) //switch on event type
         {
             case EV_COMMAND_COMPLETE:
@@ -647,9 +736,9 @@ void PS3BT::HCI_event_task()
                 break;
                 
             case EV_CONNECT_COMPLETE:
-                if (!hcibuf[2]) // check if connected OK
+                if (!hcibuf[2] && hci_new_controller < PS3_MAX_CONTROLLERS) // check if connected OK
                 { 
-                    hci_handle = hcibuf[3] | hcibuf[4] << 8; //store the handle for the ACL connection
+                    controllers[hci_new_controller].hci_handle = hcibuf[3] | hcibuf[4] << 8; //store the handle for the ACL connection
                     hci_event_flag |= HCI_FLAG_CONN_COMPLETE; // set connection complete flag
                 }
                 break;
@@ -658,7 +747,16 @@ void PS3BT::HCI_event_task()
                 if (!hcibuf[2]) // check if disconnected OK
                 {
                     hci_event_flag |= HCI_FLAG_DISCONN_COMPLETE; //set disconnect commend complete flag
-                    hci_event_flag &= ~HCI_FLAG_CONN_COMPLETE; // clear connection complete flag
+                    for (uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++) {
+                        if (controllers[i].hci_handle == (hcibuf[3] | hcibuf[4] << 8))
+                        {
+#ifdef DEBUG
+                            Notify(PSTR("\r\nDisconnected Controller: "));
+                            Serial.print(i);
+#endif
+                            resetController(i); // It can be used by the next controller that connects
+                        }
+                    }
                 }
                 break;                              
                 
@@ -805,6 +903,11 @@ void PS3BT::HCI_task()
         case HCI_CONNECT_IN_STATE:
             if(hci_incoming_connect_request)
             {
+                hci_new_controller = freeController();
+                if(hci_new_controller == PS3_MAX_CONTROLLERS) { // Can only happen if it was full before the scan was disabled
+                    hci_event_flag &= ~HCI_FLAG_INCOMING_REQUEST;
+                    break;
+                }
                 watingForConnection = false;
 #ifdef DEBUG
                 Notify(PSTR("\r\nIncoming Request"));                
@@ -826,6 +929,7 @@ void PS3BT::HCI_task()
                     Serial.write(remote_name[i]);   
                 }             
 #endif
+                controllers[hci_new_controller].type = remote_name[0]; // First letter of the name, see enum ControllerType
                 hci_accept_connection();
                 hci_state = HCI_CONNECTED_STATE;                                
             }      
@@ -842,9 +946,21 @@ void PS3BT::HCI_task()
                     Serial.print(":");
                 }      
                 PrintHex<uint8_t>(disc_bdaddr[0]);
+                Notify(PSTR(" as Controller: "));
+                Serial.print(hci_new_controller);
 #endif
-                hci_write_scan_disable(); // Only allow one controller
-                hci_state = HCI_DISABLE_SCAN;
+                hci_event_flag &= ~(HCI_FLAG_CONN_COMPLETE | HCI_FLAG_INCOMING_REQUEST); // Ready for the next controller
+                controllers[hci_new_controller].l2cap_event_flag = 0;
+                controllers[hci_new_controller].l2cap_state = L2CAP_EV_CONTROL_SETUP;
+                hci_new_controller = PS3_MAX_CONTROLLERS;
+                
+                if (freeController() < PS3_MAX_CONTROLLERS) { // Page scan is still enabled, so the next one can just connect
+                    watingForConnection = true;
+                    hci_state = HCI_CONNECT_IN_STATE;
+                } else {
+                    hci_write_scan_disable(); // No more controllers can connect
+                    hci_state = HCI_DISABLE_SCAN;
+                }
             }
             break;
             
@@ -854,49 +970,15 @@ void PS3BT::HCI_task()
 #ifdef DEBUG
                 Notify(PSTR("\r\nScan Disabled"));
 #endif
-                l2cap_event_flag = 0;
-                l2cap_state = L2CAP_EV_CONTROL_SETUP;
                 hci_state = HCI_DONE_STATE;
             }
             break;
             
         case HCI_DONE_STATE:
-            if (hci_disconnect_complete)
-                hci_state = HCI_DISCONNECT_STATE;
-            break;
-            
-        case HCI_DISCONNECT_STATE:
-            if (hci_disconnect_complete)
-            {
-#ifdef DEBUG
-                Notify(PSTR("\r\nDisconnected from Device: "));                
-                for(int8_t i = 5; i>0;i--)
-                {
-                    PrintHex<uint8_t>(disc_bdaddr[i]); 
-                    Serial.print(":");
-                }      
-                PrintHex<uint8_t>(disc_bdaddr[0]);
-#endif
-                l2cap_event_flag = 0; // Clear all flags
-                hci_event_flag = 0; // Clear all flags 
-                
-                //Reset all buffers                        
-                for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++)
-                    hcibuf[i] = 0;        
-                for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++)
-                    l2capinbuf[i] = 0;
-                for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++)
-                    l2capoutbuf[i] = 0;   
-                
-                for (uint8_t i = 0; i < OUTPUT_REPORT_BUFFER_SIZE; i++)
-                    HIDBuffer[i + 2] = pgm_read_byte(&OUTPUT_REPORT_BUFFER[i]); // First two bytes reserved for report type and ID    
-                for (uint8_t i = 0; i < OUTPUT_REPORT_BUFFER_SIZE; i++)
-                    HIDMoveBuffer[i + 2] = 0; // First two bytes reserved for report type and ID    
-                
-                l2cap_state = L2CAP_EV_WAIT;                        
+            if (freeController() < PS3_MAX_CONTROLLERS) // A controller has disconnected, so wait for a new one
                 hci_state = HCI_SCANNING_STATE;
-            }
             break;
+            
         default:
             break;
     }
@@ -906,10 +988,16 @@ void PS3BT::ACL_event_task()
 {  
     uint16_t MAX_BUFFER_SIZE = BULK_MAXPKTSIZE;    
     uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[ BTD_DATAIN_PIPE ].epAddr, &MAX_BUFFER_SIZE, l2capinbuf); // input on endpoint 2
-    if(!rcode || rcode == hrNAK) // Check for errors
+    if(!rcode) // Check for errors - the buffer is left as it was on a NAK, so there is nothing new in it
     {    
-        if (((l2capinbuf[0] | (l2capinbuf[1] << 8)) == (hci_handle | 0x2000)))//acl_handle_ok  
+        uint8_t controller;
+        for (controller = 0; controller < PS3_MAX_CONTROLLERS; controller++) {
+            if (controllers[controller].hci_handle != -1 && (l2capinbuf[0] | (l2capinbuf[1] << 8)) == (controllers[controller].hci_handle | 0x2000))//acl_handle_ok  
+                break;
+        }
+        if (controller < PS3_MAX_CONTROLLERS)
         {
+            PS3Controller *c = &controllers[controller];
             if ((l2capinbuf[6] | (l2capinbuf[7] << 8)) == 0x0001)//l2cap_control - Channel ID for ACL-U                                
             {
                 /*
@@ -955,17 +1043,17 @@ void PS3BT::ACL_event_task()
                      */
                     if ((l2capinbuf[12] | (l2capinbuf[13] << 8)) == L2CAP_PSM_HID_CTRL)
                     {                    
-                        identifier = l2capinbuf[9];
-                        control_scid[0] = l2capinbuf[14];
-                        control_scid[1] = l2capinbuf[15];
-                        l2cap_event_flag |= L2CAP_EV_CONTROL_CONNECTION_REQUEST;
+                        c->identifier = l2capinbuf[9];
+                        c->control_scid[0] = l2capinbuf[14];
+                        c->control_scid[1] = l2capinbuf[15];
+                        c->l2cap_event_flag |= L2CAP_EV_CONTROL_CONNECTION_REQUEST;
                     }
                     else if ((l2capinbuf[12] | (l2capinbuf[13] << 8)) == L2CAP_PSM_HID_INTR)
                     {
-                        identifier = l2capinbuf[9];
-                        interrupt_scid[0] = l2capinbuf[14];
-                        interrupt_scid[1] = l2capinbuf[15];
-                        l2cap_event_flag |= L2CAP_EV_INTERRUPT_CONNECTION_REQUEST;                                        
+                        c->identifier = l2capinbuf[9];
+                        c->interrupt_scid[0] = l2capinbuf[14];
+                        c->interrupt_scid[1] = l2capinbuf[15];
+                        c->l2cap_event_flag |= L2CAP_EV_INTERRUPT_CONNECTION_REQUEST;                                        
                     }
                 }
                 else if (l2capinbuf[8] == L2CAP_CMD_CONFIG_RESPONSE)
@@ -975,7 +1063,7 @@ void PS3BT::ACL_event_task()
                         if ((l2capinbuf[16] | (l2capinbuf[17] << 8)) == 0x0000)//Success
                         {
                             //Serial.print("\r\nHID Control Configuration Complete");
-                            l2cap_event_flag |= L2CAP_EV_CONTROL_CONFIG_SUCCESS;
+                            c->l2cap_event_flag |= L2CAP_EV_CONTROL_CONFIG_SUCCESS;
                         }
                     }
                     else if (l2capinbuf[12] == interrupt_dcid[0] && l2capinbuf[13] == interrupt_dcid[1])
@@ -983,7 +1071,7 @@ void PS3BT::ACL_event_task()
                         if ((l2capinbuf[16] | (l2capinbuf[17] << 8)) == 0x0000)//Success
                         {
                             //Serial.print("\r\nHID Interrupt Configuration Complete");
-                            l2cap_event_flag |= L2CAP_EV_INTERRUPT_CONFIG_SUCCESS;
+                            c->l2cap_event_flag |= L2CAP_EV_INTERRUPT_CONFIG_SUCCESS;
                         }
                     }
                 }
@@ -992,14 +1080,14 @@ void PS3BT::ACL_event_task()
                     if (l2capinbuf[12] == control_dcid[0] && l2capinbuf[13] == control_dcid[1])
                     {
                         //Serial.print("\r\nHID Control Configuration Request");
-                        identifier = l2capinbuf[9]; 
-                        l2cap_event_flag |= L2CAP_EV_CONTROL_CONFIG_REQUEST;          
+                        c->identifier = l2capinbuf[9]; 
+                        c->l2cap_event_flag |= L2CAP_EV_CONTROL_CONFIG_REQUEST;          
                     }
                     else if (l2capinbuf[12] == interrupt_dcid[0] && l2capinbuf[13] == interrupt_dcid[1])
                     {
                         //Serial.print("\r\nHID Interrupt Configuration Request");
-                        identifier = l2capinbuf[9];
-                        l2cap_event_flag |= L2CAP_EV_INTERRUPT_CONFIG_REQUEST;          
+                        c->identifier = l2capinbuf[9];
+                        c->l2cap_event_flag |= L2CAP_EV_INTERRUPT_CONFIG_REQUEST;          
                     }
                 }                                    
                 else if (l2capinbuf[8] == L2CAP_CMD_DISCONNECT_REQUEST)
@@ -1009,213 +1097,209 @@ void PS3BT::ACL_event_task()
 #ifdef DEBUG
                         Notify(PSTR("\r\nDisconnect Request: Control Channel"));
 #endif
-                        identifier = l2capinbuf[9];
-                        l2cap_disconnection_response(identifier,control_dcid,control_scid);
+                        c->identifier = l2capinbuf[9];
+                        l2cap_disconnection_response(controller, c->identifier,control_dcid,c->control_scid);
                     }
                     else if (l2capinbuf[12] == interrupt_dcid[0] && l2capinbuf[13] == interrupt_dcid[1])  
                     {
 #ifdef DEBUG
                         Notify(PSTR("\r\nDisconnect Request: Interrupt Channel"));                
 #endif
-                        identifier = l2capinbuf[9];
-                        l2cap_disconnection_response(identifier,interrupt_dcid,interrupt_scid);
+                        c->identifier = l2capinbuf[9];
+                        l2cap_disconnection_response(controller, c->identifier,interrupt_dcid,c->interrupt_scid);
                     }
                 }
                 else if (l2capinbuf[8] == L2CAP_CMD_DISCONNECT_RESPONSE)
                 {
-                    if (l2capinbuf[12] == control_scid[0] && l2capinbuf[13] == control_scid[1])
+                    if (l2capinbuf[12] == c->control_scid[0] && l2capinbuf[13] == c->control_scid[1])
                     {                                        
                         //Serial.print("\r\nDisconnect Response: Control Channel");
-                        identifier = l2capinbuf[9];
-                        l2cap_event_flag |= L2CAP_EV_CONTROL_DISCONNECT_RESPONSE;
+                        c->identifier = l2capinbuf[9];
+                        c->l2cap_event_flag |= L2CAP_EV_CONTROL_DISCONNECT_RESPONSE;
                     }
-                    else if (l2capinbuf[12] == interrupt_scid[0] && l2capinbuf[13] == interrupt_scid[1])
+                    else if (l2capinbuf[12] == c->interrupt_scid[0] && l2capinbuf[13] == c->interrupt_scid[1])
                     {                                        
                         //Serial.print("\r\nDisconnect Response: Interrupt Channel");
-                        identifier = l2capinbuf[9];
-                        l2cap_event_flag |= L2CAP_EV_INTERRUPT_DISCONNECT_RESPONSE;                                        
+                        c->identifier = l2capinbuf[9];
+                        c->l2cap_event_flag |= L2CAP_EV_INTERRUPT_DISCONNECT_RESPONSE;                                        
                     }
                 }                                     
             }
             else if (l2capinbuf[6] == interrupt_dcid[0] && l2capinbuf[7] == interrupt_dcid[1])//l2cap_interrupt
             {                                
                 //Serial.print("\r\nL2CAP Interrupt");  
-                if(PS3Connected || PS3MoveConnected || PS3NavigationConnected)
+                if(c->connected)
                 {
-                    readReport();
+                    readReport(controller);
 #ifdef PRINTREPORT
                     printReport(); //Uncomment "#define PRINTREPORT" to print the report send by the PS3 Controllers
 #endif
                 }
             }
-            L2CAP_task();
         }        
     }
-    else {
+    else if (rcode != hrNAK) {
 #ifdef EXTRADEBUG
         Notify(PSTR("\r\nACL data in error: "));
         PrintHex<uint8_t>(rcode);
 #endif
     }
+    for (uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++) { // The timers has to run even when nothing is received
+        if (controllers[i].hci_handle != -1)
+            L2CAP_task(i);
+    }
 }
-void PS3BT::L2CAP_task()
+void PS3BT::L2CAP_task(uint8_t controller)
 {    
-    switch (l2cap_state)
+    PS3Controller *c = &controllers[controller];
+    switch (c->l2cap_state)
     {
         case L2CAP_EV_WAIT:
             break;
         case L2CAP_EV_CONTROL_SETUP:
-            if (l2cap_control_connection_request)
+            if (l2cap_control_connection_request(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nHID Control Incoming Connection Request"));
 #endif
-                l2cap_connection_response(identifier, control_dcid, control_scid, PENDING);          
+                l2cap_connection_response(controller, c->identifier, control_dcid, c->control_scid, PENDING);          
                 delay(1);
-                l2cap_connection_response(identifier, control_dcid, control_scid, SUCCESSFUL);                        
-                identifier++;
+                l2cap_connection_response(controller, c->identifier, control_dcid, c->control_scid, SUCCESSFUL);                        
+                c->identifier++;
                 delay(1);
-                l2cap_config_request(identifier, control_scid);                   
-                l2cap_state = L2CAP_EV_CONTROL_REQUEST;
+                l2cap_config_request(controller, c->identifier, c->control_scid);                   
+                c->l2cap_state = L2CAP_EV_CONTROL_REQUEST;
             }
             break;
         case L2CAP_EV_CONTROL_REQUEST:
-            if (l2cap_control_config_request)
+            if (l2cap_control_config_request(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nHID Control Configuration Request"));
 #endif
-                l2cap_config_response(identifier, control_scid);                        
-                l2cap_state = L2CAP_EV_CONTROL_SUCCESS;
+                l2cap_config_response(controller, c->identifier, c->control_scid);                        
+                c->l2cap_state = L2CAP_EV_CONTROL_SUCCESS;
             }
             break;
             
         case L2CAP_EV_CONTROL_SUCCESS:
-            if (l2cap_control_config_success)
+            if (l2cap_control_config_success(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nHID Control Successfully Configured"));
 #endif
-                l2cap_state = L2CAP_EV_INTERRUPT_SETUP;
+                c->l2cap_state = L2CAP_EV_INTERRUPT_SETUP;
             }
             break;
         case L2CAP_EV_INTERRUPT_SETUP:
-            if (l2cap_interrupt_connection_request)
+            if (l2cap_interrupt_connection_request(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nHID Interrupt Incoming Connection Request"));
 #endif
-                l2cap_connection_response(identifier, interrupt_dcid, interrupt_scid, PENDING);                        
+                l2cap_connection_response(controller, c->identifier, interrupt_dcid, c->interrupt_scid, PENDING);                        
                 delay(1);
-                l2cap_connection_response(identifier, interrupt_dcid, interrupt_scid, SUCCESSFUL);                        
-                identifier++;
+                l2cap_connection_response(controller, c->identifier, interrupt_dcid, c->interrupt_scid, SUCCESSFUL);                        
+                c->identifier++;
                 delay(1);
-                l2cap_config_request(identifier, interrupt_scid);                        
+                l2cap_config_request(controller, c->identifier, c->interrupt_scid);                        
                 
-                l2cap_state = L2CAP_EV_INTERRUPT_REQUEST;
+                c->l2cap_state = L2CAP_EV_INTERRUPT_REQUEST;
             }
             break;
         case L2CAP_EV_INTERRUPT_REQUEST:
-            if (l2cap_interrupt_config_request)
+            if (l2cap_interrupt_config_request(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nHID Interrupt Configuration Request"));
 #endif
-                l2cap_config_response(identifier, interrupt_scid);                        
-                l2cap_state = L2CAP_EV_INTERRUPT_SUCCESS;
+                l2cap_config_response(controller, c->identifier, c->interrupt_scid);                        
+                c->l2cap_state = L2CAP_EV_INTERRUPT_SUCCESS;
             }
             break;
         case L2CAP_EV_INTERRUPT_SUCCESS:
-            if (l2cap_interrupt_config_success)
+            if (l2cap_interrupt_config_success(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nHID Interrupt Successfully Configured"));
 #endif                
-                if(remote_name[0] == 'M') { // First letter in Motion Controller ('M')      
-                    for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++) // Reset l2cap in buffer as it sometimes read it as a button has been pressed
-                        l2capinbuf[i] = 0;
-                    ButtonState = 0;
-                    OldButtonState = 0;       
-                    
-                    l2cap_state = L2CAP_EV_HID_PS3_LED;
-                } else
-                    l2cap_state = L2CAP_EV_HID_ENABLE_SIXAXIS;
-                timer = millis();
+                if(c->type == MotionController)
+                    c->l2cap_state = L2CAP_EV_HID_PS3_LED;
+                else
+                    c->l2cap_state = L2CAP_EV_HID_ENABLE_SIXAXIS;
+                c->timer = millis();
             }
             break;
         case L2CAP_EV_HID_ENABLE_SIXAXIS:
-            if(millis() - timer > 1000) { // loop 1 second before sending the command
-                for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++) // Reset l2cap in buffer as it sometimes read it as a button has been pressed
-                    l2capinbuf[i] = 0;
-                ButtonState = 0;
-                OldButtonState = 0;
-                
-                enable_sixaxis();                
-                for (uint8_t i = 15; i < 19; i++)
-                    l2capinbuf[i] = 0x7F; // Set the analog joystick values to center position                    
-                l2cap_state = L2CAP_EV_HID_PS3_LED;
-                timer = millis();
+            if(millis() - c->timer > 1000) { // loop 1 second before sending the command
+                enable_sixaxis(controller);
+                c->l2cap_state = L2CAP_EV_HID_PS3_LED;
+                c->timer = millis();
             }
             break;
             
         case L2CAP_EV_HID_PS3_LED: 
-            if(millis() - timer > 1000) { // loop 1 second before sending the command
-                if (remote_name[0] == 'P') { // First letter in PLAYSTATION(R)3 Controller ('P')
-                    setLedOn(LED1);
+            if(millis() - c->timer > 1000) { // loop 1 second before sending the command
+                c->connected = true; // Reports are decoded from now on
+                if (c->type == Dualshock3) {
+                    setLedOn((LED)(1 << controller), controller); // LED1 to LED4 shows which controller it is
 #ifdef DEBUG
                     Notify(PSTR("\r\nDualshock 3 Controller Enabled\r\n"));
 #endif     
-                    PS3Connected = true;
-                } else if (remote_name[0] == 'N') { // First letter in Navigation Controller ('N')
-                    setLedOn(LED1); // This just turns LED constantly on, on the Navigation controller
+                    if (controller == 0)
+                        PS3Connected = true;
+                } else if (c->type == NavigationController) {
+                    setLedOn((LED)(1 << controller), controller); // This just turns LED constantly on, on the Navigation controller
 #ifdef DEBUG
                     Notify(PSTR("\r\nNavigation Controller Enabled\r\n"));
 #endif
-                    PS3NavigationConnected = true;
-                } else if(remote_name[0] == 'M') { // First letter in Motion Controller ('M')      
-                    moveSetBulb(Red);
-                    timerBulbRumble = millis();
+                    if (controller == 0)
+                        PS3NavigationConnected = true;
+                } else if(c->type == MotionController) {
+                    moveSetBulb(Red, controller);
+                    c->timerBulbRumble = millis();
 #ifdef DEBUG
                     Notify(PSTR("\r\nMotion Controller Enabled\r\n"));
 #endif
-                    PS3MoveConnected = true;
-                }
-                l2cap_state = L2CAP_EV_L2CAP_DONE;                                         
+                    if (controller == 0)
+                        PS3MoveConnected = true;
+                } else
+                    c->connected = false; // Not a controller we know, it just stays connected
+                c->l2cap_state = L2CAP_EV_L2CAP_DONE;                                         
             }                                    
             break;
             
         case L2CAP_EV_L2CAP_DONE:
-            if (PS3MoveConnected)//The Bulb and rumble values, has to be send at aproximatly every 5th second for it to stay on
+            if (c->connected && c->type == MotionController)//The Bulb and rumble values, has to be send at aproximatly every 5th second for it to stay on
             {
-                if (millis() - timerBulbRumble > 4000)//Send at least every 4th second
+                if (millis() - c->timerBulbRumble > 4000)//Send at least every 4th second
                 {
-                    HIDMove_Command(HIDMoveBuffer, HID_BUFFERSIZE);//The Bulb and rumble values, has to be written again and again, for it to stay turned on
-                    timerBulbRumble = millis();
+                    HIDMove_Output(controller);//The Bulb and rumble values, has to be written again and again, for it to stay turned on
+                    c->timerBulbRumble = millis();
                 }
             }
             break;
             
         case L2CAP_EV_INTERRUPT_DISCONNECT:
-            if (l2cap_interrupt_disconnect_response)
+            if (l2cap_interrupt_disconnect_response(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nDisconnected Interrupt Channel"));
 #endif
-                identifier++;
-                l2cap_disconnection_request(identifier, control_dcid, control_scid);                                                
-                l2cap_state = L2CAP_EV_CONTROL_DISCONNECT;
+                c->identifier++;
+                l2cap_disconnection_request(controller, c->identifier, control_dcid, c->control_scid);                                                
+                c->l2cap_state = L2CAP_EV_CONTROL_DISCONNECT;
             }
             break;
             
         case L2CAP_EV_CONTROL_DISCONNECT:
-            if (l2cap_control_disconnect_response)
+            if (l2cap_control_disconnect_response(c))
             {
 #ifdef DEBUG
                 Notify(PSTR("\r\nDisconnected Control Channel"));
 #endif
-                hci_disconnect();
-                l2cap_state = L2CAP_EV_L2CAP_DONE;
-                hci_state = HCI_DISCONNECT_STATE;
+                hci_disconnect(controller);
+                c->l2cap_state = L2CAP_EV_WAIT; // The controller is freed when the disconnection is complete
             }
             break;
     }
@@ -1224,24 +1308,76 @@ void PS3BT::L2CAP_task()
 /************************************************************/
 /*             HID Report (HCI ACL Packet)                  */
 /************************************************************/
-void PS3BT::readReport()
+void PS3BT::readReport(uint8_t controller)
 {                    
-    if (l2capinbuf == NULL)
-        return;
     if(l2capinbuf[8] == 0xA1)//HID_THDR_DATA_INPUT  
     {
-        if(PS3Connected || PS3NavigationConnected)
-            ButtonState = (uint32_t)(l2capinbuf[11] | ((uint16_t)l2capinbuf[12] << 8) | ((uint32_t)l2capinbuf[13] << 16));
-        else if(PS3MoveConnected)
-            ButtonState = (uint32_t)(l2capinbuf[10] | ((uint16_t)l2capinbuf[11] << 8) | ((uint32_t)l2capinbuf[12] << 16));
+        PS3Controller *c = &controllers[controller];
+        const PS3Field *field;
+        uint8_t fields;
+        if(c->type == MotionController) {
+            field = MOVE_FIELDS;
+            fields = sizeof(MOVE_FIELDS) / sizeof(PS3Field);
+        } else {
+            field = PS3_FIELDS;
+            fields = sizeof(PS3_FIELDS) / sizeof(PS3Field);
+        }
+        
+        for (; fields; fields--, field++) { // Decode the report once, the get functions only read the state
+            uint8_t* src = l2capinbuf + pgm_read_byte(&field->offset);
+            uint8_t* dst = (uint8_t*)&c->state + pgm_read_byte(&field->dest);
+            uint8_t format = pgm_read_byte(&field->format);
+            for (uint8_t i = pgm_read_byte(&field->count); i; i--) {
+                switch (format) {
+                    case PS3_FIELD_BUTTONS:
+                        *(uint32_t*)dst = (uint32_t)(src[0] | ((uint16_t)src[1] << 8) | ((uint32_t)src[2] << 16));
+                        break;
+                    case PS3_FIELD_U8:
+                        *dst = src[0];
+                        break;
+                    case PS3_FIELD_BE16:
+                        *(int16_t*)dst = (src[0] << 8) | src[1];
+                        break;
+                    case PS3_FIELD_LE16:
+                        *(int16_t*)dst = src[0] | (src[1] << 8);
+                        break;
+                    case PS3_FIELD_HI12:
+                        *(int16_t*)dst = ((src[0] & 0x0F) << 8) | src[1];
+                        break;
+                    case PS3_FIELD_LO12:
+                        *(int16_t*)dst = (src[0] << 4) | (src[1] >> 4);
+                        break;
+                }
+                if (format == PS3_FIELD_U8) {
+                    src++;
+                    dst++;
+                } else {
+                    src += 2;
+                    dst += 2;
+                }
+            }
+        }
+        
+        uint32_t changed = c->state.buttons ^ c->oldButtons;
+        if (changed) {
+            for (uint8_t i = 0; i < 24; i++) { // Queue every button that changed, they are read with getButtonEvent()
+                if (!(changed & ((uint32_t)1 << i)))
+                    continue;
+                uint8_t next = (c->eventHead + 1) & (PS3_EVENT_QUEUE_SIZE - 1);
+                if (next == c->eventTail) // The queue is full, the rest of the changes are lost
+                    break;
+                c->events[c->eventHead] = i | ((c->state.buttons & ((uint32_t)1 << i)) ? 0x80 : 0x00);
+                c->eventHead = next;
+            }
+        }
         
         //Notify(PSTR("\r\nButtonState");
-        //PrintHex<uint32_t>(ButtonState);
+        //PrintHex<uint32_t>(c->state.buttons);
         
-        if(ButtonState != OldButtonState)
+        if(controller == 0 && changed)
         {
             buttonChanged = true;            
-            if(ButtonState != 0x00) {
+            if(c->state.buttons != 0x00) {
                 buttonPressed = true; 
                 buttonReleased = false;
             } else {
@@ -1250,14 +1386,7 @@ void PS3BT::readReport()
             }
         }
         
-        else
-        {
-            buttonChanged = false;
-            buttonPressed = false;
-            buttonReleased = false;
-        }
-        
-        OldButtonState = ButtonState; 
+        c->oldButtons = c->state.buttons; 
     }
 }  
 
@@ -1360,8 +1489,9 @@ void PS3BT::hci_remote_name()
     
     HCI_Command(hcibuf, 13);
 }                
-void PS3BT::hci_disconnect()
+void PS3BT::hci_disconnect(uint8_t controller)
 {
+    int16_t hci_handle = controllers[controller].hci_handle;
     hci_event_flag &= ~HCI_FLAG_DISCONN_COMPLETE;
     hcibuf[0] = 0x06; // HCI OCF = 6
     hcibuf[1]= 0x01 << 2; // HCI OGF = 1
@@ -1375,22 +1505,19 @@ void PS3BT::hci_disconnect()
 /************************************************************/
 /*                    L2CAP Commands                        */
 /************************************************************/
-void PS3BT::L2CAP_Command(uint8_t* data, uint16_t nbytes)
+void PS3BT::L2CAP_Command(uint8_t controller, uint16_t nbytes)
 {
-    uint8_t buf[64];
-    buf[0] = (uint8_t)(hci_handle & 0xff);    // HCI handle with PB,BC flag
-    buf[1] = (uint8_t)(((hci_handle >> 8) & 0x0f) | 0x20);
-    buf[2] = (uint8_t)((4 + nbytes) & 0xff);   // HCI ACL total data length
-    buf[3] = (uint8_t)((4 + nbytes) >> 8);
-    buf[4] = (uint8_t)(nbytes & 0xff);         // L2CAP header: Length
-    buf[5] = (uint8_t)(nbytes >> 8);
-    buf[6] = 0x01;  // L2CAP header: Channel ID
-    buf[7] = 0x00;  // L2CAP Signalling channel over ACL-U logical link
+    int16_t hci_handle = controllers[controller].hci_handle;
+    l2capoutbuf[0] = (uint8_t)(hci_handle & 0xff);    // HCI handle with PB,BC flag
+    l2capoutbuf[1] = (uint8_t)(((hci_handle >> 8) & 0x0f) | 0x20);
+    l2capoutbuf[2] = (uint8_t)((4 + nbytes) & 0xff);   // HCI ACL total data length
+    l2capoutbuf[3] = (uint8_t)((4 + nbytes) >> 8);
+    l2capoutbuf[4] = (uint8_t)(nbytes & 0xff);         // L2CAP header: Length
+    l2capoutbuf[5] = (uint8_t)(nbytes >> 8);
+    l2capoutbuf[6] = 0x01;  // L2CAP header: Channel ID
+    l2capoutbuf[7] = 0x00;  // L2CAP Signalling channel over ACL-U logical link
     
-    for (uint16_t i = 0; i < nbytes; i++)//L2CAP C-frame
-        buf[8 + i] = data[i];        
-    
-    uint8_t rcode = pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), buf);
+    uint8_t rcode = pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), l2capoutbuf);
     if(rcode)
     {
 #ifdef DEBUG
@@ -1399,82 +1526,82 @@ void PS3BT::L2CAP_Command(uint8_t* data, uint16_t nbytes)
 #endif        
     }        
 }
-void PS3BT::l2cap_connection_response(uint8_t rxid, uint8_t dcid[], uint8_t scid[], uint8_t result)
+void PS3BT::l2cap_connection_response(uint8_t controller, uint8_t rxid, uint8_t dcid[], uint8_t scid[], uint8_t result)
 {            
-    l2capoutbuf[0] = L2CAP_CMD_CONNECTION_RESPONSE;// Code
-    l2capoutbuf[1] = rxid;// Identifier
-    l2capoutbuf[2] = 0x08;// Length
-    l2capoutbuf[3] = 0x00;
-    l2capoutbuf[4] = dcid[0];// Destination CID
-    l2capoutbuf[5] = dcid[1];
-    l2capoutbuf[6] = scid[0];// Source CID
-    l2capoutbuf[7] = scid[1];
-    l2capoutbuf[8] = result;// Result: Pending or Success
-    l2capoutbuf[9] = 0x00;
-    l2capoutbuf[10] = 0x00;// No further information
+    l2capoutbuf[8] = L2CAP_CMD_CONNECTION_RESPONSE;// Code
+    l2capoutbuf[9] = rxid;// Identifier
+    l2capoutbuf[10] = 0x08;// Length
     l2capoutbuf[11] = 0x00;
+    l2capoutbuf[12] = dcid[0];// Destination CID
+    l2capoutbuf[13] = dcid[1];
+    l2capoutbuf[14] = scid[0];// Source CID
+    l2capoutbuf[15] = scid[1];
+    l2capoutbuf[16] = result;// Result: Pending or Success
+    l2capoutbuf[17] = 0x00;
+    l2capoutbuf[18] = 0x00;// No further information
+    l2capoutbuf[19] = 0x00;
     
-    L2CAP_Command(l2capoutbuf, 12);            
+    L2CAP_Command(controller, 12);            
 }        
-void PS3BT::l2cap_config_request(uint8_t rxid, uint8_t dcid[])
+void PS3BT::l2cap_config_request(uint8_t controller, uint8_t rxid, uint8_t dcid[])
 {
-    l2capoutbuf[0] = L2CAP_CMD_CONFIG_REQUEST;// Code
-    l2capoutbuf[1] = rxid;// Identifier
-    l2capoutbuf[2] = 0x08;// Length
-    l2capoutbuf[3] = 0x00;
-    l2capoutbuf[4] = dcid[0];// Destination CID
-    l2capoutbuf[5] = dcid[1];
-    l2capoutbuf[6] = 0x00;// Flags
-    l2capoutbuf[7] = 0x00;
-    l2capoutbuf[8] = 0x01;// Config Opt: type = MTU (Maximum Transmission Unit) - Hint
-    l2capoutbuf[9] = 0x02;// Config Opt: length            
-    l2capoutbuf[10] = 0xFF;// MTU
-    l2capoutbuf[11] = 0xFF;
+    l2capoutbuf[8] = L2CAP_CMD_CONFIG_REQUEST;// Code
+    l2capoutbuf[9] = rxid;// Identifier
+    l2capoutbuf[10] = 0x08;// Length
+    l2capoutbuf[11] = 0x00;
+    l2capoutbuf[12] = dcid[0];// Destination CID
+    l2capoutbuf[13] = dcid[1];
+    l2capoutbuf[14] = 0x00;// Flags
+    l2capoutbuf[15] = 0x00;
+    l2capoutbuf[16] = 0x01;// Config Opt: type = MTU (Maximum Transmission Unit) - Hint
+    l2capoutbuf[17] = 0x02;// Config Opt: length            
+    l2capoutbuf[18] = 0xFF;// MTU
+    l2capoutbuf[19] = 0xFF;
     
-    L2CAP_Command(l2capoutbuf, 12);
+    L2CAP_Command(controller, 12);
 }
-void PS3BT::l2cap_config_response(uint8_t rxid, uint8_t scid[])
+void PS3BT::l2cap_config_response(uint8_t controller, uint8_t rxid, uint8_t scid[])
 {            
-    l2capoutbuf[0] = L2CAP_CMD_CONFIG_RESPONSE;// Code
-    l2capoutbuf[1] = rxid;// Identifier
-    l2capoutbuf[2] = 0x0A;// Length
-    l2capoutbuf[3] = 0x00;
-    l2capoutbuf[4] = scid[0];// Source CID
-    l2capoutbuf[5] = scid[1];
-    l2capoutbuf[6] = 0x00;// Flag
-    l2capoutbuf[7] = 0x00;
-    l2capoutbuf[8] = 0x00;// Result
-    l2capoutbuf[9] = 0x00;
-    l2capoutbuf[10] = 0x01;// Config
-    l2capoutbuf[11] = 0x02;
-    l2capoutbuf[12] = 0xA0;
-    l2capoutbuf[13] = 0x02;
+    l2capoutbuf[8] = L2CAP_CMD_CONFIG_RESPONSE;// Code
+    l2capoutbuf[9] = rxid;// Identifier
+    l2capoutbuf[10] = 0x0A;// Length
+    l2capoutbuf[11] = 0x00;
+    l2capoutbuf[12] = scid[0];// Source CID
+    l2capoutbuf[13] = scid[1];
+    l2capoutbuf[14] = 0x00;// Flag
+    l2capoutbuf[15] = 0x00;
+    l2capoutbuf[16] = 0x00;// Result
+    l2capoutbuf[17] = 0x00;
+    l2capoutbuf[18] = 0x01;// Config
+    l2capoutbuf[19] = 0x02;
+    l2capoutbuf[20] = 0xA0;
+    l2capoutbuf[21] = 0x02;
     
-    L2CAP_Command(l2capoutbuf, 14);
+    L2CAP_Command(controller, 14);
 }
-void PS3BT::l2cap_disconnection_request(uint8_t rxid, uint8_t dcid[], uint8_t scid[])
+void PS3BT::l2cap_disconnection_request(uint8_t controller, uint8_t rxid, uint8_t dcid[], uint8_t scid[])
 {
-    l2capoutbuf[0] = L2CAP_CMD_DISCONNECT_REQUEST;// Code
-    l2capoutbuf[1] = rxid;// Identifier
-    l2capoutbuf[2] = 0x04;// Length
-    l2capoutbuf[3] = 0x00;
-    l2capoutbuf[4] = scid[0];// Really Destination CID
-    l2capoutbuf[5] = scid[1];
-    l2capoutbuf[6] = dcid[0];// Really Source CID
-    l2capoutbuf[7] = dcid[1];
-    L2CAP_Command(l2capoutbuf, 8);
+    l2capoutbuf[8] = L2CAP_CMD_DISCONNECT_REQUEST;// Code
+    l2capoutbuf[9] = rxid;// Identifier
+    l2capoutbuf[10] = 0x04;// Length
+    l2capoutbuf[11] = 0x00;
+    l2capoutbuf[12] = scid[0];// Really Destination CID
+    l2capoutbuf[13] = scid[1];
+    l2capoutbuf[14] = dcid[0];// Really Source CID
+    l2capoutbuf[15] = dcid[1];
+    L2CAP_Command(controller, 8);
 }
-void PS3BT::l2cap_disconnection_response(uint8_t rxid, uint8_t dcid[], uint8_t scid[])
+void PS3BT::l2cap_disconnection_response(uint8_t controller, uint8_t rxid, uint8_t dcid[], uint8_t scid[])
 {
-    l2capoutbuf[0] = L2CAP_CMD_DISCONNECT_RESPONSE;// Code
-    l2capoutbuf[1] = rxid;// Identifier
-    l2capoutbuf[2] = 0x04;// Length
-    l2capoutbuf[3] = 0x00;
-    l2capoutbuf[4] = scid[0];// Really Destination CID
-    l2capoutbuf[5] = scid[1];
-    l2capoutbuf[6] = dcid[0];// Really Source CID
-    l2capoutbuf[7] = dcid[1];
-    L2CAP_Command(l2capoutbuf, 8);
+    l2capoutbuf[8] = L2CAP_CMD_DISCONNECT_RESPONSE;// Code
+    l2capoutbuf[9] = rxid;// Identifier
+    l2capoutbuf[10] = 0x04;// Length
+    l2capoutbuf[11] = 0x00;
+    l2capoutbuf[12] = scid[0];// Really Destination CID
+    l2capoutbuf[13] = scid[1];
+    l2capoutbuf[14] = dcid[0];// Really Source CID
+    l2capoutbuf[15] = dcid[1];
+    L2CAP_Command(controller, 8);
 }
 /*******************************************************************
  *                                                                 *
@@ -1504,46 +1631,64 @@ void PS3BT::l2cap_disconnection_response(uint8_t rxid, uint8_t dcid[], uint8_t s
 /************************************************************/
 
 //Playstation Sixaxis Dualshock and Navigation Controller commands
-void PS3BT::HID_Command(uint8_t* data, uint16_t nbytes)
+void PS3BT::HID_Command(uint8_t controller, uint16_t nbytes)
 {
-    uint8_t buf[64];
-    buf[0] = (uint8_t)(hci_handle & 0xff);    // HCI handle with PB,BC flag
-    buf[1] = (uint8_t)(((hci_handle >> 8) & 0x0f) | 0x20);
-    buf[2] = (uint8_t)((4 + nbytes) & 0xff); // HCI ACL total data length
-    buf[3] = (uint8_t)((4 + nbytes) >> 8);
-    buf[4] = (uint8_t)(nbytes & 0xff); // L2CAP header: Length
-    buf[5] = (uint8_t)(nbytes >> 8);
-    buf[6] = control_scid[0];//Both the Navigation and Dualshock controller sends data via the controller channel
-    buf[7] = control_scid[1];
-    
-    for (uint16_t i = 0; i < nbytes; i++)//L2CAP C-frame            
-        buf[8 + i] = data[i];    
+    PS3Controller *c = &controllers[controller];
+    l2capoutbuf[0] = (uint8_t)(c->hci_handle & 0xff);    // HCI handle with PB,BC flag
+    l2capoutbuf[1] = (uint8_t)(((c->hci_handle >> 8) & 0x0f) | 0x20);
+    l2capoutbuf[2] = (uint8_t)((4 + nbytes) & 0xff); // HCI ACL total data length
+    l2capoutbuf[3] = (uint8_t)((4 + nbytes) >> 8);
+    l2capoutbuf[4] = (uint8_t)(nbytes & 0xff); // L2CAP header: Length
+    l2capoutbuf[5] = (uint8_t)(nbytes >> 8);
+    l2capoutbuf[6] = c->control_scid[0];//Both the Navigation and Dualshock controller sends data via the controller channel
+    l2capoutbuf[7] = c->control_scid[1];
     
-    if (millis() - timerHID <= 250)// Check if is has been more than 250ms since last command                
-        delay((uint32_t)(250 - (millis() - timerHID)));//There have to be a delay between commands
+    if (millis() - c->timerHID <= 250)// Check if is has been more than 250ms since last command                
+        delay((uint32_t)(250 - (millis() - c->timerHID)));//There have to be a delay between commands
     
-    pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), buf);
+    pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), l2capoutbuf);
     
-    timerHID = millis();
+    c->timerHID = millis();
 }
-void PS3BT::setAllOff()
+void PS3BT::HID_Output(uint8_t controller)
 {
+    l2capoutbuf[8] = 0x52;// HID BT Set_report (0x50) | Report Type (Output 0x02)
+    l2capoutbuf[9] = 0x01;// Report ID
     for (uint8_t i = 0; i < OUTPUT_REPORT_BUFFER_SIZE; i++)
-        HIDBuffer[i + 2] = pgm_read_byte(&OUTPUT_REPORT_BUFFER[i]);//First two bytes reserved for report type and ID
+        l2capoutbuf[i + 10] = pgm_read_byte(&OUTPUT_REPORT_BUFFER[i]);
+    
+    for (uint8_t i = 0; i < 4; i++)
+        l2capoutbuf[i + 11] = controllers[controller].output[i];//Rumble
+    l2capoutbuf[19] = controllers[controller].output[4];//LEDs
     
-    HID_Command(HIDBuffer, HID_BUFFERSIZE);
+    HID_Command(controller, HID_BUFFERSIZE);
 }
-void PS3BT::setRumbleOff()
+void PS3BT::setAllOff(uint8_t controller)
 {
-    HIDBuffer[3] = 0x00;
-    HIDBuffer[4] = 0x00;//low mode off
-    HIDBuffer[5] = 0x00;
-    HIDBuffer[6] = 0x00;//high mode off
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    for (uint8_t i = 0; i < sizeof(controllers[controller].output); i++)
+        controllers[controller].output[i] = 0;
     
-    HID_Command(HIDBuffer, HID_BUFFERSIZE);
+    HID_Output(controller);
 }
-void PS3BT::setRumbleOn(Rumble mode)
+void PS3BT::setRumbleOff(uint8_t controller)
 {
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    uint8_t* output = controllers[controller].output;
+    output[0] = 0x00;
+    output[1] = 0x00;//low mode off
+    output[2] = 0x00;
+    output[3] = 0x00;//high mode off
+    
+    HID_Output(controller);
+}
+void PS3BT::setRumbleOn(Rumble mode, uint8_t controller)
+{
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    uint8_t* output = controllers[controller].output;
     /* Still not totally sure how it works, maybe something like this instead?
      * 3 - duration_right
      * 4 - power_right
@@ -1552,95 +1697,115 @@ void PS3BT::setRumbleOn(Rumble mode)
      */
     if ((mode & 0x30) > 0)
     {
-        HIDBuffer[3] = 0xfe;
-        HIDBuffer[5] = 0xfe;
+        output[0] = 0xfe;
+        output[2] = 0xfe;
         
         if (mode == RumbleHigh)
         {
-            HIDBuffer[4] = 0;//low mode off
-            HIDBuffer[6] = 0xff;//high mode on
+            output[1] = 0;//low mode off
+            output[3] = 0xff;//high mode on
         }
         else
         {
-            HIDBuffer[4] = 0xff;//low mode on
-            HIDBuffer[6] = 0;//high mode off
+            output[1] = 0xff;//low mode on
+            output[3] = 0;//high mode off
         }
         
-        HID_Command(HIDBuffer, HID_BUFFERSIZE);
+        HID_Output(controller);
     }
 }
-void PS3BT::setLedOff(LED a)
+void PS3BT::setLedOff(LED a, uint8_t controller)
 {
-    HIDBuffer[11] &= ~((uint8_t)(((uint16_t)a & 0x0f) << 1));    
-    HID_Command(HIDBuffer, HID_BUFFERSIZE);               
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    controllers[controller].output[4] &= ~((uint8_t)(((uint16_t)a & 0x0f) << 1));    
+    HID_Output(controller);
 }
-void PS3BT::setLedOn(LED a)
+void PS3BT::setLedOn(LED a, uint8_t controller)
 {
-    HIDBuffer[11] |= (uint8_t)(((uint16_t)a & 0x0f) << 1);    
-    HID_Command(HIDBuffer, HID_BUFFERSIZE);            
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    controllers[controller].output[4] |= (uint8_t)(((uint16_t)a & 0x0f) << 1);    
+    HID_Output(controller);
 }
-void PS3BT::setLedToggle(LED a)
+void PS3BT::setLedToggle(LED a, uint8_t controller)
 {
-    HIDBuffer[11] ^= (uint8_t)(((uint16_t)a & 0x0f) << 1);    
-    HID_Command(HIDBuffer, HID_BUFFERSIZE);            
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
+    controllers[controller].output[4] ^= (uint8_t)(((uint16_t)a & 0x0f) << 1);    
+    HID_Output(controller);
 }
-void PS3BT::enable_sixaxis()//Command used to enable the Dualshock 3 and Navigation controller to send data via USB
+void PS3BT::enable_sixaxis(uint8_t controller)//Command used to enable the Dualshock 3 and Navigation controller to send data via USB
 {
-    uint8_t cmd_buf[6];
-    cmd_buf[0] = 0x53;// HID BT Set_report (0x50) | Report Type (Feature 0x03)
-    cmd_buf[1] = 0xF4;// Report ID
-    cmd_buf[2] = 0x42;// Special PS3 Controller enable commands
-    cmd_buf[3] = 0x03;
-    cmd_buf[4] = 0x00;
-    cmd_buf[5] = 0x00;
+    l2capoutbuf[8] = 0x53;// HID BT Set_report (0x50) | Report Type (Feature 0x03)
+    l2capoutbuf[9] = 0xF4;// Report ID
+    l2capoutbuf[10] = 0x42;// Special PS3 Controller enable commands
+    l2capoutbuf[11] = 0x03;
+    l2capoutbuf[12] = 0x00;
+    l2capoutbuf[13] = 0x00;
     
-    HID_Command(cmd_buf, 6);
+    HID_Command(controller, 6);
 }
 
 //Playstation Move Controller commands
-void PS3BT::HIDMove_Command(uint8_t* data,uint16_t nbytes)
+void PS3BT::HIDMove_Command(uint8_t controller, uint16_t nbytes)
 {
-    uint8_t buf[64];
-    buf[0] = (uint8_t)(hci_handle & 0xff);    // HCI handle with PB,BC flag
-    buf[1] = (uint8_t)(((hci_handle >> 8) & 0x0f) | 0x20);
-    buf[2] = (uint8_t)((4 + nbytes) & 0xff); // HCI ACL total data length
-    buf[3] = (uint8_t)((4 + nbytes) >> 8);
-    buf[4] = (uint8_t)(nbytes & 0xff); // L2CAP header: Length
-    buf[5] = (uint8_t)(nbytes >> 8);
-    buf[6] = interrupt_scid[0];//The Move controller sends it's data via the intterrupt channel
-    buf[7] = interrupt_scid[1];
+    PS3Controller *c = &controllers[controller];
+    l2capoutbuf[0] = (uint8_t)(c->hci_handle & 0xff);    // HCI handle with PB,BC flag
+    l2capoutbuf[1] = (uint8_t)(((c->hci_handle >> 8) & 0x0f) | 0x20);
+    l2capoutbuf[2] = (uint8_t)((4 + nbytes) & 0xff); // HCI ACL total data length
+    l2capoutbuf[3] = (uint8_t)((4 + nbytes) >> 8);
+    l2capoutbuf[4] = (uint8_t)(nbytes & 0xff); // L2CAP header: Length
+    l2capoutbuf[5] = (uint8_t)(nbytes >> 8);
+    l2capoutbuf[6] = c->interrupt_scid[0];//The Move controller sends it's data via the intterrupt channel
+    l2capoutbuf[7] = c->interrupt_scid[1];
     
-    for (uint16_t i = 0; i < nbytes; i++)//L2CAP C-frame            
-        buf[8 + i] = data[i];    
+    if (millis() - c->timerHID <= 250)// Check if is has been less than 200ms since last command                            
+        delay((uint32_t)(250 - (millis() - c->timerHID)));//There have to be a delay between commands
     
-    if (millis() - timerHID <= 250)// Check if is has been less than 200ms since last command                            
-        delay((uint32_t)(250 - (millis() - timerHID)));//There have to be a delay between commands
+    pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), l2capoutbuf);
     
-    pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), buf);
+    c->timerHID = millis();
+}
+void PS3BT::HIDMove_Output(uint8_t controller)
+{
+    l2capoutbuf[8] = 0xA2;// HID BT DATA_request (0xA0) | Report Type (Output 0x02)            
+    l2capoutbuf[9] = 0x02;// Report ID
+    for (uint8_t i = 10; i < 8 + HID_BUFFERSIZE; i++)
+        l2capoutbuf[i] = 0;
     
-    timerHID = millis();
+    l2capoutbuf[11] = controllers[controller].output[0];//Bulb
+    l2capoutbuf[12] = controllers[controller].output[1];
+    l2capoutbuf[13] = controllers[controller].output[2];
+    l2capoutbuf[15] = controllers[controller].output[3];//Rumble
+    
+    HIDMove_Command(controller, HID_BUFFERSIZE);
 }
-void PS3BT::moveSetBulb(uint8_t r, uint8_t g, uint8_t b)//Use this to set the Color using RGB values
+void PS3BT::moveSetBulb(uint8_t r, uint8_t g, uint8_t b, uint8_t controller)//Use this to set the Color using RGB values
 {            
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
     //set the Bulb's values into the write buffer            
-    HIDMoveBuffer[3] = r;
-    HIDMoveBuffer[4] = g;
-    HIDMoveBuffer[5] = b;
+    controllers[controller].output[0] = r;
+    controllers[controller].output[1] = g;
+    controllers[controller].output[2] = b;
     
-    HIDMove_Command(HIDMoveBuffer, HID_BUFFERSIZE);   
+    HIDMove_Output(controller);
 }
-void PS3BT::moveSetBulb(Colors color)//Use this to set the Color using the predefined colors in "enums.h"
+void PS3BT::moveSetBulb(Colors color, uint8_t controller)//Use this to set the Color using the predefined colors in "enums.h"
 {
-    moveSetBulb((uint8_t)(color >> 16),(uint8_t)(color >> 8),(uint8_t)(color));
+    moveSetBulb((uint8_t)(color >> 16),(uint8_t)(color >> 8),(uint8_t)(color), controller);
 }
-void PS3BT::moveSetRumble(uint8_t rumble)
+void PS3BT::moveSetRumble(uint8_t rumble, uint8_t controller)
 {
+    if (controller >= PS3_MAX_CONTROLLERS || controllers[controller].hci_handle == -1)
+        return;
 #ifdef DEBUG
     if(rumble < 64 && rumble != 0) // The rumble value has to at least 64, or approximately 25% (64/255*100)
         Notify(PSTR("\r\nThe rumble value has to at least 64, or approximately 25%"));
 #endif
     //set the rumble value into the write buffer
-    HIDMoveBuffer[7] = rumble;
+    controllers[controller].output[3] = rumble;
     
-    HIDMove_Command(HIDMoveBuffer, HID_BUFFERSIZE);            
+    HIDMove_Output(controller);
 }
\ No newline at end of file
@@ -51,6 +51,9 @@
 #define HID_BUFFERSIZE              50 // size of the buffer for the Playstation Motion Controller
 #define OUTPUT_REPORT_BUFFER_SIZE   48 //Size of the output report buffer for the controllers
 
+#define PS3_MAX_CONTROLLERS     4 // Controllers that can be connected to the dongle at the same time - each one uses about 90 bytes of RAM
+#define PS3_EVENT_QUEUE_SIZE    8 // Button changes kept for each controller until they are read - has to be a power of two
+
 // used in control endpoint header for HCI Commands
 #define bmREQ_HCI_OUT USB_SETUP_HOST_TO_DEVICE|USB_SETUP_TYPE_CLASS|USB_SETUP_RECIPIENT_DEVICE
 
@@ -69,7 +72,6 @@
 #define HCI_CONNECTED_STATE     7
 #define HCI_DISABLE_SCAN        8
 #define HCI_DONE_STATE          9
-#define HCI_DISCONNECT_STATE    10
 
 /* HCI event flags*/
 #define HCI_FLAG_CMD_COMPLETE           0x01
@@ -130,15 +132,15 @@
 #define L2CAP_EV_CONTROL_DISCONNECT_RESPONSE    0x40
 #define L2CAP_EV_INTERRUPT_DISCONNECT_RESPONSE  0x80
 
-/*Macros for L2CAP event flag tests */
-#define l2cap_control_connection_request (l2cap_event_flag & L2CAP_EV_CONTROL_CONNECTION_REQUEST)
-#define l2cap_control_config_request (l2cap_event_flag & L2CAP_EV_CONTROL_CONFIG_REQUEST)
-#define l2cap_control_config_success (l2cap_event_flag & L2CAP_EV_CONTROL_CONFIG_SUCCESS)
-#define l2cap_interrupt_connection_request (l2cap_event_flag & L2CAP_EV_INTERRUPT_CONNECTION_REQUEST)
-#define l2cap_interrupt_config_request (l2cap_event_flag & L2CAP_EV_INTERRUPT_CONFIG_REQUEST)
-#define l2cap_interrupt_config_success (l2cap_event_flag & L2CAP_EV_INTERRUPT_CONFIG_SUCCESS)
-#define l2cap_control_disconnect_response (l2cap_event_flag & L2CAP_EV_CONTROL_DISCONNECT_RESPONSE)
-#define l2cap_interrupt_disconnect_response (l2cap_event_flag & L2CAP_EV_INTERRUPT_DISCONNECT_RESPONSE)
+/*Macros for L2CAP event flag tests - every controller has its own flags */
+#define l2cap_control_connection_request(c) ((c)->l2cap_event_flag & L2CAP_EV_CONTROL_CONNECTION_REQUEST)
+#define l2cap_control_config_request(c) ((c)->l2cap_event_flag & L2CAP_EV_CONTROL_CONFIG_REQUEST)
+#define l2cap_control_config_success(c) ((c)->l2cap_event_flag & L2CAP_EV_CONTROL_CONFIG_SUCCESS)
+#define l2cap_interrupt_connection_request(c) ((c)->l2cap_event_flag & L2CAP_EV_INTERRUPT_CONNECTION_REQUEST)
+#define l2cap_interrupt_config_request(c) ((c)->l2cap_event_flag & L2CAP_EV_INTERRUPT_CONFIG_REQUEST)
+#define l2cap_interrupt_config_success(c) ((c)->l2cap_event_flag & L2CAP_EV_INTERRUPT_CONFIG_SUCCESS)
+#define l2cap_control_disconnect_response(c) ((c)->l2cap_event_flag & L2CAP_EV_CONTROL_DISCONNECT_RESPONSE)
+#define l2cap_interrupt_disconnect_response(c) ((c)->l2cap_event_flag & L2CAP_EV_INTERRUPT_DISCONNECT_RESPONSE)
 
 /* L2CAP signaling commands */
 #define L2CAP_CMD_COMMAND_REJECT        0x01
@@ -324,6 +326,48 @@ enum Rumble
     RumbleHigh = 0x10,
     RumbleLow = 0x20,            
 };
+enum ControllerType
+{
+    NoController = 0,
+    Dualshock3 = 'P', // First letter of the remote name: PLAYSTATION(R)3 Controller
+    NavigationController = 'N', // Navigation Controller
+    MotionController = 'M', // Motion Controller
+};
+
+/* Every report is decoded into this when it arrives, the get functions only read it */
+struct PS3State
+{
+    uint32_t buttons; // The three button bytes - the Move controller's are moved one byte, so enum Button works for all controllers
+    uint8_t hat[4]; // LeftHatX, LeftHatY, RightHatX, RightHatY
+    uint8_t analogButton[13]; // UP_ANALOG to SQUARE_ANALOG, then T_ANALOG
+    uint8_t status[3]; // Plugged, battery and connection status - the Move controller only has the battery
+    int16_t sensor[10]; // Same order as enum Sensor for the type of controller
+};
+
+/* Everything kept for each connected controller */
+struct PS3Controller
+{
+    int16_t hci_handle; // -1 when nothing is connected
+    uint8_t type; // ControllerType, known from the remote name
+    bool connected; // true when the controller is set up and sending reports
+    
+    uint8_t l2cap_state;
+    uint16_t l2cap_event_flag;// l2cap flags of received bluetooth events
+    uint8_t identifier;//Identifier for connection
+    uint8_t control_scid[2];// L2CAP source CID for HID_Control
+    uint8_t interrupt_scid[2];// L2CAP source CID for HID_Interrupt
+    
+    unsigned long timer;
+    uint32_t timerHID;// timer used see if there has to be a delay before a new HID command
+    uint32_t timerBulbRumble;// used to continuously set PS3 Move controller Bulb and rumble values
+    uint8_t output[5];// Rumble and LEDs for the Dualshock 3 - Bulb and rumble for the Move controller
+    
+    PS3State state;
+    uint32_t oldButtons;
+    uint8_t events[PS3_EVENT_QUEUE_SIZE];// Button number, 0x80 is set when it was pressed
+    uint8_t eventHead;
+    uint8_t eventTail;
+};
 
 class PS3BT : public USBDeviceConfig, public UsbConfigXtracter
 {
@@ -345,30 +389,34 @@ public:
     void setBdaddr(uint8_t* BDADDR);
     void setMoveBdaddr(uint8_t* BDADDR);
     
-    /* PS3 Controller Commands */
-    bool getButton(Button b);
-    uint8_t getAnalogButton(AnalogButton a);
-    uint8_t getAnalogHat(AnalogHat a);
-    int16_t getSensor(Sensor a);
-    double getAngle(Angle a);
-    bool getStatus(Status c);  
-    String getStatusString();    
-    String getTemperature();
-    void disconnect(); // use this void to disconnect any of the controllers
+    /* PS3 Controller Commands - controller is the slot 0 to PS3_MAX_CONTROLLERS-1 the controller got when it connected.
+     * A slot freed by a disconnect goes to the next controller that connects. Commands to an empty slot are ignored */
+    bool getButton(Button b, uint8_t controller = 0);
+    uint8_t getAnalogButton(AnalogButton a, uint8_t controller = 0);
+    uint8_t getAnalogHat(AnalogHat a, uint8_t controller = 0);
+    int16_t getSensor(Sensor a, uint8_t controller = 0);
+    double getAngle(Angle a, uint8_t controller = 0);
+    bool getStatus(Status c, uint8_t controller = 0);
+    String getStatusString(uint8_t controller = 0);
+    String getTemperature(uint8_t controller = 0);
+    bool getButtonEvent(Button *b, bool *pressed, uint8_t controller = 0); // Oldest button change that hasn't been read - returns false if there is none
+    ControllerType getControllerType(uint8_t controller = 0); // NoController until it is set up
+    void disconnect(uint8_t controller = 0); // use this void to disconnect any of the controllers
     
     /* HID Commands */
     /* Commands for Dualshock 3 and Navigation controller */    
-    void setAllOff();
-    void setRumbleOff();
-    void setRumbleOn(Rumble mode);
-    void setLedOff(LED a);
-    void setLedOn(LED a);    
-    void setLedToggle(LED a);
+    void setAllOff(uint8_t controller = 0);
+    void setRumbleOff(uint8_t controller = 0);
+    void setRumbleOn(Rumble mode, uint8_t controller = 0);
+    void setLedOff(LED a, uint8_t controller = 0);
+    void setLedOn(LED a, uint8_t controller = 0);
+    void setLedToggle(LED a, uint8_t controller = 0);
     /* Commands for Motion controller only */    
-    void moveSetBulb(uint8_t r, uint8_t g, uint8_t b);//Use this to set the Color using RGB values
-    void moveSetBulb(Colors color);//Use this to set the Color using the predefined colors in "enum Colors"
-    void moveSetRumble(uint8_t rumble);
+    void moveSetBulb(uint8_t r, uint8_t g, uint8_t b, uint8_t controller = 0);//Use this to set the Color using RGB values
+    void moveSetBulb(Colors color, uint8_t controller = 0);//Use this to set the Color using the predefined colors in "enum Colors"
+    void moveSetRumble(uint8_t rumble, uint8_t controller = 0);
     
+    /* These are all for the first controller, use getControllerType() and getButtonEvent() for the others */
     bool PS3Connected;// Variable used to indicate if the normal playstation controller is successfully connected
     bool PS3MoveConnected;// Variable used to indicate if the move controller is successfully connected
     bool PS3NavigationConnected;// Variable used to indicate if the navigation controller is successfully connected
@@ -399,7 +447,6 @@ private:
     bool watingForConnection;
     
     /*variables filled from HCI event management */
-    int16_t hci_handle;
     uint8_t disc_bdaddr[6]; // the bluetooth address is always 6 bytes
     uint8_t remote_name[30]; // first 30 chars of remote name
     uint8_t hci_version;
@@ -409,39 +456,29 @@ private:
     uint16_t hci_counter; // counter used for bluetooth hci reset loops
     uint8_t hci_num_reset_loops; // this value indicate how many times it should read before trying to reset
     uint16_t hci_event_flag;// hci flags of received bluetooth events        
+    uint8_t hci_new_controller;// the controller that is being connected
     
-    /* variables used by high level L2CAP task */    
-    uint8_t l2cap_state;
-    uint16_t l2cap_event_flag;// l2cap flags of received bluetooth events
-    
-    unsigned long timer;
-    
-    uint32_t ButtonState;
-    uint32_t OldButtonState;
-    uint32_t timerHID;// timer used see if there has to be a delay before a new HID command
-    uint32_t timerBulbRumble;// used to continuously set PS3 Move controller Bulb and rumble values
+    PS3Controller controllers[PS3_MAX_CONTROLLERS];
     
     uint8_t my_bdaddr[6]; // Change to your dongles Bluetooth address in the constructor
+    /* All the controllers share these, the ACL packets are read and written in place */
     uint8_t hcibuf[BULK_MAXPKTSIZE];//General purpose buffer for hci data
     uint8_t l2capinbuf[BULK_MAXPKTSIZE];//General purpose buffer for l2cap in data
-    uint8_t l2capoutbuf[BULK_MAXPKTSIZE];//General purpose buffer for l2cap out data
-    uint8_t HIDBuffer[HID_BUFFERSIZE];// Used to store HID commands
-    uint8_t HIDMoveBuffer[HID_BUFFERSIZE];// Used to store HID commands for the Move controller   
+    uint8_t l2capoutbuf[BULK_MAXPKTSIZE];//ACL packet that is being sent - the commands are written after the 8 header bytes
     
-    /* L2CAP Channels */
-    uint8_t control_scid[2];// L2CAP source CID for HID_Control                
+    /* L2CAP Channels - the same for every controller, as they are each on their own ACL link */
     uint8_t control_dcid[2];//0x0040        
-    uint8_t interrupt_scid[2];// L2CAP source CID for HID_Interrupt        
     uint8_t interrupt_dcid[2];//0x0041
-    uint8_t identifier;//Identifier for connection   
     
     void HCI_event_task(); //poll the HCI event pipe
     void HCI_task(); // HCI state machine
     void ACL_event_task(); // start polling the ACL input pipe too, though discard data until connected
-    void L2CAP_task(); // L2CAP state machine
+    void L2CAP_task(uint8_t controller); // L2CAP state machine
     
-    void readReport(); // read incoming data
+    void readReport(uint8_t controller); // read incoming data
     void printReport(); // print incoming date - Uncomment for debugging    
+    void resetController(uint8_t controller);
+    uint8_t freeController(); // returns PS3_MAX_CONTROLLERS if they are all in use
     
     /* HCI Commands */
     void HCI_Command(uint8_t* data, uint16_t nbytes);
@@ -452,19 +489,21 @@ private:
     void hci_read_local_version_information();
     void hci_accept_connection();
     void hci_remote_name();
-    void hci_disconnect();
-    
-    /* L2CAP Commands */
-    void L2CAP_Command(uint8_t* data, uint16_t nbytes);
-    void l2cap_connection_response(uint8_t rxid, uint8_t dcid[], uint8_t scid[], uint8_t result);
-    void l2cap_config_request(uint8_t rxid, uint8_t dcid[]);
-    void l2cap_config_response(uint8_t rxid, uint8_t scid[]);
-    void l2cap_disconnection_request(uint8_t rxid, uint8_t dcid[], uint8_t scid[]);
-    void l2cap_disconnection_response(uint8_t rxid, uint8_t dcid[], uint8_t scid[]);    
-    
-    /* HID Commands */
-    void HID_Command(uint8_t* data, uint16_t nbytes);
-    void HIDMove_Command(uint8_t* data, uint16_t nbytes);
-    void enable_sixaxis();//Command used to enable the Dualshock 3 and Navigation controller to send data via USB
+    void hci_disconnect(uint8_t controller);
+    
+    /* L2CAP Commands - the command is in l2capoutbuf after the header */
+    void L2CAP_Command(uint8_t controller, uint16_t nbytes);
+    void l2cap_connection_response(uint8_t controller, uint8_t rxid, uint8_t dcid[], uint8_t scid[], uint8_t result);
+    void l2cap_config_request(uint8_t controller, uint8_t rxid, uint8_t dcid[]);
+    void l2cap_config_response(uint8_t controller, uint8_t rxid, uint8_t scid[]);
+    void l2cap_disconnection_request(uint8_t controller, uint8_t rxid, uint8_t dcid[], uint8_t scid[]);
+    void l2cap_disconnection_response(uint8_t controller, uint8_t rxid, uint8_t dcid[], uint8_t scid[]);
+    
+    /* HID Commands - the report is in l2capoutbuf after the header */
+    void HID_Command(uint8_t controller, uint16_t nbytes);
+    void HIDMove_Command(uint8_t controller, uint16_t nbytes);
+    void HID_Output(uint8_t controller);//Sends the rumble and LED values
+    void HIDMove_Output(uint8_t controller);//Sends the bulb and rumble values
+    void enable_sixaxis(uint8_t controller);//Command used to enable the Dualshock 3 and Navigation controller to send data via USB
 };
 #endif
\ No newline at end of file
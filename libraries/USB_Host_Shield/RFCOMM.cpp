@@ -16,6 +16,7 @@
  */
 
 #include "RFCOMM.h"
+#include <CRC.h>
 #define DEBUG // Uncomment to print data for debugging
 //#define EXTRADEBUG // Uncomment to get even more debugging data
 //#define PRINTREPORT // Uncomment to print the report sent to the Arduino
@@ -24,28 +25,6 @@ const uint8_t RFCOMM::BTD_EVENT_PIPE  = 1;
 const uint8_t RFCOMM::BTD_DATAIN_PIPE = 2;
 const uint8_t RFCOMM::BTD_DATAOUT_PIPE = 3;
 
-/*  
- * CRC (reversed crc) lookup table as calculated by the table generator in ETSI TS 101 369 V6.3.0.
- */
-const uint8_t rfcomm_crc_table[256] PROGMEM = {    /* reversed, 8-bit, poly=0x07 */
-    0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75, 0x0E, 0x9F, 0xED, 0x7C, 0x09, 0x98, 0xEA, 0x7B,
-    0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A, 0xF8, 0x69, 0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67,
-    0x38, 0xA9, 0xDB, 0x4A, 0x3F, 0xAE, 0xDC, 0x4D, 0x36, 0xA7, 0xD5, 0x44, 0x31, 0xA0, 0xD2, 0x43,
-    0x24, 0xB5, 0xC7, 0x56, 0x23, 0xB2, 0xC0, 0x51, 0x2A, 0xBB, 0xC9, 0x58, 0x2D, 0xBC, 0xCE, 0x5F,
-    0x70, 0xE1, 0x93, 0x02, 0x77, 0xE6, 0x94, 0x05, 0x7E, 0xEF, 0x9D, 0x0C, 0x79, 0xE8, 0x9A, 0x0B,
-    0x6C, 0xFD, 0x8F, 0x1E, 0x6B, 0xFA, 0x88, 0x19, 0x62, 0xF3, 0x81, 0x10, 0x65, 0xF4, 0x86, 0x17,
-    0x48, 0xD9, 0xAB, 0x3A, 0x4F, 0xDE, 0xAC, 0x3D, 0x46, 0xD7, 0xA5, 0x34, 0x41, 0xD0, 0xA2, 0x33,
-    0x54, 0xC5, 0xB7, 0x26, 0x53, 0xC2, 0xB0, 0x21, 0x5A, 0xCB, 0xB9, 0x28, 0x5D, 0xCC, 0xBE, 0x2F,
-    0xE0, 0x71, 0x03, 0x92, 0xE7, 0x76, 0x04, 0x95, 0xEE, 0x7F, 0x0D, 0x9C, 0xE9, 0x78, 0x0A, 0x9B,
-    0xFC, 0x6D, 0x1F, 0x8E, 0xFB, 0x6A, 0x18, 0x89, 0xF2, 0x63, 0x11, 0x80, 0xF5, 0x64, 0x16, 0x87,
-    0xD8, 0x49, 0x3B, 0xAA, 0xDF, 0x4E, 0x3C, 0xAD, 0xD6, 0x47, 0x35, 0xA4, 0xD1, 0x40, 0x32, 0xA3,
-    0xC4, 0x55, 0x27, 0xB6, 0xC3, 0x52, 0x20, 0xB1, 0xCA, 0x5B, 0x29, 0xB8, 0xCD, 0x5C, 0x2E, 0xBF,
-    0x90, 0x01, 0x73, 0xE2, 0x97, 0x06, 0x74, 0xE5, 0x9E, 0x0F, 0x7D, 0xEC, 0x99, 0x08, 0x7A, 0xEB,
-    0x8C, 0x1D, 0x6F, 0xFE, 0x8B, 0x1A, 0x68, 0xF9, 0x82, 0x13, 0x61, 0xF0, 0x85, 0x14, 0x66, 0xF7,
-    0xA8, 0x39, 0x4B, 0xDA, 0xAF, 0x3E, 0x4C, 0xDD, 0xA6, 0x37, 0x45, 0xD4, 0xA1, 0x30, 0x42, 0xD3,
-    0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50, 0xC1, 0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF
-};
-
 RFCOMM::RFCOMM(USB *p, const char* name, const char* pin):
 pUsb(p), // pointer to USB class instance - mandatory
 bAddress(0), // device address - mandatory
@@ -60,6 +39,7 @@ bPollEnable(false) // don't start polling before dongle is connected
 		epInfo[i].epAttribs		= 0;        
         epInfo[i].bmNakPower    = (i) ? USB_NAK_NOWAIT : USB_NAK_MAX_POWER;
 	}
+    epInfo[BTD_DATAOUT_PIPE].bmNakPower = USB_NAK_DEFAULT; // The dongle NAKs while its ACL buffers are full, a frame must not be cut off then
     
     if (pUsb) // register in USB subsystem
 		pUsb->RegisterDeviceClass(this); //set devConfig[] entry
@@ -590,7 +570,7 @@ void RFCOMM::HCI_task() {
                 //Reset all buffers                        
                 for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++)
                     hcibuf[i] = 0;        
-                for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++)
+                for (uint16_t i = 0; i < RFCOMM_ACL_BUFFER_SIZE; i++)
                     l2capinbuf[i] = 0;
                 for (uint8_t i = 0; i < BULK_MAXPKTSIZE; i++)
                     l2capoutbuf[i] = 0;
@@ -609,7 +589,7 @@ void RFCOMM::HCI_task() {
 
 void RFCOMM::ACL_event_task()
 {
-    uint16_t MAX_BUFFER_SIZE = BULK_MAXPKTSIZE;    
+    uint16_t MAX_BUFFER_SIZE = RFCOMM_ACL_BUFFER_SIZE; // A frame longer than the endpoint size comes in several packets, the inTransfer routine will take care of this
     uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[ BTD_DATAIN_PIPE ].epAddr, &MAX_BUFFER_SIZE, l2capinbuf); // input on endpoint 2
     if(!rcode) { // Check for errors
         if (((l2capinbuf[0] | (l2capinbuf[1] << 8)) == (hci_handle | 0x2000))) { //acl_handle_ok  
@@ -806,16 +786,22 @@ void RFCOMM::ACL_event_task()
 #ifdef DEBUG
                         Notify(PSTR("\r\nReceived UIH Parameter Negotiation Command"));                      
 #endif
+                        rfcommCreditFlow = (l2capinbuf[14] == 0xF0); // The remote device asks for credit based flow control
+                        rfcommFrameSize = l2capinbuf[17] | (l2capinbuf[18] << 8); // Use the frame size it proposes if we can receive frames that large
+                        if(rfcommFrameSize > RFCOMM_MAX_FRAME_SIZE || rfcommFrameSize == 0)
+                            rfcommFrameSize = RFCOMM_MAX_FRAME_SIZE;
+                        rfcommCredit = l2capinbuf[20] & 0x07; // The initial credit it gives us
+                        
                         rfcommbuf[0] = BT_RFCOMM_PN_RSP; // UIH Parameter Negotiation Response
                         rfcommbuf[1] = l2capinbuf[12]; // Length and shiftet like so: length << 1 | 1
                         rfcommbuf[2] = l2capinbuf[13]; // Channel: channel << 1 | 1
-                        rfcommbuf[3] = 0xE0; // Pre difined for Bluetooth, see 5.5.3 of TS 07.10 Adaption for RFCOMM
+                        rfcommbuf[3] = rfcommCreditFlow ? 0xE0 : 0x00; // Pre difined for Bluetooth, see 5.5.3 of TS 07.10 Adaption for RFCOMM
                         rfcommbuf[4] = 0x00; // Priority
                         rfcommbuf[5] = 0x00; // Timer                           
-                        rfcommbuf[6] = 0x40; // Max Fram Size LSB - we will just set this to 64
-                        rfcommbuf[7] = 0x00; // Max Fram Size MSB                            
+                        rfcommbuf[6] = rfcommFrameSize & 0xFF; // Max Fram Size LSB
+                        rfcommbuf[7] = rfcommFrameSize >> 8; // Max Fram Size MSB                            
                         rfcommbuf[8] = 0x00; // MaxRatransm.
-                        rfcommbuf[9] = 0x00; // Number of Frames                    
+                        rfcommbuf[9] = 0x00; // Number of Frames - the credit is sent when the Modem Status Response is received
                         sendRfcomm(rfcommChannel,rfcommDirection,0,RFCOMM_UIH,rfcommPfBit,rfcommbuf,0x0A);                        
                     } else if(rfcommChannelType == RFCOMM_UIH && l2capinbuf[11] == BT_RFCOMM_MSC_CMD) { // UIH Modem Status Command
 #ifdef DEBUG
@@ -839,10 +825,14 @@ void RFCOMM::ACL_event_task()
                         sendRfcomm(rfcommChannel,rfcommDirection,0,RFCOMM_UIH,rfcommPfBit,rfcommbuf,0x04);
                     } else if(rfcommChannelType == RFCOMM_UIH && l2capinbuf[11] == BT_RFCOMM_MSC_RSP) { // UIH Modem Status Response
                         if(!creditSent) {
+                            if(rfcommCreditFlow) {
 #ifdef DEBUG
-                            Notify(PSTR("\r\nSend UIH Command with credit"));   
+                                Notify(PSTR("\r\nSend UIH Command with credit"));   
 #endif
-                            sendRfcommCredit(rfcommChannelPermanent,rfcommDirection,0,RFCOMM_UIH,0x10,0xFF); // 255 credit
+                                uint8_t credit = calcCredit();
+                                sendRfcommCredit(rfcommChannelPermanent,rfcommDirection,0,RFCOMM_UIH,0x10,credit); // As many frames as the buffer can hold
+                                rfcommCreditGiven += credit;
+                            }
                             creditSent = true;
                             timer = millis();
                             waitForLastCommand = true;
@@ -851,6 +841,7 @@ void RFCOMM::ACL_event_task()
 #ifdef DEBUG
                         Notify(PSTR("\r\nReceived UIH Command with credit"));                  
 #endif                                              
+                        readReport(); // Takes the credit
                     } else if(rfcommChannelType == RFCOMM_UIH && l2capinbuf[11] == BT_RFCOMM_RPN_CMD) { // UIH Remote Port Negotiation Command
 #ifdef DEBUG
                         Notify(PSTR("\r\nReceived UIH Remote Port Negotiation Command"));                   
@@ -907,6 +898,16 @@ void RFCOMM::ACL_event_task()
         waitForLastCommand = false;
         connected = true; // The RFCOMM channel is now established            
     }
+    if(connected && rfcommCreditFlow) {
+        uint8_t credit = calcCredit();
+        if(credit && rfcommCreditGiven <= credit) { // Top up when the remote device has used half of what the buffer can hold
+            sendRfcommCredit(rfcommChannelPermanent,rfcommDirection,0,RFCOMM_UIH,0x10,credit);
+            rfcommCreditGiven += credit;
+#ifdef EXTRADEBUG
+            Notify(PSTR("\r\nSent more credit"));
+#endif
+        }
+    }
 }
 void RFCOMM::SDP_task() {
     switch (l2cap_sdp_state)
@@ -1001,8 +1002,11 @@ void RFCOMM::RFCOMM_task()
 #ifdef DEBUG
                 Notify(PSTR("\r\nRFCOMM Successfully Configured"));
 #endif                
-                rfcommAvailable = 0; // Reset number of bytes available
-                bytesReceived = 0; // Reset number of bytes received
+                rfcommHead = rfcommTail = 0; // Empty the buffer
+                rfcommCreditFlow = false; // Until the Parameter Negotiation Command says otherwise
+                rfcommFrameSize = (RFCOMM_MAX_FRAME_SIZE < 127) ? RFCOMM_MAX_FRAME_SIZE : 127; // Default frame size of TS 07.10
+                rfcommCredit = 0;
+                rfcommCreditGiven = 0;
                 RFCOMMConnected = true;
                 l2cap_rfcomm_state = L2CAP_RFCOMM_DONE;
             }
@@ -1027,31 +1031,39 @@ void RFCOMM::RFCOMM_task()
 void RFCOMM::readReport() {
     if(rfcommChannelType != RFCOMM_UIH || rfcommChannel != rfcommChannelPermanent)
         return;
-    uint8_t length = l2capinbuf[10] >> 1; // Get length
-    if(rfcommAvailable + length > 256)
-        return; // Return if the buffer would be full
-
-    uint8_t offset = l2capinbuf[4]-length-4; // See if there is credit
+    uint16_t length = l2capinbuf[10] >> 1; // Get length
+    uint8_t offset = 11;
+    if(!(l2capinbuf[10] & 0x01)) // The length is two bytes long
+        length |= l2capinbuf[offset++] << 7;
     
-    for(uint8_t i = 0; i < length; i++)
-        rfcommDataBuffer[rfcommAvailable+i] = l2capinbuf[11+i+offset];    
-    rfcommAvailable += length;
-    bytesReceived += length;
-    if(bytesReceived > 200) {
-        bytesReceived = 0;
-        sendRfcommCredit(rfcommChannelPermanent,rfcommDirection,0,RFCOMM_UIH,0x10,0xFF); // Send 255 more credit
+    if(rfcommPfBit) { // The remote device gives us credit
+        if(rfcommCredit + l2capinbuf[offset] > 0xFF)
+            rfcommCredit = 0xFF;
+        else
+            rfcommCredit += l2capinbuf[offset];
 #ifdef EXTRADEBUG
-        Notify(PSTR("\r\nSent more credit"));
+        Notify(PSTR("\r\nRFCOMM Credit: "));
+        Serial.print(rfcommCredit);
 #endif
+        offset++;
     }
+    if(!length)
+        return;
+    if(rfcommCreditGiven)
+        rfcommCreditGiven--;
+    
+    if(length > (uint8_t)(0xFF - available())) { // Only happens if the remote device doesn't use credit based flow control
+#ifdef DEBUG
+        Notify(PSTR("\r\nRFCOMM buffer full - data lost"));
+#endif
+        return;
+    }
+    for(uint16_t i = 0; i < length; i++)
+        rfcommDataBuffer[rfcommHead++] = l2capinbuf[offset+i]; // The index wraps around at 256
         
 #ifdef EXTRADEBUG
     Notify(PSTR("\r\nRFCOMM Data Available: "));
-    Serial.print(rfcommAvailable);
-    if (offset) {
-        Notify(PSTR(" - Credit: 0x"));
-        Serial.print(l2capinbuf[11],HEX);
-    }
+    Serial.print(available());
 #endif
 }
 void RFCOMM::printReport() { //Uncomment "#define PRINTREPORT" to print the report send to the Arduino
@@ -1210,6 +1222,16 @@ void RFCOMM::hci_disconnect() {
 /************************************************************/
 /*                    L2CAP Commands                        */
 /************************************************************/
+uint8_t RFCOMM::ACL_Out(uint8_t* data, uint16_t nbytes) {
+    // USB finds the endpoint record by number, and the bulk endpoints usually share one (0x82 and 0x02 on CSR dongles),
+    // so the IN pipe's record is used here too - give it the NAK power of the out pipe for the transfer
+    uint8_t nakPower = epInfo[ BTD_DATAIN_PIPE ].bmNakPower;
+    if(epInfo[ BTD_DATAIN_PIPE ].epAddr == epInfo[ BTD_DATAOUT_PIPE ].epAddr)
+        epInfo[ BTD_DATAIN_PIPE ].bmNakPower = epInfo[ BTD_DATAOUT_PIPE ].bmNakPower;
+    uint8_t rcode = pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, nbytes, data);
+    epInfo[ BTD_DATAIN_PIPE ].bmNakPower = nakPower;
+    return rcode;
+}
 void RFCOMM::L2CAP_Command(uint8_t* data, uint8_t nbytes, uint8_t channelLow, uint8_t channelHigh) {
     uint8_t buf[256];
     buf[0] = (uint8_t)(hci_handle & 0xff);    // HCI handle with PB,BC flag
@@ -1224,7 +1246,7 @@ void RFCOMM::L2CAP_Command(uint8_t* data, uint8_t nbytes, uint8_t channelLow, ui
     for (uint16_t i = 0; i < nbytes; i++)//L2CAP C-frame
         buf[8 + i] = data[i];        
     
-    uint8_t rcode = pUsb->outTransfer(bAddress, epInfo[ BTD_DATAOUT_PIPE ].epAddr, (8 + nbytes), buf);
+    uint8_t rcode = ACL_Out(buf, 8 + nbytes);
     if(rcode) {
 #ifdef DEBUG
         Notify(PSTR("\r\nError sending L2CAP message: 0x"));        
@@ -1493,44 +1515,89 @@ void RFCOMM::sendRfcommCredit(uint8_t channel, uint8_t direction, uint8_t CR, ui
     RFCOMM_Command(l2capoutbuf,5);    
 }
 
-/* CRC on 2 bytes */
-uint8_t RFCOMM::__crc(uint8_t* data) {
-    return(pgm_read_byte(&rfcomm_crc_table[pgm_read_byte(&rfcomm_crc_table[0xff ^ data[0]]) ^ data[1]]));
+uint8_t RFCOMM::calcCredit() {
+    uint8_t frames = (0xFF - available()) / rfcommFrameSize; // Frames of the largest size that fit in the free part of the buffer
+    if(frames <= rfcommCreditGiven)
+        return 0;
+    return frames - rfcommCreditGiven;
 }
 
 /* Calculate FCS - we never actually check if the host sends correct FCS to the Arduino */
 uint8_t RFCOMM::calcFcs(uint8_t *data) {
     if((data[1] & 0xEF) == RFCOMM_UIH)
-        return (0xff - __crc(data)); // FCS on 2 bytes
+        return (0xff - crc8Rfcomm(0xff, data, 2)); // FCS on 2 bytes
     else
-        return (0xff - pgm_read_byte(&rfcomm_crc_table[__crc(data) ^ data[2]])); // FCS on 3 bytes
+        return (0xff - crc8Rfcomm(0xff, data, 3)); // FCS on 3 bytes
 }
 
 /* Serial commands */
+uint16_t RFCOMM::write(const uint8_t* data, uint16_t length) {
+    uint8_t buf[RFCOMM_ACL_BUFFER_SIZE]; // The frame is built with its ACL and L2CAP header so it's sent in one transfer
+    uint16_t sent = 0;
+    while(sent < length && connected) {
+        if(rfcommCreditFlow && !rfcommCredit) { // Read incoming data until the remote device gives us more credit
+            unsigned long creditTimer = millis();
+            while(!rfcommCredit && connected && (millis() - creditTimer) < RFCOMM_CREDIT_TIMEOUT)
+                ACL_event_task();
+            if(!rfcommCredit) {
+#ifdef DEBUG
+                Notify(PSTR("\r\nRFCOMM no credit - data not sent"));
+#endif
+                break;
+            }
+        }
+        uint16_t size = length - sent;
+        if(size > rfcommFrameSize)
+            size = rfcommFrameSize;
+        uint8_t credit = rfcommCreditFlow ? calcCredit() : 0; // Any credit we can give is sent along with the data
+        
+        uint16_t i = 8;
+        buf[i++] = rfcommChannelPermanent | 0 | 0 | extendAddress; // RFCOMM Address
+        buf[i++] = RFCOMM_UIH | (credit ? 0x10 : 0x00); // RFCOMM Control - the PF bit tells that there is a credit byte
+        if(size > 127) { // Length
+            buf[i++] = size << 1;
+            buf[i++] = size >> 7;
+        } else
+            buf[i++] = size << 1 | 1;
+        if(credit)
+            buf[i++] = credit;
+        memcpy(buf+i,data+sent,size);
+        i += size;
+        buf[i] = calcFcs(buf+8);
+        i++;
+        
+        buf[0] = (uint8_t)(hci_handle & 0xff); // HCI handle with PB,BC flag
+        buf[1] = (uint8_t)(((hci_handle >> 8) & 0x0f) | 0x20);
+        buf[2] = (uint8_t)((i - 4) & 0xff); // HCI ACL total data length
+        buf[3] = (uint8_t)((i - 4) >> 8);
+        buf[4] = (uint8_t)((i - 8) & 0xff); // L2CAP header: Length
+        buf[5] = (uint8_t)((i - 8) >> 8);
+        buf[6] = rfcomm_scid[0];
+        buf[7] = rfcomm_scid[1];
+        
+        uint8_t rcode = ACL_Out(buf, i);
+        if(rcode) {
+#ifdef DEBUG
+            Notify(PSTR("\r\nError sending RFCOMM data: 0x"));
+            PrintHex<uint8_t>(rcode);
+#endif
+            break;
+        }
+        rfcommCreditGiven += credit;
+        if(rfcommCreditFlow)
+            rfcommCredit--;
+        sent += size;
+    }
+    return sent;
+}
 void RFCOMM::print(const char* data) {
-    rfcommbuf[0] = rfcommChannelPermanent | 0 | 0 | extendAddress;; // RFCOMM Address
-    rfcommbuf[1] = RFCOMM_UIH; // RFCOMM Control                                                                
-    rfcommbuf[2] = strlen(data) << 1 | 1; // Length
-    uint8_t i = 0;
-    for(; i < strlen(data); i++)
-        rfcommbuf[i+3] = data[i];                                                                
-    rfcommbuf[i+3] = calcFcs(rfcommbuf);                            
-    
-    RFCOMM_Command(rfcommbuf,strlen(data)+4);
+    write((const uint8_t*)data,strlen(data));
 }
 void RFCOMM::print(uint8_t data) {
     print(&data,1);
 }
 void RFCOMM::print(uint8_t* array, uint8_t length) {
-    rfcommbuf[0] = rfcommChannelPermanent | 0 | 0 | extendAddress;; // RFCOMM Address
-    rfcommbuf[1] = RFCOMM_UIH; // RFCOMM Control
-    rfcommbuf[2] = length << 1 | 1; // Length
-    uint8_t i = 0;
-    for(; i < length; i++)
-        rfcommbuf[i+3] = array[i];
-    rfcommbuf[i+3] = calcFcs(rfcommbuf);
-    
-    RFCOMM_Command(rfcommbuf,length+4);
+    write(array,length);
 }
 void RFCOMM::print(const __FlashStringHelper *ifsh) {
     const char PROGMEM *p = (const char PROGMEM *)ifsh;
@@ -1586,9 +1653,15 @@ void RFCOMM::println(const __FlashStringHelper *ifsh) {
 }
 
 uint8_t RFCOMM::read() {
-    uint8_t output = rfcommDataBuffer[0];
-    for(uint8_t i = 1; i < rfcommAvailable; i++)
-        rfcommDataBuffer[i-1] = rfcommDataBuffer[i]; // Shift the buffer one left
-    rfcommAvailable--;
-    return output;
+    if(!available())
+        return 0;
+    return rfcommDataBuffer[rfcommTail++]; // The index wraps around at 256
+}
+uint8_t RFCOMM::read(uint8_t* data, uint8_t length) {
+    uint8_t n = available();
+    if(length > n)
+        length = n;
+    for(uint8_t i = 0; i < length; i++)
+        data[i] = rfcommDataBuffer[rfcommTail++];
+    return length;
 }
\ No newline at end of file
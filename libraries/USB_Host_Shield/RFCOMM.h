@@ -161,6 +161,10 @@
 
 #define extendAddress   0x01 // Allways 1
 
+#define RFCOMM_MAX_FRAME_SIZE   127 // The largest frame size we will negotiate, at most 255 as a whole frame has to fit in the buffer for incoming data
+#define RFCOMM_ACL_BUFFER_SIZE  (RFCOMM_MAX_FRAME_SIZE + 14) // ACL and L2CAP header, address, control, two length bytes, credit and FCS
+#define RFCOMM_CREDIT_TIMEOUT   500 // Time in ms write() will wait for the remote device to give us credit
+
 // Multiplexer message types 
 #define BT_RFCOMM_PN_CMD     0x83
 #define BT_RFCOMM_PN_RSP     0x81
@@ -210,8 +214,11 @@ public:
     void println(uint8_t* array, uint8_t length); // Include newline and carriage return
     void println(const __FlashStringHelper *); // Include newline and carriage return
     
-    uint8_t available() { return rfcommAvailable; }; // Get the bytes waiting to be read
+    uint16_t write(const uint8_t* data, uint16_t length); // Send as few frames as possible, returns the number of bytes sent
+    
+    uint8_t available() { return rfcommHead - rfcommTail; }; // Get the bytes waiting to be read
     uint8_t read(); // Used to read the buffer
+    uint8_t read(uint8_t* data, uint8_t length); // Read up to length bytes, returns the number of bytes read
     
 protected:           
     /* mandatory members */
@@ -260,7 +267,7 @@ private:
     uint16_t l2cap_event_flag;// l2cap flags of received bluetooth events
            
     uint8_t hcibuf[BULK_MAXPKTSIZE];//General purpose buffer for hci data
-    uint8_t l2capinbuf[BULK_MAXPKTSIZE];//General purpose buffer for l2cap in data
+    uint8_t l2capinbuf[RFCOMM_ACL_BUFFER_SIZE];//General purpose buffer for l2cap in data - large enough for a full RFCOMM frame
     uint8_t l2capoutbuf[BULK_MAXPKTSIZE];//General purpose buffer for l2cap out data
     uint8_t rfcommbuf[BULK_MAXPKTSIZE]; // Buffer for RFCOMM Data
     
@@ -283,11 +290,16 @@ private:
     bool waitForLastCommand;
     bool creditSent;    
     
-    uint8_t rfcommDataBuffer[256]; // Create a 256 sized buffer for incoming data
-    uint8_t rfcommAvailable;
+    uint8_t rfcommDataBuffer[256]; // Ring buffer for incoming data - the indices wrap around by themselves
+    uint8_t rfcommHead; // Where readReport() puts the next byte
+    uint8_t rfcommTail; // Where read() takes the next byte
+    
+    bool rfcommCreditFlow; // Set if credit based flow control was negotiated
+    uint16_t rfcommFrameSize; // Maximum frame size negotiated with the remote device
+    uint8_t rfcommCredit; // Frames we are allowed to send
+    uint8_t rfcommCreditGiven; // Frames the remote device is allowed to send
     
     bool firstMessage; // Used to see if it's the first SDP request received    
-    uint8_t bytesReceived; // Counter to see when it's time to send more credit
     
     /* State machines */
     void HCI_event_task(); //poll the HCI event pipe
@@ -313,6 +325,7 @@ private:
     void hci_disconnect();
     
     /* L2CAP Commands */
+    uint8_t ACL_Out(uint8_t* data, uint16_t nbytes); // Send an ACL packet, waiting while the dongle NAKs
     void L2CAP_Command(uint8_t* data, uint8_t nbytes, uint8_t channelLow = 0x01, uint8_t channelHigh = 0x00); // Standard L2CAP header: Channel ID (0x01) for ACL-U
     void l2cap_connection_response(uint8_t rxid, uint8_t* dcid, uint8_t* scid, uint8_t result);
     void l2cap_config_request(uint8_t rxid, uint8_t* dcid);
@@ -333,7 +346,7 @@ private:
     void RFCOMM_Command(uint8_t* data, uint8_t nbytes);
     void sendRfcomm(uint8_t channel, uint8_t direction, uint8_t CR, uint8_t channelType, uint8_t pfBit, uint8_t* data, uint8_t length);
     void sendRfcommCredit(uint8_t channel, uint8_t direction, uint8_t CR, uint8_t channelType, uint8_t pfBit, uint8_t credit);
+    uint8_t calcCredit(); // Credit we can give without the ring buffer overflowing
     uint8_t calcFcs(uint8_t *data);
-    uint8_t __crc(uint8_t* data);
 };
 #endif
\ No newline at end of file
@@ -42,6 +42,9 @@ void USB::init()
 {
 	devConfigIndex	= 0;
 	bmHubPre		= 0;
+
+	for (uint8_t i=0; i<USB_NUMPIPES; i++)
+		pipes[i].address = 0;
 }
 
 uint8_t USB::getUsbTaskState( void )
@@ -272,6 +275,72 @@ uint8_t USB::InTransfer(EpInfo *pep, uint16_t nak_limit, uint16_t *nbytesptr, ui
 	} //while( 1 )
 }
 
+/* Bulk IN with both halves of the double buffered RCVFIFO in use. The IN token for the next packet */
+/* is launched before the packet that has arrived is read out, so the bus transfer overlaps the     */
+/* SPI transfer. The reader empties each packet itself, and is asked first if it has room for the  */
+/* packet being read plus the one on its way. Stops after a short packet, a NAK or 'npkts' packets. */
+/* rcode 0 if at least one packet was read, hrNAK if the device had nothing to send                 */
+uint8_t USB::streamIn( uint8_t addr, uint8_t ep, uint8_t npkts, USBFifoReader *reader )
+{
+	EpInfo		*pep = NULL;
+	uint16_t	nak_limit;
+
+	uint8_t rcode = SetAddress(addr, ep, &pep, nak_limit);
+
+	if (rcode)
+		return rcode;
+
+	if (!npkts || !reader->Room(1))
+		return 0;
+
+	uint8_t	maxpktsize = pep->maxPktSize;
+
+	regWr( rHCTL, (pep->bmRcvToggle) ? bmRCVTOG1 : bmRCVTOG0 );    //set toggle value
+
+	rcode = dispatchPkt( tokIN, pep->epAddr, 1 );		// one IN token, a NAK ends it
+
+	while( !rcode )
+	{
+		if(( regRd( rHIRQ ) & bmRCVDAVIRQ ) == 0 )
+		{
+			rcode = 0xf0;								//receive error
+			break;
+		}
+		uint8_t pktsize = regRd( rRCVBC );
+
+		// Next packet goes to the other FIFO while this one is read
+		bool more = ( pktsize == maxpktsize && --npkts && reader->Room(2) );
+
+		if (more)
+			regWr( rHXFR, ( tokIN | pep->epAddr ));
+
+		reader->Read(this, pktsize);
+
+		regWr( rHIRQ, bmRCVDAVIRQ );					// free this FIFO, the other one becomes readable
+
+		if (!more)
+			break;
+
+		unsigned long timeout = millis() + USB_XFER_TIMEOUT;
+
+		while(!(regRd( rHIRQ ) & bmHXFRDNIRQ ))
+			if (millis() > timeout)
+				return USB_ERROR_TRANSFER_TIMEOUT;
+
+		regWr( rHIRQ, bmHXFRDNIRQ );
+		rcode = ( regRd( rHRSL ) & 0x0f );
+
+		if (rcode == hrNAK)								// nothing more for now, the packets so far are fine
+		{
+			rcode = 0;
+			break;
+		}
+	}
+	// Save toggle value
+	pep->bmRcvToggle = (( regRd( rHRSL ) & bmRCVTOGRD )) ? 1 : 0;
+	return( rcode );
+}
+
 /* OUT transfer to arbitrary endpoint. Handles multiple packets if necessary. Transfers 'nbytes' bytes. */
 /* Handles NAK bug per Maxim Application Note 4000 for single buffer transfer   */
 /* rcode 0 if no errors. rcode 01-0f is relayed from HRSL                       */
@@ -406,12 +475,147 @@ uint8_t USB::dispatchPkt( uint8_t token, uint8_t ep, uint16_t nak_limit )
 	return( rcode );
 }
 
+/* Scheduled interrupt IN transfers. openPipe() registers a driver buffer for an endpoint that     */
+/* USB::Task() then polls every 'interval' frames, counted from the SOF interrupt. Each poll is    */
+/* a single IN token, so an endpoint with nothing to say costs one transaction per interval rather */
+/* than a NAK loop. readPipe() returns USB_ERROR_TRANSFER_PENDING until a transfer has completed,  */
+/* then its result and length, and re-arms the endpoint.                                            */
+uint8_t USB::openPipe( uint8_t addr, uint8_t ep, uint8_t interval, uint16_t nbytes, uint8_t* data )
+{
+	if (!addr || !nbytes || !data)
+		return USB_ERROR_INVALID_ARGUMENT;
+
+	if (!getEpInfoEntry(addr, ep))
+		return USB_ERROR_EP_NOT_FOUND_IN_TBL;
+
+	UsbPipe *pp = FindPipe(addr, ep);
+
+	for (uint8_t i=0; !pp && i<USB_NUMPIPES; i++)
+		if (!pipes[i].address)
+			pp = pipes + i;
+
+	if (!pp)
+		return USB_ERROR_OUT_OF_PIPES;
+
+	pp->address		= addr;
+	pp->epAddr		= ep;
+	pp->bInterval	= (interval) ? interval : 1;
+	pp->rcode		= 0;
+	pp->bDone		= false;
+	pp->due			= getFrameNum();
+	pp->nbytes		= nbytes;
+	pp->read		= 0;
+	pp->data		= data;
+	return 0;
+}
+
+uint8_t USB::readPipe( uint8_t addr, uint8_t ep, uint16_t *nbytesptr )
+{
+	UsbPipe *pp = FindPipe(addr, ep);
+
+	if (!pp)
+		return USB_ERROR_EP_NOT_FOUND_IN_TBL;
+
+	if (!pp->bDone)
+		return USB_ERROR_TRANSFER_PENDING;
+
+	*nbytesptr	= pp->read;
+	pp->read	= 0;
+	pp->bDone	= false;
+	return pp->rcode;
+}
+
+void USB::closePipes( uint8_t addr )
+{
+	for (uint8_t i=0; i<USB_NUMPIPES; i++)
+		if (pipes[i].address == addr)
+			pipes[i].address = 0;
+}
+
+UsbPipe* USB::FindPipe(uint8_t addr, uint8_t ep)
+{
+	for (uint8_t i=0; i<USB_NUMPIPES; i++)
+		if (pipes[i].address && pipes[i].address == addr && pipes[i].epAddr == ep)
+			return pipes + i;
+	return NULL;
+}
+
+/* Sends one IN token to the endpoint. A NAK leaves the transfer pending for the next interval */
+void USB::PollPipe(UsbPipe *pp)
+{
+	EpInfo		*pep = NULL;
+	uint16_t	nak_limit;
+	uint16_t	read;
+
+	uint8_t rcode = SetAddress(pp->address, pp->epAddr, &pep, nak_limit);
+
+	if (!rcode)
+	{
+		read = pp->nbytes - pp->read;
+
+		if (read > pep->maxPktSize)
+			read = pep->maxPktSize;
+
+		rcode = InTransfer(pep, 1, &read, pp->data + pp->read);
+
+		if (rcode == hrNAK)
+			return;
+
+		pp->read += read;
+
+		// Transfer continues in the next interval after a full packet, unless the buffer is full
+		if (!rcode && read == pep->maxPktSize && pp->read < pp->nbytes)
+			return;
+	}
+	pp->rcode	= rcode;
+	pp->bDone	= true;
+}
+
+void USB::RunPipes()
+{
+	uint16_t frame = getFrameNum();
+
+	for (uint8_t i=0; i<USB_NUMPIPES; i++)
+	{
+		UsbPipe *pp = pipes + i;
+
+		if (!pp->address || pp->bDone)
+			continue;
+
+		int16_t late = (int16_t)(frame - pp->due);
+
+		if (late < 0)
+		{
+			// Frame count jumped past the wrap while Task() was not being called
+			if (-late > pp->bInterval)
+				pp->due = frame;
+			continue;
+		}
+
+		// Endpoints sharing a buffer take turns, data not yet read is not overwritten
+		bool busy = false;
+
+		for (uint8_t j=0; j<USB_NUMPIPES; j++)
+			if (j != i && pipes[j].address && pipes[j].data == pp->data && (pipes[j].bDone || pipes[j].read))
+				busy = true;
+
+		if (busy)
+			continue;
+
+		// Keep to the interval grid, or restart from now when more than an interval behind
+		pp->due = (late < pp->bInterval) ? pp->due + pp->bInterval : frame + pp->bInterval;
+
+		PollPipe(pp);
+	}
+}
+
 /* USB main task. Performs enumeration/cleanup */
 void USB::Task( void )      //USB state machine
 {
 	uint8_t rcode;
 	uint8_t tmpdata;
 	static unsigned long delay = 0;
+	static uint16_t sof_frame = 0;
 	USB_DEVICE_DESCRIPTOR buf;
 	bool lowspeed = false;
 
@@ -442,6 +646,8 @@ void USB::Task( void )      //USB state machine
             break;
     }// switch( tmpdata
 
+	RunPipes();
+
 	for (uint8_t i=0; i<USB_NUMDEVICES; i++)
 		if (devConfig[i])
 			rcode = devConfig[i]->Poll();
@@ -475,10 +681,11 @@ void USB::Task( void )      //USB state machine
                 regWr( rMODE, tmpdata );
                 usb_task_state = USB_ATTACHED_SUBSTATE_WAIT_SOF;
                 delay = millis() + 20; //20ms wait after reset per USB spec
+                sof_frame = getFrameNum();
             }
             break;
         case USB_ATTACHED_SUBSTATE_WAIT_SOF:  //todo: change check order
-            if( regRd( rHIRQ ) & bmFRAMEIRQ )							//when first SOF received we can continue
+            if( getFrameNum() != sof_frame )						//when first SOF received we can continue, IntHandler() counts them
 			{															
 				if( delay < millis() )									//20ms passed
 					usb_task_state = USB_STATE_CONFIGURING;
@@ -588,6 +795,8 @@ uint8_t USB::ReleaseDevice(uint8_t addr)
 	if (!addr)
 		return 0;
 
+	closePipes(addr);
+
 	for (uint8_t i=0; i<USB_NUMDEVICES; i++)
 		if (devConfig[i]->GetAddress() == addr)
 			return devConfig[i]->Release();
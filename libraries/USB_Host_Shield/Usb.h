@@ -109,6 +109,8 @@ typedef MAX3421e<P10, P9>		MAX3421E;		// Official Arduinos (UNO, Duemilanove, Me
 #define USB_ERROR_CLASS_INSTANCE_ALREADY_IN_USE		0xD9
 #define USB_ERROR_INVALID_MAX_PKT_SIZE				0xDA
 #define USB_ERROR_EP_NOT_FOUND_IN_TBL				0xDB
+#define USB_ERROR_TRANSFER_PENDING					0xDC
+#define USB_ERROR_OUT_OF_PIPES						0xDD
 #define USB_ERROR_TRANSFER_TIMEOUT					0xFF
 
 class USBDeviceConfig
@@ -126,6 +128,7 @@ public:
 #define USB_SETTLE_DELAY		200     //settle delay in milliseconds
 
 #define USB_NUMDEVICES			16		//number of USB devices
+#define USB_NUMPIPES			4		//number of interrupt IN endpoints USB::Task() polls on their own
 //#define HUB_MAX_HUBS			7		// maximum number of hubs that can be attached to the host controller
 #define HUB_PORT_RESET_DELAY	20		// hub port reset delay 10 ms recomended, can be up to 20 ms
 
@@ -170,6 +173,23 @@ typedef struct {
 
 
 
+/* Interrupt IN endpoint polled by USB::Task() once every bInterval frames. A NAK costs one   */
+/* transaction and waits for the next interval; the received data stays in the buffer until  */
+/* the driver picks it up with readPipe() from its Poll(), and the endpoint is not polled     */
+/* again before that.                                                                          */
+struct UsbPipe
+{
+	uint8_t		address;			// device address, 0 if the entry is free
+	uint8_t		epAddr;				// endpoint number
+	uint8_t		bInterval;			// polling interval in frames
+	uint8_t		rcode;				// result of the completed transfer
+	bool		bDone;				// transfer completed, waiting for readPipe()
+	uint16_t	due;				// frame of the next IN token
+	uint16_t	nbytes;				// buffer size
+	uint16_t	read;				// bytes received so far
+	uint8_t		*data;
+};
+
 // Base class for incomming data parser
 class USBReadParser
 {
@@ -177,11 +197,22 @@ public:
 	virtual void Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset) = 0;
 };
 
+class USB;
+
+// Base class for drivers taking bulk IN packets straight out of the receive FIFO, see USB::streamIn()
+class USBFifoReader
+{
+public:
+	virtual bool Room(uint8_t npkts) = 0;					// true if npkts more full packets can be taken
+	virtual void Read(USB *pusb, uint8_t nbytes) = 0;		// empty the packet of nbytes waiting in rRCVFIFO
+};
+
 
 class USB : public MAX3421E
 {
 		AddressPoolImpl<USB_NUMDEVICES>		addrPool;
 		USBDeviceConfig*					devConfig[USB_NUMDEVICES];
+		UsbPipe								pipes[USB_NUMPIPES];
 		uint8_t								devConfigIndex;
 		uint8_t								bmHubPre;
 
@@ -233,8 +264,14 @@ class USB : public MAX3421E
         uint8_t ctrlStatus( uint8_t ep, boolean direction, uint16_t nak_limit );
         uint8_t inTransfer( uint8_t addr, uint8_t ep, uint16_t *nbytesptr, uint8_t* data );
         uint8_t outTransfer( uint8_t addr, uint8_t ep, uint16_t nbytes, uint8_t* data );
+        uint8_t streamIn( uint8_t addr, uint8_t ep, uint8_t npkts, USBFifoReader *reader );
         uint8_t dispatchPkt( uint8_t token, uint8_t ep, uint16_t nak_limit );
 
+		/* Scheduled interrupt IN transfers */
+		uint8_t openPipe( uint8_t addr, uint8_t ep, uint8_t interval, uint16_t nbytes, uint8_t* data );
+		uint8_t readPipe( uint8_t addr, uint8_t ep, uint16_t *nbytesptr );
+		void closePipes( uint8_t addr );
+
         void Task( void );
 
 		uint8_t DefaultAddressing(uint8_t parent, uint8_t port, bool lowspeed);
@@ -249,6 +286,9 @@ class USB : public MAX3421E
 		uint8_t SetAddress(uint8_t addr, uint8_t ep, EpInfo **ppep, uint16_t &nak_limit);
 		uint8_t OutTransfer(EpInfo *pep, uint16_t nak_limit, uint16_t nbytes, uint8_t *data);
 		uint8_t InTransfer (EpInfo *pep, uint16_t nak_limit, uint16_t *nbytesptr, uint8_t *data);
+		UsbPipe* FindPipe(uint8_t addr, uint8_t ep);
+		void PollPipe(UsbPipe *pp);
+		void RunPipes();
 };
 
 #if 0 //defined(USB_METHODS_INLINE)
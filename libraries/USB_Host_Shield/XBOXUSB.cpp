@@ -33,6 +33,8 @@ bPollEnable(false) { // don't start polling before dongle is connected
     
     if (pUsb) // register in USB subsystem
 		pUsb->RegisterDeviceClass(this); //set devConfig[] entry
+    
+    resetState();
 }
 
 uint8_t XBOXUSB::Init(uint8_t parent, uint8_t port, bool lowspeed) {
@@ -229,6 +231,7 @@ Fail:
 /* Performs a cleanup after failed Init() attempt */
 uint8_t XBOXUSB::Release() {
     Xbox360Connected = false;
+    resetState();
 	pUsb->GetAddressPool().FreeAddress(bAddress);    
 	bAddress = 0;
     bPollEnable = false;
@@ -237,23 +240,45 @@ uint8_t XBOXUSB::Release() {
 uint8_t XBOXUSB::Poll() {    
 	if (!bPollEnable)
 		return 0;
+    buttonChanged = false; // These are only set until the next poll
+    buttonPressed = false;
+    buttonReleased = false;
+    uint8_t readBuf[EP_MAXPKTSIZE]; // Only needed until the report is decoded
     uint16_t BUFFER_SIZE = EP_MAXPKTSIZE;
-    pUsb->inTransfer(bAddress, epInfo[ XBOX_INPUT_PIPE ].epAddr, &BUFFER_SIZE, readBuf); // input on endpoint 1
-    readReport();
+    uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[ XBOX_INPUT_PIPE ].epAddr, &BUFFER_SIZE, readBuf); // input on endpoint 1
+    if (rcode) // Nothing new was received
+        return 0;
+    readReport(readBuf);
 #ifdef PRINTREPORT
-    printReport(); // Uncomment "#define PRINTREPORT" to print the report send by the Xbox 360 Controller
+    printReport(readBuf); // Uncomment "#define PRINTREPORT" to print the report send by the Xbox 360 Controller
 #endif
 	return 0;
 }
 
-void XBOXUSB::readReport() {              
-    if (readBuf == NULL)
-        return;
+void XBOXUSB::readReport(uint8_t* readBuf) {              
     if(readBuf[0] != 0x00 || readBuf[1] != 0x14) { // Check if it's the correct report - the controller also sends different status reports
         return;
     }
+    
+    // Decode the report once, the get functions only read the state
+    state.buttons = readBuf[2] | ((uint16_t)readBuf[3] << 8);
+    state.trigger[0] = readBuf[4];
+    state.trigger[1] = readBuf[5];
+    for (uint8_t i = 0; i < 4; i++)
+        state.hat[i] = (int16_t)(readBuf[7 + 2 * i] << 8 | readBuf[6 + 2 * i]);
+    
+    uint16_t changed = state.buttons ^ (uint16_t)OldButtonState;
+    for (uint8_t i = 0; changed && i < 16; i++) { // Queue every button that changed, they are read with getButtonEvent()
+        if (!(changed & (1 << i)))
+            continue;
+        uint8_t next = (eventHead + 1) & (XBOX_EVENT_QUEUE_SIZE - 1);
+        if (next == eventTail) // The queue is full, the rest of the changes are lost
+            break;
+        events[eventHead] = i | ((state.buttons & (1 << i)) ? 0x80 : 0x00);
+        eventHead = next;
+    }
 
-    ButtonState = (uint32_t)(readBuf[2] | ((uint16_t)readBuf[3] << 8) | ((uint32_t)readBuf[4] << 16) | ((uint32_t)readBuf[5] << 24));
+    ButtonState = (uint32_t)(state.buttons | ((uint32_t)readBuf[4] << 16) | ((uint32_t)readBuf[5] << 24));
     
     //Notify(PSTR("\r\nButtonState");
     //PrintHex<uint32_t>(ButtonState);
@@ -267,18 +292,12 @@ void XBOXUSB::readReport() {
             buttonPressed = false;
             buttonReleased = true;
         }
-    } else {
-        buttonChanged = false;
-        buttonPressed = false;
-        buttonReleased = false;
     }
     
     OldButtonState = ButtonState; 
 }  
 
-void XBOXUSB::printReport() { //Uncomment "#define PRINTREPORT" to print the report send by the Xbox 360 Controller
-    if (readBuf == NULL)
-        return;
+void XBOXUSB::printReport(uint8_t* readBuf) { //Uncomment "#define PRINTREPORT" to print the report send by the Xbox 360 Controller
     for(uint8_t i = 0; i < XBOX_REPORT_BUFFER_SIZE;i++) {
         PrintHex<uint8_t>(readBuf[i]);
         Serial.print(" ");
@@ -286,23 +305,41 @@ void XBOXUSB::printReport() { //Uncomment "#define PRINTREPORT" to print the rep
     Serial.println("");
 }
 
+void XBOXUSB::resetState() {
+    memset(&state, 0, sizeof(XBOXState));
+    ButtonState = 0;
+    OldButtonState = 0;
+    eventHead = 0;
+    eventTail = 0;
+    buttonChanged = false;
+    buttonPressed = false;
+    buttonReleased = false;
+}
+
 uint8_t XBOXUSB::getButton(Button b) {
-    if (readBuf == NULL)
-        return false;
     if(b == L2 || b == R2) { // These are analog buttons
-        return (uint8_t)(readBuf[(uint8_t)b]);
+        return state.trigger[(uint8_t)b - L2];
     }
     else {
-        if ((readBuf[(uint16_t)b >> 8] & ((uint8_t)b & 0xff)) > 0)
+        if (state.buttons & ((uint16_t)((uint8_t)b & 0xff) << ((((uint16_t)b >> 8) - 2) << 3)))
             return 1;
         else
             return 0;
     }
 }
 int16_t XBOXUSB::getAnalogHat(AnalogHat a) {
-    if (readBuf == NULL)
-        return 0;
-    return (int16_t)(readBuf[(uint8_t)a+1] << 8 | readBuf[(uint8_t)a]);            
+    return state.hat[((uint8_t)a - LeftHatX) >> 1];
+}
+bool XBOXUSB::getButtonEvent(Button *b, bool *pressed) {
+    if (eventTail == eventHead)
+        return false;
+    uint8_t event = events[eventTail];
+    eventTail = (eventTail + 1) & (XBOX_EVENT_QUEUE_SIZE - 1);
+    
+    uint8_t bit = event & 0x0F;
+    *b = (Button)(((2 + (bit >> 3)) << 8) | (1 << (bit & 0x07))); // Back to the byte and bit location of enum Button
+    *pressed = (event & 0x80);
+    return true;
 }
 
 /* Playstation Sixaxis Dualshock and Navigation Controller commands */
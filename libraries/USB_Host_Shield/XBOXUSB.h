@@ -44,6 +44,7 @@
 #define XBOX_WIRELESS_RECEIVER_THIRD_PARTY_PID  0x0291  // Third party Wireless Gaming Receiver
 
 #define XBOX_REPORT_BUFFER_SIZE 14 // Size of the input report buffer
+#define XBOX_EVENT_QUEUE_SIZE   8 // Button changes kept until they are read - has to be a power of two
 
 // used in control endpoint header for HID Commands
 #define bmREQ_HID_OUT USB_SETUP_HOST_TO_DEVICE|USB_SETUP_TYPE_CLASS|USB_SETUP_RECIPIENT_INTERFACE
@@ -98,6 +99,14 @@ enum AnalogHat
     RightHatY = 12,
 };
 
+/* Every report is decoded into this when it arrives, the get functions only read it */
+struct XBOXState
+{
+    uint16_t buttons; // Byte 2 and 3 of the report
+    uint8_t trigger[2]; // L2 and R2
+    int16_t hat[4]; // LeftHatX, LeftHatY, RightHatX, RightHatY
+};
+
 class XBOXUSB : public USBDeviceConfig
 {
 public:
@@ -113,6 +122,7 @@ public:
     /* XBOX Controller Readings */
     uint8_t getButton(Button b);
     int16_t getAnalogHat(AnalogHat a);
+    bool getButtonEvent(Button *b, bool *pressed); // Oldest button change that hasn't been read - returns false if there is none
     
     /* Commands for Dualshock 3 and Navigation controller */    
     void setAllOff() { setRumbleOn(0,0); setLedOff(); };
@@ -140,11 +150,16 @@ private:
     uint32_t ButtonState;
     uint32_t OldButtonState;     
     
-    uint8_t readBuf[EP_MAXPKTSIZE]; // General purpose buffer for input data
+    XBOXState state;
+    uint8_t events[XBOX_EVENT_QUEUE_SIZE]; // Button number, 0x80 is set when it was pressed
+    uint8_t eventHead;
+    uint8_t eventTail;
+    
     uint8_t writeBuf[EP_MAXPKTSIZE]; // General purpose buffer for output data
     
-    void readReport(); // read incoming data
-    void printReport(); // print incoming date - Uncomment for debugging
+    void readReport(uint8_t* readBuf); // read incoming data
+    void printReport(uint8_t* readBuf); // print incoming date - Uncomment for debugging
+    void resetState();
 
     /* Private commands */
     void XboxCommand(uint8_t* data, uint16_t nbytes);
@@ -0,0 +1,288 @@
+#if !defined(__BULKONLYCARD_H__)
+#define __BULKONLYCARD_H__
+
+// A USB drive as an SdFat block device, so that SdFat mounts it like an SD card:
+//
+//	#include <SdFat.h>
+//	#include <masstorage.h>
+//	#include <bulkonlycard.h>
+//
+//	USB				Usb;
+//	BulkOnly		Bulk(&Usb);
+//	BulkOnlyCard	Drive(&Bulk);
+//	SdFat			sd;
+//
+//	... Usb.Task() until Bulk.GetAddress() is set, then
+//	if (Drive.begin() && sd.begin(&Drive)) ...
+//
+// The sketch has to include SdFat.h for the Arduino IDE to find it, and
+// USE_SD_BLOCK_DEVICE has to be set nonzero in SdFatConfig.h.
+//
+// Reads are served from a READ(10) that is left open for the blocks after the
+// one asked for.  Nothing is buffered: the blocks stay in the device until they
+// are read, and the ones not wanted are discarded, so the number asked for has
+// to be guessed well.  Reads are followed as a sequential run with single block
+// reads elsewhere, the FAT or a directory, in between.  The run asks for twice
+// as many blocks each time, up to BULKONLYCARD_READ_AHEAD, and when it comes back
+// from a read elsewhere it asks for as many as it read between the last two, so
+// that a file read through the SdFat cache, which fetches the FAT block at every
+// cluster, does not throw blocks away.  A single block read elsewhere followed by
+// the next block starts a new run; random access costs one command per block.
+//
+// A write sequence is sent as WRITE(10) commands of up to BULKONLYCARD_WRITE_CHUNK
+// blocks, each one issued when writeData() gets to it.  The count given to
+// writeStart() is taken as the SD pre-erase hint: commands stay inside that range,
+// and when writeStop() comes in the middle of one the blocks it still expects are
+// sent as zeros, so that the command ends with its status.  Like pre-erased blocks
+// on an SD card, blocks in the range that were not written have no set content.
+
+#include "masstorage.h"
+#include <SdFat.h>
+
+#if !USE_SD_BLOCK_DEVICE
+#error You must set USE_SD_BLOCK_DEVICE nonzero in SdFatConfig.h
+#endif
+
+#define BULKONLYCARD_READ_AHEAD			16		// most blocks asked for by one READ(10)
+#define BULKONLYCARD_WRITE_CHUNK		16		// most blocks sent by one WRITE(10)
+#define BULKONLYCARD_BLOCK_SIZE			512
+
+#define BULKONLYCARD_ERR_NOT_READY		0x20	// no drive, see BulkOnly::GetAddress()
+#define BULKONLYCARD_ERR_BLOCK_SIZE		0x21	// drive blocks are not 512 bytes
+
+class BulkOnlyCard : public SdBlockDevice
+{
+	BulkOnly	*pBulk;
+	uint8_t		bLun;
+	uint8_t		bLastError;		// last MASS_ERR_ or BULKONLYCARD_ERR_ code
+	uint32_t	dBlocks;		// drive capacity
+	uint32_t	dNext;			// next block of the read in progress
+	uint16_t	wLeft;			// blocks left in the read in progress
+	uint32_t	dRun;			// next block of the sequential run
+	uint32_t	dAlt;			// block after the last read outside the run
+	uint8_t		bRun;			// blocks read in the run since the last read outside it
+	uint8_t		bPeriod;		// bRun when the run was last left
+	uint8_t		bWindow;		// blocks in the last read command of the run
+	uint32_t	dSeq;			// next block of readStart()/readData()
+	uint32_t	dWrite;			// next block of writeStart()/writeData()
+	uint32_t	dWriteEnd;		// end of the range given to writeStart()
+	uint8_t		bWriteLeft;		// blocks left in the write in progress
+
+	bool Result(uint8_t rcode)
+	{
+		bLastError = rcode;
+		return (rcode == MASS_ERR_SUCCESS);
+	};
+	bool EndRead()
+	{
+		bool open = (wLeft && pBulk->DataPending());
+
+		wLeft = 0;
+		return (!open || Result(pBulk->Stop()));
+	};
+	// Sends zeros for the blocks the write in progress still expects
+	bool EndWrite()
+	{
+		uint8_t	zero[64];
+
+		memset(zero, 0, sizeof(zero));
+
+		while (bWriteLeft && pBulk->DataPending())
+		{
+			if (!Result(pBulk->WriteData(sizeof(zero), zero)))
+				break;
+		}
+		bool ok = (!bWriteLeft || bLastError == MASS_ERR_SUCCESS);
+
+		bWriteLeft = 0;
+		return ok;
+	};
+	void ResetRun()
+	{
+		wLeft	= 0;
+		bWriteLeft = 0;
+		dRun	= 0xffffffff;
+		dAlt	= 0xffffffff;
+		bRun	= 0;
+		bPeriod	= 0;
+		bWindow	= 1;
+	};
+
+public:
+	BulkOnlyCard(BulkOnly *p, uint8_t lun = 0) :
+		pBulk(p),
+		bLun(lun),
+		bLastError(BULKONLYCARD_ERR_NOT_READY),
+		dBlocks(0),
+		dNext(0),
+		dSeq(0),
+		dWrite(0),
+		dWriteEnd(0)
+	{
+		ResetRun();
+	};
+
+	// Waits for the drive to be ready and reads its capacity
+	bool begin()
+	{
+		Capacity	cap;
+		uint8_t		rcode;
+
+		dBlocks	= 0;
+		ResetRun();
+
+		if (!pBulk->GetAddress())
+			return Result(BULKONLYCARD_ERR_NOT_READY);
+
+		// drives report a unit attention or not ready for a while after reset
+		for (uint8_t i=0; i<20; i++)
+		{
+			rcode = pBulk->TestUnitReady(bLun);
+
+			if (rcode != MASS_ERR_PHASE_ERROR)
+				break;
+
+			RequestSenseResponce sense;
+			pBulk->RequestSense(bLun, sizeof(sense), (uint8_t*)&sense);
+			delay(100);
+		}
+		if (rcode)
+			return Result(rcode);
+
+		rcode = pBulk->ReadCapacity(bLun, sizeof(cap), cap.data);
+
+		if (rcode)
+			return Result(rcode);
+
+		if (cap.data[4] || cap.data[5] || cap.data[6] != (BULKONLYCARD_BLOCK_SIZE >> 8) || cap.data[7])
+			return Result(BULKONLYCARD_ERR_BLOCK_SIZE);
+
+		dBlocks = ((uint32_t)cap.data[0] << 24 | (uint32_t)cap.data[1] << 16 | (uint16_t)cap.data[2] << 8 | cap.data[3]) + 1;
+		return Result(MASS_ERR_SUCCESS);
+	};
+
+	// SdBlockDevice implementation
+	virtual uint32_t cardSize() { return dBlocks; };
+	virtual uint8_t errorData() { return bLastError; };
+
+	virtual bool readBlock(uint32_t block, uint8_t *dst)
+	{
+		if (!wLeft || block != dNext || !pBulk->DataPending())
+		{
+			uint16_t n = 1;
+
+			if (!EndWrite() || !EndRead())
+				return false;
+
+			// the last read outside the run starts a new one
+			if (block == dAlt && block != dRun)
+			{
+				dRun	= block;
+				bRun	= 1;
+				bPeriod	= 0;
+				bWindow	= 1;
+			}
+			if (block == dRun)
+			{
+				if (!bRun && bPeriod)
+					n = (bPeriod < BULKONLYCARD_READ_AHEAD) ? bPeriod : BULKONLYCARD_READ_AHEAD;
+				else
+					n = (bWindow < BULKONLYCARD_READ_AHEAD / 2) ? bWindow << 1 : BULKONLYCARD_READ_AHEAD;
+
+				bWindow = n;
+			}
+			else
+			{
+				if (bRun)
+					bPeriod = bRun;
+
+				bRun = 0;
+				dAlt = block + 1;
+			}
+			if (block < dBlocks && dBlocks - block < n)
+				n = dBlocks - block;
+
+			if (!Result(pBulk->ReadStart(bLun, block, BULKONLYCARD_BLOCK_SIZE, n)))
+				return false;
+
+			wLeft = n;
+			dNext = block;
+		}
+		wLeft --;
+		dNext ++;
+
+		if (block == dRun)
+		{
+			dRun ++;
+
+			if (bRun < 0xff)
+				bRun ++;
+		}
+
+		if (!Result(pBulk->ReadData(BULKONLYCARD_BLOCK_SIZE, dst)))
+		{
+			wLeft = 0;
+			return false;
+		}
+		return true;
+	};
+	virtual bool readStart(uint32_t block)
+	{
+		dSeq = block;
+		return true;
+	};
+	virtual bool readData(uint8_t *dst)
+	{
+		return readBlock(dSeq++, dst);
+	};
+	// the read stays open for the blocks after it
+	virtual bool readStop() { return true; };
+
+	virtual bool writeBlock(uint32_t block, const uint8_t *src)
+	{
+		return EndWrite() && EndRead() && Result(pBulk->Write(bLun, block, BULKONLYCARD_BLOCK_SIZE, 1, src));
+	};
+	virtual bool writeStart(uint32_t block, uint32_t count)
+	{
+		if (!EndWrite() || !EndRead())
+			return false;
+
+		dWrite		= block;
+		dWriteEnd	= block + count;
+		return true;
+	};
+	virtual bool writeData(const uint8_t *src)
+	{
+		if (!bWriteLeft)
+		{
+			// one block at a time past the end of the range
+			uint32_t n = (dWrite < dWriteEnd) ? dWriteEnd - dWrite : 1;
+
+			if (n > BULKONLYCARD_WRITE_CHUNK)
+				n = BULKONLYCARD_WRITE_CHUNK;
+
+			if (dWrite < dBlocks && dBlocks - dWrite < n)
+				n = dBlocks - dWrite;
+
+			if (!Result(pBulk->WriteStart(bLun, dWrite, BULKONLYCARD_BLOCK_SIZE, n)))
+				return false;
+
+			bWriteLeft = n;
+		}
+		bWriteLeft --;
+		dWrite ++;
+
+		if (!Result(pBulk->WriteData(BULKONLYCARD_BLOCK_SIZE, src)))
+		{
+			bWriteLeft = 0;
+			return false;
+		}
+		return true;
+	};
+	virtual bool writeStop()
+	{
+		return EndWrite();
+	};
+};
+
+#endif // __BULKONLYCARD_H__
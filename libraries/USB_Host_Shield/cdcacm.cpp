@@ -176,7 +176,8 @@ uint8_t ACM::Init(uint8_t parent, uint8_t port, bool lowspeed)
 	USBTRACE("ACM configured\r\n");
 	ready = true;
 
-	//bPollEnable = true;
+	StreamOpen(epInfo[epDataInIndex].maxPktSize, epInfo[epDataOutIndex].maxPktSize, 0);
+	bPollEnable = true;
 
 	//USBTRACE("Poll enabled\r\n");
 	return 0;
@@ -238,6 +239,7 @@ void ACM::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint8_t proto
 
 uint8_t ACM::Release()
 {
+	StreamClose();
 	pUsb->GetAddressPool().FreeAddress(bAddress);
 
 	bControlIface		= 0;	
@@ -258,6 +260,8 @@ uint8_t ACM::Poll()
 	if (!bPollEnable)
 		return 0;
 
+	rcode = StreamTask();
+
 	//uint32_t	time_now = millis();
 
 	//if (qNextPollTime <= time_now)
@@ -298,6 +302,16 @@ uint8_t ACM::SndData(uint16_t nbytes, uint8_t *dataptr)
 	return pUsb->outTransfer(bAddress, epInfo[epDataOutIndex].epAddr, nbytes, dataptr);
 }
 
+uint8_t ACM::StreamIn(uint8_t npkts)
+{
+	return pUsb->streamIn(bAddress, epInfo[epDataInIndex].epAddr, npkts, this);
+}
+
+uint8_t ACM::StreamOut(uint16_t nbytes, uint8_t *dataptr)
+{
+	return SndData(nbytes, dataptr);
+}
+
 /* untested */
 uint8_t ACM::GetNotif( uint16_t *bytes_rcvd, uint8_t *dataptr )
 {
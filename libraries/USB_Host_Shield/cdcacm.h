@@ -36,6 +36,7 @@ e-mail   :  support@circuitsathome.com
 #include "message.h"
 
 #include "confdescparser.h"
+#include "cdcstream.h"
 
 #define bmREQ_CDCOUT        USB_SETUP_HOST_TO_DEVICE|USB_SETUP_TYPE_CLASS|USB_SETUP_RECIPIENT_INTERFACE
 #define bmREQ_CDCIN         USB_SETUP_DEVICE_TO_HOST|USB_SETUP_TYPE_CLASS|USB_SETUP_RECIPIENT_INTERFACE 
@@ -134,7 +135,7 @@ typedef struct
 	uint8_t		bCharFormat;		// 0 - 1 stop bit, 1 - 1.5 stop bits, 2 - 2 stop bits
 	uint8_t		bParityType;		// 0 - None, 1 - Odd, 2 - Even, 3 - Mark, 4 - Space
 	uint8_t		bDataBits;			// Data bits (5, 6, 7, 8 or 16)
-} LINE_CODING;
+} __attribute__((packed)) LINE_CODING;		// 7 bytes on the wire
 
 typedef struct
 {
@@ -159,7 +160,7 @@ public:
 
 #define ACM_MAX_ENDPOINTS			4
 
-class ACM : public USBDeviceConfig, public UsbConfigXtracter
+class ACM : public USBDeviceConfig, public UsbConfigXtracter, public CDCStream
 {
 protected:
 	static const uint8_t	epDataInIndex;			// DataIn endpoint index
@@ -181,6 +182,10 @@ protected:
 
 	void PrintEndpointDescriptor(const USB_ENDPOINT_DESCRIPTOR* ep_ptr);
 
+	// CDCStream implementation
+	virtual uint8_t StreamIn(uint8_t npkts);
+	virtual uint8_t StreamOut(uint16_t nbytes, uint8_t *dataptr);
+
 public:
 	ACM(USB *pusb, CDCAsyncOper *pasync);
 
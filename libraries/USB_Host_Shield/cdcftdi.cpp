@@ -173,6 +173,7 @@ uint8_t FTDI::Init(uint8_t parent, uint8_t port, bool lowspeed)
 
 	USBTRACE("FTDI configured\r\n");
 
+	StreamOpen(epInfo[epDataInIndex].maxPktSize, epInfo[epDataOutIndex].maxPktSize, 2);
 	bPollEnable = true;
 	return 0;
 
@@ -241,6 +242,7 @@ void FTDI::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint8_t prot
 
 uint8_t FTDI::Release()
 {
+	StreamClose();
 	pUsb->GetAddressPool().FreeAddress(bAddress);
 
 	bAddress			= 0;
@@ -257,6 +259,8 @@ uint8_t FTDI::Poll()
 	//if (!bPollEnable)
 	//	return 0;
 
+	rcode = StreamTask();
+
 	//if (qNextPollTime <= millis())
 	//{
 	//	Serial.println(bAddress, HEX);
@@ -329,6 +333,17 @@ uint8_t FTDI::SndData(uint16_t nbytes, uint8_t *dataptr)
 	return pUsb->outTransfer(bAddress, epInfo[epDataOutIndex].epAddr, nbytes, dataptr);
 }
 
+// Every IN packet starts with the modem and line status bytes, StreamOpen() was told to keep them out of the ring
+uint8_t FTDI::StreamIn(uint8_t npkts)
+{
+	return pUsb->streamIn(bAddress, epInfo[epDataInIndex].epAddr, npkts, this);
+}
+
+uint8_t FTDI::StreamOut(uint16_t nbytes, uint8_t *dataptr)
+{
+	return SndData(nbytes, dataptr);
+}
+
 void FTDI::PrintEndpointDescriptor( const USB_ENDPOINT_DESCRIPTOR* ep_ptr )
 {
 	Notify(PSTR("Endpoint descriptor:"));
@@ -36,6 +36,7 @@ e-mail   :  support@circuitsathome.com
 #include "message.h"
 
 #include "confdescparser.h"
+#include "cdcstream.h"
 
 #define bmREQ_FTDI_OUT  0x40
 #define bmREQ_FTDI_IN   0xc0
@@ -105,7 +106,7 @@ public:
 //		so only three endpoints are allocated.
 #define FTDI_MAX_ENDPOINTS					3
 
-class FTDI : public USBDeviceConfig, public UsbConfigXtracter
+class FTDI : public USBDeviceConfig, public UsbConfigXtracter, public CDCStream
 {
 	static const uint8_t	epDataInIndex;			// DataIn endpoint index
 	static const uint8_t	epDataOutIndex;			// DataOUT endpoint index
@@ -125,6 +126,11 @@ class FTDI : public USBDeviceConfig, public UsbConfigXtracter
 
 	void PrintEndpointDescriptor(const USB_ENDPOINT_DESCRIPTOR* ep_ptr);
 
+protected:
+	// CDCStream implementation
+	virtual uint8_t StreamIn(uint8_t npkts);
+	virtual uint8_t StreamOut(uint16_t nbytes, uint8_t *dataptr);
+
 public:
 	FTDI(USB *pusb, FTDIAsyncOper *pasync);
 
@@ -137,6 +143,10 @@ public:
 	uint8_t RcvData(uint16_t *bytes_rcvd, uint8_t *dataptr);
 	uint8_t SndData(uint16_t nbytes, uint8_t *dataptr);
 
+	// Status bytes of the last packet the Stream received
+	uint8_t GetModemStatus() { return GetHeader()[0]; };
+	uint8_t GetLineStatus() { return GetHeader()[1]; };
+
 	// USBDeviceConfig implementation
 	virtual uint8_t Init(uint8_t parent, uint8_t port, bool lowspeed);
 	virtual uint8_t Release();
@@ -186,7 +186,8 @@ uint8_t PL2303::Init(uint8_t parent, uint8_t port, bool lowspeed)
 
 	USBTRACE("PL configured\r\n");
 
-	//bPollEnable = true;
+	StreamOpen(epInfo[epDataInIndex].maxPktSize, epInfo[epDataOutIndex].maxPktSize, 0);
+	bPollEnable = true;
 	ready = true;
 	return 0;
 
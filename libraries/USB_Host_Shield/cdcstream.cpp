@@ -0,0 +1,212 @@
+/* Copyright (C) 2011 Circuits At Home, LTD. All rights reserved.
+
+This software may be distributed and modified under the terms of the GNU
+General Public License version 2 (GPL2) as published by the Free Software
+Foundation and appearing in the file GPL2.TXT included in the packaging of
+this file. Please note that GPL2 Section 2[b] requires that all works based
+on this software must also be made publicly available under the terms of
+the GPL2 ("Copyleft").
+
+Contact information
+-------------------
+
+Circuits At Home, LTD
+Web      :  http://www.circuitsathome.com
+e-mail   :  support@circuitsathome.com
+*/
+#include "cdcstream.h"
+
+CDCStream::CDCStream() :
+	rxHead(0),
+	rxTail(0),
+	bRxPayload(0),
+	bHeader(0),
+	txLen(0),
+	bTxPacket(0),
+	qTxTime(0),
+	bStreaming(false),
+	bOpen(false)
+{
+	bHeaderBuf[0] = 0;
+	bHeaderBuf[1] = 0;
+}
+
+void CDCStream::StreamOpen(uint8_t in_pkt, uint8_t out_pkt, uint8_t header)
+{
+	if (header > sizeof(bHeaderBuf))
+		header = sizeof(bHeaderBuf);
+
+	bHeader		= header;
+	bRxPayload	= in_pkt - header;
+	bTxPacket	= (out_pkt && out_pkt < CDC_TX_BUFFER_SIZE) ? out_pkt : CDC_TX_BUFFER_SIZE;
+	rxHead		= 0;
+	rxTail		= 0;
+	txLen		= 0;
+	bOpen		= true;
+}
+
+void CDCStream::StreamClose()
+{
+	bOpen		= false;
+	txLen		= 0;
+}
+
+void CDCStream::end()
+{
+	flush();
+	bStreaming	= false;
+	rxHead		= 0;
+	rxTail		= 0;
+}
+
+uint8_t CDCStream::StreamTask()
+{
+	uint8_t rcode = 0;
+
+	if (!bOpen)
+		return 0;
+
+	// Send a partly filled packet nobody added to for a while
+	if (txLen && (uint32_t)(millis() - qTxTime) >= CDC_TX_FLUSH_TIME)
+	{
+		rcode = StreamOut(txLen, txBuf);
+
+		if (!rcode)
+			txLen = 0;
+		else if (rcode == hrNAK)					// try again on the next Poll()
+			rcode = 0;
+	}
+	if (bStreaming)
+	{
+		uint8_t rcv = StreamIn(CDC_RX_BURST);
+
+		if (rcv && rcv != hrNAK)
+			rcode = rcv;
+	}
+	return rcode;
+}
+
+// The packet being read and everything after it has to fit, a full FIFO would block the bus
+bool CDCStream::Room(uint8_t npkts)
+{
+	uint8_t free = rxTail - rxHead - 1;
+
+	return (free >= (uint16_t)npkts * bRxPayload);
+}
+
+void CDCStream::Read(USB *pusb, uint8_t nbytes)
+{
+	uint8_t h = (nbytes < bHeader) ? nbytes : bHeader;
+
+	if (h)
+	{
+		pusb->bytesRd(rRCVFIFO, h, bHeaderBuf);		// modem and line status for FTDI
+		nbytes -= h;
+	}
+	if (nbytes > bRxPayload)						// Room() only made space for a full packet
+		nbytes = bRxPayload;
+
+	uint16_t first = CDC_RX_BUFFER_SIZE - rxHead;	// up to the end of the ring
+
+	if (nbytes <= first)
+		pusb->bytesRd(rRCVFIFO, nbytes, rxBuf + rxHead);
+	else
+	{
+		pusb->bytesRd(rRCVFIFO, first, rxBuf + rxHead);
+		pusb->bytesRd(rRCVFIFO, nbytes - first, rxBuf);
+	}
+	rxHead += nbytes;
+}
+
+int CDCStream::available()
+{
+	return (uint8_t)(rxHead - rxTail);
+}
+
+int CDCStream::read()
+{
+	if (rxHead == rxTail)
+		return -1;
+
+	return rxBuf[rxTail++];
+}
+
+int CDCStream::peek()
+{
+	if (rxHead == rxTail)
+		return -1;
+
+	return rxBuf[rxTail];
+}
+
+// Sends txBuf, waiting while the device NAKs
+uint8_t CDCStream::SendPending()
+{
+	uint8_t rcode = 0;
+	unsigned long timeout = millis() + USB_XFER_TIMEOUT;
+
+	while (txLen)
+	{
+		rcode = StreamOut(txLen, txBuf);
+
+		if (!rcode)
+			txLen = 0;
+		else if (rcode != hrNAK || millis() > timeout)
+			break;
+	}
+	return rcode;
+}
+
+void CDCStream::flush()
+{
+	if (bOpen)
+		SendPending();
+}
+
+size_t CDCStream::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t CDCStream::write(const uint8_t *buffer, size_t size)
+{
+	size_t done = 0;
+
+	if (!bOpen)
+		return 0;
+
+	while (done < size)
+	{
+		size_t left = size - done;
+
+		// Whole packets go straight from the caller's buffer
+		if (!txLen && left >= bTxPacket)
+		{
+			unsigned long timeout = millis() + USB_XFER_TIMEOUT;
+			uint8_t rcode;
+
+			while ((rcode = StreamOut(bTxPacket, (uint8_t*)buffer + done)) == hrNAK && millis() <= timeout);
+
+			if (rcode)
+				break;
+
+			done += bTxPacket;
+			continue;
+		}
+		uint8_t n = bTxPacket - txLen;
+
+		if (n > left)
+			n = left;
+
+		if (!txLen)
+			qTxTime = millis();
+
+		memcpy(txBuf + txLen, buffer + done, n);
+		txLen += n;
+		done += n;
+
+		if (txLen == bTxPacket && SendPending())
+			break;
+	}
+	return done;
+}
@@ -0,0 +1,104 @@
+/* Copyright (C) 2011 Circuits At Home, LTD. All rights reserved.
+
+This software may be distributed and modified under the terms of the GNU
+General Public License version 2 (GPL2) as published by the Free Software
+Foundation and appearing in the file GPL2.TXT included in the packaging of
+this file. Please note that GPL2 Section 2[b] requires that all works based
+on this software must also be made publicly available under the terms of
+the GPL2 ("Copyleft").
+
+Contact information
+-------------------
+
+Circuits At Home, LTD
+Web      :  http://www.circuitsathome.com
+e-mail   :  support@circuitsathome.com
+*/
+#if !defined(__CDCSTREAM_H__)
+#define __CDCSTREAM_H__
+
+// Serial port Stream for the USB serial adapters (ACM, PL2303 and FTDI).
+//
+// After begin() the driver's Poll(), called from USB::Task(), reads the bulk
+// IN endpoint with USB::streamIn(), which keeps both receive FIFOs busy, and
+// puts the data straight into a ring buffer that read(), peek() and
+// available() take it from.  Status bytes the chip puts at the start of each
+// packet (two for FTDI) are read out of the FIFO on their own and never
+// reach the ring.
+//
+// Bytes written are collected into packets: a packet is sent as soon as it
+// is full, a partly filled one by the next Poll() after CDC_TX_FLUSH_TIME
+// ms, or by flush().  Writes of whole packets are sent from the caller's
+// buffer without a copy.
+//
+// RcvData() and SndData() still work, but should not be mixed with the
+// Stream on the same device.
+
+#include <inttypes.h>
+#include "avrpins.h"
+#include "max3421e.h"
+#include "usbhost.h"
+#include "Usb.h"
+
+#if defined(ARDUINO) && ARDUINO >=100
+#include "Arduino.h"
+#else
+#include <WProgram.h>
+#endif
+
+#define CDC_RX_BUFFER_SIZE		256		// ring for received data, the uint8_t indices wrap around by themselves
+#define CDC_TX_BUFFER_SIZE		64		// a full speed bulk packet
+#define CDC_TX_FLUSH_TIME		2		// ms a partly filled packet waits for more bytes
+#define CDC_RX_BURST			8		// packets read in one Poll() at most
+
+class CDCStream : public Stream, public USBFifoReader
+{
+	uint8_t			rxBuf[CDC_RX_BUFFER_SIZE];
+	uint8_t			rxHead;					// where Read() puts the next byte
+	uint8_t			rxTail;					// where read() takes the next byte
+	uint8_t			bRxPayload;				// data bytes in a full IN packet
+	uint8_t			bHeader;				// status bytes at the start of each IN packet
+	uint8_t			bHeaderBuf[2];			// the last ones received
+
+	uint8_t			txBuf[CDC_TX_BUFFER_SIZE];
+	uint8_t			txLen;
+	uint8_t			bTxPacket;				// bytes in a full OUT packet
+	uint32_t		qTxTime;				// millis() when the first byte in txBuf was written
+
+	bool			bStreaming;				// begin() was called
+	bool			bOpen;					// the device is configured
+
+	uint8_t SendPending();
+
+protected:
+	// Implemented by the driver with its endpoints
+	virtual uint8_t StreamIn(uint8_t npkts) = 0;
+	virtual uint8_t StreamOut(uint16_t nbytes, uint8_t *dataptr) = 0;
+
+	void StreamOpen(uint8_t in_pkt, uint8_t out_pkt, uint8_t header);
+	void StreamClose();
+	uint8_t StreamTask();					// called from the driver's Poll()
+
+	const uint8_t* GetHeader() { return bHeaderBuf; };
+
+public:
+	CDCStream();
+
+	void begin() { bStreaming = true; };
+	void end();
+
+	// Stream implementation
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+
+	// USBFifoReader implementation
+	virtual bool Room(uint8_t npkts);
+	virtual void Read(USB *pusb, uint8_t nbytes);
+};
+
+#endif // __CDCSTREAM_H__
@@ -0,0 +1,91 @@
+
+#include <avr/pgmspace.h>
+
+#include <avrpins.h>
+#include <max3421e.h>
+#include <usbhost.h>
+#include <usb_ch9.h>
+#include <Usb.h>
+#include <usbhub.h>
+#include <avr/pgmspace.h>
+#include <address.h>
+#include <hid.h>
+#include <hiduniversal.h>
+#include <hidreportdecoder.h>
+
+#include <printhex.h>
+#include <message.h>
+#include <hexdump.h>
+#include <parsetools.h>
+
+// Decodes any joystick or gamepad from its report descriptor: the controls
+// below are copied into pad for loop() to use, and every control that
+// changes is printed.
+
+struct Pad
+{
+  int16_t   x, y, z, rz;
+  uint8_t   hat;
+  uint16_t  buttons;          // buttons 1-16, one bit each
+};
+
+const HIDUsageMap padMap[] PROGMEM = {
+  { 0x01, 0x30, 1,  offsetof(Pad, x),       2 },
+  { 0x01, 0x31, 1,  offsetof(Pad, y),       2 },
+  { 0x01, 0x32, 1,  offsetof(Pad, z),       2 },
+  { 0x01, 0x35, 1,  offsetof(Pad, rz),      2 },
+  { 0x01, 0x39, 1,  offsetof(Pad, hat),     1 },
+  { 0x09, 0x01, 16, offsetof(Pad, buttons), 2 }
+};
+
+#define PAD_MAP_SIZE  (sizeof(padMap) / sizeof(HIDUsageMap))
+
+class PadDecoder : public HIDReportDecoder
+{
+public:
+  PadDecoder(HIDFieldCompiler *table, uint8_t *prev, uint8_t prev_size) : HIDReportDecoder(table, prev, prev_size) {};
+
+protected:
+  virtual void OnUsageChanged(const HIDField *field, uint8_t index, uint16_t usage, int32_t value);
+};
+
+void PadDecoder::OnUsageChanged(const HIDField *field, uint8_t index, uint16_t usage, int32_t value)
+{
+  PrintHex<uint16_t>(field->wUsagePage);
+  Serial.print(":");
+  PrintHex<uint16_t>(usage);
+  Serial.print(" = ");
+  Serial.println(value);
+}
+
+USB                                             Usb;
+USBHub                                          Hub(&Usb);
+HIDUniversal                                    Hid(&Usb);
+
+HIDField                                        fields[16];
+HIDFieldCompiler                                table(fields, 16);
+HIDBinding                                      bind[PAD_MAP_SIZE];
+uint8_t                                         prev[64];
+PadDecoder                                      Dec(&table, prev, sizeof(prev));
+Pad                                             pad;
+
+void setup()
+{
+  Serial.begin( 115200 );
+  Serial.println("Start");
+
+  if (Usb.Init() == -1)
+      Serial.println("OSC did not start.");
+
+  delay( 200 );
+
+  Dec.Bind(padMap, bind, PAD_MAP_SIZE, &pad);
+
+  if (!Hid.SetReportParser(0, &Dec))
+      ErrorMessage<uint8_t>(PSTR("SetReportParser"), 1  );
+}
+
+void loop()
+{
+    Usb.Task();
+}
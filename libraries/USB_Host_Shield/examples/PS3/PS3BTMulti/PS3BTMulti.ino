@@ -0,0 +1,50 @@
+/*
+ Example sketch for the PS3 Bluetooth library - up to four controllers on one dongle
+ Every controller gets its own LED, LED1 for controller 0 and so on
+ */
+
+#include <PS3BT.h>
+USB Usb;
+PS3BT PS3(&Usb);
+
+void setup()
+{
+  Serial.begin(115200);
+
+  if (Usb.Init() == -1) {
+    Serial.print(F("\r\nOSC did not start"));
+    while(1); //halt
+  }
+  Serial.print(F("\r\nPS3 Bluetooth Library Started"));
+}
+void loop()
+{
+  Usb.Task();
+
+  for(uint8_t i = 0; i < PS3_MAX_CONTROLLERS; i++) {
+    if(PS3.getControllerType(i) == NoController)
+      continue;
+
+    Button b;
+    bool pressed;
+    while(PS3.getButtonEvent(&b, &pressed, i)) { // Every button change since the last loop, in the order they happened
+      Serial.print(F("\r\nController "));
+      Serial.print(i);
+      Serial.print(F(" button "));
+      Serial.print((uint16_t)b, HEX);
+      if(pressed)
+        Serial.print(F(" pressed"));
+      else
+        Serial.print(F(" released"));
+
+      if(b == PS && pressed)
+        PS3.disconnect(i);
+      else if(b == CROSS && PS3.getControllerType(i) == Dualshock3) { // Rumble while cross is held down
+        if(pressed)
+          PS3.setRumbleOn(RumbleLow, i);
+        else
+          PS3.setRumbleOff(i);
+      }
+    }
+  }
+}
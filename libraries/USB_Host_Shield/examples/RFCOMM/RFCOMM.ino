@@ -5,6 +5,7 @@
  */
 
 #include <RFCOMM.h>
+#include <CRC.h>
 USB Usb;
 /* You can create the instance of the class in two ways */
 RFCOMM SerialBT(&Usb); // This will set the name to the defaults: "Arduino" and the pin to "1234"
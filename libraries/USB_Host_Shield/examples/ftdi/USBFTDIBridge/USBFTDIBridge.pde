@@ -0,0 +1,76 @@
+#include <avrpins.h>
+#include <max3421e.h>
+#include <usbhost.h>
+#include <usb_ch9.h>
+#include <Usb.h>
+#include <usbhub.h>
+#include <avr/pgmspace.h>
+#include <address.h>
+
+#include <cdcftdi.h>
+
+#include <printhex.h>
+#include <message.h>
+#include <hexdump.h>
+#include <parsetools.h>
+
+// Connects the Arduino serial port to an FTDI adapter, both ways.
+// The FTDI is used as a Stream: Usb.Task() keeps receiving into its buffer,
+// and bytes written to it are sent in full packets.
+
+class FTDIAsync : public FTDIAsyncOper
+{
+public:
+    virtual uint8_t OnInit(FTDI *pftdi);
+};
+
+uint8_t FTDIAsync::OnInit(FTDI *pftdi)
+{
+    uint8_t rcode = 0;
+
+    rcode = pftdi->SetBaudRate(115200);
+
+    if (rcode)
+    {
+        ErrorMessage<uint8_t>(PSTR("SetBaudRate"), rcode);
+        return rcode;
+    }
+    rcode = pftdi->SetFlowControl(FTDI_SIO_DISABLE_FLOW_CTRL);
+
+    if (rcode)
+        ErrorMessage<uint8_t>(PSTR("SetFlowControl"), rcode);
+
+    return rcode;
+}
+
+USB              Usb;
+//USBHub         Hub(&Usb);
+FTDIAsync        FtdiAsync;
+FTDI             Ftdi(&Usb, &FtdiAsync);
+
+void setup()
+{
+  Serial.begin( 115200 );
+  Serial.println("Start");
+
+  if (Usb.Init() == -1)
+      Serial.println("OSC did not start.");
+
+  delay( 200 );
+
+  Ftdi.begin();
+}
+
+void loop()
+{
+    Usb.Task();
+
+    if( Usb.getUsbTaskState() == USB_STATE_RUNNING )
+    {
+        while (Serial.available())
+            Ftdi.write(Serial.read());
+
+        while (Ftdi.available())
+            Serial.write(Ftdi.read());
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ Lists the files of a FAT formatted USB drive with the SdFat library and
+ times a sequential read of the first file.
+
+ USE_SD_BLOCK_DEVICE must be set nonzero in SdFatConfig.h.
+ */
+#include <avrpins.h>
+#include <max3421e.h>
+#include <usbhost.h>
+#include <usb_ch9.h>
+#include <Usb.h>
+#include <address.h>
+
+#include <SdFat.h>
+#include <masstorage.h>
+#include <bulkonlycard.h>
+
+USB             Usb;
+BulkOnly        Bulk(&Usb);
+BulkOnlyCard    Drive(&Bulk);
+SdFat           sd;
+
+bool mounted = false;
+
+void setup()
+{
+  Serial.begin( 115200 );
+  Serial.println("Start");
+
+  if (Usb.Init() == -1)
+      Serial.println("OSC did not start.");
+
+  delay( 200 );
+}
+
+void loop()
+{
+  Usb.Task();
+
+  if (mounted || !Bulk.GetAddress())
+    return;
+
+  mounted = true;
+
+  if (!Drive.begin() || !sd.begin(&Drive))
+  {
+    Serial.print("Mount failed: 0x");
+    Serial.println(Drive.errorData(), HEX);
+    return;
+  }
+  sd.ls(LS_SIZE);
+
+  SdFile file;
+  uint8_t buf[64];
+
+  if (!file.openNext(sd.vwd(), O_READ))
+    return;
+
+  uint32_t t = millis();
+  uint32_t size = 0;
+  int n;
+
+  while ((n = file.read(buf, sizeof(buf))) > 0)
+    size += n;
+
+  t = millis() - t;
+  file.close();
+
+  Serial.print(size);
+  Serial.print(" bytes read in ");
+  Serial.print(t);
+  Serial.println(" ms");
+}
@@ -0,0 +1,360 @@
+/*
+ CdcStream - the serial drivers' Stream against FTDI and ACM adapters
+
+ An FT232R and a CDC ACM adapter are enumerated in turn by the real FTDI
+ and ACM drivers, set up the way the examples do in OnInit().  Each
+ receives a numbered byte stream at a set baud rate into a 512 byte
+ buffer, and loses what does not fit.  The FTDI one sends full 62 byte
+ packets, or what it has once its 16 ms latency timer runs out, each after
+ the modem and line status bytes; the ACM one sends whatever it has.  OUT
+ packets are NAKed one time in eight.  SPI bytes take 1.2 us.
+
+ The sketch reads with available(), peek() and read() after Usb.Task(),
+ stalling up to 3 ms now and then, and every byte is checked.  With the
+ device never empty the Stream is timed against a loop calling RcvData(),
+ and single byte writes are checked to go out in full packets.
+
+ Usage: CdcStream
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <Usb.h>
+#include <cdcftdi.h>
+#include <cdcacm.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+static int failures, checks;
+
+#define CHECK(c) do { checks++; if (!(c)) { failures++; printf("  FAIL line %d: %s\n", __LINE__, #c); } } while (0)
+#define CHECKEQ(a, b) do { checks++; long long a_ = (a), b_ = (b); if (a_ != b_) { failures++; \
+  printf("  FAIL line %d: %s = %lld, want %lld\n", __LINE__, #a, a_, b_); } } while (0)
+
+// byte k of the stream
+static uint8_t seqByte(uint64_t k) { return (uint8_t) (k * 7 + (k >> 8) + (k >> 13)); }
+
+class SerialSim : public UsbSimDevice {
+public:
+  SerialSim(bool ftdi) : UsbSimDevice(ftdi ? ftdiDevice : acmDevice, ftdi ? ftdiConfig : acmConfig),
+    ftdi(ftdi), lineCodingLength(0), baud(0), controlLines(0), vendorRequests(0), seed(1) {
+    restart(0);
+  }
+
+  static const uint64_t bufferSize = 512;
+  static const uint8_t modemStatus = 0x31, lineStatus = 0x60;
+
+  bool ftdi;
+  uint64_t sent, overrun;       // bytes of the stream sent, lost in the device
+  long inPkts, outPkts, outNaks;
+  std::vector<uint8_t> outData;
+
+  // requests from OnInit()
+  uint16_t lineCodingLength;
+  uint32_t baud;
+  uint8_t controlLines;
+  int vendorRequests;
+
+  // Starts the stream again, at bytes per second or never empty with 0
+  void restart(double bytesPerSec) {
+    rate = bytesPerSec / 1e9;
+    produced = sent = overrun = 0;
+    t0 = lastPkt = hostNanos;
+    inPkts = outPkts = outNaks = 0;
+    outData.clear();
+  }
+
+  virtual bool controlOut(const UsbSimSetup & s, const uint8_t * data, uint16_t len) {
+    if (ftdi) {
+      vendorRequests += s.bmRequestType == bmREQ_FTDI_OUT;
+      return s.bmRequestType == bmREQ_FTDI_OUT;
+    }
+    if (s.bRequest == CDC_SET_LINE_CODING) {
+      lineCodingLength = len;
+      baud = data[0] | data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+    } else if (s.bRequest == CDC_SET_CONTROL_LINE_STATE)
+      controlLines = s.wValue;
+    return true;
+  }
+
+  virtual int in(uint8_t ep, uint8_t * data) {
+    if (ep != 1)
+      return -1;
+    produce();
+    uint64_t avail = produced - sent;
+    uint64_t payload = ftdi ? 62 : 64;
+    if (ftdi ? avail < payload && hostNanos - lastPkt < 16000000ULL : !avail)
+      return -1;
+    uint64_t n = std::min(avail, payload);
+    int len = 0;
+    if (ftdi) {
+      data[len++] = modemStatus;
+      data[len++] = lineStatus;
+    }
+    for (uint64_t i = 0; i < n; i++)
+      data[len++] = seqByte(sent + i);
+    sent += n;
+    lastPkt = hostNanos;
+    inPkts++;
+    return len;
+  }
+
+  virtual bool out(uint8_t ep, const uint8_t * data, uint8_t len) {
+    if (ep != 2)
+      return false;
+    seed = seed * 1103515245 + 12345;
+    if (((seed >> 16) & 7) == 0) {
+      outNaks++;
+      return false;
+    }
+    outData.insert(outData.end(), data, data + len);
+    outPkts++;
+    return true;
+  }
+
+private:
+  static const uint8_t ftdiDevice[18], ftdiConfig[32];
+  static const uint8_t acmDevice[18], acmConfig[67];
+
+  double rate;                  // bytes per ns
+  uint64_t produced, t0, lastPkt;
+  uint32_t seed;
+
+  // What came in on the serial line since, up to the buffer size
+  void produce() {
+    if (rate == 0) {
+      produced = sent + bufferSize;
+      return;
+    }
+    uint64_t total = (uint64_t) ((hostNanos - t0) * rate);
+    uint64_t want = total - produced - overrun;
+    uint64_t room = bufferSize - (produced - sent);
+    if (want > room) {
+      overrun += want - room;
+      want = room;
+    }
+    produced += want;
+  }
+};
+
+// FT232R: vendor specific interface with bulk 0x81 and 0x02
+const uint8_t SerialSim::ftdiDevice[18] = {
+  18, 1, 0x00, 0x02, 0, 0, 0, 8, 0x03, 0x04, 0x01, 0x60, 0x00, 0x06, 1, 2, 3, 1
+};
+const uint8_t SerialSim::ftdiConfig[32] = {
+  9, 2, 32, 0, 1, 1, 0, 0x80, 45,
+  9, 4, 0, 0, 2, 0xff, 0xff, 0xff, 2,
+  7, 5, 0x81, 2, 64, 0, 0,
+  7, 5, 0x02, 2, 64, 0, 0
+};
+
+// CDC ACM: communication interface with its functional descriptors and
+// notification endpoint, data interface with bulk 0x81 and 0x02
+const uint8_t SerialSim::acmDevice[18] = {
+  18, 1, 0x00, 0x02, 0x02, 0, 0, 8, 0x34, 0x12, 0x78, 0x56, 0x00, 0x01, 1, 2, 3, 1
+};
+const uint8_t SerialSim::acmConfig[67] = {
+  9, 2, 67, 0, 2, 1, 0, 0x80, 50,
+  9, 4, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+  5, 0x24, 0x00, 0x10, 0x01,
+  5, 0x24, 0x01, 0x00, 0x01,
+  4, 0x24, 0x02, 0x02,
+  5, 0x24, 0x06, 0x00, 0x01,
+  7, 5, 0x83, 3, 8, 0, 16,
+  9, 4, 1, 0, 2, 0x0a, 0x00, 0x00, 0,
+  7, 5, 0x81, 2, 64, 0, 0,
+  7, 5, 0x02, 2, 64, 0, 0
+};
+
+// ---- sketch ----
+
+class FTDIAsync : public FTDIAsyncOper {
+public:
+  virtual uint8_t OnInit(FTDI * pftdi) {
+    uint8_t rcode = pftdi->SetBaudRate(115200);
+    if (!rcode)
+      rcode = pftdi->SetFlowControl(FTDI_SIO_DISABLE_FLOW_CTRL);
+    if (!rcode)
+      rcode = pftdi->SetModemControl(FTDI_SIO_SET_DTR_HIGH);
+    return rcode;
+  }
+};
+
+class ACMAsync : public CDCAsyncOper {
+public:
+  virtual uint8_t OnInit(ACM * pacm) {
+    uint8_t rcode = pacm->SetControlLineState(3);
+    if (rcode)
+      return rcode;
+    LINE_CODING lc;
+    lc.dwDTERate = 115200;
+    lc.bCharFormat = 0;
+    lc.bParityType = 0;
+    lc.bDataBits = 8;
+    return pacm->SetLineCoding(&lc);
+  }
+};
+
+USB Usb;
+FTDIAsync ftdiAsync;
+ACMAsync acmAsync;
+FTDI Ftdi(&Usb, &ftdiAsync);
+ACM Acm(&Usb, &acmAsync);
+
+static uint32_t rng = 777;
+static uint32_t rnd(uint32_t n) {
+  rng = rng * 1103515245 + 12345;
+  return (rng >> 16) % n;
+}
+
+static void step() {
+  Usb.Task();
+  hostAdvance(20000);
+}
+
+static bool enumerate(SerialSim * dev) {
+  Max3421eSim::attach(dev);
+  for (unsigned long t = millis(); Usb.getUsbTaskState() != USB_STATE_RUNNING && millis() - t < 2000; )
+    step();
+  return Usb.getUsbTaskState() == USB_STATE_RUNNING;
+}
+
+// 3 s of the stream at baud, read a few bytes at a time, sometimes with a
+// long stall in between
+static void integrity(CDCStream & s, SerialSim & dev, const char * name, double baud) {
+  dev.restart(baud / 10);
+  s.begin();
+  uint64_t got = 0, bad = 0, end = hostNanos + 3000000000ULL;
+  while (hostNanos < end) {
+    Usb.Task();
+    int k = rnd(4) ? 1 << 30 : rnd(4);    // mostly everything there is
+    for (int i = 0; i < k && s.available(); i++) {
+      int p = s.peek(), c = s.read();
+      if (p != c || c != seqByte(got))
+        bad++;
+      got++;
+    }
+    hostAdvance(rnd(50) ? 20000 : rnd(3000) * 1000ULL);   // something slow, up to 3 ms
+  }
+  for (int i = 0; i < 100; i++)
+    Usb.Task();
+  while (s.available()) {
+    if (s.read() != seqByte(got))
+      bad++;
+    got++;
+  }
+  s.end();
+  printf("  %-4s %7.0f baud  %8llu bytes  %llu wrong  %5llu lost in the device  %5ld IN packets\n", name, baud,
+         (unsigned long long) got, (unsigned long long) bad, (unsigned long long) dev.overrun, dev.inPkts);
+  CHECKEQ(bad, 0);
+  if (baud < 1000000)       // 3 ms at 3M baud is more than the device holds
+    CHECKEQ(dev.overrun, 0);
+  CHECKEQ(got, dev.sent);
+}
+
+// Bytes per second with the device never empty
+static double streamRate(CDCStream & s, SerialSim & dev) {
+  dev.restart(0);
+  s.begin();
+  uint64_t got = 0, bad = 0, start = hostNanos;
+  while (hostNanos - start < 200000000ULL) {
+    Usb.Task();
+    while (s.available())
+      bad += s.read() != seqByte(got++);
+  }
+  s.end();
+  CHECKEQ(bad, 0);
+  return got / ((hostNanos - start) / 1e9);
+}
+
+template <class D> static double rcvDataRate(D & d, SerialSim & dev) {
+  dev.restart(0);
+  uint8_t header = dev.ftdi ? 2 : 0;
+  uint64_t got = 0, bad = 0, start = hostNanos;
+  while (hostNanos - start < 200000000ULL) {
+    Usb.Task();
+    uint8_t buf[64];
+    uint16_t n = sizeof(buf);
+    if (d.RcvData(&n, buf) || n < header)
+      continue;
+    for (uint16_t i = header; i < n; i++)
+      bad += buf[i] != seqByte(got++);
+  }
+  CHECKEQ(bad, 0);
+  return got / ((hostNanos - start) / 1e9);
+}
+
+static void writes(CDCStream & s, SerialSim & dev, const char * name) {
+  dev.restart(1);
+  std::vector<uint8_t> expect;
+  // single bytes, with Usb.Task() in between now and then
+  for (int i = 0; i < 1000; i++) {
+    uint8_t c = seqByte(i);
+    CHECKEQ(s.write(c), 1);
+    expect.push_back(c);
+    if (i % 10 == 9) {
+      Usb.Task();
+      hostAdvance(50000);
+    }
+  }
+  long bytePkts = dev.outPkts;
+  // a buffer that is not a multiple of the packet size
+  std::vector<uint8_t> big(1000);
+  for (size_t i = 0; i < big.size(); i++)
+    big[i] = seqByte(5000 + i);
+  CHECKEQ(s.write(&big[0], big.size()), big.size());
+  expect.insert(expect.end(), big.begin(), big.end());
+  s.print("tail");
+  const char * tail = "tail";
+  expect.insert(expect.end(), tail, tail + 4);
+  for (int i = 0; i < 5; i++) {     // the timer sends the rest
+    Usb.Task();
+    hostAdvance(1000000);
+  }
+  CHECK(dev.outData == expect);
+  printf("  %-4s 1000 single byte writes in %ld packets, 1004 bytes in %ld packets, %ld NAKs\n", name, bytePkts,
+         dev.outPkts - bytePkts, dev.outNaks);
+  CHECK(bytePkts <= 1000 / 64 + 20);
+}
+
+int main() {
+  Max3421eSim::reset();
+  Max3421eSim::spiByteNs = 1200;
+  Usb.Init();
+  double baud[] = { 115200, 921600, 3000000 };
+
+  SerialSim ftdi(true);
+  CHECK(enumerate(&ftdi));
+  CHECKEQ(ftdi.vendorRequests, 3);
+  printf("FTDI\n");
+  for (int i = 0; i < 3; i++)
+    integrity(Ftdi, ftdi, "FTDI", baud[i]);
+  CHECKEQ(Ftdi.GetModemStatus(), SerialSim::modemStatus);
+  CHECKEQ(Ftdi.GetLineStatus(), SerialSim::lineStatus);
+  double fs = streamRate(Ftdi, ftdi), fr = rcvDataRate(Ftdi, ftdi);
+  writes(Ftdi, ftdi, "FTDI");
+
+  Max3421eSim::attach(NULL);
+  for (int i = 0; i < 100; i++)
+    step();
+
+  SerialSim acm(false);
+  CHECK(enumerate(&acm));
+  CHECKEQ(acm.controlLines, 3);
+  CHECKEQ(acm.lineCodingLength, 7);
+  CHECKEQ(acm.baud, 115200);
+  printf("ACM\n");
+  for (int i = 0; i < 3; i++)
+    integrity(Acm, acm, "ACM", baud[i]);
+  double as = streamRate(Acm, acm), ar = rcvDataRate(Acm, acm);
+  writes(Acm, acm, "ACM");
+
+  printf("throughput with the device never empty:\n");
+  printf("  FTDI Stream %6.0f B/s  RcvData loop %6.0f B/s  (%.2fx)\n", fs, fr, fs / fr);
+  printf("  ACM  Stream %6.0f B/s  RcvData loop %6.0f B/s  (%.2fx)\n", as, ar, as / ar);
+
+  CHECK(!Max3421eSim::toggleErrors && !Max3421eSim::overruns);
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
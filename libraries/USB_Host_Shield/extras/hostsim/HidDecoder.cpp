@@ -0,0 +1,659 @@
+/*
+ HidDecoder - HIDFieldCompiler and HIDReportDecoder on real descriptors
+
+ The field tables of a boot keyboard, a wheel mouse with report IDs, a
+ DragonRise gamepad and the 148 byte Sixaxis descriptor are checked, and
+ reports are decoded into structs and into changed usages.  Descriptors
+ laid out like the le3dp and XBOXUSB reports are decoded and compared with
+ those parsers' byte and bitfield reads.
+
+ For HIDReportDecoder the descriptor comes over USB: two HID devices
+ behind a hub are enumerated by HIDUniversal, and the decoder fetches the
+ descriptor with GetReportDescr() when it first sees a device.
+
+ The benchmark, in reports per second of host CPU time, re-parses the
+ descriptor for each report as UniversalReportParser did (without the
+ control transfer it also made) and decodes from the compiled table.
+
+ Usage: HidDecoder
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+#include <vector>
+#include <Usb.h>
+#include <usbhub.h>
+#include <hiduniversal.h>
+#include <hidreportdecoder.h>
+#include <hidescriptorparser.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+static int failures, checks;
+
+#define CHECK(c) do { checks++; if (!(c)) { failures++; printf("  FAIL line %d: %s\n", __LINE__, #c); } } while (0)
+#define CHECKEQ(a, b) do { checks++; long long a_ = (a), b_ = (b); if (a_ != b_) { failures++; \
+  printf("  FAIL line %d: %s = %lld, want %lld\n", __LINE__, #a, a_, b_); } } while (0)
+
+// The report descriptor the devices hand out, and how often it was asked for
+static const uint8_t * reportDescr;
+static uint16_t reportDescrLen;
+static int reportDescrRequests;
+
+// HID device with one interrupt IN endpoint that always NAKs; the reports
+// are given to the decoder by the test
+class HidSim : public UsbSimDevice {
+public:
+  HidSim() : UsbSimDevice(deviceDescr, configDescr) {}
+
+  virtual int controlIn(const UsbSimSetup & s, uint8_t * data) {
+    if (s.bRequest != 6 || (s.wValue >> 8) != 0x22)
+      return -1;
+    reportDescrRequests++;
+    memcpy(data, reportDescr, reportDescrLen);
+    return reportDescrLen;
+  }
+
+  virtual bool controlOut(const UsbSimSetup & s, const uint8_t *, uint16_t) {
+    return s.bRequest == 0x0a;    // SET_IDLE
+  }
+
+private:
+  static const uint8_t deviceDescr[18];
+  static const uint8_t configDescr[34];
+};
+
+const uint8_t HidSim::deviceDescr[18] = {
+  18, 1, 0x10, 0x01, 0, 0, 0, 8, 0x34, 0x12, 0x79, 0x56, 0x00, 0x01, 0, 0, 0, 1
+};
+
+const uint8_t HidSim::configDescr[34] = {
+  9, 2, 34, 0, 1, 1, 0, 0x80, 50,
+  9, 4, 0, 0, 1, 3, 0, 0, 0,
+  9, 0x21, 0x11, 0x01, 0, 1, 0x22, 148, 0,
+  7, 5, 0x81, 3, 8, 0, 10
+};
+
+USB Usb;
+USBHub Hub(&Usb);
+HIDUniversal Hid1(&Usb);
+HIDUniversal Hid2(&Usb);
+
+struct Change {
+  uint16_t page, usage;
+  int32_t value;
+};
+
+class Recorder : public HIDReportDecoder {
+public:
+  Recorder(HIDFieldCompiler * t, uint8_t * prev, uint8_t n) : HIDReportDecoder(t, prev, n) {}
+  std::vector<Change> changes;
+
+protected:
+  virtual void OnUsageChanged(const HIDField * f, uint8_t, uint16_t usage, int32_t value) {
+    Change c = { f->wUsagePage, usage, value };
+    changes.push_back(c);
+  }
+};
+
+static bool has(const std::vector<Change> & c, uint16_t page, uint16_t usage, int32_t value) {
+  for (size_t i = 0; i < c.size(); i++)
+    if (c[i].page == page && c[i].usage == usage && c[i].value == value)
+      return true;
+  return false;
+}
+
+// Hands the descriptor to the table in pieces, as a control transfer does
+static void compile(HIDFieldCompiler & t, const uint8_t * d, uint16_t n, uint16_t chunk) {
+  uint8_t buf[64];
+  for (uint16_t off = 0; off < n; off += chunk) {
+    uint16_t k = n - off < chunk ? n - off : chunk;
+    memcpy(buf, d + off, k);
+    t.Parse(k, buf, off);
+  }
+}
+
+static void dump(const char * name, HIDFieldCompiler & t) {
+  printf("%s: %u fields, %u reports%s\n", name, t.GetNumFields(), t.GetNumReports(),
+         t.HasReportId() ? ", report IDs" : "");
+  for (uint8_t i = 0; i < t.GetNumFields(); i++) {
+    const HIDField * f = t.GetField(i);
+    printf("  id %3u bit %4u size %2u x%3u flags %02x page %04x usage %04x logical %ld..%ld\n",
+           f->bReportId, f->wBitOffset, f->bSize, f->bCount, f->bmFlags, f->wUsagePage, f->wUsage,
+           (long) f->lLogicalMin, (long) f->lLogicalMax);
+  }
+}
+
+// HID 1.11 appendix B.1 boot keyboard, as most keyboards send it
+static const uint8_t kbdDescr[] = {
+  0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01,
+  0x75, 0x01, 0x95, 0x08, 0x81, 0x02, 0x95, 0x01, 0x75, 0x08, 0x81, 0x01, 0x95, 0x05, 0x75, 0x01,
+  0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02, 0x95, 0x01, 0x75, 0x03, 0x91, 0x01, 0x95, 0x06,
+  0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00, 0xC0
+};
+
+// Wheel mouse with tilt and a consumer control report, report IDs 1 and 3
+static const uint8_t mouseDescr[] = {
+  0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x05, 0x09, 0x19, 0x01,
+  0x29, 0x05, 0x15, 0x00, 0x25, 0x01, 0x95, 0x05, 0x75, 0x01, 0x81, 0x02, 0x95, 0x01, 0x75, 0x03,
+  0x81, 0x01, 0x05, 0x01, 0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x09, 0x30,
+  0x09, 0x31, 0x81, 0x06, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06,
+  0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06, 0xC0, 0xC0,
+  0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x03, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00,
+  0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00, 0xC0
+};
+
+// DragonRise generic USB gamepad (0079:0006), note the repeated Z usage
+static const uint8_t padDescr[] = {
+  0x05, 0x01, 0x09, 0x04, 0xA1, 0x01, 0xA1, 0x02, 0x75, 0x08, 0x95, 0x05, 0x15, 0x00, 0x26, 0xFF, 0x00,
+  0x35, 0x00, 0x46, 0xFF, 0x00, 0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02,
+  0x75, 0x04, 0x95, 0x01, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x65, 0x14, 0x09, 0x39, 0x81, 0x42, 0x65, 0x00,
+  0x75, 0x01, 0x95, 0x0C, 0x25, 0x01, 0x45, 0x01, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0C, 0x81, 0x02,
+  0x06, 0x00, 0xFF, 0x75, 0x01, 0x95, 0x08, 0x25, 0x01, 0x45, 0x01, 0x09, 0x01, 0x81, 0x02, 0xC0,
+  0xA1, 0x02, 0x75, 0x08, 0x95, 0x07, 0x46, 0xFF, 0x00, 0x26, 0xFF, 0x00, 0x09, 0x02, 0x91, 0x02, 0xC0, 0xC0
+};
+
+// A report laid out like the Logitech Extreme 3D Pro one examples/HID/le3dp
+// decodes by hand
+static const uint8_t le3dpDescr[] = {
+  0x05, 0x01, 0x09, 0x04, 0xA1, 0x01, 0xA1, 0x02,
+  0x75, 0x0A, 0x95, 0x02, 0x15, 0x00, 0x26, 0xFF, 0x03, 0x35, 0x00, 0x46, 0xFF, 0x03, 0x09, 0x30, 0x09, 0x31, 0x81, 0x02,
+  0x75, 0x04, 0x95, 0x01, 0x25, 0x07, 0x46, 0x3B, 0x01, 0x65, 0x14, 0x09, 0x39, 0x81, 0x42, 0x65, 0x00,
+  0x75, 0x08, 0x95, 0x01, 0x26, 0xFF, 0x00, 0x46, 0xFF, 0x00, 0x09, 0x35, 0x81, 0x02,
+  0xA4,
+  0x75, 0x01, 0x95, 0x08, 0x25, 0x01, 0x45, 0x01, 0x05, 0x09, 0x19, 0x01, 0x29, 0x08, 0x81, 0x02,
+  0xB4,
+  0x09, 0x36, 0x81, 0x02,
+  0x75, 0x01, 0x95, 0x04, 0x25, 0x01, 0x45, 0x01, 0x05, 0x09, 0x19, 0x09, 0x29, 0x0C, 0x81, 0x02,
+  0x95, 0x04, 0x81, 0x01,
+  0xC0, 0xC0
+};
+
+// Sony Sixaxis / DualShock 3, 148 bytes
+static const uint8_t ps3Descr[] = {
+  0x05, 0x01, 0x09, 0x04, 0xA1, 0x01, 0xA1, 0x02, 0x85, 0x01, 0x75, 0x08, 0x95, 0x01, 0x15, 0x00,
+  0x26, 0xFF, 0x00, 0x81, 0x03, 0x75, 0x01, 0x95, 0x13, 0x15, 0x00, 0x25, 0x01, 0x35, 0x00, 0x45, 0x01,
+  0x05, 0x09, 0x19, 0x01, 0x29, 0x13, 0x81, 0x02, 0x75, 0x01, 0x95, 0x0D, 0x06, 0x00, 0xFF, 0x81, 0x03,
+  0x15, 0x00, 0x26, 0xFF, 0x00, 0x05, 0x01, 0x09, 0x01, 0xA1, 0x00, 0x75, 0x08, 0x95, 0x04, 0x35, 0x00,
+  0x46, 0xFF, 0x00, 0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02, 0xC0, 0x05, 0x01,
+  0x95, 0x13, 0x09, 0x01, 0x81, 0x02, 0x95, 0x0C, 0x81, 0x01, 0x75, 0x10, 0x95, 0x04, 0x26, 0xFF, 0x03,
+  0x46, 0xFF, 0x03, 0x09, 0x01, 0x81, 0x02, 0xC0, 0xA1, 0x02, 0x85, 0x02, 0x75, 0x08, 0x95, 0x30,
+  0x09, 0x01, 0xB1, 0x02, 0xC0, 0xA1, 0x02, 0x85, 0xEE, 0x75, 0x08, 0x95, 0x30, 0x09, 0x01, 0xB1, 0x02,
+  0xC0, 0xA1, 0x02, 0x85, 0xEF, 0x75, 0x08, 0x95, 0x30, 0x09, 0x01, 0xB1, 0x02, 0xC0, 0xC0
+};
+
+// The Xbox 360 pad is not HID class; this describes the report XBOXUSB reads
+static const uint8_t xboxDescr[] = {
+  0x05, 0x01, 0x09, 0x05, 0xA1, 0x01,
+  0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x02, 0x06, 0x00, 0xFF, 0x09, 0x01, 0x09, 0x02, 0x81, 0x02,
+  0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x10, 0x81, 0x02,
+  0x05, 0x01, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x02, 0x09, 0x32, 0x09, 0x35, 0x81, 0x02,
+  0x16, 0x00, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x04, 0x09, 0x30, 0x09, 0x31, 0x09, 0x33, 0x09, 0x34, 0x81, 0x02,
+  0x75, 0x08, 0x95, 0x06, 0x81, 0x01,
+  0xC0
+};
+
+static void serve(const uint8_t * d, uint16_t len) {
+  reportDescr = d;
+  reportDescrLen = len;
+  reportDescrRequests = 0;
+}
+
+static void testKeyboard() {
+  HIDField f[8];
+  HIDFieldCompiler t(f, 8);
+  compile(t, kbdDescr, sizeof(kbdDescr), 8);
+  dump("keyboard", t);
+  CHECKEQ(t.GetNumFields(), 2);
+  CHECKEQ(t.GetReportLength(0), 8);
+  CHECKEQ(f[0].wUsage, 0xE0);
+  CHECKEQ(f[0].bCount, 8);
+  CHECKEQ(f[0].bmFlags & HID_FIELD_VARIABLE, HID_FIELD_VARIABLE);
+  CHECKEQ(f[1].wBitOffset, 16);
+  CHECKEQ(f[1].bCount, 6);
+  CHECKEQ(f[1].bmFlags & HID_FIELD_VARIABLE, 0);
+  CHECKEQ(f[1].lLogicalMax, 0x65);
+
+  uint8_t prev[8];
+  Recorder d(&t, prev, sizeof(prev));
+  serve(kbdDescr, sizeof(kbdDescr));
+  uint8_t r1[8] = { 0x02, 0, 0x04, 0x05, 0, 0, 0, 0 };
+  d.Parse(&Hid1, false, 8, r1);
+  CHECKEQ(reportDescrRequests, 1);
+  CHECKEQ(d.changes.size(), 3);
+  CHECK(has(d.changes, 7, 0xE1, 1));
+  CHECK(has(d.changes, 7, 0x04, 1));
+  CHECK(has(d.changes, 7, 0x05, 1));
+  // b held and moved to slot 0
+  d.changes.clear();
+  uint8_t r2[8] = { 0x00, 0, 0x05, 0x06, 0, 0, 0, 0 };
+  d.Parse(&Hid1, false, 8, r2);
+  CHECKEQ(reportDescrRequests, 1);
+  CHECKEQ(d.changes.size(), 3);
+  CHECK(has(d.changes, 7, 0xE1, 0));
+  CHECK(has(d.changes, 7, 0x04, 0));
+  CHECK(has(d.changes, 7, 0x06, 1));
+  // another device compiles again
+  d.changes.clear();
+  d.Parse(&Hid2, false, 8, r2);
+  CHECKEQ(reportDescrRequests, 2);
+  CHECK(has(d.changes, 7, 0x05, 1));
+  CHECK(has(d.changes, 7, 0x06, 1));
+}
+
+static void testMouse() {
+  HIDField f[8];
+  HIDFieldCompiler t(f, 8);
+  compile(t, mouseDescr, sizeof(mouseDescr), 64);
+  dump("mouse", t);
+  CHECK(t.HasReportId());
+  CHECKEQ(t.GetNumFields(), 5);
+  CHECKEQ(t.GetNumReports(), 2);
+  CHECKEQ(t.GetReportLength(0), 7);
+  CHECKEQ(t.GetReportLength(1), 2);
+  CHECKEQ(f[3].wUsagePage, 0x0C);
+  CHECKEQ(f[3].wUsage, 0x238);
+  CHECKEQ(f[2].wUsagePage, 0x01);
+  CHECKEQ(f[2].wUsage, 0x38);
+
+  struct M { uint8_t buttons; int16_t x, y; int8_t wheel, pan; uint16_t consumer; } m;
+  static const HIDUsageMap map[] PROGMEM = {
+    { 0x09, 0x01, 5, offsetof(M, buttons), 1 },
+    { 0x01, 0x30, 1, offsetof(M, x), 2 },
+    { 0x01, 0x31, 1, offsetof(M, y), 2 },
+    { 0x01, 0x38, 1, offsetof(M, wheel), 1 },
+    { 0x0C, 0x238, 1, offsetof(M, pan), 1 },
+    { 0x01, 0x33, 1, offsetof(M, consumer), 2 },    // not there
+  };
+  HIDBinding b[6];
+  CHECKEQ(t.Bind(map, b, 6), 5);
+  memset(&m, 0, sizeof(m));
+  uint8_t r[] = { 0x01, 0x05, 0xFB, 0xFF, 0x2C, 0x01, 0xFF, 0x02 };
+  CHECKEQ(HIDFieldCompiler::Decode(b, 6, r[0], r + 1, sizeof(r) - 1, &m), 5);
+  CHECKEQ(m.buttons, 5);
+  CHECKEQ(m.x, -5);
+  CHECKEQ(m.y, 300);
+  CHECKEQ(m.wheel, -1);
+  CHECKEQ(m.pan, 2);
+  // a short report decodes what is there
+  memset(&m, 0, sizeof(m));
+  CHECKEQ(HIDFieldCompiler::Decode(b, 6, 1, r + 1, 3, &m), 2);
+
+  uint8_t prev[16];
+  Recorder d(&t, prev, sizeof(prev));
+  serve(mouseDescr, sizeof(mouseDescr));
+  d.Parse(&Hid1, false, sizeof(r), r);
+  CHECK(has(d.changes, 9, 1, 1));
+  CHECK(has(d.changes, 9, 3, 1));
+  CHECK(!has(d.changes, 9, 2, 1));
+  CHECK(has(d.changes, 1, 0x30, -5));
+  CHECK(has(d.changes, 1, 0x31, 300));
+  CHECK(has(d.changes, 0x0C, 0x238, 2));
+  d.changes.clear();
+  uint8_t c[] = { 0x03, 0xE9, 0x00 };
+  d.Parse(&Hid1, false, sizeof(c), c);
+  CHECKEQ(d.changes.size(), 1);
+  CHECK(has(d.changes, 0x0C, 0xE9, 1));
+  d.changes.clear();
+  uint8_t c0[] = { 0x03, 0x00, 0x00 };
+  d.Parse(&Hid1, false, sizeof(c0), c0);
+  CHECKEQ(d.changes.size(), 1);
+  CHECK(has(d.changes, 0x0C, 0xE9, 0));
+  // report 1 state was kept apart from report 3
+  d.changes.clear();
+  r[1] = 0x04;
+  d.Parse(&Hid1, false, sizeof(r), r);
+  CHECKEQ(d.changes.size(), 1);
+  CHECK(has(d.changes, 9, 1, 0));
+}
+
+static void testGamepad() {
+  HIDField f[8];
+  HIDFieldCompiler t(f, 8);
+  compile(t, padDescr, sizeof(padDescr), 8);
+  dump("gamepad", t);
+  CHECKEQ(t.GetNumFields(), 6);
+  CHECKEQ(t.GetReportLength(0), 8);
+  CHECKEQ(f[0].wUsage, 0x30);
+  CHECKEQ(f[0].bCount, 3);
+  CHECKEQ(f[1].wUsage, 0x32);
+  CHECKEQ(f[1].wBitOffset, 24);
+  CHECKEQ(f[2].wUsage, 0x35);
+  CHECKEQ(f[2].wBitOffset, 32);
+  CHECKEQ(f[3].wUsage, 0x39);
+  CHECKEQ(f[3].bmFlags & HID_FIELD_NULL_STATE, HID_FIELD_NULL_STATE);
+  CHECKEQ(f[3].lLogicalMax, 7);
+  CHECKEQ(f[4].wUsagePage, 9);
+  CHECKEQ(f[4].bCount, 12);
+  CHECKEQ(f[4].wBitOffset, 44);
+  CHECKEQ(f[5].wUsagePage, 0xFF00);
+  CHECKEQ(f[5].bmFlags & HID_FIELD_SAME_USAGE, HID_FIELD_SAME_USAGE);
+  CHECKEQ(f[5].bCount, 8);
+
+  struct P { uint8_t x, y, rz, hat; uint16_t buttons; } p;
+  static const HIDUsageMap map[] PROGMEM = {
+    { 0x01, 0x30, 1, offsetof(P, x), 1 }, { 0x01, 0x31, 1, offsetof(P, y), 1 },
+    { 0x01, 0x35, 1, offsetof(P, rz), 1 }, { 0x01, 0x39, 1, offsetof(P, hat), 1 },
+    { 0x09, 0x01, 12, offsetof(P, buttons), 2 }
+  };
+  HIDBinding b[5];
+  CHECKEQ(t.Bind(map, b, 5), 5);
+  // hat centred (15), buttons 1, 5, 6 and 12
+  uint8_t r[8] = { 0x7F, 0x00, 0x80, 0x80, 0xFF, 0x2F, 0x81, 0x00 };
+  memset(&p, 0, sizeof(p));
+  HIDFieldCompiler::Decode(b, 5, 0, r, 8, &p);
+  CHECKEQ(p.x, 0x7F);
+  CHECKEQ(p.y, 0);
+  CHECKEQ(p.rz, 0xFF);
+  CHECKEQ(p.hat, 15);
+  CHECKEQ(p.buttons, 0x812);
+}
+
+// examples/HID/le3dp reads the report into this
+struct GamePadEventData {
+  union {
+    uint32_t axes;
+    struct {
+      uint32_t x : 10;
+      uint32_t y : 10;
+      uint32_t hat : 4;
+      uint32_t twist : 8;
+    };
+  };
+  uint8_t buttons_a;
+  uint8_t slider;
+  uint8_t buttons_b;
+};
+
+static void testLe3dp() {
+  HIDField f[8];
+  HIDFieldCompiler t(f, 8);
+  compile(t, le3dpDescr, sizeof(le3dpDescr), 8);
+  dump("le3dp", t);
+  CHECKEQ(t.GetNumFields(), 6);
+  CHECKEQ(t.GetReportLength(0), 7);
+  // Pop after the buttons brings back the page, size and range
+  CHECKEQ(f[4].wUsage, 0x36);
+  CHECKEQ(f[4].wUsagePage, 1);
+  CHECKEQ(f[4].bSize, 8);
+  CHECKEQ(f[4].lLogicalMax, 255);
+
+  struct J { uint16_t x, y; uint8_t hat, twist, slider; uint16_t buttons_a, buttons_b; } j;
+  static const HIDUsageMap map[] PROGMEM = {
+    { 0x01, 0x30, 1, offsetof(J, x), 2 }, { 0x01, 0x31, 1, offsetof(J, y), 2 },
+    { 0x01, 0x39, 1, offsetof(J, hat), 1 }, { 0x01, 0x35, 1, offsetof(J, twist), 1 },
+    { 0x01, 0x36, 1, offsetof(J, slider), 1 },
+    { 0x09, 0x01, 8, offsetof(J, buttons_a), 2 }, { 0x09, 0x09, 4, offsetof(J, buttons_b), 2 }
+  };
+  HIDBinding b[7];
+  CHECKEQ(t.Bind(map, b, 7), 7);
+  srand(1);
+  for (int i = 0; i < 1000; i++) {
+    uint8_t r[8] = { 0 };
+    for (int k = 0; k < 7; k++)
+      r[k] = rand();
+    r[6] &= 0x0f;
+    GamePadEventData e;
+    memcpy(&e, r, sizeof(e));
+    memset(&j, 0, sizeof(j));
+    HIDFieldCompiler::Decode(b, 7, 0, r, 7, &j);
+    CHECKEQ(j.x, e.x);
+    CHECKEQ(j.y, e.y);
+    CHECKEQ(j.hat, e.hat);
+    CHECKEQ(j.twist, e.twist);
+    CHECKEQ(j.buttons_a, e.buttons_a);
+    CHECKEQ(j.slider, e.slider);
+    CHECKEQ(j.buttons_b, e.buttons_b);
+  }
+}
+
+static void testPS3() {
+  HIDField f[16];
+  HIDFieldCompiler t(f, 16);
+  CHECKEQ(sizeof(ps3Descr), 148);
+  // the whole descriptor has to come over, not the first 128 bytes
+  serve(ps3Descr, sizeof(ps3Descr));
+  uint8_t prev[64];
+  Recorder d(&t, prev, sizeof(prev));
+  uint8_t r[49] = { 0x01, 0x00, 0x10, 0x01, 0x00, 0x00, 0x80, 0x7F, 0x00, 0xFF };   // up and L1, sticks
+  d.Parse(&Hid1, false, sizeof(r), r);
+  dump("ps3", t);
+  CHECKEQ(reportDescrRequests, 1);
+  CHECKEQ(t.GetNumFields(), 5);
+  CHECKEQ(t.GetNumReports(), 1);
+  CHECKEQ(t.GetReportLength(0), 48);    // read by PS3USB as 49 bytes with the ID
+  CHECKEQ(f[0].bCount, 19);
+  CHECKEQ(f[0].wBitOffset, 8);
+  CHECKEQ(f[1].wBitOffset, 40);
+  CHECKEQ(f[1].bCount, 3);
+  CHECKEQ(f[1].wUsage, 0x30);
+  CHECKEQ(f[2].wUsage, 0x35);
+  CHECKEQ(f[3].bmFlags & HID_FIELD_SAME_USAGE, HID_FIELD_SAME_USAGE);
+  CHECKEQ(f[3].bCount, 19);
+  CHECKEQ(f[4].bSize, 16);
+  CHECKEQ(f[4].wBitOffset, 8 * 40);
+  CHECK(has(d.changes, 9, 5, 1));
+  CHECK(has(d.changes, 9, 9, 1));
+  CHECK(has(d.changes, 1, 0x30, 0x80));
+  CHECK(has(d.changes, 1, 0x31, 0x7F));
+  CHECK(has(d.changes, 1, 0x35, 0xFF));
+  CHECK(!has(d.changes, 1, 0x32, 0));
+
+  struct S { uint32_t buttons; uint8_t lx, ly, rx, ry; } s;
+  static const HIDUsageMap map[] PROGMEM = {
+    { 0x09, 0x01, 19, offsetof(S, buttons), 4 },
+    { 0x01, 0x30, 1, offsetof(S, lx), 1 }, { 0x01, 0x31, 1, offsetof(S, ly), 1 },
+    { 0x01, 0x32, 1, offsetof(S, rx), 1 }, { 0x01, 0x35, 1, offsetof(S, ry), 1 }
+  };
+  HIDBinding b[5];
+  CHECKEQ(t.Bind(map, b, 5), 5);
+  memset(&s, 0, sizeof(s));
+  HIDFieldCompiler::Decode(b, 5, 1, r + 1, sizeof(r) - 1, &s);
+  // PS3USB reads the buttons as readBuf[2] | readBuf[3] << 8 | readBuf[4] << 16
+  CHECKEQ(s.buttons, (uint32_t) (r[2] | r[3] << 8 | (uint32_t) r[4] << 16) & 0x7FFFF);
+  CHECKEQ(s.lx, r[6]);
+  CHECKEQ(s.ly, r[7]);
+  CHECKEQ(s.rx, r[8]);
+  CHECKEQ(s.ry, r[9]);
+}
+
+static void testXbox() {
+  HIDField f[8];
+  HIDFieldCompiler t(f, 8);
+  compile(t, xboxDescr, sizeof(xboxDescr), 8);
+  dump("xbox", t);
+  CHECKEQ(t.GetReportLength(0), 20);
+  struct X { uint8_t type, len; uint16_t buttons; uint8_t lt, rt; int16_t lx, ly, rx, ry; } x;
+  static const HIDUsageMap map[] PROGMEM = {
+    { 0xFF00, 0x01, 1, offsetof(X, type), 1 }, { 0xFF00, 0x02, 1, offsetof(X, len), 1 },
+    { 0x09, 0x01, 16, offsetof(X, buttons), 2 },
+    { 0x01, 0x32, 1, offsetof(X, lt), 1 }, { 0x01, 0x35, 1, offsetof(X, rt), 1 },
+    { 0x01, 0x30, 1, offsetof(X, lx), 2 }, { 0x01, 0x31, 1, offsetof(X, ly), 2 },
+    { 0x01, 0x33, 1, offsetof(X, rx), 2 }, { 0x01, 0x34, 1, offsetof(X, ry), 2 }
+  };
+  HIDBinding b[9];
+  CHECKEQ(t.Bind(map, b, 9), 9);
+  uint8_t r[20] = { 0x00, 0x14, 0x10, 0x80, 0x40, 0xFF, 0x00, 0x80, 0xFF, 0x7F, 0x34, 0x12, 0xCC, 0xED };
+  HIDFieldCompiler::Decode(b, 9, 0, r, 20, &x);
+  CHECKEQ(x.type, 0);
+  CHECKEQ(x.len, 0x14);
+  CHECKEQ(x.buttons, 0x8010);
+  CHECKEQ(x.lt, 0x40);
+  CHECKEQ(x.rt, 0xFF);
+  // XBOXUSB::getAnalogHat() reads readBuf[a + 1] << 8 | readBuf[a]
+  CHECKEQ(x.lx, -32768);
+  CHECKEQ(x.ly, 32767);
+  CHECKEQ(x.rx, 0x1234);
+  CHECKEQ(x.ry, (int16_t) 0xEDCC);
+}
+
+static void testBits() {
+  uint8_t d[8];
+  srand(2);
+  for (int n = 0; n < 20000; n++) {
+    for (int i = 0; i < 8; i++)
+      d[i] = rand();
+    uint16_t bit = rand() % 32;
+    uint8_t size = 1 + rand() % 32;
+    uint64_t all = 0;
+    for (int i = 7; i >= 0; i--)
+      all = all << 8 | d[i];
+    uint64_t want = (all >> bit) & (size == 32 ? 0xffffffffULL : (1ULL << size) - 1);
+    CHECKEQ(HIDFieldCompiler::GetBits(d, bit, size), want);
+  }
+  // bits 3..7 = 10000b = -16
+  HIDField f = { 0, HID_FIELD_VARIABLE | HID_FIELD_SIGNED, 3, 5, 1, 1, 0x30, -16, 15 };
+  uint8_t v[2] = { 0x80, 0x00 };
+  CHECKEQ(HIDFieldCompiler::GetValue(&f, v, 0), -16);
+  // long items are skipped, and the table survives the descriptor a byte at a time
+  static const uint8_t longDescr[] = {
+    0xFE, 0x02, 0x10, 0x81, 0x01, 0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01,
+    0x75, 0x01, 0x95, 0x03, 0x81, 0x02, 0x95, 0x05, 0x81, 0x03
+  };
+  HIDField t[4];
+  HIDFieldCompiler c(t, 4);
+  compile(c, longDescr, sizeof(longDescr), 1);
+  CHECKEQ(c.GetNumFields(), 1);
+  CHECKEQ(t[0].bCount, 3);
+  CHECKEQ(c.GetReportLength(0), 1);
+  // a table too small says so
+  HIDField one[1];
+  HIDFieldCompiler small(one, 1);
+  compile(small, padDescr, sizeof(padDescr), 64);
+  CHECK(small.Overflowed());
+  CHECKEQ(small.GetNumFields(), 1);
+}
+
+static volatile uint32_t sink;
+
+class CountingDecoder : public HIDReportDecoder {
+public:
+  CountingDecoder(HIDFieldCompiler * t, uint8_t * p, uint8_t n) : HIDReportDecoder(t, p, n) {}
+
+protected:
+  virtual void OnUsageChanged(const HIDField *, uint8_t, uint16_t usage, int32_t value) {
+    sink += usage + value;
+  }
+};
+
+// Reports per second of CPU time for one way of parsing
+class Rate {
+public:
+  Rate() : n(0), start(clock()) {}
+  bool more() {
+    n += 1000;
+    return seconds() < 0.5;
+  }
+  double perSecond() { return n / seconds(); }
+
+private:
+  long n;
+  clock_t start;
+  double seconds() { return (double) (clock() - start) / CLOCKS_PER_SEC; }
+};
+
+static void bench(const char * name, const uint8_t * descr, uint16_t dlen, uint8_t rlen, bool id,
+                  const HIDUsageMap * map, uint8_t nmap) {
+  HIDField f[16];
+  HIDFieldCompiler t(f, 16);
+  compile(t, descr, dlen, 64);
+
+  // a control moving: each report has one byte changed from the one before
+  std::vector<std::vector<uint8_t> > reports(64, std::vector<uint8_t>(rlen));
+  srand(3);
+  for (int k = 0; k < rlen; k++)
+    reports[0][k] = rand();
+  for (size_t i = 1; i < reports.size(); i++) {
+    reports[i] = reports[i - 1];
+    reports[i][rand() % rlen] = rand();
+  }
+  if (id)
+    for (size_t i = 0; i < reports.size(); i++)
+      reports[i][0] = 1;
+
+  Rate old;
+  do {
+    for (int i = 0; i < 1000; i++) {
+      uint8_t buf[64], chunk[64];
+      memcpy(buf, reports[i & 63].data(), rlen);
+      ReportDescParser2 prs(rlen, buf);
+      for (uint16_t off = 0; off < dlen; off += 64) {
+        uint16_t k = dlen - off < 64 ? dlen - off : 64;
+        memcpy(chunk, descr + off, k);
+        prs.Parse(k, chunk, off);
+      }
+    }
+  } while (old.more());
+
+  uint8_t out[32];
+  HIDBinding b[16];
+  t.Bind(map, b, nmap);
+  Rate bound;
+  do {
+    for (int i = 0; i < 1000; i++) {
+      const uint8_t * r = reports[i & 63].data();
+      HIDFieldCompiler::Decode(b, nmap, id ? r[0] : 0, r + id, rlen - id, out);
+      sink += out[0];
+    }
+  } while (bound.more());
+
+  uint8_t prev[64];
+  CountingDecoder d(&t, prev, sizeof(prev));
+  serve(descr, dlen);
+  d.Parse(&Hid1, false, rlen, reports[0].data());
+  Rate changed;
+  do {
+    for (int i = 0; i < 1000; i++)
+      d.Parse(&Hid1, false, rlen, reports[i & 63].data());
+  } while (changed.more());
+
+  printf("  %-9s re-parse %9.0f   bound struct %11.0f (x%.0f)   changed usages %10.0f (x%.0f)\n", name,
+         old.perSecond(), bound.perSecond(), bound.perSecond() / old.perSecond(), changed.perSecond(),
+         changed.perSecond() / old.perSecond());
+}
+
+int main() {
+  Max3421eSim::reset();
+  UsbSimHub hub;
+  HidSim dev1, dev2;
+  hub.connect(1, &dev1);
+  hub.connect(2, &dev2);
+  Usb.Init();
+  Max3421eSim::attach(&hub);
+  for (unsigned long t = millis(); !(Hid1.GetAddress() && Hid2.GetAddress()) && millis() - t < 10000; )
+    Usb.Task(), hostAdvance(100000);
+  if (!Hid1.GetAddress() || !Hid2.GetAddress()) {
+    printf("HID devices not configured, USB task state %02x\n", Usb.getUsbTaskState());
+    return 1;
+  }
+
+  testBits();
+  testKeyboard();
+  testMouse();
+  testGamepad();
+  testLe3dp();
+  testPS3();
+  testXbox();
+  printf("%d checks, %d failures\n", checks, failures);
+
+  static const HIDUsageMap kbdMap[] PROGMEM = { { 0x07, 0xE0, 8, 0, 1 } };
+  static const HIDUsageMap padMap[] PROGMEM = {
+    { 0x01, 0x30, 1, 0, 1 }, { 0x01, 0x31, 1, 1, 1 }, { 0x01, 0x35, 1, 2, 1 }, { 0x01, 0x39, 1, 3, 1 },
+    { 0x09, 0x01, 12, 4, 2 }
+  };
+  static const HIDUsageMap ps3Map[] PROGMEM = {
+    { 0x09, 0x01, 19, 0, 4 }, { 0x01, 0x30, 1, 4, 1 }, { 0x01, 0x31, 1, 5, 1 }, { 0x01, 0x32, 1, 6, 1 },
+    { 0x01, 0x35, 1, 7, 1 }
+  };
+  static const HIDUsageMap xboxMap[] PROGMEM = {
+    { 0x09, 0x01, 16, 0, 2 }, { 0x01, 0x32, 1, 2, 1 }, { 0x01, 0x35, 1, 3, 1 },
+    { 0x01, 0x30, 1, 4, 2 }, { 0x01, 0x31, 1, 6, 2 }, { 0x01, 0x33, 1, 8, 2 }, { 0x01, 0x34, 1, 10, 2 }
+  };
+  printf("reports/s of host CPU time\n");
+  bench("keyboard", kbdDescr, sizeof(kbdDescr), 8, false, kbdMap, 1);
+  bench("gamepad", padDescr, sizeof(padDescr), 8, false, padMap, 5);
+  bench("ps3", ps3Descr, sizeof(ps3Descr), 49, true, ps3Map, 5);
+  bench("xbox", xboxDescr, sizeof(xboxDescr), 20, false, xboxMap, 7);
+  return failures != 0;
+}
@@ -0,0 +1,604 @@
+/*
+ MassStorage - BulkOnly and BulkOnlyCard against a Bulk-Only SCSI disk
+
+ A 64 MB disk holding a FAT16 volume with a 1 MB file, BIG.BIN, is
+ enumerated by the real BulkOnly driver.  The disk answers a command after
+ 600 us, reads a block from flash in 60 us, programs one in 250 us and
+ takes 1.5 ms more per write command.  Its first two TEST UNIT READYs
+ fail with a unit attention.
+
+ The BOT checks read and write through BulkOnly and BulkOnlyCard and
+ compare with the disk, then replay the write sequences OpenLog sends:
+ writeStart() with a 131072 block range stopped after a few blocks, and
+ writes running past a short range.  The benchmarks time sequential,
+ random and mixed reads and writes, then SdFat reads and writes files on
+ the volume through a block device doing one READ(10) per block and
+ through BulkOnlyCard.
+
+ Usage: MassStorage
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <random>
+#include <Usb.h>
+#include <masstorage.h>
+#include <bulkonlycard.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+// Bulk-Only Transport on EP1 IN and EP2 OUT, SCSI block commands on a RAM
+// disk with flash timing
+class MscDisk : public UsbSimDevice {
+public:
+  MscDisk() : UsbSimDevice(deviceDescr, configDescr), state(WAIT_CBW), senseKey(0), asc(0),
+    unitAttention(2), commands(0), resets(0), errors(0) {}
+
+  std::vector<uint8_t> data;
+  uint32_t blocks;
+
+  // latencies in us
+  static const uint32_t cmdUs = 600;      // command decode and flash lookup
+  static const uint32_t readUs = 60;      // per block read from flash
+  static const uint32_t writeUs = 250;    // per block programmed
+  static const uint32_t writeCmdUs = 1500;  // per write command, page merge
+
+  int unitAttention;    // TEST UNIT READYs to fail after power up
+  long commands, resets, errors;
+
+  virtual int controlIn(const UsbSimSetup & s, uint8_t * buf) {
+    if (s.bRequest == MASS_REQ_GET_MAX_LUN) {
+      buf[0] = 0;
+      return 1;
+    }
+    return -1;
+  }
+
+  virtual bool controlOut(const UsbSimSetup & s, const uint8_t *, uint16_t) {
+    if (s.bRequest != MASS_REQ_BOMSR)
+      return false;
+    state = WAIT_CBW;
+    resets++;
+    return true;
+  }
+
+  virtual int in(uint8_t ep, uint8_t * buf) {
+    if (ep != 1)
+      return -1;
+    if (state == DATA_IN) {
+      // each block shows up readUs after the one before it
+      if (micros() < readyAt + (uint64_t) readUs * (inPos / 512 + 1))
+        return -1;
+      size_t n = inBuf.size() - inPos < 64 ? inBuf.size() - inPos : 64;
+      memcpy(buf, &inBuf[inPos], n);
+      inPos += n;
+      if (inPos == inBuf.size()) {
+        state = STATUS;
+        readyAt = micros();
+      }
+      return n;
+    }
+    if (state == STATUS) {
+      if (micros() < readyAt)
+        return -1;
+      uint32_t sig = MASS_CSW_SIGNATURE;
+      memcpy(buf, &sig, 4);
+      memcpy(buf + 4, &tag, 4);
+      memcpy(buf + 8, &residue, 4);
+      buf[12] = status;
+      state = WAIT_CBW;
+      return 13;
+    }
+    return -1;
+  }
+
+  virtual bool out(uint8_t ep, const uint8_t * buf, uint8_t len) {
+    if (ep != 2)
+      return false;
+    if (state == WAIT_CBW) {
+      uint32_t sig;
+      memcpy(&sig, buf, 4);
+      if (len != 31 || sig != MASS_CBW_SIGNATURE) {
+        printf("  bad CBW, %d bytes\n", len);
+        errors++;
+        return true;
+      }
+      command(buf);
+      return true;
+    }
+    if (state == DATA_OUT) {
+      memcpy(&data[outAddr * 512 + outGot], buf, len);
+      outGot += len;
+      if (outGot >= outLen) {
+        state = STATUS;
+        readyAt = micros() + writeCmdUs + (uint64_t) writeUs * (outLen / 512);
+      }
+      return true;
+    }
+    printf("  OUT while waiting to send\n");
+    errors++;
+    return true;
+  }
+
+private:
+  static const uint8_t deviceDescr[18];
+  static const uint8_t configDescr[32];
+
+  enum { WAIT_CBW, DATA_IN, DATA_OUT, STATUS } state;
+  std::vector<uint8_t> inBuf;
+  size_t inPos;
+  uint32_t outAddr, outLen, outGot;
+  uint64_t readyAt;
+  uint32_t tag, residue;
+  uint8_t status, senseKey, asc;
+
+  static uint32_t be32(const uint8_t * p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | p[2] << 8 | p[3];
+  }
+
+  void fail(uint8_t key, uint8_t code) {
+    status = 1;
+    senseKey = key;
+    asc = code;
+  }
+
+  void command(const uint8_t * cbw) {
+    const uint8_t * cb = cbw + 15;
+    uint32_t len;
+
+    commands++;
+    memcpy(&tag, cbw + 4, 4);
+    memcpy(&len, cbw + 8, 4);
+    status = 0;
+    residue = 0;
+    inBuf.clear();
+    inPos = 0;
+    readyAt = micros() + cmdUs;
+    state = STATUS;
+
+    switch (cb[0]) {
+    case SCSI_CMD_TEST_UNIT_READY:
+      if (unitAttention > 0) {
+        unitAttention--;
+        fail(6, 0x28);
+      }
+      return;
+    case SCSI_CMD_REQUEST_SENSE:
+      inBuf.assign(18, 0);
+      inBuf[0] = 0x70;
+      inBuf[2] = senseKey;
+      inBuf[7] = 10;
+      inBuf[12] = asc;
+      senseKey = asc = 0;
+      break;
+    case SCSI_CMD_INQUIRY:
+      inBuf.assign(36, 0);
+      inBuf[4] = 31;
+      memcpy(&inBuf[8], "SIM     DISK            1.00", 28);
+      break;
+    case SCSI_CMD_READ_CAPACITY_10:
+      // the LBA field has to be zero without PMI
+      if (be32(cb + 2)) {
+        fail(5, 0x24);
+        residue = len;
+        return;
+      }
+      inBuf.assign(8, 0);
+      for (int i = 0; i < 4; i++)
+        inBuf[i] = (blocks - 1) >> (24 - 8 * i);
+      inBuf[6] = 2;
+      break;
+    case SCSI_CMD_READ_10: {
+      uint32_t a = be32(cb + 2), n = cb[7] << 8 | cb[8];
+      if (a + n > blocks) {
+        fail(5, 0x21);
+        residue = len;
+        return;
+      }
+      inBuf.assign(data.begin() + a * 512, data.begin() + (a + n) * 512);
+      break;
+    }
+    case SCSI_CMD_WRITE_10:
+      outAddr = be32(cb + 2);
+      outLen = (cb[7] << 8 | cb[8]) * 512;
+      outGot = 0;
+      if (outLen != len) {
+        printf("  WRITE(10) of %u bytes in a CBW for %u\n", outLen, len);
+        errors++;
+      }
+      if (outLen)
+        state = DATA_OUT;
+      return;
+    default:
+      fail(5, 0x20);
+      residue = len;
+      return;
+    }
+    if (inBuf.size() > len)
+      inBuf.resize(len);
+    residue = len - inBuf.size();
+    if (!inBuf.empty())
+      state = DATA_IN;
+  }
+};
+
+const uint8_t MscDisk::deviceDescr[18] = {
+  18, 1, 0x00, 0x02, 0, 0, 0, 64, 0x34, 0x12, 0x01, 0x10, 0x00, 0x01, 0, 0, 0, 1
+};
+
+const uint8_t MscDisk::configDescr[32] = {
+  9, 2, 32, 0, 1, 1, 0, 0x80, 50,
+  9, 4, 0, 0, 2, USB_CLASS_MASS_STORAGE, MASS_SUBCLASS_SCSI, MASS_PROTO_BBB, 0,
+  7, 5, 0x81, 2, 64, 0, 0,
+  7, 5, 0x02, 2, 64, 0, 0
+};
+
+static MscDisk disk;
+
+static void put16(uint8_t * p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void put32(uint8_t * p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+
+// First block of BIG.BIN, a 1 MB file holding its own offsets
+static const uint32_t bigStart = 353;
+
+// 64 MB with an MBR and a FAT16 partition at block 64, four blocks to the
+// cluster, BIG.BIN in clusters 2..513
+static void format() {
+  const uint32_t total = 131072, start = 64, spc = 4, rootEntries = 512;
+  const uint32_t vol = total - start, reserved = 1, fats = 2, rootBlocks = rootEntries * 32 / 512;
+  uint32_t spf = 1;
+  for (;;) {
+    uint32_t clusters = (vol - reserved - fats * spf - rootBlocks) / spc;
+    uint32_t need = ((clusters + 2) * 2 + 511) / 512;
+    if (need <= spf)
+      break;
+    spf = need;
+  }
+  disk.blocks = total;
+  disk.data.assign(total * 512, 0);
+  uint8_t * img = disk.data.data();
+
+  uint8_t * part = img + 446;
+  part[4] = 0x06;
+  put32(part + 8, start);
+  put32(part + 12, vol);
+  img[510] = 0x55;
+  img[511] = 0xaa;
+
+  uint8_t * boot = img + start * 512;
+  memcpy(boot, "\xeb\x3c\x90MSDOS5.0", 11);
+  put16(boot + 11, 512);
+  boot[13] = spc;
+  put16(boot + 14, reserved);
+  boot[16] = fats;
+  put16(boot + 17, rootEntries);
+  boot[21] = 0xf8;
+  put16(boot + 22, spf);
+  put16(boot + 24, 63);
+  put16(boot + 26, 255);
+  put32(boot + 28, start);
+  put32(boot + 32, vol);
+  boot[36] = 0x80;
+  boot[38] = 0x29;
+  put32(boot + 39, 0x1234);
+  memcpy(boot + 43, "USBDISK    FAT16   ", 19);
+  boot[510] = 0x55;
+  boot[511] = 0xaa;
+
+  const uint32_t size = 1UL << 20, fileClusters = size / (spc * 512);
+  uint32_t fat = start + reserved, root = fat + fats * spf, first = root + rootBlocks;
+  for (uint32_t f = 0; f < fats; f++) {
+    uint8_t * p = img + (fat + f * spf) * 512;
+    put16(p, 0xfff8);
+    put16(p + 2, 0xffff);
+    for (uint32_t i = 0; i < fileClusters; i++)
+      put16(p + (2 + i) * 2, i < fileClusters - 1 ? 3 + i : 0xffff);
+  }
+  uint8_t * entry = img + root * 512;
+  memcpy(entry, "BIG     BIN", 11);
+  entry[11] = 0x20;
+  put16(entry + 26, 2);
+  put32(entry + 28, size);
+  for (uint32_t i = 0; i < size; i += 4)
+    put32(img + first * 512 + i, i);
+  if (first != bigStart)
+    printf("BIG.BIN at block %u\n", first);
+}
+
+USB Usb;
+
+// What a block device costs over the old interface: a READ(10) or
+// WRITE(10) per block
+class PerBlockCard : public SdBlockDevice {
+public:
+  PerBlockCard(BulkOnly * bulk, uint32_t blocks) : bulk(bulk), blocks(blocks), next(0) {}
+  virtual uint32_t cardSize() { return blocks; }
+  virtual uint8_t errorData() { return 0; }
+  virtual bool readBlock(uint32_t block, uint8_t * dst) { return !bulk->Read(0, block, 512, 1, dst); }
+  virtual bool readStart(uint32_t block) { next = block; return true; }
+  virtual bool readData(uint8_t * dst) { return readBlock(next++, dst); }
+  virtual bool readStop() { return true; }
+  virtual bool writeBlock(uint32_t block, const uint8_t * src) { return !bulk->Write(0, block, 512, 1, src); }
+  virtual bool writeStart(uint32_t block, uint32_t) { next = block; return true; }
+  virtual bool writeData(const uint8_t * src) { return writeBlock(next++, src); }
+  virtual bool writeStop() { return true; }
+
+private:
+  BulkOnly * bulk;
+  uint32_t blocks, next;
+};
+
+// Collects what the per block Read() hands its parser
+class Collect : public USBReadParser {
+public:
+  uint8_t * dst;
+  virtual void Parse(const uint16_t len, const uint8_t * pbuf, const uint16_t & offset) {
+    memcpy(dst + offset, pbuf, len);
+  }
+};
+
+// Time, commands and SPI bytes of one benchmark
+class Meter {
+public:
+  Meter() : ns(hostNanos), commands(disk.commands), spi(Max3421eSim::spiBytes) {}
+  void report(const char * what, long bytes) {
+    double ms = (hostNanos - ns) / 1e6;
+    printf("  %-48s %7.1f ms %6.1f KB/s %5ld commands %6.1f SPI bytes/block\n", what, ms,
+           bytes / 1.024 / ms, disk.commands - commands,
+           (double) (Max3421eSim::spiBytes - spi) / (bytes / 512));
+  }
+
+private:
+  uint64_t ns;
+  long commands;
+  unsigned long spi;
+};
+
+static bool ok = true;
+
+#define CHECK(x) do { if (!(x)) { printf("  check failed at line %d\n", __LINE__); ok = false; } } while (0)
+
+static bool same(const uint8_t * buf, uint32_t block) {
+  return !memcmp(buf, &disk.data[block * 512], 512);
+}
+
+static void botChecks(BulkOnlyCard & drive) {
+  static uint8_t buf[512];
+  uint8_t w[512], z[512], keep[512];
+  memset(w, 0x5a, 512);
+  memset(z, 0, 512);
+
+  // a write between reads of the same run is not served stale
+  CHECK(drive.readBlock(200, buf) && drive.readBlock(201, buf) && drive.readBlock(202, buf));
+  CHECK(drive.writeBlock(203, w) && drive.readBlock(203, buf) && !memcmp(buf, w, 512));
+
+  // a write stopped early is finished with zeros inside the range
+  CHECK(drive.writeStart(300, 4) && drive.writeData(w));
+  CHECK(drive.writeStop() && disk.resets == 0);
+  CHECK(drive.readBlock(300, buf) && !memcmp(buf, w, 512));
+
+  // OpenLog: a 64 MB range stopped after 5 blocks is one WRITE(10) of 16
+  // blocks, padded, with no reset; the block after it is untouched
+  memcpy(keep, &disk.data[(4000 + 16) * 512], 512);
+  long commands = disk.commands;
+  CHECK(drive.writeStart(4000, 131072));
+  for (int i = 0; i < 5; i++)
+    CHECK(drive.writeData(w));
+  CHECK(drive.writeStop() && disk.resets == 0 && disk.commands - commands == 1);
+  for (int i = 0; i < 16; i++)
+    CHECK(!memcmp(&disk.data[(4000 + i) * 512], i < 5 ? w : z, 512));
+  CHECK(!memcmp(&disk.data[(4000 + 16) * 512], keep, 512));
+
+  // 40 blocks of the same range: three commands, the last one padded
+  commands = disk.commands;
+  CHECK(drive.writeStart(5000, 131072));
+  for (int i = 0; i < 40; i++)
+    CHECK(drive.writeData(w));
+  CHECK(drive.writeStop() && disk.resets == 0 && disk.commands - commands == 3);
+
+  // past the end of a range one block per command
+  commands = disk.commands;
+  CHECK(drive.writeStart(6000, 2));
+  for (int i = 0; i < 4; i++)
+    CHECK(drive.writeData(w));
+  CHECK(drive.writeStop() && disk.commands - commands == 3);
+  CHECK(!memcmp(&disk.data[6003 * 512], w, 512));
+
+  CHECK(drive.readBlock(5, buf) && same(buf, 5));
+}
+
+static void benchmarks(BulkOnly & bulk, BulkOnlyCard & drive) {
+  static uint8_t buf[16 * 512];
+  const uint32_t seqBlocks = 2048;
+  std::mt19937 rng(7);
+  std::vector<uint32_t> rnd(500);
+  for (size_t i = 0; i < rnd.size(); i++)
+    rnd[i] = rng() % (disk.blocks - 1);
+  Collect c;
+  c.dst = buf;
+
+  printf("sequential read 1 MB\n");
+  {
+    Meter m;
+    for (uint32_t b = 0; b < seqBlocks; b++)
+      CHECK(!bulk.Read(0, bigStart + b, 512, &c) && same(buf, bigStart + b));
+    m.report("Read() with a parser, a command per block", seqBlocks * 512);
+  }
+  {
+    Meter m;
+    for (uint32_t b = 0; b < seqBlocks; b += 16) {
+      CHECK(!bulk.Read(0, bigStart + b, 512, 16, buf));
+      for (int i = 0; i < 16; i++)
+        CHECK(same(buf + i * 512, bigStart + b + i));
+    }
+    m.report("Read() 16 blocks per command", seqBlocks * 512);
+  }
+  {
+    Meter m;
+    for (uint32_t b = 0; b < seqBlocks; b++)
+      CHECK(drive.readBlock(bigStart + b, buf) && same(buf, bigStart + b));
+    m.report("BulkOnlyCard::readBlock()", seqBlocks * 512);
+  }
+
+  printf("random read %u blocks\n", (unsigned) rnd.size());
+  {
+    Meter m;
+    for (size_t i = 0; i < rnd.size(); i++)
+      CHECK(!bulk.Read(0, rnd[i], 512, &c) && same(buf, rnd[i]));
+    m.report("Read() with a parser", rnd.size() * 512);
+  }
+  {
+    Meter m;
+    for (size_t i = 0; i < rnd.size(); i++)
+      CHECK(drive.readBlock(rnd[i], buf) && same(buf, rnd[i]));
+    m.report("BulkOnlyCard::readBlock()", rnd.size() * 512);
+  }
+
+  printf("runs of 1..32 blocks at random places\n");
+  for (int card = 0; card < 2; card++) {
+    Meter m;
+    long bytes = 0;
+    std::mt19937 runs(3);
+    for (int i = 0; i < 200; i++) {
+      uint32_t s = runs() % (disk.blocks - 40), n = 1 + runs() % 32;
+      for (uint32_t b = s; b < s + n; b++) {
+        if (card)
+          CHECK(drive.readBlock(b, buf) && same(buf, b));
+        else
+          CHECK(!bulk.Read(0, b, 512, &c) && same(buf, b));
+      }
+      bytes += n * 512;
+    }
+    m.report(card ? "BulkOnlyCard::readBlock()" : "Read() with a parser", bytes);
+  }
+
+  printf("write 256 KB\n");
+  {
+    for (int i = 0; i < 16 * 512; i++)
+      buf[i] = i * 7;
+    Meter m;
+    for (uint32_t b = 0; b < 512; b++)
+      CHECK(drive.writeBlock(100000 + b, buf + (b % 16) * 512));
+    m.report("writeBlock(), a WRITE(10) per block", 512 * 512);
+    for (uint32_t b = 0; b < 512; b++)
+      CHECK(same(buf + (b % 16) * 512, 100000 + b));
+  }
+  {
+    for (int i = 0; i < 16 * 512; i++)
+      buf[i] = i * 3;
+    Meter m;
+    for (uint32_t b = 0; b < 512; b += 16) {
+      CHECK(drive.writeStart(101000 + b, 16));
+      for (int i = 0; i < 16; i++)
+        CHECK(drive.writeData(buf + i * 512));
+      CHECK(drive.writeStop());
+    }
+    m.report("writeStart()/writeData(), 16 blocks per command", 512 * 512);
+    for (uint32_t b = 0; b < 512; b++)
+      CHECK(same(buf + (b % 16) * 512, 101000 + b));
+  }
+}
+
+static void sdFatRun(const char * name, SdBlockDevice * dev) {
+  static uint8_t buf[4096];
+  static const int chunks[] = { 64, 512, 4096 };
+  static const char * names[] = { "OUT.BIN", "OUT4K.BIN" };
+  SdFat sd;
+  SdFile f;
+
+  printf("SdFat on %s\n", name);
+  if (!sd.begin(dev)) {
+    printf("  mount failed %x %x\n", sd.card()->errorCode(), sd.card()->errorData());
+    ok = false;
+    return;
+  }
+  for (int c = 0; c < 3; c++) {
+    CHECK(f.open("BIG.BIN", O_READ));
+    Meter m;
+    uint32_t pos = 0;
+    int n;
+    while ((n = f.read(buf, chunks[c])) > 0) {
+      for (int i = 0; i < n; i += 4) {
+        uint32_t v;
+        memcpy(&v, buf + i, 4);
+        if (v != pos + i) {
+          CHECK(v == pos + i);
+          break;
+        }
+      }
+      pos += n;
+    }
+    f.close();
+    char what[48];
+    sprintf(what, "read BIG.BIN in %d byte reads", chunks[c]);
+    m.report(what, pos);
+    CHECK(pos == 1UL << 20);
+  }
+  for (int w = 0; w < 2; w++) {
+    int chunk = w ? 4096 : 512;
+    sd.remove(names[w]);
+    CHECK(f.open(names[w], O_RDWR | O_CREAT | O_TRUNC));
+    Meter m;
+    for (uint32_t pos = 0; pos < 131072; pos += chunk) {
+      for (int i = 0; i < chunk; i += 4) {
+        uint32_t v = ~(pos + i);
+        memcpy(buf + i, &v, 4);
+      }
+      CHECK(f.write(buf, chunk) == chunk);
+    }
+    f.close();
+    char what[48];
+    sprintf(what, "write %s in %d byte writes", names[w], chunk);
+    m.report(what, 131072);
+  }
+  for (int w = 0; w < 2; w++) {
+    CHECK(f.open(names[w], O_READ) && f.fileSize() == 131072);
+    for (uint32_t pos = 0; pos < 131072; pos += 512) {
+      CHECK(f.read(buf, 512) == 512);
+      for (int i = 0; i < 512; i += 4) {
+        uint32_t v;
+        memcpy(&v, buf + i, 4);
+        if (v != ~(pos + i)) {
+          CHECK(v == ~(pos + i));
+          break;
+        }
+      }
+    }
+    f.close();
+  }
+}
+
+int main() {
+  Max3421eSim::reset();
+  format();
+
+  BulkOnly bulk(&Usb);
+  BulkOnlyCard drive(&bulk);
+
+  Usb.Init();
+  Max3421eSim::attach(&disk);
+  for (unsigned long t = millis(); !bulk.GetAddress() && millis() - t < 20000; hostAdvance(100000))
+    Usb.Task();
+  if (!bulk.GetAddress()) {
+    printf("drive not configured, USB task state %02x\n", Usb.getUsbTaskState());
+    return 1;
+  }
+  if (!drive.begin()) {
+    printf("begin() failed %x\n", drive.errorData());
+    return 1;
+  }
+  printf("%u blocks, %d unit attentions cleared\n", drive.cardSize(), 2 - disk.unitAttention);
+  CHECK(drive.cardSize() == disk.blocks && !disk.unitAttention);
+
+  botChecks(drive);
+  benchmarks(bulk, drive);
+
+  PerBlockCard perBlock(&bulk, drive.cardSize());
+  sdFatRun("a READ(10) or WRITE(10) per block", &perBlock);
+  sdFatRun("BulkOnlyCard", &drive);
+
+  CHECK(!disk.errors && !Max3421eSim::toggleErrors && !Max3421eSim::overruns);
+  printf("%s: %ld bulk resets, %lu toggle errors, %lu overruns\n", ok ? "passed" : "FAILED",
+         disk.resets, Max3421eSim::toggleErrors, Max3421eSim::overruns);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+// MAX3421E host registers, SIE timing and FIFOs
+
+#include <string.h>
+#include <Arduino.h>
+#include <max3421e.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+unsigned long Max3421eSim::spiByteNs = 1000;
+unsigned long Max3421eSim::spiBytes;
+unsigned long Max3421eSim::selects;
+unsigned long Max3421eSim::transfers;
+unsigned long Max3421eSim::naks;
+unsigned long Max3421eSim::toggleErrors;
+unsigned long Max3421eSim::overruns;
+uint64_t Max3421eSim::busyNs;
+
+static UsbSimDevice * root;
+
+static uint8_t hirq, hien, mode, peraddr, hctl, cpuctl, sndbc, result;
+static bool rcvTog, sndTog;
+static uint8_t sudfifo[8], sndfifo[64];
+static uint8_t sudPos, sndPos;
+
+// the two receive FIFOs, rcv[rcvHead] is the one the CPU reads
+static uint8_t rcv[2][64], rcvLen[2], rcvPos;
+static uint8_t rcvHead, rcvCount;
+
+// transfer on the bus, and what it leaves behind when done
+static bool busy;
+static uint64_t doneAt;
+static uint8_t doneResult, doneData[64], doneLen;
+static bool doneRcv;
+
+static uint64_t resetDoneAt;
+static unsigned long frameMs;
+
+// command byte of the current SPI frame
+static bool first;
+static uint8_t command;
+
+void Max3421eSim::reset() {
+  root = NULL;
+  hirq = hien = mode = peraddr = hctl = cpuctl = sndbc = result = 0;
+  rcvTog = sndTog = false;
+  sudPos = sndPos = rcvPos = rcvHead = rcvCount = 0;
+  busy = false;
+  resetDoneAt = 0;
+  frameMs = millis();
+  spiBytes = selects = transfers = naks = toggleErrors = overruns = 0;
+  busyNs = 0;
+}
+
+void Max3421eSim::attach(UsbSimDevice * dev) {
+  if (root)
+    root->enabled = false;
+  root = dev;
+  hirq |= bmCONDETIRQ;
+}
+
+static uint64_t busTime(bool lowSpeed, int bytes) {
+  return (uint64_t) bytes * 8 * (lowSpeed ? 666667 : 83333) / 1000;
+}
+
+// Runs the transaction with the device now, the results show when the
+// bus time is up
+static void launch(uint8_t hxfr) {
+  uint8_t token = hxfr & 0xf0, ep = hxfr & 0x0f;
+  UsbSimDevice * dev = root ? root->find(peraddr) : NULL;
+  bool lowSpeed = (mode & bmLOWSPEED) != 0;
+  int bytes = 6;
+
+  Max3421eSim::transfers++;
+  doneRcv = false;
+  doneLen = 0;
+  if (!dev || dev->lowSpeed != lowSpeed)
+    // nobody answers, or a device at the other speed does not see it
+    doneResult = hrTIMEOUT;
+  else if (token == tokIN && rcvCount == 2) {
+    Max3421eSim::overruns++;
+    doneResult = hrNAK;
+  } else {
+    switch (token) {
+    case tokSETUP:
+      doneLen = 8;
+      doneResult = dev->transaction(token, ep, false, sudfifo, doneLen);
+      bytes = 18;
+      break;
+    case tokOUT:
+      doneLen = sndbc;
+      doneResult = dev->transaction(token, ep, sndTog, sndfifo, doneLen);
+      if (doneResult == hrSUCCESS)
+        sndTog = !sndTog;
+      bytes = sndbc + 10;
+      break;
+    case tokIN:
+      doneResult = dev->transaction(token, ep, rcvTog, doneData, doneLen);
+      if (doneResult == hrSUCCESS) {
+        rcvTog = !rcvTog;
+        doneRcv = true;
+      }
+      if (doneResult == hrSUCCESS || doneResult == hrTOGERR)
+        bytes = doneLen + 10;
+      break;
+    case tokINHS:
+    case tokOUTHS:
+      doneResult = dev->transaction(token, ep, true, doneData, doneLen);
+      bytes = 10;
+      break;
+    default:
+      doneResult = hrBADREQ;
+    }
+    if (doneResult == hrNAK)
+      Max3421eSim::naks++;
+  }
+  uint64_t t = busTime(lowSpeed, bytes);
+  Max3421eSim::busyNs += t;
+  busy = true;
+  doneAt = hostNanos + t;
+}
+
+static void complete() {
+  busy = false;
+  result = doneResult;
+  if (doneRcv) {
+    uint8_t i = (rcvHead + rcvCount) & 1;
+    memcpy(rcv[i], doneData, doneLen);
+    rcvLen[i] = doneLen;
+    rcvCount++;
+  }
+  hirq |= bmHXFRDNIRQ;
+}
+
+void Max3421eSim::clock() {
+  if (busy && hostNanos >= doneAt)
+    complete();
+  if ((hctl & bmBUSRST) && hostNanos >= resetDoneAt) {
+    hctl &= ~bmBUSRST;
+    hirq |= bmBUSEVENTIRQ;
+  }
+  for (unsigned long ms = millis(); frameMs != ms; ) {
+    frameMs++;
+    if (mode & bmSOFKAENAB)
+      hirq |= bmFRAMEIRQ;
+    if (root)
+      root->frame();
+  }
+}
+
+bool Max3421eSim::intLow() {
+  uint8_t pending = hirq | (rcvCount ? bmRCVDAVIRQ : 0) | bmSNDBAVIRQ;
+  return (pending & hien) && (cpuctl & bmIE);
+}
+
+static uint8_t readRegister(uint8_t reg) {
+  switch (reg) {
+  case rRCVFIFO:
+    return rcvCount ? rcv[rcvHead][rcvPos++ & 63] : 0;
+  case rRCVBC:
+    return rcvCount ? rcvLen[rcvHead] : 0;
+  case rUSBIRQ:
+    return bmOSCOKIRQ;
+  case rCPUCTL:
+    return cpuctl;
+  case rREVISION:
+    return 0x13;
+  case rHIRQ:
+    return hirq | (rcvCount ? bmRCVDAVIRQ : 0) | bmSNDBAVIRQ;
+  case rHIEN:
+    return hien;
+  case rMODE:
+    return mode;
+  case rPERADDR:
+    return peraddr;
+  case rHCTL:
+    return hctl;
+  case rHRSL: {
+    uint8_t v = result | (rcvTog ? bmRCVTOGRD : 0) | (sndTog ? bmSNDTOGRD : 0);
+    // J is the idle state at the speed the host is set to
+    if (root && (mode & bmHOST))
+      v |= (root->lowSpeed == ((mode & bmLOWSPEED) != 0)) ? bmJSTATUS : bmKSTATUS;
+    return v;
+  }
+  }
+  return 0;
+}
+
+static void writeRegister(uint8_t reg, uint8_t v) {
+  switch (reg) {
+  case rSUDFIFO:
+    sudfifo[sudPos++ & 7] = v;
+    break;
+  case rSNDFIFO:
+    sndfifo[sndPos++ & 63] = v;
+    break;
+  case rSNDBC:
+    sndbc = v;
+    sndPos = 0;
+    break;
+  case rUSBCTL:
+    if (v & bmCHIPRES) {
+      hirq = hien = mode = peraddr = hctl = cpuctl = 0;
+      rcvCount = 0;
+    }
+    break;
+  case rCPUCTL:
+    cpuctl = v;
+    break;
+  case rHIRQ:
+    if ((v & bmRCVDAVIRQ) && rcvCount) {
+      // frees this FIFO, the other one becomes readable
+      rcvHead ^= 1;
+      rcvCount--;
+      rcvPos = 0;
+    }
+    hirq &= ~(v & ~bmRCVDAVIRQ);
+    break;
+  case rHIEN:
+    hien = v;
+    break;
+  case rMODE:
+    mode = v;
+    break;
+  case rPERADDR:
+    peraddr = v;
+    break;
+  case rHCTL:
+    if (v & bmRCVTOG0)
+      rcvTog = false;
+    if (v & bmRCVTOG1)
+      rcvTog = true;
+    if (v & bmSNDTOG0)
+      sndTog = false;
+    if (v & bmSNDTOG1)
+      sndTog = true;
+    hctl = (hctl & bmBUSRST) | (v & bmSAMPLEBUS);
+    if (v & bmBUSRST) {
+      hctl |= bmBUSRST;
+      resetDoneAt = hostNanos + 50000000ULL;
+      if (root)
+        root->reset();
+    }
+    break;
+  case rHXFR:
+    launch(v);
+    break;
+  }
+}
+
+void Max3421eSim::select(bool low) {
+  if (low) {
+    first = true;
+    selects++;
+  }
+}
+
+uint8_t Max3421eSim::transfer(uint8_t data) {
+  spiBytes++;
+  if (first) {
+    first = false;
+    command = data;
+    if ((command & 0xf8) == rSUDFIFO)
+      sudPos = 0;
+    return hirq;
+  }
+  if (command & 0x02) {
+    writeRegister(command & 0xf8, data);
+    return 0;
+  }
+  return readRegister(command & 0xf8);
+}
@@ -0,0 +1,50 @@
+/*
+ Max3421eSim - register level model of the MAX3421E USB host controller,
+ for running the USB Host Shield library on the host.
+
+ The model decodes the SPI frames of the chip, a command byte followed by
+ data bytes, with the FIFO registers streaming.  A token written to HXFR
+ goes to the device at once; HXFRDNIRQ and the result in HRSL follow after
+ the bus time of the transaction at the device's speed.  The receive FIFO
+ is double buffered as on the chip: an IN can complete while the previous
+ packet is still being read, and freeing RCVFIFO (writing RCVDAVIRQ) makes
+ the next one readable.  Data toggles are checked against the device's.
+ SOF sets FRAMEIRQ once a millisecond while SOFKAENAB is on, and a bus
+ reset takes 50 ms.  INT is low while an enabled interrupt is pending.
+
+ Devices are UsbSimDevice models plugged into the root port by attach().
+ */
+
+#ifndef MAX3421ESIM_H
+#define MAX3421ESIM_H
+
+#include <stdint.h>
+
+class UsbSimDevice;
+
+class Max3421eSim {
+public:
+  // Powers up with nothing attached, all counters cleared
+  static void reset();
+  // Plugs a device into the root port, or unplugs it with NULL
+  static void attach(UsbSimDevice * dev);
+  // Moves the chip and the devices on to the current time
+  static void clock();
+
+  static unsigned long spiByteNs;     // time per SPI byte, 1000 by default
+
+  static unsigned long spiBytes;      // bytes clocked over SPI
+  static unsigned long selects;       // chip select cycles
+  static unsigned long transfers;     // tokens sent with HXFR
+  static unsigned long naks;          // transfers the device NAKed
+  static unsigned long toggleErrors;  // packets dropped on a toggle mismatch
+  static unsigned long overruns;      // INs sent with both receive FIFOs full
+  static uint64_t busyNs;             // time the bus was busy
+
+  // wiring, called by the SPI and port stand-ins
+  static void select(bool low);
+  static uint8_t transfer(uint8_t data);
+  static bool intLow();
+};
+
+#endif
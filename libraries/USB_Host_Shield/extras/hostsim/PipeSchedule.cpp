@@ -0,0 +1,312 @@
+/*
+ PipeSchedule - interrupt IN scheduling of USB::Task() on the MAX3421E model
+
+ HID devices with scripted interrupt endpoints are enumerated by the real
+ drivers and polled for 20 simulated seconds, with Task() called once per
+ sketch loop.  Each report carries the time it was made, so the latency to
+ the driver's report parser is known.  A report made while the previous
+ one was still waiting replaces it and counts as lost.
+
+   1  low speed boot keyboard, bInterval 10, keys about every 120 ms
+      (HIDBoot)
+   2  composite keyboard and mouse, bInterval 10 and 2, keys about every
+      120 ms and a mouse report every 4 ms (HIDUniversal)
+   3  full speed gamepad, bInterval 4, a report every 8 ms, and a low
+      speed boot mouse, bInterval 10, every 10 ms, behind a hub (USBHub
+      and two HIDUniversal)
+
+ With "timer" the drivers' pipes are closed and the endpoints are polled
+ with inTransfer() on a fixed timer instead, stopping at the first NAK, as
+ HIDUniversal (50 ms) and HIDBoot (10 ms) did before the scheduler.
+
+ Usage: PipeSchedule <scenario> <loop us> [timer]
+ */
+
+#include <stdio.h>
+#include <set>
+#include <random>
+#include <Usb.h>
+#include <usbhub.h>
+// before hidboot.h, whose totalEndpoints macro would shrink HIDUniversal
+#include <hiduniversal.h>
+#include <hidboot.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+struct Endpoint {
+  const char * name;
+  uint8_t ep, subclass, protocol, maxPacket, bInterval;
+  double periodMs;
+  bool poisson;
+
+  uint8_t tag;
+  bool pending;
+  uint16_t seq;
+  uint32_t made;
+  double next;
+  long generated, delivered, lost, tokens;
+  double latencySum, latencyMax;
+  std::set<unsigned long> frames;
+};
+
+static std::vector<Endpoint *> endpoints;
+static std::mt19937 rng(1);
+
+// HID device with one interrupt IN endpoint per interface
+class HidSim : public UsbSimDevice {
+public:
+  HidSim(bool lowSpeed, std::vector<Endpoint *> eps)
+    : UsbSimDevice(deviceDescr, NULL, lowSpeed), eps(eps) {
+    cfg.assign({ 9, 2, 0, 0, (uint8_t) eps.size(), 1, 0, 0xa0, 50 });
+    for (size_t i = 0; i < eps.size(); i++) {
+      Endpoint * e = eps[i];
+      uint8_t iface[] = {
+        9, 4, (uint8_t) i, 0, 1, 3, e->subclass, e->protocol, 0,
+        9, 0x21, 0x11, 0x01, 0, 1, 0x22, sizeof(reportDescr), 0,
+        7, 5, (uint8_t) (0x80 | e->ep), 3, e->maxPacket, 0, e->bInterval
+      };
+      cfg.insert(cfg.end(), iface, iface + sizeof(iface));
+      e->tag = endpoints.size();
+      e->next = micros();
+      endpoints.push_back(e);
+    }
+    cfg[2] = cfg.size();
+    config = cfg.data();
+  }
+
+  virtual int controlIn(const UsbSimSetup & s, uint8_t * data) {
+    if (s.bRequest == 6 && (s.wValue >> 8) == 0x22) {
+      memcpy(data, reportDescr, sizeof(reportDescr));
+      return sizeof(reportDescr);
+    }
+    return -1;
+  }
+
+  virtual bool controlOut(const UsbSimSetup & s, const uint8_t *, uint16_t) {
+    return s.bRequest == 0x0a || s.bRequest == 0x0b;   // SET_IDLE, SET_PROTOCOL
+  }
+
+  virtual int in(uint8_t ep, uint8_t * data) {
+    for (size_t i = 0; i < eps.size(); i++) {
+      Endpoint * e = eps[i];
+      if (e->ep != ep)
+        continue;
+      make(e);
+      e->tokens++;
+      e->frames.insert(millis());
+      if (!e->pending)
+        return -1;
+      memset(data, 0, e->maxPacket);
+      data[0] = e->tag;
+      memcpy(data + 1, &e->seq, 2);
+      memcpy(data + 3, &e->made, 4);
+      e->pending = false;
+      return e->maxPacket;
+    }
+    return -1;
+  }
+
+  virtual void frame() {
+    for (size_t i = 0; i < eps.size(); i++)
+      make(eps[i]);
+  }
+
+  static void make(Endpoint * e) {
+    while (e->next <= micros()) {
+      if (e->pending)
+        e->lost++;
+      e->pending = true;
+      e->seq++;
+      e->made = (uint32_t) e->next;
+      e->generated++;
+      double step = e->periodMs * 1000;
+      if (e->poisson)
+        step = std::exponential_distribution<double>(1 / step)(rng);
+      e->next += step;
+    }
+  }
+
+private:
+  static const uint8_t deviceDescr[18];
+  static const uint8_t reportDescr[2];
+  std::vector<Endpoint *> eps;
+  std::vector<uint8_t> cfg;
+};
+
+const uint8_t HidSim::deviceDescr[18] = {
+  18, 1, 0x10, 0x01, 0, 0, 0, 8, 0x34, 0x12, 0x78, 0x56, 0x00, 0x01, 0, 0, 0, 1
+};
+
+// a vendor defined collection, the reports are not decoded here
+const uint8_t HidSim::reportDescr[2] = { 0xc0, 0xc0 };
+
+// Report parser taking the latency of each report
+class Recorder : public HIDReportParser {
+public:
+  virtual void Parse(HID *, bool, uint8_t len, uint8_t * buf) {
+    if (len < 7 || buf[0] >= endpoints.size()) {
+      bad++;
+      return;
+    }
+    Endpoint * e = endpoints[buf[0]];
+    uint16_t seq;
+    uint32_t made;
+    memcpy(&seq, buf + 1, 2);
+    memcpy(&made, buf + 3, 4);
+    if ((int16_t) (seq - e->seq) > 0)
+      bad++;
+    double ms = (micros() - made) / 1000.0;
+    e->delivered++;
+    e->latencySum += ms;
+    if (ms > e->latencyMax)
+      e->latencyMax = ms;
+  }
+  long bad;
+};
+
+static Recorder recorder;
+
+// Polls the device's endpoints on a timer with inTransfer(), the way the
+// HID drivers did before the scheduler
+class TimerPolled : public HIDUniversal {
+public:
+  TimerPolled(USB * p, unsigned long ms) : HIDUniversal(p), ms(ms), next(0) {}
+  std::vector<Endpoint *> eps;
+
+  virtual uint8_t Poll() {
+    if (!bAddress || millis() < next)
+      return 0;
+    next = millis() + ms;
+    for (size_t i = 0; i < eps.size(); i++) {
+      uint8_t buf[64];
+      uint16_t read = eps[i]->maxPacket;
+      uint8_t rcode = pUsb->inTransfer(bAddress, eps[i]->ep, &read, buf);
+      if (rcode)
+        return rcode;
+      recorder.Parse(this, false, read, buf);
+    }
+    return 0;
+  }
+
+protected:
+  virtual uint8_t OnInitSuccessful() {
+    pUsb->closePipes(bAddress);
+    return 0;
+  }
+
+private:
+  unsigned long ms, next;
+};
+
+USB Usb;
+
+int main(int argc, char ** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <scenario 1-3> <loop us> [timer]\n", argv[0]);
+    return 2;
+  }
+  int scenario = atoi(argv[1]);
+  unsigned long loopUs = atol(argv[2]);
+  bool timer = argc > 3 && !strcmp(argv[3], "timer");
+
+  Max3421eSim::reset();
+
+  std::vector<HID *> drivers;
+  UsbSimDevice * root;
+  USBHub * hub = NULL;
+
+  if (scenario == 1) {
+    Endpoint * kbd = new Endpoint { "boot keyboard LS, bInterval 10", 1, 1, 1, 8, 10, 120, true };
+    root = new HidSim(true, { kbd });
+    if (timer) {
+      TimerPolled * t = new TimerPolled(&Usb, 10);
+      t->eps = { kbd };
+      drivers.push_back(t);
+    } else
+      drivers.push_back(new HIDBoot<HID_PROTOCOL_KEYBOARD>(&Usb));
+  } else if (scenario == 2) {
+    Endpoint * kbd = new Endpoint { "composite keyboard, bInterval 10", 1, 1, 1, 8, 10, 120, true };
+    Endpoint * mouse = new Endpoint { "composite mouse, bInterval 2", 2, 1, 2, 8, 2, 4, false };
+    root = new HidSim(false, { kbd, mouse });
+    if (timer) {
+      TimerPolled * t = new TimerPolled(&Usb, 50);
+      t->eps = { kbd, mouse };
+      drivers.push_back(t);
+    } else
+      drivers.push_back(new HIDUniversal(&Usb));
+  } else if (scenario == 3) {
+    Endpoint * pad = new Endpoint { "gamepad FS, bInterval 4", 1, 0, 0, 16, 4, 8, false };
+    Endpoint * mouse = new Endpoint { "boot mouse LS, bInterval 10", 1, 1, 2, 8, 10, 10, false };
+    UsbSimHub * h = new UsbSimHub;
+    h->connect(1, new HidSim(false, { pad }));
+    h->connect(2, new HidSim(true, { mouse }));
+    root = h;
+    hub = new USBHub(&Usb);
+    if (timer) {
+      TimerPolled * t1 = new TimerPolled(&Usb, 50), * t2 = new TimerPolled(&Usb, 10);
+      t1->eps = { pad };
+      t2->eps = { mouse };
+      drivers.push_back(t1);
+      drivers.push_back(t2);
+    } else {
+      drivers.push_back(new HIDUniversal(&Usb));
+      drivers.push_back(new HIDUniversal(&Usb));
+    }
+  } else {
+    fprintf(stderr, "no scenario %d\n", scenario);
+    return 2;
+  }
+  for (size_t i = 0; i < drivers.size(); i++)
+    drivers[i]->SetReportParser(0, &recorder);
+
+  Usb.Init();
+  Max3421eSim::attach(root);
+
+  // enumerate, then start counting
+  bool ready = false;
+  for (unsigned long t = millis(); !ready && millis() - t < 10000; hostAdvance(loopUs * 1000)) {
+    Usb.Task();
+    ready = Usb.getUsbTaskState() == USB_STATE_RUNNING;
+    for (size_t i = 0; i < drivers.size(); i++)
+      ready = ready && drivers[i]->GetAddress();
+  }
+  if (!ready) {
+    printf("scenario %d: devices not configured, USB task state %02x\n", scenario, Usb.getUsbTaskState());
+    return 1;
+  }
+  // the drivers have had reports already, go by what is made from here
+  for (size_t i = 0; i < endpoints.size(); i++) {
+    Endpoint * e = endpoints[i];
+    HidSim::make(e);
+    e->generated = e->delivered = e->lost = e->tokens = 0;
+    e->pending = false;
+    e->latencySum = e->latencyMax = 0;
+    e->frames.clear();
+  }
+
+  const double seconds = 20;
+  unsigned long start = millis(), spi = Max3421eSim::spiBytes, tasks = 0;
+  while (millis() - start < seconds * 1000) {
+    Usb.Task();
+    tasks++;
+    hostAdvance(loopUs * 1000);
+  }
+  for (size_t i = 0; i < endpoints.size(); i++)
+    HidSim::make(endpoints[i]);
+
+  printf("scenario %d, %s, loop %lu us: %.0f Task()/s, %.1f SPI bytes per Task()\n", scenario,
+         timer ? "timer polling" : "scheduled pipes", loopUs, tasks / seconds,
+         (double) (Max3421eSim::spiBytes - spi) / tasks);
+  for (size_t i = 0; i < endpoints.size(); i++) {
+    Endpoint * e = endpoints[i];
+    printf("  %-34s delivered %5ld/%5ld  lost %5ld  latency mean %5.1f max %5.1f ms"
+           "  IN %4.0f/s  frames %4.0f/s\n", e->name, e->delivered, e->generated, e->lost,
+           e->delivered ? e->latencySum / e->delivered : 0.0, e->latencyMax, e->tokens / seconds,
+           e->frames.size() / seconds);
+  }
+  bool ok = !recorder.bad && !Max3421eSim::toggleErrors && !Max3421eSim::overruns;
+  if (!ok)
+    printf("  FAILED: %ld bad reports, %lu toggle errors, %lu overruns\n", recorder.bad,
+           Max3421eSim::toggleErrors, Max3421eSim::overruns);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,613 @@
+/*
+ Ps3Multi - four PS3 controllers on one Bluetooth dongle
+
+ A CSR like dongle is enumerated by the real PS3BT driver.  It answers the
+ HCI commands on the control pipe with events on EP1 and carries ACL
+ packets over EP2 IN and EP2 OUT.  On the far end are scripted controllers
+ (Dualshock 3, Navigation and Move): once page scan is on, one pages the
+ dongle, opens the HID control and interrupt channels and takes the
+ output reports the driver sends - the LEDs, the sixaxis enable and the
+ Move bulb.
+
+ Reports are built from random bytes.  The expected values come from the
+ byte positions the getters read before the reports were decoded into
+ PS3State, applied to the report that was sent, and every getter of every
+ connected controller is compared after each report.  L2CAP echo requests
+ are sent in between, as signalling used to show through the getters.
+
+ Four controllers connect with LED1 to LED4, page scan goes off, the Move
+ bulb is written again every four seconds, and after a disconnect the next
+ controller takes the freed slot.
+
+ Usage: Ps3Multi
+ */
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <Usb.h>
+#include <PS3BT.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+static uint64_t now() { return hostNanos / 1000; }
+
+static int failures, checks;
+
+#define CHECK(c) do { checks++; if (!(c)) { failures++; printf("  FAIL line %d: %s\n", __LINE__, #c); } } while (0)
+#define CHECKEQ(a, b) do { checks++; long long a_ = (a), b_ = (b); if (a_ != b_) { failures++; \
+  printf("  FAIL line %d: %s = %lld, want %lld\n", __LINE__, #a, a_, b_); } } while (0)
+
+// ---- controllers ----
+
+struct Controller {
+  const char * name;
+  uint8_t addr[6];
+  uint16_t handle;
+  uint16_t ctrlCid, intrCid;  // the controller's end of the channels
+  int phase;                  // 0 control channel, 1 interrupt channel, 2 both open
+  bool linked, sixaxis;
+  uint8_t led, bulb[3];
+  int outputs;                // output reports taken since the link came up
+  uint8_t id;                 // signalling identifier
+};
+
+static std::vector<Controller> pads;
+
+// The host's channels, the same for every link
+static const uint16_t hostCtrlCid = 0x0040, hostIntrCid = 0x0041;
+
+// ACL packet and when it is through the air
+struct AclPacket {
+  uint64_t t;
+  std::vector<uint8_t> b;
+};
+
+class BtDongle : public UsbSimDevice {
+public:
+  BtDongle() : UsbSimDevice(deviceDescr, configDescr), nextHandle(0x0040), scanning(false), rxPos(0),
+    eventPos(0), airFree(0) {}
+
+  uint16_t nextHandle;
+  bool scanning;
+
+  // Delivers what has come through the air to the controllers, and the
+  // events that are due
+  void service();
+
+  // Controller k pages the dongle
+  void page(size_t k) { later(20000, INCOMING, k); }
+  // Sends an L2CAP packet from controller k to the host
+  void toHost(size_t k, uint16_t cid, const uint8_t * data, size_t n);
+  // Everything sent to the host has been read
+  bool idle() { return rx.empty(); }
+
+  virtual bool controlOut(const UsbSimSetup & s, const uint8_t * data, uint16_t len);
+
+  virtual int in(uint8_t ep, uint8_t * data) {
+    service();
+    if (ep == 1)
+      return packet(events, eventPos, 16, data);
+    if (ep == 2) {
+      if (rx.empty() || rx.front().t > now())
+        return -1;
+      std::deque<std::vector<uint8_t> > q(1, rx.front().b);
+      size_t pos = rxPos;
+      int n = packet(q, pos, 64, data);
+      if (q.empty()) {
+        rx.pop_front();
+        rxPos = 0;
+      } else
+        rxPos = pos;
+      return n;
+    }
+    return -1;
+  }
+
+  virtual bool out(uint8_t ep, const uint8_t * data, uint8_t len) {
+    service();
+    if (ep != 2)
+      return false;
+    outAcl.insert(outAcl.end(), data, data + len);
+    size_t total = outAcl.size() >= 4 ? 4u + (outAcl[2] | outAcl[3] << 8) : 0;
+    if (total && outAcl.size() >= total) {
+      if (outAcl.size() != total) {
+        printf("ACL length %u, packet %u bytes\n", (unsigned) total, (unsigned) outAcl.size());
+        exit(1);
+      }
+      airFree = std::max(airFree, now()) + airTime(total - 4);
+      AclPacket p = { airFree, outAcl };
+      air.push_back(p);
+      outAcl.clear();
+    }
+    return true;
+  }
+
+private:
+  static const uint8_t deviceDescr[18];
+  static const uint8_t configDescr[39];
+
+  enum Timer { INCOMING, NAME, CONNECT, DISCONNECT };
+  struct Pending {
+    uint64_t t;
+    Timer what;
+    size_t k;
+  };
+
+  std::deque<AclPacket> air;    // from the host, until the controller has it
+  std::deque<AclPacket> rx;     // for the host
+  size_t rxPos;
+  std::vector<uint8_t> outAcl;
+  std::deque<std::vector<uint8_t> > events;
+  size_t eventPos;
+  std::vector<Pending> timers;
+  uint64_t airFree;
+
+  // basic rate baseband packets: DH1 27, DH3 183, DH5 339 bytes, with the
+  // slot back
+  static uint64_t airTime(size_t n) { return n <= 27 ? 1250 : n <= 183 ? 2500 : 3750; }
+
+  // One packet of the message at the front of q, and a zero length one
+  // after a message that ends on a full packet
+  static int packet(std::deque<std::vector<uint8_t> > & q, size_t & pos, size_t max, uint8_t * data) {
+    if (q.empty())
+      return -1;
+    std::vector<uint8_t> & m = q.front();
+    size_t n = std::min(max, m.size() - pos);
+    memcpy(data, m.data() + pos, n);
+    pos += n;
+    if (pos == m.size() && n < max) {
+      q.pop_front();
+      pos = 0;
+    } else if (pos == m.size()) {
+      m.clear();
+      pos = 0;
+    }
+    return n;
+  }
+
+  void event(uint8_t code, const uint8_t * param, uint8_t n) {
+    std::vector<uint8_t> e(2 + n);
+    e[0] = code;
+    e[1] = n;
+    memcpy(e.data() + 2, param, n);
+    events.push_back(e);
+  }
+
+  void complete(uint16_t opcode, const uint8_t * ret = NULL, uint8_t n = 0) {
+    uint8_t p[16] = { 1, (uint8_t) opcode, (uint8_t) (opcode >> 8), 0 };
+    memcpy(p + 4, ret, n);
+    event(EV_COMMAND_COMPLETE, p, 4 + n);
+  }
+
+  void status(uint16_t opcode) {
+    uint8_t p[4] = { 0, 1, (uint8_t) opcode, (uint8_t) (opcode >> 8) };
+    event(EV_COMMAND_STATUS, p, 4);
+  }
+
+  void later(uint64_t us, Timer t, size_t k) {
+    Pending p = { now() + us, t, k };
+    timers.push_back(p);
+  }
+  void fire(Timer t, size_t k);
+};
+
+const uint8_t BtDongle::deviceDescr[18] = {
+  18, 1, 0x00, 0x02, 0xe0, 0x01, 0x01, 64, 0x12, 0x0a, 0x01, 0x00, 0x34, 0x12, 0, 0, 0, 1
+};
+
+const uint8_t BtDongle::configDescr[39] = {
+  9, 2, 39, 0, 1, 1, 0, 0x80, 50,
+  9, 4, 0, 0, 3, 0xe0, 0x01, 0x01, 0,
+  7, 5, 0x81, 3, 16, 0, 1,
+  7, 5, 0x82, 2, 64, 0, 0,
+  7, 5, 0x02, 2, 64, 0, 0
+};
+
+static BtDongle * dongle;
+
+static size_t byAddr(const uint8_t * addr) {
+  for (size_t k = 0; k < pads.size(); k++)
+    if (!memcmp(pads[k].addr, addr, 6))
+      return k;
+  printf("no controller with that address\n");
+  exit(1);
+}
+
+static void signal(size_t k, uint8_t code, const uint8_t * data, uint8_t n, uint8_t id = 0) {
+  uint8_t c[32] = { code, id ? id : ++pads[k].id, n, 0 };
+  memcpy(c + 4, data, n);
+  dongle->toHost(k, 0x0001, c, 4 + n);
+}
+
+// The link is up: open the HID control channel
+static void padConnected(size_t k) {
+  Controller & p = pads[k];
+  p.phase = 0;
+  p.sixaxis = false;
+  p.led = 0;
+  p.outputs = 0;
+  uint8_t req[4] = { L2CAP_PSM_HID_CTRL, 0, (uint8_t) p.ctrlCid, (uint8_t) (p.ctrlCid >> 8) };
+  signal(k, L2CAP_CMD_CONNECTION_REQUEST, req, 4);
+}
+
+static void padReceive(size_t k, const std::vector<uint8_t> & b) {
+  Controller & p = pads[k];
+  uint16_t cid = b[6] | b[7] << 8;
+  if (cid == 0x0001) {
+    switch (b[8]) {
+      case L2CAP_CMD_CONFIG_REQUEST: {  // accept it and send our own
+        uint16_t host = p.phase == 0 ? hostCtrlCid : hostIntrCid;
+        uint8_t rsp[6] = { (uint8_t) host, (uint8_t) (host >> 8), 0, 0, 0, 0 };
+        signal(k, L2CAP_CMD_CONFIG_RESPONSE, rsp, 6, b[9]);
+        uint8_t req[4] = { (uint8_t) host, (uint8_t) (host >> 8), 0, 0 };
+        signal(k, L2CAP_CMD_CONFIG_REQUEST, req, 4);
+        break;
+      }
+      case L2CAP_CMD_CONFIG_RESPONSE:   // ours was accepted
+        if (p.phase == 0) {
+          uint8_t req[4] = { L2CAP_PSM_HID_INTR, 0, (uint8_t) p.intrCid, (uint8_t) (p.intrCid >> 8) };
+          signal(k, L2CAP_CMD_CONNECTION_REQUEST, req, 4);
+        }
+        p.phase++;
+        break;
+      case L2CAP_CMD_DISCONNECT_REQUEST: {
+        uint8_t rsp[4] = { b[12], b[13], b[14], b[15] };
+        signal(k, L2CAP_CMD_DISCONNECT_RESPONSE, rsp, 4, b[9]);
+        break;
+      }
+    }
+  } else if (cid == p.ctrlCid) {
+    if (b[8] == 0x53)         // SET_REPORT feature: the sixaxis enable
+      p.sixaxis = true;
+    else if (b[8] == 0x52) {  // SET_REPORT output: rumble and LEDs
+      p.led = b[19];
+      p.outputs++;
+    }
+  } else if (cid == p.intrCid) {
+    if (b[8] == 0xa2) {       // DATA output: the Move bulb
+      memcpy(p.bulb, &b[11], 3);
+      p.outputs++;
+    }
+  } else {
+    printf("ACL packet on channel %04x\n", cid);
+    exit(1);
+  }
+}
+
+// ---- dongle ----
+
+bool BtDongle::controlOut(const UsbSimSetup & s, const uint8_t * c, uint16_t len) {
+  if (s.bmRequestType != (bmREQ_HCI_OUT) || s.bRequest || len < 3)
+    return false;
+  uint16_t opcode = c[0] | c[1] << 8;
+  switch (opcode) {
+    case 0x0c1a:    // Write Scan Enable
+      complete(opcode);
+      scanning = c[3] & 2;
+      break;
+    case 0x1009: {  // Read BD_ADDR
+      uint8_t addr[6] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 };
+      complete(opcode, addr, 6);
+      break;
+    }
+    case 0x1001: {  // Read Local Version Information: 2.0+EDR
+      uint8_t version[8] = { 4, 0, 0, 4, 0x0a, 0, 0, 0 };
+      complete(opcode, version, 8);
+      break;
+    }
+    case 0x0419:    // Remote Name Request
+      status(opcode);
+      later(2000, NAME, byAddr(c + 3));
+      break;
+    case 0x0409:    // Accept Connection Request
+      status(opcode);
+      later(5000, CONNECT, byAddr(c + 3));
+      break;
+    case 0x0406: {  // Disconnect
+      status(opcode);
+      uint16_t handle = c[3] | c[4] << 8;
+      for (size_t k = 0; k < pads.size(); k++)
+        if (pads[k].linked && pads[k].handle == handle)
+          later(3000, DISCONNECT, k);
+      break;
+    }
+    default:        // Reset and the rest
+      complete(opcode);
+      break;
+  }
+  return true;
+}
+
+void BtDongle::fire(Timer t, size_t k) {
+  Controller & p = pads[k];
+  switch (t) {
+    case INCOMING: {
+      if (!scanning)
+        break;
+      uint8_t e[10] = { 0 };
+      memcpy(e, p.addr, 6);
+      e[6] = 0x08;    // gamepad
+      e[7] = 0x05;
+      e[8] = 0x00;
+      e[9] = 1;       // ACL
+      event(EV_INCOMING_CONNECT, e, 10);
+      break;
+    }
+    case NAME: {
+      uint8_t e[37] = { 0 };
+      memcpy(e + 1, p.addr, 6);
+      strncpy((char *) e + 7, p.name, 30);
+      event(EV_REMOTE_NAME_COMPLETE, e, sizeof(e));
+      break;
+    }
+    case CONNECT: {
+      p.handle = nextHandle++;
+      p.linked = true;
+      uint8_t e[11] = { 0, (uint8_t) p.handle, (uint8_t) (p.handle >> 8) };
+      memcpy(e + 3, p.addr, 6);
+      e[9] = 1;
+      event(EV_CONNECT_COMPLETE, e, 11);
+      padConnected(k);
+      break;
+    }
+    case DISCONNECT: {
+      uint8_t e[4] = { 0, (uint8_t) p.handle, (uint8_t) (p.handle >> 8), 0x16 };
+      event(EV_DISCONNECT_COMPLETE, e, 4);
+      p.linked = false;
+      break;
+    }
+  }
+}
+
+void BtDongle::service() {
+  for (size_t i = 0; i < timers.size(); )
+    if (timers[i].t <= now()) {
+      Pending p = timers[i];
+      timers.erase(timers.begin() + i);
+      fire(p.what, p.k);
+    } else
+      i++;
+  while (!air.empty() && air.front().t <= now()) {
+    std::vector<uint8_t> b = air.front().b;
+    air.pop_front();
+    uint16_t handle = b[0] | (b[1] & 0x0f) << 8;
+    size_t k = 0;
+    while (k < pads.size() && !(pads[k].linked && pads[k].handle == handle))
+      k++;
+    if (k == pads.size()) {
+      printf("ACL packet for handle %03x\n", handle);
+      exit(1);
+    }
+    padReceive(k, b);
+  }
+}
+
+void BtDongle::toHost(size_t k, uint16_t cid, const uint8_t * data, size_t n) {
+  uint16_t handle = pads[k].handle;
+  AclPacket p;
+  p.b.resize(8 + n);
+  p.b[0] = handle & 0xff;
+  p.b[1] = (handle >> 8) | 0x20;
+  p.b[2] = (n + 4) & 0xff;
+  p.b[3] = (n + 4) >> 8;
+  p.b[4] = n & 0xff;
+  p.b[5] = n >> 8;
+  p.b[6] = cid & 0xff;
+  p.b[7] = cid >> 8;
+  memcpy(&p.b[8], data, n);
+  airFree = std::max(airFree, now()) + airTime(n + 4);
+  p.t = airFree;
+  rx.push_back(p);
+}
+
+// ---- reports ----
+
+static uint32_t seed = 12345;
+static uint8_t rnd() {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+// Indexed like the ACL packet, so the enum values are byte positions
+struct Report {
+  uint8_t b[58];
+  bool move;
+};
+
+static Report makeReport(bool move) {
+  Report r;
+  r.move = move;
+  for (size_t i = 10; i < sizeof(r.b); i++)
+    r.b[i] = rnd();
+  r.b[8] = 0xa1;    // DATA input
+  r.b[9] = 0x01;
+  if (rnd() & 1) {  // often nothing pressed
+    r.b[11 - move] = 0;
+    r.b[12 - move] = 0;
+    r.b[13 - move] &= 0x18;
+  }
+  return r;
+}
+
+// What the getters read from l2capinbuf before the reports were decoded
+static bool refButton(const Report & r, Button b) { return r.b[((uint16_t) b >> 8) - r.move] & ((uint8_t) b & 0xff); }
+static int16_t refSensor(const Report & r, Sensor a) {
+  const uint8_t * l = r.b;
+  if (!r.move)
+    return (l[a] << 8) | l[a + 1];
+  if (a == mXmove || a == mYmove)
+    return ((l[a] & 0x0f) << 8) | l[a + 1];
+  if (a == mZmove || a == tempMove)
+    return (l[a] << 4) | (l[a + 1] >> 4);
+  return l[a] | (l[a + 1] << 8);
+}
+
+static const Button buttons[] = { SELECT, L3, R3, START, UP, RIGHT, DOWN, LEFT, L2, R2, L1, R1, TRIANGLE,
+                                  CIRCLE, CROSS, SQUARE, PS };
+static const Button moveButtons[] = { SELECT, START, TRIANGLE, CIRCLE, CROSS, SQUARE, PS, MOVE, T };
+static const Sensor ds3Sensors[] = { aX, aY, aZ, gZ };
+static const Sensor moveSensors[] = { aXmove, aZmove, aYmove, gXmove, gZmove, gYmove, tempMove, mXmove, mZmove,
+                                      mYmove };
+static const AnalogHat hats[] = { LeftHatX, LeftHatY, RightHatX, RightHatY };
+
+// ---- sketch ----
+
+USB Usb;
+PS3BT PS3(&Usb);
+
+static void step() {
+  Usb.Task();
+  hostAdvance(20000);
+  dongle->service();
+}
+
+static void loopFor(uint64_t us) {
+  for (uint64_t end = now() + us; now() < end; )
+    step();
+}
+
+// Controller k pages the dongle; the driver waits two seconds before the
+// LEDs are set
+static bool connect(size_t k) {
+  dongle->page(k);
+  loopFor(3500000);
+  return pads[k].linked && pads[k].phase == 2;
+}
+
+// Getters of controller slot that differ from the report it sent last
+static int compare(const Report & r, uint8_t slot) {
+  int bad = 0;
+  if (!r.move) {
+    for (size_t i = 0; i < sizeof(hats) / sizeof(hats[0]); i++)
+      bad += PS3.getAnalogHat(hats[i], slot) != r.b[hats[i]];
+    for (int a = UP_ANALOG; a <= SQUARE_ANALOG; a++)
+      bad += PS3.getAnalogButton((AnalogButton) a, slot) != r.b[a];
+    for (size_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++)
+      bad += PS3.getButton(buttons[i], slot) != refButton(r, buttons[i]);
+    for (size_t i = 0; i < sizeof(ds3Sensors) / sizeof(ds3Sensors[0]); i++)
+      bad += PS3.getSensor(ds3Sensors[i], slot) != refSensor(r, ds3Sensors[i]);
+  } else {
+    bad += PS3.getAnalogButton(T_ANALOG, slot) != r.b[T_ANALOG];
+    for (size_t i = 0; i < sizeof(moveButtons) / sizeof(moveButtons[0]); i++)
+      bad += PS3.getButton(moveButtons[i], slot) != refButton(r, moveButtons[i]);
+    for (size_t i = 0; i < sizeof(moveSensors) / sizeof(moveSensors[0]); i++)
+      bad += PS3.getSensor(moveSensors[i], slot) != refSensor(r, moveSensors[i]);
+  }
+  return bad;
+}
+
+// Controllers who[i] in slots[i] take turns sending n reports, with echo
+// requests in between if asked; every getter of every slot is compared
+// after each report, and every queued button event with the button state
+static int stream(const char * what, const std::vector<size_t> & who, const std::vector<uint8_t> & slots, int n,
+                  bool echo) {
+  std::vector<Report> last(who.size());
+  std::vector<bool> have(who.size());
+  int bad = 0;
+  long events = 0;
+  for (int i = 0; i < n; i++) {
+    size_t j = i % who.size();
+    size_t k = who[j];
+    Report r = makeReport(!strcmp(pads[k].name, "Motion Controller"));
+    dongle->toHost(k, hostIntrCid, r.b + 8, sizeof(r.b) - 8);
+    if (echo && i % 3 == 0) {   // nothing to do with the report
+      uint8_t e[10] = { 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa };
+      signal(k, 0x08, e, sizeof(e));
+    }
+    // a report every 4 ms, later when the Move bulb refresh was on the air
+    loopFor(4000);
+    while (!dongle->idle())
+      step();
+    last[j] = r;
+    have[j] = true;
+    Button b;
+    bool pressed;
+    while (PS3.getButtonEvent(&b, &pressed, slots[j])) {
+      events++;
+      bad += PS3.getButton(b, slots[j]) != pressed;
+    }
+    for (size_t m = 0; m < who.size(); m++)
+      if (have[m])
+        bad += compare(last[m], slots[m]);
+  }
+  printf("  %-44s %5d reports %6ld button events %3d wrong values\n", what, n, events, bad);
+  return bad;
+}
+
+int main() {
+  const char * names[] = { "PLAYSTATION(R)3 Controller", "Navigation Controller", "Motion Controller",
+                           "PLAYSTATION(R)3 Controller", "PLAYSTATION(R)3 Controller" };
+  for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+    Controller p = {};
+    p.name = names[k];
+    for (int i = 0; i < 6; i++)
+      p.addr[i] = 0xa0 + k * 8 + i;
+    p.ctrlCid = 0x0050 + 2 * k;
+    p.intrCid = p.ctrlCid + 1;
+    pads.push_back(p);
+  }
+
+  Max3421eSim::reset();
+  BtDongle bt;
+  dongle = &bt;
+  Usb.Init();
+  Max3421eSim::attach(&bt);
+  for (unsigned long t = millis(); !PS3.isWatingForConnection() && millis() - t < 10000; )
+    step();
+  if (!PS3.isWatingForConnection()) {
+    printf("dongle not set up, USB task state %02x\n", Usb.getUsbTaskState());
+    return 1;
+  }
+  CHECK(bt.scanning);
+
+  printf("connecting\n");
+  for (size_t k = 0; k < 4; k++) {
+    CHECK(connect(k));
+    CHECKEQ(PS3.getControllerType(k), pads[k].name[0]);
+  }
+  CHECK(!bt.scanning);
+  CHECKEQ(pads[0].led, LED1 << 1);
+  CHECKEQ(pads[1].led, LED2 << 1);
+  CHECKEQ(pads[3].led, LED4 << 1);
+  CHECK(pads[0].sixaxis && pads[1].sixaxis && !pads[2].sixaxis && pads[3].sixaxis);
+  CHECK(pads[2].bulb[0] == 255 && !pads[2].bulb[1] && !pads[2].bulb[2]);
+  CHECK(PS3.PS3Connected && !PS3.PS3MoveConnected && !PS3.PS3NavigationConnected);
+
+  printf("reports\n");
+  std::vector<size_t> one(1, 0);
+  std::vector<uint8_t> slot0(1, 0);
+  CHECKEQ(stream("one Dualshock 3", one, slot0, 300, false), 0);
+  CHECKEQ(stream("one Dualshock 3, echo requests in between", one, slot0, 300, true), 0);
+  size_t all[] = { 0, 1, 2, 3 };
+  uint8_t slots[] = { 0, 1, 2, 3 };
+  std::vector<size_t> four(all, all + 4);
+  std::vector<uint8_t> fourSlots(slots, slots + 4);
+  CHECKEQ(stream("four controllers interleaved", four, fourSlots, 1200, true), 0);
+
+  // the Move bulb is written again every four seconds
+  int outputs = pads[2].outputs;
+  loopFor(9000000);
+  CHECKEQ(pads[2].outputs - outputs, 2);
+
+  // the Navigation controller is turned off and another one takes its slot
+  printf("reconnecting\n");
+  PS3.disconnect(1);
+  loopFor(500000);
+  CHECK(!pads[1].linked);
+  CHECKEQ(PS3.getControllerType(1), NoController);
+  CHECK(bt.scanning);
+  PS3.setLedOn(LED1, 1);    // nothing there, nothing is sent
+  CHECK(connect(4));
+  CHECKEQ(PS3.getControllerType(1), Dualshock3);
+  CHECKEQ(pads[4].led, LED2 << 1);
+  CHECK(!bt.scanning);
+  all[1] = 4;
+  four.assign(all, all + 4);
+  CHECKEQ(stream("after reconnecting", four, fourSlots, 800, true), 0);
+
+  CHECK(!Max3421eSim::toggleErrors && !Max3421eSim::overruns);
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
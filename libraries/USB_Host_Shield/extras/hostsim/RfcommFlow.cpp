@@ -0,0 +1,679 @@
+/*
+ RfcommFlow - RFCOMM frames and credit based flow control over a dongle
+
+ A CSR like Bluetooth dongle is enumerated by the real RFCOMM driver.  It
+ answers the HCI commands on the control pipe with events on EP1, and
+ carries ACL packets over EP2 IN and EP2 OUT to an SPP device on the far
+ end of the link.  The dongle has 8 ACL buffers and NAKs the OUT pipe while
+ they are full; each packet takes the air time of the basic rate baseband
+ packet it fits in (DH1, DH3 or DH5 and the slot back).
+
+ The SPP device pages the dongle once scanning is enabled, opens an L2CAP
+ channel to the RFCOMM PSM and starts the multiplexer: SABM, Parameter
+ Negotiation with its frame size and credit, SABM on DLCI 2 and the Modem
+ Status exchange.  It checks the FCS, the byte order and that no frame
+ comes without credit, and hands out credit again when half is used.
+ Between peers it closes the L2CAP channel and drops the link, and the
+ driver goes back to scanning.
+
+ For each peer 16 KB is written in 256 byte pieces and in one call, 1000
+ lines are sent with println(), 16 KB is read, and a sketch that stops
+ reading must not lose data.
+
+ Usage: RfcommFlow
+ */
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <Usb.h>
+#include <RFCOMM.h>
+#include <CRC.h>
+#include "Max3421eSim.h"
+#include "UsbSimDevice.h"
+
+static uint64_t now() { return hostNanos / 1000; }
+
+// An ACL packet and when it is through the air
+struct AclPacket {
+  uint64_t t;
+  std::vector<uint8_t> b;
+};
+
+class BtDongle : public UsbSimDevice {
+public:
+  BtDongle() : UsbSimDevice(deviceDescr, configDescr), handle(0x002a), scanning(false), paging(false) {
+    clear();
+  }
+
+  static const int aclBuffers = 8;
+  static const uint16_t peerCid = 0x0040;   // the peer's RFCOMM channel, our frames go there
+
+  uint16_t handle;
+  long naks, aclOut, aclIn;
+
+  void clear() {
+    air.clear();
+    rx.clear();
+    rxPos = 0;
+    outAcl.clear();
+    airFree = now();
+    naks = aclOut = aclIn = 0;
+  }
+
+  // Delivers what has come through the air to the peer, and the events
+  // that are due
+  void service();
+
+  // The SPP device pages the dongle, now or once page scan is on
+  void page() {
+    paging = true;
+    if (scanning)
+      later(20000, INCOMING);
+  }
+  // Nothing on its way in either direction
+  bool idle() { return air.empty() && rx.empty() && outAcl.empty(); }
+  // Sends an L2CAP packet from the peer to the host
+  void toHost(uint16_t cid, const uint8_t * data, size_t n);
+  // Drops the link, the peer having closed its channel
+  void disconnect() { later(5000, DISCONNECT); }
+
+  virtual bool controlOut(const UsbSimSetup & s, const uint8_t * data, uint16_t len);
+
+  virtual int in(uint8_t ep, uint8_t * data) {
+    service();
+    if (ep == 1)
+      return packet(events, eventPos, 16, data);
+    if (ep == 2) {
+      if (rx.empty() || rx.front().t > now()) {
+        naks++;
+        return -1;
+      }
+      std::deque<std::vector<uint8_t> > q(1, rx.front().b);
+      size_t pos = rxPos;
+      int n = packet(q, pos, 64, data);
+      if (q.empty()) {
+        rx.pop_front();
+        rxPos = 0;
+      } else
+        rxPos = pos;
+      return n;
+    }
+    return -1;
+  }
+
+  virtual bool out(uint8_t ep, const uint8_t * data, uint8_t len) {
+    service();
+    if (ep != 2)
+      return false;
+    if (outAcl.empty() && (int) air.size() >= aclBuffers) {
+      naks++;
+      return false;
+    }
+    outAcl.insert(outAcl.end(), data, data + len);
+    size_t total = outAcl.size() >= 4 ? 4u + (outAcl[2] | outAcl[3] << 8) : 0;
+    if (total && outAcl.size() >= total) {
+      if (outAcl.size() != total) {
+        printf("ACL length %u, packet %u bytes\n", (unsigned) total, (unsigned) outAcl.size());
+        exit(1);
+      }
+      airFree = std::max(airFree, now()) + airTime(total - 4);
+      AclPacket p = { airFree, outAcl };
+      air.push_back(p);
+      outAcl.clear();
+      aclOut++;
+    }
+    return true;
+  }
+
+  virtual void reset() {
+    UsbSimDevice::reset();
+    events.clear();
+    eventPos = 0;
+    timers.clear();
+    scanning = paging = false;
+    clear();
+  }
+
+private:
+  static const uint8_t deviceDescr[18];
+  static const uint8_t configDescr[39];
+
+  enum Timer { INCOMING, NAME, CONNECT, DISCONNECT };
+
+  std::deque<AclPacket> air;    // from the host, until the peer has it
+  std::deque<AclPacket> rx;     // for the host, once the dongle has it
+  size_t rxPos;
+  std::vector<uint8_t> outAcl;  // ACL packet coming from the host
+  uint64_t airFree;             // the air is busy until then
+  std::deque<std::vector<uint8_t> > events;
+  size_t eventPos;
+  std::vector<std::pair<uint64_t, Timer> > timers;
+  bool scanning, paging;
+
+  // basic rate baseband packets: DH1 27, DH3 183, DH5 339 bytes, with the
+  // slot back
+  static uint64_t airTime(size_t n) { return n <= 27 ? 1250 : n <= 183 ? 2500 : 3750; }
+
+  // One packet of the message at the front of q, and a zero length one
+  // after a message that ends on a full packet
+  static int packet(std::deque<std::vector<uint8_t> > & q, size_t & pos, size_t max, uint8_t * data) {
+    if (q.empty())
+      return -1;
+    std::vector<uint8_t> & m = q.front();
+    size_t n = std::min(max, m.size() - pos);
+    memcpy(data, m.data() + pos, n);
+    pos += n;
+    if (pos == m.size() && n < max) {
+      q.pop_front();
+      pos = 0;
+    } else if (pos == m.size()) {
+      m.clear();
+      pos = 0;
+    }
+    return n;
+  }
+
+  void event(uint8_t code, const uint8_t * param, uint8_t n) {
+    std::vector<uint8_t> e(2 + n);
+    e[0] = code;
+    e[1] = n;
+    memcpy(e.data() + 2, param, n);
+    events.push_back(e);
+  }
+
+  void complete(uint16_t opcode, const uint8_t * ret = NULL, uint8_t n = 0) {
+    uint8_t p[16] = { 1, (uint8_t) opcode, (uint8_t) (opcode >> 8), 0 };
+    memcpy(p + 4, ret, n);
+    event(EV_COMMAND_COMPLETE, p, 4 + n);
+  }
+
+  void status(uint16_t opcode) {
+    uint8_t p[4] = { 0, 1, (uint8_t) opcode, (uint8_t) (opcode >> 8) };
+    event(EV_COMMAND_STATUS, p, 4);
+  }
+
+  void later(uint64_t us, Timer t) { timers.push_back(std::make_pair(now() + us, t)); }
+  void fire(Timer t);
+};
+
+const uint8_t BtDongle::deviceDescr[18] = {
+  18, 1, 0x00, 0x02, 0xe0, 0x01, 0x01, 64, 0x12, 0x0a, 0x01, 0x00, 0x34, 0x12, 0, 0, 0, 1
+};
+
+const uint8_t BtDongle::configDescr[39] = {
+  9, 2, 39, 0, 1, 1, 0, 0x80, 50,
+  9, 4, 0, 0, 3, 0xe0, 0x01, 0x01, 0,
+  7, 5, 0x81, 3, 16, 0, 1,
+  7, 5, 0x82, 2, 64, 0, 0,
+  7, 5, 0x02, 2, 64, 0, 0
+};
+
+static const uint8_t peerAddr[6] = { 0x66, 0x55, 0x44, 0x33, 0x22, 0x11 };
+
+// ---- SPP device ----
+
+// DLCI 2, server channel 1
+static const uint8_t dlci = 2;
+
+struct Peer {
+  uint16_t n1;              // frame size it proposes
+  bool credits;             // asks for credit based flow control
+  int rxMax;                // credit it gives, topped up at half
+};
+
+static BtDongle * dongle;
+static Peer peer;
+static uint8_t sigId;
+static uint16_t hostCid;          // the host's end of the channel, from its connection response
+static bool l2capOut, l2capIn;    // our config accepted, theirs accepted
+static int rxCredit, txCredit;    // what the host may still send, what the peer may still send
+static uint16_t n1;               // negotiated
+static bool cfc;
+static long violations, badFcs, badSeq, gotBytes, peerSent, peerToSend;
+static uint8_t rxSeq, txSeq;
+
+static uint8_t fcs(const uint8_t * f, int n) { return 0xff - crc8Rfcomm(0xff, f, n); }
+
+static void signal(uint8_t code, uint8_t id, const uint8_t * data, uint8_t n) {
+  uint8_t c[32] = { code, id, n, 0 };
+  memcpy(c + 4, data, n);
+  dongle->toHost(0x0001, c, 4 + n);
+}
+
+static void frame(uint8_t address, uint8_t ctrl, const uint8_t * info, size_t len, int credit = -1) {
+  uint8_t f[1100];
+  size_t i = 0;
+  f[i++] = address << 2 | 2 | 1;
+  f[i++] = ctrl | (credit >= 0 ? 0x10 : 0);
+  if (len > 127) {
+    f[i++] = len << 1;
+    f[i++] = len >> 7;
+  } else
+    f[i++] = len << 1 | 1;
+  if (credit >= 0)
+    f[i++] = credit;
+  memcpy(f + i, info, len);
+  i += len;
+  f[i] = fcs(f, (ctrl & 0xef) == RFCOMM_UIH ? 2 : 3);
+  dongle->toHost(hostCid, f, i + 1);
+}
+
+static void mux(uint8_t type, const uint8_t * v, uint8_t n) {
+  uint8_t m[16] = { type, (uint8_t) (n << 1 | 1) };
+  memcpy(m + 2, v, n);
+  frame(0, RFCOMM_UIH, m, n + 2);
+}
+
+static void peerData() {
+  while (peerToSend > peerSent && (!cfc || txCredit > 0)) {
+    uint8_t d[1024];
+    size_t n = std::min<long>(n1, peerToSend - peerSent);
+    for (size_t i = 0; i < n; i++)
+      d[i] = txSeq++;
+    int credit = -1;
+    if (cfc && rxCredit <= peer.rxMax / 2) {
+      credit = peer.rxMax - rxCredit;
+      rxCredit = peer.rxMax;
+    }
+    frame(dlci, RFCOMM_UIH, d, n, credit);
+    peerSent += n;
+    if (cfc)
+      txCredit--;
+  }
+}
+
+// The link is up: open the RFCOMM channel
+static void peerConnected() {
+  sigId = 1;
+  l2capOut = l2capIn = false;
+  uint8_t req[4] = { RFCOMM_PSM, 0, BtDongle::peerCid & 0xff, BtDongle::peerCid >> 8 };
+  signal(L2CAP_CMD_CONNECTION_REQUEST, sigId++, req, 4);
+}
+
+static void peerSignal(const uint8_t * c) {
+  uint8_t code = c[0], id = c[1];
+  if (code == L2CAP_CMD_CONNECTION_RESPONSE) {
+    if (c[8] == SUCCESSFUL && !c[9]) {
+      hostCid = c[4] | c[5] << 8;
+      uint8_t cfg[4] = { c[4], c[5], 0, 0 };
+      signal(L2CAP_CMD_CONFIG_REQUEST, sigId++, cfg, 4);
+    }
+  } else if (code == L2CAP_CMD_CONFIG_REQUEST) {
+    if ((c[4] | c[5] << 8) != BtDongle::peerCid) {
+      printf("config request for CID %04x\n", c[4] | c[5] << 8);
+      exit(1);
+    }
+    uint8_t rsp[6] = { (uint8_t) hostCid, (uint8_t) (hostCid >> 8), 0, 0, 0, 0 };
+    signal(L2CAP_CMD_CONFIG_RESPONSE, id, rsp, 6);
+    l2capIn = true;
+  } else if (code == L2CAP_CMD_CONFIG_RESPONSE)
+    l2capOut = !c[8] && !c[9];
+  else if (code == L2CAP_CMD_DISCONNECT_RESPONSE) {
+    dongle->disconnect();
+    return;
+  }
+  // configured both ways, start the multiplexer
+  if (l2capIn && l2capOut) {
+    l2capIn = false;
+    frame(0, RFCOMM_SABM | 0x10, NULL, 0);
+  }
+}
+
+static void peerReceive(const std::vector<uint8_t> & acl) {
+  uint16_t cid = acl[6] | acl[7] << 8;
+  if (cid == 0x0001) {
+    peerSignal(&acl[8]);
+    return;
+  }
+  if (cid != BtDongle::peerCid) {
+    printf("frame to CID %04x\n", cid);
+    exit(1);
+  }
+  const uint8_t * f = &acl[8];
+  size_t flen = acl.size() - 8;
+  uint8_t address = f[0] >> 2, ctrl = f[1] & 0xef;
+  bool pf = f[1] & 0x10;
+  size_t i = 2, len = f[i] >> 1;
+  if (!(f[i++] & 1))
+    len |= f[i++] << 7;
+  if (f[flen - 1] != fcs(f, ctrl == RFCOMM_UIH ? 2 : 3))
+    badFcs++;
+  if (ctrl == RFCOMM_UA) {
+    if (address == 0) {   // multiplexer up, negotiate
+      uint8_t pn[8] = { dlci, (uint8_t) (peer.credits ? 0xf0 : 0), 7, 0, (uint8_t) peer.n1,
+                        (uint8_t) (peer.n1 >> 8), 0, (uint8_t) (peer.credits ? peer.rxMax : 0) };
+      mux(BT_RFCOMM_PN_CMD, pn, 8);
+    } else {
+      uint8_t msc[2] = { (uint8_t) (dlci << 2 | 3), 0x8d };
+      mux(BT_RFCOMM_MSC_CMD, msc, 2);
+    }
+    return;
+  }
+  if (ctrl != RFCOMM_UIH)
+    return;
+  if (address == 0) {
+    uint8_t type = f[i];
+    if (type == BT_RFCOMM_PN_RSP) {
+      const uint8_t * v = f + i + 2;
+      cfc = peer.credits && v[1] == 0xe0;
+      n1 = v[4] | v[5] << 8;
+      rxCredit = cfc ? peer.rxMax : 0;
+      txCredit = cfc ? v[7] : 0;
+      frame(dlci, RFCOMM_SABM | 0x10, NULL, 0);
+    } else if (type == BT_RFCOMM_MSC_CMD) {
+      uint8_t m[2] = { f[i + 2], f[i + 3] };
+      mux(BT_RFCOMM_MSC_RSP, m, 2);
+    }
+    return;
+  }
+  if (pf)
+    txCredit += f[i++];
+  if (len) {
+    if (cfc) {
+      if (rxCredit <= 0)
+        violations++;
+      else
+        rxCredit--;
+    }
+    for (size_t k = 0; k < len; k++)
+      if (f[i + k] != rxSeq++) {
+        badSeq++;
+        rxSeq = f[i + k] + 1;
+      }
+    gotBytes += len;
+    // top up when idle in the other direction
+    if (cfc && rxCredit <= peer.rxMax / 2 && peerToSend <= peerSent) {
+      frame(dlci, RFCOMM_UIH, NULL, 0, peer.rxMax - rxCredit);
+      rxCredit = peer.rxMax;
+    }
+  }
+  peerData();
+}
+
+// ---- dongle ----
+
+bool BtDongle::controlOut(const UsbSimSetup & s, const uint8_t * c, uint16_t len) {
+  if (s.bmRequestType != (bmREQ_HCI_OUT) || s.bRequest || len < 3)
+    return false;
+  uint16_t opcode = c[0] | c[1] << 8;
+  switch (opcode) {
+    case 0x0c1a:    // Write Scan Enable
+      complete(opcode);
+      scanning = c[3] & 2;
+      if (scanning && paging)
+        later(20000, INCOMING);
+      break;
+    case 0x1009: {  // Read BD_ADDR
+      uint8_t addr[6] = { 0x01, 0x00, 0x00, 0x5b, 0x02, 0x00 };
+      complete(opcode, addr, 6);
+      break;
+    }
+    case 0x0419:    // Remote Name Request
+      status(opcode);
+      later(10000, NAME);
+      break;
+    case 0x0409:    // Accept Connection Request
+      status(opcode);
+      later(5000, CONNECT);
+      break;
+    case 0x0406:    // Disconnect
+      status(opcode);
+      later(5000, DISCONNECT);
+      break;
+    default:        // Reset, Write Local Name and the rest
+      complete(opcode);
+      break;
+  }
+  return true;
+}
+
+void BtDongle::fire(Timer t) {
+  switch (t) {
+    case INCOMING: {
+      paging = false;
+      uint8_t p[10] = { 0 };
+      memcpy(p, peerAddr, 6);
+      p[6] = 0x0c;    // laptop
+      p[7] = 0x01;
+      p[8] = 0x20;
+      p[9] = 1;       // ACL
+      event(EV_INCOMING_CONNECT, p, 10);
+      break;
+    }
+    case NAME: {
+      uint8_t p[37] = { 0 };
+      memcpy(p + 1, peerAddr, 6);
+      strcpy((char *) p + 7, "SPP host");
+      event(EV_REMOTE_NAME_COMPLETE, p, sizeof(p));
+      break;
+    }
+    case CONNECT: {
+      uint8_t p[11] = { 0, (uint8_t) handle, (uint8_t) (handle >> 8) };
+      memcpy(p + 3, peerAddr, 6);
+      p[9] = 1;
+      event(EV_CONNECT_COMPLETE, p, 11);
+      peerConnected();
+      break;
+    }
+    case DISCONNECT: {
+      uint8_t p[4] = { 0, (uint8_t) handle, (uint8_t) (handle >> 8), 0x13 };
+      event(EV_DISCONNECT_COMPLETE, p, 4);
+      air.clear();
+      rx.clear();
+      rxPos = 0;
+      handle++;
+      break;
+    }
+  }
+}
+
+void BtDongle::service() {
+  for (size_t i = 0; i < timers.size(); )
+    if (timers[i].first <= now()) {
+      Timer t = timers[i].second;
+      timers.erase(timers.begin() + i);
+      fire(t);
+    } else
+      i++;
+  while (!air.empty() && air.front().t <= now()) {
+    std::vector<uint8_t> b = air.front().b;
+    air.pop_front();
+    if ((b[0] | (b[1] & 0x0f) << 8) != handle) {
+      printf("ACL packet for handle %03x\n", b[0] | (b[1] & 0x0f) << 8);
+      exit(1);
+    }
+    peerReceive(b);
+  }
+}
+
+void BtDongle::toHost(uint16_t cid, const uint8_t * data, size_t n) {
+  AclPacket p;
+  p.b.resize(8 + n);
+  p.b[0] = handle & 0xff;
+  p.b[1] = (handle >> 8) | 0x20;
+  p.b[2] = (n + 4) & 0xff;
+  p.b[3] = (n + 4) >> 8;
+  p.b[4] = n & 0xff;
+  p.b[5] = n >> 8;
+  p.b[6] = cid & 0xff;
+  p.b[7] = cid >> 8;
+  memcpy(&p.b[8], data, n);
+  airFree = std::max(airFree, now()) + airTime(n + 4);
+  p.t = airFree;
+  rx.push_back(p);
+  aclIn++;
+}
+
+// ---- sketch ----
+
+USB Usb;
+RFCOMM SerialBT(&Usb);
+
+static void step() {
+  Usb.Task();
+  hostAdvance(20000);
+  dongle->service();
+}
+
+static void loopFor(uint64_t us) {
+  for (uint64_t end = now() + us; now() < end; )
+    step();
+}
+
+// Until the dongle's buffers are through the air and the credit is back
+static void drainOut() {
+  for (uint64_t t0 = now(); !dongle->idle() && now() - t0 < 2000000; )
+    step();
+  loopFor(20000);
+}
+
+struct Meter {
+  uint64_t t0;
+  Meter() : t0(now()) {}
+  void report(const char * what, long bytes) {
+    double ms = (now() - t0) / 1000.0;
+    printf("  %-32s %8.1f ms %6.1f KB/s  ACL out %4ld in %4ld  lost %ld  no credit %ld  bad %ld/%ld\n",
+           what, ms, bytes / 1.024 / ms, dongle->aclOut, dongle->aclIn, bytes - gotBytes, violations,
+           badFcs, badSeq);
+  }
+  void restart() {
+    t0 = now();
+    dongle->aclOut = dongle->aclIn = 0;
+    gotBytes = 0;
+    rxSeq = 0;
+  }
+};
+
+#define OK(x) do { if (!(x)) { printf("  check failed at line %d: %s\n", __LINE__, #x); ok = false; } } while (0)
+
+int main() {
+  bool ok = true;
+  Max3421eSim::reset();
+  BtDongle bt;
+  dongle = &bt;
+  Usb.Init();
+  Max3421eSim::attach(&bt);
+  for (unsigned long t = millis(); !SerialBT.isWatingForConnection() && millis() - t < 10000; )
+    step();
+  if (!SerialBT.isWatingForConnection()) {
+    printf("dongle not set up, USB task state %02x\n", Usb.getUsbTaskState());
+    return 1;
+  }
+
+  static uint8_t data[16384];
+  for (size_t i = 0; i < sizeof(data); i++)
+    data[i] = i;
+  const char * line = "sensor 1023 512 77";   // 18 characters and CRLF
+
+  struct {
+    const char * name;
+    Peer peer;
+  } peers[] = {
+    { "credit based, N1 990", { 990, true, 7 } },
+    { "credit based, N1 127", { 127, true, 7 } },
+    { "no credits, N1 127", { 127, false, 7 } },
+    { "credit based, N1 64, 1 credit", { 64, true, 1 } },
+  };
+  for (size_t k = 0; k < sizeof(peers) / sizeof(peers[0]); k++) {
+    peer = peers[k].peer;
+    printf("peer: %s\n", peers[k].name);
+    violations = badFcs = badSeq = gotBytes = peerSent = peerToSend = 0;
+    rxSeq = txSeq = 0;
+    cfc = false;
+    n1 = 127;
+    bt.clear();
+    bt.page();
+    for (uint64_t t0 = now(); !SerialBT.connected && now() - t0 < 3000000; )
+      step();
+    loopFor(5000);
+    OK(SerialBT.connected);
+    if (!SerialBT.connected)
+      break;
+    printf("  connected, frame size %u, credit based %d\n", n1, cfc);
+    OK(n1 == std::min<unsigned>(peer.n1, RFCOMM_MAX_FRAME_SIZE) && cfc == peer.credits);
+
+    Meter m;
+    // 16 KB sent in 256 byte pieces from loop()
+    m.restart();
+    for (size_t i = 0; i < sizeof(data); i += 256) {
+      OK(SerialBT.write(data + i, 256) == 256);
+      step();
+    }
+    drainOut();
+    m.report("write 16 KB, 256 bytes a time", sizeof(data));
+
+    m.restart();
+    OK(SerialBT.write(data, sizeof(data)) == sizeof(data));
+    drainOut();
+    m.report("write 16 KB in one call", sizeof(data));
+
+    // 1000 lines with println()
+    m.restart();
+    for (int i = 0; i < 1000; i++) {
+      SerialBT.println(line);
+      step();
+    }
+    drainOut();
+    badSeq = 0;   // the lines are not a counting sequence
+    m.report("println() 1000 lines", 20000);
+
+    // 16 KB from the peer, read from loop()
+    {
+      static uint8_t got[16384];
+      long n = 0;
+      m.restart();
+      peerToSend = sizeof(data);
+      peerSent = 0;
+      txSeq = 0;
+      peerData();
+      for (uint64_t t0 = now(); n < (long) sizeof(data) && now() - t0 < 3000000; ) {
+        step();
+        n += SerialBT.read(got + n, std::min<long>(64, sizeof(data) - n));
+      }
+      long good = 0;
+      for (long i = 0; i < n; i++)
+        if (got[i] == (uint8_t) i)
+          good++;
+      gotBytes = good;
+      m.report("read 16 KB", sizeof(data));
+      peerToSend = 0;
+    }
+    OK(violations == 0 && badFcs == 0 && badSeq == 0);
+
+    // a sketch that stops reading must not lose data
+    {
+      peerToSend = 2000;
+      peerSent = 0;
+      txSeq = 0;
+      gotBytes = 0;
+      peerData();
+      loopFor(300000);
+      OK(SerialBT.available() >= 255 - n1 && (!cfc || peerSent < 2000 - 255));
+      static uint8_t got[2000];
+      long n = 0;
+      for (uint64_t t0 = now(); n < 2000 && now() - t0 < 1000000; ) {
+        step();
+        n += SerialBT.read(got + n, std::min<long>(100, 2000 - n));
+      }
+      if (cfc)
+        OK(n == 2000);
+      for (long i = 0; i < n; i++)
+        OK(got[i] == (uint8_t) i);
+      peerToSend = 0;
+    }
+
+    // the peer closes its channel and drops the link
+    loopFor(20000);
+    uint8_t d[4] = { (uint8_t) hostCid, (uint8_t) (hostCid >> 8), BtDongle::peerCid & 0xff, BtDongle::peerCid >> 8 };
+    signal(L2CAP_CMD_DISCONNECT_REQUEST, sigId++, d, 4);
+    for (uint64_t t0 = now(); (SerialBT.connected || !SerialBT.isWatingForConnection()) && now() - t0 < 1000000; )
+      step();
+    OK(!SerialBT.connected && SerialBT.isWatingForConnection());
+  }
+  bool clean = !Max3421eSim::toggleErrors && !Max3421eSim::overruns;
+  OK(clean);
+  printf("checks %s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
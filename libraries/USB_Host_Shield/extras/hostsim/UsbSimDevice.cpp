@@ -0,0 +1,298 @@
+// Control endpoint, toggles and the hub of the device models
+
+#include <string.h>
+#include <max3421e.h>
+#include "UsbSimDevice.h"
+#include "Max3421eSim.h"
+
+UsbSimDevice::UsbSimDevice(const uint8_t * device, const uint8_t * config, bool lowSpeed)
+  : lowSpeed(lowSpeed), enabled(false), device(device), config(config) {
+  reset();
+  enabled = false;
+}
+
+void UsbSimDevice::reset() {
+  enabled = true;
+  address = 0;
+  configuration = 0;
+  ctl.clear();
+  ctlPos = 0;
+  ctlStall = false;
+  memset(inToggle, 0, sizeof(inToggle));
+  memset(outToggle, 0, sizeof(outToggle));
+}
+
+UsbSimDevice * UsbSimDevice::find(uint8_t addr) {
+  return enabled && address == addr ? this : NULL;
+}
+
+int UsbSimDevice::controlIn(const UsbSimSetup &, uint8_t *) { return -1; }
+bool UsbSimDevice::controlOut(const UsbSimSetup &, const uint8_t *, uint16_t) { return false; }
+int UsbSimDevice::in(uint8_t, uint8_t *) { return -1; }
+bool UsbSimDevice::out(uint8_t, const uint8_t *, uint8_t) { return false; }
+
+int UsbSimDevice::standardIn(uint8_t * data) {
+  static const uint8_t lang[] = { 4, 3, 0x09, 0x04 };
+  static const uint8_t name[] = { 8, 3, 's', 0, 'i', 0, 'm', 0 };
+
+  if ((setup.bmRequestType & 0x60) != 0)
+    return controlIn(setup, data);
+
+  switch (setup.bRequest) {
+  case 6:   // GET_DESCRIPTOR
+    switch (setup.wValue >> 8) {
+    case 1:
+      memcpy(data, device, device[0]);
+      return device[0];
+    case 2: {
+      uint16_t len = config[2] | config[3] << 8;
+      memcpy(data, config, len);
+      return len;
+    }
+    case 3:
+      if (setup.wValue & 0xff) {
+        memcpy(data, name, sizeof(name));
+        return sizeof(name);
+      }
+      memcpy(data, lang, sizeof(lang));
+      return sizeof(lang);
+    }
+    return controlIn(setup, data);
+  case 0:   // GET_STATUS
+    data[0] = data[1] = 0;
+    return 2;
+  case 8:   // GET_CONFIGURATION
+    data[0] = configuration;
+    return 1;
+  }
+  return controlIn(setup, data);
+}
+
+bool UsbSimDevice::standardOut() {
+  if ((setup.bmRequestType & 0x60) != 0)
+    return controlOut(setup, ctl.data(), ctl.size());
+
+  switch (setup.bRequest) {
+  case 5:   // SET_ADDRESS, takes effect after the status stage
+    address = setup.wValue & 0x7f;
+    return true;
+  case 9:   // SET_CONFIGURATION
+    configuration = setup.wValue & 0xff;
+    memset(inToggle, 0, sizeof(inToggle));
+    memset(outToggle, 0, sizeof(outToggle));
+    return true;
+  case 1:   // CLEAR_FEATURE
+    if ((setup.bmRequestType & 0x1f) == 2 && setup.wValue == 0) {
+      if (setup.wIndex & 0x80)
+        inToggle[setup.wIndex & 0x0f] = false;
+      else
+        outToggle[setup.wIndex & 0x0f] = false;
+    }
+    return true;
+  case 3:   // SET_FEATURE
+  case 11:  // SET_INTERFACE
+    return true;
+  }
+  return controlOut(setup, ctl.data(), ctl.size());
+}
+
+uint8_t UsbSimDevice::transaction(uint8_t token, uint8_t ep, bool toggle, uint8_t * data, uint8_t & len) {
+  uint8_t maxPacket0 = device[7];
+
+  switch (token) {
+  case tokSETUP:
+    setup.bmRequestType = data[0];
+    setup.bRequest = data[1];
+    setup.wValue = data[2] | data[3] << 8;
+    setup.wIndex = data[4] | data[5] << 8;
+    setup.wLength = data[6] | data[7] << 8;
+    ctl.clear();
+    ctlPos = 0;
+    ctlStall = false;
+    inToggle[0] = outToggle[0] = true;
+    if (setup.bmRequestType & 0x80) {
+      static uint8_t buf[4096];
+      int n = standardIn(buf);
+      if (n < 0)
+        ctlStall = true;
+      else
+        ctl.assign(buf, buf + (n < setup.wLength ? n : setup.wLength));
+    }
+    return hrSUCCESS;
+
+  case tokINHS:     // status stage of a no-data or OUT request
+    if (ctlStall || !standardOut())
+      return hrSTALL;
+    return hrSUCCESS;
+
+  case tokOUTHS:    // status stage of an IN request
+    return ctlStall ? hrSTALL : hrSUCCESS;
+
+  case tokIN: {
+    int n;
+    if (ep == 0) {
+      if (ctlStall)
+        return hrSTALL;
+      n = ctl.size() - ctlPos;
+      if (n > maxPacket0)
+        n = maxPacket0;
+      memcpy(data, ctl.data() + ctlPos, n);
+    } else if ((n = in(ep, data)) < 0)
+      return hrNAK;
+    len = n;
+    bool sent = inToggle[ep];
+    inToggle[ep] = !inToggle[ep];
+    if (sent != toggle) {
+      // The host ACKs a packet with the wrong toggle and throws it away
+      Max3421eSim::toggleErrors++;
+      return hrTOGERR;
+    }
+    if (ep == 0)
+      ctlPos += n;
+    return hrSUCCESS;
+  }
+
+  case tokOUT:
+    if (toggle != outToggle[ep]) {
+      // A retransmission as far as the device knows, ACKed and dropped
+      Max3421eSim::toggleErrors++;
+      return hrSUCCESS;
+    }
+    if (ep == 0) {
+      if (ctlStall)
+        return hrSTALL;
+      ctl.insert(ctl.end(), data, data + len);
+    } else if (!out(ep, data, len))
+      return hrNAK;
+    outToggle[ep] = !outToggle[ep];
+    return hrSUCCESS;
+  }
+  return hrSTALL;
+}
+
+// Hub with four ports, port status as in chapter 11 of the USB spec
+
+static const uint8_t hubDevice[18] = {
+  18, 1, 0x00, 0x02, 0x09, 0, 0, 64, 0x51, 0x04, 0x03, 0x20, 0x00, 0x01, 0, 0, 0, 1
+};
+
+static const uint8_t hubConfig[25] = {
+  9, 2, 25, 0, 1, 1, 0, 0xe0, 50,
+  9, 4, 0, 0, 1, 0x09, 0, 0, 0,
+  7, 5, 0x81, 0x03, 1, 0, 12
+};
+
+UsbSimHub::UsbSimHub() : UsbSimDevice(hubDevice, hubConfig) {
+  for (int i = 0; i <= PORTS; i++) {
+    port[i] = NULL;
+    status[i] = change[i] = 0;
+  }
+}
+
+void UsbSimHub::connect(uint8_t p, UsbSimDevice * dev) {
+  if (port[p])
+    port[p]->enabled = false;
+  port[p] = dev;
+  status[p] &= 0x0100;    // keeps PORT_POWER
+  if (dev)
+    status[p] |= 0x0001 | (dev->lowSpeed ? 0x0200 : 0);
+  change[p] |= 0x0001;
+}
+
+void UsbSimHub::reset() {
+  UsbSimDevice::reset();
+  for (int i = 1; i <= PORTS; i++) {
+    status[i] &= ~0x0103;
+    change[i] = 0;
+    if (port[i]) {
+      port[i]->enabled = false;
+      status[i] |= 0x0001 | (port[i]->lowSpeed ? 0x0200 : 0);
+      change[i] = 0x0001;
+    }
+  }
+}
+
+UsbSimDevice * UsbSimHub::find(uint8_t addr) {
+  if (UsbSimDevice::find(addr))
+    return this;
+  for (int i = 1; i <= PORTS; i++)
+    if (port[i] && (status[i] & 0x0002) && port[i]->find(addr))
+      return port[i]->find(addr);
+  return NULL;
+}
+
+void UsbSimHub::frame() {
+  for (int i = 1; i <= PORTS; i++)
+    if (port[i])
+      port[i]->frame();
+}
+
+int UsbSimHub::controlIn(const UsbSimSetup & s, uint8_t * data) {
+  static const uint8_t hubDescr[9] = { 9, 0x29, PORTS, 0x00, 0x00, 50, 100, 0x00, 0xff };
+
+  if (s.bRequest == 6 && (s.wValue >> 8) == 0x29) {
+    memcpy(data, hubDescr, sizeof(hubDescr));
+    return sizeof(hubDescr);
+  }
+  if (s.bRequest == 0) {    // GET_STATUS, of the hub or of a port
+    uint8_t p = s.wIndex & 0xff;
+    bool other = (s.bmRequestType & 0x1f) == 3;
+    if (other && (p < 1 || p > PORTS))
+      return -1;
+    uint16_t st = other ? status[p] : 0, ch = other ? change[p] : 0;
+    data[0] = st;
+    data[1] = st >> 8;
+    data[2] = ch;
+    data[3] = ch >> 8;
+    return 4;
+  }
+  return -1;
+}
+
+bool UsbSimHub::controlOut(const UsbSimSetup & s, const uint8_t *, uint16_t) {
+  uint8_t p = s.wIndex & 0xff;
+
+  if ((s.bmRequestType & 0x1f) != 3)
+    return s.bRequest == 1 || s.bRequest == 3;    // hub features
+  if (p < 1 || p > PORTS)
+    return false;
+  if (s.bRequest == 3) {    // SET_FEATURE
+    switch (s.wValue) {
+    case 8:   // PORT_POWER
+      status[p] |= 0x0100;
+      return true;
+    case 4:   // PORT_RESET, done at once
+      if (!(status[p] & 0x0001))
+        return true;
+      port[p]->reset();
+      status[p] |= 0x0002;
+      change[p] |= 0x0010;
+      return true;
+    }
+    return true;
+  }
+  if (s.bRequest == 1) {    // CLEAR_FEATURE
+    if (s.wValue >= 16 && s.wValue <= 20)
+      change[p] &= ~(1 << (s.wValue - 16));
+    else if (s.wValue == 1) {
+      status[p] &= ~0x0002;
+      if (port[p])
+        port[p]->enabled = false;
+    }
+    return true;
+  }
+  return false;
+}
+
+int UsbSimHub::in(uint8_t ep, uint8_t * data) {
+  if (ep != 1)
+    return -1;
+  uint8_t map = 0;
+  for (int i = 1; i <= PORTS; i++)
+    if (change[i])
+      map |= 1 << i;
+  if (!map)
+    return -1;
+  data[0] = map;
+  return 1;
+}
@@ -0,0 +1,95 @@
+/*
+ UsbSimDevice - a USB device for the MAX3421E model.
+
+ The control endpoint is handled here.  The standard requests are answered
+ from the device and configuration descriptors given to the constructor;
+ class and vendor requests, and descriptors other than the device,
+ configuration and string ones, go to controlIn() and controlOut().  Data
+ endpoints go to in() and out(), which NAK when the device has nothing to
+ send or no room.  Data toggles are kept per endpoint and reset by
+ SET_CONFIGURATION and CLEAR_FEATURE(ENDPOINT_HALT).
+
+ UsbSimHub is a full speed hub, for more than one device on the bus.
+ */
+
+#ifndef USBSIMDEVICE_H
+#define USBSIMDEVICE_H
+
+#include <stdint.h>
+#include <vector>
+
+struct UsbSimSetup {
+  uint8_t bmRequestType;
+  uint8_t bRequest;
+  uint16_t wValue;
+  uint16_t wIndex;
+  uint16_t wLength;
+};
+
+class UsbSimDevice {
+public:
+  UsbSimDevice(const uint8_t * device, const uint8_t * config, bool lowSpeed = false);
+  virtual ~UsbSimDevice() {}
+
+  bool lowSpeed;
+  bool enabled;             // reset on the root port or an enabled hub port
+  uint8_t address;          // 0 until SET_ADDRESS
+  uint8_t configuration;    // 0 until SET_CONFIGURATION
+
+  // Class and vendor requests.  controlIn() fills the data stage and
+  // returns its length, or -1 to stall.  controlOut() gets the OUT data
+  // stage, if any, at the status stage and returns false to stall.
+  virtual int controlIn(const UsbSimSetup & setup, uint8_t * data);
+  virtual bool controlOut(const UsbSimSetup & setup, const uint8_t * data, uint16_t len);
+  // Data endpoints.  in() fills a packet and returns its length, or -1 to
+  // NAK; out() returns false to NAK.
+  virtual int in(uint8_t ep, uint8_t * data);
+  virtual bool out(uint8_t ep, const uint8_t * data, uint8_t len);
+  // Called once a millisecond
+  virtual void frame() {}
+  // Bus reset or hub port reset: address 0, not configured
+  virtual void reset();
+  // The device with this address, this one or one behind a hub
+  virtual UsbSimDevice * find(uint8_t addr);
+
+  // One transaction, from the chip model.  toggle is the toggle the host
+  // expects (IN) or sends (OUT), data and len the packet either way.
+  // Returns the HRSL result code.
+  uint8_t transaction(uint8_t token, uint8_t ep, bool toggle, uint8_t * data, uint8_t & len);
+
+protected:
+  const uint8_t * device;
+  const uint8_t * config;
+
+private:
+  UsbSimSetup setup;
+  std::vector<uint8_t> ctl;   // data stage
+  uint16_t ctlPos;
+  bool ctlStall;
+  bool inToggle[16], outToggle[16];
+
+  int standardIn(uint8_t * data);
+  bool standardOut();
+};
+
+class UsbSimHub : public UsbSimDevice {
+public:
+  UsbSimHub();
+
+  // Connects a device to port 1..4, or disconnects it with NULL
+  void connect(uint8_t port, UsbSimDevice * dev);
+
+  virtual int controlIn(const UsbSimSetup & setup, uint8_t * data);
+  virtual bool controlOut(const UsbSimSetup & setup, const uint8_t * data, uint16_t len);
+  virtual int in(uint8_t ep, uint8_t * data);
+  virtual void frame();
+  virtual void reset();
+  virtual UsbSimDevice * find(uint8_t addr);
+
+private:
+  enum { PORTS = 4 };
+  UsbSimDevice * port[PORTS + 1];
+  uint16_t status[PORTS + 1], change[PORTS + 1];
+};
+
+#endif
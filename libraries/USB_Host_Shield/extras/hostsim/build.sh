@@ -0,0 +1,43 @@
+#!/bin/sh
+# Builds the USB Host Shield library with the host compiler against the
+# MAX3421E model and runs the tests.  Run from this directory:  sh build.sh
+#
+# The library is built as it is for an ATmega328P, with -fpermissive for
+# its integer and pointer conversions, and without RTTI as on the board.
+
+set -e
+CORE=../../../../hardware/ProMicro/cores/arduino
+LIB=../..
+SD=../../../SdFat
+CRC=../../../CRC
+CXX="${CXX:-g++} -std=gnu++11 -O2 -w -fpermissive -fno-rtti -DARDUINO=101 -D__AVR_ATmega328P__"
+CXX="$CXX -Istub -I$CORE -I$LIB -I$SD -I$CRC -I."
+SOURCES="$LIB/Usb.cpp $LIB/message.cpp $LIB/parsetools.cpp core.cpp hostcore.cpp"
+SOURCES="$SOURCES Max3421eSim.cpp UsbSimDevice.cpp"
+
+mkdir -p bin
+$CXX $SOURCES $LIB/hid.cpp $LIB/hidboot.cpp $LIB/hiduniversal.cpp $LIB/usbhub.cpp \
+  PipeSchedule.cpp -o bin/PipeSchedule
+$CXX $SOURCES $LIB/hid.cpp $LIB/hiduniversal.cpp $LIB/usbhub.cpp $LIB/hidreportdecoder.cpp \
+  $LIB/hidescriptorparser.cpp $LIB/hidusagetitlearrays.cpp HidDecoder.cpp -o bin/HidDecoder
+$CXX $SOURCES $LIB/masstorage.cpp $SD/Sd2Card.cpp $SD/SdVolume.cpp $SD/SdBaseFile.cpp \
+  $SD/SdFat.cpp $SD/SdFile.cpp MassStorage.cpp -o bin/MassStorage
+$CXX $SOURCES $LIB/RFCOMM.cpp $CRC/CRC.cpp RfcommFlow.cpp -o bin/RfcommFlow
+$CXX $SOURCES $LIB/PS3BT.cpp Ps3Multi.cpp -o bin/Ps3Multi
+$CXX $SOURCES $LIB/cdcftdi.cpp $LIB/cdcacm.cpp $LIB/cdcstream.cpp CdcStream.cpp -o bin/CdcStream
+for scenario in 1 2 3; do
+  echo "== PipeSchedule $scenario"
+  ./bin/PipeSchedule $scenario 100 timer
+  ./bin/PipeSchedule $scenario 100
+  ./bin/PipeSchedule $scenario 3000
+done
+echo "== HidDecoder"
+./bin/HidDecoder
+echo "== MassStorage"
+./bin/MassStorage
+echo "== RfcommFlow"
+./bin/RfcommFlow
+echo "== Ps3Multi"
+./bin/Ps3Multi
+echo "== CdcStream"
+./bin/CdcStream
@@ -0,0 +1,7 @@
+// The printing and string classes of the Arduino core, built on the host.
+// Arduino.h comes first so that the core's own is skipped.
+
+#include <Arduino.h>
+#include <Print.cpp>
+#include <Stream.cpp>
+#include <WString.cpp>
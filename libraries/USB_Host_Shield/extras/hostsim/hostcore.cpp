@@ -0,0 +1,91 @@
+// Clock, number formatting, Serial and the shield's pins for host builds
+
+#include <Arduino.h>
+#include <stdio.h>
+#include "Max3421eSim.h"
+
+uint64_t hostNanos = 0;
+
+void hostAdvance(uint64_t ns) {
+  hostNanos += ns;
+  Max3421eSim::clock();
+}
+
+unsigned long millis(void) { return hostNanos / 1000000; }
+unsigned long micros(void) { return hostNanos / 1000; }
+void delay(unsigned long ms) { hostAdvance(ms * 1000000ULL); }
+void delayMicroseconds(unsigned int us) { hostAdvance(us * 1000ULL); }
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+long random(long max) { return max ? rand() % max : 0; }
+long random(long min, long max) { return min + random(max - min); }
+
+char *ultoa(unsigned long value, char *buf, int base) {
+  char tmp[33];
+  int n = 0;
+  do {
+    int d = value % base;
+    tmp[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+    value /= base;
+  } while (value);
+  for (int i = 0; i < n; i++)
+    buf[i] = tmp[n - 1 - i];
+  buf[n] = 0;
+  return buf;
+}
+
+char *ltoa(long value, char *buf, int base) {
+  if (value < 0 && base == 10) {
+    buf[0] = '-';
+    ultoa(-(unsigned long) value, buf + 1, base);
+    return buf;
+  }
+  return ultoa((unsigned long) value, buf, base);
+}
+
+char *itoa(int value, char *buf, int base) {
+  return base == 10 ? ltoa(value, buf, base) : ultoa((unsigned) value, buf, base);
+}
+
+char *utoa(unsigned value, char *buf, int base) { return ultoa(value, buf, base); }
+
+char *dtostrf(double value, signed char width, unsigned char prec, char *buf) {
+  sprintf(buf, "%*.*f", width, prec, value);
+  return buf;
+}
+
+HostSerial Serial;
+
+size_t HostSerial::write(uint8_t c) {
+  if (echo)
+    putchar(c);
+  return 1;
+}
+
+// PB2 is the chip select of the MAX3421E, PB1 its INT output
+HostPortB PORTB;
+volatile uint8_t DDRB;
+
+HostPortB & HostPortB::operator=(uint8_t v) {
+  uint8_t fell = value & ~v, rose = v & ~value;
+  value = v;
+  if (fell & _BV(2))
+    Max3421eSim::select(true);
+  if (rose & _BV(2))
+    Max3421eSim::select(false);
+  return *this;
+}
+
+uint8_t hostPinB(void) {
+  return (PORTB.value & ~_BV(1)) | (Max3421eSim::intLow() ? 0 : _BV(1));
+}
+
+HostSPDR SPDR;
+HostSPSR SPSR;
+volatile uint8_t SPCR;
+
+HostSPDR & HostSPDR::operator=(uint8_t out) {
+  in = Max3421eSim::transfer(out);
+  hostAdvance(Max3421eSim::spiByteNs);
+  return *this;
+}
@@ -0,0 +1,79 @@
+// Host stand-in for the Arduino core header.  The core's Print, Stream
+// and WString are compiled as they are; only the AVR parts, the clock and
+// Serial are replaced.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef unsigned int word;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+// the SPI pins of an ATmega328P
+static const uint8_t SS = 10;
+static const uint8_t MOSI = 11;
+static const uint8_t MISO = 12;
+static const uint8_t SCK = 13;
+
+#define PI 3.1415926535897932384626433832795
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+// simulated time in nanoseconds, moved on by SPI transfers, delay() and
+// the tests
+extern uint64_t hostNanos;
+void hostAdvance(uint64_t ns);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+long random(long max);
+long random(long min, long max);
+
+char *itoa(int value, char *buf, int base);
+char *utoa(unsigned value, char *buf, int base);
+char *ltoa(long value, char *buf, int base);
+char *ultoa(unsigned long value, char *buf, int base);
+char *dtostrf(double value, signed char width, unsigned char prec, char *buf);
+
+#ifdef __cplusplus
+#include <WString.h>
+#include <Stream.h>
+
+// Serial output is dropped unless echo is set
+class HostSerial : public Stream {
+public:
+  bool echo;
+  void begin(unsigned long) {}
+  virtual size_t write(uint8_t c);
+  using Print::write;
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+  operator bool() { return true; }
+};
+
+extern HostSerial Serial;
+#endif
+
+#endif
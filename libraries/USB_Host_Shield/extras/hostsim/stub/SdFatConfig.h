@@ -0,0 +1,4 @@
+// SdFat as a sketch using a USB drive configures it
+#include "../../../../SdFat/SdFatConfig.h"
+#undef USE_SD_BLOCK_DEVICE
+#define USE_SD_BLOCK_DEVICE 1
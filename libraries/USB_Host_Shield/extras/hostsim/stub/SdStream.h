@@ -0,0 +1 @@
+// SdFat's stream classes assume a 32 bit long and are not used here
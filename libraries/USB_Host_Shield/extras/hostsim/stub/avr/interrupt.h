@@ -0,0 +1,7 @@
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#define cli()
+#define sei()
+
+#endif
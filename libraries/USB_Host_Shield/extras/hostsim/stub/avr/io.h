@@ -0,0 +1,59 @@
+// Port B and the SPI registers of an ATmega328P, wired to the MAX3421E
+// model as on the USB Host Shield: PB2 (pin 10) is the chip select and
+// PB1 (pin 9) reads the INT line.  Writing SPDR clocks a byte out and
+// latches the byte clocked in; SPIF is always set.
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#define SPIF 7
+#define SPI2X 0
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+
+struct HostSPDR {
+  uint8_t in;
+  HostSPDR & operator=(uint8_t out);
+  operator uint8_t() const { return in; }
+};
+
+struct HostSPSR {
+  uint8_t value;
+  HostSPSR & operator=(uint8_t v) { value = v; return *this; }
+  operator uint8_t() const { return value | _BV(SPIF); }
+};
+
+struct HostPortB {
+  uint8_t value;
+  HostPortB & operator=(uint8_t v);
+  HostPortB & operator&=(uint8_t mask) { return *this = value & mask; }
+  HostPortB & operator|=(uint8_t mask) { return *this = value | mask; }
+  HostPortB & operator^=(uint8_t mask) { return *this = value ^ mask; }
+  operator uint8_t() const { return value; }
+};
+
+// PB1 follows the INT output of the model
+uint8_t hostPinB(void);
+#define PINB hostPinB()
+
+extern HostSPDR SPDR;
+extern HostSPSR SPSR;
+extern volatile uint8_t SPCR;
+extern HostPortB PORTB;
+extern volatile uint8_t DDRB;
+
+// avrpins.h makes port classes for the ports that are defined
+#define PORTB PORTB
+#define DDRB DDRB
+
+#endif
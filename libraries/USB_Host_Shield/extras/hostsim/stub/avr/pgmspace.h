@@ -0,0 +1,23 @@
+// Program memory is ordinary memory on the host.  The library keeps
+// pointers in its PROGMEM tables, so pgm_read_word() reads a whole
+// element rather than 16 bits.
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+typedef char prog_char;
+typedef unsigned char prog_uchar;
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(p))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+
+#endif
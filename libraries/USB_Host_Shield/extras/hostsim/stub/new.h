@@ -0,0 +1,2 @@
+// The host C++ library has new and delete
+#include <new>
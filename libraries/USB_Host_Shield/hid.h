@@ -122,6 +122,8 @@ struct HidItemPrefix
 
 #define HID_LONG_ITEM_PREFIX						0xfe		// Long item prefix value
 
+#define HID_MAX_REPORT_DESCR_LEN					0x200		// wLength of Get Descriptor(Report), devices send less
+
 #define bmHID_MAIN_ITEM_TAG							0xfc		// Main item tag mask
 
 #define bmHID_MAIN_ITEM_INPUT						0x80		// Main item Input tag value
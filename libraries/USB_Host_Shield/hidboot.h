@@ -170,9 +170,12 @@ class HIDBoot : public HID //public USBDeviceConfig, public UsbConfigXtracter
 	uint8_t		bIfaceNum;				// Interface Number
 	uint8_t		bNumIface;				// number of interfaces in the configuration
 	uint8_t		bNumEP;					// total number of EP in the configuration
-	uint32_t	qNextPollTime;			// next poll time
+	uint8_t		bInterval;				// interrupt IN polling interval in frames
 	bool		bPollEnable;			// poll enable flag
 
+	static const uint8_t constBuffLen = 16;	// report buffer length
+	uint8_t		pollBuf[constBuffLen];	// report buffer, filled by USB::Task()
+
 	void Initialize();
 
 	virtual HIDReportParser* GetReportParser(uint8_t id) { return pRptParser; };
@@ -180,7 +183,7 @@ class HIDBoot : public HID //public USBDeviceConfig, public UsbConfigXtracter
 public:
 	HIDBoot(USB *p);
 
-	virtual bool SetReportParser(uint8_t id, HIDReportParser *prs) { pRptParser = prs; };
+	virtual bool SetReportParser(uint8_t id, HIDReportParser *prs) { pRptParser = prs; return true; };
 
 	// USBDeviceConfig implementation
 	virtual uint8_t Init(uint8_t parent, uint8_t port, bool lowspeed);
@@ -195,7 +198,7 @@ public:
 template <const uint8_t BOOT_PROTOCOL>
 HIDBoot<BOOT_PROTOCOL>::HIDBoot(USB *p) : 
 		HID(p),
-		qNextPollTime(0),
+		bInterval(0),
 		bPollEnable(false),
 		pRptParser(NULL)
 {
@@ -374,6 +377,14 @@ uint8_t HIDBoot<BOOT_PROTOCOL>::Init(uint8_t parent, uint8_t port, bool lowspeed
 		if (rcode)
 			goto FailSetIdle;
 	}
+
+	// Let USB::Task() poll the interrupt endpoint at the interval it asks for
+	rcode = pUsb->openPipe(bAddress, epInfo[epInterruptInIndex].epAddr, bInterval, 
+		(epInfo[epInterruptInIndex].maxPktSize < constBuffLen) ? epInfo[epInterruptInIndex].maxPktSize : constBuffLen, pollBuf);
+
+	if (rcode)
+		goto FailOpenPipe;
+
 	USBTRACE("BM configured\r\n");
 
 	bPollEnable = true;
@@ -403,6 +414,10 @@ FailSetConfDescr:
 	USBTRACE("setConf:");
 	goto Fail;
 
+FailOpenPipe:
+	USBTRACE("openPipe:");
+	goto Fail;
+
 Fail:
 	Serial.println(rcode, HEX);
 	Release();
@@ -434,6 +449,8 @@ void HIDBoot<BOOT_PROTOCOL>::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t
 		epInfo[index].maxPktSize	= (uint8_t)pep->wMaxPacketSize;
 		epInfo[index].epAttribs		= 0;
 
+		bInterval = pep->bInterval;
+
 		bNumEP ++;
 
 		//PrintEndpointDescriptor(pep);
@@ -444,13 +461,13 @@ void HIDBoot<BOOT_PROTOCOL>::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t
 template <const uint8_t BOOT_PROTOCOL>
 uint8_t HIDBoot<BOOT_PROTOCOL>::Release()
 {
+	pUsb->closePipes(bAddress);
 	pUsb->GetAddressPool().FreeAddress(bAddress);
 
 	bConfNum			= 0;
 	bIfaceNum			= 0;
 	bNumEP				= 1;
 	bAddress			= 0;
-	qNextPollTime		= 0;
 	bPollEnable			= false;
 	return 0;
 }
@@ -463,31 +480,27 @@ uint8_t HIDBoot<BOOT_PROTOCOL>::Poll()
 	if (!bPollEnable)
 		return 0;
 
-	if (qNextPollTime <= millis())
-	{
-		qNextPollTime = millis() + 10;
+	uint16_t	read = 0;
 
-		const uint8_t const_buff_len = 16;
-		uint8_t buf[const_buff_len];
+	// The report arrives in pollBuf as USB::Task() gets it, nothing to do until then
+	rcode = pUsb->readPipe(bAddress, epInfo[epInterruptInIndex].epAddr, &read);
 
-		uint16_t	read = (uint16_t)epInfo[epInterruptInIndex].maxPktSize;
-
-		uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[epInterruptInIndex].epAddr, &read, buf);
+	if (rcode == USB_ERROR_TRANSFER_PENDING)
+		return 0;
 
-		if (rcode)
-		{
-			if (rcode != hrNAK)
-				USBTRACE2("Poll:", rcode);
-			return rcode;
-		}
-		//for (uint8_t i=0; i<read; i++)
-		//	PrintHex<uint8_t>(buf[i]);
-		//if (read)
-		//	Serial.println("");
-
-		if (pRptParser)
-			pRptParser->Parse((HID*)this, 0, (uint8_t)read, buf);
+	if (rcode)
+	{
+		USBTRACE2("Poll:", rcode);
+		return rcode;
 	}
+	//for (uint8_t i=0; i<read; i++)
+	//	PrintHex<uint8_t>(pollBuf[i]);
+	//if (read)
+	//	Serial.println("");
+
+	if (pRptParser)
+		pRptParser->Parse((HID*)this, 0, (uint8_t)read, pollBuf);
+
 	return rcode;
 }
 
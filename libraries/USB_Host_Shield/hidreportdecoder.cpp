@@ -0,0 +1,570 @@
+/* Copyright (C) 2011 Circuits At Home, LTD. All rights reserved.
+
+This software may be distributed and modified under the terms of the GNU
+General Public License version 2 (GPL2) as published by the Free Software
+Foundation and appearing in the file GPL2.TXT included in the packaging of
+this file. Please note that GPL2 Section 2[b] requires that all works based
+on this software must also be made publicly available under the terms of
+the GPL2 ("Copyleft").
+
+Contact information
+-------------------
+
+Circuits At Home, LTD
+Web      :  http://www.circuitsathome.com
+e-mail   :  support@circuitsathome.com
+*/
+#include "hidreportdecoder.h"
+
+HIDFieldCompiler::HIDFieldCompiler(HIDField *fields, uint8_t max_fields) :
+	pFields(fields),
+	bMaxFields(max_fields)
+{
+	Reset();
+}
+
+void HIDFieldCompiler::Reset()
+{
+	bNumFields		= 0;
+	bOverflow		= false;
+	bHasReportId	= false;
+	bItemPrefix		= 0;
+	bItemSize		= 0;
+	bItemLeft		= 0;
+	wSkip			= 0;
+	dValue			= 0;
+	bNumReports		= 0;
+
+	memset(&glob, 0, sizeof(glob));
+	memset(&pushed, 0, sizeof(pushed));
+
+	ClearLocals();
+}
+
+void HIDFieldCompiler::ClearLocals()
+{
+	bNumUsages	= 0;
+	dUsageMin	= 0;
+	dUsageMax	= 0;
+	bUsageRange	= false;
+}
+
+void HIDFieldCompiler::Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset)
+{
+	if (!offset)
+		Reset();
+
+	for (uint16_t i=0; i<len; i++)
+	{
+		uint8_t b = pbuf[i];
+
+		// long items carry nothing a report parser needs
+		if (wSkip)
+		{
+			wSkip --;
+			continue;
+		}
+		if (bItemLeft)
+		{
+			dValue |= (uint32_t)b << ((bItemSize - bItemLeft) << 3);
+
+			if (!--bItemLeft)
+				OnItem();
+			continue;
+		}
+		// data size of a long item, its tag and data follow
+		if (bItemPrefix == HID_LONG_ITEM_PREFIX)
+		{
+			wSkip		= (uint16_t)b + 1;
+			bItemPrefix	= 0;
+			continue;
+		}
+		bItemPrefix = b;
+
+		if (b == HID_LONG_ITEM_PREFIX)
+			continue;
+
+		bItemSize	= b & DATA_SIZE_MASK;
+
+		if (bItemSize == DATA_SIZE_4)
+			bItemSize = 4;
+
+		bItemLeft	= bItemSize;
+		dValue		= 0;
+
+		if (!bItemSize)
+			OnItem();
+	}
+}
+
+void HIDFieldCompiler::OnItem()
+{
+	int32_t		value;
+	uint32_t	usage = (bItemSize == 4) ? dValue : (dValue & 0xffff);
+
+	switch (bItemSize)
+	{
+	case 1:
+		value = (int8_t)dValue;
+		break;
+	case 2:
+		value = (int16_t)dValue;
+		break;
+	default:
+		value = (int32_t)dValue;
+	}
+
+	switch (bItemPrefix & (TYPE_MASK | TAG_MASK))
+	{
+	case (TYPE_GLOBAL | TAG_GLOBAL_USAGEPAGE):
+		glob.wUsagePage = dValue;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_LOGICALMIN):
+		glob.lLogicalMin = value;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_LOGICALMAX):
+		// many descriptors give 255 as a single 0xff byte
+		glob.lLogicalMax = (value < glob.lLogicalMin) ? (int32_t)dValue : value;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_REPORTSIZE):
+		glob.bReportSize = (dValue > 0xff) ? 0xff : dValue;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_REPORTCOUNT):
+		glob.wReportCount = (dValue > 0xffff) ? 0xffff : dValue;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_REPORTID):
+		glob.bReportId	= dValue;
+		bHasReportId	= true;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_PUSH):
+		pushed = glob;
+		break;
+	case (TYPE_GLOBAL | TAG_GLOBAL_POP):
+		glob = pushed;
+		break;
+	case (TYPE_LOCAL  | TAG_LOCAL_USAGE):
+		if (bNumUsages < HID_FIELD_MAX_USAGES)
+			dUsages[bNumUsages++] = usage;
+		break;
+	case (TYPE_LOCAL  | TAG_LOCAL_USAGEMIN):
+		dUsageMin	= usage;
+		bUsageRange	= true;
+		break;
+	case (TYPE_LOCAL  | TAG_LOCAL_USAGEMAX):
+		dUsageMax	= usage;
+		bUsageRange	= true;
+		break;
+	case (TYPE_MAIN   | TAG_MAIN_INPUT):
+		OnInput(dValue);
+		ClearLocals();
+		break;
+	case (TYPE_MAIN   | TAG_MAIN_OUTPUT):
+	case (TYPE_MAIN   | TAG_MAIN_FEATURE):
+	case (TYPE_MAIN   | TAG_MAIN_COLLECTION):
+	case (TYPE_MAIN   | TAG_MAIN_ENDCOLLECTION):
+		ClearLocals();
+		break;
+	}
+}
+
+// Usages of one and two bytes are on the usage page current at the Main item
+uint32_t HIDFieldCompiler::FullUsage(uint32_t usage)
+{
+	return ((usage >> 16) ? usage : ((uint32_t)glob.wUsagePage << 16) | usage);
+}
+
+uint32_t HIDFieldCompiler::GetUsage(uint16_t index)
+{
+	if (bNumUsages)
+		return FullUsage(dUsages[(index < bNumUsages) ? index : bNumUsages - 1]);
+
+	uint32_t usage	= FullUsage(dUsageMin) + index;
+	uint32_t max	= FullUsage(dUsageMax);
+
+	return ((bUsageRange && usage > max) ? max : usage);
+}
+
+HIDFieldCompiler::ReportBits* HIDFieldCompiler::FindReport(uint8_t id)
+{
+	for (uint8_t i=0; i<bNumReports; i++)
+		if (reports[i].bReportId == id)
+			return reports + i;
+
+	if (bNumReports == HID_FIELD_MAX_REPORTS)
+		return NULL;
+
+	reports[bNumReports].bReportId	= id;
+	reports[bNumReports].wBits		= 0;
+
+	return reports + bNumReports++;
+}
+
+void HIDFieldCompiler::OnInput(uint8_t flags)
+{
+	ReportBits	*rpt	= FindReport(glob.bReportId);
+	uint8_t		size	= glob.bReportSize;
+	uint16_t	count	= glob.wReportCount;
+
+	if (!rpt)
+	{
+		bOverflow = true;
+		return;
+	}
+	uint16_t bit = rpt->wBits;
+
+	rpt->wBits += (uint16_t)size * count;
+
+	// constant padding, or nothing that fits an integer
+	if ((flags & 0x01) || !count || !size || size > 32)
+		return;
+
+	flags &= (HID_FIELD_VARIABLE | HID_FIELD_RELATIVE | HID_FIELD_NULL_STATE);
+
+	if (glob.lLogicalMin < 0)
+		flags |= HID_FIELD_SIGNED;
+
+	if (!(flags & HID_FIELD_VARIABLE))
+	{
+		AddField(bit, flags, count, GetUsage(0));
+		return;
+	}
+
+	// one field for each run of usages counting up, or of one usage repeated
+	for (uint16_t i=0; i<count; )
+	{
+		uint16_t	start	= i;
+		uint32_t	usage	= GetUsage(i);
+		uint8_t		step	= (i + 1 < count && GetUsage(i + 1) == usage) ? 0 : 1;
+
+		for (i++; i<count && GetUsage(i) == usage + (uint32_t)(i - start) * step; i++)
+			;
+
+		AddField(bit + start * size, (step) ? flags : flags | HID_FIELD_SAME_USAGE, i - start, usage);
+	}
+}
+
+void HIDFieldCompiler::AddField(uint16_t bit, uint8_t flags, uint16_t count, uint32_t usage)
+{
+	while (count)
+	{
+		if (bNumFields == bMaxFields)
+		{
+			bOverflow = true;
+			return;
+		}
+		HIDField	*f	= pFields + bNumFields++;
+		uint8_t		n	= (count > 0xff) ? 0xff : count;
+
+		f->bReportId	= glob.bReportId;
+		f->bmFlags		= flags;
+		f->wBitOffset	= bit;
+		f->bSize		= glob.bReportSize;
+		f->bCount		= n;
+		f->wUsagePage	= usage >> 16;
+		f->wUsage		= usage;
+		f->lLogicalMin	= glob.lLogicalMin;
+		f->lLogicalMax	= glob.lLogicalMax;
+
+		count	-= n;
+		bit		+= (uint16_t)n * glob.bReportSize;
+
+		if ((flags & (HID_FIELD_VARIABLE | HID_FIELD_SAME_USAGE)) == HID_FIELD_VARIABLE)
+			usage += n;
+	}
+}
+
+const HIDField* HIDFieldCompiler::FindUsage(uint16_t page, uint16_t usage, uint8_t *index)
+{
+	for (uint8_t i=0; i<bNumFields; i++)
+	{
+		const HIDField *f = pFields + i;
+
+		if (!(f->bmFlags & HID_FIELD_VARIABLE) || f->wUsagePage != page || usage < f->wUsage)
+			continue;
+
+		uint16_t n = usage - f->wUsage;
+
+		if ((f->bmFlags & HID_FIELD_SAME_USAGE) && n)
+			continue;
+
+		if (n < f->bCount)
+		{
+			*index = n;
+			return f;
+		}
+	}
+	return NULL;
+}
+
+uint8_t HIDFieldCompiler::Bind(const HIDUsageMap *map, HIDBinding *bind, uint8_t n)
+{
+	uint8_t bound = 0;
+
+	for (; n; n--, map++, bind++)
+	{
+		HIDUsageMap		m;
+		uint8_t			index;
+
+		memcpy_P(&m, map, sizeof(m));
+
+		const HIDField	*f		= FindUsage(m.wUsagePage, m.wUsage, &index);
+		uint8_t			count	= (m.bCount) ? m.bCount : 1;
+
+		// no such usage: an offset past any report, so that Decode() skips it
+		bind->wBitOffset	= 0xffff;
+		bind->bBits			= 0;
+		bind->bReportId		= 0;
+		bind->bOffset		= m.bOffset;
+		bind->bSize			= m.bSize;
+
+		if (!f || index + count > f->bCount || (uint16_t)count * f->bSize > 32)
+			continue;
+
+		bind->wBitOffset	= f->wBitOffset + (uint16_t)index * f->bSize;
+		bind->bBits			= count * f->bSize;
+		bind->bReportId		= f->bReportId;
+
+		if (count == 1 && (f->bmFlags & HID_FIELD_SIGNED))
+			bind->bSize |= HID_FIELD_SIGNED;
+
+		bound ++;
+	}
+	return bound;
+}
+
+// Reads only the bytes the value is in, the caller checks that they are in the report
+uint32_t HIDFieldCompiler::GetBits(const uint8_t *data, uint16_t bit, uint8_t size)
+{
+	uint8_t		shift	= bit & 7;
+	uint8_t		bytes	= (shift + size + 7) >> 3;
+	uint32_t	value	= 0;
+
+	data += bit >> 3;
+
+	for (uint8_t i=(bytes > 4) ? 4 : bytes; i; i--)
+		value = (value << 8) | data[i - 1];
+
+	value >>= shift;
+
+	if (bytes > 4)
+		value |= (uint32_t)data[4] << (32 - shift);
+
+	if (size < 32)
+		value &= ((uint32_t)1 << size) - 1;
+
+	return value;
+}
+
+int32_t HIDFieldCompiler::GetValue(const HIDField *field, const uint8_t *data, uint8_t index)
+{
+	uint32_t value = GetBits(data, field->wBitOffset + (uint16_t)index * field->bSize, field->bSize);
+
+	if (field->bmFlags & HID_FIELD_SIGNED)
+	{
+		uint32_t sign = (uint32_t)1 << (field->bSize - 1);
+
+		value = (value ^ sign) - sign;
+	}
+	return (int32_t)value;
+}
+
+// Copies the bound values of report id into dst, returns how many there were
+uint8_t HIDFieldCompiler::Decode(const HIDBinding *bind, uint8_t n, uint8_t id, const uint8_t *data, uint8_t len, void *dst)
+{
+	uint16_t	bits	= (uint16_t)len << 3;
+	uint8_t		done	= 0;
+
+	for (; n; n--, bind++)
+	{
+		if (bind->bReportId != id || bind->wBitOffset + bind->bBits > bits)
+			continue;
+
+		uint32_t value = GetBits(data, bind->wBitOffset, bind->bBits);
+
+		if (bind->bSize & HID_FIELD_SIGNED)
+		{
+			uint32_t sign = (uint32_t)1 << (bind->bBits - 1);
+
+			value = (value ^ sign) - sign;
+		}
+		// little endian, the low bytes are the member
+		memcpy((uint8_t*)dst + bind->bOffset, &value, bind->bSize & 0x07);
+		done ++;
+	}
+	return done;
+}
+
+HIDReportDecoder::HIDReportDecoder(HIDFieldCompiler *table, uint8_t *prev, uint8_t prev_size) :
+	pTable(table),
+	pPrev(prev),
+	bPrevSize(prev_size),
+	bAddress(0),
+	pMap(NULL),
+	pBind(NULL),
+	bNumBind(0),
+	pDest(NULL)
+{
+}
+
+void HIDReportDecoder::Bind(const HIDUsageMap *map, HIDBinding *bind, uint8_t n, void *dest)
+{
+	pMap		= map;
+	pBind		= bind;
+	bNumBind	= n;
+	pDest		= dest;
+
+	if (bAddress)
+		pTable->Bind(pMap, pBind, bNumBind);
+}
+
+void HIDReportDecoder::Reset()
+{
+	bAddress = 0;
+}
+
+void HIDReportDecoder::Compile(HID *hid)
+{
+	bAddress = 0;
+
+	uint8_t rcode = hid->GetReportDescr(0, pTable);
+
+	if (rcode)
+	{
+		ErrorMessage<uint8_t>(PSTR("GetReportDescr"), rcode);
+		return;
+	}
+	if (pTable->Overflowed())
+		Notify(PSTR("HID field table full\r\n"));
+
+	if (pMap)
+		pTable->Bind(pMap, pBind, bNumBind);
+
+	if (pPrev)
+		memset(pPrev, 0, bPrevSize);
+
+	bAddress = hid->GetAddress();
+}
+
+void HIDReportDecoder::Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf)
+{
+	uint8_t id = 0;
+
+	if (bAddress != hid->GetAddress())
+	{
+		Compile(hid);
+
+		if (!bAddress)
+			return;
+	}
+	// the descriptor tells whether there is a report ID, is_rpt_id may not
+	if (pTable->HasReportId())
+	{
+		if (!len)
+			return;
+
+		id = *buf++;
+		len --;
+	}
+	if (pBind)
+	{
+		HIDFieldCompiler::Decode(pBind, bNumBind, id, buf, len, pDest);
+		OnReport(id);
+	}
+	if (!pPrev)
+		return;
+
+	uint16_t offset = 0;
+
+	// previous reports are kept in the order of the report IDs in the descriptor
+	for (uint8_t i=0; i<pTable->GetNumReports(); i++)
+	{
+		uint8_t n = pTable->GetReportLength(i);
+
+		if (pTable->GetReportId(i) != id)
+		{
+			offset += n;
+			continue;
+		}
+		if (offset + n > bPrevSize)
+			return;
+
+		if (len < n)
+			n = len;
+
+		FindChanges(id, buf, n, pPrev + offset);
+		memcpy(pPrev + offset, buf, n);
+		return;
+	}
+}
+
+// Most reports change one or two fields, the others are passed over 32 bits at a time
+bool HIDReportDecoder::BitsDiffer(const uint8_t *data, const uint8_t *prev, uint16_t bit, uint16_t size)
+{
+	while (size)
+	{
+		uint8_t n = (size > 32) ? 32 : size;
+
+		if (HIDFieldCompiler::GetBits(data, bit, n) != HIDFieldCompiler::GetBits(prev, bit, n))
+			return true;
+
+		bit		+= n;
+		size	-= n;
+	}
+	return false;
+}
+
+void HIDReportDecoder::FindChanges(uint8_t id, const uint8_t *data, uint8_t len, const uint8_t *prev)
+{
+	uint16_t bits = (uint16_t)len << 3;
+
+	for (uint8_t i=0; i<pTable->GetNumFields(); i++)
+	{
+		const HIDField	*f		= pTable->GetField(i);
+		uint16_t		size	= (uint16_t)f->bSize * f->bCount;
+
+		if (f->bReportId != id || f->wBitOffset + size > bits || !BitsDiffer(data, prev, f->wBitOffset, size))
+			continue;
+
+		if (f->bmFlags & HID_FIELD_VARIABLE)
+		{
+			for (uint8_t j=0; j<f->bCount; j++)
+			{
+				uint16_t bit = f->wBitOffset + (uint16_t)j * f->bSize;
+
+				if (HIDFieldCompiler::GetBits(data, bit, f->bSize) == HIDFieldCompiler::GetBits(prev, bit, f->bSize))
+					continue;
+
+				OnUsageChanged(f, j, (f->bmFlags & HID_FIELD_SAME_USAGE) ? f->wUsage : f->wUsage + j,
+					HIDFieldCompiler::GetValue(f, data, j));
+			}
+			continue;
+		}
+		// arrays hold the usages that are on, in any order: first those that went, then those that came
+		for (uint8_t on=0; on<2; on++)
+		{
+			const uint8_t *from	= (on) ? data : prev;
+			const uint8_t *to	= (on) ? prev : data;
+
+			for (uint8_t j=0; j<f->bCount; j++)
+			{
+				int32_t		value	= HIDFieldCompiler::GetValue(f, from, j);
+				uint8_t		k		= 0;
+
+				if (value < f->lLogicalMin || value > f->lLogicalMax)
+					continue;
+
+				uint16_t usage = f->wUsage + (uint16_t)(value - f->lLogicalMin);
+
+				// usage 0 is no usage
+				if (!usage)
+					continue;
+
+				while (k < f->bCount && HIDFieldCompiler::GetValue(f, to, k) != value)
+					k ++;
+
+				if (k == f->bCount)
+					OnUsageChanged(f, j, usage, on);
+			}
+		}
+	}
+}
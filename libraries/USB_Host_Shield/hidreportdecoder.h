@@ -0,0 +1,221 @@
+/* Copyright (C) 2011 Circuits At Home, LTD. All rights reserved.
+
+This software may be distributed and modified under the terms of the GNU
+General Public License version 2 (GPL2) as published by the Free Software
+Foundation and appearing in the file GPL2.TXT included in the packaging of
+this file. Please note that GPL2 Section 2[b] requires that all works based
+on this software must also be made publicly available under the terms of
+the GPL2 ("Copyleft").
+
+Contact information
+-------------------
+
+Circuits At Home, LTD
+Web      :  http://www.circuitsathome.com
+e-mail   :  support@circuitsathome.com
+*/
+#if !defined(__HIDREPORTDECODER_H__)
+#define __HIDREPORTDECODER_H__
+
+// Report decoding from a table compiled out of the report descriptor.
+//
+// HIDFieldCompiler reads the report descriptor once, the way GetReportDescr()
+// hands it over, and keeps one HIDField per run of Input elements: the report
+// ID, where the run starts and how many bits each element has, its logical
+// range and the usage of its first element.  Constant padding takes no entry.
+// After that a report is decoded by shifting bits out of it, no descriptor
+// is read again.
+//
+// HIDReportDecoder is the report parser that uses the table.  It compiles it
+// from the device with the first report, and again when the device address
+// changes or after Reset().  Then it calls OnUsageChanged() for each element
+// that differs from the previous report, or copies the usages a sketch asked
+// for with Bind() into its own struct, or both:
+//
+//	struct Pad { int16_t x, y; uint16_t buttons; } pad;
+//
+//	const HIDUsageMap padMap[] PROGMEM = {
+//		{ 0x01, 0x30, 1,  offsetof(Pad, x), 2 },				// X
+//		{ 0x01, 0x31, 1,  offsetof(Pad, y), 2 },				// Y
+//		{ 0x09, 0x01, 12, offsetof(Pad, buttons), 2 }			// buttons 1-12, one bit each
+//	};
+//
+//	HIDField					fields[16];
+//	HIDFieldCompiler			table(fields, 16);
+//	HIDBinding					bind[3];
+//	HIDReportDecoder			decoder(&table);
+//
+//	decoder.Bind(padMap, bind, 3, &pad);
+//	Hid.SetReportParser(0, &decoder);
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+#include "avrpins.h"
+#include "max3421e.h"
+#include "usbhost.h"
+#include "usb_ch9.h"
+#include "Usb.h"
+
+#if defined(ARDUINO) && ARDUINO >=100
+#include "Arduino.h"
+#else
+#include <WProgram.h>
+#endif
+
+#include "message.h"
+#include "hid.h"
+
+#define HID_FIELD_MAX_USAGES		8		// Usage items kept for one Main item, the last one repeats
+#define HID_FIELD_MAX_REPORTS		8		// Input report IDs kept track of
+
+// HIDField::bmFlags, the low bits are those of the Input item
+#define HID_FIELD_VARIABLE			0x02	// one element per usage, otherwise an array of usage indices
+#define HID_FIELD_RELATIVE			0x04
+#define HID_FIELD_NULL_STATE		0x40	// values outside the logical range mean no value
+#define HID_FIELD_SAME_USAGE		0x20	// all elements have wUsage, otherwise it counts up from the first
+#define HID_FIELD_SIGNED			0x80	// logical minimum is negative
+
+struct HIDField
+{
+	uint8_t		bReportId;			// 0 when the device has no report IDs
+	uint8_t		bmFlags;
+	uint16_t	wBitOffset;			// first element, from the byte after the report ID
+	uint8_t		bSize;				// bits in one element, 1 to 32
+	uint8_t		bCount;				// number of elements
+	uint16_t	wUsagePage;
+	uint16_t	wUsage;				// first element, or usage of the logical minimum for arrays
+	int32_t		lLogicalMin;
+	int32_t		lLogicalMax;
+};
+
+// Where a sketch wants a usage in its struct, kept in PROGMEM
+struct HIDUsageMap
+{
+	uint16_t	wUsagePage;
+	uint16_t	wUsage;
+	uint8_t		bCount;				// elements with consecutive usages packed into one value
+	uint8_t		bOffset;			// offsetof() the member
+	uint8_t		bSize;				// sizeof() the member, 1, 2 or 4
+};
+
+// An HIDUsageMap entry resolved against the table
+struct HIDBinding
+{
+	uint16_t	wBitOffset;
+	uint8_t		bReportId;
+	uint8_t		bBits;				// 0 when the device has no such usage
+	uint8_t		bOffset;
+	uint8_t		bSize;				// with HID_FIELD_SIGNED when the value is sign extended
+};
+
+class HIDFieldCompiler : public USBReadParser
+{
+	struct Globals
+	{
+		uint16_t	wUsagePage;
+		int32_t		lLogicalMin;
+		int32_t		lLogicalMax;
+		uint8_t		bReportSize;
+		uint16_t	wReportCount;
+		uint8_t		bReportId;
+	};
+
+	struct ReportBits
+	{
+		uint8_t		bReportId;
+		uint16_t	wBits;
+	};
+
+	HIDField		*pFields;
+	uint8_t			bMaxFields;
+	uint8_t			bNumFields;
+	bool			bOverflow;				// table or report list was too small
+	bool			bHasReportId;
+
+	// item parser
+	uint8_t			bItemPrefix;
+	uint8_t			bItemSize;
+	uint8_t			bItemLeft;				// value bytes still to come
+	uint16_t		wSkip;					// long item bytes still to come
+	uint32_t		dValue;
+
+	Globals			glob;
+	Globals			pushed;					// one level of Push
+	uint32_t		dUsages[HID_FIELD_MAX_USAGES];	// page in the high word when the item gave one
+	uint8_t			bNumUsages;
+	uint32_t		dUsageMin;
+	uint32_t		dUsageMax;
+	bool			bUsageRange;
+
+	ReportBits		reports[HID_FIELD_MAX_REPORTS];
+	uint8_t			bNumReports;
+
+	void OnItem();
+	void OnInput(uint8_t flags);
+	void AddField(uint16_t bit, uint8_t flags, uint16_t count, uint32_t usage);
+	uint32_t GetUsage(uint16_t index);
+	uint32_t FullUsage(uint32_t usage);
+	ReportBits* FindReport(uint8_t id);
+	void ClearLocals();
+
+public:
+	HIDFieldCompiler(HIDField *fields, uint8_t max_fields);
+
+	void Reset();
+
+	// USBReadParser implementation, called with the descriptor in pieces
+	virtual void Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset);
+
+	uint8_t GetNumFields() { return bNumFields; };
+	const HIDField* GetField(uint8_t i) { return pFields + i; };
+	bool HasReportId() { return bHasReportId; };
+	bool Overflowed() { return bOverflow; };
+
+	uint8_t GetNumReports() { return bNumReports; };
+	uint8_t GetReportId(uint8_t i) { return reports[i].bReportId; };
+	uint8_t GetReportLength(uint8_t i) { return (reports[i].wBits + 7) >> 3; };	// bytes after the report ID
+
+	// Field holding an element with the usage, and the element index in it
+	const HIDField* FindUsage(uint16_t page, uint16_t usage, uint8_t *index);
+
+	uint8_t Bind(const HIDUsageMap *map, HIDBinding *bind, uint8_t n);
+
+	static uint32_t GetBits(const uint8_t *data, uint16_t bit, uint8_t size);
+	static int32_t GetValue(const HIDField *field, const uint8_t *data, uint8_t index);
+	static uint8_t Decode(const HIDBinding *bind, uint8_t n, uint8_t id, const uint8_t *data, uint8_t len, void *dst);
+};
+
+class HIDReportDecoder : public HIDReportParser
+{
+	HIDFieldCompiler	*pTable;
+	uint8_t				*pPrev;			// previous report of each report ID, one after the other
+	uint8_t				bPrevSize;
+	uint8_t				bAddress;		// device the table was compiled for, 0 before that
+
+	const HIDUsageMap	*pMap;
+	HIDBinding			*pBind;
+	uint8_t				bNumBind;
+	void				*pDest;
+
+	void Compile(HID *hid);
+	void FindChanges(uint8_t id, const uint8_t *data, uint8_t len, const uint8_t *prev);
+	static bool BitsDiffer(const uint8_t *data, const uint8_t *prev, uint16_t bit, uint16_t size);
+
+protected:
+	// An element changed; array usages report 1 when they appear and 0 when they go
+	virtual void OnUsageChanged(const HIDField *field, uint8_t index, uint16_t usage, int32_t value) {};
+	// A report was decoded into the bound struct
+	virtual void OnReport(uint8_t id) {};
+
+public:
+	HIDReportDecoder(HIDFieldCompiler *table, uint8_t *prev = NULL, uint8_t prev_size = 0);
+
+	void Bind(const HIDUsageMap *map, HIDBinding *bind, uint8_t n, void *dest);
+	bool IsCompiled() { return (bAddress != 0); };
+	void Reset();
+
+	// HIDReportParser implementation
+	virtual void Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf);
+};
+
+#endif // __HIDREPORTDECODER_H__
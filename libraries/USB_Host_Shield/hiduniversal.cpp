@@ -2,7 +2,6 @@
 
 HIDUniversal::HIDUniversal(USB *p) : 
 		HID(p),
-		qNextPollTime(0),
 		bPollEnable(false),
 		bHasReportId(false)
 {
@@ -42,6 +41,7 @@ void HIDUniversal::Initialize()
 	{
 		hidInterfaces[i].bmInterface	= 0;
 		hidInterfaces[i].bmProtocol		= 0;
+		hidInterfaces[i].bInterval		= 0;
 
 		for (uint8_t j=0; j<maxEpPerInterface; j++)
 			hidInterfaces[i].epIndex[j] = 0;
@@ -235,6 +235,22 @@ uint8_t HIDUniversal::Init(uint8_t parent, uint8_t port, bool lowspeed)
 			goto FailSetIdle;
 	}
 
+	// Let USB::Task() poll the interrupt endpoints at the intervals they ask for
+	for (uint8_t i=0; i<bNumIface; i++)
+	{
+		uint8_t index = hidInterfaces[i].epIndex[epInterruptInIndex];
+
+		if (index == 0)
+			continue;
+
+		uint8_t len = (epInfo[index].maxPktSize < constBuffLen) ? epInfo[index].maxPktSize : constBuffLen;
+
+		rcode = pUsb->openPipe(bAddress, epInfo[index].epAddr, hidInterfaces[i].bInterval, len, pollBuf);
+
+		if (rcode)
+			goto FailOpenPipe;
+	}
+
 	USBTRACE("HU configured\r\n");
 
 	OnInitSuccessful();
@@ -270,6 +286,10 @@ FailGetReportDescr:
 	USBTRACE("GetReportDescr:");
 	goto Fail;
 
+FailOpenPipe:
+	USBTRACE("openPipe:");
+	goto Fail;
+
 Fail:
 	Serial.println(rcode, HEX);
 	Release();
@@ -326,6 +346,9 @@ void HIDUniversal::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint
 		// Fill in the endpoint index list
 		piface->epIndex[index] = bNumEP;			//(pep->bEndpointAddress & 0x0F);
 
+		if (index == epInterruptInIndex)
+			piface->bInterval = pep->bInterval;
+
 		bNumEP ++;
 	}
 	//PrintEndpointDescriptor(pep);
@@ -334,11 +357,11 @@ void HIDUniversal::EndpointXtract(uint8_t conf, uint8_t iface, uint8_t alt, uint
 
 uint8_t HIDUniversal::Release()
 {
+	pUsb->closePipes(bAddress);
 	pUsb->GetAddressPool().FreeAddress(bAddress);
 
 	bNumEP				= 1;
 	bAddress			= 0;
-	qNextPollTime		= 0;
 	bPollEnable			= false;
 	return 0;
 }
@@ -369,50 +392,49 @@ uint8_t HIDUniversal::Poll()
 	if (!bPollEnable)
 		return 0;
 
-	if (qNextPollTime <= millis())
+	for (uint8_t i=0; i<bNumIface; i++)
 	{
-		qNextPollTime = millis() + 50;
-
-		uint8_t buf[constBuffLen];
-
-		for (uint8_t i=0; i<bNumIface; i++)
-		{
-			uint8_t		index	= hidInterfaces[i].epIndex[epInterruptInIndex];
-			uint16_t	read	= (uint16_t)epInfo[index].maxPktSize;
+		uint8_t		index	= hidInterfaces[i].epIndex[epInterruptInIndex];
+		uint16_t	read	= 0;
 
-			ZeroMemory(constBuffLen, buf);
+		if (index == 0)
+			continue;
 
-			uint8_t rcode = pUsb->inTransfer(bAddress, epInfo[index].epAddr, &read, buf);
+		// Reports arrive in pollBuf as USB::Task() gets them, nothing to do until then
+		rcode = pUsb->readPipe(bAddress, epInfo[index].epAddr, &read);
 
-			if (rcode)
-			{
-				if (rcode != hrNAK)
-					USBTRACE2("Poll:", rcode);
-				return rcode;
-			}
+		if (rcode == USB_ERROR_TRANSFER_PENDING)
+		{
+			rcode = 0;
+			continue;
+		}
+		if (rcode)
+		{
+			USBTRACE2("Poll:", rcode);
+			return rcode;
+		}
 
-			if (read > constBuffLen)
-				read = constBuffLen;
+		if (read > constBuffLen)
+			read = constBuffLen;
 
-			bool identical = BuffersIdentical(read, buf, prevBuf);
+		bool identical = BuffersIdentical(read, pollBuf, prevBuf);
 
-			SaveBuffer(read, buf, prevBuf);
+		SaveBuffer(read, pollBuf, prevBuf);
 
-			if (identical)
-				return 0;
+		if (identical)
+			continue;
 
-			Serial.print("\r\nBuf: ");
+		Serial.print("\r\nBuf: ");
 
-			for (uint8_t i=0; i<read; i++)
-				PrintHex<uint8_t>(buf[i]);
+		for (uint8_t i=0; i<read; i++)
+			PrintHex<uint8_t>(pollBuf[i]);
 
-			Serial.println("");
+		Serial.println("");
 
-			HIDReportParser		*prs = GetReportParser( ((bHasReportId) ? *buf : 0) );
+		HIDReportParser		*prs = GetReportParser( ((bHasReportId) ? *pollBuf : 0) );
 
-			if (prs)
-				prs->Parse(this, bHasReportId, (uint8_t)read, buf);
-		}
+		if (prs)
+			prs->Parse(this, bHasReportId, (uint8_t)read, pollBuf);
 	}
 	return rcode;
 }
@@ -29,6 +29,7 @@ class HIDUniversal : public HID
 			uint8_t		bmProtocol	: 2;
 		};
 		uint8_t			epIndex[maxEpPerInterface];
+		uint8_t			bInterval;		// interrupt IN polling interval in frames
 	};
 	
 	HIDInterface	hidInterfaces[maxHidInterfaces];
@@ -36,10 +37,10 @@ class HIDUniversal : public HID
 	uint8_t		bConfNum;				// configuration number
 	uint8_t		bNumIface;				// number of interfaces in the configuration
 	uint8_t		bNumEP;					// total number of EP in the configuration
-	uint32_t	qNextPollTime;			// next poll time
 	bool		bPollEnable;			// poll enable flag
 
 	static const uint16_t constBuffLen = 64;	// event buffer length
+	uint8_t pollBuf[constBuffLen];		// event buffer, filled by USB::Task() for all interfaces in turn
 	uint8_t prevBuf[constBuffLen];		// previous event buffer
 
 	void Initialize();
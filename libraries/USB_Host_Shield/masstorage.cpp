@@ -58,7 +58,9 @@ BulkOnly::BulkOnly(USB *p /*, CDCAsyncOper *pasync*/) :
 	qNextPollTime(0),	
 	bPollEnable(false),	
 	bIface(0),	
-	bNumEP(1)			
+	bNumEP(1),
+	dCBWTag(0),
+	bCmdOpen(false)
 {
 	for(uint8_t i=0; i<MASS_MAX_ENDPOINTS; i++)
 	{
@@ -300,6 +302,7 @@ uint8_t BulkOnly::Release()
 	bAddress			= 0;
 	qNextPollTime		= 0;
 	bPollEnable			= false;
+	bCmdOpen			= false;
 	return 0;
 }
 
@@ -494,7 +497,6 @@ uint8_t BulkOnly::ReadCapacity(uint8_t lun, uint16_t bsize, uint8_t *buf)
 		cbw.CBWCB[i] = 0;
 
 	cbw.CBWCB[0] = SCSI_CMD_READ_CAPACITY_10;
-	cbw.CBWCB[4] = bsize;
 
 	return Transaction(&cbw, bsize, buf, 0);
 }
@@ -546,15 +548,10 @@ uint8_t BulkOnly::Transaction(CommandBlockWrapper *cbw, uint16_t size, void *buf
 {
 	uint16_t read;
 	{
-		bLastUsbError = pUsb->outTransfer(bAddress, epInfo[epDataOutIndex].epAddr, sizeof(CommandBlockWrapper), (uint8_t*)cbw);
-
-		uint8_t ret = HandleUsbError(epDataOutIndex);
+		uint8_t ret = SendCBW(cbw);
 
 		if (ret)
-		{
-			ErrorMessage<uint8_t>(PSTR("CBW"), ret);
 			return ret;
-		}
 	}
 
 	if (size && buf)
@@ -595,7 +592,7 @@ uint8_t BulkOnly::Transaction(CommandBlockWrapper *cbw, uint16_t size, void *buf
 				bLastUsbError = pUsb->inTransfer(bAddress, epInfo[epDataInIndex].epAddr, &read, (uint8_t*)buf);
 		} // if (cbw->bmCBWFlags & MASS_CMD_DIR_IN)
 
-		else if (cbw->bmCBWFlags & MASS_CMD_DIR_OUT)
+		else
 			bLastUsbError = pUsb->outTransfer(bAddress, epInfo[epDataOutIndex].epAddr, read, (uint8_t*)buf);
 	}
 
@@ -606,25 +603,223 @@ uint8_t BulkOnly::Transaction(CommandBlockWrapper *cbw, uint16_t size, void *buf
 		ErrorMessage<uint8_t>(PSTR("RSP"), ret);
 		return MASS_ERR_GENERAL_USB_ERROR;
 	}
+	return ReadCSW();
+}
+
+uint8_t BulkOnly::SendCBW(CommandBlockWrapper *cbw)
+{
+	// finish a READ/WRITE left open by ReadStart()/WriteStart()
+	if (bCmdOpen)
 	{
-		CommandStatusWrapper	csw;
-		read = sizeof(CommandStatusWrapper);
+		uint8_t ret = Stop();
 
-		bLastUsbError = pUsb->inTransfer(bAddress, epInfo[epDataInIndex].epAddr, &read, (uint8_t*)&csw);
+		if (ret)
+			return ret;
+	}
+	cbw->dCBWTag = ++dCBWTag;
 
-		uint8_t ret = HandleUsbError(epDataInIndex);
+	bLastUsbError = pUsb->outTransfer(bAddress, epInfo[epDataOutIndex].epAddr, sizeof(CommandBlockWrapper), (uint8_t*)cbw);
 
-		if (ret)
+	uint8_t ret = HandleUsbError(epDataOutIndex);
+
+	if (ret)
+		ErrorMessage<uint8_t>(PSTR("CBW"), ret);
+
+	return ret;
+}
+
+uint8_t BulkOnly::ReadCSW()
+{
+	CommandStatusWrapper	csw;
+	uint16_t				read = sizeof(CommandStatusWrapper);
+
+	csw.dCSWSignature = 0;
+
+	bLastUsbError = pUsb->inTransfer(bAddress, epInfo[epDataInIndex].epAddr, &read, (uint8_t*)&csw);
+
+	uint8_t ret = HandleUsbError(epDataInIndex);
+
+	if (ret)
+	{
+		ErrorMessage<uint8_t>(PSTR("CSW"), ret);
+		return ret;
+	}
+	// the device and the host no longer agree on where they are
+	if (read < sizeof(CommandStatusWrapper) || csw.dCSWSignature != MASS_CSW_SIGNATURE || csw.dCSWTag != dCBWTag)
+	{
+		ErrorMessage<uint8_t>(PSTR("CSW"), MASS_ERR_INVALID_CSW);
+		ResetRecovery();
+		return MASS_ERR_INVALID_CSW;
+	}
+	return csw.bCSWStatus;
+}
+
+uint8_t BulkOnly::StartReadWrite(uint8_t cmd, uint8_t dir, uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks)
+{
+	CommandBlockWrapper cbw;
+
+	cbw.dCBWSignature			= MASS_CBW_SIGNATURE;
+	cbw.dCBWDataTransferLength	= (uint32_t)bsize * blocks;
+	cbw.bmCBWFlags				= dir;
+	cbw.bmCBWLUN				= lun;
+	cbw.bmCBWCBLength			= 10;
+
+	for (uint8_t i=0; i<16; i++)
+		cbw.CBWCB[i] = 0;
+
+	cbw.CBWCB[0] = cmd;
+	cbw.CBWCB[2] = ((addr >> 24) & 0xff);
+	cbw.CBWCB[3] = ((addr >> 16) & 0xff);
+	cbw.CBWCB[4] = ((addr >> 8) & 0xff);
+	cbw.CBWCB[5] = (addr & 0xff);
+	cbw.CBWCB[7] = (blocks >> 8);
+	cbw.CBWCB[8] = (blocks & 0xff);
+
+	uint8_t ret = SendCBW(&cbw);
+
+	if (ret)
+		return ret;
+
+	if (!cbw.dCBWDataTransferLength)
+		return ReadCSW();
+
+	bCmdOpen	= true;
+	bCmdDir		= dir;
+	dCmdLeft	= cbw.dCBWDataTransferLength;
+
+	return MASS_ERR_SUCCESS;
+}
+
+// Ends the data phase after an error or a short packet and reads the status
+uint8_t BulkOnly::EndData(uint8_t index)
+{
+	bCmdOpen = false;
+
+	uint8_t ret = HandleUsbError(index);
+
+	if (ret)
+	{
+		ErrorMessage<uint8_t>(PSTR("RDR"), ret);
+		return ret;
+	}
+	ret = ReadCSW();
+
+	return (ret) ? ret : MASS_ERR_GENERAL_USB_ERROR;
+}
+
+uint8_t BulkOnly::ReadStart(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks)
+{
+	return StartReadWrite(SCSI_CMD_READ_10, MASS_CMD_DIR_IN, lun, addr, bsize, blocks);
+}
+
+uint8_t BulkOnly::WriteStart(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks)
+{
+	return StartReadWrite(SCSI_CMD_WRITE_10, MASS_CMD_DIR_OUT, lun, addr, bsize, blocks);
+}
+
+uint8_t BulkOnly::ReadData(uint16_t bsize, uint8_t *buf)
+{
+	if (!bCmdOpen || bCmdDir != MASS_CMD_DIR_IN || dCmdLeft < bsize)
+		return MASS_ERR_NO_COMMAND;
+
+	uint16_t read = bsize;
+
+	bLastUsbError = pUsb->inTransfer(bAddress, epInfo[epDataInIndex].epAddr, &read, buf);
+
+	if (bLastUsbError || read != bsize)
+		return EndData(epDataInIndex);
+
+	dCmdLeft -= bsize;
+
+	if (dCmdLeft)
+		return MASS_ERR_SUCCESS;
+
+	bCmdOpen = false;
+	return ReadCSW();
+}
+
+uint8_t BulkOnly::WriteData(uint16_t bsize, const uint8_t *buf)
+{
+	if (!bCmdOpen || bCmdDir != MASS_CMD_DIR_OUT || dCmdLeft < bsize)
+		return MASS_ERR_NO_COMMAND;
+
+	bLastUsbError = pUsb->outTransfer(bAddress, epInfo[epDataOutIndex].epAddr, bsize, (uint8_t*)buf);
+
+	if (bLastUsbError)
+		return EndData(epDataOutIndex);
+
+	dCmdLeft -= bsize;
+
+	if (dCmdLeft)
+		return MASS_ERR_SUCCESS;
+
+	bCmdOpen = false;
+	return ReadCSW();
+}
+
+uint8_t BulkOnly::Stop()
+{
+	if (!bCmdOpen)
+		return MASS_ERR_SUCCESS;
+
+	bCmdOpen = false;
+
+	// the device waits for the rest of the data, only a reset gets it out of that
+	if (bCmdDir == MASS_CMD_DIR_OUT)
+	{
+		if (ResetRecovery())
+			return MASS_ERR_UNABLE_TO_RECOVER;
+		return MASS_ERR_WRITE_INCOMPLETE;
+	}
+	// the host has to take all the data before the status comes
+	{
+		const uint8_t	bufSize = 64;
+		uint8_t			rbuf[bufSize];
+
+		while (dCmdLeft)
 		{
-			ErrorMessage<uint8_t>(PSTR("CSW"), ret);
-			return ret;
+			uint16_t ask	= (dCmdLeft < bufSize) ? dCmdLeft : bufSize;
+			uint16_t read	= ask;
+
+			bLastUsbError = pUsb->inTransfer(bAddress, epInfo[epDataInIndex].epAddr, &read, rbuf);
+
+			if (bLastUsbError || read >= dCmdLeft)
+				break;
+
+			dCmdLeft -= read;
+
+			if (read < ask)
+				break;
 		}
-		//if (csw.bCSWStatus == MASS_ERR_PHASE_ERROR)
-		//	bLastUsbError = ResetRecovery();
+	}
+	uint8_t ret = HandleUsbError(epDataInIndex);
 
-		return csw.bCSWStatus;
+	if (ret)
+	{
+		ErrorMessage<uint8_t>(PSTR("RDR"), ret);
+		return ret;
 	}
-	//return MASS_ERR_SUCCESS;
+	return ReadCSW();
+}
+
+uint8_t BulkOnly::Read(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks, uint8_t *buf)
+{
+	uint8_t ret = ReadStart(lun, addr, bsize, blocks);
+
+	for (; !ret && blocks && bCmdOpen; blocks--, buf += bsize)
+		ret = ReadData(bsize, buf);
+
+	return ret;
+}
+
+uint8_t BulkOnly::Write(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks, const uint8_t *buf)
+{
+	uint8_t ret = WriteStart(lun, addr, bsize, blocks);
+
+	for (; !ret && blocks && bCmdOpen; blocks--, buf += bsize)
+		ret = WriteData(bsize, buf);
+
+	return ret;
 }
 
 void BulkOnly::PrintEndpointDescriptor( const USB_ENDPOINT_DESCRIPTOR* ep_ptr )
@@ -74,6 +74,9 @@
 #define MASS_ERR_PHASE_ERROR				0x01
 #define MASS_ERR_DEVICE_DISCONNECTED		0x11
 #define MASS_ERR_UNABLE_TO_RECOVER			0x12	// Reset recovery error
+#define MASS_ERR_INVALID_CSW				0x13	// CSW missing or not for the last CBW
+#define MASS_ERR_WRITE_INCOMPLETE			0x14	// Stop() before all the data of a write was sent
+#define MASS_ERR_NO_COMMAND					0x15	// no READ/WRITE in progress for ReadData/WriteData
 #define MASS_ERR_GENERAL_USB_ERROR			0xFF
 
 #define MASS_TRANS_FLG_CALLBACK				0x01	// Callback is involved
@@ -140,7 +143,7 @@ struct CommandBlockWrapper
 	};
 
 	uint8_t		CBWCB[16];
-} ;
+} __attribute__((packed));		// 31 bytes on the wire
 
 struct CommandStatusWrapper
 {
@@ -148,7 +151,7 @@ struct CommandStatusWrapper
 	uint32_t	dCSWTag;
 	uint32_t	dCSWDataResidue;
 	uint8_t		bCSWStatus;
-};
+} __attribute__((packed));		// 13 bytes on the wire
 
 struct RequestSenseResponce
 {
@@ -180,7 +183,7 @@ struct RequestSenseResponce
 //	virtual void Parse(const uint16_t len, const uint8_t *pbuf, const uint16_t &offset) = 0;
 //};
 
-#define MASS_MAX_ENDPOINTS		3
+#define MASS_MAX_ENDPOINTS		4		// control, bulk IN, bulk OUT, interrupt IN
 
 class BulkOnly : public USBDeviceConfig, public UsbConfigXtracter
 {
@@ -204,6 +207,10 @@ protected:
 	uint8_t		bMaxLUN;				// Max LUN
 	uint8_t		bLastUsbError;			// Last USB error
 
+	bool		bCmdOpen;				// READ/WRITE(10) waiting for its data phase to finish
+	uint8_t		bCmdDir;				// its direction
+	uint32_t	dCmdLeft;				// bytes left in its data phase
+
 protected:
 	//union TransFlags
 	//{
@@ -224,6 +231,11 @@ protected:
 	uint8_t Transaction(CommandBlockWrapper *cbw, uint16_t bsize, void *buf, uint8_t flags);
 	uint8_t HandleUsbError(uint8_t index);
 
+	uint8_t SendCBW(CommandBlockWrapper *cbw);
+	uint8_t ReadCSW();
+	uint8_t StartReadWrite(uint8_t cmd, uint8_t dir, uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks);
+	uint8_t EndData(uint8_t index);
+
 public:
 	BulkOnly(USB *p);
 	uint8_t GetLastUsbError() { return bLastUsbError; };
@@ -239,6 +251,20 @@ public:
 	//uint8_t Read(uint8_t lun, uint32_t addr, uint16_t bsize, uint8_t *buf);
 	uint8_t Read(uint8_t lun, uint32_t addr, uint16_t bsize, USBReadParser *prs);
 
+	// Multiple block transfers, one command for all the blocks
+	uint8_t Read(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks, uint8_t *buf);
+	uint8_t Write(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks, const uint8_t *buf);
+
+	// The same a block at a time: ReadStart() or WriteStart(), then ReadData()
+	// or WriteData() for each block.  The status is read with the last block.
+	// Stop() ends a read early, discarding the blocks not read.
+	uint8_t ReadStart(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks);
+	uint8_t ReadData(uint16_t bsize, uint8_t *buf);
+	uint8_t WriteStart(uint8_t lun, uint32_t addr, uint16_t bsize, uint16_t blocks);
+	uint8_t WriteData(uint16_t bsize, const uint8_t *buf);
+	uint8_t Stop();
+	bool DataPending() { return bCmdOpen; };
+
 	// USBDeviceConfig implementation
 	virtual uint8_t Init(uint8_t parent, uint8_t port, bool lowspeed);
 	virtual uint8_t Release();
@@ -108,7 +108,7 @@ typedef struct {
     uint8_t		iProduct;              // Index of String Descriptor describing the product.
     uint8_t		iSerialNumber;         // Index of String Descriptor with the device's serial number.
     uint8_t		bNumConfigurations;    // Number of possible configurations.
-} USB_DEVICE_DESCRIPTOR;
+} __attribute__((packed)) USB_DEVICE_DESCRIPTOR;
 
 /* Configuration descriptor structure */
 typedef struct
@@ -121,7 +121,7 @@ typedef struct
     uint8_t iConfiguration;        // Index of String Descriptor describing the configuration.
     uint8_t bmAttributes;          // Configuration characteristics.
     uint8_t bMaxPower;             // Maximum power consumed by this configuration.
-} USB_CONFIGURATION_DESCRIPTOR;
+} __attribute__((packed)) USB_CONFIGURATION_DESCRIPTOR;
 
 /* Interface descriptor structure */
 typedef struct
@@ -135,7 +135,7 @@ typedef struct
     uint8_t bInterfaceSubClass;    // Subclass code (assigned by the USB-IF).
     uint8_t bInterfaceProtocol;    // Protocol code (assigned by the USB-IF).  0xFF-Vendor specific.
     uint8_t iInterface;            // Index of String Descriptor describing the interface.
-} USB_INTERFACE_DESCRIPTOR;
+} __attribute__((packed)) USB_INTERFACE_DESCRIPTOR;
 
 /* Endpoint descriptor structure */
 typedef struct
@@ -146,7 +146,7 @@ typedef struct
     uint8_t bmAttributes;          // Endpoint transfer type.
     uint16_t wMaxPacketSize;        // Maximum packet size.
     uint8_t bInterval;             // Polling interval in frames.
-} USB_ENDPOINT_DESCRIPTOR;
+} __attribute__((packed)) USB_ENDPOINT_DESCRIPTOR;
 
 
 /* HID descriptor */
@@ -159,12 +159,12 @@ typedef struct
 	uint8_t		bNumDescriptors;		// Number of additional class specific descriptors
 	uint8_t		bDescrType;				// Type of class descriptor
     uint16_t	wDescriptorLength;		// Total size of the Report descriptor
-} USB_HID_DESCRIPTOR;
+} __attribute__((packed)) USB_HID_DESCRIPTOR;
 
 typedef struct
 {
 	uint8_t		bDescrType;				// Type of class descriptor
     uint16_t	wDescriptorLength;		// Total size of the Report descriptor
-} HID_CLASS_DESCRIPTOR_LEN_AND_TYPE;
+} __attribute__((packed)) HID_CLASS_DESCRIPTOR_LEN_AND_TYPE;
 
 #endif // _ch9_h_
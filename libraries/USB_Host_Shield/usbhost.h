@@ -22,6 +22,12 @@ e-mail   :  support@circuitsathome.com
 #include "max3421e.h"
 #include "usb_ch9.h"
 
+#if defined(ARDUINO) && ARDUINO >=100
+#include "Arduino.h"
+#else
+#include <WProgram.h>
+#endif
+
 
 /* SPI initialization */
 template< typename CLK, typename MOSI, typename MISO, typename SPI_SS > class SPi
@@ -56,6 +62,8 @@ typedef SPi< Pb7, Pb5, Pb6, Pb4 > spi;
 template< typename SS, typename INTR > class MAX3421e /* : public spi */
 {
 	static uint8_t vbusState;
+	static uint16_t frameNum;		// SOFs since power-up, see IntHandler()
+	static uint16_t frameTime;		// millis() of the last SOF counted
 
   public:
     MAX3421e();
@@ -68,6 +76,7 @@ template< typename SS, typename INTR > class MAX3421e /* : public spi */
     uint16_t reset();
     int8_t Init();
 	uint8_t getVbusState( void ) { return vbusState; };
+	uint16_t getFrameNum( void ) { return frameNum; };
 	void busprobe();
 	uint8_t GpxHandler();
 	uint8_t IntHandler();
@@ -76,6 +85,10 @@ template< typename SS, typename INTR > class MAX3421e /* : public spi */
 
 template< typename SS, typename INTR >
 uint8_t MAX3421e< SS, INTR >::vbusState = 0;
+template< typename SS, typename INTR >
+uint16_t MAX3421e< SS, INTR >::frameNum = 0;
+template< typename SS, typename INTR >
+uint16_t MAX3421e< SS, INTR >::frameTime = 0;
 
 /* constructor */
 template< typename SS, typename INTR >
@@ -287,9 +300,14 @@ uint8_t MAX3421e< SS, INTR >::IntHandler()
 	uint8_t HIRQ;
 	uint8_t HIRQ_sendback = 0x00;
     HIRQ = regRd( rHIRQ );                  //determine interrupt source
-    //if( HIRQ & bmFRAMEIRQ ) {               //->1ms SOF interrupt handler
-    //    HIRQ_sendback |= bmFRAMEIRQ;
-    //}//end FRAMEIRQ handling
+    if( HIRQ & bmFRAMEIRQ ) {               //->1ms SOF interrupt handler
+        /* The chip has no frame number register, so SOFs are counted here. Frames that went by */
+        /* while Task() was not called are added from millis(), both tick once a millisecond   */
+        uint16_t now = (uint16_t)millis();
+        frameNum += ( now != frameTime ) ? (uint16_t)( now - frameTime ) : 1;
+        frameTime = now;
+        HIRQ_sendback |= bmFRAMEIRQ;        //clearing it lets INT go high until the next event
+    }//end FRAMEIRQ handling
     if( HIRQ & bmCONDETIRQ ) {
         busprobe();
         HIRQ_sendback |= bmCONDETIRQ;
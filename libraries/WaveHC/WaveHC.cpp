@@ -18,7 +18,9 @@
 #include "WaveHC.h"
 #include "dac.h"
 #include "WaveUtil.h"
+#include "WaveMixer.h"
 WaveHC *playing = 0;
+WaveHC *queued = 0;  // wave to start when playing ends, see enqueue()
 #define PLAYBUFFLEN 256UL
 uint8_t buffer1[PLAYBUFFLEN];
 uint8_t buffer2[PLAYBUFFLEN];
@@ -27,6 +29,7 @@ uint8_t *currentpos, *endbuffpos;   // the current playing location and the end
 
 volatile uint8_t fillingbuffer = 0;
 volatile uint8_t doublebuffready = 0;
+volatile uint8_t readerLocked = 0;  // main program is using the SD, see lockReader()
 //uint16_t temp16;
 
 #define DEBUG 0
@@ -37,6 +40,45 @@ volatile uint8_t doublebuffready = 0;
 
 #define SECTORSIZE 512
 
+// send a 12-bit value to DAC A, used when the mixer is active
+static inline void dac_send12(uint16_t v)
+{
+  select_dac();
+
+  // dac a, buffered, gain = 1, enabled
+  dac_data_low();
+  dac_clock_up();  dac_clock_down();
+  dac_data_high();
+  dac_clock_up();  dac_clock_down();
+  dac_clock_up();  dac_clock_down();
+  dac_clock_up();  dac_clock_down();
+
+  uint8_t t8 = v >> 4;
+  for (uint8_t i = 0; i < 8; i++) {
+    if (t8 & 0x80)
+      DAC_DI_PORT |= _BV(DAC_DI);
+    else
+      DAC_DI_PORT &= ~_BV(DAC_DI);
+    dac_clock_up();
+    t8 <<= 1;
+    dac_clock_down();
+  }
+  t8 = v << 4;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (t8 & 0x80)
+      DAC_DI_PORT |= _BV(DAC_DI);
+    else
+      DAC_DI_PORT &= ~_BV(DAC_DI);
+    dac_clock_up();
+    t8 <<= 1;
+    dac_clock_down();
+  }
+
+  unselect_dac();
+  dac_latch_down();
+  dac_latch_up();
+}
+
 #if defined(__AVR_ATmega328P__)
 SIGNAL(TIMER1_COMPA_vect) {
 #else
@@ -58,8 +100,15 @@ SIGNAL(SIG_OUTPUT_COMPARE1A) {
 
   uint8_t t8, i;
 
-  if (!playing) 
+  if (!playing) {
+    // clips only, see WaveMixer::start()
+    if (mixerActive) {
+      dac_send12(mixerSample(0));
+    } else {
+      TIMSK1 &= ~_BV(OCIE1A);
+    }
     return;
+  }
 
 
   if (currentpos == endbuffpos) {
@@ -84,6 +133,20 @@ SIGNAL(SIG_OUTPUT_COMPARE1A) {
     }
   }
 
+  if (mixerActive || mixerStreamGain != MIXER_UNITY) {
+    // mix stream and clips in 12-bit signed fixed-point
+    int16_t s;
+    if (playing->BitsPerSample == 16) {
+      s = (int16_t)((currentpos[1] << 8) | currentpos[0]) >> 4;
+      currentpos += 2;
+    } else {
+      s = ((int16_t)currentpos[0] - 128) << 4;
+      currentpos++;
+    }
+    dac_send12(mixerSample(s));
+    return;
+  }
+
 
   // ok get ready to output data to the dac
   // do the THING
@@ -221,10 +284,10 @@ SIGNAL(SIG_OUTPUT_COMPARE1B) {
 	::);
 #endif //OSX_BUG_FIX	
 	
-  uint16_t read;
+  int16_t read;
 
   TIMSK1 &= ~_BV(OCIE1B);   // turn off bufferfiller 
-  if (doublebuffready) { // we're not needed ??
+  if (doublebuffready || readerLocked) { // we're not needed ??
     return;
   }
 
@@ -234,7 +297,20 @@ SIGNAL(SIG_OUTPUT_COMPARE1B) {
 
   read = readWaveData(playing, doublebuff, PLAYBUFFLEN);
 
-  if (read == 0) {
+  if (read < PLAYBUFFLEN && queued) {
+    // end of wave or read error, fill the rest of the buffer from the queued wave
+    if (read < 0) read = 0;
+    cli();
+    playing->isplaying = 0;
+    playing = queued;
+    queued = 0;
+    playing->isplaying = 1;
+    sei();
+    int16_t n = readWaveData(playing, doublebuff + read, PLAYBUFFLEN - read);
+    if (n > 0) read += n;
+  }
+
+  if (read <= 0 && !queued) {
     playing->stop();
   }
   cli();
@@ -359,6 +435,7 @@ uint8_t WaveHC::create(FatReader &f)
   remainingBytesInChunk = 0;
   fd = &f;
   errors = 0;
+  if (queued == this) queued = 0;
 
   isplaying = 0;
 
@@ -382,6 +459,62 @@ void WaveHC::pause(void)
   fd->volume()->rawDevice()->readEnd(); // redo any partial read on resume
 }
 
+/*
+ * Queue this wave to start when the playing wave ends, with no gap between
+ * the last sample of one and the first sample of the next.
+ *
+ * create() must be called first. If the SD is read while a wave is playing,
+ * as it is for open() and create(), the reads must be between lockReader()
+ * and unlockReader().  The data chunk is located here so the fill interrupt
+ * only has to read samples when it switches waves.
+ *
+ * Returns zero if the format differs from the playing wave or no data chunk
+ * is found.  If nothing is playing the wave is started with play().
+ */
+uint8_t WaveHC::enqueue(void)
+{
+  if (!playing) {
+    play();
+    return isplaying;
+  }
+  if (Channels != playing->Channels
+      || BitsPerSample != playing->BitsPerSample
+      || dwSamplesPerSec != playing->dwSamplesPerSec) {
+    return 0;
+  }
+  lockReader();
+  uint8_t ok = remainingBytesInChunk || seekDataChunk(this);
+  unlockReader();
+  if (!ok) return 0;
+  cli();
+  queued = this;
+  sei();
+  return 1;
+}
+// return true if this wave is waiting to follow the playing wave
+uint8_t WaveHC::isQueued(void)
+{
+  return queued == this;
+}
+/*
+ * Hold off the buffer fill interrupt so the main program can read the SD.
+ * Keep the lock short, the play buffer lasts PLAYBUFFLEN samples.
+ */
+void WaveHC::lockReader(void)
+{
+  cli();
+  readerLocked = 1;
+  sei();
+}
+// release lockReader() and catch up on any fill that was held off
+void WaveHC::unlockReader(void)
+{
+  cli();
+  readerLocked = 0;
+  if (playing && !doublebuffready && !fillingbuffer) TIMSK1 |= _BV(OCIE1B);
+  sei();
+}
+
 void WaveHC::play(void) {
   // setup the interrupt as necessary
   // fix for stereo - play interleaved
@@ -389,6 +522,7 @@ void WaveHC::play(void) {
   uint32_t ticksPerSample = F_CPU / (dwSamplesPerSec*Channels);
   int16_t read;
 
+  TIMSK1 &= ~_BV(OCIE1A);   // DAC interrupt may be running clips only
   playing = this;
 
   // fill the buffer so that we're on a boundary.
@@ -425,28 +559,33 @@ void WaveHC::play(void) {
 }
 
 
-int16_t readWaveData(WaveHC *wav, uint8_t *buff, uint16_t len) {
+// skip chunks until the start of a data chunk
+uint8_t seekDataChunk(WaveHC *wav) {
   uint8_t headerbuff[5];
+  while (1) {
+    // read chunk ID
+    if (wav->fd->read(headerbuff, 4) != 4) return 0;
+    headerbuff[4] = 0;
+    if (wav->fd->read((uint8_t *)&wav->remainingBytesInChunk, 4) != 4) return 0;
+#if DEBUG > 0
+    Serial.print((char *)headerbuff);
+    putstring(" type, size=");
+    Serial.print(wav->remainingBytesInChunk, DEC);
+    putstring_nl("");
+#endif
+
+    if (!strncmp((char *)headerbuff, "data", 4)) return 1;
+    // MEME, if not "data" then skip it!
+    if (!wav->fd->seekCur(wav->remainingBytesInChunk)) return 0;
+  }
+}
+
+int16_t readWaveData(WaveHC *wav, uint8_t *buff, uint16_t len) {
 #if DEBUG > 1
   putstring("*hacK "); uart_putdw_dec(len); putstring_nl("");
 #endif
   if (wav->remainingBytesInChunk == 0) {
-    while (1) {
-      // read chunk ID
-      if (wav->fd->read(headerbuff, 4) != 4) return 0;
-      headerbuff[4] = 0;
-      if (wav->fd->read((uint8_t *)&wav->remainingBytesInChunk, 4) != 4) return 0;
-#if DEBUG > 0
-      Serial.print((char *)headerbuff);
-      putstring(" type, size=");
-      Serial.print(wav->remainingBytesInChunk, DEC);
-      putstring_nl("");
-#endif
-
-      if (!strncmp((char *)headerbuff, "data", 4)) break;
-      // MEME, if not "data" then skip it!
-      if (!wav->fd->seekCur(wav->remainingBytesInChunk)) return 0;
-    }
+    if (!seekDataChunk(wav)) return 0;
   }
 
   if (len > SECTORSIZE) len = SECTORSIZE;
@@ -500,7 +639,9 @@ void WaveHC::setSampleRate(uint32_t samplerate)
 }
 
 void WaveHC::stop(void) {
-  TIMSK1 &= ~_BV(OCIE1A);   // turn on buferfixer if not
+  // keep the DAC interrupt for clips that are still mixing
+  if (!mixerActive) TIMSK1 &= ~_BV(OCIE1A);   // turn on buferfixer if not
+  queued = 0;
 #if DEBUG > 0
   putstring("\n\rAll done!\n\r"); // MEME: Fix last bytes
   Serial.print(playing->errors, DEC);
@@ -8,6 +8,7 @@
  allow 18 byte format chunk if no compression
  play stereo as mono by interleaving channels
  change method of reading fmt chunk - use union of structs
+ gapless playback of queued waves with enqueue(), see WaveMixer.h for clips
 */
 #ifndef WaveHC_h
 #define WaveHC_h
@@ -18,8 +19,12 @@ class WaveHC {
  public:
   WaveHC(void);
   uint8_t create(FatReader &f);
+  uint8_t enqueue(void);
   uint32_t getSize(void) {return fd->fileSize();}
   uint8_t isPaused(void);
+  uint8_t isQueued(void);
+  static void lockReader(void);
+  static void unlockReader(void);
   void pause(void);
   void play(void);
   void resume(void);
@@ -39,5 +44,6 @@ class WaveHC {
 };
 
 int16_t readWaveData(WaveHC *wav, uint8_t *buff, uint16_t len);
+uint8_t seekDataChunk(WaveHC *wav);
 
 #endif //WaveHC_h
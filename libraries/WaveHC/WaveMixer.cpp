@@ -0,0 +1,131 @@
+/*
+ Software mixer for WaveHC.  See WaveMixer.h.
+*/
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include "WProgram.h"
+#include "WaveHC.h"
+#include "WaveMixer.h"
+
+extern WaveHC *playing;
+
+WaveMixer Mixer;
+
+volatile uint8_t mixerActive = 0;         // bit i set if voice i + 1 is active
+uint16_t mixerStreamGain = MIXER_UNITY;   // gain of the wave stream
+uint32_t mixerSampleRate = 22050;         // DAC rate if no wave is playing
+
+static mixer_voice_t voices[MIXER_VOICES];
+
+//------------------------------------------------------------------------------
+/*
+ * Mix the active clips into one stream sample. Called from the DAC interrupt.
+ *
+ * stream is a 12-bit signed sample, the return value is the unsigned 12-bit
+ * DAC code.
+ */
+uint16_t mixerSample(int16_t stream)
+{
+  int16_t acc = stream;
+  if (mixerStreamGain != MIXER_UNITY) {
+    acc = ((int32_t)stream * mixerStreamGain) >> 8;
+  }
+  uint8_t active = mixerActive;
+  mixer_voice_t *v = voices;
+  for (uint8_t m = 1; active; m <<= 1, v++) {
+    if (!(active & m)) continue;
+    active &= ~m;
+    // 8-bit unsigned clip sample to 12-bit signed, gain is at most unity
+    // so the signed product fits in 16 bits
+    int8_t s = pgm_read_byte(v->pos) ^ 0X80;
+    acc += ((int16_t)s * (int16_t)v->gain) >> 4;
+    if (++v->pos == v->end) {
+      if (v->loop) {
+        v->pos = v->start;
+      } else {
+        mixerActive &= ~m;
+      }
+    }
+  }
+  if (acc > 2047) acc = 2047;
+  else if (acc < -2048) acc = -2048;
+  return acc + 2048;
+}
+//------------------------------------------------------------------------------
+WaveMixer::WaveMixer(void) {
+}
+/*
+ * Set the DAC rate used for clips when no wave is playing.
+ */
+void WaveMixer::begin(uint32_t samplerate)
+{
+  mixerSampleRate = samplerate;
+}
+// return true if the voice is playing, voice zero is the wave stream
+uint8_t WaveMixer::isActive(uint8_t voice)
+{
+  if (voice == 0) return playing != 0;
+  if (voice > MIXER_VOICES) return 0;
+  return (mixerActive & (1 << (voice - 1))) != 0;
+}
+/*
+ * Set the gain of a voice. gain is 8.8 fixed-point and limited to unity.
+ */
+void WaveMixer::setGain(uint8_t voice, uint16_t gain)
+{
+  if (gain > MIXER_UNITY) gain = MIXER_UNITY;
+  cli();
+  if (voice == 0) {
+    mixerStreamGain = gain;
+  } else if (voice <= MIXER_VOICES) {
+    voices[voice - 1].gain = gain;
+  }
+  sei();
+}
+/*
+ * Start a clip on a voice, replacing any clip already on that voice.
+ *
+ * clip is 8-bit unsigned mono PCM in PROGMEM.  Returns zero if the voice
+ * number is invalid or the clip is empty.
+ */
+uint8_t WaveMixer::start(uint8_t voice, const uint8_t *clip, uint16_t len,
+                         uint16_t gain, uint8_t loop)
+{
+  if (voice == 0 || voice > MIXER_VOICES || len == 0) return 0;
+  if (gain > MIXER_UNITY) gain = MIXER_UNITY;
+  uint8_t m = 1 << (voice - 1);
+  mixer_voice_t *v = &voices[voice - 1];
+
+  cli();
+  mixerActive &= ~m;
+  v->start = v->pos = clip;
+  v->end = clip + len;
+  v->gain = gain;
+  v->loop = loop;
+  mixerActive |= m;
+  if (!playing && !(TIMSK1 & _BV(OCIE1A))) {
+    // nothing playing so run the DAC interrupt for the clips alone
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS10);
+    OCR1A = F_CPU / mixerSampleRate;
+    TIMSK1 |= _BV(OCIE1A);
+  }
+  sei();
+  return 1;
+}
+// stop a clip voice
+void WaveMixer::stop(uint8_t voice)
+{
+  if (voice == 0 || voice > MIXER_VOICES) return;
+  cli();
+  mixerActive &= ~(1 << (voice - 1));
+  sei();
+}
+// stop all clip voices
+void WaveMixer::stopAll(void)
+{
+  cli();
+  mixerActive = 0;
+  sei();
+}
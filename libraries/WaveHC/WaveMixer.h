@@ -0,0 +1,54 @@
+/*
+ Software mixer for WaveHC.
+
+ Overlays up to MIXER_VOICES short clips on the stream played by WaveHC.
+ Clips are 8-bit unsigned mono PCM stored in flash (PROGMEM) and recorded
+ at the DAC interrupt rate, the sample rate times the number of channels
+ of the stream they are mixed with.  Mixing is done in the DAC interrupt
+ with 12-bit signed fixed-point arithmetic and a per-voice gain where 256
+ is unity.
+
+ The stream itself is voice zero; its gain is set with setGain(0, gain).
+ If no wave is playing, start() runs the DAC interrupt at the rate given to
+ begin() so a beep can be played on its own.
+*/
+#ifndef WaveMixer_h
+#define WaveMixer_h
+
+#include <stdint.h>
+
+/** number of clip voices in addition to the wave stream */
+#define MIXER_VOICES 3
+/** gain value for unity amplitude */
+#define MIXER_UNITY 256
+
+/** clip voice state, owned by the DAC interrupt while active */
+struct mixer_voice_t {
+  const uint8_t *pos;   // next sample in flash
+  const uint8_t *start; // first sample, used to loop
+  const uint8_t *end;   // one past the last sample
+  uint16_t gain;        // 8.8 fixed-point gain
+  uint8_t loop;         // restart at end instead of stopping
+};
+
+class WaveMixer {
+ public:
+  WaveMixer(void);
+  void begin(uint32_t samplerate);
+  uint8_t isActive(uint8_t voice);
+  void setGain(uint8_t voice, uint16_t gain);
+  uint8_t start(uint8_t voice, const uint8_t *clip, uint16_t len,
+                uint16_t gain = MIXER_UNITY, uint8_t loop = 0);
+  void stop(uint8_t voice);
+  void stopAll(void);
+};
+
+extern WaveMixer Mixer;
+
+// used by the WaveHC DAC interrupt
+extern volatile uint8_t mixerActive;
+extern uint16_t mixerStreamGain;
+extern uint32_t mixerSampleRate;
+uint16_t mixerSample(int16_t stream);
+
+#endif //WaveMixer_h
@@ -0,0 +1,288 @@
+/*
+ * WindowStats.h
+ *
+ * Running statistics for sampled sensor streams.
+ *
+ *  WindowStats<T, N>   sum, mean, min and max over the last N samples,
+ *                      O(1) amortized per sample (min/max by monotonic deques)
+ *  ExpAverage<T, K>    exponential average, weight 1/2^K per sample
+ *  CicDecimator<O, R>  order O cascaded integrator-comb decimator by R;
+ *                      order 1 is a moving average decimator
+ *  StreamStats         block mean, RMS about the mean and mean absolute
+ *                      deviation from the previous block's mean
+ *
+ * Everything is allocated statically by the template arguments, so one
+ * object per channel is all that is needed.
+ */
+
+#ifndef WINDOWSTATS_H_
+#define WINDOWSTATS_H_
+
+#include <Arduino.h>
+
+template <typename T, int N, typename S = long>
+class WindowStats {
+	T values[N];
+	int pos;       // next slot to write, also the oldest when full
+	int filled;
+	S total;
+	// positions of min and max candidates, oldest first
+	int minq[N], maxq[N];
+	int minHead, minLen;
+	int maxHead, maxLen;
+
+	static int wrap(int i) {
+		return i >= N ? i - N : i;
+	}
+
+public:
+	WindowStats() {
+		reset();
+	}
+
+	void reset() {
+		pos = 0;
+		filled = 0;
+		total = 0;
+		minHead = minLen = 0;
+		maxHead = maxLen = 0;
+	}
+
+	void add(const T x) {
+		if (filled == N) {
+			// the oldest sample leaves the window
+			total -= values[pos];
+			if (minLen && minq[minHead] == pos) {
+				minHead = wrap(minHead + 1);
+				minLen--;
+			}
+			if (maxLen && maxq[maxHead] == pos) {
+				maxHead = wrap(maxHead + 1);
+				maxLen--;
+			}
+		} else {
+			filled++;
+		}
+		values[pos] = x;
+		total += x;
+		// drop candidates that can never be the min or max again
+		while (minLen && !(values[minq[wrap(minHead + minLen - 1)]] < x))
+			minLen--;
+		minq[wrap(minHead + minLen++)] = pos;
+		while (maxLen && !(x < values[maxq[wrap(maxHead + maxLen - 1)]]))
+			maxLen--;
+		maxq[wrap(maxHead + maxLen++)] = pos;
+		pos = wrap(pos + 1);
+	}
+
+	int count() const {
+		return filled;
+	}
+
+	boolean full() const {
+		return filled == N;
+	}
+
+	S sum() const {
+		return total;
+	}
+
+	T mean() const {
+		return filled ? T(total / filled) : T(0);
+	}
+
+	// min() and max() are only valid after the first add()
+	T min() const {
+		return values[minq[minHead]];
+	}
+
+	T max() const {
+		return values[maxq[maxHead]];
+	}
+
+	T range() const {
+		return max() - min();
+	}
+
+	// i-th most recent sample, 0 is the last one added
+	T operator[](int i) const {
+		i = pos - 1 - i;
+		return values[i < 0 ? i + N : i];
+	}
+};
+
+template <typename T, uint8_t K, typename S = long>
+class ExpAverage {
+	S acc;         // average scaled by 2^K
+	boolean primed;
+
+public:
+	ExpAverage() {
+		reset();
+	}
+
+	void reset() {
+		acc = 0;
+		primed = false;
+	}
+
+	T add(const T x) {
+		if (!primed) {
+			acc = (S) x << K;
+			primed = true;
+		} else {
+			acc += x - (acc >> K);
+		}
+		return value();
+	}
+
+	T value() const {
+		return T(acc >> K);
+	}
+};
+
+/*
+ * The output of a CIC decimator has gain R^O, value() is the raw output
+ * and mean() divides the gain out. Input bits + O * log2(R) must not exceed
+ * 32; the integrators may wrap, the comb stages undo it.
+ */
+template <uint8_t O, uint16_t R>
+class CicDecimator {
+	unsigned long integ[O];
+	unsigned long comb[O];
+	uint16_t phase;
+	long out;
+
+public:
+	CicDecimator() {
+		reset();
+	}
+
+	void reset() {
+		for (uint8_t i = 0; i < O; i++) {
+			integ[i] = 0;
+			comb[i] = 0;
+		}
+		phase = 0;
+		out = 0;
+	}
+
+	static unsigned long gain() {
+		unsigned long g = 1;
+		for (uint8_t i = 0; i < O; i++)
+			g *= R;
+		return g;
+	}
+
+	// returns true when a new output is ready
+	boolean add(const long x) {
+		unsigned long y = (unsigned long) x;
+		for (uint8_t i = 0; i < O; i++) {
+			integ[i] += y;
+			y = integ[i];
+		}
+		if (++phase < R)
+			return false;
+		phase = 0;
+		for (uint8_t i = 0; i < O; i++) {
+			unsigned long t = y;
+			y -= comb[i];
+			comb[i] = t;
+		}
+		out = (long) y;
+		return true;
+	}
+
+	long value() const {
+		return out;
+	}
+
+	long mean() const {
+		return out / (long) gain();
+	}
+};
+
+/*
+ * Accumulates a block of samples. mean() and rms() describe the current
+ * block; meanAbsDev() is taken about the mean of the previous block, as
+ * the two pass loops in Power_Measurement do, so one pass is enough.
+ * Without a baseline given, the first sample is the baseline of the
+ * first block.
+ */
+class StreamStats {
+	unsigned int n;
+	long total;
+	unsigned long squares;
+	unsigned long absDev;
+	int baseline;
+	boolean based;     // false until the baseline is set
+
+public:
+	StreamStats() :
+			baseline(0), based(false) {
+		clear();
+	}
+
+	StreamStats(int base) :
+			baseline(base), based(true) {
+		clear();
+	}
+
+	void clear() {
+		n = 0;
+		total = 0;
+		squares = 0;
+		absDev = 0;
+	}
+
+	// end the block, its mean becomes the baseline for the next one
+	void restart() {
+		if (n)
+			baseline = mean();
+		clear();
+	}
+
+	void add(const int x) {
+		if (!based) {
+			baseline = x;
+			based = true;
+		}
+		long d = (long) x - baseline;
+		n++;
+		total += d;
+		squares += (unsigned long) (d * d);
+		absDev += d < 0 ? -d : d;
+	}
+
+	unsigned int count() const {
+		return n;
+	}
+
+	int base() const {
+		return baseline;
+	}
+
+	int mean() const {
+		return n ? int(baseline + total / (long) n) : baseline;
+	}
+
+	// RMS about the block mean
+	float rms() const {
+		if (!n)
+			return 0;
+		float m = (float) total / n;
+		float v = (float) squares / n - m * m;
+		return v > 0 ? sqrt(v) : 0;
+	}
+
+	// RMS about the baseline, e.g. an AC signal around a measured ground
+	float rmsFromBase() const {
+		return n ? sqrt((float) squares / n) : 0;
+	}
+
+	int meanAbsDev() const {
+		return n ? int(absDev / n) : 0;
+	}
+};
+
+#endif /* WINDOWSTATS_H_ */
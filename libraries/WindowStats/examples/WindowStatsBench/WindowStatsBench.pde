@@ -0,0 +1,83 @@
+/*
+ * Per-sample cost of WindowStats, CicDecimator and StreamStats.
+ *
+ * Feeds pseudo random 10-bit samples to a bank of channels and prints the
+ * average time and CPU cycles spent per sample for each engine, followed by
+ * the cost of the rescanning loop WindowStats replaces.
+ */
+#include <WindowStats.h>
+
+const int channels = 24;
+const int window = 32;
+const unsigned int rounds = 200;
+
+WindowStats<int, window> stats[channels];
+CicDecimator<2, 16> cic[channels];
+StreamStats block[channels];
+int hist[window];
+
+unsigned int lfsr = 0xACE1;
+
+int sample() {
+	lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+	return lfsr & 0x3ff;
+}
+
+void report(const char * name, unsigned long us, unsigned long n) {
+	Serial.print(name);
+	Serial.print(": ");
+	Serial.print((float) us / n, 2);
+	Serial.print(" us, ");
+	Serial.print((float) us * (F_CPU / 1000000L) / n, 0);
+	Serial.println(" cycles/sample");
+}
+
+void setup() {
+	Serial.begin(19200);
+}
+
+void loop() {
+	unsigned long n = (unsigned long) rounds * channels;
+	unsigned long t;
+	long sink = 0;
+
+	t = micros();
+	for (unsigned int r = 0; r < rounds; r++)
+		for (int c = 0; c < channels; c++) {
+			stats[c].add(sample());
+			sink += stats[c].min() + stats[c].max() + stats[c].sum();
+		}
+	report("WindowStats<int,32>", micros() - t, n);
+
+	t = micros();
+	for (unsigned int r = 0; r < rounds; r++)
+		for (int c = 0; c < channels; c++)
+			if (cic[c].add(sample()))
+				sink += cic[c].mean();
+	report("CicDecimator<2,16>", micros() - t, n);
+
+	t = micros();
+	for (unsigned int r = 0; r < rounds; r++)
+		for (int c = 0; c < channels; c++)
+			block[c].add(sample());
+	report("StreamStats", micros() - t, n);
+
+	// the rescanning loop of analogLowpass, one channel
+	int q = 0;
+	t = micros();
+	for (unsigned long i = 0; i < n; i++) {
+		hist[q] = sample();
+		int sum = 0, maxv = hist[q], minv = hist[q];
+		for (int j = 0; j < window; j++) {
+			sum += hist[j];
+			maxv = max(maxv, hist[j]);
+			minv = min(minv, hist[j]);
+		}
+		sink += sum + maxv + minv;
+		q = (q + 1) % window;
+	}
+	report("rescan of 32", micros() - t, n);
+
+	Serial.println(sink & 1 ? "" : " ");
+	delay(5000);
+}
@@ -114,13 +114,15 @@ char* ETHER_28J60::serviceRequest()
 				{
 	          		// head, post and other methods for possible status codes see:
 	            	// http://www.w3.org/Protocols/rfc2616/rfc2616-sec10.html
-	            	plen=es.ES_fill_tcp_data_p(buf,0,PSTR("HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n<h1>200 OK</h1>"));
-					plen=es.ES_fill_tcp_data_p(buf,plen,PSTR("<h1>A</h1>"));		        	
+	            	es.ES_make_tcp_ack_from_any(buf); // send ack for the request
+	            	plen=es.ES_fill_tcp_data_onchip_p(buf,0,PSTR("HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n<h1>200 OK</h1>"));
+					plen=es.ES_fill_tcp_data_onchip_p(buf,plen,PSTR("<h1>A</h1>"));		        	
 					respond();
+					return 0;
 	        	}
 	 			if (strncmp("/",(char *)&(buf[dat_p+4]),1)==0) // was "/ " and 2
 				{
-					// Copy the request action before we overwrite it with the response
+					// Copy the request action, buf is reused for the next packet
 					int i = 0;
 					while (buf[dat_p+5+i] != ' ' && i < STR_BUFFER_SIZE)
 					{
@@ -128,23 +130,22 @@ char* ETHER_28J60::serviceRequest()
 						i++;
 					}
 					strbuf[i] = '\0';
-					plen=es.ES_fill_tcp_data_p(buf,0,PSTR("HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n"));		        	
+					// the response is written into the chip as it is printed,
+					// so it is not limited by the size of buf
+					es.ES_make_tcp_ack_from_any(buf); // send ack for http get
+					plen=es.ES_fill_tcp_data_onchip_p(buf,0,PSTR("HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n"));		        	
 					return (char*)strbuf;
 	         	}	     
 	      }
 		}
 	}
+	return 0;
 }
 
 
 void ETHER_28J60::print(char* text)
 {
-	int j = 0;
-  	while (text[j]) 
-	{
-    	buf[TCP_CHECKSUM_L_P+3+plen]=text[j++];
-    	plen++;
-  	}
+	plen=es.ES_fill_tcp_data_onchip(buf,plen,text);
 }
 
 void ETHER_28J60::print(int number)
@@ -156,6 +157,5 @@ void ETHER_28J60::print(int number)
 
 void ETHER_28J60::respond()
 {
-	es.ES_make_tcp_ack_from_any(buf); // send ack for http get
-	es.ES_make_tcp_ack_with_data(buf,plen); // send data
+	es.ES_make_tcp_ack_with_data_onchip(buf,plen); // send the rest of the data
 }
@@ -30,6 +30,11 @@
 
 static uint8_t Enc28j60Bank;
 static uint16_t NextPacketPtr;
+// the packet last received stays in the receive buffer until the next
+// call to enc28j60PacketReceive, so that replies can copy from it
+static uint8_t PacketHeld;
+static uint16_t PacketAddr;
+static uint16_t PacketLen;
 
 #define ENC28J60_CONTROL_CS     10
 #define SPI_MOSI				11
@@ -272,6 +277,8 @@ uint8_t enc28j60getrev(void)
 
 void enc28j60PacketSend(uint16_t len, uint8_t* packet)
 {
+	// the frame before must be out before the buffer is written
+	enc28j60TransmitWait();
 	// Set the write pointer to start of transmit buffer area
 	enc28j60Write(EWRPTL, TXSTART_INIT&0xFF);
 	enc28j60Write(EWRPTH, TXSTART_INIT>>8);
@@ -299,6 +306,15 @@ uint16_t enc28j60PacketReceive(uint16_t maxlen, uint8_t* packet)
 {
 	uint16_t rxstat;
 	uint16_t len;
+	// free the packet read out last time
+	if (PacketHeld){
+		// Move the RX read pointer to the start of the next received packet
+		enc28j60Write(ERXRDPTL, (NextPacketPtr));
+		enc28j60Write(ERXRDPTH, (NextPacketPtr)>>8);
+		// decrement the packet counter indicate we are done with this packet
+		enc28j60WriteOp(ENC28J60_BIT_FIELD_SET, ECON2, ECON2_PKTDEC);
+		PacketHeld=0;
+	}
 	// check if a packet has been received and buffered
 	//if( !(enc28j60Read(EIR) & EIR_PKTIF) ){
         // The above does not work. See Rev. B4 Silicon Errata point 6.
@@ -309,6 +325,8 @@ uint16_t enc28j60PacketReceive(uint16_t maxlen, uint8_t* packet)
 	// Set the read pointer to the start of the received packet
 	enc28j60Write(ERDPTL, (NextPacketPtr));
 	enc28j60Write(ERDPTH, (NextPacketPtr)>>8);
+	// the frame follows the 6 byte header
+	PacketAddr=enc28j60RxWrap(NextPacketPtr+6);
 	// read the next packet pointer
 	NextPacketPtr  = enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0);
 	NextPacketPtr |= enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0)<<8;
@@ -319,6 +337,7 @@ uint16_t enc28j60PacketReceive(uint16_t maxlen, uint8_t* packet)
 	// read the receive status (see datasheet page 43)
 	rxstat  = enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0);
 	rxstat |= enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0)<<8;
+        PacketLen=len;
 	// limit retrieve length
         if (len>maxlen-1){
                 len=maxlen-1;
@@ -329,16 +348,122 @@ uint16_t enc28j60PacketReceive(uint16_t maxlen, uint8_t* packet)
         if ((rxstat & 0x80)==0){
                 // invalid
                 len=0;
+                PacketLen=0;
         }else{
                 // copy the packet from the receive buffer
                 enc28j60ReadBuffer(len, packet);
         }
-	// Move the RX read pointer to the start of the next received packet
-	// This frees the memory we just read out
-	enc28j60Write(ERXRDPTL, (NextPacketPtr));
-	enc28j60Write(ERXRDPTH, (NextPacketPtr)>>8);
-	// decrement the packet counter indicate we are done with this packet
-	enc28j60WriteOp(ENC28J60_BIT_FIELD_SET, ECON2, ECON2_PKTDEC);
+	// the memory is freed on the next call
+	PacketHeld=1;
 	return(len);
 }
 
+// The buffer memory address that addr comes to, reading on from the
+// end of the receive buffer wraps to its start
+uint16_t enc28j60RxWrap(uint16_t addr)
+{
+        if (addr>RXSTOP_INIT){
+                addr-=RXSTOP_INIT-RXSTART_INIT+1;
+        }
+        return(addr);
+}
+
+// Address and full length of the frame last returned by
+// enc28j60PacketReceive, also when only part of it was copied out.
+// The length is 0 for a bad frame.
+uint16_t enc28j60PacketAddr(void)
+{
+        return(PacketAddr);
+}
+
+uint16_t enc28j60PacketLen(void)
+{
+        return(PacketLen);
+}
+
+// Writes len bytes into the buffer memory at addr
+void enc28j60WriteMem(uint16_t addr, uint8_t* data, uint16_t len)
+{
+        enc28j60Write(EWRPTL, addr&0xFF);
+        enc28j60Write(EWRPTH, addr>>8);
+        enc28j60WriteBuffer(len, data);
+}
+
+// Copies len bytes within the buffer memory with the DMA engine, the
+// source wraps if it is in the receive buffer (see datasheet page 71)
+void enc28j60CopyMem(uint16_t saddr, uint16_t daddr, uint16_t len)
+{
+        uint16_t eaddr;
+        if (len==0){
+                return;
+        }
+        eaddr=saddr+len-1;
+        if (saddr<=RXSTOP_INIT){
+                eaddr=enc28j60RxWrap(eaddr);
+        }
+        enc28j60Write(EDMASTL, saddr&0xFF);
+        enc28j60Write(EDMASTH, saddr>>8);
+        enc28j60Write(EDMANDL, eaddr&0xFF);
+        enc28j60Write(EDMANDH, eaddr>>8);
+        enc28j60Write(EDMADSTL, daddr&0xFF);
+        enc28j60Write(EDMADSTH, daddr>>8);
+        enc28j60WriteOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_CSUMEN);
+        enc28j60WriteOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_DMAST);
+        while (enc28j60Read(ECON1) & ECON1_DMAST);
+}
+
+// The IP checksum of len bytes of buffer memory at addr, taken by the
+// DMA engine.  Returned as checksum() returns it, high byte first on
+// the wire.
+uint16_t enc28j60Checksum(uint16_t addr, uint16_t len)
+{
+        uint16_t eaddr=addr+len-1;
+        if (addr<=RXSTOP_INIT){
+                eaddr=enc28j60RxWrap(eaddr);
+        }
+        // a packet arriving while the checksum is taken can be lost.
+        // See Rev. B7 Silicon Errata point 17.
+        while (enc28j60Read(ESTAT) & ESTAT_RXBUSY);
+        enc28j60Write(EDMASTL, addr&0xFF);
+        enc28j60Write(EDMASTH, addr>>8);
+        enc28j60Write(EDMANDL, eaddr&0xFF);
+        enc28j60Write(EDMANDH, eaddr>>8);
+        enc28j60WriteOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_CSUMEN);
+        enc28j60WriteOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_DMAST);
+        while (enc28j60Read(ECON1) & ECON1_DMAST);
+        enc28j60WriteOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_CSUMEN);
+        return((enc28j60Read(EDMACSH)<<8) | enc28j60Read(EDMACSL));
+}
+
+// Waits until the frame given to the chip last has gone out, the
+// transmit buffer must not be written before that
+void enc28j60TransmitWait(void)
+{
+        while (enc28j60Read(ECON1) & ECON1_TXRTS){
+                // See Rev. B4 Silicon Errata point 12.
+                if (enc28j60Read(EIR) & EIR_TXERIF){
+                        enc28j60WriteOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRTS);
+                }
+        }
+}
+
+// Sends the frame of len bytes already written to the transmit buffer
+// at TXSTART_INIT+1
+void enc28j60TransmitBuffer(uint16_t len)
+{
+	// Set the write pointer to start of transmit buffer area
+	enc28j60Write(EWRPTL, TXSTART_INIT&0xFF);
+	enc28j60Write(EWRPTH, TXSTART_INIT>>8);
+	// write per-packet control byte (0x00 means use macon3 settings)
+	enc28j60WriteOp(ENC28J60_WRITE_BUF_MEM, 0, 0x00);
+	// Set the TXND pointer to correspond to the packet size given
+	enc28j60Write(ETXNDL, (TXSTART_INIT+len)&0xFF);
+	enc28j60Write(ETXNDH, (TXSTART_INIT+len)>>8);
+	// send the contents of the transmit buffer onto the network
+	enc28j60WriteOp(ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRTS);
+        // Reset the transmit logic problem. See Rev. B4 Silicon Errata point 12.
+	if( (enc28j60Read(EIR) & EIR_TXERIF) ){
+                enc28j60WriteOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRTS);
+        }
+}
+
@@ -275,6 +275,15 @@ extern void enc28j60Init(uint8_t* macaddr);
 extern void enc28j60PacketSend(uint16_t len, uint8_t* packet);
 extern uint16_t enc28j60PacketReceive(uint16_t maxlen, uint8_t* packet);
 extern uint8_t enc28j60getrev(void);
+// replies built in the buffer memory
+extern uint16_t enc28j60RxWrap(uint16_t addr);
+extern uint16_t enc28j60PacketAddr(void);
+extern uint16_t enc28j60PacketLen(void);
+extern void enc28j60WriteMem(uint16_t addr, uint8_t* data, uint16_t len);
+extern void enc28j60CopyMem(uint16_t saddr, uint16_t daddr, uint16_t len);
+extern uint16_t enc28j60Checksum(uint16_t addr, uint16_t len);
+extern void enc28j60TransmitWait(void);
+extern void enc28j60TransmitBuffer(uint16_t len);
 
 #endif
 //@}
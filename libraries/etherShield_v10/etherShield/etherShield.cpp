@@ -78,6 +78,22 @@ void EtherShield::ES_make_tcp_ack_with_data(uint8_t *buf,uint16_t dlen){
 	make_tcp_ack_with_data(buf,dlen);
 }
 
+uint16_t EtherShield::ES_fill_tcp_data_onchip_p(uint8_t *buf,uint16_t pos, const prog_char *progmem_s){
+	return fill_tcp_data_onchip_p(buf, pos, progmem_s);
+}
+
+uint16_t EtherShield::ES_fill_tcp_data_onchip(uint8_t *buf,uint16_t pos, const char *s){
+	return fill_tcp_data_onchip(buf, pos, s);
+}
+
+uint16_t EtherShield::ES_fill_tcp_data_onchip_len(uint8_t *buf,uint16_t pos, const uint8_t *data,uint16_t len){
+	return fill_tcp_data_onchip_len(buf, pos, data, len);
+}
+
+void EtherShield::ES_make_tcp_ack_with_data_onchip(uint8_t *buf,uint16_t dlen){
+	make_tcp_ack_with_data_onchip(buf,dlen);
+}
+
 void EtherShield::ES_make_arp_request(uint8_t *buf, uint8_t *server_ip){
 	make_arp_request(buf, server_ip);
 }
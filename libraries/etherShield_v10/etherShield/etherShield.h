@@ -47,6 +47,11 @@ class EtherShield
 		uint16_t ES_get_tcp_data_pointer(void);
 		void ES_make_tcp_ack_from_any(uint8_t *buf);
 		void ES_make_tcp_ack_with_data(uint8_t *buf,uint16_t dlen);
+		// reply data written into the chip instead of buf
+		uint16_t ES_fill_tcp_data_onchip_p(uint8_t *buf,uint16_t pos, const prog_char *progmem_s);
+		uint16_t ES_fill_tcp_data_onchip(uint8_t *buf,uint16_t pos, const char *s);
+		uint16_t ES_fill_tcp_data_onchip_len(uint8_t *buf,uint16_t pos, const uint8_t *data,uint16_t len);
+		void ES_make_tcp_ack_with_data_onchip(uint8_t *buf,uint16_t dlen);
 		
 		// new web client functions 
 		void ES_make_arp_request(uint8_t *buf, uint8_t *server_ip);
@@ -20,9 +20,11 @@
  *********************************************/
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <string.h>
 //#include "avr_compat.h"
 #include "net.h"
 #include "enc28j60.h"
+#include "ip_arp_udp_tcp.h"
 
 static uint8_t wwwport=80;
 static uint8_t macaddr[6];
@@ -30,6 +32,9 @@ static uint8_t ipaddr[4];
 static int16_t info_hdr_len=0;
 static int16_t info_data_len=0;
 static uint8_t seqnum=0xa; // my initial tcp sequence number
+// a frame built in the chip starts after the control byte
+#define TX_FRAME_P (TXSTART_INIT+1)
+#define ICMP_DATA_P (ICMP_TYPE_P+8)
 
 // The Ip checksum is calculated over the ip header only starting
 // with the header length field and a total length of 20 bytes
@@ -359,7 +364,17 @@ void make_echo_reply_from_request(uint8_t *buf,uint16_t len)
         }
         buf[ICMP_CHECKSUM_P]+=0x08;
         //
-        enc28j60PacketSend(len,buf);
+        // the data is copied over from the request still in the receive
+        // buffer, so pings larger than buf are answered whole
+        len=enc28j60PacketLen();
+        if (len<=ICMP_DATA_P){
+                enc28j60PacketSend(len,buf);
+                return;
+        }
+        enc28j60TransmitWait();
+        enc28j60WriteMem(TX_FRAME_P,buf,ICMP_DATA_P);
+        enc28j60CopyMem(enc28j60RxWrap(enc28j60PacketAddr()+ICMP_DATA_P),TX_FRAME_P+ICMP_DATA_P,len-ICMP_DATA_P);
+        enc28j60TransmitBuffer(len);
 }
 
 // you can send a max of 220 bytes of data
@@ -528,6 +543,106 @@ void make_tcp_ack_with_data(uint8_t *buf,uint16_t dlen)
         enc28j60PacketSend(IP_HEADER_LEN+TCP_HEADER_LEN_PLAIN+dlen+ETH_HEADER_LEN,buf);
 }
 
+// Replies built in the chip.  After make_tcp_ack_from_any the data is
+// written with fill_tcp_data_onchip* straight into the transmit buffer
+// instead of buf, and make_tcp_ack_with_data_onchip sends it.  Every
+// TCP_ONCHIP_SEGMENT bytes a segment goes out on its own, so a reply
+// can be much larger than buf.  The segments follow each other without
+// waiting for acks, the other side's window must take the whole reply.
+// The tcp checksum is taken by the chip's DMA engine.
+
+// step the sequence number in buf past n bytes sent
+static void tcp_seq_add(uint8_t *buf,uint16_t n)
+{
+        uint8_t i=4;
+        while(i>0){
+                n=buf[TCP_SEQ_H_P+i-1]+n;
+                buf[TCP_SEQ_H_P+i-1]=0xff&n;
+                n=n>>8;
+                i--;
+        }
+}
+
+// send the header in buf with dlen bytes of data already in the chip
+static void send_tcp_onchip(uint8_t *buf,uint16_t dlen,uint8_t flags)
+{
+        uint16_t j;
+        buf[TCP_FLAG_P]=flags;
+        j=IP_HEADER_LEN+TCP_HEADER_LEN_PLAIN+dlen;
+        buf[IP_TOTLEN_H_P]=j>>8;
+        buf[IP_TOTLEN_L_P]=j& 0xff;
+        fill_ip_hdr_checksum(buf);
+        // the rest of the pseudo header, protocol and tcp length, stands
+        // in the checksum field and the sum starts from ip.src
+        j=IP_PROTO_TCP_V+TCP_HEADER_LEN_PLAIN+dlen;
+        buf[TCP_CHECKSUM_H_P]=j>>8;
+        buf[TCP_CHECKSUM_L_P]=j& 0xff;
+        enc28j60TransmitWait();
+        enc28j60WriteMem(TX_FRAME_P,buf,TCP_DATA_P);
+        j=enc28j60Checksum(TX_FRAME_P+IP_SRC_P,8+TCP_HEADER_LEN_PLAIN+dlen);
+        buf[TCP_CHECKSUM_H_P]=j>>8;
+        buf[TCP_CHECKSUM_L_P]=j& 0xff;
+        enc28j60WriteMem(TX_FRAME_P+TCP_CHECKSUM_H_P,&buf[TCP_CHECKSUM_H_P],2);
+        enc28j60TransmitBuffer(ETH_HEADER_LEN+IP_HEADER_LEN+TCP_HEADER_LEN_PLAIN+dlen);
+}
+
+// fill in len bytes of tcp data at position pos of the segment being
+// built in the chip.  Returns the position at which the data after
+// this could be filled, counted from the start of the next segment
+// when this one was sent.
+uint16_t fill_tcp_data_onchip_len(uint8_t *buf,uint16_t pos, const uint8_t *data,uint16_t len)
+{
+        uint16_t n;
+        while(len){
+                if (pos==0){
+                        // the frame sent before may still be going out
+                        enc28j60TransmitWait();
+                }
+                n=TCP_ONCHIP_SEGMENT-pos;
+                if (n>len){
+                        n=len;
+                }
+                enc28j60WriteMem(TX_FRAME_P+TCP_DATA_P+pos,(uint8_t *)data,n);
+                data+=n;
+                len-=n;
+                pos+=n;
+                if (pos==TCP_ONCHIP_SEGMENT){
+                        send_tcp_onchip(buf,pos,TCP_FLAG_ACK_V);
+                        tcp_seq_add(buf,pos);
+                        pos=0;
+                }
+        }
+        return(pos);
+}
+
+uint16_t fill_tcp_data_onchip_p(uint8_t *buf,uint16_t pos, const prog_char *progmem_s)
+{
+        uint8_t chunk[16];
+        uint8_t n;
+        char c;
+        do{
+                n=0;
+                while (n<sizeof(chunk) && (c = pgm_read_byte(progmem_s))) {
+                        chunk[n++]=c;
+                        progmem_s++;
+                }
+                pos=fill_tcp_data_onchip_len(buf,pos,chunk,n);
+        }while(n==sizeof(chunk));
+        return(pos);
+}
+
+uint16_t fill_tcp_data_onchip(uint8_t *buf,uint16_t pos, const char *s)
+{
+        return(fill_tcp_data_onchip_len(buf,pos,(const uint8_t *)s,strlen(s)));
+}
+
+// send the last dlen bytes filled in the chip, with the fin.
+// Use it in place of make_tcp_ack_with_data.
+void make_tcp_ack_with_data_onchip(uint8_t *buf,uint16_t dlen)
+{
+        send_tcp_onchip(buf,dlen,TCP_FLAG_ACK_V|TCP_FLAG_PUSH_V|TCP_FLAG_FIN_V);
+}
+
 
 /* new functions for web client interface */
 void make_arp_request(uint8_t *buf, uint8_t *server_ip)
@@ -33,6 +33,12 @@ extern uint16_t fill_tcp_data_p(uint8_t *buf,uint16_t pos, const prog_char *prog
 extern uint16_t fill_tcp_data(uint8_t *buf,uint16_t pos, const char *s);
 extern void make_tcp_ack_from_any(uint8_t *buf);
 extern void make_tcp_ack_with_data(uint8_t *buf,uint16_t dlen);
+// the data of a reply held in the chip instead of buf, see ip_arp_udp_tcp.c
+#define TCP_ONCHIP_SEGMENT 1400
+extern uint16_t fill_tcp_data_onchip_len(uint8_t *buf,uint16_t pos, const uint8_t *data,uint16_t len);
+extern uint16_t fill_tcp_data_onchip_p(uint8_t *buf,uint16_t pos, const prog_char *progmem_s);
+extern uint16_t fill_tcp_data_onchip(uint8_t *buf,uint16_t pos, const char *s);
+extern void make_tcp_ack_with_data_onchip(uint8_t *buf,uint16_t dlen);
 extern void make_arp_request(uint8_t *buf, uint8_t *server_ip);
 extern uint8_t arp_packet_is_myreply_arp ( uint8_t *buf );
 extern void tcp_client_send_packet(uint8_t *buf,uint16_t dest_port, uint16_t src_port, uint8_t flags, uint8_t max_segment_size, 
@@ -0,0 +1,39 @@
+/*
+ Enc28j60Sim - register level model of the ENC28J60, for running
+ etherShield on the host.
+
+ The model decodes the SPI opcodes and keeps the control register banks
+ and the 8 KB buffer memory.  It has the receive ring with its wrap, the
+ DMA copy and checksum, and a transmit that completes a few register
+ reads after it is started.  receive() queues a frame as the chip would
+ on reception.  Every transmitted frame is kept in sent[].
+
+ Writes into the frame being transmitted are counted in txOverwrites.
+ Frames that do not fit the receive ring are dropped and counted in
+ rxDrops.
+ */
+
+#ifndef ENC28J60SIM_H
+#define ENC28J60SIM_H
+
+#include <stdint.h>
+#include <vector>
+
+class Enc28j60Sim {
+public:
+  // Queues a received frame, false if the receive ring is full
+  static bool receive(const uint8_t * frame, uint16_t len);
+  // Lets a transmission still going on complete
+  static void finishTransmit();
+
+  static std::vector<std::vector<uint8_t> > sent;
+  static unsigned long spiBytes;
+  static unsigned long txOverwrites;
+  static unsigned long rxDrops;
+
+  // wiring, called by the pin and SPI stand-ins
+  static void select(bool low);
+  static uint8_t transfer(uint8_t data);
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ OnChipReply - replies built in the ENC28J60 buffer, on the model
+
+ Answers a 1200 byte ping placed so that it wraps the receive ring, and
+ checks the reply is whole with valid checksums.  Then serves pages of
+ 300 to 20000 bytes through ETHER_28J60 and checks the data, sequence
+ numbers and checksums of every segment and the FIN on the last.  Prints
+ the SPI bytes each reply took.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "etherShield.h"
+#include "ETHER_28J60.h"
+#include "Enc28j60Sim.h"
+
+typedef std::vector<uint8_t> Frame;
+
+static uint8_t mymac[6] = { 0x54, 0x55, 0x58, 0x10, 0x00, 0x24 };
+static uint8_t myip[4] = { 192, 168, 1, 15 };
+static uint8_t peermac[6] = { 0x02, 0, 0, 0, 0, 1 };
+static uint8_t peerip[4] = { 192, 168, 1, 2 };
+static int fails;
+
+#define CHECK(c) do { if (!(c)) { printf("FAIL line %d: %s\n", __LINE__, #c); fails++; } } while (0)
+
+static uint16_t sum(const uint8_t * p, int n, uint32_t s = 0) {
+  for (int i = 0; i < n; i++)
+    s += (i & 1) ? p[i] : p[i] << 8;
+  while (s >> 16)
+    s = (s & 0xFFFF) + (s >> 16);
+  return s;
+}
+
+static uint32_t be32(const uint8_t * p) {
+  return (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static Frame ipFrame(uint8_t proto, const Frame & payload) {
+  Frame f(34);
+  uint16_t length = 20 + payload.size();
+  memcpy(&f[0], mymac, 6);
+  memcpy(&f[6], peermac, 6);
+  f[12] = 8;
+  f[14] = 0x45;
+  f[16] = length >> 8;
+  f[17] = length;
+  f[18] = 0x12;
+  f[22] = 64;
+  f[23] = proto;
+  memcpy(&f[26], peerip, 4);
+  memcpy(&f[30], myip, 4);
+  uint16_t c = ~sum(&f[14], 20);
+  f[24] = c >> 8;
+  f[25] = c;
+  f.insert(f.end(), payload.begin(), payload.end());
+  return f;
+}
+
+static uint32_t peerSeq = 1000;
+
+static Frame tcpFrame(uint8_t flags, uint32_t ack, const std::string & data) {
+  Frame t(20);
+  t[0] = 0x9c; t[1] = 0x40;     // from port 40000 to 80
+  t[3] = 80;
+  for (int i = 0; i < 4; i++) {
+    t[4 + i] = peerSeq >> (24 - 8 * i);
+    t[8 + i] = ack >> (24 - 8 * i);
+  }
+  t[12] = 0x50;
+  t[13] = flags;
+  t[14] = t[15] = 0xff;
+  t.insert(t.end(), data.begin(), data.end());
+  Frame f = ipFrame(6, t);
+  uint16_t c = ~sum(&f[34], t.size(), sum(&f[26], 8) + 6 + t.size());
+  f[50] = c >> 8;
+  f[51] = c;
+  return f;
+}
+
+static bool ipValid(const Frame & f) { return sum(&f[14], 20) == 0xFFFF; }
+
+static bool tcpValid(const Frame & f) {
+  int length = (f[16] << 8 | f[17]) - 20;
+  return sum(&f[34], length, sum(&f[26], 8) + 6 + length) == 0xFFFF;
+}
+
+static ETHER_28J60 server;
+
+static void ping() {
+  Frame icmp(8 + 1200);
+  icmp[0] = 8;
+  icmp[5] = 7;
+  icmp[7] = 1;
+  for (size_t i = 8; i < icmp.size(); i++)
+    icmp[i] = i * 7;
+  uint16_t c = ~sum(&icmp[0], icmp.size());
+  icmp[2] = c >> 8;
+  icmp[3] = c;
+
+  // frames for another address move the ring on so that the ping wraps
+  for (int k = 0; k < 5; k++) {
+    Frame f = ipFrame(17, Frame(1200 - k, 0));
+    f[30] = 9;
+    Enc28j60Sim::receive(&f[0], f.size());
+    server.serviceRequest();
+  }
+
+  Frame f = ipFrame(1, icmp);
+  Enc28j60Sim::sent.clear();
+  Enc28j60Sim::receive(&f[0], f.size());
+  unsigned long before = Enc28j60Sim::spiBytes;
+  server.serviceRequest();
+  Enc28j60Sim::finishTransmit();
+  printf("ping %u bytes: %lu SPI bytes\n", (unsigned) f.size(), Enc28j60Sim::spiBytes - before);
+
+  CHECK(Enc28j60Sim::sent.size() == 1);
+  if (Enc28j60Sim::sent.size() == 1) {
+    Frame & t = Enc28j60Sim::sent[0];
+    CHECK(t.size() == f.size());
+    CHECK(memcmp(&t[0], peermac, 6) == 0 && memcmp(&t[6], mymac, 6) == 0);
+    CHECK(ipValid(t));
+    CHECK(t[34] == 0 && sum(&t[34], t.size() - 34) == 0xFFFF);
+    CHECK(memcmp(&t[42], &f[42], f.size() - 42) == 0);
+  }
+}
+
+static void page(int pageSize) {
+  // handshake
+  Enc28j60Sim::sent.clear();
+  Frame f = tcpFrame(0x02, 0, "");
+  Enc28j60Sim::receive(&f[0], f.size());
+  server.serviceRequest();
+  Enc28j60Sim::finishTransmit();
+  CHECK(Enc28j60Sim::sent.size() == 1);
+  uint32_t seq = be32(&Enc28j60Sim::sent[0][38]) + 1;
+  peerSeq++;
+
+  std::string request = "GET /abc HTTP/1.0\r\n\r\n";
+  f = tcpFrame(0x10, seq, request);
+  Enc28j60Sim::receive(&f[0], f.size());
+  Enc28j60Sim::sent.clear();
+  unsigned long before = Enc28j60Sim::spiBytes;
+  char * action = server.serviceRequest();
+  CHECK(action && strcmp(action, "abc") == 0);
+
+  std::string expect;
+  char line[64];
+  for (int n = 0; (int) expect.size() < pageSize; n++) {
+    snprintf(line, sizeof(line), "<p>line %d of the page</p>\n", n);
+    expect += line;
+    server.print(line);
+  }
+  server.respond();
+  Enc28j60Sim::finishTransmit();
+  unsigned long spi = Enc28j60Sim::spiBytes - before;
+
+  std::string got;
+  std::vector<Frame> & sent = Enc28j60Sim::sent;
+  CHECK(sent.size() >= 2);
+  for (size_t i = 0; i < sent.size(); i++) {
+    Frame & t = sent[i];
+    int length = (t[16] << 8 | t[17]) - 40;
+    CHECK(ipValid(t));
+    CHECK(tcpValid(t));
+    CHECK(be32(&t[42]) == peerSeq + request.size());
+    CHECK(be32(&t[38]) == seq);
+    CHECK((int) t.size() == 54 + length);
+    CHECK(((t[47] & 1) != 0) == (i == sent.size() - 1));   // FIN on the last
+    got.append(t.begin() + 54, t.end());
+    seq += length;
+  }
+  peerSeq += request.size() + 1;
+  CHECK(got == "HTTP/1.0 200 OK\r\nContent-Type: text/html\r\n\r\n" + expect);
+  printf("page %5d bytes: %u frames, %lu SPI bytes\n", pageSize, (unsigned) sent.size(), spi);
+}
+
+int main() {
+  server.setup(mymac, myip, 80);
+  ping();
+  page(300);
+  page(1400 - 45);
+  page(5000);
+  page(20000);
+  printf("writes into a frame being sent %lu, receive drops %lu\n",
+         Enc28j60Sim::txOverwrites, Enc28j60Sim::rxDrops);
+  CHECK(Enc28j60Sim::txOverwrites == 0);
+  printf(fails ? "%d FAILED\n" : "ok\n", fails);
+  return fails != 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Builds etherShield and ETHER_28J60 with the host compiler against the
+# ENC28J60 model and runs the tests.  Run from this directory:  sh build.sh
+
+set -e
+LIB=../..
+CXX="${CXX:-g++} -w -Istub -I$LIB/etherShield -I$LIB/ETHER_28J60 -I."
+SOURCES="etherShield_c.cpp $LIB/etherShield/etherShield.cpp $LIB/ETHER_28J60/ETHER_28J60.cpp hostcore.cpp Enc28j60Sim.cpp"
+
+mkdir -p bin
+for test in OnChipReply; do
+  $CXX $SOURCES $test.cpp -o bin/$test
+  echo "== $test"
+  ./bin/$test
+done
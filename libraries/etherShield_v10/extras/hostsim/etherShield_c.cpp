@@ -0,0 +1,6 @@
+// The C sources of etherShield, built as C++ so that SPDR reaches the model
+
+extern "C" {
+#include <enc28j60.c>
+#include <ip_arp_udp_tcp.c>
+}
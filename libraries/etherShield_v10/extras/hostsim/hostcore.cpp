@@ -0,0 +1,27 @@
+// Pins, SPI and delays of the Arduino core for host builds
+
+#include <Arduino.h>
+#include <avr/io.h>
+#include "Enc28j60Sim.h"
+
+// pin 10 is the chip select of the ENC28J60
+#define CS_PIN 10
+
+HostSPDR SPDR;
+volatile uint8_t SPSR = 1 << SPIF;  // every transfer is complete at once
+volatile uint8_t SPCR;
+
+HostSPDR & HostSPDR::operator=(uint8_t out) {
+  in = Enc28j60Sim::transfer(out);
+  return *this;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin == CS_PIN)
+    Enc28j60Sim::select(value == LOW);
+}
+
+void delay(unsigned long) {}
+void delayMicroseconds(unsigned int) {}
@@ -0,0 +1,32 @@
+// Host stand-in for the parts of the Arduino core the library uses
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+#ifdef __cplusplus
+}
+#endif
+
+inline char *itoa(int value, char *buf, int base) {
+  sprintf(buf, base == 16 ? "%x" : "%d", value);
+  return buf;
+}
+
+#endif
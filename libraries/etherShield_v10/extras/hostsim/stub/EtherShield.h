@@ -0,0 +1,2 @@
+// etherShield.cpp includes its header as EtherShield.h
+#include <etherShield.h>
@@ -0,0 +1,23 @@
+// The SPI registers of the AVR, wired to the ENC28J60 model.  Writing
+// SPDR clocks a byte out and latches the byte clocked in.
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define SPIF 7
+#define SPI2X 0
+#define SPE 6
+#define MSTR 4
+
+struct HostSPDR {
+  uint8_t in;
+  HostSPDR & operator=(uint8_t out);
+  operator uint8_t() const { return in; }
+};
+
+extern HostSPDR SPDR;
+extern volatile uint8_t SPSR, SPCR;
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+typedef char prog_char;
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#endif
@@ -16,6 +16,15 @@
 #include "aSocket.h"
 #include "spiBus.h"
 
+uint8_t aSocket::hwaddr[ETH_ALEN];
+uint32_t aSocket::ipaddr;
+uint8_t aSocket::netmask;
+uint32_t aSocket::gatewayip;
+uint8_t aSocket::pktbuf[ASOCKET_BUFSIZE];
+aSocket *aSocket::table[ASOCKET_MAX];
+uint8_t aSocket::parts = 0;
+uint16_t aSocket::rxsize;
+uint16_t aSocket::txsize;
 
 uint16_t checksum(uint16_t* addr, uint16_t len) {
 
@@ -94,12 +103,13 @@ void aSocket::MakeTcp( struct tcphdr *tcp, uint8_t tcpflags, uint16_t datalen, u
 
 	tcp->source = port;
 	tcp->dest = peerport;
-	tcp->seq = seq;
+	// data goes from the oldest byte not acked, anything else after what is in flight
+	tcp->seq = datalen ? seq : IncNetNum(seq,seq_adv);
 	tcp->ack_seq = ack;
 	tcp->doff = (TCPHDR_SIZE+((flags&ASOCKET_TCP_OPT) ? 8 : 0))>>2;
 	tcp->res1 = 0;
 	tcp->flags = tcpflags;
-	tcp->window = htons(TCP_MSS_DEFAULT);
+	tcp->window = htons(rxsize-availdata);
 	tcp->urg_ptr = 0;
 
 	if ( flags & ASOCKET_TCP_OPT ) {
@@ -147,6 +157,8 @@ uint16_t aSocket::OnChipChecksum( uint16_t pktaddr, uint8_t prot, uint16_t datal
 
 	uint16_t cs;
 	uint16_t csoff;
+	// a received packet may wrap around the end of the receive ring
+	uint8_t rx = ( pktaddr <= RXSTOP_INIT );
 	
 	pktaddr += ETHHDR_SIZE + IPHDR_SIZE;
 
@@ -165,10 +177,13 @@ uint16_t aSocket::OnChipChecksum( uint16_t pktaddr, uint8_t prot, uint16_t datal
 	break;
 	}
 	
+	if ( rx ) csoff = enc28j60_RxWrap(csoff);
+
 	cs = htons(cs);
 	enc28j60_WriteMem( csoff, (uint8_t*)&cs, sizeof(uint16_t) );
 
-	cs = htons( enc28j60_checksum( pktaddr-8, 8+datalen ) );
+	pktaddr -= 8;
+	cs = htons( enc28j60_checksum( rx ? enc28j60_RxWrap(pktaddr) : pktaddr, 8+datalen ) );
 
 	enc28j60_WriteMem( csoff, (uint8_t*)&cs, sizeof(uint16_t) );
 	
@@ -201,7 +216,7 @@ void aSocket::InitSEQ() {
 
 }
 
-uint32_t aSocket::IncNetNum( uint32_t &num, uint16_t addval ) {
+uint32_t aSocket::IncNetNum( uint32_t num, uint16_t addval ) {
 
 	return htonl( ntohl(num) + addval);
 }
@@ -237,7 +252,7 @@ void aSocket::QueryARP() {
 	arp->ar_op = htons(ARPOP_REQUEST);
 
 	arp->ar_sip = ipaddr;
-	arp->ar_tip = peeripaddr;
+	arp->ar_tip = ArpTarget();
 
 	for ( uint8_t i = 0 ; i < ETH_ALEN ; i++ ) {
 		eth->h_source[i] = hwaddr[i];
@@ -248,286 +263,521 @@ void aSocket::QueryARP() {
 
 	DispatchPacket( ETHHDR_SIZE+ARPHDR_SIZE );
 
+	timer = millis();
 }
 
-void aSocket::HandleInetStack( uint32_t timeout ) {
+// the host whose hardware address frames to the peer go to
+uint32_t aSocket::ArpTarget() {
 
-	#ifdef __ASOCK_DBG__
-		_FUNCTION_DBG_INFO_
-	#endif
+	// do we need to use gateway?
+	if ( subnet(ipaddr) != subnet(peeripaddr) ) return gatewayip;
+
+return peeripaddr;
+}
+
+void aSocket::SetState( constate_t cs ) {
+
+	if ( constate == cs ) return;
+
+	constate = cs;
 
+	if ( cs == ASOCK_ESTABLISHED ) evflags |= ASOCK_EV_ESTABLISHED;
+	else if ( cs == ASOCK_CLOSED ) evflags |= ASOCK_EV_CLOSED;
+}
+
+// Sends datalen bytes from the start of the transmit buffer
+void aSocket::SendData( uint16_t datalen ) {
+
+	uint16_t hdrlen = ETHHDR_SIZE + IPHDR_SIZE + ((protocol == IPPROTO_TCP) ? TCPHDR_SIZE : UDPHDR_SIZE);
+
+	MakeEth( (struct ethhdr*)pktbuf, ETH_P_IP );
+	MakeIp( (struct iphdr*)(pktbuf+ETHHDR_SIZE), hdrlen+datalen-ETHHDR_SIZE, protocol );
+
+	if ( protocol == IPPROTO_TCP ) {
+#ifdef ASOCKET_COMPILE_TCP
+		MakeTcp( (struct tcphdr*)(pktbuf+ETHHDR_SIZE+IPHDR_SIZE), TCP_FLAG_PSH|TCP_FLAG_ACK, datalen, ASOCKET_NOFLAGS );
+#endif
+	} else {
+#ifdef ASOCKET_COMPILE_UDP
+		MakeUdp( (struct udphdr*)(pktbuf+ETHHDR_SIZE+IPHDR_SIZE), datalen, ASOCKET_NOFLAGS );
+#endif
+	}
+
+	uint16_t pktaddr = enc28j60_NewPacket( hdrlen+datalen );
+	enc28j60_WritePacketData( 0, pktbuf, hdrlen, 0 );
+	if ( datalen ) enc28j60_CopyMem( TxBuffer(), pktaddr+hdrlen, datalen );
+
+	OnChipChecksum( pktaddr, protocol, datalen );
+	enc28j60_SendNewPacket();
+
+	timer = millis();
+
+	if ( protocol == IPPROTO_TCP ) {
+#ifdef ASOCKET_COMPILE_TCP
+		seq_adv = datalen;
+#endif
+	} else {
+		// nothing comes back for datagrams
+		txlen -= datalen;
+		if ( txlen ) enc28j60_CopyMem( TxBuffer()+datalen, TxBuffer(), txlen );
+		else {
+			txpush = 0;
+			evflags |= ASOCK_EV_ACKED;
+		}
+	}
+}
+
+// Sends what is due, called for each socket on every poll()
+void aSocket::Timer() {
+
+	uint32_t elapsed = millis() - timer;
+
+	switch ( constate ) {
+
+	case ASOCK_QUERYARP:
+		if ( elapsed < ASOCKET_REQTO ) break;
+
+		if ( ++retries == ASOCKET_RETRIES ) SetState( ASOCK_CLOSED );
+		else QueryARP();
+	break;
+
+	case ASOCK_INIT:
+#ifdef ASOCKET_COMPILE_UDP
+		if ( protocol == IPPROTO_UDP ) {
+			SetState( ASOCK_ESTABLISHED );
+			break;
+		}
+#endif
+#ifdef ASOCKET_COMPILE_TCP
+		if ( retries && elapsed < ((uint32_t)ASOCKET_RTO << (retries-1)) ) break;
+
+		if ( retries == ASOCKET_RETRIES ) {
+			SetState( ASOCK_CLOSED );
+			break;
+		}
+
+		retries++;
+		SendTCPSYN();
+		timer = millis();
+#endif
+	break;
+
+	case ASOCK_ESTABLISHED:
+#ifdef ASOCKET_COMPILE_TCP
+		if ( seq_adv ) {
+
+			if ( elapsed < ((uint32_t)ASOCKET_RTO << retries) ) break;
+
+			// no ack received
+			if ( retries == ASOCKET_RETRIES ) {
+				close();
+				break;
+			}
+
+			retries++;
+			SendData( seq_adv );
+			break;
+		}
+#endif
+		if ( txpush && txlen ) {
+
+			uint16_t maxlen = MAX_FRAMELEN - ETHHDR_SIZE - IPHDR_SIZE - ((protocol == IPPROTO_TCP) ? TCPHDR_SIZE : UDPHDR_SIZE);
+
+			SendData( (txlen < maxlen) ? txlen : maxlen );
+		}
+	break;
+
+	default:
+	break;
+	}
+}
+
+#ifdef ASOCKET_COMPILE_TCP
+// Answers the segment in pktbuf with a segment of our own, without data
+void aSocket::TcpReply( struct ethhdr *eth, struct iphdr *ip, struct tcphdr *tcp, uint8_t tcpflags, uint8_t flags ) {
+
+	// we may need to cut off possible tcp options
+	uint16_t len = ((uint8_t*)tcp-(uint8_t*)eth) + TCPHDR_SIZE + ((flags&ASOCKET_TCP_OPT) ? 8 : 0);
+
+	MakeEthReply( eth );
+	MakeIpReply( ip, len-ETHHDR_SIZE );
+	MakeTcp( tcp, tcpflags, 0, flags|ASOCKET_CHECKSUM );
+
+	DispatchPacket( len );
+}
+
+// The bytes from seq on were acked
+void aSocket::Acked( uint16_t len ) {
+
+	seq = IncNetNum( seq, len );
+	seq_adv -= len;
+	txlen -= len;
+
+	// keep what is left at the start of the buffer
+	if ( txlen ) enc28j60_CopyMem( TxBuffer()+len, TxBuffer(), txlen );
+	else {
+		txpush = 0;
+		evflags |= ASOCK_EV_ACKED;
+	}
+
+	retries = 0;
+	timer = millis();
+}
+
+void aSocket::TcpInput( struct ethhdr *eth, struct iphdr *ip, struct tcphdr *tcp, uint16_t pktlen ) {
+
+	uint16_t tcpoffset = ((uint8_t*)tcp-(uint8_t*)eth);
 	uint16_t datalen;
-	uint32_t m = millis();
-	constate_t	initialcs = constate;
 
-	while ( ((millis() - m) < timeout) && initialcs == constate ) {
-	
-		uint16_t pktlen;
+	switch ( constate ) {
 
-		if ( !(pktlen = enc28j60_ReceivePkt()) || pktlen > ETH_DATA_LEN ) continue;
-		enc28j60_ReadPacketData( 0, pktbuf, (pktlen < ASOCKET_BUFSIZE) ? pktlen : ASOCKET_BUFSIZE );
+	case ASOCK_INIT:
+		if ( !(tcp->flags == (TCP_FLAG_SYN|TCP_FLAG_ACK)) || tcp->ack_seq != seq ) break;
 
-		struct ethhdr *eth = (struct ethhdr*)pktbuf;
+		ack = IncNetNum( tcp->seq, 1 );
+		TcpReply( eth, ip, tcp, TCP_FLAG_ACK, ASOCKET_NOFLAGS );
 
-		#ifdef __ASOCK_DBG_ETH__
-			Serial.print("ETH len: ");
-			Serial.println(pktlen,DEC);
-		#endif
-		
-		if ( ntohs(eth->h_proto) == ETH_P_ARP ) {
-		
-			struct arphdr *arp = (struct arphdr*)(pktbuf+ETHHDR_SIZE);
-			
-			#ifdef __ASOCK_DBG_ARP__
-				Serial.print("ARP op: ");
-				Serial.println(ntohs(arp->ar_op),HEX);
-			#endif
+		retries = 0;
+		SetState( ASOCK_ESTABLISHED );
+	break;
 
-			switch ( ntohs(arp->ar_op) ) {
-	
-			case ARPOP_REQUEST:
+	case ASOCK_LISTEN:
+		if ( tcp->flags != TCP_FLAG_SYN ) break;
 
-				if ( arp->ar_tip != ipaddr ) break;
+		copyhwa(eth->h_source,peerhwaddr);
+		peeripaddr = ip->saddr;
+		peerport = tcp->source;
 
-				// make reply frame
-				for ( uint8_t i = 0 ; i < ETH_ALEN ; i++ ) {
+		InitSEQ();
+		ack = IncNetNum( tcp->seq, 1 );
+		TcpReply( eth, ip, tcp, TCP_FLAG_SYN|TCP_FLAG_ACK, ASOCKET_TCP_OPT );
+
+		seq = IncNetNum( seq, 1 );
+		retries = 0;
+		SetState( ASOCK_ESTABLISHED );
+	break;
 
-					eth->h_dest[i] = eth->h_source[i];
-					eth->h_source[i] = hwaddr[i];
+	case ASOCK_ESTABLISHED:
 
-					arp->ar_tha[i] = arp->ar_sha[i];
-					arp->ar_sha[i] = hwaddr[i];
-				}
+		if ( tcp->flags == TCP_FLAG_SYN ) {
 
-				arp->ar_tip = arp->ar_sip;
-				arp->ar_sip = ipaddr;
-				arp->ar_op = htons(ARPOP_REPLY);
+			// our syn+ack was lost, send it again
+			if ( IncNetNum(tcp->seq,1) != ack ) break;
 
-				DispatchPacket( pktlen );
+			uint16_t adv = seq_adv;
+			seq_adv = 0;
+			seq = htonl( ntohl(seq)-1 );
+
+			TcpReply( eth, ip, tcp, TCP_FLAG_SYN|TCP_FLAG_ACK, ASOCKET_TCP_OPT );
+
+			seq = IncNetNum( seq, 1 );
+			seq_adv = adv;
 			break;
+		}
 
-			case ARPOP_REPLY:
-				if ( constate != ASOCK_QUERYARP || peeripaddr != arp->ar_sip ) break;
+		if ( tcp->flags & TCP_FLAG_RST ) {
+			if ( tcp->seq == ack ) SetState( ASOCK_CLOSED );
+			break;
+		}
 
-				copyhwa(arp->ar_sha,peerhwaddr);
+		if ( !(tcp->flags & TCP_FLAG_ACK) ) break;
 
-				// we can initialize connection now
-				constate = ASOCK_INIT;
+		{
+			// acks older than seq, or for more than was sent, move nothing
+			int32_t acked = ntohl(tcp->ack_seq) - ntohl(seq);
+			if ( acked > 0 && acked <= seq_adv ) Acked( acked );
+		}
+
+		datalen = pktlen - (tcpoffset+(tcp->doff<<2));
+
+		if ( tcp->seq != ack ) {
+
+			// out of order, or sent again because our ack was lost,
+			// tell what we wait for
+			if ( datalen || (tcp->flags & (TCP_FLAG_SYN|TCP_FLAG_FIN)) )
+				TcpReply( eth, ip, tcp, TCP_FLAG_ACK, ASOCKET_NOFLAGS );
 			break;
+		}
+
+		if ( datalen ) {
+
+			// what does not fit will be sent again
+			if ( availdata+datalen > rxsize ) datalen = rxsize-availdata;
+
+			if ( datalen ) {
+				enc28j60_CopyMem( enc28j60_RxWrap(enc28j60_ReceivedPktAddr()+tcpoffset+(tcp->doff<<2)), RxBuffer()+availdata, datalen );
+				availdata += datalen;
+				evflags |= ASOCK_EV_DATA;
+
+				ack = IncNetNum( ack, datalen );
 			}
+		}
+
+		if ( tcp->flags & TCP_FLAG_FIN ) {
+
+			// send rst
+			TcpReply( eth, ip, tcp, TCP_FLAG_RST|TCP_FLAG_ACK, ASOCKET_NOFLAGS );
+
+			seq_adv = 0;
+			txlen = 0;
+			SetState( ASOCK_CLOSED );
+			break;
+		}
+
+		// send ack if we got any data, a full buffer tells its window
+		if ( pktlen > tcpoffset+(tcp->doff<<2) )
+			TcpReply( eth, ip, tcp, TCP_FLAG_ACK, ASOCKET_NOFLAGS );
+	break;
+
+	default:
+	break;
+	}
+}
+#endif
+
+// The socket a packet to dport from sip:sport is for; a connection
+// to that peer, or else the first socket listening on dport
+aSocket* aSocket::Find( uint8_t prot, uint16_t dport, uint32_t sip, uint16_t sport ) {
+
+	aSocket *listener = NULL;
+
+	for ( uint8_t i = 0 ; i < ASOCKET_MAX ; i++ ) {
+
+		aSocket *s = table[i];
+
+		if ( !s || s->protocol != prot || s->port != dport ) continue;
+
+		if ( s->constate == ASOCK_LISTEN ) {
+			if ( !listener ) listener = s;
+		} else if ( (s->constate == ASOCK_INIT || s->constate == ASOCK_ESTABLISHED)
+					&& s->peeripaddr == sip && s->peerport == sport )
+			return s;
+	}
+
+return listener;
+}
+
+void aSocket::HandlePacket( uint16_t pktlen ) {
+
+	#ifdef __ASOCK_DBG__
+		_FUNCTION_DBG_INFO_
+	#endif
+
+	uint16_t datalen;
+
+	// one byte less, ReadBuffer terminates the data with zero
+	enc28j60_ReadPacketData( 0, pktbuf, (pktlen < ASOCKET_BUFSIZE) ? pktlen : ASOCKET_BUFSIZE-1 );
 
-		} else if ( ntohs(eth->h_proto) == ETH_P_IP ) {
+	struct ethhdr *eth = (struct ethhdr*)pktbuf;
+
+	#ifdef __ASOCK_DBG_ETH__
+		Serial.print("ETH len: ");
+		Serial.println(pktlen,DEC);
+	#endif
+	
+	if ( ntohs(eth->h_proto) == ETH_P_ARP ) {
+	
+		struct arphdr *arp = (struct arphdr*)(pktbuf+ETHHDR_SIZE);
 		
-			struct iphdr *ip = (struct iphdr*)(pktbuf+ETHHDR_SIZE);
-			
-			#ifdef __ASOCK_DBG_IP__
-				Serial.print("IP src: ");
-				Serial.print(ntohl(ip->saddr),HEX);
-				Serial.print(" dst: ");
-				Serial.println(ntohl(ip->daddr),HEX);
-			#endif
+		#ifdef __ASOCK_DBG_ARP__
+			Serial.print("ARP op: ");
+			Serial.println(ntohs(arp->ar_op),HEX);
+		#endif
 
-			if ( ip->version != IPVERSION || ip->ihl != 5 || ip->daddr != ipaddr ) {
-				enc28j60_FreeReceivedPkt();
-				continue;
-			}
+		switch ( ntohs(arp->ar_op) ) {
 
-			// We can't rely on received bytes count for frames smaller than 60 bytes (+4 for crc).
-			// (for eg. tcp syn+ack, or udp packet)
-			pktlen = ntohs(ip->tot_len) + ETHHDR_SIZE;
+		case ARPOP_REQUEST:
 
-			if ( ip->protocol == IPPROTO_ICMP ) {
+			if ( arp->ar_tip != ipaddr ) break;
 
-				struct icmphdr *icmp = (struct icmphdr*)( (uint8_t*)ip + (ip->ihl << 2) );
+			// make reply frame
+			for ( uint8_t i = 0 ; i < ETH_ALEN ; i++ ) {
 
-				#ifdef __ASOCK_DBG_ICMP__
-					Serial.print("ICMP type: ");
-					Serial.println(icmp->type,HEX);
-				#endif
+				eth->h_dest[i] = eth->h_source[i];
+				eth->h_source[i] = hwaddr[i];
 
-				if ( icmp->type == ICMP_ECHO ) {
+				arp->ar_tha[i] = arp->ar_sha[i];
+				arp->ar_sha[i] = hwaddr[i];
+			}
 
-					// make reply frame
-					MakeEthReply( eth );
-					MakeIpReply( ip, 0 );
+			arp->ar_tip = arp->ar_sip;
+			arp->ar_sip = ipaddr;
+			arp->ar_op = htons(ARPOP_REPLY);
 
-					// icmp
-					icmp->type = ICMP_ECHOREPLY;
-					icmp->checksum += 8;		// add our change to checksum
+			DispatchPacket( pktlen );
+		break;
 
-					DispatchPacket( pktlen );
-				}
+		case ARPOP_REPLY:
+			for ( uint8_t i = 0 ; i < ASOCKET_MAX ; i++ ) {
 
-			} else
+				aSocket *s = table[i];
 
-#ifdef ASOCKET_COMPILE_UDP
-			if ( ip->protocol == IPPROTO_UDP && protocol == IPPROTO_UDP ) {
-				struct udphdr *udp = (struct udphdr*)( (uint8_t*)ip + (ip->ihl << 2) );
-				datalen = ntohs(udp->len) - UDPHDR_SIZE;
-				
-				#ifdef __ASOCK_DBG_UDP__
-				Serial.print("tcp: src ");
-				Serial.print(ntohs(udp->source),DEC);
-				Serial.print(" dst ");
-				Serial.println(ntohs(udp->dest),DEC);
-				Serial.print(" pktlen ");
-				Serial.println(pktlen,DEC);
-				#endif
-
-				if ( port != udp->dest || OnChipChecksum(enc28j60_ReceivedPktAddr(),IPPROTO_UDP,datalen) != udp->check ) {
-					enc28j60_FreeReceivedPkt();
-					continue;
-				}
-
-				if ( constate == ASOCK_ESTABLISHED || constate == ASOCK_LISTEN ) {
-
-					if ( datalen ) {
-
-						if ( constate == ASOCK_LISTEN ) {
-							copyhwa(eth->h_source,peerhwaddr);
-							peeripaddr = ip->saddr;
-							peerport = udp->source;
-							constate = ASOCK_ESTABLISHED;
-						}
-
-						if ( availdata+datalen > RXBUFSIZE ) datalen = RXBUFSIZE-availdata;
-
-						enc28j60_CopyMem( enc28j60_ReceivedPktAddr()+pktlen-datalen, RXBUFFER+availdata, datalen );
-						availdata += datalen;
-
-						enc28j60_FreeReceivedPkt();
-					return;
-					}
-				}
-
-			} else
-#endif
-#ifdef ASOCKET_COMPILE_TCP
-			if ( ip->protocol == IPPROTO_TCP && protocol == IPPROTO_TCP ) {
-				struct tcphdr *tcp = (struct tcphdr*)( (uint8_t*)ip + (ip->ihl << 2) );
-
-				uint16_t tcpoffset = ((uint8_t*)tcp-(uint8_t*)eth);
-				datalen = pktlen - (tcpoffset+TCPHDR_SIZE);
-
-				#ifdef __ASOCK_DBG_TCP__
-				Serial.print("tcp: src ");
-				Serial.print(ntohs(tcp->source),DEC);
-				Serial.print(" dst ");
-				Serial.println(ntohs(tcp->dest),DEC);
-				Serial.print(" flags ");
-				Serial.print(tcp->flags,HEX);
-				Serial.print(" pktlen ");
-				Serial.println(pktlen,DEC);
-				Serial.print(" check ");
-				Serial.print(OnChipChecksum(enc28j60_ReceivedPktAddr(),IPPROTO_TCP,datalen),HEX);
-				Serial.print(' ');
-				Serial.println(tcp->check,HEX);
-				#endif
-
-				if ( port != tcp->dest || OnChipChecksum(enc28j60_ReceivedPktAddr(),IPPROTO_TCP,datalen) != tcp->check ) {
-					enc28j60_FreeReceivedPkt();
-					continue;
-				}
-
-				// now we can proceed
-				switch ( constate ) {
-
-				case ASOCK_INIT:
-					if ( !(tcp->flags == (TCP_FLAG_SYN|TCP_FLAG_ACK)) || tcp->ack_seq != seq || peerport != tcp->source ) break;
-
-					ack = IncNetNum( tcp->seq, 1 );
-
-					// make reply frame (we may need to cut off possible tcp options)
-					MakeEthReply( eth );
-					MakeIpReply( ip, tcpoffset+TCPHDR_SIZE-ETHHDR_SIZE );
-					MakeTcp( tcp, TCP_FLAG_ACK, 0, ASOCKET_CHECKSUM );
-
-					DispatchPacket( tcpoffset+TCPHDR_SIZE );
-
-					constate = ASOCK_ESTABLISHED;
-				break;
+				if ( !s || s->constate != ASOCK_QUERYARP || s->ArpTarget() != arp->ar_sip ) continue;
+
+				copyhwa(arp->ar_sha,s->peerhwaddr);
 
-				case ASOCK_LISTEN:
-					if ( tcp->flags != TCP_FLAG_SYN ) break;
+				// we can initialize connection now
+				s->constate = ASOCK_INIT;
+				s->retries = 0;
+			}
+		break;
+		}
 
-					copyhwa(eth->h_source,peerhwaddr);
-					peeripaddr = ip->saddr;
-					peerport = tcp->source;
+	} else if ( ntohs(eth->h_proto) == ETH_P_IP ) {
+	
+		struct iphdr *ip = (struct iphdr*)(pktbuf+ETHHDR_SIZE);
+		
+		#ifdef __ASOCK_DBG_IP__
+			Serial.print("IP src: ");
+			Serial.print(ntohl(ip->saddr),HEX);
+			Serial.print(" dst: ");
+			Serial.println(ntohl(ip->daddr),HEX);
+		#endif
 
-					InitSEQ();
-					ack = IncNetNum( tcp->seq, 1 );
+		if ( ip->version != IPVERSION || ip->ihl != 5 || ip->daddr != ipaddr ) return;
 
-					MakeEthReply( eth );
-					MakeIpReply( ip, (tcpoffset+TCPHDR_SIZE+8)-ETHHDR_SIZE );
-					MakeTcp( tcp, TCP_FLAG_SYN|TCP_FLAG_ACK, 0, ASOCKET_TCP_OPT|ASOCKET_CHECKSUM );
+		// We can't rely on received bytes count for frames smaller than 60 bytes (+4 for crc).
+		// (for eg. tcp syn+ack, or udp packet)
+		pktlen = ntohs(ip->tot_len) + ETHHDR_SIZE;
 
-					DispatchPacket( tcpoffset+TCPHDR_SIZE+8 );
+		if ( ip->protocol == IPPROTO_ICMP ) {
 
-					seq = IncNetNum( seq, 1 );
-					constate = ASOCK_ESTABLISHED;
-				break;
+			struct icmphdr *icmp = (struct icmphdr*)( (uint8_t*)ip + (ip->ihl << 2) );
 
-				case ASOCK_ESTABLISHED:
-					if ( tcp->seq != ack || peerport != tcp->source ) break;
+			#ifdef __ASOCK_DBG_ICMP__
+				Serial.print("ICMP type: ");
+				Serial.println(icmp->type,HEX);
+			#endif
 
-					// is it carry proper ack?
-					if (  (tcp->flags & TCP_FLAG_ACK) && tcp->ack_seq == IncNetNum(seq,seq_adv) )
-						seq = tcp->ack_seq;
-					else
-						// no, ignore this packet
-						break;
+			if ( icmp->type == ICMP_ECHO ) {
 
-					MakeEthReply( eth );
-					MakeIpReply( ip, tcpoffset+TCPHDR_SIZE-ETHHDR_SIZE );
+				// make reply frame
+				MakeEthReply( eth );
+				MakeIpReply( ip, 0 );
 
-					if ( tcp->flags & (TCP_FLAG_RST|TCP_FLAG_FIN) ) {
+				// icmp
+				icmp->type = ICMP_ECHOREPLY;
+				icmp->checksum += 8;		// add our change to checksum
 
-						// send rst
-						if ( tcp->flags & TCP_FLAG_FIN ) {
-							MakeTcp( tcp, TCP_FLAG_RST|TCP_FLAG_ACK, 0, ASOCKET_CHECKSUM );
-							DispatchPacket( tcpoffset+TCPHDR_SIZE );
-						}
+				DispatchPacket( pktlen );
+			}
 
-						constate = ASOCK_CLOSED;
-						break;
-					}
+		} else
 
-					if ( tcp->flags & TCP_FLAG_ACK ) {
-					
-						// we may need to cut off possible tcp options
-						datalen = pktlen - (tcpoffset+(tcp->doff<<2));
+#ifdef ASOCKET_COMPILE_UDP
+		if ( ip->protocol == IPPROTO_UDP ) {
+			struct udphdr *udp = (struct udphdr*)( (uint8_t*)ip + (ip->ihl << 2) );
+			datalen = ntohs(udp->len) - UDPHDR_SIZE;
+			
+			#ifdef __ASOCK_DBG_UDP__
+			Serial.print("udp: src ");
+			Serial.print(ntohs(udp->source),DEC);
+			Serial.print(" dst ");
+			Serial.println(ntohs(udp->dest),DEC);
+			Serial.print(" pktlen ");
+			Serial.println(pktlen,DEC);
+			#endif
 
-						if ( availdata+datalen > RXBUFSIZE ) datalen = RXBUFSIZE-availdata;
+			aSocket *s = Find( IPPROTO_UDP, udp->dest, ip->saddr, udp->source );
 
-						// send ack if we got any data
-						if ( datalen ) {
+			if ( !s || !datalen || OnChipChecksum(enc28j60_ReceivedPktAddr(),IPPROTO_UDP,datalen) != udp->check ) return;
 
-							enc28j60_CopyMem( enc28j60_ReceivedPktAddr()+pktlen-datalen, RXBUFFER+availdata, datalen );
-							availdata += datalen;
+			if ( s->constate == ASOCK_LISTEN ) {
+				copyhwa(eth->h_source,s->peerhwaddr);
+				s->peeripaddr = ip->saddr;
+				s->peerport = udp->source;
+				s->SetState( ASOCK_ESTABLISHED );
+			}
 
-							ack = IncNetNum( ack, datalen );
+			if ( s->availdata+datalen > rxsize ) datalen = rxsize-s->availdata;
 
-							MakeTcp( tcp, TCP_FLAG_ACK, 0, ASOCKET_CHECKSUM );
-							DispatchPacket( tcpoffset+TCPHDR_SIZE );
-						}
-					}
-					
-					enc28j60_FreeReceivedPkt();
-				return;
-				}
+			if ( datalen ) {
+				enc28j60_CopyMem( enc28j60_RxWrap(enc28j60_ReceivedPktAddr()+pktlen-datalen), s->RxBuffer()+s->availdata, datalen );
+				s->availdata += datalen;
+				s->evflags |= ASOCK_EV_DATA;
 			}
+
+		} else
+#endif
+#ifdef ASOCKET_COMPILE_TCP
+		if ( ip->protocol == IPPROTO_TCP ) {
+			struct tcphdr *tcp = (struct tcphdr*)( (uint8_t*)ip + (ip->ihl << 2) );
+
+			uint16_t tcpoffset = ((uint8_t*)tcp-(uint8_t*)eth);
+			datalen = pktlen - (tcpoffset+TCPHDR_SIZE);
+
+			#ifdef __ASOCK_DBG_TCP__
+			Serial.print("tcp: src ");
+			Serial.print(ntohs(tcp->source),DEC);
+			Serial.print(" dst ");
+			Serial.println(ntohs(tcp->dest),DEC);
+			Serial.print(" flags ");
+			Serial.print(tcp->flags,HEX);
+			Serial.print(" pktlen ");
+			Serial.println(pktlen,DEC);
+			Serial.print(" check ");
+			Serial.print(OnChipChecksum(enc28j60_ReceivedPktAddr(),IPPROTO_TCP,datalen),HEX);
+			Serial.print(' ');
+			Serial.println(tcp->check,HEX);
+			#endif
+
+			if ( OnChipChecksum(enc28j60_ReceivedPktAddr(),IPPROTO_TCP,datalen) != tcp->check ) return;
+
+			// segments for no socket, and syns while every socket is busy, are
+			// dropped, the peer sends them again
+			aSocket *s = Find( IPPROTO_TCP, tcp->dest, ip->saddr, tcp->source );
+			if ( s ) s->TcpInput( eth, ip, tcp, pktlen );
+		}
 #else
 		{ }
 #endif
-		}
-
-		enc28j60_FreeReceivedPkt();
 	}
 }
 
 // --------------- public members
 
 aSocket::aSocket( ) {
+
+	// the first free entry
+	for ( slot = 0 ; slot < ASOCKET_MAX && table[slot] ; slot++ );
+
+	if ( slot < ASOCKET_MAX ) table[slot] = this;
+
+	protocol = 0;
+	port = 0;
+	constate = ASOCK_CLOSED;
+	evflags = 0;
+
+#ifdef ASOCKET_COMPILE_TCP
+	seq_adv = 0;
+#endif
+	txlen = 0;
+	txpush = 0;
+	availdata = 0;
+
+	peeripaddr = INADDR_NONE;
+	peerport = 0;
+}
+
+aSocket::~aSocket( ) {
+
+	if ( slot < ASOCKET_MAX ) table[slot] = NULL;
+}
+
+// Whether the socket has a part of the buffers, they are split between
+// the sockets there are the first time one opens
+uint8_t aSocket::Open() {
+
+	if ( slot == ASOCKET_MAX ) return 0;
+
+	if ( !parts ) {
+		for ( uint8_t i = 0 ; i < ASOCKET_MAX ; i++ ) if ( table[i] ) parts = i+1;
+
+		rxsize = RXBUFSIZE / parts;
+		txsize = TXBUFSIZE / parts;
+	}
+
+return slot < parts;
 }
 
 void aSocket::setup( uint32_t ip, uint8_t hwa[ETH_ALEN], uint8_t mask, uint32_t gw ) {
@@ -553,28 +803,53 @@ void aSocket::setup( uint32_t ip, uint8_t hwa[ETH_ALEN], uint8_t mask, uint32_t
 #endif
 }
 
-uint32_t aSocket::listen( uint16_t portnum, uint8_t prot ) {
+void aSocket::poll() {
+
+	uint16_t pktlen;
+
+	// a few packets at a time, the timers must run under load too
+	for ( uint8_t n = 0 ; n < 8 && (pktlen = enc28j60_ReceivePkt()) ; n++ ) {
+
+		HandlePacket( pktlen );
+		enc28j60_FreeReceivedPkt();
+	}
+
+	for ( uint8_t i = 0 ; i < ASOCKET_MAX ; i++ ) if ( table[i] ) table[i]->Timer();
+}
+
+uint32_t aSocket::listen( uint16_t portnum, uint8_t prot, uint8_t flags ) {
+
+	if ( !Open() ) return INADDR_NONE;
 
 	port = portnum;
 	protocol = prot;
-	constate = ASOCK_LISTEN;
+	peeripaddr = INADDR_NONE;
 
 #ifdef ASOCKET_COMPILE_TCP
 	seq = 0;
 	seq_adv = 0;
 	ack = 0;
 #endif
+	txlen = 0;
+	txpush = 0;
 	availdata = 0;
+	evflags = 0;
+	constate = ASOCK_LISTEN;
+
+	if ( flags & ASOCKET_NOWAIT ) return INADDR_NONE;
 
-	while ( constate == ASOCK_LISTEN ) HandleInetStack(ASOCKET_CONTO);
+	while ( constate == ASOCK_LISTEN ) poll();
 
 	if ( constate != ASOCK_ESTABLISHED ) close();
 
 return peeripaddr;
 }
 
-uint8_t aSocket::connect( uint32_t ip, uint16_t portnum, uint8_t prot ) {
+uint8_t aSocket::connect( uint32_t ip, uint16_t portnum, uint8_t prot, uint8_t flags ) {
 
+	if ( !Open() ) return 1;
+
+	peeripaddr = ip;
 	peerport = portnum;
 	protocol = prot;
 
@@ -587,83 +862,47 @@ uint8_t aSocket::connect( uint32_t ip, uint16_t portnum, uint8_t prot ) {
 	seq_adv = 0;
 	ack = 0;
 #endif
+	txlen = 0;
+	txpush = 0;
 	availdata = 0;
+	evflags = 0;
+	retries = 0;
 	constate = ASOCK_QUERYARP;
 
-	while ( 1 ) {
-
-		// while doing assignment here we will optimize code size
-		peeripaddr = ip;
-
-		switch ( constate ) {
-
-		case ASOCK_QUERYARP:
-
-			// do we need to use gateway?
-			if ( subnet(ipaddr) != subnet(peeripaddr) ) peeripaddr = gatewayip;
-
-			for ( uint8_t counter = 0 ; counter < ASOCKET_RETRIES && constate == ASOCK_QUERYARP ; counter++ ) {
-
-				QueryARP();
-				HandleInetStack(ASOCKET_REQTO);
-			}
-
-			if ( constate == ASOCK_QUERYARP ) constate = ASOCK_CLOSED;
-
-		break;
-
-		case ASOCK_INIT:
-#ifdef ASOCKET_COMPILE_UDP
-			if ( protocol == IPPROTO_UDP ) {
-				constate = ASOCK_ESTABLISHED;
-				break;
-			}
-#endif
-#ifdef ASOCKET_COMPILE_TCP
-			for ( uint8_t counter = 0 ; counter < ASOCKET_RETRIES && constate == ASOCK_INIT ; counter++ ) {
+	QueryARP();
 
-				SendTCPSYN();
-				HandleInetStack(ASOCKET_REQTO);
-			}
+	if ( flags & ASOCKET_NOWAIT ) return 0;
 
-			if ( constate == ASOCK_INIT ) constate = ASOCK_CLOSED;
+	while ( constate == ASOCK_QUERYARP || constate == ASOCK_INIT ) poll();
 
-		break;
-#endif
-		case ASOCK_ESTABLISHED:
-		return 0;
+	if ( constate == ASOCK_ESTABLISHED ) return 0;
 
-		case ASOCK_CLOSED:
-			close();
-		return 1;
-		}
-	}
+	close();
 
 return 1;
 }
 
 uint16_t aSocket::available() {
 
-	HandleInetStack(1);
-
-	if ( constate != ASOCK_ESTABLISHED ) close();
+	poll();
 
 return availdata;
 }
 
 uint8_t* aSocket::read( uint16_t *datasize ) {
 
-	if ( *datasize > ASOCKET_BUFSIZE ) *datasize = ASOCKET_BUFSIZE;
+	// one byte less, ReadBuffer terminates the data with zero
+	if ( *datasize > ASOCKET_BUFSIZE-1 ) *datasize = ASOCKET_BUFSIZE-1;
 
 	// invoking available() will read possible pendings
 	if ( *datasize > available() ) *datasize = availdata;
 
 	if ( *datasize ) {
 	
-		enc28j60_ReadMem( RXBUFFER, pktbuf, *datasize );
+		enc28j60_ReadMem( RxBuffer(), pktbuf, *datasize );
 
 		availdata -= *datasize;
-		if ( availdata ) enc28j60_CopyMem( RXBUFFER+*datasize, RXBUFFER, availdata );
+		if ( availdata ) enc28j60_CopyMem( RxBuffer()+*datasize, RxBuffer(), availdata );
 		
 	return pktbuf;
 	}
@@ -673,87 +912,34 @@ return NULL;
 
 uint16_t aSocket::write( uint8_t *data, uint16_t datasize, uint8_t flags ) {
 
-	static uint16_t dataoff = 0;
-
 	if ( constate != ASOCK_ESTABLISHED ) return 0;
-	
-	if ( !dataoff ) {
-	
-		// create new packet
-		dataoff = ETHHDR_SIZE + IPHDR_SIZE + ((protocol == IPPROTO_TCP) ? TCPHDR_SIZE : UDPHDR_SIZE);
-		enc28j60_NewPacket( dataoff );
-	}
 
-	// adjust packet size
-	if ( (dataoff+datasize) > MAX_FRAMELEN ) {
-		datasize = MAX_FRAMELEN - dataoff;
+	// take what fits in the buffer
+	if ( datasize > txsize-txlen ) {
+		datasize = txsize-txlen;
 
-		// packet oversized, send it immediately
+		// buffer full, send it immediately
 		flags &= ~ASOCKET_MORE_DATA;
 	}
 
 	if ( datasize ) {
-		enc28j60_SetNewPacketLen( dataoff+datasize );
-		enc28j60_WritePacketData(dataoff,data,datasize, (flags&ASOCKET_PGM_DATA) );
+		if ( flags & ASOCKET_PGM_DATA )
+			enc28j60_WritePGMMem( TxBuffer()+txlen, data, datasize );
+		else
+			enc28j60_WriteMem( TxBuffer()+txlen, data, datasize );
 
-		dataoff += datasize;
+		txlen += datasize;
 	}
 
 	// wait for more data
 	if ( flags & ASOCKET_MORE_DATA ) return datasize;
-	
-	MakeEth( (struct ethhdr*)pktbuf, ETH_P_IP );
-	MakeIp( (struct iphdr*)(pktbuf+ETHHDR_SIZE), dataoff-ETHHDR_SIZE, protocol );
-	
-	uint16_t datalen;
-
-	if ( protocol == IPPROTO_TCP ) {
-#ifdef ASOCKET_COMPILE_TCP
-		datalen = dataoff - ETHHDR_SIZE - IPHDR_SIZE - TCPHDR_SIZE;
-
-		MakeTcp( (struct tcphdr*)(pktbuf+ETHHDR_SIZE+IPHDR_SIZE), TCP_FLAG_PSH|TCP_FLAG_ACK, datalen, ASOCKET_NOFLAGS );
-		enc28j60_WritePacketData(0,pktbuf,ETHHDR_SIZE+IPHDR_SIZE+TCPHDR_SIZE, 0 );
-#endif
-	} else {
-#ifdef ASOCKET_COMPILE_UDP
-		datalen = dataoff - ETHHDR_SIZE - IPHDR_SIZE - UDPHDR_SIZE;
-
-		MakeUdp( (struct udphdr*)(pktbuf+ETHHDR_SIZE+IPHDR_SIZE), datalen, ASOCKET_NOFLAGS );
-		enc28j60_WritePacketData(0,pktbuf,ETHHDR_SIZE+IPHDR_SIZE+UDPHDR_SIZE, 0 );
-#endif
-	}
-
-	OnChipChecksum( enc28j60_NewPktAddr(), protocol, datalen );
-	seq_adv = datalen;
-
-	uint8_t counter = 0;
-	for ( ; counter < ASOCKET_RETRIES && constate == ASOCK_ESTABLISHED ; counter++ ) {
-
-		enc28j60_SendNewPacket();
 
-		if ( protocol == IPPROTO_TCP ) {
-#ifdef ASOCKET_COMPILE_TCP
-
-			uint32_t initialseq = seq;
-			HandleInetStack(ASOCKET_REQTO);		// wait for ack
-
-			if ( seq == IncNetNum(initialseq,seq_adv) ) break;
-			
-			// no ack received, loop back for retransmission
-#endif
-		} else {
-#ifdef ASOCKET_COMPILE_UDP
-			break;
-#endif
-		}
-	}
+	// it goes out now unless a segment is in flight, then once that is acked
+	txpush = 1;
+	Timer();
 
-	dataoff = 0;
-	seq_adv = 0;
-
-	if ( constate != ASOCK_ESTABLISHED || counter == ASOCKET_RETRIES ) {
-		close();
-	}
+	if ( !(flags & ASOCKET_NOWAIT) )
+		while ( txlen && constate == ASOCK_ESTABLISHED ) poll();
 
 return datasize;
 }
@@ -768,8 +954,13 @@ void aSocket::close() {
 		MakeTcp( (struct tcphdr*)(pktbuf+ETHHDR_SIZE+IPHDR_SIZE), TCP_FLAG_RST|TCP_FLAG_ACK, 0, ASOCKET_CHECKSUM );
 		DispatchPacket( ETHHDR_SIZE+IPHDR_SIZE+TCPHDR_SIZE );
 	}
+
+	seq_adv = 0;
 #endif
-	constate = ASOCK_CLOSED;
+	txlen = 0;
+	txpush = 0;
+
+	SetState( ASOCK_CLOSED );
 	peeripaddr = INADDR_NONE;
 	peerport = 0;
-}
\ No newline at end of file
+}
@@ -11,6 +11,33 @@
 	Copyright: GPL V2 (http://www.gnu.org/licenses/gpl.html)
 		  
 	TODO: TCP and UDP checksum for received packets?
+
+	Up to ASOCKET_MAX sockets are served at once, each aSocket object
+	takes an entry of the table when it is constructed and gives it back
+	when it is destroyed.  Every socket has its own part of the receive
+	and transmit buffers on the chip, and keeps one segment in flight
+	with its own retransmission timer.  The buffers are split evenly
+	between the sockets there are when the first listen() or connect()
+	is made, a sketch with one socket has them whole.  Sockets created
+	after that only open in the entry of one that was destroyed.
+
+	listen(), connect() and write() wait as before unless given
+	ASOCKET_NOWAIT, then connect() returns 0 once it has started and
+	write() takes what fits in the buffer.  Call aSocket::poll() often, it
+	reads what came in for all the sockets and runs their timers, and
+	check state() or events() for what happened:
+
+		aSocket web[2], up;
+
+		web[0].listen( htons(80), IPPROTO_TCP, ASOCKET_NOWAIT );
+		web[1].listen( htons(80), IPPROTO_TCP, ASOCKET_NOWAIT );
+		up.connect( server, htons(5000), IPPROTO_TCP, ASOCKET_NOWAIT );
+
+		for (;;) {
+			aSocket::poll();
+			if ( web[0].events() & ASOCK_EV_DATA ) ...
+			if ( up.events() & ASOCK_EV_ACKED ) up.write( ..., ASOCKET_NOWAIT );
+		}
 */
 
 #ifndef __ASOCKET_H__
@@ -19,9 +46,11 @@
 #define ASOCKET_COMPILE_UDP
 #define ASOCKET_COMPILE_TCP
 
+#define ASOCKET_MAX		4			// sockets at once
 #define ASOCKET_BUFSIZE	160
 #define ASOCKET_CONTO		30000		// time out for whole connection
 #define ASOCKET_REQTO		3000			// time out for various requests
+#define ASOCKET_RTO		500			// first retransmission time out, doubled for each retry
 #define ASOCKET_RETRIES	3
 
 #define ASOCKET_NOFLAGS		0x0
@@ -29,6 +58,13 @@
 #define ASOCKET_MORE_DATA	0x2
 #define ASOCKET_TCP_OPT		0x4
 #define ASOCKET_CHECKSUM	0x8
+#define ASOCKET_NOWAIT		0x10		// listen, connect and write return at once
+
+// what happened since events() was called last
+#define ASOCK_EV_ESTABLISHED	0x1
+#define ASOCK_EV_DATA			0x2
+#define ASOCK_EV_ACKED			0x4		// all data written was acked
+#define ASOCK_EV_CLOSED		0x8
 
 #include <inttypes.h>
 #include <avr/pgmspace.h>
@@ -56,32 +92,46 @@ typedef enum constate_e {
 
 class aSocket {
 
+	// interface, shared by all sockets (network order)
+	static uint8_t		hwaddr[ETH_ALEN];
+	static uint32_t	ipaddr;
+	static uint8_t		netmask;
+	static uint32_t	gatewayip;
+
+	static uint8_t		pktbuf[ASOCKET_BUFSIZE];
+
+	static aSocket		*table[ASOCKET_MAX];
+	static uint8_t		parts;			// the buffers are split in, 0 until a socket opens
+	static uint16_t	rxsize;			// buffers on the chip of each socket
+	static uint16_t	txsize;
+
 	// transmission control block, all of those data are in network order (big endian)
-	uint8_t		hwaddr[ETH_ALEN];
-	uint32_t	ipaddr;
-	uint8_t		netmask;
+	uint8_t		slot;			// entry in table, ASOCKET_MAX if none
 	uint16_t	port;
 
-	uint32_t	gatewayip;
-
 	uint8_t		peerhwaddr[ETH_ALEN];
 	uint32_t	peeripaddr;
 	uint16_t	peerport;
 
 	uint8_t		protocol;
 	constate_t	constate;
+	uint8_t		evflags;
 
 #ifdef ASOCKET_COMPILE_TCP
-	uint32_t	seq;
-	uint16_t	seq_adv;		// expected advance for seq number
+	uint32_t	seq;			// oldest byte not acked
+	uint16_t	seq_adv;		// bytes sent and not acked
 	uint32_t	ack;
 #endif
 
+	uint16_t	txlen;			// bytes in the transmit buffer, including seq_adv
+	uint8_t		txpush;			// send them as soon as nothing is in flight
 	uint16_t	availdata;
-	uint8_t		pktbuf[ASOCKET_BUFSIZE];
 
-	void MakeEthReply( struct ethhdr *eth );
-	void MakeIpReply( struct iphdr *ip, uint16_t tot_len );
+	uint32_t	timer;			// when the last request or segment was sent
+	uint8_t		retries;
+
+	static void MakeEthReply( struct ethhdr *eth );
+	static void MakeIpReply( struct iphdr *ip, uint16_t tot_len );
 
 	void MakeEth( struct ethhdr *eth, uint16_t h_proto );
 	void MakeIp( struct iphdr *ip, uint16_t tot_len, uint8_t protocol );
@@ -90,33 +140,53 @@ class aSocket {
 	void MakeTcp( struct tcphdr *tcp, uint8_t tcpflags, uint16_t datalen, uint8_t flags );
 
 	void InitSEQ();
-	uint32_t IncNetNum( uint32_t &num, uint16_t addval );
+	uint32_t IncNetNum( uint32_t num, uint16_t addval );
 	void SendTCPSYN();
+	void TcpReply( struct ethhdr *eth, struct iphdr *ip, struct tcphdr *tcp, uint8_t tcpflags, uint8_t flags );
+	void TcpInput( struct ethhdr *eth, struct iphdr *ip, struct tcphdr *tcp, uint16_t pktlen );
+	void Acked( uint16_t len );
 #endif
 
 #ifdef ASOCKET_COMPILE_UDP
 	void MakeUdp( struct udphdr *udp, uint16_t datalen, uint8_t flags );
 #endif
 
-	uint16_t OnChipChecksum( uint16_t pktaddr, uint8_t prot, uint16_t datalen );
-	void DispatchPacket( uint16_t pktlen );
+	static uint16_t OnChipChecksum( uint16_t pktaddr, uint8_t prot, uint16_t datalen );
+	static void DispatchPacket( uint16_t pktlen );
+
+	static void copyhwa( uint8_t *srchwa, uint8_t *dsthwa );
+	static uint32_t subnet( uint32_t ip );
 
-	void copyhwa( uint8_t *srchwa, uint8_t *dsthwa );
-	uint32_t subnet( uint32_t ip );
+	uint16_t RxBuffer() { return RXBUFFER + slot*rxsize; }
+	uint16_t TxBuffer() { return TXBUFFER + slot*txsize; }
 
+	uint8_t Open();
+	void SetState( constate_t cs );
+	uint32_t ArpTarget();
 	void QueryARP();
+	void SendData( uint16_t datalen );
+	void Timer();
+
+	static aSocket* Find( uint8_t prot, uint16_t dport, uint32_t sip, uint16_t sport );
+	static void HandlePacket( uint16_t pktlen );
 
-	void HandleInetStack( uint32_t timeout );
+	// a copy would share the table entry and the buffers
+	aSocket( const aSocket & );
+	aSocket& operator=( const aSocket & );
 
 public:
     aSocket( void );
+    ~aSocket( void );
 
 	constate_t state() { return constate; }
 
+	// returns the ASOCK_EV_ flags set since the last call and clears them
+	uint8_t events() { uint8_t ev = evflags; evflags = 0; return ev; }
+
 	void setup( uint32_t ip, uint8_t hwa[ETH_ALEN], uint8_t mask, uint32_t gw );
 
-	uint32_t listen( uint16_t portnum, uint8_t prot );
-	uint8_t connect( uint32_t ip, uint16_t portnum, uint8_t prot );
+	uint32_t listen( uint16_t portnum, uint8_t prot, uint8_t flags = ASOCKET_NOFLAGS );
+	uint8_t connect( uint32_t ip, uint16_t portnum, uint8_t prot, uint8_t flags = ASOCKET_NOFLAGS );
 
 	void flush() { availdata = 0; }
 	uint16_t available();
@@ -124,6 +194,9 @@ public:
 	uint16_t write( uint8_t *data, uint16_t datasize, uint8_t flags );
 
 	void close();
+
+	// handles the packets received and the timers of all sockets
+	static void poll();
 };
 
 #endif * __ASOCKET_H__ */
\ No newline at end of file
@@ -366,6 +366,14 @@ void enc28j60_WriteMem( uint16_t addr, uint8_t *data, uint16_t dlen ) {
 	enc28j60WriteBuffer(dlen,data);
 }
 
+void enc28j60_WritePGMMem( uint16_t addr, uint8_t *data, uint16_t dlen ) {
+
+	enc28j60Write(EWRPTL, addr&0xff);
+	enc28j60Write(EWRPTH, addr>>8);
+
+	enc28j60WritePGMBuffer(dlen,data);
+}
+
 void enc28j60_ReadMem( uint16_t addr, uint8_t *data, uint16_t dlen ) {
 
 	enc28j60Write(ERDPTL, addr&0xff);
@@ -374,12 +382,23 @@ void enc28j60_ReadMem( uint16_t addr, uint8_t *data, uint16_t dlen ) {
 	enc28j60ReadBuffer(dlen, data);
 }
 
+// Address in the receive ring that addr, counted on from a packet
+// near the end, comes to
+uint16_t enc28j60_RxWrap( uint16_t addr ) {
+
+	if ( addr > RXSTOP_INIT ) addr -= RXSTOP_INIT-RXSTART_INIT+1;
+
+return addr;
+}
+
 void enc28j60_CopyMem( uint16_t saddr, uint16_t daddr, uint16_t len ) {
 
 	enc28j60Write(EDMASTL, saddr&0xff);
 	enc28j60Write(EDMASTH, saddr>>8);
 
-	saddr += (len-1);		// the EDMAND registers should point to the last byte
+	// the EDMAND registers should point to the last byte, the DMA wraps
+	// within the receive ring by itself
+	saddr = (saddr <= RXSTOP_INIT) ? enc28j60_RxWrap(saddr+len-1) : saddr+len-1;
 	enc28j60Write(EDMANDL, saddr&0xff);
 	enc28j60Write(EDMANDH, saddr>>8);
 
@@ -411,7 +430,8 @@ uint16_t enc28j60_checksum( uint16_t addr, uint16_t len ) {
 	enc28j60Write(EDMASTL, addr&0xff);
 	enc28j60Write(EDMASTH, addr>>8);
 
-	addr += (len-1);		// the EDMAND registers should point to the last byte
+	// the EDMAND registers should point to the last byte
+	addr = (addr <= RXSTOP_INIT) ? enc28j60_RxWrap(addr+len-1) : addr+len-1;
 	enc28j60Write(EDMANDL, addr&0xFF);
 	enc28j60Write(EDMANDH, addr>>8);
 
@@ -442,8 +462,8 @@ uint16_t enc28j60_ReceivePkt( void ) {
 	// The above does not work. See Rev. B4 Silicon Errata point 6.
 	if( enc28j60Read(EPKTCNT) == 0 ) return 0;
 
-	enc28j60Write(ERDPTL, (NextPacketPtr+2)&0xff);
-	enc28j60Write(ERDPTH, (NextPacketPtr+2)>>8);
+	enc28j60Write(ERDPTL, enc28j60_RxWrap(NextPacketPtr+2)&0xff);
+	enc28j60Write(ERDPTH, enc28j60_RxWrap(NextPacketPtr+2)>>8);
 
 	// read the packet length (see datasheet page 43)
 	pktlen  = enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0);
@@ -457,8 +477,9 @@ uint16_t enc28j60_ReceivePkt( void ) {
 	// check CRC and symbol errors (see datasheet page 44, table 7-3):
 	// The ERXFCON.CRCEN is set by default. Normally we should not
 	// need to check this.
-	if ( (rxstat & 0x80)==0 ){
-		// invalid
+	if ( (rxstat & 0x80)==0 || pktlen > MAX_FRAMELEN ){
+		// invalid, drop it
+		enc28j60_FreeReceivedPkt();
 		return 0;
 	}
 
@@ -466,15 +487,15 @@ return pktlen;
 }
 
 uint16_t enc28j60_ReceivedPktAddr() {
-	return (NextPacketPtr+6);
+	return enc28j60_RxWrap(NextPacketPtr+6);
 }
 
 uint16_t enc28j60_ReceivedPktLen() {
 
 	uint16_t pktlen;
 
-	enc28j60Write(ERDPTL, (NextPacketPtr+2)&0xff);
-	enc28j60Write(ERDPTH, (NextPacketPtr+2)>>8);
+	enc28j60Write(ERDPTL, enc28j60_RxWrap(NextPacketPtr+2)&0xff);
+	enc28j60Write(ERDPTH, enc28j60_RxWrap(NextPacketPtr+2)>>8);
 
 	pktlen  = enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0);
 	pktlen |= enc28j60ReadOp(ENC28J60_READ_BUF_MEM, 0)<<8;
@@ -486,7 +507,7 @@ return pktlen;
 void enc28j60_ReadPacketData( uint16_t offset, uint8_t* data, uint16_t dlen ) {
 
 	if ( offset < MAX_FRAMELEN ) {
-		offset += (NextPacketPtr + 6);
+		offset = enc28j60_RxWrap(offset + NextPacketPtr + 6);
 
 		enc28j60Write(ERDPTL, offset&0xFF);
 		enc28j60Write(ERDPTH, offset>>8);
@@ -518,6 +539,13 @@ void enc28j60_FreeReceivedPkt( void ) {
 
 uint16_t enc28j60_NewPacket( uint16_t len ) {
 
+	// the frame sent before must be out before the buffer is written
+	while ( enc28j60Read(ECON1) & ECON1_TXRTS ) {
+		// See Rev. B4 Silicon Errata point 12.
+		if ( enc28j60Read(EIR) & EIR_TXERIF )
+			enc28j60WriteOp(ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRTS);
+	}
+
 	// Set the write pointer to start of transmit buffer area
 	enc28j60Write(EWRPTL, TXSTART_INIT&0xFF);
 	enc28j60Write(EWRPTH, TXSTART_INIT>>8);
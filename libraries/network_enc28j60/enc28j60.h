@@ -250,10 +250,13 @@
 // start with recbuf at 0/
 #define RXSTART_INIT     0x0
 // receive buffer end
-#define RXSTOP_INIT      (0x1FFF-(0x0600<<1)-1)	// note: make also buffer for tcp/udp data
+#define RXSTOP_INIT      (0x1FFF-0x0600-RXBUFSIZE-TXBUFSIZE-2)	// odd, make also buffers for tcp/udp data
 
-#define RXBUFFER			RXSTOP_INIT+1
+// received data and data not acked yet, split between the sockets
+#define RXBUFFER			(RXSTOP_INIT+1)
 #define RXBUFSIZE		0x0600
+#define TXBUFFER			(RXBUFFER+RXBUFSIZE)
+#define TXBUFSIZE		0x0860
 
 // start TX buffer at 0x1FFF-0x0600, space for one full ethernet frame (~1500 bytes)
 #define TXSTART_INIT     (0x1FFF-0x0600)
@@ -285,10 +288,12 @@ extern uint8_t enc28j60getrev(void);
 // Newly added functions (Adrian Brzezinski)
 
 void enc28j60_WriteMem( uint16_t addr, uint8_t *data, uint16_t dlen );
+void enc28j60_WritePGMMem( uint16_t addr, uint8_t *data, uint16_t dlen );
 void enc28j60_ReadMem( uint16_t addr, uint8_t *data, uint16_t dlen );
 void enc28j60_CopyMem( uint16_t saddr, uint16_t daddr, uint16_t len );
 uint16_t enc28j60_checksum( uint16_t addr, uint16_t len );
 
+uint16_t enc28j60_RxWrap( uint16_t addr );
 uint16_t enc28j60_ReceivePkt( void );
 uint16_t enc28j60_ReceivedPktAddr();
 uint16_t enc28j60_ReceivedPktLen();
@@ -0,0 +1,176 @@
+// Enc28j60Sim - register level model of the ENC28J60, see Enc28j60Sim.h
+
+#include <string.h>
+#include "Enc28j60Sim.h"
+
+std::vector<std::vector<uint8_t> > Enc28j60Sim::sent;
+unsigned long Enc28j60Sim::spiBytes;
+unsigned long Enc28j60Sim::txOverwrites;
+unsigned long Enc28j60Sim::rxDrops;
+
+// bank 0 pointers, low byte first
+enum { ERDPT = 0x00, EWRPT = 0x02, ETXST = 0x04, ETXND = 0x06, ERXST = 0x08, ERXND = 0x0A,
+       ERXRDPT = 0x0C, EDMAST = 0x10, EDMAND = 0x12, EDMADST = 0x14, EDMACS = 0x16 };
+// in every bank
+enum { ECON2 = 0x1E, ECON1 = 0x1F };
+enum { ECON1_CSUMEN = 0x10, ECON1_DMAST = 0x20, ECON1_TXRTS = 0x08, ECON2_PKTDEC = 0x40,
+       ECON2_AUTOINC = 0x80 };
+// bank 1
+enum { EPKTCNT = 0x19 };
+
+enum { RCR = 0x00, RBM = 0x20, WCR = 0x40, WBM = 0x60, BFS = 0x80, BFC = 0xA0, SRC = 0xFF };
+
+static uint8_t mem[8192];
+static uint8_t reg[4][32];
+static int state = -1, op, address;   // state -1 deselected, 0 expects an opcode
+static int txReads;                   // ECON1 reads until the transmission is done
+static uint16_t rxWrite;
+static uint8_t packets;
+
+static uint8_t & R(int bank, int a) { return a >= 0x1B ? reg[0][a] : reg[bank][a]; }
+static uint16_t get16(int a) { return reg[0][a] | reg[0][a + 1] << 8; }
+static void set16(int a, uint16_t v) { reg[0][a] = v; reg[0][a + 1] = v >> 8; }
+static int bank() { return reg[0][ECON1] & 3; }
+static uint16_t rxStart() { return get16(ERXST); }
+static uint16_t rxEnd() { return get16(ERXND); }
+static uint16_t rxNext(uint16_t a) { return a == rxEnd() ? rxStart() : (a + 1) & 0x1FFF; }
+static bool inRx(uint16_t a) { return a >= rxStart() && a <= rxEnd(); }
+
+static void completeTransmit() {
+  uint16_t start = get16(ETXST), end = get16(ETXND);
+  // the control byte is not sent, the status vector follows the frame
+  Enc28j60Sim::sent.push_back(std::vector<uint8_t>(mem + start + 1, mem + end + 1));
+  for (int i = 1; i <= 7; i++)
+    mem[(end + i) & 0x1FFF] = 0xEE;
+  reg[0][ECON1] &= ~ECON1_TXRTS;
+  txReads = 0;
+}
+
+// copy or checksum, reading through the receive ring wrap like the chip
+static void dma() {
+  uint16_t a = get16(EDMAST), end = get16(EDMAND), dst = get16(EDMADST);
+  bool wrap = inRx(a);
+  if (reg[0][ECON1] & ECON1_CSUMEN) {
+    uint32_t sum = 0;
+    for (int n = 0; ; n++) {
+      sum += (n & 1) ? mem[a] : mem[a] << 8;
+      if (a == end)
+        break;
+      a = wrap ? rxNext(a) : (a + 1) & 0x1FFF;
+    }
+    while (sum >> 16)
+      sum = (sum & 0xFFFF) + (sum >> 16);
+    set16(EDMACS, ~sum);
+  } else {
+    for (;;) {
+      mem[dst] = mem[a];
+      dst = (dst + 1) & 0x1FFF;
+      if (a == end)
+        break;
+      a = wrap ? rxNext(a) : (a + 1) & 0x1FFF;
+    }
+  }
+  reg[0][ECON1] &= ~ECON1_DMAST;
+}
+
+static void written(int a) {
+  if (a == ECON1) {
+    if (reg[0][ECON1] & ECON1_DMAST)
+      dma();
+    if ((reg[0][ECON1] & ECON1_TXRTS) && !txReads)
+      txReads = 3;
+  }
+  if (a == ECON2 && (reg[0][ECON2] & ECON2_PKTDEC)) {
+    if (packets)
+      packets--;
+    reg[0][ECON2] &= ~ECON2_PKTDEC;
+  }
+}
+
+void Enc28j60Sim::select(bool low) {
+  state = low ? 0 : -1;
+}
+
+uint8_t Enc28j60Sim::transfer(uint8_t b) {
+  spiBytes++;
+  if (state < 0)
+    return 0;
+  if (state == 0) {
+    state = 1;
+    if (b == SRC) {
+      memset(reg, 0, sizeof(reg));
+      reg[0][ECON2] = ECON2_AUTOINC;
+      return 0;
+    }
+    op = b & 0xE0;
+    address = b & 0x1F;
+    return 0;
+  }
+
+  int bk = bank();
+  reg[1][EPKTCNT] = packets;
+  switch (op) {
+  case RCR:
+    if (address == ECON1 && txReads && --txReads == 0)
+      completeTransmit();
+    return R(bk, address);
+  case RBM: {
+    uint16_t p = get16(ERDPT);
+    uint8_t v = mem[p];
+    set16(ERDPT, inRx(p) ? rxNext(p) : (p + 1) & 0x1FFF);
+    return v;
+  }
+  case WCR:
+    R(bk, address) = b;
+    written(address);
+    return 0;
+  case WBM: {
+    uint16_t p = get16(EWRPT);
+    if (txReads && p >= get16(ETXST) && p <= get16(ETXND) + 7)
+      txOverwrites++;
+    mem[p] = b;
+    set16(EWRPT, (p + 1) & 0x1FFF);
+    return 0;
+  }
+  case BFS:
+    R(bk, address) |= b;
+    written(address);
+    return 0;
+  case BFC:
+    R(bk, address) &= ~b;
+    written(address);
+    return 0;
+  }
+  return 0;
+}
+
+bool Enc28j60Sim::receive(const uint8_t * frame, uint16_t len) {
+  // next packet pointer, byte count and status ahead of the frame, the
+  // CRC after it, and the next frame starting on an even address
+  uint16_t size = 6 + len + 4;
+  size += size & 1;
+  uint16_t span = rxEnd() - rxStart() + 1;
+  uint16_t used = (rxWrite + span - get16(ERXRDPT)) % span;
+  if (used + size >= span) {
+    rxDrops++;
+    return false;
+  }
+  uint16_t next = rxWrite;
+  for (int i = 0; i < size; i++)
+    next = rxNext(next);
+  uint8_t header[6] = { (uint8_t) next, (uint8_t) (next >> 8), (uint8_t) (len + 4),
+                        (uint8_t) ((len + 4) >> 8), 0x80, 0 };
+  uint16_t a = rxWrite;
+  for (int i = 0; i < size; i++) {
+    mem[a] = i < 6 ? header[i] : i < 6 + len ? frame[i - 6] : 0xCC;
+    a = rxNext(a);
+  }
+  rxWrite = next;
+  packets++;
+  return true;
+}
+
+void Enc28j60Sim::finishTransmit() {
+  if (txReads)
+    completeTransmit();
+}
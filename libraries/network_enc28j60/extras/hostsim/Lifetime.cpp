@@ -0,0 +1,43 @@
+/*
+ Lifetime - sockets created and destroyed around the buffer split
+
+ The split is made for the sockets there are at the first listen(); a
+ socket destroyed after that gives its entry to the next one created,
+ and a socket beyond the split does not open.
+ */
+
+#include "LinkSim.h"
+#include <WProgram.h>
+#include "aSocket.h"
+
+static uint8_t hwaddr[6] = { 0x01, 0x02, 0x03, 0x10, 0x00, 0x09 };
+
+int main() {
+  int bad = 0;
+
+  enc28j60Init(hwaddr);
+  aSocket a, * b = new aSocket;
+  a.setup(htonl(SRV_IP), hwaddr, 24, htonl(0x0A000001));
+  b->listen(htons(81), IPPROTO_TCP, ASOCKET_NOWAIT);
+  if (b->state() != ASOCK_LISTEN)
+    bad++;
+  delete b;
+
+  // no timer may run for the destroyed socket
+  for (int i = 0; i < 100; i++)
+    aSocket::poll();
+
+  aSocket c, d;                 // c takes b's entry, d is past the split
+  c.listen(htons(82), IPPROTO_TCP, ASOCKET_NOWAIT);
+  if (c.state() != ASOCK_LISTEN)
+    bad++;
+  d.listen(htons(83), IPPROTO_TCP, ASOCKET_NOWAIT);
+  if (d.state() == ASOCK_LISTEN)
+    bad++;
+  a.listen(htons(80), IPPROTO_TCP, ASOCKET_NOWAIT);
+  if (a.state() != ASOCK_LISTEN)
+    bad++;
+
+  printf("%s\n", bad ? "lifetime FAILED" : "lifetime ok");
+  return bad;
+}
@@ -0,0 +1,333 @@
+/*
+ LinkSim - the network on the other side of the ENC28J60 model
+
+ Frames the chip sends go to simulated peers after the checksums are
+ checked; frames the peers send reach the chip LINK_US later.  Each frame
+ is lost with probability lossRate in either direction.  ARP requests for
+ a peer are answered.
+
+ A client peer fetches a page over and over: SYN, a GET, then it reads
+ and checks the data until the server resets or closes, and starts the
+ next connection.  A server peer takes what a connection sends it and
+ acks it, for telemetry.
+
+ Time passes in millis(), which the library calls while it waits, and by
+ SPI_BYTE_US per SPI byte.  Every call moves the network on.
+ */
+
+#ifndef LINKSIM_H
+#define LINKSIM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <deque>
+#include "Enc28j60Sim.h"
+
+extern long long hostMicros;
+
+typedef std::vector<uint8_t> Frame;
+
+static const uint8_t SRV_MAC[6] = { 0x01, 0x02, 0x03, 0x10, 0x00, 0x09 };
+static const uint32_t SRV_IP = 0x0A000009;
+static const int LINK_US = 200;
+
+static double lossRate = 0;
+static long badChecksums, framesOut;
+
+static uint16_t csum(const uint8_t * p, int n, uint32_t sum = 0) {
+  for (int i = 0; i < n; i++)
+    sum += (i & 1) ? p[i] : p[i] << 8;
+  while (sum >> 16)
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  return ~sum;
+}
+
+static void put16(uint8_t * p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+static void put32(uint8_t * p, uint32_t v) { put16(p, v >> 16); put16(p + 2, v); }
+static uint16_t get16(const uint8_t * p) { return p[0] << 8 | p[1]; }
+static uint32_t get32(const uint8_t * p) { return (uint32_t) get16(p) << 16 | get16(p + 2); }
+
+static Frame tcpFrame(const uint8_t * mac, uint32_t ip, uint16_t sport, uint16_t dport,
+                      uint32_t seq, uint32_t ack, uint8_t flags, const uint8_t * data, int len) {
+  Frame f(54 + len);
+  uint8_t * p = &f[0];
+  memcpy(p, SRV_MAC, 6);
+  memcpy(p + 6, mac, 6);
+  put16(p + 12, 0x0800);
+  uint8_t * ipp = p + 14;
+  ipp[0] = 0x45;
+  put16(ipp + 2, 40 + len);
+  ipp[8] = 64;
+  ipp[9] = 6;
+  put32(ipp + 12, ip);
+  put32(ipp + 16, SRV_IP);
+  put16(ipp + 10, csum(ipp, 20));
+  uint8_t * t = ipp + 20;
+  put16(t, sport);
+  put16(t + 2, dport);
+  put32(t + 4, seq);
+  put32(t + 8, ack);
+  t[12] = 5 << 4;
+  t[13] = flags;
+  put16(t + 14, 1460);
+  if (len)
+    memcpy(t + 20, data, len);
+  uint32_t pseudo = 6 + 20 + len;
+  for (int i = 0; i < 8; i += 2)
+    pseudo += get16(ipp + 12 + i);
+  put16(t + 16, csum(t, 20 + len, pseudo));
+  return f;
+}
+
+static bool tcpChecksumOk(const uint8_t * p) {
+  const uint8_t * ipp = p + 14;
+  int length = get16(ipp + 2) - 20;
+  uint32_t pseudo = 6 + length;
+  for (int i = 0; i < 8; i += 2)
+    pseudo += get16(ipp + 12 + i);
+  return csum(ipp + 20, length, pseudo) == 0;
+}
+
+// frames on the wire towards the chip
+struct Pending { long long at; Frame f; };
+static std::deque<Pending> toChip;
+
+static void send(const Frame & f) {
+  if (lossRate > 0 && rand() < lossRate * RAND_MAX)
+    return;
+  Pending p = { hostMicros + LINK_US, f };
+  toChip.push_back(p);
+}
+
+enum { F_FIN = 1, F_SYN = 2, F_RST = 4, F_PSH = 8, F_ACK = 16 };
+
+struct Peer {
+  uint8_t mac[6];
+  uint32_t ip;
+  uint16_t port, srvport;
+  bool server;
+  int st;                       // 0 idle, 1 SYN sent, 2 established
+  uint32_t isn, sndNxt, sndUna, rcvNxt;
+  Frame req;
+  long long started, rtoAt, lastIn;
+  uint16_t prevPort;            // the connection before, acked as in TIME_WAIT
+  uint32_t prevSnd, prevRcv;
+  long got, expect;
+  long done, failed, bytesIn;
+  long long latSum, latMax;
+
+  void start() {
+    port++;
+    if (port < 20000)
+      port = 20000;
+    isn = rand();
+    sndNxt = isn + 1;
+    sndUna = isn;
+    got = 0;
+    st = 1;
+    started = hostMicros;
+    send(tcpFrame(mac, ip, port, srvport, isn, 0, F_SYN, 0, 0));
+    rtoAt = hostMicros + 300000;
+  }
+
+  void finish(bool ok) {
+    if (ok) {
+      long long l = hostMicros - started;
+      done++;
+      latSum += l;
+      if (l > latMax)
+        latMax = l;
+    } else {
+      failed++;
+    }
+    st = 0;
+    prevPort = port;
+    prevSnd = sndNxt;
+    prevRcv = rcvNxt;
+    if (!server)
+      start();
+  }
+
+  void input(const uint8_t * p) {
+    const uint8_t * t = p + 34;
+    int dlen = get16(p + 16) - 40 - ((t[12] >> 4) * 4 - 20);
+    const uint8_t * data = t + (t[12] >> 4) * 4;
+    uint8_t fl = t[13];
+    uint32_t seq = get32(t + 4), ack = get32(t + 8);
+
+    if (server) {
+      if (fl & F_SYN) {
+        port = get16(t);
+        isn = 7777;
+        sndNxt = isn + 1;
+        rcvNxt = seq + 1;
+        st = 2;
+        send(tcpFrame(mac, ip, srvport, port, isn, rcvNxt, F_SYN | F_ACK, 0, 0));
+        return;
+      }
+      if (st != 2 || get16(t) != port)
+        return;
+      if (fl & F_RST) {
+        st = 0;
+        return;
+      }
+      if (dlen && seq == rcvNxt) {
+        rcvNxt += dlen;
+        bytesIn += dlen;
+        done++;
+      }
+      if (dlen)
+        send(tcpFrame(mac, ip, srvport, port, sndNxt, rcvNxt, F_ACK, 0, 0));
+      return;
+    }
+
+    if (get16(t) == srvport && get16(t + 2) == prevPort && prevPort != port) {
+      if (dlen && !(fl & F_RST))
+        send(tcpFrame(mac, ip, prevPort, srvport, prevSnd, prevRcv, F_ACK, 0, 0));
+      return;
+    }
+    if (get16(t) != srvport || get16(t + 2) != port)
+      return;
+    lastIn = hostMicros;
+    if (st == 1) {
+      if ((fl & (F_SYN | F_ACK)) != (F_SYN | F_ACK) || ack != isn + 1)
+        return;
+      rcvNxt = seq + 1;
+      st = 2;
+      sndUna = isn + 1;
+      send(tcpFrame(mac, ip, port, srvport, sndNxt, rcvNxt, F_ACK | F_PSH, &req[0], req.size()));
+      sndNxt += req.size();
+      rtoAt = hostMicros + 300000;
+      return;
+    }
+    if (st != 2)
+      return;
+    if (fl & F_RST) {
+      finish(got == expect);
+      return;
+    }
+    if ((fl & F_ACK) && ack == sndNxt)
+      sndUna = ack;
+    if (fl & F_SYN) {
+      send(tcpFrame(mac, ip, port, srvport, sndNxt, rcvNxt, F_ACK, 0, 0));
+      return;
+    }
+    if (dlen && seq == rcvNxt) {
+      for (int i = 0; i < dlen; i++)
+        if (data[i] != (uint8_t) ('a' + (got + i) % 26)) {
+          fprintf(stderr, "bad data\n");
+          exit(1);
+        }
+      rcvNxt += dlen;
+      got += dlen;
+    }
+    if (dlen)
+      send(tcpFrame(mac, ip, port, srvport, sndNxt, rcvNxt, F_ACK, 0, 0));
+  }
+
+  void timer() {
+    if (server || !st || hostMicros < rtoAt)
+      return;
+    if (hostMicros - started > 5000000) {
+      finish(false);
+      return;
+    }
+    if (st == 2 && got == expect) {
+      // the reset was lost
+      if (hostMicros - lastIn > 1000000)
+        finish(true);
+      return;
+    }
+    rtoAt = hostMicros + 300000;
+    if (st == 1)
+      send(tcpFrame(mac, ip, port, srvport, isn, 0, F_SYN, 0, 0));
+    else if (sndUna != sndNxt)
+      send(tcpFrame(mac, ip, port, srvport, sndUna, rcvNxt, F_ACK | F_PSH, &req[0], req.size()));
+  }
+};
+
+static std::vector<Peer> peers;
+
+static Peer & addPeer(uint32_t ip, uint16_t srvport, bool server, long expect) {
+  Peer p = Peer();
+  uint8_t mac[6] = { 0x02, 0, 0, 0, 0, (uint8_t) ip };
+  const char * r = "GET / HTTP/1.0\r\n\r\n";
+  memcpy(p.mac, mac, 6);
+  p.ip = ip;
+  p.srvport = srvport;
+  p.server = server;
+  p.expect = expect;
+  p.port = 20000 + 1000 * (ip & 0xff);
+  p.req.assign(r, r + strlen(r));
+  peers.push_back(p);
+  return peers.back();
+}
+
+// frames from the chip to the peers, and due frames to the chip
+static void netStep() {
+  std::vector<Frame> & sent = Enc28j60Sim::sent;
+  Enc28j60Sim::finishTransmit();
+  for (size_t i = 0; i < sent.size(); i++) {
+    const uint8_t * p = &sent[i][0];
+    framesOut++;
+    if (lossRate > 0 && rand() < lossRate * RAND_MAX)
+      continue;
+    uint16_t type = get16(p + 12);
+    if (type == 0x0806) {
+      if (get16(p + 20) != 1)
+        continue;
+      uint32_t target = get32(p + 38);
+      for (size_t k = 0; k < peers.size(); k++)
+        if (peers[k].ip == target) {
+          Frame r(42);
+          memcpy(&r[0], SRV_MAC, 6);
+          memcpy(&r[6], peers[k].mac, 6);
+          put16(&r[12], 0x0806);
+          put16(&r[14], 1);
+          put16(&r[16], 0x0800);
+          r[18] = 6;
+          r[19] = 4;
+          put16(&r[20], 2);
+          memcpy(&r[22], peers[k].mac, 6);
+          put32(&r[28], target);
+          memcpy(&r[32], SRV_MAC, 6);
+          put32(&r[38], SRV_IP);
+          send(r);
+        }
+      continue;
+    }
+    if (type != 0x0800 || p[23] != 6)
+      continue;
+    if (!tcpChecksumOk(p)) {
+      badChecksums++;
+      continue;
+    }
+    for (size_t k = 0; k < peers.size(); k++)
+      if (peers[k].ip == get32(p + 30))
+        peers[k].input(p);
+  }
+  sent.clear();
+  for (size_t k = 0; k < peers.size(); k++)
+    peers[k].timer();
+  while (!toChip.empty() && toChip.front().at <= hostMicros) {
+    Frame & f = toChip.front().f;
+    Enc28j60Sim::receive(&f[0], f.size());     // dropped when the ring is full
+    toChip.pop_front();
+  }
+}
+
+extern "C" unsigned long millis(void) {
+  static bool inNet;
+  hostMicros += 1;
+  if (!inNet) {
+    inNet = true;
+    netStep();
+    inNet = false;
+  }
+  return hostMicros / 1000;
+}
+
+#endif
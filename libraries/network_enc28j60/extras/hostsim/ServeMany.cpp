@@ -0,0 +1,143 @@
+/*
+ ServeMany - clients fetching a 1000 byte page over and over from aSocket
+
+ Three sockets serve port 80 and a fourth sends a 32 byte telemetry
+ record every 50 ms to a collector.  Built with -DSERVE_BLOCKING it is
+ one socket served with the blocking calls, as network.cpp does.
+
+   ServeMany [clients [loss [seconds]]]
+
+ Fails when a frame has a bad checksum, a frame was written while being
+ transmitted, or no connection completed.
+ */
+
+#include "LinkSim.h"
+#include <WProgram.h>
+#include "aSocket.h"
+
+#ifndef SERVE_BLOCKING
+aSocket web[3], up;
+#else
+aSocket sock;
+#endif
+
+static uint8_t hwaddr[6] = { 0x01, 0x02, 0x03, 0x10, 0x00, 0x09 };
+static uint8_t page[1000];
+static const long PAGE = sizeof(page);
+static long telemetrySent;
+
+int main(int argc, char ** argv) {
+  int clients = argc > 1 ? atoi(argv[1]) : 4;
+  lossRate = argc > 2 ? atof(argv[2]) : 0;
+  long long endUs = argc > 3 ? atof(argv[3]) * 1e6 : 10000000;
+
+  srand(1);
+  for (int i = 0; i < PAGE; i++)
+    page[i] = 'a' + i % 26;
+  enc28j60Init(hwaddr);
+  for (int i = 0; i < clients; i++)
+    addPeer(0x0A000064 + i, 80, false, PAGE);
+#ifndef SERVE_BLOCKING
+  addPeer(0x0A000032, 5000, true, 0);
+  size_t collector = peers.size() - 1;
+  web[0].setup(htonl(SRV_IP), hwaddr, 24, htonl(0x0A000001));
+#endif
+  for (size_t i = 0; i < peers.size(); i++)
+    if (!peers[i].server)
+      peers[i].start();
+
+#ifndef SERVE_BLOCKING
+  long off[3] = { 0, 0, 0 };
+  uint8_t busy[3] = { 0, 0, 0 };
+  uint32_t lastTelemetry = 0;
+
+  while (hostMicros < endUs) {
+    aSocket::poll();
+    for (int i = 0; i < 3; i++) {
+      aSocket & s = web[i];
+      if (s.state() == ASOCK_CLOSED) {
+        s.listen(htons(80), IPPROTO_TCP, ASOCKET_NOWAIT);
+        busy[i] = 0;
+        continue;
+      }
+      if (s.state() != ASOCK_ESTABLISHED)
+        continue;
+      uint8_t ev = s.events();
+      if (!busy[i] && s.available() >= 18) {
+        uint16_t n = 18;
+        uint8_t * d = s.read(&n);
+        if (strncmp((char *) d, "GET ", 4)) {
+          fprintf(stderr, "bad request\n");
+          return 1;
+        }
+        busy[i] = 1;
+        off[i] = 0;
+      }
+      if (busy[i] == 1) {
+        off[i] += s.write(page + off[i], PAGE - off[i], ASOCKET_NOWAIT);
+        if (off[i] == PAGE)
+          busy[i] = 2;
+      } else if (busy[i] == 2 && (ev & ASOCK_EV_ACKED)) {
+        s.close();
+        s.listen(htons(80), IPPROTO_TCP, ASOCKET_NOWAIT);
+        busy[i] = 0;
+      }
+    }
+    if (up.state() == ASOCK_CLOSED) {
+      up.connect(htonl(0x0A000032), htons(5000), IPPROTO_TCP, ASOCKET_NOWAIT);
+    } else if (up.state() == ASOCK_ESTABLISHED && millis() - lastTelemetry >= 50) {
+      uint8_t record[32];
+      memset(record, 't', sizeof(record));
+      if (up.write(record, sizeof(record), ASOCKET_NOWAIT) == sizeof(record))
+        telemetrySent++;
+      lastTelemetry = millis();
+    }
+  }
+#else
+  while (hostMicros < endUs) {
+    sock.setup(htonl(SRV_IP), hwaddr, 24, htonl(0x0A000001));
+    if (sock.listen(htons(80), IPPROTO_TCP) == INADDR_NONE)
+      continue;
+    while (sock.available() < 16 && sock.state() != ASOCK_CLOSED)
+      ;
+    if (sock.state() == ASOCK_CLOSED)
+      continue;
+    uint16_t n = ASOCKET_BUFSIZE;
+    uint8_t * d = sock.read(&n);
+    if (strncmp((char *) d, "GET ", 4)) {
+      fprintf(stderr, "bad request\n");
+      return 1;
+    }
+    for (long o = 0; o < PAGE; ) {
+      long len = PAGE - o > 300 ? 300 : PAGE - o;
+      o += sock.write(page + o, len, o + len < PAGE ? ASOCKET_MORE_DATA : 0);
+      if (sock.state() != ASOCK_ESTABLISHED)
+        break;
+    }
+    sock.close();
+  }
+#endif
+
+  long done = 0, failed = 0;
+  long long latency = 0, latencyMax = 0;
+  for (size_t i = 0; i < peers.size(); i++) {
+    if (peers[i].server)
+      continue;
+    done += peers[i].done;
+    failed += peers[i].failed;
+    latency += peers[i].latSum;
+    if (peers[i].latMax > latencyMax)
+      latencyMax = peers[i].latMax;
+  }
+  printf("clients %d loss %.2f: %.1f conn/s, latency avg %.1f ms max %.1f ms, failed %ld, "
+         "bad checksums %ld, rx drops %lu",
+         clients, lossRate, done / (endUs / 1e6), done ? latency / done / 1000.0 : 0,
+         latencyMax / 1000.0, failed, badChecksums, Enc28j60Sim::rxDrops);
+#ifndef SERVE_BLOCKING
+  printf(", telemetry %ld/%ld", peers[collector].bytesIn / 32, telemetrySent);
+#endif
+  printf(", tx overwrites %lu, spi bytes/conn %lu\n",
+         Enc28j60Sim::txOverwrites, done ? Enc28j60Sim::spiBytes / done : 0);
+
+  return badChecksums || Enc28j60Sim::txOverwrites || !done;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds aSocket with the host compiler against the ENC28J60 model and
+# runs the tests.  Run from this directory:  sh build.sh
+#
+# The library casts buffer pointers to 16 bit offsets as on the AVR, so
+# it is built with -fpermissive.
+
+set -e
+LIB=../..
+CXX="${CXX:-g++} -w -fpermissive -Istub -I$LIB -I."
+SOURCES="enc28j60_c.cpp $LIB/aSocket.cpp hostcore.cpp Enc28j60Sim.cpp"
+
+mkdir -p bin
+$CXX $SOURCES ServeMany.cpp -o bin/ServeMany
+$CXX -DSERVE_BLOCKING $SOURCES ServeMany.cpp -o bin/ServeBlocking
+$CXX $SOURCES Lifetime.cpp -o bin/Lifetime
+./bin/Lifetime
+echo "== ServeBlocking"
+./bin/ServeBlocking 4 0
+./bin/ServeBlocking 4 0.01
+./bin/ServeBlocking 4 0.02
+echo "== ServeMany"
+./bin/ServeMany 3 0
+./bin/ServeMany 4 0
+./bin/ServeMany 4 0.01
+./bin/ServeMany 4 0.02
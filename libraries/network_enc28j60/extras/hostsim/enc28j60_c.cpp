@@ -0,0 +1,5 @@
+// enc28j60.c built as C++ so that SPDR reaches the model
+
+extern "C" {
+#include <enc28j60.c>
+}
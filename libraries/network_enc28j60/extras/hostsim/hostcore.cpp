@@ -0,0 +1,32 @@
+// Pins, SPI and delays of the Arduino core for host builds.  millis() is
+// in LinkSim.h, it runs the network as time passes.
+
+#include <WProgram.h>
+#include "Enc28j60Sim.h"
+
+// time an SPI byte takes, at 4 MHz with the AVR's overhead
+#define SPI_BYTE_US 3
+
+long long hostMicros;
+
+HostSPDR SPDR;
+HostPortB PORTB;
+volatile uint8_t SPSR = 1 << SPIF;  // every transfer is complete at once
+volatile uint8_t SPCR;
+
+HostSPDR & HostSPDR::operator=(uint8_t out) {
+  hostMicros += SPI_BYTE_US;
+  in = Enc28j60Sim::transfer(out);
+  return *this;
+}
+
+HostPortB & HostPortB::operator=(int v) {
+  value = v;
+  Enc28j60Sim::select((v & 7) == 0);
+  return *this;
+}
+
+extern "C" void pinMode(uint8_t, uint8_t) {}
+extern "C" void digitalWrite(uint8_t, uint8_t) {}
+extern "C" void delay(unsigned long) {}
+extern "C" void delayMicroseconds(unsigned int) {}
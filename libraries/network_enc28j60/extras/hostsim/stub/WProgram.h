@@ -0,0 +1,31 @@
+// Host stand-in for the parts of the Arduino core the library uses
+
+#ifndef WProgram_h
+#define WProgram_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned long millis(void);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+// The SPI registers of the AVR and port B, wired to the ENC28J60 model.
+// Writing SPDR clocks a byte out and latches the byte clocked in.  The
+// low three bits of PORTB select the device, 0 is the ENC28J60.
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+
+#define SPIF 7
+#define SPI2X 0
+#define SPE 6
+#define MSTR 4
+
+struct HostSPDR {
+  uint8_t in;
+  HostSPDR & operator=(uint8_t out);
+  operator uint8_t() const { return in; }
+};
+
+struct HostPortB {
+  uint8_t value;
+  HostPortB & operator=(int v);
+  operator int() const { return value; }
+};
+
+extern HostSPDR SPDR;
+extern HostPortB PORTB;
+extern volatile uint8_t SPSR, SPCR;
+
+#endif
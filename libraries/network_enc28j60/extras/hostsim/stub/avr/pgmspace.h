@@ -0,0 +1,15 @@
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+typedef char prog_char;
+typedef const char *PGM_P;
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strncmp_P strncmp
+
+#endif
@@ -29,7 +29,7 @@ uint32_t authtime;
 uint32_t authip;
 uint8_t auth = 0;
 
-aSocket sock = aSocket();
+aSocket sock;
 
 struct httpreq {
 
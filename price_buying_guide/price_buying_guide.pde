@@ -1,24 +1,5 @@
-
-
-int best(int price[], int items, int budget, boolean buying[]) {
-  int itemNo = items - 1;
-  if ( items == 0 )
-    return 0;
-  if ( items == 1 and price[itemNo] <= budget )
-    return price[itemNo];
-
-  
-  int buy = price[itemNo] 
-    + best(price, itemNo, budget - price[itemNo], buying);
-  int notbuy = best(price, itemNo, budget, buying);
-  if ( buy <= budget and buy >= notbuy ) {
-    buying[itemNo] = true;
-    return buy;
-  } else {
-    buying[itemNo] = false;
-    return notbuy;
-  }
-}
+#include <Sort.h>
+#include <SubsetSum.h>
 
 int list0[] = { 
   108, 78, 78, 58, 58, 68, 0};
@@ -27,6 +8,8 @@ int list1[] = {
   228, 238, 198, 298, 64, 178, 0};
 int * plist = list1;
 const int B = 500;
+// every total up to the budget, see SubsetSum.h
+byte work[SUBSET_SUM_WORKSPACE(B)];
 
 void setup() {
   Serial.begin(9600);
@@ -50,7 +33,7 @@ void setup() {
   
   long swatch_milli = millis();
   long swatch_mu = micros();
-  int result = best(plist, number, B, buyingGuide);
+  int result = SubsetSum::best(plist, number, B, buyingGuide, work, sizeof(work));
   swatch_mu = micros() - swatch_mu;
   swatch_milli = millis() - swatch_milli;
   
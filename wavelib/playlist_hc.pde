@@ -0,0 +1,129 @@
+/*
+ * Gapless playlist with a beep mixed over the stream.
+ *
+ * Plays every WAV file in the root directory back to back using
+ * WaveHC::enqueue().  Send 'b' to overlay a beep, '+'/'-' to change the
+ * stream gain.  Once a second the sketch prints the number of idle loop
+ * passes, which drops as the DAC interrupt takes more of the CPU, so the
+ * cost of mixing can be compared with plain playback.
+ */
+#include <FatReader.h>
+#include <SdReader.h>
+#include <avr/pgmspace.h>
+#include "WaveUtil.h"
+#include "WaveHC.h"
+#include "WaveMixer.h"
+
+SdReader card;
+FatVolume vol;
+FatReader root;
+dir_t dirBuf;
+
+// two files and waves, one playing and one queued
+FatReader file[2];
+WaveHC wave[2];
+uint8_t next = 0;
+
+// 1 kHz beep at 22.05 kHz, 8-bit unsigned, 22 samples per cycle
+const uint8_t beepCycle[] PROGMEM = {
+  128, 164, 197, 224, 243, 254, 254, 243, 224, 197, 164,
+  128,  92,  59,  32,  13,   2,   2,  13,  32,  59,  92
+};
+uint16_t streamGain = MIXER_UNITY;
+uint32_t idleCount = 0;
+uint32_t lastReport = 0;
+
+/*
+ * print error message and halt if SD I/O error
+ */
+void sdErrorCheck(void)
+{
+  if (!card.errorCode()) return;
+  putstring("\n\rSD I/O error: ");
+  Serial.print(card.errorCode(), HEX);
+  putstring(", ");
+  Serial.println(card.errorData(), HEX);
+  while(1);
+}
+/*
+ * open the next WAV in the root directory into file[next] and queue it
+ */
+uint8_t queueNext(void)
+{
+  uint8_t ok = 0;
+  WaveHC::lockReader();
+  while (!ok) {
+    if (root.readDir(dirBuf) <= 0) {
+      root.rewind();
+      if (root.readDir(dirBuf) <= 0) break;
+    }
+    if (dirBuf.name[0] == '.' || DIR_IS_SUBDIR(dirBuf)) continue;
+    if (strncmp_P((char *)&dirBuf.name[8], PSTR("WAV"), 3)) continue;
+    ok = file[next].open(vol, dirBuf) && wave[next].create(file[next]);
+  }
+  WaveHC::unlockReader();
+  sdErrorCheck();
+  if (!ok || !wave[next].enqueue()) return 0;
+  next ^= 1;
+  return 1;
+}
+
+void setup() {
+  Serial.begin(9600);
+  putstring_nl("\nGapless playlist");
+
+  pinMode(2, OUTPUT);
+  pinMode(3, OUTPUT);
+  pinMode(4, OUTPUT);
+  pinMode(5, OUTPUT);
+  if (!card.init()) {
+    putstring_nl("Card init. failed!");
+    sdErrorCheck();while(1);
+  }
+  card.partialBlockRead(true);
+  if (!vol.init(card)) {
+    putstring_nl("No valid FAT partition!");
+    sdErrorCheck();while(1);
+  }
+  if (!root.openRoot(vol)) {
+    putstring_nl("Can't open root dir!"); while(1);
+  }
+  Mixer.begin(22050);
+  // start the first wave and queue the second
+  if (!queueNext() || !queueNext()) {
+    putstring_nl("Need WAV files with the same format!"); while(1);
+  }
+}
+
+void loop() {
+  // queue another wave as soon as the queued one starts playing
+  if (!wave[next ^ 1].isQueued()) {
+    if (!queueNext()) putstring_nl("Format mismatch, gap follows");
+  }
+  if (Serial.available()) {
+    switch (Serial.read()) {
+      case 'b':
+        Mixer.start(1, beepCycle, sizeof(beepCycle), MIXER_UNITY/2, 1);
+        delay(200);
+        Mixer.stop(1);
+        break;
+      case '+':
+        if (streamGain < MIXER_UNITY) streamGain += 32;
+        Mixer.setGain(0, streamGain);
+        break;
+      case '-':
+        if (streamGain > 0) streamGain -= 32;
+        Mixer.setGain(0, streamGain);
+        break;
+    }
+  }
+  idleCount++;
+  if (millis() - lastReport >= 1000) {
+    lastReport = millis();
+    putstring("idle/s: ");
+    Serial.print(idleCount);
+    putstring(" underruns: ");
+    Serial.println(wave[0].errors + wave[1].errors);
+    idleCount = 0;
+  }
+}